@@ -16,6 +16,7 @@ if is_plat("linux") and has_config("enable_backend_x11") then
     add_requires("pkgconfig::xcb", {system = true})
     add_requires("pkgconfig::xcb-keysyms", {system = true})
     add_requires("pkgconfig::xcb-randr", {system = true})
+    add_requires("pkgconfig::xcb-xfixes", {system = true})
     add_requires("pkgconfig::xcb-xinput", {system = true})
     add_requires("pkgconfig::xcb-xtest", {system = true})
 end
@@ -36,6 +37,7 @@ function mks_add_backend_packages()
         add_packages("pkgconfig::xcb")
         add_packages("pkgconfig::xcb-keysyms")
         add_packages("pkgconfig::xcb-randr")
+        add_packages("pkgconfig::xcb-xfixes")
         add_packages("pkgconfig::xcb-xinput")
         add_packages("pkgconfig::xcb-xtest")
     end
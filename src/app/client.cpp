@@ -1,13 +1,64 @@
 #include "rpc/transport.hpp"
 #include "rpc/message.hpp"
 #include "client.hpp"
+#include "diag/flight_recorder.hpp"
+#include "diag/metrics.hpp"
+#include "diag/trace.hpp"
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <cstring>
 #include <utility>
 
 MKS_BEGIN
 
+namespace {
+
+struct ClientMetrics {
+    Counter &injected;
+    Counter &injectFailures;
+    Histogram &injectNs;
+    Histogram &startupNs;
+    Histogram &resumeNs;
+    Counter &resumed;
+};
+
+auto clientMetrics() -> ClientMetrics & {
+    static auto result = ClientMetrics {
+        .injected = metrics().counter("client.inject.events"),
+        .injectFailures = metrics().counter("client.inject.failures"),
+        .injectNs = metrics().histogram("client.inject.latency_ns"),
+        // run() entry until Hello + Screens are flushed with injection ready.
+        .startupNs = metrics().histogram("client.startup.latency_ns"),
+        // Connection loss until the resuming handshake is flushed.
+        .resumeNs = metrics().histogram("client.resume.latency_ns"),
+        .resumed = metrics().counter("client.sessions.resumed"),
+    };
+    return result;
+}
+
+constexpr auto kReconnectInitialDelay = std::chrono::milliseconds {100};
+constexpr auto kReconnectMaxDelay = std::chrono::milliseconds {2'000};
+
+// Messages the client sends on its own (screen diffs, clipboard offers and requests).
+constexpr auto kOutboundDepth = size_t {16};
+constexpr auto kClipboardRequestDepth = size_t {8};
+// Drag offers and ends; a drag offers at most 64 files.
+constexpr auto kDropDepth = size_t {80};
+
+auto localComputerName() -> IoResult<std::string> {
+    char buffer[256] {};
+    if (::gethostname(buffer, sizeof(buffer)) == -1) {
+        return Err(std::error_code(errno, std::generic_category()));
+    }
+    buffer[sizeof(buffer) - 1] = '\0';
+    return std::string {buffer, std::strlen(buffer)};
+}
+
+} // namespace
+
 Client::Client(Platform::Ptr platform, IPEndpoint endpoint)
     : Client(std::move(platform), endpoint, AppConfig {}) {
 
@@ -16,52 +67,123 @@ Client::Client(Platform::Ptr platform, IPEndpoint endpoint)
 Client::Client(Platform::Ptr platform, IPEndpoint endpoint, AppConfig config)
     : mPlatform(std::move(platform)),
       mEndpoint(endpoint),
-      mConfig(std::move(config)) {
+      mConfig(std::move(config)),
+      mDrops(mFiles, [this](FileFetchMessage fetch, FileReceiveOptions options) {
+          return fetchDropped(std::move(fetch), options);
+      }) {
     // Interface invariant: callers inject a live Platform.
     assert(mPlatform);
     ensureMachineId(mConfig);
 }
 
 auto Client::run() -> IoTask<void> {
+    const auto startedAt = std::chrono::steady_clock::now();
     auto injector = mPlatform->createInjector();
     if (!injector) {
         SPDLOG_ERROR("Current platform does not provide an input injector");
         co_return Err(std::make_error_code(std::errc::operation_not_supported));
     }
-    
+
+    ILIAS_CO_TRY(auto computerName, localComputerName());
+    SPDLOG_INFO("Computer name: {}", computerName);
+
+    // Connecting waits on the network and injector setup on the display
+    // server or portal, so the two overlap. The injector is initialized
+    // speculatively: it is shut down again if the connection fails or the
+    // server rejects this client.
     SPDLOG_INFO("Connecting to server to {}", mEndpoint);
-    ILIAS_CO_TRY(auto stream, co_await TcpStream::connect(mEndpoint));
+    auto [connected, initialized, clipboard] = co_await ilias::whenAll(
+        TcpStream::connect(mEndpoint),
+        injector->initialize(),
+        initializeClipboard()
+    );
+    mClipboard = std::move(clipboard);
+    if (!initialized) {
+        SPDLOG_ERROR("Client failed to initialize input injection: {}", initialized.error().message());
+        if (mClipboard) {
+            co_await mClipboard->shutdown();
+            mClipboard = nullptr;
+        }
+        co_return Err(initialized.error());
+    }
+    if (!connected) {
+        co_await shutdownPlatform(*injector);
+        co_return Err(connected.error());
+    }
+
+    // The injector outlives individual connections so a resumed session
+    // continues with the same virtual devices (and held keys) as before.
+    co_return co_await ilias::finally(
+        serveConnections(std::move(*connected), *injector, computerName, startedAt),
+        shutdownPlatform(*injector)
+    );
+}
 
-    // Send Hello to it
-    char computerNameBuf[256] {};
-    if (::gethostname(computerNameBuf, sizeof(computerNameBuf)) == -1) {
-        co_return Err(std::error_code(errno, std::generic_category()));
+auto Client::serveConnections(
+    TcpStream stream,
+    InputInjector &injector,
+    std::string_view computerName,
+    std::chrono::steady_clock::time_point startedAt
+) -> IoTask<void> {
+    auto *latency = &clientMetrics().startupNs;
+    while (true) {
+        auto result = co_await runConnection(std::move(stream), injector, computerName, *latency, startedAt);
+        if (result || result.error() == make_error_code(RpcError::Rejected) || mResumeToken.empty() ||
+            mResumeGracePeriod.count() <= 0) {
+            co_return result;
+        }
+
+        SPDLOG_WARN(
+            "Client lost connection to {}: {}; reconnecting within {}ms",
+            mEndpoint,
+            result.error().message(),
+            mResumeGracePeriod.count()
+        );
+        startedAt = std::chrono::steady_clock::now();
+        auto reconnected = co_await reconnect(startedAt + mResumeGracePeriod);
+        if (!reconnected) {
+            SPDLOG_ERROR("Client could not reconnect to {}: {}", mEndpoint, reconnected.error().message());
+            co_return result;
+        }
+        stream = std::move(*reconnected);
+        latency = &clientMetrics().resumeNs;
     }
-    computerNameBuf[sizeof(computerNameBuf) - 1] = '\0';
-    auto computerNameLen = std::strlen(computerNameBuf);
-    std::string_view computerName {computerNameBuf, static_cast<size_t>(computerNameLen)};
-    SPDLOG_INFO("Computer name: {}", computerName);
+}
 
+auto Client::runConnection(
+    TcpStream stream,
+    InputInjector &injector,
+    std::string_view computerName,
+    Histogram &latency,
+    std::chrono::steady_clock::time_point startedAt
+) -> IoTask<void> {
     RpcTransport transport {std::move(stream)};
-    ILIAS_CO_TRYV(co_await transport.writeMessage(RpcMessage {HelloMessage {
-        .version = 0,
-        .machineId = mConfig.machineId,
-        .name = std::string {computerName},
-    }}));
-
-    // Initialize injection only after the server accepts the identity. If this
-    // fails, the connection exits before advertising screens that cannot accept
-    // forwarded input.
-    ILIAS_CO_TRYV(co_await injector->initialize());
-
-    // Start the reader part and the writer part
-    auto [readResult, writeResult] = co_await ilias::finally(
+    const auto handshake = makeHandshake(computerName);
+    auto known = std::vector<ScreenInfo> {};
+    if (const auto *screens = std::get_if<ScreensMessage>(&handshake.back())) {
+        known = screens->screens;
+    }
+
+    // Everything but the handshake goes through these queues, so the one
+    // writer can put input-sized frames ahead of clipboard chunks.
+    auto [outbound, outboundReceiver] = ilias::mpsc::channel<RpcMessage>(kOutboundDepth);
+    auto [bulk, bulkReceiver] = ilias::mpsc::channel<RpcMessage>(kClipboardBulkDepth);
+    auto [requests, requestReceiver] = ilias::mpsc::channel<ClipboardRequestMessage>(kClipboardRequestDepth);
+    auto [drops, dropReceiver] = ilias::mpsc::channel<RpcMessage>(kDropDepth);
+    mOutbound = outbound;
+    auto [readResult, writeResult, screensResult, clipboardResult, dropsResult] = co_await ilias::finally(
         ilias::whenAny(
-            handleRead(transport, *injector),
-            handleWrite(transport)
+            handleRead(transport, injector, requests, drops),
+            handleWrite(transport, handshake, latency, startedAt, outboundReceiver, bulkReceiver),
+            watchScreens(outbound, std::move(known)),
+            syncClipboard(outbound, bulk, requestReceiver),
+            receiveDrops(dropReceiver)
         ),
-        shutdownConnection(transport, *injector)
+        shutdownConnection(transport)
     );
+    // Pastes waiting on this connection fail now rather than at their timeout.
+    mOutbound = {};
+    mClipboardFetches.failAll(make_error_code(ClipboardError::Disconnected));
 
     if (readResult) {
         ILIAS_CO_TRYV(std::move(*readResult));
@@ -69,10 +191,137 @@ auto Client::run() -> IoTask<void> {
     if (writeResult) {
         ILIAS_CO_TRYV(std::move(*writeResult));
     }
+    if (screensResult) {
+        ILIAS_CO_TRYV(std::move(*screensResult));
+    }
+    if (clipboardResult) {
+        ILIAS_CO_TRYV(std::move(*clipboardResult));
+    }
+    if (dropsResult) {
+        ILIAS_CO_TRYV(std::move(*dropsResult));
+    }
     co_return {};
 }
 
-auto Client::shutdownConnection(RpcTransport &transport, InputInjector &injector) -> Task<void> {
+auto Client::reconnect(std::chrono::steady_clock::time_point deadline) -> IoTask<TcpStream> {
+    auto delay = kReconnectInitialDelay;
+    while (true) {
+        const auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::steady_clock::duration::zero()) {
+            co_return Err(std::make_error_code(std::errc::timed_out));
+        }
+        // A connect to a vanished address can hang far past the grace period.
+        auto [connected, timeout] = co_await ilias::whenAny(
+            TcpStream::connect(mEndpoint),
+            ilias::sleep(std::chrono::duration_cast<std::chrono::milliseconds>(remaining))
+        );
+        if (connected && *connected) {
+            co_return std::move(connected->value());
+        }
+        if (!connected) {
+            co_return Err(std::make_error_code(std::errc::timed_out));
+        }
+        SPDLOG_DEBUG("Client reconnect to {} failed: {}", mEndpoint, connected->error().message());
+        co_await ilias::sleep(delay);
+        delay = std::min(delay * 2, kReconnectMaxDelay);
+    }
+}
+
+auto Client::makeHandshake(std::string_view computerName) const -> std::array<RpcMessage, 2> {
+    // Hello and Screens go out together as soon as the socket is up. These
+    // coordinates are the client's own real screen rects; the server stores
+    // them for entry-point mapping and sends input back in the same
+    // screenIndex/x/y space. Screens are re-read per connection: a layout
+    // that changed while disconnected makes the server register afresh.
+    // handleWrite() reports later changes from this snapshot.
+    return std::array {
+        RpcMessage {HelloMessage {
+            .version = kProtocolVersion,
+            .machineId = mConfig.machineId,
+            .name = std::string {computerName},
+            .resumeToken = mResumeToken,
+        }},
+        RpcMessage {ScreensMessage {
+            .screens = mPlatform->screens(),
+        }},
+    };
+}
+
+// MARK: Files
+
+auto sendFileTo(
+    IPEndpoint endpoint,
+    const AppConfig &config,
+    FileTransfers &files,
+    std::filesystem::path path,
+    FileSendOptions options
+) -> IoTask<FileTransferStats> {
+    ILIAS_CO_TRY(auto computerName, localComputerName());
+    ILIAS_CO_TRY(auto offer, co_await files.makeOffer(path, options));
+    SPDLOG_INFO(
+        "Client offering {} ({} bytes, {} chunks) to {}{}",
+        offer.manifest.name,
+        offer.manifest.size,
+        offer.manifest.chunkHashes.size(),
+        endpoint,
+        offer.replace ? ", replacing its copy" : ""
+    );
+    ILIAS_CO_TRY(auto stream, co_await TcpStream::connect(endpoint));
+    auto transport = RpcTransport {std::move(stream)};
+    // Hello without a resume token, then the offer where screens would go:
+    // the server treats the connection as a file transfer, not a session.
+    const auto handshake = std::array {
+        RpcMessage {HelloMessage {
+            .version = kProtocolVersion,
+            .machineId = config.machineId,
+            .name = computerName,
+        }},
+        RpcMessage {offer},
+    };
+    auto written = co_await transport.writeMessages(handshake);
+    auto result = written
+        ? co_await files.send(transport, std::move(path), offer)
+        : IoResult<FileTransferStats> {Err(written.error())};
+    if (auto closed = co_await transport.shutdown(); !closed) {
+        SPDLOG_WARN("File connection shutdown failed for {}: {}", endpoint, closed.error().message());
+    }
+    transport.close();
+    co_return result;
+}
+
+auto Client::sendFile(std::filesystem::path path, FileSendOptions options) -> IoTask<FileTransferStats> {
+    co_return co_await sendFileTo(mEndpoint, mConfig, mFiles, std::move(path), options);
+}
+
+auto Client::receiveDrops(ilias::mpsc::Receiver<RpcMessage> &drops) -> IoTask<void> {
+    co_await mDrops.run(drops);
+    co_return {};
+}
+
+auto Client::fetchDropped(FileFetchMessage fetch, FileReceiveOptions options) -> IoTask<std::filesystem::path> {
+    ILIAS_CO_TRY(auto computerName, localComputerName());
+    ILIAS_CO_TRY(auto stream, co_await TcpStream::connect(mEndpoint));
+    auto transport = RpcTransport {std::move(stream)};
+    // Like sendFile(), with the fetch where screens would go; the server
+    // answers with the file's offer and becomes the sender.
+    const auto transferId = fetch.transferId;
+    const auto handshake = std::array {
+        RpcMessage {HelloMessage {
+            .version = kProtocolVersion,
+            .machineId = mConfig.machineId,
+            .name = computerName,
+        }},
+        RpcMessage {std::move(fetch)},
+    };
+    auto written = co_await transport.writeMessages(handshake);
+    auto received = written
+        ? co_await mFiles.fetch(transport, transferId, options)
+        : IoResult<std::filesystem::path> {Err(written.error())};
+    co_await shutdownConnection(transport);
+    co_return received;
+}
+
+auto Client::shutdownConnection(RpcTransport &transport) -> Task<void> {
     SPDLOG_INFO("Client shutting down connection to {}", mEndpoint);
     auto result = co_await transport.shutdown();
     if (!result) {
@@ -83,76 +332,299 @@ auto Client::shutdownConnection(RpcTransport &transport, InputInjector &injector
         );
     }
     transport.close();
-    co_await injector.shutdown();
     SPDLOG_INFO("Client connection shutdown complete for {}", mEndpoint);
     co_return;
 }
 
-auto Client::handleWrite(RpcTransport &transport) -> IoTask<void> {
+auto Client::handleWrite(
+    RpcTransport &transport,
+    std::span<const RpcMessage> handshake,
+    Histogram &latency,
+    std::chrono::steady_clock::time_point startedAt,
+    ilias::mpsc::Receiver<RpcMessage> &outbound,
+    ilias::mpsc::Receiver<RpcMessage> &bulk
+) -> IoTask<void> {
+    // One flush; the server registers our screens when it accepts the Hello.
+    ILIAS_CO_TRYV(co_await transport.writeMessages(handshake));
+    latency.record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startedAt).count()
+    ));
+
+    while (true) {
+        auto message = co_await nextOutbound(outbound, bulk);
+        if (!message) {
+            co_return {};
+        }
+        ILIAS_CO_TRYV(co_await transport.writeMessage(*message));
+    }
+}
+
+auto Client::watchScreens(ilias::mpsc::Sender<RpcMessage> &outbound, std::vector<ScreenInfo> known)
+    -> IoTask<void> {
     using namespace std::literals;
 
-    // First, send screen to it. These coordinates are the client's own real
-    // screen rects; the server stores them for entry-point mapping and sends
-    // input back in the same screenIndex/x/y space.
-    ILIAS_CO_TRYV(co_await transport.writeMessage(RpcMessage {ScreensMessage {
-        .screens = mPlatform->screens(),
-    }}));
+    // Follow hot-plug from the layout the handshake reported. Only the diff
+    // is sent, so the server keeps routes (and the cursor) on screens that
+    // did not change.
+    while (true) {
+        auto change = co_await mPlatform->nextScreenChange(known);
+        if (!change) {
+            // Not worth dropping the connection: control keeps working on the
+            // layout the server already has.
+            SPDLOG_WARN("Client stopped watching screen changes: {}", change.error().message());
+            break;
+        }
+        auto changes = diffScreens(known, change->screens);
+        SPDLOG_INFO(
+            "Client screens changed, sending {} update(s) for {} screen(s)",
+            changes.updates.size(),
+            changes.count
+        );
+        known = std::move(change->screens);
+        if (!co_await outbound.send(RpcMessage {std::move(changes)})) {
+            co_return {};
+        }
+    }
 
-    // TODO: 
     while (true) {
         co_await ilias::sleep(1s);
-        // ILIAS_CO_TRYV(co_await transport.writeMessage(RpcMessage {PingMessage {} }));
     }
 }
 
-auto Client::handleRead(RpcTransport &transport, InputInjector &injector) -> IoTask<void> {
+auto Client::handleRead(
+    RpcTransport &transport,
+    InputInjector &injector,
+    ilias::mpsc::Sender<ClipboardRequestMessage> &clipboardRequests,
+    ilias::mpsc::Sender<RpcMessage> &drops
+) -> IoTask<void> {
     while (true) {
         ILIAS_CO_TRY(auto msg, co_await transport.readMessage());
         SPDLOG_TRACE("Client received message {}", msg);
-        ILIAS_CO_TRYV(co_await handleMessage(msg, injector));
-    }
-}
+        if (const auto *error = std::get_if<ErrorMessage>(&msg)) {
+            SPDLOG_ERROR("Server {} rejected the client: {}", mEndpoint, error->message);
+            co_return Err(RpcError::Rejected);
+        }
+        if (auto *welcome = std::get_if<WelcomeMessage>(&msg)) {
+            if (welcome->resumed) {
+                clientMetrics().resumed.add();
+                SPDLOG_INFO("Client resumed its session with {}", mEndpoint);
+            }
+            mResumeToken = std::move(welcome->resumeToken);
+            mResumeGracePeriod = std::chrono::milliseconds {welcome->resumeGraceMs};
+            continue;
+        }
+        if (auto *offer = std::get_if<ClipboardOfferMessage>(&msg)) {
+            publishClipboard(std::move(offer->offer));
+            continue;
+        }
+        if (auto *request = std::get_if<ClipboardRequestMessage>(&msg)) {
+            const auto requestId = request->requestId;
+            if (!clipboardRequests.trySend(std::move(*request))) {
+                SPDLOG_WARN("Client dropped clipboard request {}: too many pending", requestId);
+                (void) mOutbound.trySend(RpcMessage {ClipboardDataMessage {
+                    .requestId = requestId,
+                    .last = true,
+                    .error = make_error_code(ClipboardError::Unavailable).message(),
+                }});
+            }
+            continue;
+        }
+        if (const auto *chunk = std::get_if<ClipboardDataMessage>(&msg)) {
+            if (!mClipboardFetches.accept(*chunk)) {
+                SPDLOG_TRACE("Client dropped clipboard chunk for unknown request {}", chunk->requestId);
+            }
+            continue;
+        }
+        if (std::holds_alternative<DragOfferMessage>(msg) || std::holds_alternative<DragEndMessage>(msg)) {
+            if (!co_await drops.send(std::move(msg))) {
+                co_return {};
+            }
+            continue;
+        }
+        const auto *input = std::get_if<InputMessage>(&msg);
+        if (!input) {
+            SPDLOG_TRACE("Client received non-input message {}", msg);
+            continue;
+        }
 
-auto Client::handleMessage(const RpcMessage &message, InputInjector &injector) -> IoTask<void> {
-    if (auto input = std::get_if<InputMessage>(&message)) {
         // InputMessage already carries target-client coordinates. The client
         // side should inject directly instead of re-running topology logic.
-        SPDLOG_TRACE("Client injecting input event {}", input->event);
-        auto injected = co_await injector.inject(input->event);
+        // Backends that can inject right away skip the coroutine of inject().
+        const auto start = beginInject(*input);
+        auto span = std::optional<TraceSpan> {std::in_place, "InputInjector::inject", input->traceId};
+        auto injected = injector.tryInject(input->event);
         if (!injected) {
-            SPDLOG_WARN(
-                "Client failed to inject input event {}: {}",
-                input->event,
-                injected.error().message()
-            );
-            co_return Err(injected.error());
+            injected = co_await injector.inject(input->event);
         }
+        span.reset();
+        ILIAS_CO_TRYV(finishInject(*input, *injected, start));
+    }
+}
 
-        if (const auto *move = std::get_if<MouseMoveEvent>(&input->event)) {
-            if (!mLastInjectedMouseScreen || *mLastInjectedMouseScreen != move->screenIndex) {
-                SPDLOG_INFO(
-                    "Client cursor entered local screen={} at ({}, {})",
-                    move->screenIndex,
-                    move->x,
-                    move->y
-                );
-            }
-            else {
-                SPDLOG_TRACE(
-                    "Client cursor moved on local screen={} to ({}, {})",
-                    move->screenIndex,
-                    move->x,
-                    move->y
-                );
-            }
-            mLastInjectedMouseScreen = move->screenIndex;
-        }
-        SPDLOG_TRACE("Client injected input event {}", input->event);
-        co_return {};
+// MARK: Clipboard
+
+auto Client::initializeClipboard() -> Task<Clipboard::Ptr> {
+    auto clipboard = mPlatform->createClipboard();
+    if (!clipboard) {
+        SPDLOG_INFO("Current platform does not share the clipboard");
+        co_return nullptr;
     }
+    if (auto initialized = co_await clipboard->initialize(); !initialized) {
+        // Clipboard sharing is optional; injection goes on without it.
+        SPDLOG_WARN("Client failed to initialize the clipboard: {}", initialized.error().message());
+        co_return nullptr;
+    }
+    co_return clipboard;
+}
+
+auto Client::shutdownPlatform(InputInjector &injector) -> Task<void> {
+    if (mClipboard) {
+        co_await mClipboard->shutdown();
+        mClipboard = nullptr;
+    }
+    co_await injector.shutdown();
+}
 
-    SPDLOG_TRACE("Client received non-input message {}", message);
+auto Client::syncClipboard(
+    ilias::mpsc::Sender<RpcMessage> &outbound,
+    ilias::mpsc::Sender<RpcMessage> &bulk,
+    ilias::mpsc::Receiver<ClipboardRequestMessage> &requests
+) -> IoTask<void> {
+    // A copy made before this connection (or while reconnecting) is still
+    // the latest one here; the server has to hear about it again.
+    if (mLocalOffer) {
+        (void) outbound.trySend(RpcMessage {ClipboardOfferMessage {.offer = *mLocalOffer}});
+    }
+    co_await ilias::whenAll(watchClipboard(outbound), serveClipboard(bulk, requests));
     co_return {};
 }
 
+auto Client::watchClipboard(ilias::mpsc::Sender<RpcMessage> &outbound) -> Task<void> {
+    if (!mClipboard) {
+        co_return;
+    }
+    while (true) {
+        auto offer = co_await mClipboard->nextOffer();
+        if (!offer) {
+            SPDLOG_WARN("Client stopped watching the clipboard: {}", offer.error().message());
+            co_return;
+        }
+        if (offer->hash == mPublishedClipboardHash) {
+            SPDLOG_TRACE("Client ignored a local copy of the published offer {}", offer->hash);
+            continue;
+        }
+        offer->serial = ++mNextClipboardSerial;
+        mLocalOffer = *offer;
+        SPDLOG_INFO("Client clipboard changed, advertising offer {}: {}", offer->serial, offer->formats);
+        if (!co_await outbound.send(RpcMessage {ClipboardOfferMessage {.offer = std::move(*offer)}})) {
+            co_return;
+        }
+    }
+}
+
+auto Client::serveClipboard(
+    ilias::mpsc::Sender<RpcMessage> &bulk,
+    ilias::mpsc::Receiver<ClipboardRequestMessage> &requests
+) -> Task<void> {
+    while (auto request = co_await requests.recv()) {
+        auto bytes = IoResult<std::vector<std::byte>> {Err(ClipboardError::Unavailable)};
+        // Only the latest copy is readable; a request for an older serial lost the race.
+        if (mClipboard && mLocalOffer && mLocalOffer->serial == request->serial) {
+            SPDLOG_DEBUG("Client serving clipboard offer {} as {}", request->serial, request->mime);
+            bytes = co_await mClipboard->read(request->mime);
+        }
+        co_await sendClipboardData(bulk, request->requestId, std::move(bytes));
+    }
+}
+
+auto Client::publishClipboard(ClipboardOffer offer) -> void {
+    if (!mClipboard) {
+        return;
+    }
+    if (mLocalOffer && mLocalOffer->hash == offer.hash) {
+        // Same content as our own copy; keep serving it locally.
+        return;
+    }
+    SPDLOG_INFO("Client publishing clipboard offer {}: {}", offer.serial, offer.formats);
+    mPublishedClipboardHash = offer.hash;
+    // The local offer is now stale: this machine pastes the server's.
+    mLocalOffer.reset();
+    const auto serial = offer.serial;
+    auto published = mClipboard->publish(std::move(offer), [this, serial](std::string mime) {
+        return fetchClipboard(serial, std::move(mime));
+    });
+    if (!published) {
+        SPDLOG_WARN("Client failed to publish clipboard offer {}: {}", serial, published.error().message());
+    }
+}
+
+auto Client::fetchClipboard(uint32_t serial, std::string mime) -> IoTask<std::vector<std::byte>> {
+    if (!mOutbound) {
+        co_return Err(ClipboardError::Disconnected);
+    }
+    const auto requestId = ++mNextClipboardRequest;
+    auto receiver = mClipboardFetches.begin(requestId);
+    SPDLOG_DEBUG("Client pasting clipboard offer {} as {}", serial, mime);
+    auto sent = mOutbound.trySend(RpcMessage {ClipboardRequestMessage {
+        .serial = serial,
+        .requestId = requestId,
+        .mime = std::move(mime),
+    }});
+    if (!sent) {
+        mClipboardFetches.fail(requestId, make_error_code(ClipboardError::Disconnected));
+    }
+    co_return co_await awaitClipboardFetch(std::move(receiver));
+}
+
+auto Client::beginInject(const InputMessage &input) -> std::chrono::steady_clock::time_point {
+    SPDLOG_TRACE("Client injecting input event {}", input.event);
+    flightRecord(FlightStage::Receive, input.event);
+    traceFlow(TraceFlow::End, input.traceId);
+    return std::chrono::steady_clock::now();
+}
+
+auto Client::finishInject(
+    const InputMessage &input,
+    const IoResult<void> &injected,
+    std::chrono::steady_clock::time_point start
+) -> IoResult<void> {
+    clientMetrics().injectNs.record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()
+    ));
+    if (!injected) {
+        clientMetrics().injectFailures.add();
+        flightRecord(FlightStage::InjectFailed, input.event);
+        SPDLOG_WARN(
+            "Client failed to inject input event {}: {}",
+            input.event,
+            injected.error().message()
+        );
+        return Err(injected.error());
+    }
+    clientMetrics().injected.add();
+    flightRecord(FlightStage::Inject, input.event);
+
+    if (const auto *move = std::get_if<MouseMoveEvent>(&input.event)) {
+        if (!mLastInjectedMouseScreen || *mLastInjectedMouseScreen != move->screenIndex) {
+            SPDLOG_INFO(
+                "Client cursor entered local screen={} at ({}, {})",
+                move->screenIndex,
+                move->x,
+                move->y
+            );
+        }
+        else {
+            SPDLOG_TRACE(
+                "Client cursor moved on local screen={} to ({}, {})",
+                move->screenIndex,
+                move->x,
+                move->y
+            );
+        }
+        mLastInjectedMouseScreen = move->screenIndex;
+    }
+    SPDLOG_TRACE("Client injected input event {}", input.event);
+    return {};
+}
+
 MKS_END
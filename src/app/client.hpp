@@ -1,13 +1,24 @@
 #pragma once
 
 #include "preinclude.hpp"
+#include "clipboard_transfer.hpp"
 #include "config/app_config.hpp"
 #include "core.hpp"
+#include "file_drops.hpp"
+#include "file_transfer.hpp"
 #include "platform/platform.hpp"
+#include "rpc/message.hpp"
 #include <ilias/task.hpp>
 #include <ilias/net.hpp>
+#include <ilias/sync.hpp>
+#include <array>
+#include <chrono>
+#include <filesystem>
 #include <map>
 #include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 
 MKS_BEGIN
 
@@ -15,8 +26,22 @@ using ilias::IPEndpoint;
 using ilias::TcpListener;
 using ilias::TcpStream;
 
+class Histogram;
 class RpcTransport;
-struct RpcMessage;
+
+/**
+ * @brief Send @p path to the server at @p endpoint on a file connection.
+ *
+ * Needs no session, only a machine id the server trusts, so `mksync send`
+ * runs it next to a client of the same config or on its own.
+ */
+auto sendFileTo(
+    IPEndpoint endpoint,
+    const AppConfig &config,
+    FileTransfers &files,
+    std::filesystem::path path,
+    FileSendOptions options = {}
+) -> IoTask<FileTransferStats>;
 
 class Client {
 public:
@@ -25,18 +50,127 @@ public:
     Client(const Client &) = delete;
     ~Client() = default;
 
+    /**
+     * @brief Connect, handshake and inject until the connection is lost for good.
+     *
+     * A connection that drops after the server issued a resume token is
+     * re-established within the server's grace period, keeping the injector
+     * up, so the server can restore this client's route as it was.
+     */
     auto run() -> IoTask<void>;
 
+    /**
+     * @brief Send @p path to the server on a connection of its own.
+     *
+     * Independent of @c run(): input keeps flowing on the session while the
+     * file streams. Sending the same file again after a failure only moves
+     * the chunks the server does not hold yet.
+     */
+    auto sendFile(std::filesystem::path path, FileSendOptions options = {}) -> IoTask<FileTransferStats>;
+
+    auto files() noexcept -> FileTransfers & { return mFiles; }
+
+    /** @brief Files dragged from the server onto this machine; see @ref FileDrops. */
+    auto drops() noexcept -> FileDrops & { return mDrops; }
+
 private:
-    auto handleWrite(RpcTransport &transport) -> IoTask<void>;
-    auto handleRead(RpcTransport &transport, InputInjector &injector) -> IoTask<void>;
-    auto handleMessage(const RpcMessage &message, InputInjector &injector) -> IoTask<void>;
-    auto shutdownConnection(RpcTransport &transport, InputInjector &injector) -> Task<void>;
+    auto serveConnections(
+        TcpStream stream,
+        InputInjector &injector,
+        std::string_view computerName,
+        std::chrono::steady_clock::time_point startedAt
+    ) -> IoTask<void>;
+    auto runConnection(
+        TcpStream stream,
+        InputInjector &injector,
+        std::string_view computerName,
+        Histogram &latency,
+        std::chrono::steady_clock::time_point startedAt
+    ) -> IoTask<void>;
+    /** @brief Retry connecting with backoff until @p deadline. */
+    auto reconnect(std::chrono::steady_clock::time_point deadline) -> IoTask<TcpStream>;
+    auto makeHandshake(std::string_view computerName) const -> std::array<RpcMessage, 2>;
+    /**
+     * @brief Flush the handshake, then write queued messages.
+     *
+     * Clipboard chunks on @p bulk go out only while @p outbound is empty.
+     */
+    auto handleWrite(
+        RpcTransport &transport,
+        std::span<const RpcMessage> handshake,
+        Histogram &latency,
+        std::chrono::steady_clock::time_point startedAt,
+        ilias::mpsc::Receiver<RpcMessage> &outbound,
+        ilias::mpsc::Receiver<RpcMessage> &bulk
+    ) -> IoTask<void>;
+    auto handleRead(
+        RpcTransport &transport,
+        InputInjector &injector,
+        ilias::mpsc::Sender<ClipboardRequestMessage> &clipboardRequests,
+        ilias::mpsc::Sender<RpcMessage> &drops
+    ) -> IoTask<void>;
+    /** @brief Report screen hot-plug from @p known on as ScreensChangedMessage diffs. */
+    auto watchScreens(ilias::mpsc::Sender<RpcMessage> &outbound, std::vector<ScreenInfo> known) -> IoTask<void>;
+
+    // MARK: Clipboard
+
+    /** @brief Bring up the local clipboard; null when the backend has none or it fails. */
+    auto initializeClipboard() -> Task<Clipboard::Ptr>;
+    auto shutdownPlatform(InputInjector &injector) -> Task<void>;
+    /** @brief Advertise local copies and answer requests for them for one connection. */
+    auto syncClipboard(
+        ilias::mpsc::Sender<RpcMessage> &outbound,
+        ilias::mpsc::Sender<RpcMessage> &bulk,
+        ilias::mpsc::Receiver<ClipboardRequestMessage> &requests
+    ) -> IoTask<void>;
+    auto watchClipboard(ilias::mpsc::Sender<RpcMessage> &outbound) -> Task<void>;
+    /** @brief Stream the local offer for each request onto @p bulk, one request at a time. */
+    auto serveClipboard(
+        ilias::mpsc::Sender<RpcMessage> &bulk,
+        ilias::mpsc::Receiver<ClipboardRequestMessage> &requests
+    ) -> Task<void>;
+    /** @brief Make a server offer pasteable here. */
+    auto publishClipboard(ClipboardOffer offer) -> void;
+    /** @brief Clipboard::Fetch for an offer published by @ref publishClipboard. */
+    auto fetchClipboard(uint32_t serial, std::string mime) -> IoTask<std::vector<std::byte>>;
+    // Synchronous halves of one injection, so the per-event path only
+    // suspends when the injector itself has to wait.
+    auto beginInject(const InputMessage &input) -> std::chrono::steady_clock::time_point;
+    auto finishInject(
+        const InputMessage &input,
+        const IoResult<void> &injected,
+        std::chrono::steady_clock::time_point start
+    ) -> IoResult<void>;
+    auto shutdownConnection(RpcTransport &transport) -> Task<void>;
+
+    // MARK: Files
+
+    /** @brief Run @ref FileDrops for one connection on the drag messages in @p drops. */
+    auto receiveDrops(ilias::mpsc::Receiver<RpcMessage> &drops) -> IoTask<void>;
+    /** @brief FileDrops::Fetch — fetch a dragged file on a connection of its own. */
+    auto fetchDropped(FileFetchMessage fetch, FileReceiveOptions options) -> IoTask<std::filesystem::path>;
 
     Platform::Ptr mPlatform;
     IPEndpoint mEndpoint;
     AppConfig mConfig;
     std::optional<uint32_t> mLastInjectedMouseScreen;
+    // From the last WelcomeMessage; empty until the server issues one.
+    std::string mResumeToken;
+    std::chrono::milliseconds mResumeGracePeriod {0};
+
+    Clipboard::Ptr mClipboard;
+    // Queue of the live connection's writer; empty between connections.
+    ilias::mpsc::Sender<RpcMessage> mOutbound;
+    ClipboardFetches mClipboardFetches;
+    // Last local copy advertised, under our own serial; re-sent on reconnect.
+    std::optional<ClipboardOffer> mLocalOffer;
+    // Hash of the last server offer published locally, so its echo is not re-advertised.
+    std::string mPublishedClipboardHash;
+    uint32_t mNextClipboardSerial = 0;
+    uint32_t mNextClipboardRequest = 0;
+
+    FileTransfers mFiles;
+    FileDrops mDrops;
 };
 
 MKS_END
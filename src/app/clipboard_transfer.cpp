@@ -0,0 +1,138 @@
+#include "clipboard_transfer.hpp"
+#include "worker_pool.hpp"
+
+#include <memory>
+#include <utility>
+
+MKS_BEGIN
+
+THIS_ERROR_IMPL(ClipboardError);
+
+// MARK: Fetches
+
+auto ClipboardFetches::begin(uint32_t requestId) -> ilias::oneshot::Receiver<Result> {
+    auto [sender, receiver] = ilias::oneshot::channel<Result>();
+    mPending.insert_or_assign(requestId, Pending {.done = std::move(sender)});
+    return std::move(receiver);
+}
+
+auto ClipboardFetches::accept(const ClipboardDataMessage &chunk) -> bool {
+    auto it = mPending.find(chunk.requestId);
+    if (it == mPending.end()) {
+        return false;
+    }
+    auto &pending = it->second;
+    if (!chunk.error.empty()) {
+        SPDLOG_WARN("Clipboard request {} failed remotely: {}", chunk.requestId, chunk.error);
+        (void) pending.done.send(Err(ClipboardError::Unavailable));
+        mPending.erase(it);
+        return true;
+    }
+    if (!appendClipboardChunk(pending.bytes, chunk)) {
+        SPDLOG_WARN(
+            "Clipboard request {} got a bad chunk at offset {} (have {} bytes)",
+            chunk.requestId,
+            chunk.offset,
+            pending.bytes.size()
+        );
+        (void) pending.done.send(Err(ClipboardError::TransferFailed));
+        mPending.erase(it);
+        return true;
+    }
+    if (chunk.last) {
+        (void) pending.done.send(std::move(pending.bytes));
+        mPending.erase(it);
+    }
+    return true;
+}
+
+auto ClipboardFetches::fail(uint32_t requestId, std::error_code error) -> void {
+    auto it = mPending.find(requestId);
+    if (it == mPending.end()) {
+        return;
+    }
+    (void) it->second.done.send(Err(error));
+    mPending.erase(it);
+}
+
+auto ClipboardFetches::failAll(std::error_code error) -> void {
+    for (auto &[requestId, pending] : mPending) {
+        (void) pending.done.send(Err(error));
+    }
+    mPending.clear();
+}
+
+auto awaitClipboardFetch(ilias::oneshot::Receiver<ClipboardFetches::Result> receiver)
+    -> IoTask<std::vector<std::byte>> {
+    auto result = co_await std::move(receiver);
+    if (!result) {
+        co_return Err(ClipboardError::Disconnected);
+    }
+    co_return std::move(*result);
+}
+
+// MARK: Streaming
+
+auto sendClipboardData(
+    OutboundSender bulk,
+    uint32_t requestId,
+    IoResult<std::vector<std::byte>> bytes
+) -> Task<void> {
+    if (!bytes) {
+        (void) co_await bulk.send(RpcMessage {ClipboardDataMessage {
+            .requestId = requestId,
+            .last = true,
+            .error = bytes.error().message(),
+        }});
+        co_return;
+    }
+
+    // Base64 runs on a worker, a chunk at a time. The worker shares the bytes
+    // because this coroutine is cancelled when the connection goes away.
+    auto shared = std::make_shared<const std::vector<std::byte>>(std::move(*bytes));
+    auto offset = uint64_t {0};
+    while (true) {
+        auto chunk = co_await workerPool().submit([shared, requestId, offset] {
+            return makeClipboardChunk(requestId, *shared, offset);
+        });
+        if (!chunk) {
+            (void) co_await bulk.send(RpcMessage {ClipboardDataMessage {
+                .requestId = requestId,
+                .last = true,
+                .error = chunk.error().message(),
+            }});
+            co_return;
+        }
+        const auto last = chunk->last;
+        offset += kClipboardChunkBytes;
+        if (!co_await bulk.send(RpcMessage {std::move(*chunk)})) {
+            // Connection gone; the requester fails its fetch on its own.
+            co_return;
+        }
+        if (last) {
+            co_return;
+        }
+    }
+}
+
+auto nextOutbound(
+    ilias::mpsc::Receiver<RpcMessage> &urgent,
+    ilias::mpsc::Receiver<RpcMessage> &bulk
+) -> Task<std::optional<RpcMessage>> {
+    if (auto message = urgent.tryRecv()) {
+        co_return std::move(*message);
+    }
+    if (auto chunk = bulk.tryRecv()) {
+        co_return std::move(*chunk);
+    }
+    auto [message, chunk] = co_await ilias::whenAny(urgent.recv(), bulk.recv());
+    if (message) {
+        co_return std::move(*message);
+    }
+    if (chunk && *chunk) {
+        co_return std::move(**chunk);
+    }
+    co_return std::nullopt;
+}
+
+MKS_END
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "outbound_queue.hpp"
+#include "refl/this_error.hpp"
+#include "rpc/message.hpp"
+#include <ilias/sync.hpp>
+#include <ilias/sync/oneshot.hpp>
+#include <ilias/task.hpp>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+MKS_BEGIN
+
+enum class ClipboardError {
+    Ok = 0,
+    Unavailable,    // Offer replaced, or its owner is gone
+    TransferFailed, // Out-of-order or undecodable chunk, or the owner reported an error
+    Disconnected,   // The link carrying the transfer dropped
+};
+THIS_ERROR(ClipboardError);
+
+/**
+ * @brief Clipboard chunks queued per connection before the producer waits.
+ *
+ * Chunks only go out while no input is queued, so this bounds how far a
+ * transfer gets ahead of the socket, not how long input waits.
+ */
+inline constexpr size_t kClipboardBulkDepth = 4;
+
+/**
+ * @brief Pastes waiting on a remote clipboard, keyed by request id.
+ *
+ * Chunks are appended as they arrive and the paste resumes once the last one
+ * is in. The owner of the registry picks request ids; they only need to be
+ * unique among its own outstanding requests.
+ */
+class ClipboardFetches {
+public:
+    using Result = IoResult<std::vector<std::byte>>;
+
+    /** @brief Track @p requestId; the returned receiver completes with its bytes. */
+    auto begin(uint32_t requestId) -> ilias::oneshot::Receiver<Result>;
+
+    /**
+     * @brief Feed a reply chunk.
+     *
+     * @return false when @p chunk does not belong to a pending fetch.
+     */
+    auto accept(const ClipboardDataMessage &chunk) -> bool;
+
+    /** @brief Fail one fetch, e.g. when its request could not be sent. */
+    auto fail(uint32_t requestId, std::error_code error) -> void;
+
+    /** @brief Fail every pending fetch, e.g. after the connection dropped. */
+    auto failAll(std::error_code error) -> void;
+
+private:
+    struct Pending {
+        std::vector<std::byte> bytes;
+        ilias::oneshot::Sender<Result> done;
+    };
+
+    std::map<uint32_t, Pending> mPending;
+};
+
+/** @brief Wait for a fetch started with @ref ClipboardFetches::begin. */
+auto awaitClipboardFetch(ilias::oneshot::Receiver<ClipboardFetches::Result> receiver)
+    -> IoTask<std::vector<std::byte>>;
+
+/**
+ * @brief Answer @p requestId with @p bytes, one ClipboardDataMessage at a time.
+ *
+ * Each chunk waits for room in @p bulk, so memory stays bounded by the
+ * channel depth however large the content. A failed read is sent as a
+ * single chunk carrying the error.
+ */
+auto sendClipboardData(
+    OutboundSender bulk,
+    uint32_t requestId,
+    IoResult<std::vector<std::byte>> bytes
+) -> Task<void>;
+
+/**
+ * @brief Next frame for a connection writer.
+ *
+ * Anything queued on @p urgent (input, control, offers) goes first; a
+ * clipboard chunk from @p bulk is only written when @p urgent is empty, so
+ * input never waits behind more than the one chunk already on the wire.
+ * nullopt once @p urgent is closed.
+ */
+auto nextOutbound(
+    ilias::mpsc::Receiver<RpcMessage> &urgent,
+    ilias::mpsc::Receiver<RpcMessage> &bulk
+) -> Task<std::optional<RpcMessage>>;
+
+MKS_END
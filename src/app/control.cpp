@@ -0,0 +1,141 @@
+#include "control.hpp"
+#include "idle.hpp"
+#include "diag/flight_recorder.hpp"
+#include "diag/metrics.hpp"
+#include "rpc/transport.hpp"
+
+#include <exception>
+#include <system_error>
+#include <utility>
+
+MKS_BEGIN
+
+using ilias::TaskScope;
+
+ControlService::ControlService(std::optional<IPEndpoint> endpoint) : mEndpoint(endpoint) {
+    addCommand("stats", []() {
+        return formatMetrics(metrics().snapshot());
+    });
+    // Replies with the dump path so the caller can decode it locally.
+    addCommand("flight-dump", []() {
+        auto path = flightDumpPath();
+        if (auto dumped = dumpFlightRecorder(path); !dumped) {
+            throw std::system_error(dumped.error(), path.string());
+        }
+        return std::filesystem::absolute(path).string();
+    });
+}
+
+auto ControlService::addCommand(std::string name, Handler handler) -> void {
+    mHandlers.insert_or_assign(std::move(name), std::move(handler));
+}
+
+auto ControlService::run() -> IoTask<void> {
+    if (!mEndpoint) {
+        SPDLOG_INFO("Control socket disabled");
+        co_await idleUntilCancelled();
+        co_return {};
+    }
+    auto listener = co_await TcpListener::bind(*mEndpoint);
+    if (!listener) {
+        SPDLOG_WARN(
+            "Control socket disabled, failed to bind {}: {}",
+            *mEndpoint,
+            listener.error().message()
+        );
+        co_await idleUntilCancelled();
+        co_return {};
+    }
+    SPDLOG_INFO("Control socket listening on {}", *mEndpoint);
+
+    co_await TaskScope::enter([&](auto &scope) -> Task<void> {
+        while (true) {
+            auto incoming = co_await listener->accept();
+            if (!incoming) {
+                SPDLOG_ERROR("Control socket failed to accept: {}", incoming.error().message());
+                co_return;
+            }
+            auto &[sock, endpoint] = *incoming;
+            SPDLOG_TRACE("Control socket accepted {}", endpoint);
+            scope.spawn(handleConnection(std::move(sock)));
+        }
+    });
+    co_await idleUntilCancelled();
+    co_return {};
+}
+
+auto ControlService::handleConnection(TcpStream stream) -> IoTask<void> {
+    RpcTransport transport {std::move(stream)};
+    while (true) {
+        auto message = co_await transport.readMessage();
+        if (!message) {
+            // EOF after the last request is the normal way a query ends.
+            break;
+        }
+        auto request = std::get_if<ControlRequestMessage>(&*message);
+        if (!request) {
+            SPDLOG_WARN("Control socket received unexpected message {}", *message);
+            break;
+        }
+        auto reply = dispatch(request->command);
+        if (auto written = co_await transport.writeMessage(RpcMessage {std::move(reply)}); !written) {
+            break;
+        }
+    }
+    (void) co_await transport.shutdown();
+    transport.close();
+    co_return {};
+}
+
+auto ControlService::dispatch(std::string_view command) const -> ControlReplyMessage {
+    auto it = mHandlers.find(command);
+    if (it == mHandlers.end()) {
+        auto known = std::string {};
+        for (const auto &[name, _] : mHandlers) {
+            known += known.empty() ? name : ", " + name;
+        }
+        return ControlReplyMessage {
+            .ok = false,
+            .body = fmtlib::format("unknown command '{}', expected one of: {}", command, known),
+        };
+    }
+    try {
+        return ControlReplyMessage {.ok = true, .body = it->second()};
+    }
+    catch (const std::exception &error) {
+        return ControlReplyMessage {.ok = false, .body = error.what()};
+    }
+}
+
+auto resolveControlEndpoint(std::string_view value, std::string_view fallback)
+    -> IoResult<std::optional<IPEndpoint>> {
+    if (value == "off") {
+        return std::nullopt;
+    }
+    auto text = std::string {value.empty() ? fallback : value};
+    auto endpoint = IPEndpoint::fromString(text);
+    if (!endpoint) {
+        SPDLOG_ERROR("Invalid control endpoint: {}", text);
+        return Err(std::make_error_code(std::errc::invalid_argument));
+    }
+    return std::optional<IPEndpoint> {*endpoint};
+}
+
+auto queryControl(IPEndpoint endpoint, std::string command) -> IoTask<ControlReplyMessage> {
+    ILIAS_CO_TRY(auto stream, co_await TcpStream::connect(endpoint));
+    RpcTransport transport {std::move(stream)};
+    ILIAS_CO_TRYV(co_await transport.writeMessage(RpcMessage {ControlRequestMessage {
+        .command = std::move(command),
+    }}));
+    ILIAS_CO_TRY(auto message, co_await transport.readMessage());
+    (void) co_await transport.shutdown();
+    transport.close();
+
+    auto reply = std::get_if<ControlReplyMessage>(&message);
+    if (!reply) {
+        co_return Err(RpcError::ProtocolError);
+    }
+    co_return std::move(*reply);
+}
+
+MKS_END
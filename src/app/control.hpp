@@ -0,0 +1,73 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "rpc/message.hpp"
+#include <functional>
+#include <ilias/net.hpp>
+#include <ilias/task.hpp>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+MKS_BEGIN
+
+using ilias::IPEndpoint;
+using ilias::TcpListener;
+using ilias::TcpStream;
+
+/** Default loopback control endpoints, one per role so both can share a host. */
+inline constexpr std::string_view kServerControlEndpoint = "127.0.0.1:24860";
+inline constexpr std::string_view kClientControlEndpoint = "127.0.0.1:24861";
+
+/**
+ * @brief Local diagnostic socket answering @c ControlRequestMessage queries.
+ *
+ * Uses the regular RPC framing on a loopback listener. Each command is a
+ * table entry (name → handler) so roles can add their own queries without
+ * touching the accept/dispatch code. @c "stats" and @c "flight-dump" are
+ * always registered.
+ *
+ * Non-responsibilities:
+ * - Authentication: bind to loopback only; anything that can reach the port
+ *   can read the counters.
+ */
+class ControlService {
+public:
+    /** Produces the reply body; thrown exceptions become an error reply. */
+    using Handler = std::function<std::string()>;
+
+    /** @param endpoint Listen address; nullopt keeps the service disabled. */
+    explicit ControlService(std::optional<IPEndpoint> endpoint);
+
+    /** @brief Register or replace the handler for @p name. */
+    auto addCommand(std::string name, Handler handler) -> void;
+
+    /**
+     * @brief Serve until cancelled.
+     *
+     * A disabled service or a failed bind only turns diagnostics off, so the
+     * task keeps waiting instead of tearing down the role it runs beside.
+     */
+    auto run() -> IoTask<void>;
+
+private:
+    auto handleConnection(TcpStream stream) -> IoTask<void>;
+    auto dispatch(std::string_view command) const -> ControlReplyMessage;
+
+    std::optional<IPEndpoint> mEndpoint;
+    std::map<std::string, Handler, std::less<>> mHandlers;
+};
+
+/**
+ * @brief Resolve a `--control` option value.
+ *
+ * Empty selects @p fallback, @c "off" disables the socket (returns nullopt).
+ */
+auto resolveControlEndpoint(std::string_view value, std::string_view fallback)
+    -> IoResult<std::optional<IPEndpoint>>;
+
+/** @brief Send one command to a ControlService and wait for its reply. */
+auto queryControl(IPEndpoint endpoint, std::string command) -> IoTask<ControlReplyMessage>;
+
+MKS_END
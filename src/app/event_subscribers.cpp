@@ -0,0 +1,489 @@
+#include "event_subscribers.hpp"
+#include "idle.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#if defined(__linux__)
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <sys/eventfd.h>
+    #include <sys/mman.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <time.h>
+    #include <unistd.h>
+
+    #include <ilias/net/poller.hpp>
+#endif
+
+MKS_BEGIN
+
+// The layout is the protocol; a change here needs MKS_EVENT_RING_VERSION bumped.
+static_assert(sizeof(mks_event_record) == 128);
+static_assert(sizeof(mks_event_ring_header) == 256);
+static_assert(offsetof(mks_event_ring_header, head) == 64);
+static_assert(offsetof(mks_event_ring_header, tail) == 128);
+static_assert(offsetof(mks_event_ring_header, dropped) == 192);
+static_assert((MKS_EVENT_RING_MAX_CAPACITY & (MKS_EVENT_RING_MAX_CAPACITY - 1)) == 0);
+
+#if defined(__linux__)
+
+namespace {
+
+// Every event is copied once per ring and each ring holds a mapping and two
+// descriptors; this bounds both.
+constexpr auto kMaxSubscribers = size_t {16};
+
+auto lastError() -> std::error_code {
+    return std::error_code(errno, std::generic_category());
+}
+
+/** @brief Closes a descriptor on scope exit. */
+struct OwnedFd {
+    int fd = -1;
+
+    explicit OwnedFd(int value) : fd(value) {}
+    OwnedFd(const OwnedFd &) = delete;
+
+    ~OwnedFd() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+};
+
+auto monotonicNanoseconds() -> uint64_t {
+    auto now = timespec {};
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * 1'000'000'000 + uint64_t(now.tv_nsec);
+}
+
+// NUL-padded and truncated; the record was zeroed, so only the text is written.
+template <size_t N>
+auto copyText(char (&target)[N], mks_string text) -> void {
+    std::memcpy(target, text.data, std::min(text.size, N - 1));
+}
+
+auto unixAddress(const std::filesystem::path &path) -> IoResult<sockaddr_un> {
+    auto address = sockaddr_un {};
+    address.sun_family = AF_UNIX;
+    const auto &native = path.native();
+    if (native.empty() || native.size() >= sizeof address.sun_path) {
+        return Err(std::make_error_code(std::errc::filename_too_long));
+    }
+    std::memcpy(address.sun_path, native.data(), native.size());
+    return address;
+}
+
+// A socket file nothing listens on any more, left behind by a server that crashed.
+auto isStaleSocket(const sockaddr_un &address) -> bool {
+    struct stat info {};
+    if (::lstat(address.sun_path, &info) != 0 || !S_ISSOCK(info.st_mode)) {
+        return false;
+    }
+    auto probe = OwnedFd {::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)};
+    if (probe.fd < 0) {
+        return false;
+    }
+    return ::connect(probe.fd, reinterpret_cast<const sockaddr *>(&address), sizeof address) != 0 &&
+           errno == ECONNREFUSED;
+}
+
+auto listenOn(const std::filesystem::path &path) -> IoResult<int> {
+    ILIAS_TRY(auto address, unixAddress(path));
+    auto socket = OwnedFd {::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)};
+    if (socket.fd < 0) {
+        return Err(lastError());
+    }
+    auto bound = ::bind(socket.fd, reinterpret_cast<const sockaddr *>(&address), sizeof address);
+    if (bound != 0 && errno == EADDRINUSE && isStaleSocket(address)) {
+        ::unlink(address.sun_path);
+        bound = ::bind(socket.fd, reinterpret_cast<const sockaddr *>(&address), sizeof address);
+    }
+    if (bound != 0) {
+        return Err(lastError());
+    }
+    // Connecting needs write access; serve() also checks the peer's uid.
+    if (::chmod(address.sun_path, 0600) != 0 || ::listen(socket.fd, SOMAXCONN) != 0) {
+        const auto error = lastError();
+        ::unlink(address.sun_path);
+        return Err(error);
+    }
+    return std::exchange(socket.fd, -1);
+}
+
+// Subscribers run as this user; root may watch anyone.
+auto peerAllowed(int fd) -> bool {
+    auto credentials = ucred {};
+    auto size = socklen_t {sizeof credentials};
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) != 0) {
+        return false;
+    }
+    return credentials.uid == ::geteuid() || credentials.uid == 0;
+}
+
+auto sendReply(int fd, const mks_event_ring_reply &reply, std::span<const int> fds) -> IoResult<void> {
+    auto payload = iovec {.iov_base = const_cast<mks_event_ring_reply *>(&reply), .iov_len = sizeof reply};
+    alignas(cmsghdr) char control[CMSG_SPACE(2 * sizeof(int))] {};
+    auto message = msghdr {};
+    message.msg_iov = &payload;
+    message.msg_iovlen = 1;
+    if (!fds.empty()) {
+        message.msg_control = control;
+        message.msg_controllen = CMSG_SPACE(fds.size_bytes());
+        auto *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(fds.size_bytes());
+        std::memcpy(CMSG_DATA(header), fds.data(), fds.size_bytes());
+    }
+    // The socket's buffer is empty at this point; a reply always fits.
+    if (::sendmsg(fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT) != ssize_t {sizeof reply}) {
+        return Err(lastError());
+    }
+    return {};
+}
+
+/** @brief Runs @c action on scope exit, cancellation included. */
+template <typename F>
+struct OnExit {
+    F action;
+
+    ~OnExit() { action(); }
+};
+
+} // namespace
+
+// MARK: Rings
+
+/** @brief One subscriber's mapping and wakeup descriptor; written only by the event loop thread. */
+struct EventSubscribers::Ring {
+    int memory = -1;
+    int wakeup = -1;
+    void *mapping = nullptr;
+    size_t size = 0;
+    mks_event_ring_header *header = nullptr;
+    mks_event_record *records = nullptr;
+    uint64_t mask = 0;
+    uint32_t events = 0;
+    // Ours; header->head is only published, never read back, since the
+    // subscriber can write to the whole mapping.
+    uint64_t head = 0;
+
+    Ring() = default;
+    Ring(const Ring &) = delete;
+
+    ~Ring() {
+        if (mapping) {
+            ::munmap(mapping, size);
+        }
+        if (memory >= 0) {
+            ::close(memory);
+        }
+        if (wakeup >= 0) {
+            ::close(wakeup);
+        }
+    }
+
+    static auto create(uint32_t events, uint32_t capacity) -> IoResult<std::unique_ptr<Ring>> {
+        const auto slots = std::bit_ceil(std::clamp<uint32_t>(
+            capacity == 0 ? MKS_EVENT_RING_DEFAULT_CAPACITY : capacity,
+            1,
+            MKS_EVENT_RING_MAX_CAPACITY
+        ));
+        auto ring = std::make_unique<Ring>();
+        ring->size = sizeof(mks_event_ring_header) + size_t {slots} * sizeof(mks_event_record);
+        ring->memory = ::memfd_create("mksync-events", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (ring->memory < 0 || ::ftruncate(ring->memory, static_cast<off_t>(ring->size)) != 0) {
+            return Err(lastError());
+        }
+        // The subscriber maps the same file. Sealed, it cannot shrink it and
+        // turn our next store into a SIGBUS.
+        if (::fcntl(ring->memory, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+            return Err(lastError());
+        }
+        // Populated up front, so publishing never takes a page fault.
+        auto *mapping =
+            ::mmap(nullptr, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->memory, 0);
+        if (mapping == MAP_FAILED) {
+            return Err(lastError());
+        }
+        ring->mapping = mapping;
+        ring->wakeup = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (ring->wakeup < 0) {
+            return Err(lastError());
+        }
+        // A new memfd reads as zeros: cursors, counter and flag start at 0.
+        ring->header = static_cast<mks_event_ring_header *>(mapping);
+        ring->header->magic = MKS_EVENT_RING_MAGIC;
+        ring->header->version = MKS_EVENT_RING_VERSION;
+        ring->header->record_size = sizeof(mks_event_record);
+        ring->header->capacity = slots;
+        ring->header->events = events;
+        ring->header->records_offset = sizeof(mks_event_ring_header);
+        ring->records = reinterpret_cast<mks_event_record *>(
+            static_cast<std::byte *>(mapping) + ring->header->records_offset
+        );
+        ring->mask = slots - 1;
+        ring->events = events;
+        return ring;
+    }
+
+    auto push(const mks_event_record &record) -> void {
+        const auto tail = std::atomic_ref(header->tail).load(std::memory_order_acquire);
+        // Unsigned, so a tail the subscriber moved past head also reads as full.
+        if (head - tail > mask) {
+            std::atomic_ref(header->dropped).fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        records[head & mask] = record;
+        ++head;
+        // Sequentially consistent with the subscriber's store to waiting and
+        // its last look at head: either it sees this record or we see it waiting.
+        std::atomic_ref(header->head).store(head, std::memory_order_seq_cst);
+        auto waiting = std::atomic_ref(header->waiting);
+        if (waiting.load(std::memory_order_seq_cst) != 0 && waiting.exchange(0) != 0) {
+            const auto one = uint64_t {1};
+            // Only fails once the counter is near overflow, when it is readable anyway.
+            (void) ::write(wakeup, &one, sizeof one);
+        }
+    }
+};
+
+#else
+
+struct EventSubscribers::Ring {
+    uint32_t events = 0;
+};
+
+#endif
+
+// MARK: Construction
+
+EventSubscribers::EventSubscribers(PluginHost &plugins) {
+    static const auto plugin = mks_plugin {
+        .abi_version = MKS_PLUGIN_ABI_VERSION,
+        .name = "event-subscribers",
+        // Nothing until the first subscriber attaches.
+        .events = 0,
+        .create = nullptr,
+        .destroy = nullptr,
+        .on_event = &EventSubscribers::onEvent,
+    };
+    // Built against the same header as the host, so it cannot be refused.
+    auto host = plugins.attach(plugin, this);
+    assert(host);
+    mHost = *host;
+}
+
+EventSubscribers::~EventSubscribers() = default;
+
+auto EventSubscribers::setPath(std::filesystem::path path) -> void {
+    mPath = std::move(path);
+}
+
+auto EventSubscribers::count() const noexcept -> size_t {
+    return mRings.size();
+}
+
+auto EventSubscribers::onEvent(void *instance, const mks_event *event) -> void {
+    static_cast<EventSubscribers *>(instance)->publish(*event);
+}
+
+auto EventSubscribers::updateSubscription() -> void {
+    auto events = uint32_t {0};
+    for (const auto &ring : mRings) {
+        events |= ring->events;
+    }
+    mHost->subscribe(mHost->context, events);
+}
+
+#if defined(__linux__)
+
+// MARK: Events
+
+auto EventSubscribers::publish(const mks_event &event) -> void {
+    auto record = mks_event_record {};
+    record.timestamp_ns = monotonicNanoseconds();
+    record.type = event.type;
+    switch (event.type) {
+        case MKS_EVENT_KEY: record.data.key = *event.data.key; break;
+        case MKS_EVENT_MOUSE_BUTTON: record.data.mouse_button = *event.data.mouse_button; break;
+        case MKS_EVENT_MOUSE_MOVE: record.data.mouse_move = *event.data.mouse_move; break;
+        case MKS_EVENT_MOUSE_WHEEL: record.data.mouse_wheel = *event.data.mouse_wheel; break;
+        case MKS_EVENT_SCREEN_SWITCH: {
+            const auto &view = *event.data.screen_switch;
+            auto &target = record.data.screen_switch;
+            copyText(target.from_owner_id, view.from_owner_id);
+            copyText(target.to_owner_id, view.to_owner_id);
+            target.from_screen_index = view.from_screen_index;
+            target.to_screen_index = view.to_screen_index;
+            target.x = view.x;
+            target.y = view.y;
+            target.to_local = view.to_local;
+            break;
+        }
+        case MKS_EVENT_SESSION_OPENED:
+        case MKS_EVENT_SESSION_CLOSED: {
+            const auto &view = *event.data.session;
+            auto &target = record.data.session;
+            copyText(target.owner_id, view.owner_id);
+            copyText(target.endpoint, view.endpoint);
+            target.resumed = view.resumed;
+            target.suspended = view.suspended;
+            break;
+        }
+        default: return;
+    }
+    for (const auto &ring : mRings) {
+        if (ring->events & event.type) {
+            ring->push(record);
+        }
+    }
+}
+
+// MARK: Connections
+
+auto EventSubscribers::run() -> IoTask<void> {
+    if (mPath.empty()) {
+        co_await idleUntilCancelled();
+        co_return {};
+    }
+    auto listener = listenOn(mPath);
+    if (!listener) {
+        // Like the control socket: losing it must not take the server down.
+        SPDLOG_WARN("Event socket disabled, failed to listen on {}: {}", mPath.string(), listener.error().message());
+        co_await idleUntilCancelled();
+        co_return {};
+    }
+    auto socket = OwnedFd {*listener};
+    auto removeFile = OnExit {[&]() {
+        ::unlink(mPath.c_str());
+    }};
+    ILIAS_CO_TRY(auto poller, co_await ilias::Poller::make(socket.fd, ilias::IoDescriptor::Socket));
+    SPDLOG_INFO("Event socket listening on {}", mPath.string());
+
+    co_await ilias::TaskScope::enter([&](auto &scope) -> Task<void> {
+        while (true) {
+            if (auto ready = co_await poller.poll(POLLIN); !ready) {
+                SPDLOG_ERROR("Event socket failed to poll: {}", ready.error().message());
+                co_return;
+            }
+            const auto fd = ::accept4(socket.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EAGAIN || errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                SPDLOG_ERROR("Event socket failed to accept: {}", lastError().message());
+                co_return;
+            }
+            scope.spawn(serve(fd));
+        }
+    });
+    co_await idleUntilCancelled();
+    co_return {};
+}
+
+auto EventSubscribers::serve(int fd) -> Task<void> {
+    auto socket = OwnedFd {fd};
+    auto poller = co_await ilias::Poller::make(fd, ilias::IoDescriptor::Socket);
+    if (!poller) {
+        SPDLOG_WARN("Event subscriber dropped, failed to poll its socket: {}", poller.error().message());
+        co_return;
+    }
+    if (auto ready = co_await poller->poll(POLLIN); !ready) {
+        co_return;
+    }
+    // SOCK_SEQPACKET: the request arrives whole or not at all.
+    auto request = mks_event_ring_request {};
+    if (::recv(fd, &request, sizeof request, MSG_DONTWAIT) != ssize_t {sizeof request}) {
+        SPDLOG_WARN("Event subscriber sent no valid request");
+        co_return;
+    }
+
+    auto reply = mks_event_ring_reply {.version = MKS_EVENT_RING_VERSION, .status = 0, .size = 0};
+    auto ring = std::unique_ptr<Ring> {};
+    if (request.version != MKS_EVENT_RING_VERSION) {
+        reply.status = EPROTO;
+    }
+    else if (!peerAllowed(fd)) {
+        reply.status = EACCES;
+    }
+    else if (mRings.size() >= kMaxSubscribers) {
+        reply.status = EBUSY;
+    }
+    else if (auto created = Ring::create(request.events & MKS_EVENT_RING_EVENTS, request.capacity); !created) {
+        reply.status = created.error().value();
+    }
+    else {
+        ring = std::move(*created);
+        reply.size = ring->size;
+    }
+    const int fds[] = {ring ? ring->memory : -1, ring ? ring->wakeup : -1};
+    auto sent = sendReply(fd, reply, ring ? std::span<const int> {fds} : std::span<const int> {});
+    if (!sent || !ring) {
+        SPDLOG_WARN(
+            "Event subscriber refused: {}",
+            sent ? std::error_code(reply.status, std::generic_category()).message() : sent.error().message()
+        );
+        co_return;
+    }
+
+    auto *attached = ring.get();
+    mRings.push_back(std::move(ring));
+    updateSubscription();
+    SPDLOG_INFO("Event subscriber attached (events {:#x}, {} records)", attached->events, attached->mask + 1);
+    auto detach = OnExit {[&]() {
+        std::erase_if(mRings, [&](const auto &entry) {
+            return entry.get() == attached;
+        });
+        updateSubscription();
+    }};
+
+    // Nothing more is expected on the socket; it stays open only to say the
+    // subscriber is alive.
+    while (true) {
+        if (auto ready = co_await poller->poll(POLLIN); !ready) {
+            break;
+        }
+        char ignored[64];
+        const auto received = ::recv(fd, ignored, sizeof ignored, MSG_DONTWAIT);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+            break;
+        }
+    }
+    SPDLOG_INFO(
+        "Event subscriber detached, {} records dropped",
+        std::atomic_ref(attached->header->dropped).load(std::memory_order_relaxed)
+    );
+}
+
+#else
+
+auto EventSubscribers::publish(const mks_event &) -> void {}
+
+auto EventSubscribers::run() -> IoTask<void> {
+    if (!mPath.empty()) {
+        SPDLOG_WARN("Event socket {} not served, event subscribers need Linux", mPath.string());
+    }
+    co_await idleUntilCancelled();
+    co_return {};
+}
+
+auto EventSubscribers::serve(int) -> Task<void> {
+    co_return;
+}
+
+#endif
+
+MKS_END
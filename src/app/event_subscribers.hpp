@@ -0,0 +1,70 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "plugin/mks_event_ring.h"
+#include "plugin_host.hpp"
+#include <ilias/task.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+MKS_BEGIN
+
+/**
+ * @brief Hands server events to other local processes through the shared
+ *        memory rings of @c mks_event_ring.h.
+ *
+ * Registered with the server's PluginHost as a built-in plugin, so it sees
+ * events through the same bit test as any plugin: with nobody subscribed its
+ * subscription is 0 and routing pays nothing for it. With subscribers, each
+ * event is converted once into a fixed-layout record and copied into every
+ * ring that asked for it, on the event loop thread; the only system call is
+ * the eventfd write for a subscriber that went to sleep. A full ring drops
+ * the record and counts it, so no subscriber can ever hold up input routing.
+ *
+ * Linux only (memfd, eventfd, SCM_RIGHTS); elsewhere run() logs and returns.
+ *
+ * Non-responsibilities:
+ * - Authentication beyond the local user: the socket is mode 0600 and a
+ *   subscriber running as another user (other than root) is refused. Input
+ *   records include every key pressed.
+ */
+class EventSubscribers {
+public:
+    /** @param plugins Host to observe events through; must outlive this. */
+    explicit EventSubscribers(PluginHost &plugins);
+    EventSubscribers(const EventSubscribers &) = delete;
+    ~EventSubscribers();
+
+    /** @brief Unix socket to listen on; empty (the default) keeps the service off. */
+    auto setPath(std::filesystem::path path) -> void;
+
+    /** @brief Subscribers currently attached. */
+    auto count() const noexcept -> size_t;
+
+    /** @brief Accept subscribers until cancelled; when off, or the socket fails, just waits to be. */
+    auto run() -> IoTask<void>;
+
+    /**
+     * @brief Serve one subscriber on the connected @c SOCK_SEQPACKET socket
+     *        @p fd (non-blocking, owned) until it hangs up.
+     *
+     * run() spawns this for each accepted connection.
+     */
+    auto serve(int fd) -> Task<void>;
+
+private:
+    struct Ring;
+
+    static auto onEvent(void *instance, const mks_event *event) -> void;
+    auto publish(const mks_event &event) -> void;
+    auto updateSubscription() -> void;
+
+    const mks_plugin_host *mHost = nullptr;
+    std::filesystem::path mPath;
+    std::vector<std::unique_ptr<Ring>> mRings;
+};
+
+MKS_END
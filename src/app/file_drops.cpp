@@ -0,0 +1,172 @@
+#include "file_drops.hpp"
+#include "diag/metrics.hpp"
+
+#include <utility>
+
+MKS_BEGIN
+
+using ilias::TaskScope;
+
+namespace {
+
+struct DropMetrics {
+    Counter &offered;
+    Counter &staged;
+    Counter &stored;
+    Counter &discarded;
+};
+
+auto dropMetrics() -> DropMetrics & {
+    static auto result = DropMetrics {
+        .offered = metrics().counter("client.drop.offered"),
+        // Fetches complete on disk; before the drop when the prefetch won.
+        .staged = metrics().counter("client.drop.staged"),
+        .stored = metrics().counter("client.drop.stored"),
+        .discarded = metrics().counter("client.drop.discarded"),
+    };
+    return result;
+}
+
+// Only ever dropped, never sent: waits until the fetch is cancelled.
+auto cancellation(ilias::oneshot::Receiver<bool> receiver) -> Task<void> {
+    (void) co_await std::move(receiver);
+}
+
+} // namespace
+
+FileDrops::FileDrops(FileTransfers &files, Fetch fetch)
+    : mFiles(files),
+      mFetch(std::move(fetch)) {
+}
+
+auto FileDrops::run(ilias::mpsc::Receiver<RpcMessage> &messages) -> Task<void> {
+    // Fetches of a previous connection were cancelled with it.
+    mDrags.clear();
+    mInFlight.clear();
+    co_await TaskScope::enter([&](auto &scope) -> Task<void> {
+        while (auto message = co_await messages.recv()) {
+            if (const auto *end = std::get_if<DragEndMessage>(&*message)) {
+                acceptEnd(*end);
+                continue;
+            }
+            auto *offer = std::get_if<DragOfferMessage>(&*message);
+            if (!offer) {
+                continue;
+            }
+            if (!mAccepting) {
+                SPDLOG_DEBUG("Client ignored dragged {}: drops are off", offer->manifest.name);
+                continue;
+            }
+            // The same file dragged again while its last fetch still runs is
+            // left to that fetch; both would write the same part file.
+            if (mInFlight.contains(offer->transferId)) {
+                continue;
+            }
+            auto &drag = mDrags[offer->dragId];
+            if (drag.files.contains(offer->fileIndex)) {
+                continue;
+            }
+            if (!drag.throttle) {
+                drag.throttle = std::make_shared<BandwidthShare>(mPrefetchRate);
+            }
+            auto [cancel, cancelled] = ilias::oneshot::channel<bool>();
+            auto [decide, decision] = ilias::oneshot::channel<bool>();
+            drag.files.emplace(offer->fileIndex, Pending {
+                .cancel = std::move(cancel),
+                .decision = std::move(decide),
+            });
+            mInFlight.insert(offer->transferId);
+            dropMetrics().offered.add();
+            SPDLOG_INFO(
+                "Client prefetching dragged {} ({} bytes, file {} of {} in drag {})",
+                offer->manifest.name,
+                offer->manifest.size,
+                offer->fileIndex + 1,
+                offer->fileCount,
+                offer->dragId
+            );
+            scope.spawn(prefetch(std::move(*offer), drag.throttle, std::move(cancelled), std::move(decision)));
+        }
+        // The session is gone; what is still fetching stops and cleans up.
+        mDrags.clear();
+    });
+}
+
+auto FileDrops::acceptEnd(const DragEndMessage &end) -> void {
+    auto it = mDrags.find(end.dragId);
+    if (it == mDrags.end()) {
+        return;
+    }
+    if (!end.dropped) {
+        SPDLOG_INFO("Client discarding drag {}: dropped elsewhere", end.dragId);
+        // Closing the senders cancels the fetches; each deletes its part file.
+        mDrags.erase(it);
+        return;
+    }
+    SPDLOG_INFO("Client got the drop of drag {} ({} files)", end.dragId, it->second.files.size());
+    it->second.throttle->setRate(0);
+    for (auto &[index, pending] : it->second.files) {
+        (void) pending.decision.send(true);
+    }
+    if (it->second.files.empty()) {
+        mDrags.erase(it);
+    }
+}
+
+auto FileDrops::prefetch(
+    DragOfferMessage offer,
+    std::shared_ptr<BandwidthShare> throttle,
+    ilias::oneshot::Receiver<bool> cancelled,
+    ilias::oneshot::Receiver<bool> decision
+) -> Task<void> {
+    auto [fetched, stopped] = co_await ilias::whenAny(
+        mFetch(FileFetchMessage {.transferId = offer.transferId}, FileReceiveOptions {
+            .stage = true,
+            .throttle = throttle.get(),
+        }),
+        cancellation(std::move(cancelled))
+    );
+    if (!fetched || !*fetched) {
+        if (fetched) {
+            SPDLOG_WARN("Client failed to fetch dragged {}: {}", offer.manifest.name, fetched->error().message());
+        }
+        dropMetrics().discarded.add();
+        (void) co_await mFiles.discard(mFiles.partPath(offer.transferId));
+        finish(offer);
+        co_return;
+    }
+    dropMetrics().staged.add();
+
+    // Usually still held: the decision comes with the drag's end.
+    auto staged = std::move(**fetched);
+    auto dropped = co_await std::move(decision);
+    if (dropped && *dropped) {
+        auto stored = co_await mFiles.commit(std::move(staged), offer.manifest.name);
+        if (stored) {
+            dropMetrics().stored.add();
+            SPDLOG_INFO("Client stored dropped {} at {}", offer.manifest.name, stored->string());
+        }
+        else {
+            SPDLOG_WARN("Client failed to store dropped {}: {}", offer.manifest.name, stored.error().message());
+        }
+    }
+    else {
+        dropMetrics().discarded.add();
+        (void) co_await mFiles.discard(std::move(staged));
+    }
+    finish(offer);
+}
+
+auto FileDrops::finish(const DragOfferMessage &offer) -> void {
+    mInFlight.erase(offer.transferId);
+    auto it = mDrags.find(offer.dragId);
+    if (it == mDrags.end()) {
+        return;
+    }
+    it->second.files.erase(offer.fileIndex);
+    if (it->second.files.empty()) {
+        mDrags.erase(it);
+    }
+}
+
+MKS_END
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "file_transfer.hpp"
+#include "rpc/message.hpp"
+#include <ilias/sync.hpp>
+#include <ilias/sync/oneshot.hpp>
+#include <ilias/task.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+MKS_BEGIN
+
+/**
+ * @brief Default rate of a fetch that starts before its drop.
+ *
+ * Most drags end somewhere else, so a prefetch must not crowd out the
+ * link; the drop lifts the limit for the rest of the file.
+ */
+inline constexpr uint64_t kDefaultPrefetchRate = 16 * 1024 * 1024;
+
+/**
+ * @brief Client side of file drag-and-drop: fetch dragged files before the drop.
+ *
+ * Every DragOfferMessage starts a throttled fetch of that file on a
+ * connection of its own, staged as a part file next to the downloads. The
+ * DragEndMessage then decides: a drop here lifts the throttle and stores
+ * each file once it is complete; a drop anywhere else cancels the fetches
+ * and deletes what they staged. A large file that was dragged for a moment
+ * before the drop is then mostly on disk already when the button comes up.
+ */
+class FileDrops {
+public:
+    /**
+     * @brief Fetch @p fetch from the server and receive it with @p options.
+     *
+     * Supplied by Client: opens the file connection and hands it to
+     * @ref FileTransfers::receive.
+     */
+    using Fetch = std::function<IoTask<std::filesystem::path>(FileFetchMessage fetch, FileReceiveOptions options)>;
+
+    /** @param files Where drops are staged and stored; must outlive this object. */
+    FileDrops(FileTransfers &files, Fetch fetch);
+    FileDrops(const FileDrops &) = delete;
+
+    /** @brief Whether offers are fetched at all (default true); a refused drag still moves the cursor. */
+    auto setAccepting(bool accepting) noexcept -> void { mAccepting = accepting; }
+    auto accepting() const noexcept -> bool { return mAccepting; }
+
+    /** @brief Rate of a fetch until its drop; 0 fetches at full speed from the start. */
+    auto setPrefetchRate(uint64_t bytesPerSecond) noexcept -> void { mPrefetchRate = bytesPerSecond; }
+
+    /**
+     * @brief Follow DragOfferMessage and DragEndMessage from @p messages.
+     *
+     * Runs for one session connection. Fetches still going when it is
+     * cancelled stop with it; their part files stay and a later drag of the
+     * same file resumes from them.
+     */
+    auto run(ilias::mpsc::Receiver<RpcMessage> &messages) -> Task<void>;
+
+private:
+    /** @brief One offered file; dropping the senders cancels its fetch. */
+    struct Pending {
+        ilias::oneshot::Sender<bool> cancel;
+        // true: store once fetched (a drop here); closed: discard.
+        ilias::oneshot::Sender<bool> decision;
+    };
+
+    struct Drag {
+        std::shared_ptr<BandwidthShare> throttle;
+        // File index → its fetch.
+        std::map<uint32_t, Pending> files;
+    };
+
+    /** @brief Stage @p offer, then store or discard it as the drag's end decides. */
+    auto prefetch(
+        DragOfferMessage offer,
+        std::shared_ptr<BandwidthShare> throttle,
+        ilias::oneshot::Receiver<bool> cancelled,
+        ilias::oneshot::Receiver<bool> decision
+    ) -> Task<void>;
+    auto finish(const DragOfferMessage &offer) -> void;
+    auto acceptEnd(const DragEndMessage &end) -> void;
+
+    FileTransfers &mFiles;
+    Fetch mFetch;
+    bool mAccepting = true;
+    uint64_t mPrefetchRate = kDefaultPrefetchRate;
+    // Drag id → files still fetching or waiting for the drop.
+    std::map<uint32_t, Drag> mDrags;
+    // Transfer ids being fetched; each has one part file, so one fetch at a time.
+    std::set<std::string, std::less<>> mInFlight;
+};
+
+MKS_END
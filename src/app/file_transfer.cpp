@@ -0,0 +1,1198 @@
+#include "file_transfer.hpp"
+#include "core/file_delta.hpp"
+#include "diag/metrics.hpp"
+#include "rpc/transport.hpp"
+#include "thread_tuning.hpp"
+#include "worker_pool.hpp"
+
+#include <ilias/sync/oneshot.hpp>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MKS_BEGIN
+
+THIS_ERROR_IMPL(FileTransferError);
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+// Bytes of the new file one delta job matches; a window of them runs at once.
+constexpr uint64_t kDeltaRangeBytes = 8 * 1024 * 1024;
+
+struct TransferMetrics {
+    Counter &bytesSent;
+    Counter &bytesReceived;
+    Counter &chunksReused;
+    Counter &filesSent;
+    Counter &filesReceived;
+    Counter &deltas;
+    Counter &deltaBytesReused;
+};
+
+auto transferMetrics() -> TransferMetrics & {
+    static auto result = TransferMetrics {
+        .bytesSent = metrics().counter("transfer.bytes_sent"),
+        .bytesReceived = metrics().counter("transfer.bytes_received"),
+        .chunksReused = metrics().counter("transfer.chunks_reused"),
+        .filesSent = metrics().counter("transfer.files_sent"),
+        .filesReceived = metrics().counter("transfer.files_received"),
+        .deltas = metrics().counter("transfer.deltas"),
+        // Bytes receivers copied from their older version instead of reading them off the wire.
+        .deltaBytesReused = metrics().counter("transfer.delta_bytes_reused"),
+    };
+    return result;
+}
+
+auto lastError() -> std::error_code {
+#if defined(_WIN32)
+    return std::error_code(static_cast<int>(::GetLastError()), std::system_category());
+#else
+    return std::error_code(errno, std::generic_category());
+#endif
+}
+
+// MARK: Files
+
+/**
+ * @brief Read-only view of a whole file for the sender.
+ *
+ * Chunks are written to the socket straight from the mapping.
+ */
+class MappedFile {
+public:
+    static auto open(const std::filesystem::path &path) -> IoResult<std::shared_ptr<MappedFile>> {
+        auto error = std::error_code {};
+        if (!std::filesystem::is_regular_file(path, error)) {
+            return Err(error ? error : make_error_code(FileTransferError::NotAFile));
+        }
+        const auto size = std::filesystem::file_size(path, error);
+        if (error) {
+            return Err(error);
+        }
+        auto file = std::make_shared<MappedFile>();
+        if (size == 0) {
+            // Nothing to map; an empty file is offered with no chunks.
+            return file;
+        }
+#if defined(_WIN32)
+        auto handle = ::CreateFileW(
+            path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr
+        );
+        if (handle == INVALID_HANDLE_VALUE) {
+            return Err(lastError());
+        }
+        auto mapping = ::CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        ::CloseHandle(handle);
+        if (!mapping) {
+            return Err(lastError());
+        }
+        auto *view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        ::CloseHandle(mapping);
+        if (!view) {
+            return Err(lastError());
+        }
+#else
+        const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return Err(lastError());
+        }
+        auto *view = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED) {
+            return Err(lastError());
+        }
+        (void) ::madvise(view, size, MADV_SEQUENTIAL);
+#endif
+        file->mData = static_cast<const std::byte *>(view);
+        file->mSize = size;
+        return file;
+    }
+
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        if (!mData) {
+            return;
+        }
+#if defined(_WIN32)
+        ::UnmapViewOfFile(mData);
+#else
+        ::munmap(const_cast<std::byte *>(mData), mSize);
+#endif
+    }
+
+    auto bytes() const noexcept -> std::span<const std::byte> {
+        return {mData, static_cast<size_t>(mSize)};
+    }
+
+    /**
+     * @brief Fault @p range in, on the calling (disk) thread.
+     *
+     * A socket write from a cold mapping would otherwise block the event
+     * loop on the disk inside the kernel.
+     */
+    auto pageIn(std::span<const std::byte> range) const noexcept -> void {
+        if (range.empty()) {
+            return;
+        }
+#if !defined(_WIN32)
+        const auto begin = reinterpret_cast<uintptr_t>(range.data()) & ~(uintptr_t {kPageSize} - 1);
+        (void) ::madvise(
+            reinterpret_cast<void *>(begin),
+            reinterpret_cast<uintptr_t>(range.data()) + range.size() - begin,
+            MADV_WILLNEED
+        );
+#endif
+        auto sum = uint8_t {0};
+        for (auto offset = size_t {0}; offset < range.size(); offset += kPageSize) {
+            sum ^= std::to_integer<uint8_t>(*static_cast<const volatile std::byte *>(range.data() + offset));
+        }
+        (void) sum;
+    }
+
+private:
+    const std::byte *mData = nullptr;
+    uint64_t mSize = 0;
+};
+
+/**
+ * @brief The receiver's part file, written at chunk offsets.
+ */
+class PartFile {
+public:
+    static auto open(const std::filesystem::path &path) -> IoResult<std::shared_ptr<PartFile>> {
+        auto file = std::make_shared<PartFile>();
+#if defined(_WIN32)
+        file->mHandle = ::CreateFileW(
+            path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr
+        );
+        if (file->mHandle == INVALID_HANDLE_VALUE) {
+            return Err(lastError());
+        }
+#else
+        file->mFd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (file->mFd < 0) {
+            return Err(lastError());
+        }
+#endif
+        return file;
+    }
+
+    PartFile() = default;
+    PartFile(const PartFile &) = delete;
+
+    ~PartFile() {
+#if defined(_WIN32)
+        if (mHandle != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(mHandle);
+        }
+#else
+        if (mFd >= 0) {
+            ::close(mFd);
+        }
+#endif
+    }
+
+    auto size() const -> IoResult<uint64_t> {
+#if defined(_WIN32)
+        auto size = LARGE_INTEGER {};
+        if (!::GetFileSizeEx(mHandle, &size)) {
+            return Err(lastError());
+        }
+        return static_cast<uint64_t>(size.QuadPart);
+#else
+        struct stat info {};
+        if (::fstat(mFd, &info) != 0) {
+            return Err(lastError());
+        }
+        return static_cast<uint64_t>(info.st_size);
+#endif
+    }
+
+    /** @brief Make the file exactly @p size bytes with its blocks reserved up front. */
+    auto preallocate(uint64_t size) -> IoResult<void> {
+#if defined(_WIN32)
+        auto end = LARGE_INTEGER {};
+        end.QuadPart = static_cast<LONGLONG>(size);
+        if (!::SetFilePointerEx(mHandle, end, nullptr, FILE_BEGIN) || !::SetEndOfFile(mHandle)) {
+            return Err(lastError());
+        }
+#else
+        if (::ftruncate(mFd, static_cast<off_t>(size)) != 0) {
+            return Err(lastError());
+        }
+        if (size == 0) {
+            return {};
+        }
+        // Filesystems without fallocate keep the sparse file; writes fill it.
+        const auto result = ::posix_fallocate(mFd, 0, static_cast<off_t>(size));
+        if (result != 0 && result != EOPNOTSUPP && result != EINVAL) {
+            return Err(std::error_code(result, std::generic_category()));
+        }
+#endif
+        return {};
+    }
+
+    auto readAt(uint64_t offset, std::span<std::byte> bytes) const -> IoResult<void> {
+        while (!bytes.empty()) {
+#if defined(_WIN32)
+            auto overlapped = OVERLAPPED {};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            auto done = DWORD {0};
+            const auto request = static_cast<DWORD>(std::min<size_t>(bytes.size(), 1U << 30));
+            if (!::ReadFile(mHandle, bytes.data(), request, &done, &overlapped)) {
+                return Err(lastError());
+            }
+            const auto count = static_cast<size_t>(done);
+#else
+            const auto count = ::pread(mFd, bytes.data(), bytes.size(), static_cast<off_t>(offset));
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count < 0) {
+                return Err(lastError());
+            }
+#endif
+            if (count == 0) {
+                return Err(std::make_error_code(std::errc::io_error));
+            }
+            offset += static_cast<uint64_t>(count);
+            bytes = bytes.subspan(static_cast<size_t>(count));
+        }
+        return {};
+    }
+
+    auto writeAt(uint64_t offset, std::span<const std::byte> bytes) -> IoResult<void> {
+        while (!bytes.empty()) {
+#if defined(_WIN32)
+            auto overlapped = OVERLAPPED {};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            auto done = DWORD {0};
+            const auto request = static_cast<DWORD>(std::min<size_t>(bytes.size(), 1U << 30));
+            if (!::WriteFile(mHandle, bytes.data(), request, &done, &overlapped)) {
+                return Err(lastError());
+            }
+            const auto count = static_cast<size_t>(done);
+#else
+            const auto count = ::pwrite(mFd, bytes.data(), bytes.size(), static_cast<off_t>(offset));
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count < 0) {
+                return Err(lastError());
+            }
+#endif
+            offset += static_cast<uint64_t>(count);
+            bytes = bytes.subspan(static_cast<size_t>(count));
+        }
+        return {};
+    }
+
+private:
+#if defined(_WIN32)
+    HANDLE mHandle = INVALID_HANDLE_VALUE;
+#else
+    int mFd = -1;
+#endif
+};
+
+// A name from the wire must stay inside the download directory.
+auto isPlainFileName(std::string_view name) -> bool {
+    if (name.empty() || name == "." || name == ".." || name.size() > 255) {
+        return false;
+    }
+    return name.find_first_of(std::string_view {"/\\:\0", 4}) == std::string_view::npos;
+}
+
+auto validateManifest(const FileOfferMessage &offer) -> bool {
+    const auto &manifest = offer.manifest;
+    if (!isPlainFileName(manifest.name)) {
+        return false;
+    }
+    if (manifest.size > 0 && manifest.chunkSize == 0) {
+        return false;
+    }
+    return manifest.chunkHashes.size() == fileChunkCount(manifest) &&
+        manifest.chunkHashes.size() <= kMaxFileChunks &&
+        offer.transferId == fileTransferId(manifest);
+}
+
+// "name (1).ext", "name (2).ext", ... next to an existing @p target.
+auto freePath(const std::filesystem::path &target) -> std::filesystem::path {
+    auto error = std::error_code {};
+    if (!std::filesystem::exists(target, error)) {
+        return target;
+    }
+    const auto stem = target.stem().string();
+    const auto extension = target.extension().string();
+    for (auto index = 1;; ++index) {
+        auto candidate = target.parent_path() / fmtlib::format("{} ({}){}", stem, index, extension);
+        if (!std::filesystem::exists(candidate, error)) {
+            return candidate;
+        }
+    }
+}
+
+/**
+ * @brief Checks a file written front to back against its manifest.
+ *
+ * A delta rebuilds the file in order, so each chunk hash is complete the
+ * moment the chunk is, without reading the file back.
+ */
+class ChunkVerifier {
+public:
+    explicit ChunkVerifier(const FileManifest &manifest)
+        : mChunkSize(manifest.chunkSize),
+          mSize(manifest.size),
+          mHashes(manifest.chunkHashes) {
+    }
+
+    auto update(std::span<const std::byte> bytes) -> void {
+        while (!bytes.empty() && mPosition < mSize) {
+            const auto chunkEnd = std::min<uint64_t>(uint64_t {mIndex + 1} * mChunkSize, mSize);
+            const auto take = static_cast<size_t>(std::min<uint64_t>(bytes.size(), chunkEnd - mPosition));
+            mHash.update(bytes.first(take));
+            mPosition += take;
+            bytes = bytes.subspan(take);
+            if (mPosition == chunkEnd) {
+                if (mHash.digest() != mHashes[mIndex]) {
+                    mCorrupted.push_back(mIndex);
+                }
+                mHash = XxHash64 {};
+                ++mIndex;
+            }
+        }
+    }
+
+    auto corrupted() const noexcept -> const std::vector<uint32_t> & { return mCorrupted; }
+
+private:
+    uint64_t mChunkSize = 0;
+    uint64_t mSize = 0;
+    std::vector<uint64_t> mHashes;
+    uint64_t mPosition = 0;
+    uint32_t mIndex = 0;
+    XxHash64 mHash;
+    std::vector<uint32_t> mCorrupted;
+};
+
+/**
+ * @brief Run @p fn(0) ... @p fn(count - 1) on the worker pool at once.
+ *
+ * WorkerPool::submit() runs one job per await; this posts them all first,
+ * so they spread over the workers, and collects the results in order.
+ * @p fn is shared by the jobs and must only read what it captured.
+ */
+template <typename Fn>
+auto runParallel(size_t count, Fn fn) -> IoTask<std::vector<std::invoke_result_t<Fn &, size_t>>> {
+    using Result = std::invoke_result_t<Fn &, size_t>;
+    auto shared = std::make_shared<Fn>(std::move(fn));
+    auto receivers = std::vector<ilias::oneshot::Receiver<Result>> {};
+    receivers.reserve(count);
+    for (auto job = size_t {0}; job < count; ++job) {
+        auto [sender, receiver] = ilias::oneshot::channel<Result>();
+        workerPool().post([shared, job, sender = std::move(sender)]() mutable {
+            (void) sender.send((*shared)(job));
+        });
+        receivers.push_back(std::move(receiver));
+    }
+    auto results = std::vector<Result> {};
+    results.reserve(count);
+    for (auto &receiver : receivers) {
+        auto result = co_await std::move(receiver);
+        if (!result) {
+            co_return Err(std::make_error_code(std::errc::operation_canceled));
+        }
+        results.push_back(std::move(*result));
+    }
+    co_return results;
+}
+
+// Writes @p bytes raw in slices, each waiting for its share of @p bandwidth.
+auto writeSlices(RpcTransport &transport, BandwidthShare &bandwidth, std::span<const std::byte> bytes) -> IoTask<void> {
+    for (auto offset = size_t {0}; offset < bytes.size(); offset += kFileSliceBytes) {
+        const auto slice = bytes.subspan(offset, std::min(kFileSliceBytes, bytes.size() - offset));
+        co_await bandwidth.reserve(slice.size());
+        ILIAS_CO_TRYV(co_await transport.writeRaw(slice));
+        transferMetrics().bytesSent.add(slice.size());
+    }
+    co_return {};
+}
+
+// The receiver's FileCompleteMessage that ends every transfer.
+auto readCompletion(RpcTransport &transport, const FileOfferMessage &offer) -> IoTask<void> {
+    ILIAS_CO_TRY(auto reply, co_await transport.readMessage());
+    const auto *complete = std::get_if<FileCompleteMessage>(&reply);
+    if (!complete || complete->transferId != offer.transferId) {
+        SPDLOG_ERROR("File transfer {} expected completion, got {}", offer.transferId, reply);
+        co_return Err(RpcError::ProtocolError);
+    }
+    if (!complete->error.empty()) {
+        SPDLOG_WARN("File transfer {} of {} failed remotely: {}", offer.transferId, offer.manifest.name, complete->error);
+        co_return Err(FileTransferError::Corrupted);
+    }
+    transferMetrics().filesSent.add();
+    co_return {};
+}
+
+} // namespace
+
+// MARK: Disk thread
+
+/**
+ * @brief Runs blocking file work in order on its own thread.
+ *
+ * Jobs own everything they touch (shared_ptr buffers and files), so a
+ * transfer cancelled while a job is queued leaves nothing dangling.
+ */
+class FileTransfers::DiskThread {
+public:
+    DiskThread() : mThread([this](std::stop_token token) { loop(std::move(token)); }) {}
+
+    /** @brief Run @p job there; it returns an IoResult, which comes back here. */
+    template <typename Fn>
+    auto run(Fn fn) -> Task<std::invoke_result_t<Fn &>> {
+        using Result = std::invoke_result_t<Fn &>;
+        auto [sender, receiver] = ilias::oneshot::channel<Result>();
+        post([fn = std::move(fn), sender = std::move(sender)]() mutable {
+            (void) sender.send(fn());
+        });
+        auto result = co_await std::move(receiver);
+        if (!result) {
+            co_return Result {Err(std::make_error_code(std::errc::operation_canceled))};
+        }
+        co_return std::move(*result);
+    }
+
+private:
+    using Job = std::move_only_function<void()>;
+
+    auto post(Job job) -> void {
+        {
+            auto lock = std::scoped_lock {mMutex};
+            mJobs.push_back(std::move(job));
+        }
+        mWake.notify_one();
+    }
+
+    auto loop(std::stop_token token) -> void {
+        resetThreadTuning();
+        while (true) {
+            auto job = Job {};
+            {
+                auto lock = std::unique_lock {mMutex};
+                if (!mWake.wait(lock, token, [this] { return !mJobs.empty(); })) {
+                    return;
+                }
+                job = std::move(mJobs.front());
+                mJobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable_any mWake;
+    std::deque<Job> mJobs;
+    std::jthread mThread; // Last, so it stops before the queue goes away
+};
+
+// MARK: Bandwidth
+
+auto BandwidthShare::reserve(uint64_t bytes) -> Task<void> {
+    if (mRate == 0) {
+        co_return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    const auto start = std::max(now, mNextFree);
+    mNextFree = start + std::chrono::nanoseconds {bytes * 1'000'000'000ULL / mRate};
+    if (start > now) {
+        co_await ilias::sleep(std::chrono::ceil<std::chrono::milliseconds>(start - now));
+    }
+}
+
+// MARK: Transfers
+
+FileTransfers::FileTransfers()
+    : mDisk(std::make_unique<DiskThread>()),
+      mDirectory(defaultDownloadDirectory()) {
+}
+
+FileTransfers::~FileTransfers() = default;
+
+auto FileTransfers::setDirectory(std::filesystem::path directory) -> void {
+    mDirectory = std::move(directory);
+}
+
+auto FileTransfers::partPath(std::string_view transferId) const -> std::filesystem::path {
+    // Named by transfer id: only the same content ever resumes into it.
+    return mDirectory / fmtlib::format(".{}.mkspart", transferId);
+}
+
+auto FileTransfers::makeOffer(std::filesystem::path path, FileSendOptions options) -> IoTask<FileOfferMessage> {
+    ILIAS_CO_TRY(auto manifest, co_await mDisk->run([path]() -> IoResult<FileManifest> {
+        auto file = MappedFile::open(path);
+        if (!file) {
+            return Err(file.error());
+        }
+        const auto bytes = (*file)->bytes();
+        auto manifest = FileManifest {
+            .name = path.filename().string(),
+            .size = bytes.size(),
+            .chunkSize = fileChunkSize(bytes.size()),
+        };
+        for (auto offset = size_t {0}; offset < bytes.size(); offset += manifest.chunkSize) {
+            const auto length = std::min<size_t>(manifest.chunkSize, bytes.size() - offset);
+            manifest.chunkHashes.push_back(xxhash64(bytes.subspan(offset, length)));
+        }
+        return manifest;
+    }));
+    auto transferId = fileTransferId(manifest);
+    co_return FileOfferMessage {
+        .transferId = std::move(transferId),
+        .manifest = std::move(manifest),
+        .replace = options.replace,
+    };
+}
+
+auto FileTransfers::send(RpcTransport &transport, std::filesystem::path path, const FileOfferMessage &offer)
+    -> IoTask<FileTransferStats> {
+    const auto &manifest = offer.manifest;
+    ILIAS_CO_TRY(auto message, co_await transport.readMessage());
+    if (const auto *error = std::get_if<ErrorMessage>(&message)) {
+        SPDLOG_WARN("File transfer {} refused at handshake: {}", offer.transferId, error->message);
+        co_return Err(RpcError::Rejected);
+    }
+    if (auto *signature = std::get_if<FileSignatureMessage>(&message)) {
+        co_return co_await sendDelta(transport, std::move(path), offer, std::move(*signature));
+    }
+    const auto *accept = std::get_if<FileAcceptMessage>(&message);
+    if (!accept || accept->transferId != offer.transferId) {
+        SPDLOG_ERROR("File transfer {} expected an accept, got {}", offer.transferId, message);
+        co_return Err(RpcError::ProtocolError);
+    }
+    if (!accept->error.empty()) {
+        SPDLOG_WARN("File transfer {} of {} refused: {}", offer.transferId, manifest.name, accept->error);
+        co_return Err(FileTransferError::Rejected);
+    }
+    for (auto index : accept->chunks) {
+        if (index >= manifest.chunkHashes.size()) {
+            co_return Err(RpcError::ProtocolError);
+        }
+    }
+
+    ILIAS_CO_TRY(auto file, co_await mDisk->run([path] { return MappedFile::open(path); }));
+    if (file->bytes().size() != manifest.size) {
+        co_return Err(FileTransferError::Changed);
+    }
+    auto chunkBytes = [&](uint32_t index) {
+        return file->bytes().subspan(uint64_t {index} * manifest.chunkSize, fileChunkLength(manifest, index));
+    };
+    auto pageIn = [&](uint32_t index) {
+        return mDisk->run([file, range = chunkBytes(index)]() -> IoResult<void> {
+            file->pageIn(range);
+            return {};
+        });
+    };
+    auto writeChunk = [&](std::span<const std::byte> chunk) {
+        return writeSlices(transport, mBandwidth, chunk);
+    };
+
+    auto stats = FileTransferStats {
+        .reusedChunks = static_cast<uint32_t>(manifest.chunkHashes.size() - accept->chunks.size()),
+    };
+    SPDLOG_INFO(
+        "Sending {} ({} bytes, {} of {} chunks) as transfer {}",
+        manifest.name,
+        manifest.size,
+        accept->chunks.size(),
+        manifest.chunkHashes.size(),
+        offer.transferId
+    );
+    const auto &chunks = accept->chunks;
+    if (!chunks.empty()) {
+        ILIAS_CO_TRYV(co_await pageIn(chunks.front()));
+    }
+    for (auto position = size_t {0}; position < chunks.size(); ++position) {
+        const auto chunk = chunkBytes(chunks[position]);
+        // The next chunk pages in while this one is on the wire.
+        if (position + 1 < chunks.size()) {
+            auto [written, paged] = co_await ilias::whenAll(writeChunk(chunk), pageIn(chunks[position + 1]));
+            ILIAS_CO_TRYV(written);
+            ILIAS_CO_TRYV(paged);
+        }
+        else {
+            ILIAS_CO_TRYV(co_await writeChunk(chunk));
+        }
+        stats.bytes += chunk.size();
+        stats.chunks += 1;
+    }
+    ILIAS_CO_TRYV(co_await readCompletion(transport, offer));
+    co_return stats;
+}
+
+auto FileTransfers::sendDelta(
+    RpcTransport &transport,
+    std::filesystem::path path,
+    const FileOfferMessage &offer,
+    FileSignatureMessage first
+) -> IoTask<FileTransferStats> {
+    const auto &manifest = offer.manifest;
+    const auto blockCount = deltaBlockCount(first.basisSize, first.blockSize);
+    if (first.blockSize < kMinDeltaBlockSize || first.blockSize > kMaxDeltaBlockSize || blockCount > kMaxDeltaBlocks) {
+        SPDLOG_ERROR("File transfer {} got an unusable signature: {} blocks of {}", offer.transferId, blockCount, first.blockSize);
+        co_return Err(RpcError::ProtocolError);
+    }
+    auto signature = FileSignature {
+        .blockSize = first.blockSize,
+        .basisSize = first.basisSize,
+    };
+    auto message = RpcMessage {std::move(first)};
+    while (true) {
+        auto *part = std::get_if<FileSignatureMessage>(&message);
+        if (!part || part->transferId != offer.transferId || part->blockSize != signature.blockSize ||
+            part->basisSize != signature.basisSize || part->weak.size() != part->strong.size() ||
+            signature.weak.size() + part->weak.size() > blockCount) {
+            SPDLOG_ERROR("File transfer {} expected its signature, got {}", offer.transferId, message);
+            co_return Err(RpcError::ProtocolError);
+        }
+        signature.weak.insert(signature.weak.end(), part->weak.begin(), part->weak.end());
+        signature.strong.insert(signature.strong.end(), part->strong.begin(), part->strong.end());
+        if (part->last) {
+            break;
+        }
+        ILIAS_CO_TRY(auto next, co_await transport.readMessage());
+        message = std::move(next);
+    }
+    if (signature.weak.size() != blockCount) {
+        co_return Err(RpcError::ProtocolError);
+    }
+
+    ILIAS_CO_TRY(auto file, co_await mDisk->run([path] { return MappedFile::open(path); }));
+    if (file->bytes().size() != manifest.size) {
+        co_return Err(FileTransferError::Changed);
+    }
+    ILIAS_CO_TRY(auto index, co_await workerPool().submit([signature = std::move(signature)]() mutable {
+        return std::make_shared<const FileSignatureIndex>(std::move(signature));
+    }));
+
+    // The file is diffed in ranges, a window of them at a time on the worker
+    // pool; the next window is diffed while this one is on the wire.
+    const auto size = manifest.size;
+    const auto rangeBytes = std::max<uint64_t>(kDeltaRangeBytes / index->blockSize(), 16) * index->blockSize();
+    const auto rangeCount = (size + rangeBytes - 1) / rangeBytes;
+    const auto window = std::max<uint64_t>(workerPool().size(), 1);
+    auto diffWindow = [&](uint64_t firstRange) {
+        const auto count = std::min(window, rangeCount - firstRange);
+        return runParallel(count, [file, index, firstRange, rangeBytes, size](size_t job) {
+            const auto begin = (firstRange + job) * rangeBytes;
+            return diffRange(*index, file->bytes(), begin, std::min(size, begin + rangeBytes));
+        });
+    };
+
+    auto stats = FileTransferStats {};
+    auto writeOps = [&](const std::vector<std::vector<FileDeltaOp>> &ranges) -> IoTask<void> {
+        for (const auto &ops : ranges) {
+            for (auto begin = size_t {0}; begin < ops.size(); begin += kDeltaOpsPerMessage) {
+                const auto batch = std::span {ops}.subspan(begin, std::min(kDeltaOpsPerMessage, ops.size() - begin));
+                auto delta = FileDeltaMessage {.transferId = offer.transferId};
+                for (const auto &op : batch) {
+                    delta.blocks.push_back(op.block);
+                    delta.lengths.push_back(op.length);
+                }
+                ILIAS_CO_TRYV(co_await transport.writeMessage(RpcMessage {std::move(delta)}));
+                for (const auto &op : batch) {
+                    if (op.block != kDeltaLiteral) {
+                        stats.reusedBytes += op.length;
+                        continue;
+                    }
+                    ILIAS_CO_TRYV(co_await writeSlices(transport, mBandwidth, file->bytes().subspan(op.source, op.length)));
+                    stats.bytes += op.length;
+                    stats.chunks += 1;
+                }
+            }
+        }
+        co_return {};
+    };
+
+    SPDLOG_INFO(
+        "Sending {} ({} bytes) as transfer {}: delta against the receiver's {} blocks of {} bytes",
+        manifest.name,
+        manifest.size,
+        offer.transferId,
+        blockCount,
+        index->blockSize()
+    );
+    if (rangeCount > 0) {
+        ILIAS_CO_TRY(auto current, co_await diffWindow(0));
+        for (auto next = window; next < rangeCount; next += window) {
+            auto [written, diffed] = co_await ilias::whenAll(writeOps(current), diffWindow(next));
+            ILIAS_CO_TRYV(written);
+            if (!diffed) {
+                co_return Err(diffed.error());
+            }
+            current = std::move(*diffed);
+        }
+        ILIAS_CO_TRYV(co_await writeOps(current));
+    }
+    ILIAS_CO_TRYV(co_await readCompletion(transport, offer));
+    SPDLOG_INFO("Sent {} as a delta: {} literal bytes, {} bytes reused", manifest.name, stats.bytes, stats.reusedBytes);
+    co_return stats;
+}
+
+auto FileTransfers::receive(RpcTransport &transport, FileOfferMessage offer, FileReceiveOptions options)
+    -> IoTask<std::filesystem::path> {
+    const auto &manifest = offer.manifest;
+    auto refuse = [&](std::error_code error) -> IoTask<void> {
+        SPDLOG_WARN("Refusing file transfer {} of {}: {}", offer.transferId, manifest.name, error.message());
+        co_return co_await transport.writeMessage(RpcMessage {FileAcceptMessage {
+            .transferId = offer.transferId,
+            .error = error.message(),
+        }});
+    };
+    if (!validateManifest(offer)) {
+        (void) co_await refuse(make_error_code(FileTransferError::InvalidManifest));
+        co_return Err(FileTransferError::InvalidManifest);
+    }
+
+    const auto part = partPath(offer.transferId);
+    struct Prepared {
+        std::shared_ptr<PartFile> file;
+        std::vector<uint32_t> missing;
+        // An older copy to replace, worth a delta against.
+        std::optional<std::filesystem::path> basis;
+    };
+    auto basisPath = offer.replace ? std::optional {mDirectory / manifest.name} : std::nullopt;
+    auto prepared = co_await mDisk->run([part, manifest, basisPath]() -> IoResult<Prepared> {
+        auto error = std::error_code {};
+        std::filesystem::create_directories(part.parent_path(), error);
+        if (error) {
+            return Err(error);
+        }
+        auto file = PartFile::open(part);
+        if (!file) {
+            return Err(file.error());
+        }
+        auto existing = (*file)->size();
+        if (!existing) {
+            return Err(existing.error());
+        }
+        auto result = Prepared {.file = std::move(*file)};
+        const auto resuming = *existing == manifest.size && manifest.size > 0;
+        if (auto allocated = result.file->preallocate(manifest.size); !allocated) {
+            return Err(allocated.error());
+        }
+
+        // Chunks already on disk from an interrupted attempt are kept when
+        // they still hash right; the rest are fetched.
+        auto buffer = std::vector<std::byte>(resuming ? kFileSliceBytes : 0);
+        for (auto index = uint32_t {0}; index < manifest.chunkHashes.size(); ++index) {
+            if (!resuming) {
+                result.missing.push_back(index);
+                continue;
+            }
+            auto hash = XxHash64 {};
+            const auto begin = uint64_t {index} * manifest.chunkSize;
+            const auto length = fileChunkLength(manifest, index);
+            auto readable = true;
+            for (auto offset = uint64_t {0}; offset < length && readable; offset += kFileSliceBytes) {
+                const auto slice = std::span {buffer}.first(std::min<uint64_t>(kFileSliceBytes, length - offset));
+                readable = result.file->readAt(begin + offset, slice).has_value();
+                hash.update(slice);
+            }
+            if (!readable || hash.digest() != manifest.chunkHashes[index]) {
+                result.missing.push_back(index);
+            }
+        }
+
+        // Resuming beats a delta: the chunks on disk are already the new content.
+        if (basisPath && manifest.size > 0 && result.missing.size() == manifest.chunkHashes.size()) {
+            const auto basisSize = std::filesystem::file_size(*basisPath, error);
+            if (!error && std::filesystem::is_regular_file(*basisPath, error) && basisSize > 0 &&
+                basisSize <= kMaxDeltaBlocks * kMaxDeltaBlockSize) {
+                result.basis = basisPath;
+            }
+        }
+        return result;
+    });
+    if (!prepared) {
+        (void) co_await refuse(prepared.error());
+        co_return Err(prepared.error());
+    }
+    if (prepared->basis) {
+        prepared->file.reset();
+        co_return co_await receiveDelta(transport, offer, std::move(*prepared->basis), options);
+    }
+    auto file = std::move(prepared->file);
+    const auto missing = std::move(prepared->missing);
+    transferMetrics().chunksReused.add(manifest.chunkHashes.size() - missing.size());
+    SPDLOG_INFO(
+        "Receiving {} ({} bytes) as transfer {}: {} of {} chunks needed",
+        manifest.name,
+        manifest.size,
+        offer.transferId,
+        missing.size(),
+        manifest.chunkHashes.size()
+    );
+    ILIAS_CO_TRYV(co_await transport.writeMessage(RpcMessage {FileAcceptMessage {
+        .transferId = offer.transferId,
+        .chunks = missing,
+    }}));
+
+    // Slice n is read from the socket while slice n - 1 is written to disk.
+    struct PendingWrite {
+        std::shared_ptr<std::vector<std::byte>> buffer;
+        uint64_t offset = 0;
+        size_t length = 0;
+        uint32_t chunk = 0;
+        std::shared_ptr<XxHash64> hash;
+        bool lastOfChunk = false;
+    };
+    auto corrupted = std::vector<uint32_t> {};
+    auto writeSlice = [&](PendingWrite write) -> IoTask<void> {
+        ILIAS_CO_TRY(auto digest, co_await mDisk->run([file, write]() -> IoResult<std::optional<uint64_t>> {
+            const auto bytes = std::span<const std::byte> {*write.buffer}.first(write.length);
+            if (auto written = file->writeAt(write.offset, bytes); !written) {
+                return Err(written.error());
+            }
+            write.hash->update(bytes);
+            return write.lastOfChunk ? std::optional {write.hash->digest()} : std::nullopt;
+        }));
+        if (digest && *digest != manifest.chunkHashes[write.chunk]) {
+            corrupted.push_back(write.chunk);
+        }
+        co_return {};
+    };
+
+    auto buffers = std::array {
+        std::make_shared<std::vector<std::byte>>(kFileSliceBytes),
+        std::make_shared<std::vector<std::byte>>(kFileSliceBytes),
+    };
+    auto turn = size_t {0};
+    auto previous = std::optional<PendingWrite> {};
+    for (auto index : missing) {
+        const auto begin = uint64_t {index} * manifest.chunkSize;
+        const auto length = fileChunkLength(manifest, index);
+        auto hash = std::make_shared<XxHash64>();
+        for (auto offset = uint64_t {0}; offset < length; offset += kFileSliceBytes) {
+            auto current = PendingWrite {
+                .buffer = buffers[turn],
+                .offset = begin + offset,
+                .length = static_cast<size_t>(std::min<uint64_t>(kFileSliceBytes, length - offset)),
+                .chunk = index,
+                .hash = hash,
+                .lastOfChunk = offset + kFileSliceBytes >= length,
+            };
+            turn ^= 1;
+            co_await mBandwidth.reserve(current.length);
+            if (options.throttle) {
+                co_await options.throttle->reserve(current.length);
+            }
+            const auto target = std::span {*current.buffer}.first(current.length);
+            if (previous) {
+                auto [read, written] = co_await ilias::whenAll(transport.readRaw(target), writeSlice(*previous));
+                ILIAS_CO_TRYV(read);
+                ILIAS_CO_TRYV(written);
+            }
+            else {
+                ILIAS_CO_TRYV(co_await transport.readRaw(target));
+            }
+            transferMetrics().bytesReceived.add(current.length);
+            previous = std::move(current);
+        }
+    }
+    if (previous) {
+        ILIAS_CO_TRYV(co_await writeSlice(*previous));
+    }
+
+    if (!corrupted.empty()) {
+        // The part file stays; a retry refetches exactly these chunks.
+        SPDLOG_WARN("File transfer {} of {}: chunks {} failed verification", offer.transferId, manifest.name, corrupted);
+        ILIAS_CO_TRYV(co_await transport.writeMessage(RpcMessage {FileCompleteMessage {
+            .transferId = offer.transferId,
+            .error = make_error_code(FileTransferError::Corrupted).message(),
+        }}));
+        co_return Err(FileTransferError::Corrupted);
+    }
+
+    file.reset();
+    co_return co_await finishReceive(transport, offer, options);
+}
+
+auto FileTransfers::receiveDelta(
+    RpcTransport &transport,
+    const FileOfferMessage &offer,
+    std::filesystem::path basis,
+    FileReceiveOptions options
+) -> IoTask<std::filesystem::path> {
+    const auto &manifest = offer.manifest;
+    struct Opened {
+        std::shared_ptr<MappedFile> basis;
+        std::shared_ptr<PartFile> file;
+    };
+    auto opened = co_await mDisk->run([basis, part = partPath(offer.transferId)]() -> IoResult<Opened> {
+        auto mapped = MappedFile::open(basis);
+        if (!mapped) {
+            return Err(mapped.error());
+        }
+        auto file = PartFile::open(part);
+        if (!file) {
+            return Err(file.error());
+        }
+        return Opened {.basis = std::move(*mapped), .file = std::move(*file)};
+    });
+    if (!opened) {
+        SPDLOG_WARN("Refusing file transfer {} of {}: {}", offer.transferId, manifest.name, opened.error().message());
+        (void) co_await transport.writeMessage(RpcMessage {FileAcceptMessage {
+            .transferId = offer.transferId,
+            .error = opened.error().message(),
+        }});
+        co_return Err(opened.error());
+    }
+    auto basisFile = std::move(opened->basis);
+    auto file = std::move(opened->file);
+    const auto basisSize = uint64_t {basisFile->bytes().size()};
+
+    // Sign the old copy on the worker pool, a range of blocks per job.
+    const auto blockSize = deltaBlockSize(basisSize);
+    const auto blockCount = deltaBlockCount(basisSize, blockSize);
+    const auto jobs = std::clamp<uint64_t>(blockCount / kSignatureBlocksPerMessage, 1, workerPool().size());
+    const auto perJob = (blockCount + jobs - 1) / jobs;
+    ILIAS_CO_TRY(auto pieces, co_await runParallel(jobs, [basisFile, blockSize, blockCount, perJob](size_t job) {
+        const auto first = std::min(job * perJob, blockCount);
+        return signBlocks(basisFile->bytes(), blockSize, first, std::min(perJob, blockCount - first));
+    }));
+    auto weak = std::vector<uint32_t> {};
+    auto strong = std::vector<uint64_t> {};
+    weak.reserve(blockCount);
+    strong.reserve(blockCount);
+    for (auto &piece : pieces) {
+        weak.insert(weak.end(), piece.weak.begin(), piece.weak.end());
+        strong.insert(strong.end(), piece.strong.begin(), piece.strong.end());
+    }
+    SPDLOG_INFO(
+        "Receiving {} ({} bytes) as transfer {}: delta against {} ({} blocks of {} bytes)",
+        manifest.name,
+        manifest.size,
+        offer.transferId,
+        basis.string(),
+        blockCount,
+        blockSize
+    );
+    for (auto first = size_t {0}; first < weak.size(); first += kSignatureBlocksPerMessage) {
+        const auto count = std::min(kSignatureBlocksPerMessage, weak.size() - first);
+        ILIAS_CO_TRYV(co_await transport.writeMessage(RpcMessage {FileSignatureMessage {
+            .transferId = offer.transferId,
+            .blockSize = blockSize,
+            .basisSize = basisSize,
+            .weak = std::vector<uint32_t>(weak.begin() + first, weak.begin() + first + count),
+            .strong = std::vector<uint64_t>(strong.begin() + first, strong.begin() + first + count),
+            .last = first + count == weak.size(),
+        }}));
+    }
+
+    // Rebuild front to back: copies come from the old copy, literals off the wire.
+    auto verifier = std::make_shared<ChunkVerifier>(manifest);
+    auto buffer = std::make_shared<std::vector<std::byte>>(kFileSliceBytes);
+    auto written = uint64_t {0};
+    auto reused = uint64_t {0};
+    while (written < manifest.size) {
+        ILIAS_CO_TRY(auto message, co_await transport.readMessage());
+        const auto *delta = std::get_if<FileDeltaMessage>(&message);
+        if (!delta || delta->transferId != offer.transferId || delta->blocks.empty() ||
+            delta->blocks.size() != delta->lengths.size()) {
+            SPDLOG_ERROR("File transfer {} expected a delta, got {}", offer.transferId, message);
+            co_return Err(RpcError::ProtocolError);
+        }
+        for (auto op = size_t {0}; op < delta->blocks.size(); ++op) {
+            const auto block = delta->blocks[op];
+            const auto length = delta->lengths[op];
+            if (length == 0 || length > manifest.size - written) {
+                co_return Err(RpcError::ProtocolError);
+            }
+            if (block != kDeltaLiteral) {
+                const auto from = uint64_t {block} * blockSize;
+                if (from >= basisSize || length > basisSize - from) {
+                    co_return Err(RpcError::ProtocolError);
+                }
+                ILIAS_CO_TRYV(co_await mDisk->run([basisFile, file, verifier, from, length, to = written]() -> IoResult<void> {
+                    const auto bytes = basisFile->bytes().subspan(from, length);
+                    if (auto copied = file->writeAt(to, bytes); !copied) {
+                        return copied;
+                    }
+                    verifier->update(bytes);
+                    return {};
+                }));
+                reused += length;
+                written += length;
+                continue;
+            }
+            for (auto offset = uint64_t {0}; offset < length; offset += kFileSliceBytes) {
+                const auto slice = static_cast<size_t>(std::min<uint64_t>(kFileSliceBytes, length - offset));
+                co_await mBandwidth.reserve(slice);
+                if (options.throttle) {
+                    co_await options.throttle->reserve(slice);
+                }
+                ILIAS_CO_TRYV(co_await transport.readRaw(std::span {*buffer}.first(slice)));
+                transferMetrics().bytesReceived.add(slice);
+                ILIAS_CO_TRYV(co_await mDisk->run([buffer, file, verifier, slice, to = written + offset]() -> IoResult<void> {
+                    const auto bytes = std::span<const std::byte> {*buffer}.first(slice);
+                    if (auto stored = file->writeAt(to, bytes); !stored) {
+                        return stored;
+                    }
+                    verifier->update(bytes);
+                    return {};
+                }));
+            }
+            written += length;
+        }
+    }
+    basisFile.reset();
+    file.reset();
+
+    transferMetrics().deltas.add();
+    transferMetrics().deltaBytesReused.add(reused);
+    if (!verifier->corrupted().empty()) {
+        // What verified stays in the part file; a retry resumes into it.
+        SPDLOG_WARN(
+            "File transfer {} of {}: chunks {} failed verification after the delta",
+            offer.transferId,
+            manifest.name,
+            verifier->corrupted()
+        );
+        ILIAS_CO_TRYV(co_await transport.writeMessage(RpcMessage {FileCompleteMessage {
+            .transferId = offer.transferId,
+            .error = make_error_code(FileTransferError::Corrupted).message(),
+        }}));
+        co_return Err(FileTransferError::Corrupted);
+    }
+    SPDLOG_INFO(
+        "Rebuilt {} from its older copy: {} of {} bytes reused",
+        manifest.name,
+        reused,
+        manifest.size
+    );
+    co_return co_await finishReceive(transport, offer, options);
+}
+
+auto FileTransfers::finishReceive(RpcTransport &transport, const FileOfferMessage &offer, FileReceiveOptions options)
+    -> IoTask<std::filesystem::path> {
+    const auto &manifest = offer.manifest;
+    const auto part = partPath(offer.transferId);
+    if (options.stage) {
+        ILIAS_CO_TRYV(co_await transport.writeMessage(RpcMessage {FileCompleteMessage {
+            .transferId = offer.transferId,
+        }}));
+        SPDLOG_INFO("Staged {} as {}", manifest.name, part.string());
+        co_return part;
+    }
+    auto stored = co_await mDisk->run([part, target = mDirectory / manifest.name, replace = offer.replace]()
+                                          -> IoResult<std::filesystem::path> {
+        // A replacing transfer takes the name over; renaming onto it is atomic.
+        auto path = replace ? target : freePath(target);
+        auto error = std::error_code {};
+        std::filesystem::rename(part, path, error);
+        if (error) {
+            return Err(error);
+        }
+        return path;
+    });
+    ILIAS_CO_TRYV(co_await transport.writeMessage(RpcMessage {FileCompleteMessage {
+        .transferId = offer.transferId,
+        .error = stored ? std::string {} : stored.error().message(),
+    }}));
+    if (stored) {
+        transferMetrics().filesReceived.add();
+        SPDLOG_INFO("Received {} into {}", manifest.name, stored->string());
+    }
+    co_return stored;
+}
+
+auto FileTransfers::fetch(RpcTransport &transport, std::string transferId, FileReceiveOptions options)
+    -> IoTask<std::filesystem::path> {
+    ILIAS_CO_TRY(auto message, co_await transport.readMessage());
+    if (const auto *error = std::get_if<ErrorMessage>(&message)) {
+        SPDLOG_WARN("Fetch of {} refused: {}", transferId, error->message);
+        co_return Err(FileTransferError::Rejected);
+    }
+    auto *offer = std::get_if<FileOfferMessage>(&message);
+    if (!offer || offer->transferId != transferId) {
+        SPDLOG_ERROR("Fetch of {} expected its offer, got {}", transferId, message);
+        co_return Err(RpcError::ProtocolError);
+    }
+    co_return co_await receive(transport, std::move(*offer), options);
+}
+
+auto FileTransfers::commit(std::filesystem::path staged, std::string name) -> IoTask<std::filesystem::path> {
+    if (!isPlainFileName(name)) {
+        co_return Err(FileTransferError::InvalidManifest);
+    }
+    auto stored = co_await mDisk->run([staged, target = mDirectory / name]() -> IoResult<std::filesystem::path> {
+        auto path = freePath(target);
+        auto error = std::error_code {};
+        std::filesystem::rename(staged, path, error);
+        if (error) {
+            return Err(error);
+        }
+        return path;
+    });
+    if (stored) {
+        transferMetrics().filesReceived.add();
+        SPDLOG_INFO("Received {} into {}", name, stored->string());
+    }
+    co_return stored;
+}
+
+auto FileTransfers::discard(std::filesystem::path staged) -> IoTask<void> {
+    co_return co_await mDisk->run([staged]() -> IoResult<void> {
+        auto error = std::error_code {};
+        std::filesystem::remove(staged, error);
+        if (error) {
+            return Err(error);
+        }
+        return {};
+    });
+}
+
+auto defaultDownloadDirectory() -> std::filesystem::path {
+#if defined(_WIN32)
+    const auto *home = std::getenv("USERPROFILE");
+#else
+    const auto *home = std::getenv("HOME");
+#endif
+    if (home && *home) {
+        return std::filesystem::path {home} / "Downloads" / "mksync";
+    }
+    auto error = std::error_code {};
+    auto temp = std::filesystem::temp_directory_path(error);
+    return (error ? std::filesystem::path {"."} : temp) / "mksync";
+}
+
+MKS_END
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "refl/this_error.hpp"
+#include "rpc/message.hpp"
+#include <ilias/task.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+MKS_BEGIN
+
+class RpcTransport;
+
+enum class FileTransferError {
+    Ok = 0,
+    NotAFile,        // The path to send is not a regular file
+    Changed,         // The file changed size between offer and send
+    Rejected,        // The receiver refused the offer
+    InvalidManifest, // The name is a path, or the hashes do not cover the size
+    Corrupted,       // A chunk did not hash to its manifest entry
+};
+THIS_ERROR(FileTransferError);
+
+/**
+ * @brief Bytes per socket write or read and per bandwidth reservation.
+ *
+ * Chunks are only the unit of resume; moving them in slices bounds the
+ * receiver's buffers and lets concurrent transfers interleave finely.
+ */
+inline constexpr size_t kFileSliceBytes = 1024 * 1024;
+
+struct FileTransferStats {
+    uint64_t bytes = 0;        // Chunk bytes written to the connection
+    uint32_t chunks = 0;       // Chunks written
+    uint32_t reusedChunks = 0; // Chunks the receiver already held
+    uint64_t reusedBytes = 0;  // Bytes a delta let the receiver copy from its older version
+};
+
+/**
+ * @brief Rate limit shared by every transfer of one process.
+ *
+ * Each slice reserves its airtime in arrival order, so N concurrent
+ * transfers interleave and each gets 1/N of the rate. A rate of 0 means
+ * unlimited: transfers then share whatever the links give them.
+ */
+class BandwidthShare {
+public:
+    explicit BandwidthShare(uint64_t bytesPerSecond = 0) noexcept : mRate(bytesPerSecond) {}
+
+    auto setRate(uint64_t bytesPerSecond) noexcept -> void { mRate = bytesPerSecond; }
+    auto rate() const noexcept -> uint64_t { return mRate; }
+
+    /** @brief Wait until @p bytes may go out. */
+    auto reserve(uint64_t bytes) -> Task<void>;
+
+private:
+    uint64_t mRate = 0;
+    std::chrono::steady_clock::time_point mNextFree {};
+};
+
+/** @brief How @ref FileTransfers::makeOffer offers one file. */
+struct FileSendOptions {
+    // Replace the receiver's file of the same name; an older version there
+    // turns the transfer into a delta against it.
+    bool replace = false;
+};
+
+/** @brief How @ref FileTransfers::receive treats one transfer. */
+struct FileReceiveOptions {
+    // Leave the verified part file in place and return its path; commit()
+    // or discard() decides later. A drag fetched before its drop stages.
+    bool stage = false;
+    // Extra limit for this transfer alone, on top of bandwidth(). Read per
+    // slice, so lifting it (rate 0) speeds up a transfer already running.
+    BandwidthShare *throttle = nullptr;
+};
+
+/**
+ * @brief Chunked file transfer over a dedicated connection.
+ *
+ * The sender maps the file and hands the mapping straight to the socket, so
+ * file bytes are never copied in user space on the way out. The receiver
+ * preallocates a part file, writes each slice at its offset and checks every
+ * chunk against the manifest; the part file survives a dropped connection
+ * and the next offer of the same file only fetches what is missing.
+ *
+ * A replacing offer for a file the receiver already holds is sent as a
+ * delta instead: the receiver signs its old copy block by block, the sender
+ * finds those blocks anywhere in the new file and streams only the bytes in
+ * between; the receiver rebuilds the file in the part file and checks it
+ * against the manifest like any other transfer. Signing and matching are
+ * split over the worker pool.
+ *
+ * Disk work (hashing, page-in, preallocation, positional writes) runs on one
+ * thread owned by this object, so the event loop that routes input only ever
+ * waits on sockets.
+ */
+class FileTransfers {
+public:
+    FileTransfers();
+    FileTransfers(const FileTransfers &) = delete;
+    ~FileTransfers();
+
+    auto bandwidth() noexcept -> BandwidthShare & { return mBandwidth; }
+
+    /** @brief Where received files land (created on first use). */
+    auto setDirectory(std::filesystem::path directory) -> void;
+    auto directory() const -> const std::filesystem::path & { return mDirectory; }
+
+    /** @brief Hash @p path into an offer; the chunk hashes are computed off the event loop. */
+    auto makeOffer(std::filesystem::path path, FileSendOptions options = {}) -> IoTask<FileOfferMessage>;
+
+    /**
+     * @brief Sender half, once @p offer was written on @p transport.
+     *
+     * Waits for the receiver's FileAcceptMessage, streams the chunks it asked
+     * for and returns when the receiver confirmed the file. A signature in
+     * its place is answered with a delta.
+     */
+    auto send(RpcTransport &transport, std::filesystem::path path, const FileOfferMessage &offer)
+        -> IoTask<FileTransferStats>;
+
+    /**
+     * @brief Receiver half, after @p offer was read from @p transport.
+     *
+     * @return Where the file was stored; an existing file of the same name is
+     *         never overwritten. With @c options.stage, the part file.
+     */
+    auto receive(RpcTransport &transport, FileOfferMessage offer, FileReceiveOptions options = {})
+        -> IoTask<std::filesystem::path>;
+
+    /**
+     * @brief Receiver half of a fetch, once FileFetchMessage @p transferId was written.
+     *
+     * Reads the sender's FileOfferMessage and continues as @ref receive.
+     */
+    auto fetch(RpcTransport &transport, std::string transferId, FileReceiveOptions options = {})
+        -> IoTask<std::filesystem::path>;
+
+    /** @brief Store a part file @ref receive staged as @p name; same naming rules. */
+    auto commit(std::filesystem::path staged, std::string name) -> IoTask<std::filesystem::path>;
+
+    /** @brief Where @ref receive keeps @p transferId until it is complete. */
+    auto partPath(std::string_view transferId) const -> std::filesystem::path;
+
+    /** @brief Delete a part file @ref receive staged. */
+    auto discard(std::filesystem::path staged) -> IoTask<void>;
+
+private:
+    class DiskThread;
+
+    auto sendDelta(
+        RpcTransport &transport,
+        std::filesystem::path path,
+        const FileOfferMessage &offer,
+        FileSignatureMessage first
+    ) -> IoTask<FileTransferStats>;
+    /** @brief Rebuild @p offer in its preallocated part file from @p basis and the sender's delta. */
+    auto receiveDelta(
+        RpcTransport &transport,
+        const FileOfferMessage &offer,
+        std::filesystem::path basis,
+        FileReceiveOptions options
+    ) -> IoTask<std::filesystem::path>;
+    /** @brief Confirm a complete part file: stage it, or move it to its name. */
+    auto finishReceive(RpcTransport &transport, const FileOfferMessage &offer, FileReceiveOptions options)
+        -> IoTask<std::filesystem::path>;
+
+    std::unique_ptr<DiskThread> mDisk;
+    BandwidthShare mBandwidth;
+    std::filesystem::path mDirectory;
+};
+
+/** @brief Downloads/mksync under the user's home, or under the temp directory without one. */
+auto defaultDownloadDirectory() -> std::filesystem::path;
+
+MKS_END
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include <chrono>
+#include <ilias/sync.hpp>
+
+MKS_BEGIN
+
+/**
+ * @brief Never finishes; returns only by being cancelled.
+ *
+ * For services that run beside a role task under whenAny (the control and
+ * event sockets): returning would stop the role, so one that is off or whose
+ * socket died parks here instead.
+ */
+inline auto idleUntilCancelled() -> Task<void> {
+    using namespace std::literals;
+    while (true) {
+        co_await ilias::sleep(1h);
+    }
+}
+
+MKS_END
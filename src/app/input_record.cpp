@@ -0,0 +1,406 @@
+#include "input_record.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <variant>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MKS_BEGIN
+
+THIS_ERROR_IMPL(InputRecordError);
+
+namespace {
+
+constexpr uint32_t kRecordVersion = 1;
+constexpr char kRecordMagic[8] = {'M', 'K', 'S', 'R', 'E', 'C', '\0', '\0'};
+constexpr size_t kWriteBufferSize = 64 * 1024;
+
+struct FileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t startTimeNs; // system_clock, for humans correlating with logs
+    uint64_t reserved;
+};
+static_assert(sizeof(FileHeader) == 32);
+
+auto systemNowNs() -> uint64_t {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count());
+}
+
+auto toScreenRecord(const ScreenInfo &screen) -> ScreenRecord {
+    auto record = ScreenRecord {
+        .x = screen.x,
+        .y = screen.y,
+        .width = screen.width,
+        .height = screen.height,
+        .dpi = screen.dpi,
+        .primary = static_cast<uint8_t>(screen.primary ? 1 : 0),
+    };
+    const auto length = std::min(screen.name.size(), sizeof(record.name));
+    record.nameLength = static_cast<uint8_t>(length);
+    std::memcpy(record.name, screen.name.data(), length);
+    return record;
+}
+
+auto fromScreenRecord(const ScreenRecord &record) -> ScreenInfo {
+    return ScreenInfo {
+        .x = record.x,
+        .y = record.y,
+        .width = record.width,
+        .height = record.height,
+        .dpi = record.dpi,
+        .name = std::string(record.name, std::min<size_t>(record.nameLength, sizeof(record.name))),
+        .primary = record.primary != 0,
+    };
+}
+
+// MARK: Mapping
+
+struct Mapping {
+    const std::byte *data = nullptr;
+    size_t size = 0;
+};
+
+auto mapFile(const std::filesystem::path &path) -> IoResult<Mapping> {
+#if defined(_WIN32)
+    auto file = ::CreateFileW(
+        path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+    );
+    if (file == INVALID_HANDLE_VALUE) {
+        return Err(std::error_code(static_cast<int>(::GetLastError()), std::system_category()));
+    }
+    auto size = LARGE_INTEGER {};
+    if (!::GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        ::CloseHandle(file);
+        return Err(InputRecordError::Truncated);
+    }
+    auto mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ::CloseHandle(file);
+    if (!mapping) {
+        return Err(std::error_code(static_cast<int>(::GetLastError()), std::system_category()));
+    }
+    // The view keeps the mapping object alive on its own.
+    auto *view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    ::CloseHandle(mapping);
+    if (!view) {
+        return Err(std::error_code(static_cast<int>(::GetLastError()), std::system_category()));
+    }
+    return Mapping {static_cast<const std::byte *>(view), static_cast<size_t>(size.QuadPart)};
+#else
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return Err(std::error_code(errno, std::generic_category()));
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+        const auto error = errno;
+        ::close(fd);
+        return Err(std::error_code(error, std::generic_category()));
+    }
+    if (info.st_size == 0) {
+        ::close(fd);
+        return Err(InputRecordError::Truncated);
+    }
+    auto *view = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return Err(std::error_code(errno, std::generic_category()));
+    }
+    // Replay reads front to back.
+    (void) ::madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+    return Mapping {static_cast<const std::byte *>(view), static_cast<size_t>(info.st_size)};
+#endif
+}
+
+auto unmapFile(const std::byte *data, size_t size) noexcept -> void {
+    if (!data) {
+        return;
+    }
+#if defined(_WIN32)
+    (void) size;
+    ::UnmapViewOfFile(data);
+#else
+    ::munmap(const_cast<std::byte *>(data), size);
+#endif
+}
+
+} // namespace
+
+// MARK: Encoding
+
+auto encodeInputRecord(const InputEvent &event, uint64_t timeNs) noexcept -> InputRecord {
+    auto record = InputRecord {};
+    record.timeNs = timeNs;
+    std::visit(Overloads {
+        [&](const KeyEvent &key) {
+            record.kind = InputRecordKind::Key;
+            record.code = static_cast<uint32_t>(key.key);
+            record.modifiers = static_cast<uint8_t>(key.modifiers);
+            record.index = key.nativeCode;
+            record.flags = (key.release ? InputRecord::kRelease : 0) |
+                           (key.repeat ? InputRecord::kRepeat : 0);
+        },
+        [&](const MouseButtonEvent &button) {
+            record.kind = InputRecordKind::MouseButton;
+            record.code = static_cast<uint32_t>(button.button);
+            record.index = button.screenIndex;
+            record.x = button.x;
+            record.y = button.y;
+            record.flags = button.release ? InputRecord::kRelease : 0;
+        },
+        [&](const MouseMoveEvent &move) {
+            record.kind = InputRecordKind::MouseMove;
+            record.index = move.screenIndex;
+            record.x = move.x;
+            record.y = move.y;
+            record.deltaX = move.deltaX;
+            record.deltaY = move.deltaY;
+        },
+        [&](const MouseWheelEvent &wheel) {
+            record.kind = InputRecordKind::MouseWheel;
+            record.x = wheel.x;
+            record.y = wheel.y;
+            record.deltaX = wheel.deltaX;
+            record.deltaY = wheel.deltaY;
+        },
+    }, event);
+    return record;
+}
+
+auto decodeInputRecord(const InputRecord &record) noexcept -> std::optional<InputEvent> {
+    switch (record.kind) {
+        case InputRecordKind::Key:
+            return KeyEvent {
+                .key = static_cast<Key>(record.code),
+                .modifiers = static_cast<KeyModifier>(record.modifiers),
+                .nativeCode = record.index,
+                .repeat = (record.flags & InputRecord::kRepeat) != 0,
+                .release = (record.flags & InputRecord::kRelease) != 0,
+            };
+        case InputRecordKind::MouseButton:
+            return MouseButtonEvent {
+                .x = record.x,
+                .y = record.y,
+                .screenIndex = record.index,
+                .button = static_cast<MouseButton>(record.code),
+                .release = (record.flags & InputRecord::kRelease) != 0,
+            };
+        case InputRecordKind::MouseMove:
+            return MouseMoveEvent {
+                .x = record.x,
+                .y = record.y,
+                .screenIndex = record.index,
+                .deltaX = record.deltaX,
+                .deltaY = record.deltaY,
+            };
+        case InputRecordKind::MouseWheel:
+            return MouseWheelEvent {
+                .x = record.x,
+                .y = record.y,
+                .deltaX = record.deltaX,
+                .deltaY = record.deltaY,
+            };
+        default:
+            return std::nullopt;
+    }
+}
+
+// MARK: Writer
+
+auto InputRecordWriter::FileCloser::operator()(std::FILE *file) const noexcept -> void {
+    std::fclose(file);
+}
+
+InputRecordWriter::InputRecordWriter(std::FILE *file)
+    : mFile(file), mStart(std::chrono::steady_clock::now()) {
+}
+
+InputRecordWriter::~InputRecordWriter() = default;
+
+auto InputRecordWriter::open(const std::filesystem::path &path) -> IoResult<InputRecordWriter> {
+#if defined(_WIN32)
+    auto *file = ::_wfopen(path.c_str(), L"wb");
+#else
+    auto *file = std::fopen(path.c_str(), "wb");
+#endif
+    if (!file) {
+        return Err(std::error_code(errno, std::generic_category()));
+    }
+    std::setvbuf(file, nullptr, _IOFBF, kWriteBufferSize);
+
+    auto writer = InputRecordWriter {file};
+    auto header = FileHeader {};
+    std::memcpy(header.magic, kRecordMagic, sizeof(header.magic));
+    header.version = kRecordVersion;
+    header.recordSize = sizeof(InputRecord);
+    header.startTimeNs = systemNowNs();
+    if (auto written = writer.writeBytes(&header, sizeof(header)); !written) {
+        return Err(written.error());
+    }
+    return writer;
+}
+
+auto InputRecordWriter::elapsedNs() const -> uint64_t {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - mStart
+    ).count());
+}
+
+auto InputRecordWriter::writeBytes(const void *data, size_t size) -> IoResult<void> {
+    if (std::fwrite(data, 1, size, mFile.get()) != size) {
+        return Err(InputRecordError::IoError);
+    }
+    return {};
+}
+
+auto InputRecordWriter::append(const InputEvent &event) -> IoResult<void> {
+    const auto record = encodeInputRecord(event, elapsedNs());
+    if (auto written = writeBytes(&record, sizeof(record)); !written) {
+        return written;
+    }
+    ++mEventCount;
+    return {};
+}
+
+auto InputRecordWriter::appendScreens(const std::vector<ScreenInfo> &screens) -> IoResult<void> {
+    auto record = InputRecord {};
+    record.timeNs = elapsedNs();
+    record.kind = InputRecordKind::Screens;
+    record.code = static_cast<uint32_t>(screens.size());
+    if (auto written = writeBytes(&record, sizeof(record)); !written) {
+        return written;
+    }
+    for (const auto &screen : screens) {
+        const auto entry = toScreenRecord(screen);
+        if (auto written = writeBytes(&entry, sizeof(entry)); !written) {
+            return written;
+        }
+    }
+    return {};
+}
+
+auto InputRecordWriter::flush() -> IoResult<void> {
+    if (std::fflush(mFile.get()) != 0) {
+        return Err(InputRecordError::IoError);
+    }
+    return {};
+}
+
+// MARK: Reader
+
+InputRecordReader::InputRecordReader(InputRecordReader &&other) noexcept
+    : mData(std::exchange(other.mData, nullptr)),
+      mSize(std::exchange(other.mSize, 0)),
+      mOffset(std::exchange(other.mOffset, 0)),
+      mStartTimeNs(other.mStartTimeNs),
+      mScreens(std::move(other.mScreens)) {
+}
+
+auto InputRecordReader::operator=(InputRecordReader &&other) noexcept -> InputRecordReader & {
+    if (this != &other) {
+        release();
+        mData = std::exchange(other.mData, nullptr);
+        mSize = std::exchange(other.mSize, 0);
+        mOffset = std::exchange(other.mOffset, 0);
+        mStartTimeNs = other.mStartTimeNs;
+        mScreens = std::move(other.mScreens);
+    }
+    return *this;
+}
+
+InputRecordReader::~InputRecordReader() {
+    release();
+}
+
+auto InputRecordReader::release() noexcept -> void {
+    unmapFile(mData, mSize);
+    mData = nullptr;
+    mSize = 0;
+}
+
+auto InputRecordReader::open(const std::filesystem::path &path) -> IoResult<InputRecordReader> {
+    ILIAS_TRY(auto mapping, mapFile(path));
+    auto reader = InputRecordReader {};
+    reader.mData = mapping.data;
+    reader.mSize = mapping.size;
+
+    auto header = FileHeader {};
+    if (reader.mSize < sizeof(header)) {
+        return Err(InputRecordError::Truncated);
+    }
+    std::memcpy(&header, reader.mData, sizeof(header));
+    if (std::memcmp(header.magic, kRecordMagic, sizeof(kRecordMagic)) != 0) {
+        return Err(InputRecordError::BadMagic);
+    }
+    if (header.version != kRecordVersion || header.recordSize != sizeof(InputRecord)) {
+        return Err(InputRecordError::UnsupportedVersion);
+    }
+    reader.mStartTimeNs = header.startTimeNs;
+    ILIAS_TRYV(reader.parseScreens());
+    reader.rewind();
+    return reader;
+}
+
+auto InputRecordReader::parseScreens() -> IoResult<void> {
+    auto offset = sizeof(FileHeader);
+    while (mSize - offset >= sizeof(InputRecord)) {
+        auto record = InputRecord {};
+        std::memcpy(&record, mData + offset, sizeof(record));
+        offset += sizeof(record);
+        if (record.kind != InputRecordKind::Screens) {
+            continue;
+        }
+        if ((mSize - offset) / sizeof(ScreenRecord) < record.code) {
+            return Err(InputRecordError::Truncated);
+        }
+        for (auto index = 0U; index < record.code; ++index) {
+            auto screen = ScreenRecord {};
+            std::memcpy(&screen, mData + offset, sizeof(screen));
+            offset += sizeof(screen);
+            mScreens.push_back(fromScreenRecord(screen));
+        }
+        break;
+    }
+    if (mScreens.empty()) {
+        return Err(InputRecordError::NoScreens);
+    }
+    return {};
+}
+
+auto InputRecordReader::rewind() noexcept -> void {
+    mOffset = sizeof(FileHeader);
+}
+
+auto InputRecordReader::nextEvent() noexcept -> std::optional<TimedInputEvent> {
+    // A partial trailing record (writer killed mid-append) reads as end of file.
+    while (mSize - mOffset >= sizeof(InputRecord)) {
+        auto record = InputRecord {};
+        std::memcpy(&record, mData + mOffset, sizeof(record));
+        mOffset += sizeof(record);
+        if (record.kind == InputRecordKind::Screens) {
+            const auto skip = static_cast<size_t>(record.code) * sizeof(ScreenRecord);
+            mOffset += std::min(skip, mSize - mOffset);
+            continue;
+        }
+        if (auto event = decodeInputRecord(record)) {
+            return TimedInputEvent {.timeNs = record.timeNs, .event = *event};
+        }
+    }
+    return std::nullopt;
+}
+
+MKS_END
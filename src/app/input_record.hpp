@@ -0,0 +1,168 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "refl/formatter.hpp"
+#include "refl/this_error.hpp"
+#include "core.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+MKS_BEGIN
+
+/**
+ * @brief Input recording file (`mksync record` / `mksync replay`).
+ *
+ * Layout: a 32-byte header, then an append-only sequence of fixed 40-byte
+ * @ref InputRecord entries. A @c Screens record is followed by @c code
+ * 64-byte @ref ScreenRecord entries. Everything is host endian, like the
+ * flight recorder dump. A file cut short by a crash stays readable up to its
+ * last complete record.
+ */
+enum class InputRecordKind : uint8_t {
+    Key = 1,
+    MouseButton,
+    MouseMove,
+    MouseWheel,
+    Screens, // Screen layout snapshot; `code` ScreenRecords follow
+};
+FORMATTER(InputRecordKind);
+
+struct InputRecord {
+    static constexpr uint8_t kRelease = 1 << 0;
+    static constexpr uint8_t kRepeat = 1 << 1;
+
+    uint64_t        timeNs = 0;    // Since the recording started (steady_clock)
+    InputRecordKind kind = InputRecordKind::Key;
+    uint8_t         flags = 0;
+    uint8_t         modifiers = 0; // KeyModifier
+    uint8_t         reserved = 0;
+    uint32_t        code = 0;      // Key / MouseButton; screen count for Screens
+    uint32_t        index = 0;     // screenIndex; nativeCode for Key
+    int32_t         x = 0;
+    int32_t         y = 0;
+    int32_t         deltaX = 0;
+    int32_t         deltaY = 0;
+    uint32_t        padding = 0;
+};
+static_assert(std::is_trivially_copyable_v<InputRecord>);
+static_assert(sizeof(InputRecord) == 40);
+
+struct ScreenRecord {
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t dpi = 0;
+    uint8_t primary = 0;
+    uint8_t nameLength = 0;
+    char    name[42] = {}; // Truncated, not NUL terminated
+};
+static_assert(std::is_trivially_copyable_v<ScreenRecord>);
+static_assert(sizeof(ScreenRecord) == 64);
+
+enum class InputRecordError {
+    Ok = 0,
+    BadMagic,
+    UnsupportedVersion,
+    Truncated,
+    NoScreens,
+    IoError,
+};
+THIS_ERROR(InputRecordError);
+
+struct TimedInputEvent {
+    uint64_t   timeNs = 0;
+    InputEvent event;
+};
+
+/**
+ * @brief Append-only writer.
+ *
+ * Records go through one stdio buffer, so appending an event never
+ * allocates; call @ref flush to make them visible to readers.
+ */
+class InputRecordWriter {
+public:
+    static auto open(const std::filesystem::path &path) -> IoResult<InputRecordWriter>;
+
+    InputRecordWriter(InputRecordWriter &&) noexcept = default;
+    ~InputRecordWriter();
+
+    auto append(const InputEvent &event) -> IoResult<void>;
+
+    /** @brief Snapshot of the layout events refer to; written at start and on change. */
+    auto appendScreens(const std::vector<ScreenInfo> &screens) -> IoResult<void>;
+
+    auto flush() -> IoResult<void>;
+
+    /** @brief Events appended so far (screen snapshots not counted). */
+    auto eventCount() const noexcept -> uint64_t { return mEventCount; }
+
+private:
+    struct FileCloser {
+        auto operator()(std::FILE *file) const noexcept -> void;
+    };
+
+    InputRecordWriter(std::FILE *file);
+    auto elapsedNs() const -> uint64_t;
+    auto writeBytes(const void *data, size_t size) -> IoResult<void>;
+
+    std::unique_ptr<std::FILE, FileCloser> mFile;
+    std::chrono::steady_clock::time_point mStart;
+    uint64_t mEventCount = 0;
+};
+
+/**
+ * @brief Memory-mapped reader.
+ *
+ * @ref nextEvent decodes straight from the mapping into a value; screen
+ * snapshots after the first are skipped (replay cannot change the layout of a
+ * running server).
+ */
+class InputRecordReader {
+public:
+    static auto open(const std::filesystem::path &path) -> IoResult<InputRecordReader>;
+
+    InputRecordReader(InputRecordReader &&other) noexcept;
+    auto operator=(InputRecordReader &&other) noexcept -> InputRecordReader &;
+    ~InputRecordReader();
+
+    /** @brief Next event in file order, nullopt at the end. */
+    auto nextEvent() noexcept -> std::optional<TimedInputEvent>;
+
+    /** @brief Start over from the first record. */
+    auto rewind() noexcept -> void;
+
+    /** @brief First screen snapshot; the layout the recorded events refer to. */
+    auto screens() const -> const std::vector<ScreenInfo> & { return mScreens; }
+
+    /** @brief Wall-clock (system_clock) time the recording started, in ns. */
+    auto startTimeNs() const noexcept -> uint64_t { return mStartTimeNs; }
+
+private:
+    InputRecordReader() = default;
+    auto parseScreens() -> IoResult<void>;
+    auto release() noexcept -> void;
+
+    const std::byte *mData = nullptr;
+    size_t mSize = 0;
+    size_t mOffset = 0;
+    uint64_t mStartTimeNs = 0;
+    std::vector<ScreenInfo> mScreens;
+};
+
+/** @brief Parse a record back into an event; nullopt for Screens or unknown kinds. */
+auto decodeInputRecord(const InputRecord &record) noexcept -> std::optional<InputEvent>;
+auto encodeInputRecord(const InputEvent &event, uint64_t timeNs) noexcept -> InputRecord;
+
+MKS_END
+
+REFL_REGISTER_FMT_FORMATTER(mks::InputRecordKind);
+REFL_REGISTER_FMT_FORMATTER(mks::InputRecordError);
@@ -0,0 +1,229 @@
+#include "input_replay.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <ilias/sync.hpp>
+#include <utility>
+
+MKS_BEGIN
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// Start-gate poll interval, and how long a finished replay parks nextEvent().
+constexpr auto kGatePollInterval = 50ms;
+constexpr auto kParkInterval = 1h;
+
+class RecordingCapture final : public InputCapture {
+public:
+    RecordingCapture(InputCapture::Ptr inner, std::shared_ptr<InputRecordWriter> writer)
+        : mInner(std::move(inner)), mWriter(std::move(writer)) {
+    }
+
+    auto initialize() -> IoTask<void> override {
+        return mInner->initialize();
+    }
+
+    auto shutdown() -> Task<void> override {
+        if (auto flushed = mWriter->flush(); !flushed) {
+            SPDLOG_WARN("Failed to flush input recording: {}", flushed.error().message());
+        }
+        return mInner->shutdown();
+    }
+
+    auto nextEvent() -> Task<InputEvent> override {
+        auto event = co_await mInner->nextEvent();
+        if (auto appended = mWriter->append(event); !appended && !mWarned) {
+            SPDLOG_WARN("Input recording stopped: {}", appended.error().message());
+            mWarned = true;
+        }
+        co_return event;
+    }
+
+    auto setRemoteControlActive(bool active) -> IoResult<void> override {
+        return mInner->setRemoteControlActive(active);
+    }
+
+    auto moveLocalCursor(uint32_t screenIndex, int32_t x, int32_t y) -> IoResult<void> override {
+        return mInner->moveLocalCursor(screenIndex, x, y);
+    }
+
+    auto setDedicatedThread(bool enabled) -> bool override {
+        return mInner->setDedicatedThread(enabled);
+    }
+
+private:
+    InputCapture::Ptr mInner;
+    std::shared_ptr<InputRecordWriter> mWriter;
+    bool mWarned = false;
+};
+
+} // namespace
+
+// MARK: Recording
+
+RecordingPlatform::RecordingPlatform(Platform::Ptr inner, std::shared_ptr<InputRecordWriter> writer)
+    : mInner(std::move(inner)), mWriter(std::move(writer)) {
+    (void) screens();
+}
+
+auto RecordingPlatform::screens() const -> std::vector<ScreenInfo> {
+    auto current = mInner->screens();
+    const auto changed = current.size() != mLastScreens.size() ||
+        !std::equal(current.begin(), current.end(), mLastScreens.begin(), [](const auto &a, const auto &b) {
+            return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height &&
+                   a.dpi == b.dpi && a.name == b.name && a.primary == b.primary;
+        });
+    if (changed) {
+        if (auto appended = mWriter->appendScreens(current); !appended) {
+            SPDLOG_WARN("Failed to record screen layout: {}", appended.error().message());
+        }
+        mLastScreens = current;
+    }
+    return current;
+}
+
+auto RecordingPlatform::createCapture() -> InputCapture::Ptr {
+    auto capture = mInner->createCapture();
+    if (!capture) {
+        return nullptr;
+    }
+    return std::make_shared<RecordingCapture>(std::move(capture), mWriter);
+}
+
+auto RecordingPlatform::createInjector() -> InputInjector::Ptr {
+    return mInner->createInjector();
+}
+
+auto RecordingPlatform::nextScreenChange(std::vector<ScreenInfo> known) -> IoTask<ScreenChangeEvent> {
+    ILIAS_CO_TRY(auto change, co_await mInner->nextScreenChange(std::move(known)));
+    (void) screens();
+    co_return change;
+}
+
+auto RecordingPlatform::createClipboard() -> Clipboard::Ptr {
+    return mInner->createClipboard();
+}
+
+auto RecordingPlatform::createDragSource() -> DragSource::Ptr {
+    return mInner->createDragSource();
+}
+
+// MARK: Replay capture
+
+ReplayCapture::ReplayCapture(InputRecordReader reader, ReplayOptions options)
+    : mReader(std::move(reader)), mOptions(std::move(options)) {
+}
+
+auto ReplayCapture::initialize() -> IoTask<void> {
+    co_return {};
+}
+
+auto ReplayCapture::shutdown() -> Task<void> {
+    co_return;
+}
+
+auto ReplayCapture::setRemoteControlActive(bool) -> IoResult<void> {
+    return {};
+}
+
+auto ReplayCapture::moveLocalCursor(uint32_t, int32_t, int32_t) -> IoResult<void> {
+    return {};
+}
+
+auto ReplayCapture::waitUntilDue(uint64_t timeNs) -> Task<void> {
+    if (mOptions.speed <= 0) {
+        // Still suspend once per event: the server drains capture without
+        // yielding, so sessions would otherwise never get to write.
+        co_await ilias::sleep(0ms);
+        co_return;
+    }
+    const auto offset = std::chrono::nanoseconds {
+        static_cast<int64_t>(static_cast<double>(timeNs - mBaseNs) / mOptions.speed)
+    };
+    const auto due = mStartTime + offset;
+    if (const auto now = std::chrono::steady_clock::now(); due > now) {
+        co_await ilias::sleep(due - now);
+    }
+}
+
+auto ReplayCapture::nextEvent() -> Task<InputEvent> {
+    if (!mStarted) {
+        while (mOptions.startGate && !mOptions.startGate()) {
+            co_await ilias::sleep(kGatePollInterval);
+        }
+        mStarted = true;
+        mStartTime = std::chrono::steady_clock::now();
+        SPDLOG_INFO("Replay started (speed {})", mOptions.speed);
+    }
+
+    while (true) {
+        auto next = mReader.nextEvent();
+        if (!next && mOptions.loop && mReplayed > 0) {
+            mReader.rewind();
+            mStartTime = std::chrono::steady_clock::now();
+            next = mReader.nextEvent();
+            mBaseNs = next ? next->timeNs : 0;
+        }
+        if (!next) {
+            if (!mFinished) {
+                SPDLOG_INFO("Replay finished after {} events", mReplayed);
+                mFinished = true;
+            }
+            // InputCapture has no end-of-stream; the caller watches finished().
+            co_await ilias::sleep(kParkInterval);
+            continue;
+        }
+        if (mReplayed == 0) {
+            mBaseNs = next->timeNs;
+        }
+        co_await waitUntilDue(next->timeNs);
+        ++mReplayed;
+        co_return next->event;
+    }
+}
+
+// MARK: Replay platform
+
+ReplayPlatform::ReplayPlatform(InputRecordReader reader, ReplayOptions options)
+    : mScreens(reader.screens()), mReader(std::move(reader)), mOptions(std::move(options)) {
+}
+
+auto ReplayPlatform::open(const std::filesystem::path &path, ReplayOptions options)
+    -> IoResult<std::shared_ptr<ReplayPlatform>> {
+    ILIAS_TRY(auto reader, InputRecordReader::open(path));
+    return std::shared_ptr<ReplayPlatform>(new ReplayPlatform(std::move(reader), std::move(options)));
+}
+
+auto ReplayPlatform::screens() const -> std::vector<ScreenInfo> {
+    return mScreens;
+}
+
+auto ReplayPlatform::createCapture() -> InputCapture::Ptr {
+    // One playback per platform: the reader moves into the capture.
+    if (!mReader) {
+        return nullptr;
+    }
+    mCapture = std::make_shared<ReplayCapture>(std::move(*mReader), std::move(mOptions));
+    mReader.reset();
+    return mCapture;
+}
+
+auto ReplayPlatform::createInjector() -> InputInjector::Ptr {
+    return nullptr;
+}
+
+auto parseReplaySpeed(std::string_view text) -> std::optional<double> {
+    if (text == "max") {
+        return 0.0;
+    }
+    auto value = 0.0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc {} || end != text.data() + text.size() || !(value > 0)) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+MKS_END
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "app/input_record.hpp"
+#include "platform/platform.hpp"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+MKS_BEGIN
+
+/**
+ * @brief Platform decorator that appends every captured event to a recording.
+ *
+ * Screens, injection and the clipboard pass straight through. The layout is
+ * snapshotted when the platform is created and again whenever @c screens()
+ * reports a different one, including each hot-plug change the inner
+ * platform reports.
+ */
+class RecordingPlatform final : public Platform {
+public:
+    RecordingPlatform(Platform::Ptr inner, std::shared_ptr<InputRecordWriter> writer);
+
+    auto screens() const -> std::vector<ScreenInfo> override;
+    auto createCapture() -> InputCapture::Ptr override;
+    auto createInjector() -> InputInjector::Ptr override;
+    auto nextScreenChange(std::vector<ScreenInfo> known) -> IoTask<ScreenChangeEvent> override;
+    auto createClipboard() -> Clipboard::Ptr override;
+    auto createDragSource() -> DragSource::Ptr override;
+
+private:
+    Platform::Ptr mInner;
+    std::shared_ptr<InputRecordWriter> mWriter;
+    mutable std::vector<ScreenInfo> mLastScreens;
+};
+
+struct ReplayOptions {
+    /** @brief Playback rate; 1 is original timing, 0 replays as fast as the server drains. */
+    double speed = 1.0;
+    /** @brief Start over at the end instead of finishing. */
+    bool loop = false;
+    /** @brief Polled before the first event (e.g. "enough clients connected"); empty starts at once. */
+    std::function<bool()> startGate;
+};
+
+/**
+ * @brief InputCapture that plays back a recording.
+ *
+ * Events are decoded from the mapping one at a time, so playback does not
+ * allocate per event. Remote control and cursor warps are accepted and
+ * ignored: the recorded events already contain the resulting motion.
+ */
+class ReplayCapture final : public InputCapture {
+public:
+    ReplayCapture(InputRecordReader reader, ReplayOptions options);
+
+    auto initialize() -> IoTask<void> override;
+    auto shutdown() -> Task<void> override;
+    auto nextEvent() -> Task<InputEvent> override;
+    auto setRemoteControlActive(bool active) -> IoResult<void> override;
+    auto moveLocalCursor(uint32_t screenIndex, int32_t x, int32_t y) -> IoResult<void> override;
+
+    /** @brief True once the last event was delivered (never when looping). */
+    auto finished() const noexcept -> bool { return mFinished; }
+    auto replayed() const noexcept -> uint64_t { return mReplayed; }
+
+private:
+    auto waitUntilDue(uint64_t timeNs) -> Task<void>;
+
+    InputRecordReader mReader;
+    ReplayOptions mOptions;
+    bool mStarted = false;
+    bool mFinished = false;
+    uint64_t mReplayed = 0;
+    uint64_t mBaseNs = 0; // Recording time mapped to mStartTime
+    std::chrono::steady_clock::time_point mStartTime;
+};
+
+/**
+ * @brief Capture-only platform serving a recording to a Server.
+ *
+ * Local screens come from the recording's first snapshot so recorded
+ * coordinates and edges line up. There is no injector.
+ */
+class ReplayPlatform final : public Platform {
+public:
+    static auto open(const std::filesystem::path &path, ReplayOptions options)
+        -> IoResult<std::shared_ptr<ReplayPlatform>>;
+
+    auto screens() const -> std::vector<ScreenInfo> override;
+    auto createCapture() -> InputCapture::Ptr override;
+    auto createInjector() -> InputInjector::Ptr override;
+
+    /** @brief Capture handed to the server, null before createCapture(). */
+    auto capture() const -> std::shared_ptr<ReplayCapture> { return mCapture; }
+
+private:
+    ReplayPlatform(InputRecordReader reader, ReplayOptions options);
+
+    std::vector<ScreenInfo> mScreens;
+    std::optional<InputRecordReader> mReader;
+    ReplayOptions mOptions;
+    std::shared_ptr<ReplayCapture> mCapture;
+};
+
+/** @brief Parse `--speed`: a positive factor ("1", "2.5") or "max". */
+auto parseReplaySpeed(std::string_view text) -> std::optional<double>;
+
+MKS_END
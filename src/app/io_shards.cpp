@@ -0,0 +1,544 @@
+#include "io_shards.hpp"
+#include "diag/metrics.hpp"
+#include "thread_tuning.hpp"
+
+#include <ilias/sync/oneshot.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#if defined(__linux__)
+    #include <arpa/inet.h>
+    #include <fcntl.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <poll.h>
+    #include <sys/eventfd.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+
+    #include <ilias/net/poller.hpp>
+    #include <ilias/platform.hpp>
+    #include <ilias/sync.hpp>
+#endif
+
+MKS_BEGIN
+
+#if defined(__linux__)
+
+namespace {
+
+// Jobs waiting for a shard to start them; one per accepted session, so this
+// is never close to full in practice.
+constexpr auto kShardInboxDepth = size_t {1024};
+
+struct ShardMetrics {
+    Counter &jobs;
+    Counter &refused;
+    Gauge &running;
+};
+
+auto shardMetrics() -> ShardMetrics & {
+    static auto result = ShardMetrics {
+        .jobs = metrics().counter("io_shards.jobs"),
+        .refused = metrics().counter("io_shards.refused"),
+        .running = metrics().gauge("io_shards.running"),
+    };
+    return result;
+}
+
+auto lastError() -> std::error_code {
+    return std::error_code(errno, std::generic_category());
+}
+
+// IPEndpoint only goes through text here: "a.b.c.d:port" or "[v6]:port".
+auto socketAddress(const IPEndpoint &endpoint) -> IoResult<std::pair<sockaddr_storage, socklen_t>> {
+    const auto text = fmtlib::format("{}", endpoint);
+    const auto colon = text.rfind(':');
+    if (colon == std::string::npos) {
+        return Err(std::make_error_code(std::errc::invalid_argument));
+    }
+    auto host = std::string_view {text}.substr(0, colon);
+    const auto port = static_cast<uint16_t>(std::stoul(text.substr(colon + 1)));
+    auto storage = sockaddr_storage {};
+    if (host.starts_with('[') && host.ends_with(']')) {
+        const auto address = std::string {host.substr(1, host.size() - 2)};
+        auto &v6 = reinterpret_cast<sockaddr_in6 &>(storage);
+        v6.sin6_family = AF_INET6;
+        v6.sin6_port = htons(port);
+        if (::inet_pton(AF_INET6, address.c_str(), &v6.sin6_addr) != 1) {
+            return Err(std::make_error_code(std::errc::invalid_argument));
+        }
+        return std::pair {storage, socklen_t {sizeof v6}};
+    }
+    const auto address = std::string {host};
+    auto &v4 = reinterpret_cast<sockaddr_in &>(storage);
+    v4.sin_family = AF_INET;
+    v4.sin_port = htons(port);
+    if (::inet_pton(AF_INET, address.c_str(), &v4.sin_addr) != 1) {
+        return Err(std::make_error_code(std::errc::invalid_argument));
+    }
+    return std::pair {storage, socklen_t {sizeof v4}};
+}
+
+auto endpointOf(const sockaddr_storage &storage) -> IoResult<IPEndpoint> {
+    char address[INET6_ADDRSTRLEN] {};
+    auto text = std::string {};
+    if (storage.ss_family == AF_INET6) {
+        const auto &v6 = reinterpret_cast<const sockaddr_in6 &>(storage);
+        ::inet_ntop(AF_INET6, &v6.sin6_addr, address, sizeof address);
+        text = fmtlib::format("[{}]:{}", address, ntohs(v6.sin6_port));
+    }
+    else {
+        const auto &v4 = reinterpret_cast<const sockaddr_in &>(storage);
+        ::inet_ntop(AF_INET, &v4.sin_addr, address, sizeof address);
+        text = fmtlib::format("{}:{}", address, ntohs(v4.sin_port));
+    }
+    auto endpoint = IPEndpoint::fromString(text);
+    if (!endpoint) {
+        return Err(std::make_error_code(std::errc::address_family_not_supported));
+    }
+    return *endpoint;
+}
+
+} // namespace
+
+// MARK: Wakeup
+
+IoWakeup::~IoWakeup() {
+    if (mFd >= 0) {
+        ::close(mFd);
+    }
+}
+
+auto IoWakeup::open() -> IoResult<void> {
+    mFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (mFd < 0) {
+        return Err(lastError());
+    }
+    return {};
+}
+
+auto IoWakeup::prepare() noexcept -> void {
+    // Paired with the fence in notify(): the queues publish with release
+    // stores, which alone may pass a later load, so both sides order their
+    // store before their look at the other's. Then either the consumer's
+    // second look sees the item or the producer sees it waiting.
+    mWaiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+auto IoWakeup::consume() noexcept -> void {
+    auto count = uint64_t {0};
+    (void) ::read(mFd, &count, sizeof count);
+}
+
+auto IoWakeup::notify() noexcept -> void {
+    // Keeps the caller's publish ahead of the load below; see prepare().
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mWaiting.load(std::memory_order_relaxed) && mWaiting.exchange(false)) {
+        const auto one = uint64_t {1};
+        // Only fails once the counter is near overflow, when it is readable anyway.
+        (void) ::write(mFd, &one, sizeof one);
+    }
+}
+
+// MARK: Socket stream
+
+struct SocketStream::Poll {
+    ilias::Poller poller;
+};
+
+SocketStream::SocketStream(int fd) noexcept : mFd(fd) {
+}
+
+SocketStream::SocketStream(SocketStream &&other) noexcept
+    : mFd(std::exchange(other.mFd, -1)),
+      mPoll(std::move(other.mPoll)) {
+}
+
+auto SocketStream::operator=(SocketStream &&other) noexcept -> SocketStream & {
+    if (this != &other) {
+        mPoll.reset();
+        if (mFd >= 0) {
+            ::close(mFd);
+        }
+        mFd = std::exchange(other.mFd, -1);
+        mPoll = std::move(other.mPoll);
+    }
+    return *this;
+}
+
+SocketStream::~SocketStream() {
+    // The poller deregisters before the descriptor goes.
+    mPoll.reset();
+    if (mFd >= 0) {
+        ::close(mFd);
+    }
+}
+
+auto SocketStream::wait(uint32_t events) -> IoTask<void> {
+    if (!mPoll) {
+        ILIAS_CO_TRY(auto poller, co_await ilias::Poller::make(mFd, ilias::IoDescriptor::Socket));
+        mPoll = std::make_unique<Poll>(Poll {std::move(poller)});
+    }
+    if (auto ready = co_await mPoll->poller.poll(events); !ready) {
+        co_return Err(ready.error());
+    }
+    co_return {};
+}
+
+auto SocketStream::read(ilias::MutableBuffer buffer) -> IoTask<size_t> {
+    while (true) {
+        const auto count = ::recv(mFd, buffer.data(), buffer.size(), MSG_DONTWAIT);
+        if (count >= 0) {
+            co_return static_cast<size_t>(count);
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            co_return Err(lastError());
+        }
+        ILIAS_CO_TRYV(co_await wait(POLLIN));
+    }
+}
+
+auto SocketStream::write(ilias::Buffer buffer) -> IoTask<size_t> {
+    while (true) {
+        const auto count = ::send(mFd, buffer.data(), buffer.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (count >= 0) {
+            co_return static_cast<size_t>(count);
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            co_return Err(lastError());
+        }
+        ILIAS_CO_TRYV(co_await wait(POLLOUT));
+    }
+}
+
+auto SocketStream::flush() -> IoTask<void> {
+    // Nothing is buffered above the socket.
+    co_return {};
+}
+
+auto SocketStream::shutdown() -> IoTask<void> {
+    if (::shutdown(mFd, SHUT_RDWR) != 0 && errno != ENOTCONN) {
+        co_return Err(lastError());
+    }
+    co_return {};
+}
+
+auto SocketStream::remoteEndpoint() const -> IoResult<IPEndpoint> {
+    auto storage = sockaddr_storage {};
+    auto size = socklen_t {sizeof storage};
+    if (::getpeername(mFd, reinterpret_cast<sockaddr *>(&storage), &size) != 0) {
+        return Err(lastError());
+    }
+    return endpointOf(storage);
+}
+
+auto SocketStream::duplicate() const -> IoResult<SocketStream> {
+    const auto fd = ::fcntl(mFd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) {
+        return Err(lastError());
+    }
+    return SocketStream {fd};
+}
+
+// MARK: Acceptor
+
+TcpAcceptor::TcpAcceptor(SocketStream socket) noexcept : mSocket(std::move(socket)) {
+}
+
+auto TcpAcceptor::bind(const IPEndpoint &endpoint) -> IoResult<TcpAcceptor> {
+    ILIAS_TRY(auto address, socketAddress(endpoint));
+    auto &[storage, size] = address;
+    const auto fd = ::socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return Err(lastError());
+    }
+    auto socket = SocketStream {fd};
+    // Like the ilias listener: a restarted server can bind while old
+    // connections sit in TIME_WAIT.
+    const auto on = 1;
+    (void) ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+    if (::bind(fd, reinterpret_cast<const sockaddr *>(&storage), size) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+        return Err(lastError());
+    }
+    return TcpAcceptor {std::move(socket)};
+}
+
+auto TcpAcceptor::localEndpoint() const -> IoResult<IPEndpoint> {
+    auto storage = sockaddr_storage {};
+    auto size = socklen_t {sizeof storage};
+    if (::getsockname(mSocket.mFd, reinterpret_cast<sockaddr *>(&storage), &size) != 0) {
+        return Err(lastError());
+    }
+    return endpointOf(storage);
+}
+
+auto TcpAcceptor::accept() -> IoTask<SocketStream> {
+    while (true) {
+        const auto fd = ::accept4(mSocket.mFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd >= 0) {
+            const auto on = 1;
+            (void) ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+            co_return SocketStream {fd};
+        }
+        if (errno == EINTR || errno == ECONNABORTED) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            co_return Err(lastError());
+        }
+        ILIAS_CO_TRYV(co_await mSocket.wait(POLLIN));
+    }
+}
+
+// MARK: Shards
+
+struct IoShards::Shard {
+    MpscQueue<Job> inbox {kShardInboxDepth};
+    IoWakeup wakeup;
+    std::atomic<size_t> tasks {0};
+    std::atomic<bool> stopping {false};
+};
+
+namespace {
+
+auto runAndCount(Task<void> task, std::atomic<size_t> &tasks) -> Task<void> {
+    co_await std::move(task);
+    tasks.fetch_sub(1, std::memory_order_relaxed);
+    shardMetrics().running.add(-1);
+}
+
+auto runAndReply(
+    std::move_only_function<IoTask<void>()> job,
+    ilias::oneshot::Sender<IoResult<void>> sender
+) -> Task<void> {
+    auto result = co_await job();
+    (void) sender.send(std::move(result));
+}
+
+} // namespace
+
+IoShards::IoShards() {
+    (void) shardMetrics();
+}
+
+IoShards::~IoShards() {
+    stop();
+}
+
+auto IoShards::start(size_t threads) -> IoResult<void> {
+    if (!mShards.empty() || threads == 0) {
+        return Err(std::make_error_code(std::errc::invalid_argument));
+    }
+    auto shards = std::vector<std::unique_ptr<Shard>> {};
+    for (auto index = size_t {0}; index < threads; ++index) {
+        auto shard = std::make_unique<Shard>();
+        ILIAS_TRYV(shard->wakeup.open());
+        shards.push_back(std::move(shard));
+    }
+    mShards = std::move(shards);
+    mThreads.reserve(threads);
+    for (auto &shard : mShards) {
+        mThreads.emplace_back([&shard = *shard] {
+            resetThreadTuning();
+            auto context = ilias::PlatformContext {};
+            context.install();
+            serve(shard).wait();
+        });
+    }
+    SPDLOG_INFO("Server I/O shards started: {}", threads);
+    return {};
+}
+
+auto IoShards::stop() -> void {
+    for (auto &shard : mShards) {
+        shard->stopping.store(true, std::memory_order_seq_cst);
+        shard->wakeup.notify();
+    }
+    mThreads.clear();
+    mShards.clear();
+}
+
+auto IoShards::post(Job job) -> bool {
+    if (mShards.empty()) {
+        return false;
+    }
+    // A handful of shards; scanning them is cheaper than keeping them sorted.
+    auto *target = mShards.front().get();
+    for (const auto &shard : mShards) {
+        if (shard->tasks.load(std::memory_order_relaxed) < target->tasks.load(std::memory_order_relaxed)) {
+            target = shard.get();
+        }
+    }
+    if (!target->inbox.tryPush(std::move(job))) {
+        shardMetrics().refused.add();
+        return false;
+    }
+    target->tasks.fetch_add(1, std::memory_order_relaxed);
+    shardMetrics().jobs.add();
+    shardMetrics().running.add(1);
+    target->wakeup.notify();
+    return true;
+}
+
+auto IoShards::run(std::move_only_function<IoTask<void>()> job) -> IoTask<void> {
+    auto [sender, receiver] = ilias::oneshot::channel<IoResult<void>>();
+    auto posted = post([job = std::move(job), sender = std::move(sender)]() mutable {
+        return runAndReply(std::move(job), std::move(sender));
+    });
+    if (!posted) {
+        co_return Err(std::make_error_code(std::errc::resource_unavailable_try_again));
+    }
+    auto result = co_await std::move(receiver);
+    if (!result) {
+        co_return Err(std::make_error_code(std::errc::operation_canceled));
+    }
+    co_return std::move(*result);
+}
+
+auto IoShards::serve(Shard &shard) -> Task<void> {
+    auto poller = co_await ilias::Poller::make(shard.wakeup.fd(), ilias::IoDescriptor::Socket);
+    if (!poller) {
+        SPDLOG_ERROR("Server I/O shard failed to poll its inbox: {}", poller.error().message());
+        co_return;
+    }
+    co_await ilias::TaskScope::enter([&](auto &scope) -> Task<void> {
+        while (!shard.stopping.load(std::memory_order_seq_cst)) {
+            while (auto job = shard.inbox.tryPop()) {
+                scope.spawn(runAndCount((*job)(), shard.tasks));
+            }
+            shard.wakeup.prepare();
+            if (!shard.inbox.empty() || shard.stopping.load(std::memory_order_seq_cst)) {
+                continue;
+            }
+            if (auto ready = co_await poller->poll(POLLIN); !ready) {
+                SPDLOG_ERROR("Server I/O shard failed to poll its inbox: {}", ready.error().message());
+                co_return;
+            }
+            shard.wakeup.consume();
+        }
+    });
+}
+
+#else
+
+namespace {
+
+auto unsupported() -> std::error_code {
+    return std::make_error_code(std::errc::operation_not_supported);
+}
+
+} // namespace
+
+IoWakeup::~IoWakeup() = default;
+
+auto IoWakeup::open() -> IoResult<void> {
+    return Err(unsupported());
+}
+
+auto IoWakeup::prepare() noexcept -> void {
+}
+
+auto IoWakeup::consume() noexcept -> void {
+}
+
+auto IoWakeup::notify() noexcept -> void {
+}
+
+struct SocketStream::Poll {};
+
+SocketStream::SocketStream(int fd) noexcept : mFd(fd) {
+}
+
+SocketStream::SocketStream(SocketStream &&other) noexcept : mFd(std::exchange(other.mFd, -1)) {
+}
+
+auto SocketStream::operator=(SocketStream &&other) noexcept -> SocketStream & {
+    mFd = std::exchange(other.mFd, -1);
+    return *this;
+}
+
+SocketStream::~SocketStream() = default;
+
+auto SocketStream::wait(uint32_t) -> IoTask<void> {
+    co_return Err(unsupported());
+}
+
+auto SocketStream::read(ilias::MutableBuffer) -> IoTask<size_t> {
+    co_return Err(unsupported());
+}
+
+auto SocketStream::write(ilias::Buffer) -> IoTask<size_t> {
+    co_return Err(unsupported());
+}
+
+auto SocketStream::flush() -> IoTask<void> {
+    co_return {};
+}
+
+auto SocketStream::shutdown() -> IoTask<void> {
+    co_return Err(unsupported());
+}
+
+auto SocketStream::remoteEndpoint() const -> IoResult<IPEndpoint> {
+    return Err(unsupported());
+}
+
+auto SocketStream::duplicate() const -> IoResult<SocketStream> {
+    return Err(unsupported());
+}
+
+TcpAcceptor::TcpAcceptor(SocketStream socket) noexcept : mSocket(std::move(socket)) {
+}
+
+auto TcpAcceptor::bind(const IPEndpoint &) -> IoResult<TcpAcceptor> {
+    return Err(unsupported());
+}
+
+auto TcpAcceptor::localEndpoint() const -> IoResult<IPEndpoint> {
+    return Err(unsupported());
+}
+
+auto TcpAcceptor::accept() -> IoTask<SocketStream> {
+    co_return Err(unsupported());
+}
+
+struct IoShards::Shard {};
+
+IoShards::IoShards() = default;
+
+IoShards::~IoShards() = default;
+
+auto IoShards::start(size_t) -> IoResult<void> {
+    return Err(unsupported());
+}
+
+auto IoShards::stop() -> void {
+}
+
+auto IoShards::post(Job) -> bool {
+    return false;
+}
+
+auto IoShards::run(std::move_only_function<IoTask<void>()>) -> IoTask<void> {
+    co_return Err(unsupported());
+}
+
+auto IoShards::serve(Shard &) -> Task<void> {
+    co_return;
+}
+
+#endif
+
+MKS_END
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "mpsc_queue.hpp"
+#include <ilias/io.hpp>
+#include <ilias/net.hpp>
+#include <ilias/task.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+MKS_BEGIN
+
+using ilias::IPEndpoint;
+
+/**
+ * @brief Wakes one consumer coroutine from producers on any thread (eventfd).
+ *
+ * The consumer calls @c prepare(), looks at its queue once more and only then
+ * polls @c fd() for readability, calling @c consume() after it woke. A
+ * producer calls @c notify() after publishing; it writes the eventfd only
+ * when it finds the consumer asleep, so a busy consumer costs no system calls.
+ * Same protocol as the @c waiting flag of @c mks_event_ring.h.
+ */
+class IoWakeup {
+public:
+    IoWakeup() = default;
+    IoWakeup(const IoWakeup &) = delete;
+    ~IoWakeup();
+
+    auto open() -> IoResult<void>;
+    auto fd() const noexcept -> int { return mFd; }
+
+    /** @brief Consumer: about to sleep. Check the queue again before polling. */
+    auto prepare() noexcept -> void;
+    /** @brief Consumer: reset the eventfd after it polled readable. */
+    auto consume() noexcept -> void;
+    /** @brief Producer: call after publishing, from any thread. */
+    auto notify() noexcept -> void;
+
+private:
+    int mFd = -1;
+    std::atomic<bool> mWaiting {false};
+};
+
+/**
+ * @brief Connected non-blocking TCP socket usable from whichever thread awaits it.
+ *
+ * An ilias @c TcpStream stays with the context it was created on; this one
+ * registers with the context of the thread that first waits on it, so the
+ * routing thread can accept a socket and an I/O shard can write to a
+ * @ref duplicate of it. Satisfies the stream concept @c ilias::DynStream
+ * wraps. Linux only; elsewhere every operation fails.
+ */
+class SocketStream {
+public:
+    /** @param fd Connected, non-blocking; owned. */
+    explicit SocketStream(int fd) noexcept;
+    SocketStream(SocketStream &&other) noexcept;
+    auto operator=(SocketStream &&other) noexcept -> SocketStream &;
+    ~SocketStream();
+
+    auto read(ilias::MutableBuffer buffer) -> IoTask<size_t>;
+    auto write(ilias::Buffer buffer) -> IoTask<size_t>;
+    auto flush() -> IoTask<void>;
+    /** @brief Shut down both directions; a duplicate sees its writes fail. */
+    auto shutdown() -> IoTask<void>;
+
+    auto remoteEndpoint() const -> IoResult<IPEndpoint>;
+    /** @brief Another descriptor for the same socket, to be waited on elsewhere. */
+    auto duplicate() const -> IoResult<SocketStream>;
+
+private:
+    friend class TcpAcceptor;
+    struct Poll;
+
+    auto wait(uint32_t events) -> IoTask<void>;
+
+    int mFd = -1;
+    // Created on first wait, on the thread that waits.
+    std::unique_ptr<Poll> mPoll;
+};
+
+/**
+ * @brief Listening TCP socket handing out @ref SocketStream (Linux).
+ */
+class TcpAcceptor {
+public:
+    static auto bind(const IPEndpoint &endpoint) -> IoResult<TcpAcceptor>;
+
+    auto localEndpoint() const -> IoResult<IPEndpoint>;
+    /** @brief Next connection, with @c TCP_NODELAY set. */
+    auto accept() -> IoTask<SocketStream>;
+
+private:
+    explicit TcpAcceptor(SocketStream socket) noexcept;
+
+    // Never read or written; only polled for incoming connections.
+    SocketStream mSocket;
+};
+
+/**
+ * @brief Threads with an ilias context each, for connection I/O off the routing thread.
+ *
+ * The routing thread captures and routes input; with many clients, encoding
+ * and writing every client's messages on it would put their cost between
+ * capture and routing. A job posted here runs as a task on the least busy
+ * shard. Jobs reach the shard through a lock-free @ref MpscQueue and an
+ * @ref IoWakeup, so posting never takes a lock.
+ *
+ * Off by default (no threads); @c start() is Linux only.
+ */
+class IoShards {
+public:
+    /**
+     * @brief Produces the task to run, called on the shard.
+     *
+     * The task must own what it uses: the job itself is destroyed as soon as
+     * it returned the task.
+     */
+    using Job = std::move_only_function<Task<void>()>;
+
+    IoShards();
+    IoShards(const IoShards &) = delete;
+    /** @brief Stops the shards; see @c stop(). */
+    ~IoShards();
+
+    /** @brief Start @p threads shards; fails when started already or unsupported. */
+    auto start(size_t threads) -> IoResult<void>;
+
+    /**
+     * @brief Stop accepting jobs and join the threads.
+     *
+     * A shard ends through the TaskScope its tasks run under; close what
+     * they wait on first, or the join waits with them.
+     */
+    auto stop() -> void;
+
+    auto size() const noexcept -> size_t { return mShards.size(); }
+
+    /** @brief Run @p job on the shard with the fewest tasks; false when not started or its inbox is full. */
+    auto post(Job job) -> bool;
+
+    /**
+     * @brief Run @p job on a shard and resume with its result.
+     *
+     * Cancelling the awaiting coroutine does not cancel the job; close what
+     * it waits on instead.
+     */
+    auto run(std::move_only_function<IoTask<void>()> job) -> IoTask<void>;
+
+private:
+    struct Shard;
+
+    static auto serve(Shard &shard) -> Task<void>;
+
+    std::vector<std::unique_ptr<Shard>> mShards;
+    std::vector<std::jthread> mThreads; // Last, so shards stop before their state goes away
+};
+
+MKS_END
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+MKS_BEGIN
+
+/**
+ * @brief Bounded lock-free queue for many producer threads and one consumer.
+ *
+ * Each slot carries a sequence number (Vyukov's bounded queue): a producer
+ * claims a slot with one compare-exchange on the head and publishes it with a
+ * release store of the slot's sequence, so producers never wait for each
+ * other or for the consumer. A full queue refuses the push instead of
+ * blocking; what to do then (drop, retry later) is the caller's policy.
+ *
+ * @c tryPop, @c empty and the destructor belong to the single consumer.
+ */
+template <typename T>
+class MpscQueue {
+public:
+    /** @param capacity Slots, rounded up to a power of two (at least 2). */
+    explicit MpscQueue(size_t capacity)
+        : mMask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+          mSlots(std::make_unique<Slot[]>(mMask + 1)) {
+        for (auto index = size_t {0}; index <= mMask; ++index) {
+            mSlots[index].sequence.store(index, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+
+    auto capacity() const noexcept -> size_t { return mMask + 1; }
+
+    /**
+     * @brief Queue @p value; any thread.
+     *
+     * @return false when the queue is full, leaving @p value untouched.
+     */
+    auto tryPush(T &&value) -> bool {
+        auto head = mHead.load(std::memory_order_relaxed);
+        while (true) {
+            auto &slot = mSlots[head & mMask];
+            const auto sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto lag = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(head);
+            if (lag == 0) {
+                if (mHead.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                    slot.value.emplace(std::move(value));
+                    slot.sequence.store(head + 1, std::memory_order_release);
+                    return true;
+                }
+                // head was reloaded by the failed exchange.
+            }
+            else if (lag < 0) {
+                // The consumer has not freed this slot from the previous lap.
+                return false;
+            }
+            else {
+                head = mHead.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** @brief Oldest published value, if any; consumer only. */
+    auto tryPop() -> std::optional<T> {
+        auto &slot = mSlots[mTail & mMask];
+        if (slot.sequence.load(std::memory_order_acquire) != mTail + 1) {
+            return std::nullopt;
+        }
+        auto value = std::move(*slot.value);
+        slot.value.reset();
+        // Free for the producer one lap ahead.
+        slot.sequence.store(mTail + mMask + 1, std::memory_order_release);
+        ++mTail;
+        return value;
+    }
+
+    /**
+     * @brief Whether tryPop() would return nothing right now; consumer only.
+     *
+     * A push that has claimed its slot but not published it yet reads as empty.
+     */
+    auto empty() const noexcept -> bool {
+        return mSlots[mTail & mMask].sequence.load(std::memory_order_acquire) != mTail + 1;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence {0};
+        std::optional<T> value;
+    };
+
+    const size_t mMask;
+    std::unique_ptr<Slot[]> mSlots;
+    // Producers and the consumer each get a cache line, so a push does not
+    // invalidate the line the consumer reads its cursor from.
+    alignas(64) std::atomic<size_t> mHead {0};
+    alignas(64) size_t mTail = 0;
+};
+
+MKS_END
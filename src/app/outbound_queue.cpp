@@ -0,0 +1,138 @@
+#include "outbound_queue.hpp"
+
+#include <chrono>
+#include <system_error>
+#include <utility>
+
+#if defined(__linux__)
+    #include <poll.h>
+
+    #include <ilias/net/poller.hpp>
+#endif
+
+MKS_BEGIN
+
+namespace {
+
+// How long a clipboard chunk waits before looking at a full lane again.
+constexpr auto kFullLaneRetry = std::chrono::milliseconds {1};
+
+} // namespace
+
+// MARK: Queue
+
+OutboundQueue::OutboundQueue(size_t urgentDepth, size_t bulkDepth)
+    : mUrgent(urgentDepth),
+      mBulk(bulkDepth) {
+}
+
+auto OutboundQueue::create(size_t urgentDepth, size_t bulkDepth) -> IoResult<std::shared_ptr<OutboundQueue>> {
+    auto queue = std::make_shared<OutboundQueue>(urgentDepth, bulkDepth);
+    ILIAS_TRYV(queue->mWakeup.open());
+    return queue;
+}
+
+auto OutboundQueue::push(Lane lane, RpcMessage &&message) -> bool {
+    if (closed()) {
+        return false;
+    }
+    auto &target = lane == Lane::Urgent ? mUrgent : mBulk;
+    if (!target.tryPush(std::move(message))) {
+        return false;
+    }
+    mWakeup.notify();
+    return true;
+}
+
+auto OutboundQueue::close() -> void {
+    mClosed.store(true, std::memory_order_release);
+    mWakeup.notify();
+}
+
+// MARK: Receiver
+
+#if defined(__linux__)
+
+struct OutboundReceiver::Poll {
+    ilias::Poller poller;
+};
+
+#else
+
+struct OutboundReceiver::Poll {};
+
+#endif
+
+OutboundReceiver::OutboundReceiver(std::shared_ptr<OutboundQueue> queue) : mQueue(std::move(queue)) {
+}
+
+OutboundReceiver::OutboundReceiver(OutboundReceiver &&) noexcept = default;
+
+// Out of line, where Poll is complete; the poller goes before the queue's eventfd.
+OutboundReceiver::~OutboundReceiver() = default;
+
+auto OutboundReceiver::recv() -> IoTask<RpcMessage> {
+#if defined(__linux__)
+    auto &queue = *mQueue;
+    while (true) {
+        if (auto message = queue.mUrgent.tryPop()) {
+            co_return std::move(*message);
+        }
+        if (auto chunk = queue.mBulk.tryPop()) {
+            co_return std::move(*chunk);
+        }
+        if (queue.closed()) {
+            co_return Err(std::make_error_code(std::errc::operation_canceled));
+        }
+        queue.mWakeup.prepare();
+        if (!queue.mUrgent.empty() || !queue.mBulk.empty() || queue.closed()) {
+            continue;
+        }
+        if (!mPoll) {
+            ILIAS_CO_TRY(auto poller, co_await ilias::Poller::make(queue.mWakeup.fd(), ilias::IoDescriptor::Socket));
+            mPoll = std::make_unique<Poll>(Poll {std::move(poller)});
+        }
+        if (auto ready = co_await mPoll->poller.poll(POLLIN); !ready) {
+            co_return Err(ready.error());
+        }
+        queue.mWakeup.consume();
+    }
+#else
+    co_return Err(std::make_error_code(std::errc::operation_not_supported));
+#endif
+}
+
+// MARK: Sender
+
+OutboundSender::OutboundSender(ilias::mpsc::Sender<RpcMessage> channel) : mChannel(std::move(channel)) {
+}
+
+OutboundSender::OutboundSender(std::shared_ptr<OutboundQueue> queue, OutboundQueue::Lane lane)
+    : mQueue(std::move(queue)),
+      mLane(lane) {
+}
+
+auto OutboundSender::trySend(RpcMessage message) -> bool {
+    if (mQueue) {
+        return mQueue->push(mLane, std::move(message));
+    }
+    return static_cast<bool>(mChannel.trySend(std::move(message)));
+}
+
+auto OutboundSender::send(RpcMessage message) -> Task<bool> {
+    if (!mQueue) {
+        co_return static_cast<bool>(co_await mChannel.send(std::move(message)));
+    }
+    // Copied: the session may end while the message waits for room.
+    auto queue = mQueue;
+    const auto lane = mLane;
+    while (!queue->push(lane, std::move(message))) {
+        if (queue->closed()) {
+            co_return false;
+        }
+        co_await ilias::sleep(kFullLaneRetry);
+    }
+    co_return true;
+}
+
+MKS_END
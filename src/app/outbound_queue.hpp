@@ -0,0 +1,102 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "io_shards.hpp"
+#include "mpsc_queue.hpp"
+#include "rpc/message.hpp"
+#include <ilias/sync.hpp>
+#include <ilias/task.hpp>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+
+MKS_BEGIN
+
+/**
+ * @brief Messages for one connection whose writer runs on an I/O shard.
+ *
+ * Two lock-free lanes: @c Urgent (input, offers, control) and @c Bulk
+ * (clipboard chunks), popped urgent first like @ref nextOutbound. Producers
+ * are the routing thread's coroutines, through @ref OutboundSender; the one
+ * consumer is the writer, through @ref OutboundReceiver.
+ */
+class OutboundQueue {
+public:
+    enum class Lane {
+        Urgent,
+        Bulk,
+    };
+
+    static auto create(size_t urgentDepth, size_t bulkDepth) -> IoResult<std::shared_ptr<OutboundQueue>>;
+
+    OutboundQueue(size_t urgentDepth, size_t bulkDepth);
+    OutboundQueue(const OutboundQueue &) = delete;
+
+    /** @brief Queue @p message; false when the lane is full or the queue closed. */
+    auto push(Lane lane, RpcMessage &&message) -> bool;
+
+    /** @brief Refuse further messages and wake the writer so it can end; any thread. */
+    auto close() -> void;
+    auto closed() const noexcept -> bool { return mClosed.load(std::memory_order_acquire); }
+
+private:
+    friend class OutboundReceiver;
+
+    MpscQueue<RpcMessage> mUrgent;
+    MpscQueue<RpcMessage> mBulk;
+    IoWakeup mWakeup;
+    std::atomic<bool> mClosed {false};
+};
+
+/**
+ * @brief The writer's end of an @ref OutboundQueue; lives on the writer's thread.
+ */
+class OutboundReceiver {
+public:
+    explicit OutboundReceiver(std::shared_ptr<OutboundQueue> queue);
+    OutboundReceiver(OutboundReceiver &&) noexcept;
+    ~OutboundReceiver();
+
+    /** @brief Next message, urgent first; operation_canceled once the queue is closed. */
+    auto recv() -> IoTask<RpcMessage>;
+
+private:
+    struct Poll;
+
+    std::shared_ptr<OutboundQueue> mQueue;
+    // The poller registers with the context of the thread that first waits.
+    std::unique_ptr<Poll> mPoll;
+};
+
+/**
+ * @brief Handle producers hold to queue messages for one connection.
+ *
+ * Either an ilias channel, drained by a writer on the same event loop, or a
+ * lane of an @ref OutboundQueue, drained by a writer on an I/O shard. Copies
+ * refer to the same queue.
+ */
+class OutboundSender {
+public:
+    OutboundSender() = default;
+    OutboundSender(ilias::mpsc::Sender<RpcMessage> channel);
+    OutboundSender(std::shared_ptr<OutboundQueue> queue, OutboundQueue::Lane lane);
+
+    /** @brief Queue without waiting; false when full or the connection is gone. */
+    auto trySend(RpcMessage message) -> bool;
+
+    /**
+     * @brief Queue, waiting for room; false once the connection is gone.
+     *
+     * A full @ref OutboundQueue lane is retried every millisecond: only
+     * clipboard chunks wait like this, and only while one is in flight.
+     */
+    auto send(RpcMessage message) -> Task<bool>;
+
+private:
+    ilias::mpsc::Sender<RpcMessage> mChannel;
+    std::shared_ptr<OutboundQueue> mQueue;
+    OutboundQueue::Lane mLane = OutboundQueue::Lane::Urgent;
+};
+
+MKS_END
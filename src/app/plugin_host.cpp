@@ -0,0 +1,355 @@
+#include "plugin_host.hpp"
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <dlfcn.h>
+#endif
+
+MKS_BEGIN
+
+THIS_ERROR_IMPL(PluginError);
+
+namespace {
+
+// Input reaches plugins as a pointer to the captured event itself, so each C
+// struct must lay out exactly like its C++ counterpart.
+template <typename C, typename Cpp>
+constexpr auto kSameLayout = sizeof(C) == sizeof(Cpp) && alignof(C) == alignof(Cpp) &&
+                             std::is_standard_layout_v<Cpp> && std::is_trivially_copyable_v<Cpp>;
+
+static_assert(kSameLayout<mks_key_event, KeyEvent>);
+static_assert(offsetof(mks_key_event, key) == offsetof(KeyEvent, key));
+static_assert(offsetof(mks_key_event, modifiers) == offsetof(KeyEvent, modifiers));
+static_assert(offsetof(mks_key_event, native_code) == offsetof(KeyEvent, nativeCode));
+static_assert(offsetof(mks_key_event, repeat) == offsetof(KeyEvent, repeat));
+static_assert(offsetof(mks_key_event, release) == offsetof(KeyEvent, release));
+
+static_assert(kSameLayout<mks_mouse_button_event, MouseButtonEvent>);
+static_assert(offsetof(mks_mouse_button_event, x) == offsetof(MouseButtonEvent, x));
+static_assert(offsetof(mks_mouse_button_event, y) == offsetof(MouseButtonEvent, y));
+static_assert(offsetof(mks_mouse_button_event, screen_index) == offsetof(MouseButtonEvent, screenIndex));
+static_assert(offsetof(mks_mouse_button_event, button) == offsetof(MouseButtonEvent, button));
+static_assert(offsetof(mks_mouse_button_event, release) == offsetof(MouseButtonEvent, release));
+
+static_assert(kSameLayout<mks_mouse_move_event, MouseMoveEvent>);
+static_assert(offsetof(mks_mouse_move_event, x) == offsetof(MouseMoveEvent, x));
+static_assert(offsetof(mks_mouse_move_event, y) == offsetof(MouseMoveEvent, y));
+static_assert(offsetof(mks_mouse_move_event, screen_index) == offsetof(MouseMoveEvent, screenIndex));
+static_assert(offsetof(mks_mouse_move_event, delta_x) == offsetof(MouseMoveEvent, deltaX));
+static_assert(offsetof(mks_mouse_move_event, delta_y) == offsetof(MouseMoveEvent, deltaY));
+
+static_assert(kSameLayout<mks_mouse_wheel_event, MouseWheelEvent>);
+static_assert(offsetof(mks_mouse_wheel_event, x) == offsetof(MouseWheelEvent, x));
+static_assert(offsetof(mks_mouse_wheel_event, y) == offsetof(MouseWheelEvent, y));
+static_assert(offsetof(mks_mouse_wheel_event, delta_x) == offsetof(MouseWheelEvent, deltaX));
+static_assert(offsetof(mks_mouse_wheel_event, delta_y) == offsetof(MouseWheelEvent, deltaY));
+
+// ServerEvents::publish maps variant index i to event bit i.
+static_assert(std::is_same_v<std::variant_alternative_t<0, InputEvent>, KeyEvent> && MKS_EVENT_KEY == 1U << 0);
+static_assert(std::is_same_v<std::variant_alternative_t<1, InputEvent>, MouseButtonEvent> &&
+              MKS_EVENT_MOUSE_BUTTON == 1U << 1);
+static_assert(std::is_same_v<std::variant_alternative_t<2, InputEvent>, MouseMoveEvent> &&
+              MKS_EVENT_MOUSE_MOVE == 1U << 2);
+static_assert(std::is_same_v<std::variant_alternative_t<3, InputEvent>, MouseWheelEvent> &&
+              MKS_EVENT_MOUSE_WHEEL == 1U << 3);
+
+auto viewOf(std::string_view text) noexcept -> mks_string {
+    return mks_string {.data = text.data(), .size = text.size()};
+}
+
+} // namespace
+
+// MARK: Loading
+
+/** @brief An open shared library, closed on destruction. */
+struct PluginHost::Library {
+#if defined(_WIN32)
+    HMODULE handle = nullptr;
+#else
+    void *handle = nullptr;
+#endif
+
+    Library() = default;
+    Library(const Library &) = delete;
+
+    ~Library() {
+        if (!handle) {
+            return;
+        }
+#if defined(_WIN32)
+        ::FreeLibrary(handle);
+#else
+        ::dlclose(handle);
+#endif
+    }
+
+    auto entry() const -> mks_plugin_entry_fn {
+#if defined(_WIN32)
+        return reinterpret_cast<mks_plugin_entry_fn>(::GetProcAddress(handle, MKS_PLUGIN_ENTRY_NAME));
+#else
+        return reinterpret_cast<mks_plugin_entry_fn>(::dlsym(handle, MKS_PLUGIN_ENTRY_NAME));
+#endif
+    }
+};
+
+/** @brief One created plugin; its address is the context the plugin calls back with. */
+struct PluginHost::Loaded {
+    PluginHost *owner = nullptr;
+    const mks_plugin *plugin = nullptr;
+    std::string name;
+    // Null for plugins linked into the process.
+    std::unique_ptr<Library> library;
+    mks_plugin_host host {};
+    void *instance = nullptr;
+    uint32_t events = 0;
+    // The instance came through attach() and is not ours to destroy.
+    bool attached = false;
+};
+
+PluginHost::PluginHost() = default;
+
+PluginHost::~PluginHost() {
+    // Newest first, and each instance before the library that holds its code.
+    while (!mPlugins.empty()) {
+        auto &loaded = *mPlugins.back();
+        if (!loaded.attached && loaded.plugin->destroy) {
+            loaded.plugin->destroy(loaded.instance);
+        }
+        mPlugins.pop_back();
+    }
+}
+
+auto PluginHost::load(const std::filesystem::path &path) -> IoResult<void> {
+    auto library = std::make_unique<Library>();
+#if defined(_WIN32)
+    library->handle = ::LoadLibraryW(path.c_str());
+    if (!library->handle) {
+        SPDLOG_ERROR("Failed to load plugin {}: error {}", path.string(), ::GetLastError());
+        return Err(PluginError::LoadFailed);
+    }
+#else
+    library->handle = ::dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!library->handle) {
+        SPDLOG_ERROR("Failed to load plugin {}: {}", path.string(), ::dlerror());
+        return Err(PluginError::LoadFailed);
+    }
+#endif
+    auto entry = library->entry();
+    if (!entry) {
+        SPDLOG_ERROR("Plugin {} does not export {}", path.string(), MKS_PLUGIN_ENTRY_NAME);
+        return Err(PluginError::MissingEntry);
+    }
+    const auto *plugin = entry();
+    if (!plugin) {
+        SPDLOG_ERROR("Plugin {} returned no descriptor", path.string());
+        return Err(PluginError::MissingEntry);
+    }
+    ILIAS_TRYV(create(*plugin, std::move(library), nullptr));
+    return {};
+}
+
+auto PluginHost::add(const mks_plugin &plugin) -> IoResult<void> {
+    ILIAS_TRYV(create(plugin, nullptr, nullptr));
+    return {};
+}
+
+auto PluginHost::attach(const mks_plugin &plugin, void *instance) -> IoResult<const mks_plugin_host *> {
+    ILIAS_TRY(auto loaded, create(plugin, nullptr, instance));
+    return &loaded->host;
+}
+
+auto PluginHost::create(const mks_plugin &plugin, std::unique_ptr<Library> library, void *instance)
+    -> IoResult<Loaded *> {
+    const auto name = std::string {plugin.name ? plugin.name : "unnamed"};
+    if (plugin.abi_version != MKS_PLUGIN_ABI_VERSION) {
+        SPDLOG_ERROR(
+            "Plugin {} was built for ABI {}, this host speaks {}",
+            name,
+            plugin.abi_version,
+            MKS_PLUGIN_ABI_VERSION
+        );
+        return Err(PluginError::AbiMismatch);
+    }
+    if (!plugin.on_event) {
+        SPDLOG_ERROR("Plugin {} has no on_event", name);
+        return Err(PluginError::AbiMismatch);
+    }
+
+    auto loaded = std::make_unique<Loaded>();
+    loaded->owner = this;
+    loaded->plugin = &plugin;
+    loaded->name = name;
+    loaded->library = std::move(library);
+    loaded->host = mks_plugin_host {
+        .abi_version = MKS_PLUGIN_ABI_VERSION,
+        .context = loaded.get(),
+        .log = [](void *context, int level, const char *message) {
+            const auto &self = *static_cast<Loaded *>(context);
+            const auto text = std::string_view {message ? message : ""};
+            switch (level) {
+                case MKS_LOG_DEBUG: SPDLOG_DEBUG("[{}] {}", self.name, text); break;
+                case MKS_LOG_INFO: SPDLOG_INFO("[{}] {}", self.name, text); break;
+                case MKS_LOG_WARN: SPDLOG_WARN("[{}] {}", self.name, text); break;
+                default: SPDLOG_ERROR("[{}] {}", self.name, text); break;
+            }
+        },
+        .subscribe = [](void *context, uint32_t events) {
+            auto &self = *static_cast<Loaded *>(context);
+            self.events = events;
+            self.owner->updateEvents();
+        },
+    };
+    loaded->events = plugin.events;
+    loaded->instance = instance;
+    loaded->attached = instance != nullptr;
+    if (!loaded->attached && plugin.create) {
+        loaded->instance = plugin.create(&loaded->host);
+        if (!loaded->instance) {
+            SPDLOG_ERROR("Plugin {} refused to start", name);
+            return Err(PluginError::CreateFailed);
+        }
+    }
+    SPDLOG_INFO("Loaded plugin {} (events {:#x})", name, loaded->events);
+    auto *result = loaded.get();
+    mPlugins.push_back(std::move(loaded));
+    updateEvents();
+    return result;
+}
+
+auto PluginHost::names() const -> std::vector<std::string> {
+    auto result = std::vector<std::string> {};
+    result.reserve(mPlugins.size());
+    for (const auto &loaded : mPlugins) {
+        result.push_back(loaded->name);
+    }
+    return result;
+}
+
+auto PluginHost::updateEvents() -> void {
+    mEvents = 0;
+    for (const auto &loaded : mPlugins) {
+        mEvents |= loaded->events;
+    }
+}
+
+// MARK: Dispatch
+
+auto PluginHost::dispatch(const mks_event &event) -> void {
+    // Indexed: a plugin may subscribe (not load) from on_event, which only
+    // changes masks, so the vector itself stays put.
+    for (size_t index = 0; index < mPlugins.size(); ++index) {
+        auto &loaded = *mPlugins[index];
+        if (loaded.events & event.type) {
+            loaded.plugin->on_event(loaded.instance, &event);
+        }
+    }
+}
+
+auto PluginHost::publishInput(const InputEvent &event, uint32_t type) -> void {
+    auto view = mks_event {.type = type, .data = {}};
+    if (const auto *key = std::get_if<KeyEvent>(&event)) {
+        view.data.key = reinterpret_cast<const mks_key_event *>(key);
+    }
+    else if (const auto *button = std::get_if<MouseButtonEvent>(&event)) {
+        view.data.mouse_button = reinterpret_cast<const mks_mouse_button_event *>(button);
+    }
+    else if (const auto *move = std::get_if<MouseMoveEvent>(&event)) {
+        view.data.mouse_move = reinterpret_cast<const mks_mouse_move_event *>(move);
+    }
+    else if (const auto *wheel = std::get_if<MouseWheelEvent>(&event)) {
+        view.data.mouse_wheel = reinterpret_cast<const mks_mouse_wheel_event *>(wheel);
+    }
+    dispatch(view);
+}
+
+auto PluginHost::publishScreens(std::span<const TopologyScreen> screens) -> void {
+    if (!wants(MKS_EVENT_SCREENS)) {
+        return;
+    }
+    auto views = std::vector<mks_screen> {};
+    views.reserve(screens.size());
+    for (const auto &screen : screens) {
+        views.push_back(mks_screen {
+            .owner_id = viewOf(screen.key.ownerId),
+            .screen_index = screen.key.screenIndex,
+            .cell_x = screen.cell.x,
+            .cell_y = screen.cell.y,
+            .x = screen.info.x,
+            .y = screen.info.y,
+            .width = screen.info.width,
+            .height = screen.info.height,
+            .dpi = screen.info.dpi,
+            .name = viewOf(screen.info.name),
+            .primary = screen.info.primary,
+            .local = screen.local,
+        });
+    }
+    const auto payload = mks_screens_event {.screens = views.data(), .count = views.size()};
+    dispatch(mks_event {.type = MKS_EVENT_SCREENS, .data = {.screens = &payload}});
+}
+
+auto PluginHost::publishClipboard(const ClipboardOffer &offer, std::optional<IPEndpoint> owner) -> void {
+    if (!wants(MKS_EVENT_CLIPBOARD)) {
+        return;
+    }
+    const auto ownerText = owner ? fmtlib::format("{}", *owner) : std::string {};
+    auto formats = std::vector<mks_clipboard_format> {};
+    formats.reserve(offer.formats.size());
+    for (const auto &format : offer.formats) {
+        formats.push_back(mks_clipboard_format {.mime = viewOf(format.mime), .size = format.size});
+    }
+    const auto payload = mks_clipboard_event {
+        .serial = offer.serial,
+        .hash = viewOf(offer.hash),
+        .owner = viewOf(ownerText),
+        .formats = formats.data(),
+        .format_count = formats.size(),
+    };
+    dispatch(mks_event {.type = MKS_EVENT_CLIPBOARD, .data = {.clipboard = &payload}});
+}
+
+auto PluginHost::publishScreenSwitch(const ScreenKey &from, const ScreenPoint &to, bool toLocal) -> void {
+    if (!wants(MKS_EVENT_SCREEN_SWITCH)) {
+        return;
+    }
+    const auto payload = mks_screen_switch_event {
+        .from_owner_id = viewOf(from.ownerId),
+        .from_screen_index = from.screenIndex,
+        .to_owner_id = viewOf(to.key.ownerId),
+        .to_screen_index = to.key.screenIndex,
+        .x = to.x,
+        .y = to.y,
+        .to_local = toLocal,
+    };
+    dispatch(mks_event {.type = MKS_EVENT_SCREEN_SWITCH, .data = {.screen_switch = &payload}});
+}
+
+auto PluginHost::publishSessionOpened(IPEndpoint endpoint, std::string_view ownerId, bool resumed) -> void {
+    publishSession(MKS_EVENT_SESSION_OPENED, endpoint, ownerId, resumed);
+}
+
+auto PluginHost::publishSessionClosed(IPEndpoint endpoint, std::string_view ownerId, bool suspended) -> void {
+    publishSession(MKS_EVENT_SESSION_CLOSED, endpoint, ownerId, suspended);
+}
+
+auto PluginHost::publishSession(uint32_t type, IPEndpoint endpoint, std::string_view ownerId, bool flag) -> void {
+    if (!wants(type)) {
+        return;
+    }
+    const auto endpointText = fmtlib::format("{}", endpoint);
+    const auto payload = mks_session_event {
+        .owner_id = viewOf(ownerId),
+        .endpoint = viewOf(endpointText),
+        .resumed = type == MKS_EVENT_SESSION_OPENED && flag,
+        .suspended = type == MKS_EVENT_SESSION_CLOSED && flag,
+    };
+    dispatch(mks_event {.type = type, .data = {.session = &payload}});
+}
+
+MKS_END
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "core.hpp"
+#include "plugin/mks_plugin.h"
+#include "server_events.hpp"
+#include <ilias/net.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+MKS_BEGIN
+
+using ilias::IPEndpoint;
+
+enum class PluginError {
+    Ok = 0,
+    LoadFailed,
+    MissingEntry,
+    AbiMismatch,
+    CreateFailed,
+};
+THIS_ERROR(PluginError);
+
+/**
+ * @brief Loads plugins through the C ABI of @c mks_plugin.h and dispatches
+ *        server events to them.
+ *
+ * The @ref ServerEvents sink main() hands the server. The host keeps the OR
+ * of all subscriptions, so an event nobody subscribed to is one test of that
+ * mask in the caller's inline path: nothing is built, looked up or called.
+ * When some plugin does subscribe, the event is converted once into its C view
+ * and every subscriber gets a pointer to the same view; input events are
+ * not converted at all, their C structs share the C++ layout.
+ *
+ * Single-threaded like the rest of the server: events are published and
+ * plugins called on the event loop thread. Plugins are loaded before the
+ * server runs and unloaded with the host.
+ */
+class PluginHost final : public ServerEvents {
+public:
+    PluginHost();
+    PluginHost(const PluginHost &) = delete;
+    ~PluginHost() override;
+
+    /** @brief Load the shared library at @p path and create its plugin. */
+    auto load(const std::filesystem::path &path) -> IoResult<void>;
+
+    /** @brief Create a plugin linked into this process (built-ins, tests); @p plugin must outlive the host. */
+    auto add(const mks_plugin &plugin) -> IoResult<void>;
+
+    /**
+     * @brief Register @p instance, created and owned by the caller, as a built-in plugin.
+     *
+     * @p plugin's create and destroy are not called. Returns the host view the
+     * instance subscribes through; both must outlive the host.
+     */
+    auto attach(const mks_plugin &plugin, void *instance) -> IoResult<const mks_plugin_host *>;
+
+    /** @brief Names of the loaded plugins, in load order. */
+    auto names() const -> std::vector<std::string>;
+
+    auto publishScreens(std::span<const TopologyScreen> screens) -> void override;
+    auto publishClipboard(const ClipboardOffer &offer, std::optional<IPEndpoint> owner) -> void override;
+    auto publishScreenSwitch(const ScreenKey &from, const ScreenPoint &to, bool toLocal) -> void override;
+    auto publishSessionOpened(IPEndpoint endpoint, std::string_view ownerId, bool resumed) -> void override;
+    auto publishSessionClosed(IPEndpoint endpoint, std::string_view ownerId, bool suspended) -> void override;
+
+private:
+    struct Library;
+    struct Loaded;
+
+    auto create(const mks_plugin &plugin, std::unique_ptr<Library> library, void *instance) -> IoResult<Loaded *>;
+    auto publishInput(const InputEvent &event, uint32_t type) -> void override;
+    auto dispatch(const mks_event &event) -> void;
+    auto publishSession(uint32_t type, IPEndpoint endpoint, std::string_view ownerId, bool flag) -> void;
+    auto updateEvents() -> void;
+
+    // Stable addresses: each mks_plugin_host::context points at its Loaded.
+    std::vector<std::unique_ptr<Loaded>> mPlugins;
+};
+
+MKS_END
+
+REFL_REGISTER_FMT_FORMATTER(mks::PluginError);
@@ -1,14 +1,39 @@
 #include "server.hpp"
 #include "server_session.hpp"
+#include "worker_pool.hpp"
+#include "diag/flight_recorder.hpp"
+#include "diag/trace.hpp"
 
 #include <cassert>
 #include <ilias/sync.hpp>
+#include <random>
 #include <utility>
 
 MKS_BEGIN
 
 using ilias::TaskScope;
 
+namespace {
+
+// Long enough for a Wi-Fi roam or a resumed laptop lid; short enough that a
+// client that really left does not keep the cursor for long (F12 still works).
+constexpr auto kDefaultResumeGracePeriod = std::chrono::milliseconds {15'000};
+
+auto newResumeToken() -> std::string {
+    static constexpr auto digits = std::string_view {"0123456789abcdef"};
+    auto rd = std::random_device {};
+    auto result = std::string {};
+    result.reserve(32);
+    for (auto index = 0; index < 16; ++index) {
+        const auto value = rd() & 0xFFU;
+        result.push_back(digits[(value >> 4U) & 0xFU]);
+        result.push_back(digits[value & 0xFU]);
+    }
+    return result;
+}
+
+} // namespace
+
 // MARK: Construction
 
 Server::Server(Platform::Ptr platform, IPEndpoint endpoint)
@@ -29,10 +54,29 @@ Server::Server(
       mEndpoint(endpoint),
       mScreens(std::move(config), std::move(configPath)),
       mClientSenders(),
-      mInput(mScreens, mClientSenders) {
+      mClientBulkSenders(),
+      mInput(mScreens, mClientSenders),
+      mClipboard(mClientSenders, mClientBulkSenders),
+      mDrag(mClientSenders, mFiles),
+      mResumeGracePeriod(kDefaultResumeGracePeriod) {
     // Interface invariant: callers inject a live Platform (MockPlatform in
     // tests, Platform::create() in main). Null is a programming error.
     assert(mPlatform);
+    // Config writes and layout dumps stay off the thread that routes input.
+    mScreens.setWorkerPool(&workerPool());
+    mInput.setDragHandlers(ServerInputRouter::DragHandlers {
+        .onCross = [this](const VirtualScreen &from, const VirtualScreen &to) {
+            mDrag.crossed(from, to);
+        },
+        .onRelease = [this](const VirtualScreen &target) {
+            mDrag.released(target);
+        },
+    });
+    mInput.setSwitchHandler([this](const VirtualScreen &from, const VirtualScreen &to, const ScreenPoint &entry) {
+        if (mEvents) {
+            mEvents->publishScreenSwitch(from.key, entry, to.local);
+        }
+    });
 }
 
 Server::~Server() = default;
@@ -47,11 +91,49 @@ auto Server::activeScreenKey() const -> std::optional<ScreenKey> {
     return mInput.activeScreenKey();
 }
 
+auto Server::setResumeGracePeriod(std::chrono::milliseconds period) -> void {
+    mResumeGracePeriod = period;
+}
+
+auto Server::setFileDirectory(std::filesystem::path directory) -> void {
+    mFiles.setDirectory(std::move(directory));
+}
+
+auto Server::setEvents(ServerEvents *events) -> void {
+    mEvents = events;
+    mClipboard.setEvents(events);
+}
+
+auto Server::setIoThreads(size_t threads) -> void {
+    mIoThreads = threads;
+}
+
+auto Server::setCaptureThread(bool enabled) -> void {
+    mCaptureThread = enabled;
+}
+
 // MARK: Run
 
 auto Server::run() -> IoTask<void> {
+    if (mIoThreads > 0) {
+        if (auto started = mShards.start(mIoThreads); !started) {
+            SPDLOG_WARN("Server writes to clients from the routing thread, no I/O shards: {}", started.error().message());
+        }
+    }
+    if (mShards.size() > 0) {
+        ILIAS_CO_TRY(auto acceptor, TcpAcceptor::bind(mEndpoint));
+        ILIAS_CO_TRY(auto localEndpoint, acceptor.localEndpoint());
+        auto result = co_await serve(localEndpoint, acceptShardedConnections(std::move(acceptor)));
+        // Every session has closed its queue by now, so the writers are done.
+        mShards.stop();
+        co_return result;
+    }
     ILIAS_CO_TRY(auto listener, co_await TcpListener::bind(mEndpoint));
     ILIAS_CO_TRY(auto localEndpoint, listener.localEndpoint());
+    co_return co_await serve(localEndpoint, acceptIncomingConnections(std::move(listener)));
+}
+
+auto Server::serve(IPEndpoint localEndpoint, Task<void> accept) -> IoTask<void> {
     SPDLOG_INFO("Server listening on {}", localEndpoint);
 
     auto capture = mPlatform->createCapture();
@@ -59,23 +141,58 @@ auto Server::run() -> IoTask<void> {
         SPDLOG_ERROR("Current platform does not provide an input capture backend");
         co_return Err(std::make_error_code(std::errc::operation_not_supported));
     }
+    if (mCaptureThread && !capture->setDedicatedThread(true)) {
+        SPDLOG_WARN("Current platform captures input on the routing thread only");
+    }
     ILIAS_CO_TRYV(co_await capture->initialize());
     mInput.setCapture(capture.get());
+    auto clipboard = co_await initializeClipboard();
+    mClipboard.setLocal(clipboard.get());
+    // Without one, drags still move the cursor; they just carry no files.
+    auto dragSource = mPlatform->createDragSource();
+    mDrag.setSource(dragSource.get());
 
     // Local screens anchor the topology at (0,0) primary / free cells to the right.
-    registerScreens(localEndpoint, mPlatform->screens(), true);
+    auto localScreens = mPlatform->screens();
+    registerScreens(localEndpoint, localScreens, true);
 
     co_await ilias::finally(
         ilias::whenAll(
-            acceptIncomingConnections(std::move(listener)),
-            waitPlatformEvent(*capture)
+            std::move(accept),
+            waitPlatformEvent(*capture),
+            watchLocalScreens(localEndpoint, std::move(localScreens)),
+            mClipboard.run(),
+            mDrag.run()
         ),
-        capture->shutdown()
+        shutdownPlatform(*capture, clipboard)
     );
     mInput.setCapture(nullptr);
+    mClipboard.setLocal(nullptr);
+    mDrag.setSource(nullptr);
     co_return {};
 }
 
+auto Server::initializeClipboard() -> Task<Clipboard::Ptr> {
+    auto clipboard = mPlatform->createClipboard();
+    if (!clipboard) {
+        SPDLOG_INFO("Current platform does not share the clipboard");
+        co_return nullptr;
+    }
+    if (auto initialized = co_await clipboard->initialize(); !initialized) {
+        // Clipboard sharing is optional; input sharing goes on without it.
+        SPDLOG_WARN("Server failed to initialize the clipboard: {}", initialized.error().message());
+        co_return nullptr;
+    }
+    co_return clipboard;
+}
+
+auto Server::shutdownPlatform(InputCapture &capture, Clipboard::Ptr clipboard) -> Task<void> {
+    if (clipboard) {
+        co_await clipboard->shutdown();
+    }
+    co_await capture.shutdown();
+}
+
 auto Server::acceptIncomingConnections(TcpListener listener) -> Task<void> {
     // TaskScope cancels remaining sessions when this accept task is cancelled
     // (e.g. run() finally / process shutdown).
@@ -94,41 +211,119 @@ auto Server::acceptIncomingConnections(TcpListener listener) -> Task<void> {
     });
 }
 
+auto Server::acceptShardedConnections(TcpAcceptor acceptor) -> Task<void> {
+    co_return co_await TaskScope::enter([&](auto &scope) -> Task<void> {
+        while (true) {
+            auto incoming = co_await acceptor.accept();
+            if (!incoming) {
+                SPDLOG_ERROR("Server failed to accept incoming connection: {}", incoming.error().message());
+                co_return;
+            }
+            scope.spawn(handleSharded(std::move(*incoming)));
+        }
+    });
+}
+
 auto Server::waitPlatformEvent(InputCapture &capture) -> Task<void> {
     SPDLOG_INFO("Server waiting for platform events");
     while (true) {
         auto event = co_await capture.nextEvent();
         SPDLOG_TRACE("Server captured platform event {}", event);
-        mInput.handleInputEvent(event);
+        flightRecord(FlightStage::Capture, event);
+        traceInstant("InputCapture::nextEvent");
+        {
+            auto span = TraceSpan {"ServerInputRouter::handleInputEvent"};
+            mInput.handleInputEvent(event);
+        }
+        // After routing, so subscribed plugins never delay the client; without
+        // any, this is a mask test.
+        if (mEvents) {
+            mEvents->publish(event);
+        }
+    }
+}
+
+auto Server::watchLocalScreens(IPEndpoint localEndpoint, std::vector<ScreenInfo> known) -> Task<void> {
+    while (true) {
+        auto change = co_await mPlatform->nextScreenChange(known);
+        if (!change) {
+            // Input keeps flowing; the topology just stops following hot-plug.
+            SPDLOG_WARN("Server stopped watching local screen changes: {}", change.error().message());
+            co_return;
+        }
+        SPDLOG_INFO("Server local screens changed: {}", change->screens);
+        applyScreenChanges(localEndpoint, diffScreens(known, change->screens), true);
+        known = std::move(change->screens);
     }
 }
 
 auto Server::handleIncoming(TcpStream stream) -> IoTask<void> {
     ILIAS_CO_TRY(auto endpoint, stream.remoteEndpoint());
+    auto session = ServerSession {sessionContext(), std::move(stream), endpoint};
+    co_return co_await runSession(session, endpoint);
+}
 
-    // Session borrows host state; onClosed / onScreens keep active-screen
-    // pointers consistent when map nodes are erased.
-    auto session = ServerSession {
-        ServerSession::Context {
-            .screens = mScreens,
-            .senders = mClientSenders,
-            .onScreens = [this](
-                IPEndpoint ep,
-                std::string_view ownerId,
-                const std::vector<ScreenInfo> &screens
-            ) {
-                registerScreens(ep, ownerId, screens, false);
-            },
-            .onClosed = [this](IPEndpoint ep) {
-                removeEndpointScreens(ep);
-                mClientSenders.erase(ep);
-                mScreens.forgetOwner(ep);
-            },
+auto Server::handleSharded(SocketStream stream) -> IoTask<void> {
+    ILIAS_CO_TRY(auto endpoint, stream.remoteEndpoint());
+    ILIAS_CO_TRY(auto writer, stream.duplicate());
+    auto session = ServerSession {sessionContext(), std::move(stream), endpoint, mShards, std::move(writer)};
+    co_return co_await runSession(session, endpoint);
+}
+
+auto Server::sessionContext() -> ServerSession::Context {
+    // Session borrows host state; the callbacks keep active-screen pointers
+    // consistent when map nodes are erased or re-keyed.
+    return ServerSession::Context {
+        .screens = mScreens,
+        .senders = mClientSenders,
+        .bulkSenders = mClientBulkSenders,
+        .stops = mSessionStops,
+        .onHandshake = [this](
+            IPEndpoint ep,
+            std::string_view ownerId,
+            std::string_view resumeToken,
+            const std::vector<ScreenInfo> &screens
+        ) {
+            auto welcome = completeHandshake(ep, ownerId, resumeToken, screens);
+            // Queued behind the Welcome, so a late joiner can paste the current copy.
+            mClipboard.announceTo(ep);
+            return welcome;
+        },
+        .onScreens = [this](
+            IPEndpoint ep,
+            std::string_view ownerId,
+            const std::vector<ScreenInfo> &screens
+        ) {
+            registerScreens(ep, ownerId, screens, false);
+        },
+        .onScreensChanged = [this](IPEndpoint ep, const ScreensChangedMessage &changes) {
+            applyScreenChanges(ep, changes, false);
+        },
+        .onClipboard = [this](IPEndpoint ep, RpcMessage message) {
+            return mClipboard.handleMessage(ep, std::move(message));
+        },
+        .onFileOffer = [this](std::string_view ownerId, RpcTransport &transport, FileOfferMessage offer) {
+            return receiveFile(ownerId, transport, std::move(offer));
+        },
+        .onFileFetch = [this](std::string_view ownerId, RpcTransport &transport, FileFetchMessage fetch) {
+            return mDrag.serveFetch(ownerId, transport, std::move(fetch));
+        },
+        .onClosed = [this](IPEndpoint ep, bool broken) {
+            closeEndpoint(ep, broken);
         },
-        std::move(stream),
-        endpoint,
     };
-    co_return co_await session.run();
+}
+
+auto Server::runSession(ServerSession &session, IPEndpoint endpoint) -> IoTask<void> {
+    auto result = co_await session.run();
+
+    // This task owns the suspended route's timer; a resume before it fires
+    // moves the route to another endpoint and makes expireRoute a no-op.
+    if (auto token = suspendedRouteToken(endpoint)) {
+        co_await ilias::sleep(mResumeGracePeriod);
+        expireRoute(*token, endpoint);
+    }
+    co_return result;
 }
 
 // MARK: Screen coordination
@@ -155,6 +350,7 @@ auto Server::registerScreens(
     }
     mScreens.registerScreens(endpoint, ownerId, screens, local);
     mInput.ensureActiveLocalScreen(local);
+    publishScreens();
 }
 
 auto Server::removeEndpointScreens(IPEndpoint endpoint) -> void {
@@ -162,6 +358,184 @@ auto Server::removeEndpointScreens(IPEndpoint endpoint) -> void {
         mInput.clearActiveState();
         mInput.ensureActiveLocalScreen();
     }
+    publishScreens();
+}
+
+auto Server::applyScreenChanges(
+    IPEndpoint endpoint,
+    const ScreensChangedMessage &changes,
+    bool local
+) -> void {
+    if (mScreens.applyScreenChanges(endpoint, changes, local, mInput.activeScreen())) {
+        mInput.clearActiveState();
+    }
+    else {
+        mInput.clampActivePoint();
+    }
+    mInput.ensureActiveLocalScreen();
+    publishScreens();
+}
+
+auto Server::publishScreens() -> void {
+    if (mEvents && mEvents->wants(MKS_EVENT_SCREENS)) {
+        mEvents->publishScreens(mScreens.topologyScreens());
+    }
+}
+
+// MARK: Session resumption
+
+auto Server::completeHandshake(
+    IPEndpoint endpoint,
+    std::string_view ownerId,
+    std::string_view resumeToken,
+    const std::vector<ScreenInfo> &screens
+) -> WelcomeMessage {
+    const auto graceMs = static_cast<uint32_t>(mResumeGracePeriod.count());
+    auto it = resumeToken.empty() ? mRoutes.end() : mRoutes.find(std::string {resumeToken});
+    // The route may still look live when the old socket has not noticed the
+    // drop yet (typical after roaming); the token proves it is the same client.
+    if (it != mRoutes.end() && it->second.ownerId == ownerId &&
+        mScreens.matchesScreens(it->second.endpoint, screens)) {
+        const auto previous = it->second.endpoint;
+        // A still-open old connection must stop feeding screen and clipboard
+        // changes under the old endpoint, and its eventual close must not
+        // take down the route or tell plugins the session ended.
+        mSessionStops.erase(previous);
+        mSessions.erase(previous);
+        mScreens.moveEndpoint(previous, endpoint);
+        mClientSenders.erase(previous);
+        mClientBulkSenders.erase(previous);
+        mClipboard.moveEndpoint(previous, endpoint);
+        it->second.endpoint = endpoint;
+        it->second.suspended = false;
+        mInput.resumeRoute(previous, endpoint);
+        mSessions.insert_or_assign(endpoint, std::string {ownerId});
+        if (mEvents) {
+            mEvents->publishSessionOpened(endpoint, ownerId, true);
+        }
+        return WelcomeMessage {
+            .resumeToken = it->first,
+            .resumed = true,
+            .resumeGraceMs = graceMs,
+        };
+    }
+
+    // A fresh registration replaces whatever this owner left behind, or its
+    // screen keys would collide in the topology.
+    dropOwnerRoutes(ownerId);
+    registerScreens(endpoint, ownerId, screens, false);
+    mSessions.insert_or_assign(endpoint, std::string {ownerId});
+    if (mEvents) {
+        mEvents->publishSessionOpened(endpoint, ownerId, false);
+    }
+    if (mResumeGracePeriod.count() <= 0) {
+        return WelcomeMessage {};
+    }
+    auto token = newResumeToken();
+    mRoutes.insert_or_assign(token, ResumeRoute {
+        .ownerId = std::string {ownerId},
+        .endpoint = endpoint,
+    });
+    return WelcomeMessage {
+        .resumeToken = std::move(token),
+        .resumeGraceMs = graceMs,
+    };
+}
+
+auto Server::closeEndpoint(IPEndpoint endpoint, bool broken) -> void {
+    mClientSenders.erase(endpoint);
+    mClientBulkSenders.erase(endpoint);
+    mClipboard.closeEndpoint(endpoint);
+    mSessionStops.erase(endpoint);
+    auto session = mSessions.extract(endpoint);
+    if (!session) {
+        // Never got past the handshake (rejected, or a file connection), or
+        // a resume took its route over: nothing routed still belongs to this
+        // endpoint, only the owner id the handshake remembered.
+        mScreens.forgetOwner(endpoint);
+        return;
+    }
+    for (auto it = mRoutes.begin(); it != mRoutes.end(); ++it) {
+        auto &route = it->second;
+        if (route.endpoint != endpoint || route.suspended) {
+            continue;
+        }
+        if (!broken) {
+            // The client left on purpose, so nothing will resume: control
+            // must not wait on its screens for the grace period.
+            mRoutes.erase(it);
+            break;
+        }
+        // Keep screens, cells and the active cursor; only the sender goes.
+        SPDLOG_INFO(
+            "Server suspended route for {} owner={} for {}ms",
+            endpoint,
+            route.ownerId,
+            mResumeGracePeriod.count()
+        );
+        route.suspended = true;
+        mInput.holdReleases(endpoint);
+        if (mEvents) {
+            mEvents->publishSessionClosed(endpoint, session.mapped(), true);
+        }
+        return;
+    }
+    removeEndpointScreens(endpoint);
+    mScreens.forgetOwner(endpoint);
+    if (mEvents) {
+        mEvents->publishSessionClosed(endpoint, session.mapped(), false);
+    }
+}
+
+auto Server::suspendedRouteToken(IPEndpoint endpoint) const -> std::optional<std::string> {
+    for (const auto &[token, route] : mRoutes) {
+        if (route.endpoint == endpoint && route.suspended) {
+            return token;
+        }
+    }
+    return std::nullopt;
+}
+
+auto Server::expireRoute(const std::string &token, IPEndpoint endpoint) -> void {
+    auto it = mRoutes.find(token);
+    if (it == mRoutes.end() || !it->second.suspended || it->second.endpoint != endpoint) {
+        return;
+    }
+    SPDLOG_INFO("Server route for {} owner={} expired", endpoint, it->second.ownerId);
+    mRoutes.erase(it);
+    mInput.dropHeldReleases(endpoint);
+    removeEndpointScreens(endpoint);
+    mScreens.forgetOwner(endpoint);
+}
+
+auto Server::dropOwnerRoutes(std::string_view ownerId) -> void {
+    for (auto it = mRoutes.begin(); it != mRoutes.end();) {
+        if (it->second.ownerId != ownerId) {
+            ++it;
+            continue;
+        }
+        const auto endpoint = it->second.endpoint;
+        it = mRoutes.erase(it);
+        mInput.dropHeldReleases(endpoint);
+        removeEndpointScreens(endpoint);
+        mClientSenders.erase(endpoint);
+        mClientBulkSenders.erase(endpoint);
+        mScreens.forgetOwner(endpoint);
+    }
+}
+
+// MARK: Files
+
+auto Server::receiveFile(std::string_view ownerId, RpcTransport &transport, FileOfferMessage offer) -> IoTask<void> {
+    SPDLOG_INFO(
+        "Server receiving {} ({} bytes) from owner={}",
+        offer.manifest.name,
+        offer.manifest.size,
+        ownerId
+    );
+    ILIAS_CO_TRY(auto path, co_await mFiles.receive(transport, std::move(offer)));
+    SPDLOG_INFO("Server stored a file from owner={} at {}", ownerId, path.string());
+    co_return {};
 }
 
 // Impl formatter for VirtualScreen (declared via _refl_fmt_inline in types).
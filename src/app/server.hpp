@@ -3,15 +3,24 @@
 #include "preinclude.hpp"
 #include "config/app_config.hpp"
 #include "core.hpp"
+#include "file_transfer.hpp"
+#include "io_shards.hpp"
 #include "platform/platform.hpp"
 #include "rpc/message.hpp"
+#include "server_clipboard.hpp"
+#include "server_drag.hpp"
+#include "server_events.hpp"
 #include "server_input.hpp"
 #include "server_screens.hpp"
+#include "server_session.hpp"
 #include "server_types.hpp"
 #include <ilias/task.hpp>
 #include <ilias/net.hpp>
 #include <ilias/sync.hpp>
+#include <chrono>
 #include <map>
+#include <optional>
+#include <string>
 
 MKS_BEGIN
 
@@ -27,10 +36,20 @@ using ilias::TcpStream;
  * - @ref ServerScreenStore  — topology cells, VirtualScreen routes, config layout
  * - @ref ServerInputRouter  — active screen, edge switch, remote InputMessage queue
  * - @ref ServerSession      — one TCP peer: Hello, ScreensMessage, read/write loops
+ * - @ref ServerClipboard    — clipboard offers and transfers between machines
+ * - @ref FileTransfers      — files clients send on a connection of their own
+ * - @ref ServerDrag         — local file drags offered to clients before the drop
+ * - @ref ServerEvents       — where input, screens, clipboard and sessions are published
  *
  * @c run() starts accept + capture in parallel. Each accept spawns a
  * ServerSession task under a TaskScope so disconnects are structured.
  *
+ * With @ref setIoThreads, each session's writer (message encoding and socket
+ * writes) runs on one of that many @ref IoShards threads, and the thread
+ * calling run() keeps capture, routing, accept and session reads. Routing
+ * then only pushes to a lock-free queue per client. Server state is still
+ * touched from that one thread alone.
+ *
  * @invariant @c platform is non-null at construction
  */
 class Server {
@@ -57,12 +76,66 @@ public:
     /** @brief Key of the screen that currently owns keyboard/mouse, if any. */
     auto activeScreenKey() const -> std::optional<ScreenKey>;
 
+    /**
+     * @brief How long a dropped client's route stays suspended (default 15s).
+     *
+     * Zero removes a client's screens as soon as its session ends.
+     */
+    auto setResumeGracePeriod(std::chrono::milliseconds period) -> void;
+
+    /** @brief Where files sent by trusted clients are stored (default @ref defaultDownloadDirectory). */
+    auto setFileDirectory(std::filesystem::path directory) -> void;
+
+    /**
+     * @brief Sink for this server's events, set before run(); nullptr (the
+     *        default) publishes nowhere. Must outlive the server.
+     */
+    auto setEvents(ServerEvents *events) -> void;
+
+    /**
+     * @brief Threads writing to clients, set before run(); 0 (the default)
+     *        writes from the routing thread.
+     *
+     * Linux only; elsewhere, or when the threads cannot start, run() logs it
+     * and writes from the routing thread.
+     */
+    auto setIoThreads(size_t threads) -> void;
+
+    /**
+     * @brief Have the capture read and translate events on a thread of its
+     *        own, set before run(); off by default.
+     *
+     * Routing then takes events off a lock-free ring, so local input is not
+     * left unread while the loop is busy writing to a slow client. Backends
+     * without such a thread (all but X11) log it and capture on the loop.
+     */
+    auto setCaptureThread(bool enabled) -> void;
+
 private:
+    /**
+     * @brief Route issued to one client at handshake, keyed by resume token.
+     *
+     * While @c suspended, the endpoint's screens, cells and the active cursor
+     * stay in place with no sender; a reconnect presenting the token moves
+     * them to the new endpoint instead of registering from scratch.
+     */
+    struct ResumeRoute {
+        std::string ownerId;
+        IPEndpoint endpoint;
+        bool suspended = false;
+    };
+
     // MARK: Background tasks
 
+    /** @brief Capture, routing and the background tasks, around @p accept. */
+    auto serve(IPEndpoint localEndpoint, Task<void> accept) -> IoTask<void>;
+
     /** @brief Accept loop; each connection is a ServerSession under TaskScope. */
     auto acceptIncomingConnections(TcpListener listener) -> Task<void>;
 
+    /** @brief Accept loop for sharded sessions (@ref setIoThreads). */
+    auto acceptShardedConnections(TcpAcceptor acceptor) -> Task<void>;
+
     /** @brief Drain InputCapture and forward events to the input router. */
     auto waitPlatformEvent(InputCapture &capture) -> Task<void>;
 
@@ -73,6 +146,15 @@ private:
      */
     auto handleIncoming(TcpStream stream) -> IoTask<void>;
 
+    /** @brief handleIncoming() for a session whose writer runs on mShards. */
+    auto handleSharded(SocketStream stream) -> IoTask<void>;
+
+    /** @brief Host references and callbacks shared by every session. */
+    auto sessionContext() -> ServerSession::Context;
+
+    /** @brief Run @p session, then hold its route through the resume grace period. */
+    auto runSession(ServerSession &session, IPEndpoint endpoint) -> IoTask<void>;
+
     // MARK: Screen registration (store + input coordination)
 
     /**
@@ -98,12 +180,91 @@ private:
      */
     auto removeEndpointScreens(IPEndpoint endpoint) -> void;
 
+    /**
+     * @brief Incremental screen update for an endpoint (hot-plug).
+     *
+     * The active screen is only dropped when it was unplugged; a resized
+     * active screen keeps the cursor, clamped into its new size.
+     */
+    auto applyScreenChanges(
+        IPEndpoint endpoint,
+        const ScreensChangedMessage &changes,
+        bool local
+    ) -> void;
+
+    /** @brief Follow hot-plug on the server's own screens, starting from @p known. */
+    auto watchLocalScreens(IPEndpoint localEndpoint, std::vector<ScreenInfo> known) -> Task<void>;
+
+    /** @brief Bring up the local clipboard; null when the backend has none or it fails. */
+    auto initializeClipboard() -> Task<Clipboard::Ptr>;
+
+    /** @brief Release the local clipboard and capture at the end of run(). */
+    auto shutdownPlatform(InputCapture &capture, Clipboard::Ptr clipboard) -> Task<void>;
+
+    // MARK: Session resumption
+
+    /**
+     * @brief ServerSession::Context::onHandshake — resume or register fresh.
+     *
+     * A resume stops the route's previous session if it is still running.
+     */
+    auto completeHandshake(
+        IPEndpoint endpoint,
+        std::string_view ownerId,
+        std::string_view resumeToken,
+        const std::vector<ScreenInfo> &screens
+    ) -> WelcomeMessage;
+
+    /**
+     * @brief ServerSession::Context::onClosed — suspend the endpoint's route
+     * when the connection @p broken; otherwise, or when it has no route (no
+     * grace period is set), remove its screens and the route. A no-op for
+     * routing when the session never completed its handshake or was stopped
+     * by a resume.
+     */
+    auto closeEndpoint(IPEndpoint endpoint, bool broken) -> void;
+
+    /** @brief Token of the suspended route at @p endpoint, if any. */
+    auto suspendedRouteToken(IPEndpoint endpoint) const -> std::optional<std::string>;
+
+    /** @brief Remove the route if it is still suspended at @p endpoint. */
+    auto expireRoute(const std::string &token, IPEndpoint endpoint) -> void;
+
+    /** @brief Drop every route of @p ownerId along with its screens. */
+    auto dropOwnerRoutes(std::string_view ownerId) -> void;
+
+    /** @brief Hand the layout to plugins after it changed, if any of them asked. */
+    auto publishScreens() -> void;
+
+    // MARK: Files
+
+    /** @brief ServerSession::Context::onFileOffer — store the file under mFiles.directory(). */
+    auto receiveFile(std::string_view ownerId, RpcTransport &transport, FileOfferMessage offer) -> IoTask<void>;
+
     Platform::Ptr mPlatform;
     IPEndpoint mEndpoint;
+    ServerEvents *mEvents = nullptr;
     ServerScreenStore mScreens;
     // Endpoint → outbound RPC queue used by ServerInputRouter for remote peers.
     ServerInputRouter::ClientSenders mClientSenders;
+    // Endpoint → clipboard chunk queue, drained behind mClientSenders.
+    ServerInputRouter::ClientSenders mClientBulkSenders;
     ServerInputRouter mInput;
+    ServerClipboard mClipboard;
+    FileTransfers mFiles;
+    ServerDrag mDrag;
+    // Resume token → route; live and suspended.
+    std::map<std::string, ResumeRoute> mRoutes;
+    // Endpoint → owner of each session past its handshake, so plugins see
+    // a close only for sessions they saw open.
+    std::map<IPEndpoint, std::string> mSessions;
+    // Endpoint → stop handle of each routable session; see completeHandshake.
+    std::map<IPEndpoint, ServerSession::StopHandle> mSessionStops;
+    std::chrono::milliseconds mResumeGracePeriod;
+    size_t mIoThreads = 0;
+    bool mCaptureThread = false;
+    // Last, so the shard threads are joined before the rest is destroyed.
+    IoShards mShards;
 };
 
 MKS_END
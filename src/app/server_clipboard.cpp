@@ -0,0 +1,281 @@
+#include "server_clipboard.hpp"
+
+#include <algorithm>
+#include <string_view>
+#include <utility>
+
+MKS_BEGIN
+
+namespace {
+
+// Local pastes queued for serveLocal(); each one streams to completion before the next.
+constexpr auto kLocalRequestDepth = size_t {8};
+
+auto offersFormat(const ClipboardOffer &offer, std::string_view mime) -> bool {
+    return std::ranges::any_of(offer.formats, [&](const ClipboardFormat &format) {
+        return format.mime == mime;
+    });
+}
+
+} // namespace
+
+ServerClipboard::ServerClipboard(
+    ServerInputRouter::ClientSenders &senders,
+    ServerInputRouter::ClientSenders &bulkSenders
+)
+    : mSenders(senders),
+      mBulkSenders(bulkSenders) {
+}
+
+auto ServerClipboard::setEvents(ServerEvents *events) -> void {
+    mEvents = events;
+}
+
+auto ServerClipboard::setLocal(Clipboard *local) -> void {
+    mLocal = local;
+    if (!local) {
+        mLocalRequests = {};
+        if (mOffer && !mOwner) {
+            // Nothing left to serve the local offer from.
+            mOffer.reset();
+        }
+    }
+}
+
+auto ServerClipboard::currentOffer() const -> std::optional<ClipboardOffer> {
+    return mOffer;
+}
+
+// MARK: Local clipboard
+
+auto ServerClipboard::run() -> Task<void> {
+    if (!mLocal) {
+        co_return;
+    }
+    auto [sender, receiver] = ilias::mpsc::channel<LocalRequest>(kLocalRequestDepth);
+    mLocalRequests = sender;
+    co_await ilias::whenAll(watchLocal(*mLocal), serveLocal(*mLocal, std::move(receiver)));
+}
+
+auto ServerClipboard::watchLocal(Clipboard &local) -> Task<void> {
+    while (true) {
+        auto offer = co_await local.nextOffer();
+        if (!offer) {
+            // Input keeps flowing; this machine just stops advertising copies.
+            SPDLOG_WARN("Server stopped watching the local clipboard: {}", offer.error().message());
+            co_return;
+        }
+        if (offer->hash == mPublishedHash) {
+            SPDLOG_TRACE("Server ignored a local copy of the published offer {}", offer->hash);
+            continue;
+        }
+        acceptOffer(std::nullopt, std::move(*offer));
+    }
+}
+
+auto ServerClipboard::serveLocal(Clipboard &local, ilias::mpsc::Receiver<LocalRequest> requests) -> Task<void> {
+    while (auto request = co_await requests.recv()) {
+        auto bytes = co_await local.read(request->mime);
+        auto it = mBulkSenders.find(request->requester);
+        if (it == mBulkSenders.end()) {
+            continue;
+        }
+        // Copied: the session may end while a chunk waits for room.
+        auto bulk = it->second;
+        co_await sendClipboardData(bulk, request->requestId, std::move(bytes));
+    }
+}
+
+// MARK: Messages
+
+auto ServerClipboard::handleMessage(IPEndpoint endpoint, RpcMessage message) -> Task<void> {
+    if (auto *offer = std::get_if<ClipboardOfferMessage>(&message)) {
+        acceptOffer(endpoint, std::move(offer->offer));
+    }
+    else if (const auto *request = std::get_if<ClipboardRequestMessage>(&message)) {
+        acceptRequest(endpoint, *request);
+    }
+    else if (auto *chunk = std::get_if<ClipboardDataMessage>(&message)) {
+        co_await acceptData(endpoint, std::move(*chunk));
+    }
+}
+
+auto ServerClipboard::acceptOffer(std::optional<IPEndpoint> owner, ClipboardOffer offer) -> void {
+    mOwner = owner;
+    mOwnerSerial = offer.serial;
+    offer.serial = ++mNextSerial;
+    mOffer = offer;
+    SPDLOG_INFO(
+        "Server clipboard offer {} from {}: {}",
+        offer.serial,
+        owner ? fmtlib::format("{}", *owner) : std::string {"local"},
+        offer.formats
+    );
+    if (mEvents) {
+        mEvents->publishClipboard(offer, owner);
+    }
+
+    for (auto &[endpoint, sender] : mSenders) {
+        if (endpoint == owner) {
+            continue;
+        }
+        if (!sender.trySend(RpcMessage {ClipboardOfferMessage {.offer = offer}})) {
+            SPDLOG_WARN("Server dropped clipboard offer {} for {}: queue full", offer.serial, endpoint);
+        }
+    }
+
+    if (!owner || !mLocal) {
+        return;
+    }
+    mPublishedHash = offer.hash;
+    const auto serial = offer.serial;
+    auto published = mLocal->publish(std::move(offer), [this, serial](std::string mime) {
+        return fetch(serial, std::move(mime));
+    });
+    if (!published) {
+        SPDLOG_WARN("Server failed to publish clipboard offer {} locally: {}", serial, published.error().message());
+    }
+}
+
+auto ServerClipboard::acceptRequest(IPEndpoint requester, const ClipboardRequestMessage &request) -> void {
+    if (!mOffer || request.serial != mOffer->serial || mOwner == requester || !offersFormat(*mOffer, request.mime)) {
+        reject(requester, request.requestId, ClipboardError::Unavailable);
+        return;
+    }
+    SPDLOG_DEBUG(
+        "Server clipboard request {} from {} for offer {} as {}",
+        request.requestId,
+        requester,
+        request.serial,
+        request.mime
+    );
+
+    if (!mOwner) {
+        auto queued = mLocalRequests && mLocalRequests.trySend(LocalRequest {
+            .requester = requester,
+            .requestId = request.requestId,
+            .mime = request.mime,
+        });
+        if (!queued) {
+            reject(requester, request.requestId, ClipboardError::Unavailable);
+        }
+        return;
+    }
+
+    auto owner = mSenders.find(*mOwner);
+    const auto relayId = ++mNextRequestId;
+    auto forwarded = owner != mSenders.end() && owner->second.trySend(RpcMessage {ClipboardRequestMessage {
+        .serial = mOwnerSerial,
+        .requestId = relayId,
+        .mime = request.mime,
+    }});
+    if (!forwarded) {
+        reject(requester, request.requestId, ClipboardError::Unavailable);
+        return;
+    }
+    mRelays.insert_or_assign(relayId, Relay {
+        .requester = requester,
+        .requestId = request.requestId,
+        .owner = *mOwner,
+    });
+}
+
+auto ServerClipboard::acceptData(IPEndpoint owner, ClipboardDataMessage chunk) -> Task<void> {
+    if (mFetches.accept(chunk)) {
+        co_return;
+    }
+    auto it = mRelays.find(chunk.requestId);
+    if (it == mRelays.end() || it->second.owner != owner) {
+        SPDLOG_TRACE("Server dropped clipboard chunk {} from {}", chunk.requestId, owner);
+        co_return;
+    }
+    const auto relay = it->second;
+    if (chunk.last || !chunk.error.empty()) {
+        mRelays.erase(it);
+    }
+
+    auto bulk = mBulkSenders.find(relay.requester);
+    if (bulk == mBulkSenders.end()) {
+        mRelays.erase(chunk.requestId);
+        co_return;
+    }
+    // Waiting here holds back the owner's reader, which is the backpressure
+    // that keeps a slow requester from piling chunks up on the server.
+    auto sender = bulk->second;
+    chunk.requestId = relay.requestId;
+    (void) co_await sender.send(RpcMessage {std::move(chunk)});
+}
+
+auto ServerClipboard::fetch(uint32_t serial, std::string mime) -> IoTask<std::vector<std::byte>> {
+    if (!mOffer || mOffer->serial != serial || !mOwner || !offersFormat(*mOffer, mime)) {
+        co_return Err(ClipboardError::Unavailable);
+    }
+    auto owner = mSenders.find(*mOwner);
+    if (owner == mSenders.end()) {
+        co_return Err(ClipboardError::Unavailable);
+    }
+
+    const auto requestId = ++mNextRequestId;
+    auto receiver = mFetches.begin(requestId);
+    SPDLOG_DEBUG("Server pasting clipboard offer {} as {} from {}", serial, mime, *mOwner);
+    auto sent = owner->second.trySend(RpcMessage {ClipboardRequestMessage {
+        .serial = mOwnerSerial,
+        .requestId = requestId,
+        .mime = std::move(mime),
+    }});
+    if (!sent) {
+        mFetches.fail(requestId, make_error_code(ClipboardError::Unavailable));
+    }
+    co_return co_await awaitClipboardFetch(std::move(receiver));
+}
+
+auto ServerClipboard::reject(IPEndpoint requester, uint32_t requestId, ClipboardError error) -> void {
+    auto it = mSenders.find(requester);
+    if (it == mSenders.end()) {
+        return;
+    }
+    (void) it->second.trySend(RpcMessage {ClipboardDataMessage {
+        .requestId = requestId,
+        .last = true,
+        .error = make_error_code(error).message(),
+    }});
+}
+
+// MARK: Endpoints
+
+auto ServerClipboard::announceTo(IPEndpoint endpoint) -> void {
+    if (!mOffer || mOwner == endpoint) {
+        return;
+    }
+    auto it = mSenders.find(endpoint);
+    if (it != mSenders.end()) {
+        (void) it->second.trySend(RpcMessage {ClipboardOfferMessage {.offer = *mOffer}});
+    }
+}
+
+auto ServerClipboard::moveEndpoint(IPEndpoint from, IPEndpoint to) -> void {
+    if (mOwner == from) {
+        mOwner = to;
+    }
+}
+
+auto ServerClipboard::closeEndpoint(IPEndpoint endpoint) -> void {
+    for (auto it = mRelays.begin(); it != mRelays.end();) {
+        if (it->second.owner == endpoint) {
+            reject(it->second.requester, it->second.requestId, ClipboardError::Disconnected);
+            it = mRelays.erase(it);
+        }
+        else if (it->second.requester == endpoint) {
+            it = mRelays.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    if (mOwner == endpoint) {
+        // A resumed owner keeps its offer, but these fetches went to the old socket.
+        mFetches.failAll(make_error_code(ClipboardError::Disconnected));
+    }
+}
+
+MKS_END
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "clipboard_transfer.hpp"
+#include "core.hpp"
+#include "platform/platform.hpp"
+#include "rpc/message.hpp"
+#include "server_events.hpp"
+#include "server_input.hpp"
+#include <ilias/net.hpp>
+#include <ilias/sync.hpp>
+#include <ilias/task.hpp>
+#include <map>
+#include <optional>
+#include <string>
+
+MKS_BEGIN
+
+using ilias::IPEndpoint;
+
+/**
+ * @brief Server side of clipboard sharing: the hub between machines.
+ *
+ * Every copy, local or reported by a client, becomes the current offer
+ * under a server serial and is advertised to every other machine. A request
+ * for it is answered from the local clipboard or relayed to the owning
+ * client; relayed chunks are passed on as they arrive, so the server only
+ * holds a whole copy when it pastes one itself.
+ *
+ * Chunks travel on each session's bulk queue, which its writer drains only
+ * while no input is waiting.
+ */
+class ServerClipboard {
+public:
+    /**
+     * @param senders     Session queues for offers, requests and errors.
+     * @param bulkSenders Session queues for ClipboardDataMessage chunks.
+     */
+    ServerClipboard(
+        ServerInputRouter::ClientSenders &senders,
+        ServerInputRouter::ClientSenders &bulkSenders
+    );
+
+    /**
+     * @brief Attach or clear the host clipboard (nullptr on shutdown).
+     */
+    auto setLocal(Clipboard *local) -> void;
+
+    /** @brief Where every offer is published; nullptr (the default) tells no one. */
+    auto setEvents(ServerEvents *events) -> void;
+
+    /**
+     * @brief Follow local copies and serve requests for them.
+     *
+     * Returns at once when no local clipboard is attached; remote machines
+     * still share through the relay.
+     */
+    auto run() -> Task<void>;
+
+    /** @brief ServerSession::Context::onClipboard — an offer, request or chunk from @p endpoint. */
+    auto handleMessage(IPEndpoint endpoint, RpcMessage message) -> Task<void>;
+
+    /** @brief Queue the current offer for a client that just connected. */
+    auto announceTo(IPEndpoint endpoint) -> void;
+
+    /** @brief A resumed client moved from @p from to @p to. */
+    auto moveEndpoint(IPEndpoint from, IPEndpoint to) -> void;
+
+    /** @brief Fail transfers that depend on @p endpoint after its session ended. */
+    auto closeEndpoint(IPEndpoint endpoint) -> void;
+
+    /** @brief The offer every machine currently pastes from, if any. */
+    auto currentOffer() const -> std::optional<ClipboardOffer>;
+
+private:
+    /** @brief A client request relayed to the owner under a server request id. */
+    struct Relay {
+        IPEndpoint requester;
+        uint32_t requestId = 0; // The requester's id
+        IPEndpoint owner;
+    };
+
+    struct LocalRequest {
+        IPEndpoint requester;
+        uint32_t requestId = 0;
+        std::string mime;
+    };
+
+    /** @param owner Advertising client, nullopt for the local clipboard. */
+    auto acceptOffer(std::optional<IPEndpoint> owner, ClipboardOffer offer) -> void;
+    auto acceptRequest(IPEndpoint requester, const ClipboardRequestMessage &request) -> void;
+    auto acceptData(IPEndpoint owner, ClipboardDataMessage chunk) -> Task<void>;
+
+    /** @brief Clipboard::Fetch for a remote offer published locally. */
+    auto fetch(uint32_t serial, std::string mime) -> IoTask<std::vector<std::byte>>;
+    auto reject(IPEndpoint requester, uint32_t requestId, ClipboardError error) -> void;
+
+    auto watchLocal(Clipboard &local) -> Task<void>;
+    auto serveLocal(Clipboard &local, ilias::mpsc::Receiver<LocalRequest> requests) -> Task<void>;
+
+    ServerInputRouter::ClientSenders &mSenders;
+    ServerInputRouter::ClientSenders &mBulkSenders;
+    ServerEvents *mEvents = nullptr;
+    Clipboard *mLocal = nullptr;
+    // Current offer under the server serial, plus who holds its bytes.
+    std::optional<ClipboardOffer> mOffer;
+    std::optional<IPEndpoint> mOwner;
+    uint32_t mOwnerSerial = 0;
+    // Hash of the last remote offer published locally, so its echo is not re-advertised.
+    std::string mPublishedHash;
+    uint32_t mNextSerial = 0;
+    // Shared by relays and local fetches, so a chunk's id names exactly one of them.
+    uint32_t mNextRequestId = 0;
+    std::map<uint32_t, Relay> mRelays;
+    ClipboardFetches mFetches;
+    // Feeds serveLocal(); empty while run() is not serving.
+    ilias::mpsc::Sender<LocalRequest> mLocalRequests;
+};
+
+MKS_END
@@ -0,0 +1,247 @@
+#include "server_drag.hpp"
+#include "diag/metrics.hpp"
+#include "rpc/transport.hpp"
+
+#include <algorithm>
+#include <utility>
+
+MKS_BEGIN
+
+namespace {
+
+struct DragMetrics {
+    Counter &started;
+    Counter &filesOffered;
+    Counter &dropped;
+    Counter &fetches;
+};
+
+auto dragMetrics() -> DragMetrics & {
+    static auto result = DragMetrics {
+        .started = metrics().counter("server.drag.started"),
+        .filesOffered = metrics().counter("server.drag.files_offered"),
+        // Drags released over a client that had been offered them.
+        .dropped = metrics().counter("server.drag.dropped"),
+        .fetches = metrics().counter("server.drag.fetches"),
+    };
+    return result;
+}
+
+// Crossings and releases waiting for run(); a drag queues a handful at most.
+constexpr auto kDragEventDepth = size_t {32};
+// Files beyond this are not offered; a drop that large is better sent as a folder archive.
+constexpr auto kMaxDragFiles = size_t {64};
+
+} // namespace
+
+ServerDrag::ServerDrag(ServerInputRouter::ClientSenders &senders, FileTransfers &files)
+    : mSenders(senders),
+      mFiles(files) {
+}
+
+auto ServerDrag::setSource(DragSource *source) -> void {
+    mSource = source;
+}
+
+// MARK: Router hooks
+
+auto ServerDrag::crossed(const VirtualScreen &from, const VirtualScreen &to) -> void {
+    if (!mEvents) {
+        return;
+    }
+    mHolding = true;
+    auto sent = mEvents.trySend(Cross {
+        .endpoint = to.endpoint,
+        .ownerId = to.key.ownerId,
+        .fromLocal = from.local,
+        .toLocal = to.local,
+    });
+    if (!sent) {
+        SPDLOG_WARN("Server dropped a drag crossing onto {}: too many pending", to.key);
+    }
+}
+
+auto ServerDrag::released(const VirtualScreen &target) -> void {
+    if (!mEvents || !mHolding) {
+        return;
+    }
+    mHolding = false;
+    auto release = Release {};
+    if (!target.local) {
+        release.target = target.endpoint;
+        release.ownerId = target.key.ownerId;
+    }
+    if (!mEvents.trySend(std::move(release))) {
+        SPDLOG_WARN("Server dropped a drag release over {}: too many pending", target.key);
+    }
+}
+
+// MARK: Drags
+
+auto ServerDrag::run() -> Task<void> {
+    auto [sender, receiver] = ilias::mpsc::channel<Event>(kDragEventDepth);
+    mEvents = sender;
+    while (auto event = co_await receiver.recv()) {
+        if (auto *cross = std::get_if<Cross>(&*event)) {
+            co_await acceptCross(std::move(*cross));
+        }
+        else {
+            co_await acceptRelease(std::get<Release>(std::move(*event)));
+        }
+    }
+    mEvents = {};
+}
+
+auto ServerDrag::acceptCross(Cross cross) -> Task<void> {
+    if (!mDrag) {
+        // Only a drag that started on this machine carries files we can serve.
+        if (!cross.fromLocal || cross.toLocal || !mSource) {
+            co_return;
+        }
+        co_await startDrag();
+    }
+    if (cross.toLocal || mDrag->offers.empty() || mDrag->offeredTo.contains(cross.endpoint)) {
+        co_return;
+    }
+
+    SPDLOG_INFO(
+        "Server offering drag {} ({} files) to {}",
+        mDrag->id,
+        mDrag->offers.size(),
+        cross.endpoint
+    );
+    for (auto &[transferId, served] : mServed) {
+        if (served.dragId == mDrag->id) {
+            served.owners.insert(cross.ownerId);
+        }
+    }
+    mDrag->offeredTo.insert(cross.endpoint);
+    const auto fileCount = static_cast<uint32_t>(mDrag->offers.size());
+    for (auto index = uint32_t {0}; index < fileCount; ++index) {
+        const auto &offer = mDrag->offers[index];
+        auto sent = co_await sendTo(cross.endpoint, RpcMessage {DragOfferMessage {
+            .dragId = mDrag->id,
+            .fileIndex = index,
+            .fileCount = fileCount,
+            .transferId = offer.transferId,
+            .manifest = offer.manifest,
+        }});
+        if (!sent) {
+            co_return;
+        }
+        dragMetrics().filesOffered.add();
+    }
+}
+
+auto ServerDrag::startDrag() -> Task<void> {
+    mDrag = Drag {.id = ++mNextDragId};
+    auto files = co_await mSource->draggedFiles();
+    if (!files) {
+        SPDLOG_DEBUG("Server could not read the local drag: {}", files.error().message());
+        co_return;
+    }
+    if (files->empty()) {
+        // A text selection or window move; nothing to offer until the release.
+        co_return;
+    }
+    if (files->size() > kMaxDragFiles) {
+        SPDLOG_WARN("Server offers the first {} of {} dragged files", kMaxDragFiles, files->size());
+        files->resize(kMaxDragFiles);
+    }
+
+    // Hashing reads every file once; the offers go out when all are hashed,
+    // which for most drags is long before the button comes up.
+    std::erase_if(mServed, [&](const auto &entry) { return entry.second.dragId + 1 < mDrag->id; });
+    for (auto &path : *files) {
+        auto offer = co_await mFiles.makeOffer(path);
+        if (!offer) {
+            // Directories and unreadable files are skipped, not the whole drag.
+            SPDLOG_WARN("Server cannot offer dragged {}: {}", path.string(), offer.error().message());
+            continue;
+        }
+        mServed.insert_or_assign(offer->transferId, Served {
+            .dragId = mDrag->id,
+            .path = std::move(path),
+            .offer = *offer,
+        });
+        mDrag->offers.push_back(std::move(*offer));
+    }
+    if (!mDrag->offers.empty()) {
+        dragMetrics().started.add();
+        SPDLOG_INFO("Server started drag {} with {} files", mDrag->id, mDrag->offers.size());
+    }
+}
+
+auto ServerDrag::acceptRelease(Release release) -> Task<void> {
+    if (!mDrag) {
+        co_return;
+    }
+    auto drag = std::move(*mDrag);
+    mDrag.reset();
+    const auto dropped = release.target && drag.offeredTo.contains(*release.target);
+
+    // Only the drop target may go on fetching.
+    for (auto &[transferId, served] : mServed) {
+        if (served.dragId != drag.id) {
+            continue;
+        }
+        std::erase_if(served.owners, [&](const std::string &owner) {
+            return !dropped || owner != release.ownerId;
+        });
+    }
+
+    for (const auto &endpoint : drag.offeredTo) {
+        const auto isTarget = dropped && endpoint == *release.target;
+        (void) co_await sendTo(endpoint, RpcMessage {DragEndMessage {
+            .dragId = drag.id,
+            .dropped = isTarget,
+        }});
+    }
+    if (dropped) {
+        dragMetrics().dropped.add();
+        SPDLOG_INFO("Server dropped drag {} on {}", drag.id, *release.target);
+    }
+    else if (!drag.offeredTo.empty()) {
+        SPDLOG_INFO("Server cancelled drag {}: dropped outside the clients it was offered to", drag.id);
+    }
+}
+
+auto ServerDrag::sendTo(IPEndpoint endpoint, RpcMessage message) -> Task<bool> {
+    auto it = mSenders.find(endpoint);
+    if (it == mSenders.end()) {
+        co_return false;
+    }
+    // Copied: the session may end while the message waits for room.
+    auto sender = it->second;
+    co_return static_cast<bool>(co_await sender.send(std::move(message)));
+}
+
+// MARK: Fetches
+
+auto ServerDrag::serveFetch(std::string_view ownerId, RpcTransport &transport, FileFetchMessage fetch) -> IoTask<void> {
+    auto it = mServed.find(fetch.transferId);
+    if (it == mServed.end() || !it->second.owners.contains(ownerId)) {
+        SPDLOG_WARN("Server refused fetch of {} by owner={}: not offered", fetch.transferId, ownerId);
+        (void) co_await transport.writeMessage(RpcMessage {ErrorMessage {
+            .message = "no such drag",
+        }});
+        co_return Err(FileTransferError::Rejected);
+    }
+    // Copied: a later drag may replace the entry while this one streams.
+    auto path = it->second.path;
+    auto offer = it->second.offer;
+    dragMetrics().fetches.add();
+    ILIAS_CO_TRYV(co_await transport.writeMessage(RpcMessage {offer}));
+    ILIAS_CO_TRY(auto stats, co_await mFiles.send(transport, std::move(path), offer));
+    SPDLOG_INFO(
+        "Server served dragged {} to owner={}: {} bytes in {} chunks, {} reused",
+        offer.manifest.name,
+        ownerId,
+        stats.bytes,
+        stats.chunks,
+        stats.reusedChunks
+    );
+    co_return {};
+}
+
+MKS_END
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "core.hpp"
+#include "file_transfer.hpp"
+#include "platform/platform.hpp"
+#include "rpc/message.hpp"
+#include "server_input.hpp"
+#include <ilias/net.hpp>
+#include <ilias/sync.hpp>
+#include <ilias/task.hpp>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+MKS_BEGIN
+
+using ilias::IPEndpoint;
+
+/**
+ * @brief Server side of file drag-and-drop onto client screens.
+ *
+ * When a held button carries the cursor from a local screen onto a client,
+ * the local @ref DragSource is asked what is being dragged. Each file is
+ * hashed into a manifest and offered to that client right away (and to any
+ * other client the drag crosses), so it can fetch in the background while
+ * the button is still down. The release then tells the client under the
+ * cursor that it got the drop and every other one to discard its copy.
+ *
+ * Fetches arrive on file connections of their own (@ref serveFetch) and are
+ * served by @ref FileTransfers::send, like files a client sends.
+ */
+class ServerDrag {
+public:
+    /**
+     * @param senders Session queues for DragOfferMessage and DragEndMessage.
+     * @param files   Transfers of the server; fetches are sent through it.
+     */
+    ServerDrag(ServerInputRouter::ClientSenders &senders, FileTransfers &files);
+
+    /** @brief Attach or clear the local drag source (nullptr on shutdown). */
+    auto setSource(DragSource *source) -> void;
+
+    /** @brief ServerInputRouter::DragHandlers::onCross. */
+    auto crossed(const VirtualScreen &from, const VirtualScreen &to) -> void;
+
+    /** @brief ServerInputRouter::DragHandlers::onRelease. */
+    auto released(const VirtualScreen &target) -> void;
+
+    /** @brief Handle crossings and releases in order; offers are hashed and sent here. */
+    auto run() -> Task<void>;
+
+    /**
+     * @brief ServerSession::Context::onFileFetch — send a file of a drag
+     *        offered to @p ownerId.
+     *
+     * Writes the file's FileOfferMessage, or an ErrorMessage when the drag
+     * is gone or was never offered to this client, then streams the chunks.
+     */
+    auto serveFetch(std::string_view ownerId, RpcTransport &transport, FileFetchMessage fetch) -> IoTask<void>;
+
+private:
+    struct Cross {
+        IPEndpoint endpoint;
+        std::string ownerId;
+        bool fromLocal = false;
+        bool toLocal = false;
+    };
+
+    struct Release {
+        // Client under the cursor; nullopt when the drop was on a local screen.
+        std::optional<IPEndpoint> target;
+        std::string ownerId;
+    };
+
+    using Event = std::variant<Cross, Release>;
+
+    /** @brief The drag of the button held right now. */
+    struct Drag {
+        uint32_t id = 0;
+        // Empty when the drag carries no local files; crossings are then ignored.
+        std::vector<FileOfferMessage> offers;
+        std::set<IPEndpoint> offeredTo;
+    };
+
+    /** @brief A dragged file clients may fetch. */
+    struct Served {
+        uint32_t dragId = 0;
+        std::filesystem::path path;
+        FileOfferMessage offer;
+        // Clients that may fetch it; narrowed to the drop target on release.
+        std::set<std::string, std::less<>> owners;
+    };
+
+    auto acceptCross(Cross cross) -> Task<void>;
+    auto acceptRelease(Release release) -> Task<void>;
+    /** @brief Ask the source and hash what it drags into a new @c mDrag. */
+    auto startDrag() -> Task<void>;
+    /** @brief Queue @p message on @p endpoint's session, waiting for room. */
+    auto sendTo(IPEndpoint endpoint, RpcMessage message) -> Task<bool>;
+
+    ServerInputRouter::ClientSenders &mSenders;
+    FileTransfers &mFiles;
+    DragSource *mSource = nullptr;
+    // Feeds run(); empty while run() is not serving.
+    ilias::mpsc::Sender<Event> mEvents;
+    // A crossing was queued since the last release, so the next release matters.
+    bool mHolding = false;
+    std::optional<Drag> mDrag;
+    uint32_t mNextDragId = 0;
+    // Transfer id → file, for the current and the previous drag.
+    std::map<std::string, Served, std::less<>> mServed;
+};
+
+MKS_END
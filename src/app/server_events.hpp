@@ -0,0 +1,66 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "core.hpp"
+#include "plugin/mks_plugin.h"
+#include <ilias/net.hpp>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+MKS_BEGIN
+
+using ilias::IPEndpoint;
+
+/**
+ * @brief Where Server publishes what happens to it, without knowing who
+ *        listens.
+ *
+ * @ref PluginHost implements it for plugins, and through them for event
+ * subscribers in other processes; the server only ever sees this interface,
+ * so it builds and tests without either.
+ *
+ * Each event kind is one @c MKS_EVENT_* bit. The implementation keeps the OR
+ * of what its listeners want in @c mEvents, so input nobody wants costs the
+ * publisher one inline mask test and no virtual call.
+ *
+ * Called on the server's event loop thread only.
+ */
+class ServerEvents {
+public:
+    virtual ~ServerEvents() = default;
+
+    /** @brief Whether anyone wants one of @p events. */
+    auto wants(uint32_t events) const noexcept -> bool { return (mEvents & events) != 0; }
+
+    /** @brief Captured local input; call after it was routed. */
+    auto publish(const InputEvent &event) -> void {
+        // Variant index i is MKS_EVENT_* bit i (checked in plugin_host.cpp).
+        const auto type = uint32_t {1} << event.index();
+        if (wants(type)) {
+            publishInput(event, type);
+        }
+    }
+
+    /** @brief The layout changed; @p screens is all of it. */
+    virtual auto publishScreens(std::span<const TopologyScreen> screens) -> void = 0;
+
+    /** @brief A machine copied; @p owner is the client, nullopt for the server. */
+    virtual auto publishClipboard(const ClipboardOffer &offer, std::optional<IPEndpoint> owner) -> void = 0;
+
+    /** @brief Keyboard and mouse moved from screen @p from to @p to. */
+    virtual auto publishScreenSwitch(const ScreenKey &from, const ScreenPoint &to, bool toLocal) -> void = 0;
+
+    virtual auto publishSessionOpened(IPEndpoint endpoint, std::string_view ownerId, bool resumed) -> void = 0;
+    virtual auto publishSessionClosed(IPEndpoint endpoint, std::string_view ownerId, bool suspended) -> void = 0;
+
+protected:
+    /** @brief @c publish past the mask test; @p type is the event's bit. */
+    virtual auto publishInput(const InputEvent &event, uint32_t type) -> void = 0;
+
+    // OR of every listener's subscription.
+    uint32_t mEvents = 0;
+};
+
+MKS_END
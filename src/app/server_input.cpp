@@ -1,10 +1,69 @@
 #include "server_input.hpp"
+#include "diag/flight_recorder.hpp"
+#include "diag/metrics.hpp"
+#include "diag/probes.hpp"
+#include "diag/trace.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <utility>
 
 MKS_BEGIN
 
+namespace {
+
+struct RouterMetrics {
+    Counter &events;
+    Counter &queued;
+    Counter &droppedNoSender;
+    Counter &droppedQueueFull;
+    // Releases past kMaxHeldReleases for a suspended route.
+    Counter &droppedHeldReleases;
+    Counter &screenSwitches;
+    Counter &backendErrors;
+    // Queued on session channels but not yet taken by a writer. Messages
+    // still buffered when a session closes are not subtracted, so this can
+    // overcount by at most one channel depth per disconnect.
+    Gauge &pending;
+    // Wall time spent routing one captured event, in nanoseconds.
+    Histogram &routeNs;
+};
+
+auto routerMetrics() -> RouterMetrics & {
+    static auto result = RouterMetrics {
+        .events = metrics().counter("server.input.events"),
+        .queued = metrics().counter("server.input.queued"),
+        .droppedNoSender = metrics().counter("server.input.dropped_no_sender"),
+        .droppedQueueFull = metrics().counter("server.input.dropped_queue_full"),
+        .droppedHeldReleases = metrics().counter("server.input.dropped_held_releases"),
+        .screenSwitches = metrics().counter("server.screen_switches"),
+        .backendErrors = metrics().counter("server.backend_errors"),
+        .pending = metrics().gauge("server.input.pending"),
+        .routeNs = metrics().histogram("server.input.route_ns"),
+    };
+    return result;
+}
+
+// Releases kept per suspended endpoint. On resume they are queued together
+// with the cursor move, so this stays below the session channel depth (10).
+constexpr auto kMaxHeldReleases = size_t {8};
+
+auto isRelease(const InputEvent &event) -> bool {
+    if (const auto *key = std::get_if<KeyEvent>(&event)) {
+        return key->release;
+    }
+    if (const auto *button = std::get_if<MouseButtonEvent>(&event)) {
+        return button->release;
+    }
+    return false;
+}
+
+auto buttonBit(MouseButton button) -> uint32_t {
+    return uint32_t {1} << static_cast<uint32_t>(button);
+}
+
+} // namespace
+
 // MARK: Lifecycle / active screen
 
 ServerInputRouter::ServerInputRouter(ServerScreenStore &screens, ClientSenders &senders)
@@ -17,6 +76,14 @@ auto ServerInputRouter::setCapture(InputCapture *capture) -> void {
     updateCaptureRemoteControl();
 }
 
+auto ServerInputRouter::setDragHandlers(DragHandlers handlers) -> void {
+    mDrag = std::move(handlers);
+}
+
+auto ServerInputRouter::setSwitchHandler(SwitchHandler handler) -> void {
+    mOnSwitch = std::move(handler);
+}
+
 auto ServerInputRouter::activeScreen() const -> VirtualScreen * {
     return mActiveScreen;
 }
@@ -57,21 +124,108 @@ auto ServerInputRouter::ensureActiveLocalScreen(bool preferLocalPrimary) -> void
     }
 }
 
+auto ServerInputRouter::clampActivePoint() -> void {
+    if (!mActiveScreen || !mActivePoint || mActivePoint->key != mActiveScreen->key) {
+        return;
+    }
+    const auto x = std::clamp(mActivePoint->x, 0, std::max(0, mActiveScreen->info.width - 1));
+    const auto y = std::clamp(mActivePoint->y, 0, std::max(0, mActiveScreen->info.height - 1));
+    if (x == mActivePoint->x && y == mActivePoint->y) {
+        return;
+    }
+    mActivePoint->x = x;
+    mActivePoint->y = y;
+    SPDLOG_INFO("Server active cursor clamped to resized screen: {}", *mActivePoint);
+    if (!mActiveScreen->local) {
+        queueInputForScreen(*mActiveScreen, InputEvent {MouseMoveEvent {
+            .x = x,
+            .y = y,
+            .screenIndex = mActivePoint->key.screenIndex,
+        }});
+    }
+}
+
+// MARK: Session resumption
+
+auto ServerInputRouter::holdReleases(IPEndpoint endpoint) -> void {
+    mHeldReleases.try_emplace(endpoint);
+}
+
+auto ServerInputRouter::resumeRoute(IPEndpoint from, IPEndpoint to) -> void {
+    auto held = mHeldReleases.extract(from);
+    if (mActiveScreen && !mActiveScreen->local && mActiveScreen->endpoint == to && mActivePoint) {
+        // The client's cursor may have moved on its own while disconnected.
+        queueInputForScreen(*mActiveScreen, InputEvent {MouseMoveEvent {
+            .x = mActivePoint->x,
+            .y = mActivePoint->y,
+            .screenIndex = mActivePoint->key.screenIndex,
+        }});
+    }
+    if (!held || held.mapped().empty()) {
+        return;
+    }
+    auto *screen = mScreens.findEndpointScreen(to);
+    if (!screen) {
+        return;
+    }
+    SPDLOG_INFO("Server replaying {} held releases to {}", held.mapped().size(), to);
+    for (const auto &event : held.mapped()) {
+        queueInputForScreen(*screen, event);
+    }
+}
+
+auto ServerInputRouter::dropHeldReleases(IPEndpoint endpoint) -> void {
+    mHeldReleases.erase(endpoint);
+}
+
 // MARK: Event entry
 
 auto ServerInputRouter::handleInputEvent(const InputEvent &event) -> void {
-    SPDLOG_TRACE(
-        "Server handling input event active={} point={} event={}",
-        mActiveScreen ? fmtlib::format("{}", mActiveScreen->key) : std::string {"<none>"},
-        mActivePoint ? fmtlib::format("{}", *mActivePoint) : std::string {"<none>"},
-        event
-    );
+    // Every return path below counts as one routed event.
+    struct RouteTimer {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        ~RouteTimer() {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            routerMetrics().events.add();
+            routerMetrics().routeNs.record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()
+            ));
+        }
+    } timer;
+
+    // The optional parts are formatted into temporaries before spdlog checks
+    // the level, so only build them when trace output is actually wanted.
+    if (spdlog::should_log(spdlog::level::trace)) {
+        SPDLOG_TRACE(
+            "Server handling input event active={} point={} event={}",
+            mActiveScreen ? fmtlib::format("{}", mActiveScreen->key) : std::string {"<none>"},
+            mActivePoint ? fmtlib::format("{}", *mActivePoint) : std::string {"<none>"},
+            event
+        );
+    }
 
     if (tryHandleLocalHotkey(event)) {
         SPDLOG_TRACE("Server consumed local hotkey event {}", event);
         return;
     }
 
+    // Presses count before routing, so a crossing they start is seen as a
+    // drag; releases after, so the drop follows the release on the wire.
+    const auto *button = std::get_if<MouseButtonEvent>(&event);
+    if (button && !button->release) {
+        mHeldButtons |= buttonBit(button->button);
+    }
+    routeInputEvent(event);
+    if (button && button->release && mHeldButtons != 0) {
+        mHeldButtons &= ~buttonBit(button->button);
+        if (mHeldButtons == 0 && mActiveScreen && mDrag.onRelease) {
+            mDrag.onRelease(*mActiveScreen);
+        }
+    }
+}
+
+auto ServerInputRouter::routeInputEvent(const InputEvent &event) -> void {
     if (mActiveScreen && !mActiveScreen->local) {
         // While a remote screen is active, all non-mouse input belongs to that
         // client. Mouse movement still needs special handling because the local
@@ -210,25 +364,31 @@ auto ServerInputRouter::handleRemoteMouseMove(const MouseMoveEvent &event) -> vo
         return;
     }
 
-    auto nextPoint = *mActivePoint;
-    nextPoint.x += deltaX;
-    nextPoint.y += deltaY;
-    SPDLOG_TRACE("Server remote virtual cursor candidate {}", nextPoint);
+    // Move the virtual cursor in place: copying the point would copy its
+    // owner id string on every motion event. Every path below either
+    // switches screens or clamps it back inside the active one.
+    auto &candidate = *mActivePoint;
+    const auto x = candidate.x + deltaX;
+    const auto y = candidate.y + deltaY;
+    candidate.x = x;
+    candidate.y = y;
+    SPDLOG_TRACE("Server remote virtual cursor candidate {}", candidate);
 
     // Check crossing before clamping so an overshoot past the remote edge can
     // move into the neighbor instead of getting stuck at the border pixel.
-    if (auto edge = mScreens.topology().hitEdge(nextPoint)) {
-        SPDLOG_TRACE("Server remote virtual cursor hit edge {} at {}", *edge, nextPoint);
-        if (auto target = mScreens.topology().mapEntryPoint(nextPoint, *edge)) {
-            SPDLOG_TRACE("Server remote mouse maps {} across {} to {}", nextPoint, *edge, *target);
-            switchActiveScreen(*target);
-            return;
+    if (auto edge = mScreens.topology().hitEdge(candidate)) {
+        SPDLOG_TRACE("Server remote virtual cursor hit edge {} at {}", *edge, candidate);
+        if (auto target = mScreens.topology().mapEntryPoint(candidate, *edge)) {
+            SPDLOG_TRACE("Server remote mouse maps {} across {} to {}", candidate, *edge, *target);
+            if (switchActiveScreen(std::move(*target))) {
+                return;
+            }
         }
         else {
             SPDLOG_TRACE(
                 "Server remote edge {} has no mapped target from {}: {}",
                 *edge,
-                nextPoint,
+                candidate,
                 target.error().message()
             );
         }
@@ -238,8 +398,8 @@ auto ServerInputRouter::handleRemoteMouseMove(const MouseMoveEvent &event) -> vo
     const auto maxY = std::max(0, mActiveScreen->info.height - 1);
     // No neighbor accepted the movement, so keep the virtual cursor inside the
     // active remote screen and send an absolute pixel position to the client.
-    mActivePoint->x = std::clamp(nextPoint.x, 0, maxX);
-    mActivePoint->y = std::clamp(nextPoint.y, 0, maxY);
+    candidate.x = std::clamp(x, 0, maxX);
+    candidate.y = std::clamp(y, 0, maxY);
     SPDLOG_TRACE("Server remote virtual cursor clamped to {}", *mActivePoint);
 
     queueInputForScreen(*mActiveScreen, InputEvent {MouseMoveEvent {
@@ -251,13 +411,17 @@ auto ServerInputRouter::handleRemoteMouseMove(const MouseMoveEvent &event) -> vo
 
 // MARK: Screen switch / capture
 
-auto ServerInputRouter::switchActiveScreen(ScreenPoint point) -> void {
+auto ServerInputRouter::switchActiveScreen(ScreenPoint point) -> bool {
     auto *screen = mScreens.findScreen(point.key);
     if (!screen) {
-        return;
+        return false;
     }
 
+    auto *previous = mActiveScreen;
     if (mActiveScreen && mActiveScreen->key != screen->key) {
+        MKS_PROBE2(screen_switch, mActiveScreen->key.screenIndex, screen->key.screenIndex);
+        routerMetrics().screenSwitches.add();
+        flightRecord(FlightStage::ScreenSwitch, screen->key.screenIndex);
         SPDLOG_INFO(
             "Server active screen changed {} -> {} at {}",
             mActiveScreen->key,
@@ -293,6 +457,14 @@ auto ServerInputRouter::switchActiveScreen(ScreenPoint point) -> void {
     else {
         moveLocalCursorToActivePoint();
     }
+
+    if (previous && previous != screen && mOnSwitch) {
+        mOnSwitch(*previous, *screen, *mActivePoint);
+    }
+    if (mHeldButtons != 0 && previous && previous != screen && mDrag.onCross) {
+        mDrag.onCross(*previous, *screen);
+    }
+    return true;
 }
 
 auto ServerInputRouter::eventAtActivePoint(InputEvent event) const -> InputEvent {
@@ -337,6 +509,7 @@ auto ServerInputRouter::moveLocalCursorToActivePoint() -> void {
         mActivePoint->y
     );
     if (!result) {
+        routerMetrics().backendErrors.add();
         SPDLOG_WARN(
             "Server failed to move local cursor to {}: {}",
             *mActivePoint,
@@ -357,6 +530,7 @@ auto ServerInputRouter::updateCaptureRemoteControl() -> void {
     const auto active = mActiveScreen && !mActiveScreen->local;
     auto result = mCapture->setRemoteControlActive(active);
     if (!result) {
+        routerMetrics().backendErrors.add();
         SPDLOG_WARN(
             "Server failed to {} local input capture for remote control: {}",
             active ? "enable" : "disable",
@@ -373,12 +547,41 @@ auto ServerInputRouter::queueInputForScreen(const VirtualScreen &screen, InputEv
 
     auto it = mSenders.find(screen.endpoint);
     if (it == mSenders.end() || !it->second) {
+        if (auto held = mHeldReleases.find(screen.endpoint); held != mHeldReleases.end()) {
+            // Suspended session: expected to come back, so no warning per event.
+            if (isRelease(event)) {
+                if (held->second.size() < kMaxHeldReleases) {
+                    held->second.push_back(event);
+                    return false;
+                }
+                // The key may stay stuck on the client after it resumes.
+                routerMetrics().droppedHeldReleases.add();
+                flightRecord(FlightStage::Drop, event, screen.key.screenIndex);
+                SPDLOG_DEBUG(
+                    "Server dropped release for suspended {}: {} already held, event={}",
+                    screen.endpoint,
+                    kMaxHeldReleases,
+                    event
+                );
+                return false;
+            }
+            routerMetrics().droppedNoSender.add();
+            flightRecord(FlightStage::Drop, event, screen.key.screenIndex);
+            return false;
+        }
+        routerMetrics().droppedNoSender.add();
+        MKS_PROBE3(queue, screen.key.screenIndex, event.index(), 0);
+        flightRecord(FlightStage::Drop, event, screen.key.screenIndex);
         SPDLOG_WARN("Server has no sender for remote screen {}", screen.key);
         return false;
     }
 
+    // InputEvent is a small trivially copyable variant; keep our copy for the
+    // flight record instead of moving it into the message.
+    const auto traceId = nextTraceId();
     auto message = RpcMessage {InputMessage {
-        .event = std::move(event),
+        .event = event,
+        .traceId = traceId,
     }};
     SPDLOG_TRACE(
         "Server queueing input for remote screen {} endpoint={} message={}",
@@ -387,9 +590,23 @@ auto ServerInputRouter::queueInputForScreen(const VirtualScreen &screen, InputEv
         message
     );
     if (!it->second.trySend(std::move(message))) {
+        routerMetrics().droppedQueueFull.add();
+        MKS_PROBE3(queue, screen.key.screenIndex, event.index(), 0);
+        flightRecord(FlightStage::Drop, event, screen.key.screenIndex);
         SPDLOG_WARN("Server failed to queue input for remote screen {}", screen.key);
         return false;
     }
+    routerMetrics().queued.add();
+    routerMetrics().pending.add(1);
+    MKS_PROBE3(queue, screen.key.screenIndex, event.index(), 1);
+    traceFlow(TraceFlow::Start, traceId);
+    traceAsyncBegin("channel", traceId);
+    flightRecord(
+        FlightStage::Queue,
+        event,
+        screen.key.screenIndex,
+        static_cast<uint32_t>(std::max<int64_t>(0, routerMetrics().pending.value()))
+    );
     return true;
 }
 
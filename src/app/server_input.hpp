@@ -2,14 +2,18 @@
 
 #include "preinclude.hpp"
 #include "core.hpp"
+#include "outbound_queue.hpp"
 #include "platform/platform.hpp"
 #include "rpc/message.hpp"
 #include "server_screens.hpp"
 #include "server_types.hpp"
 #include <ilias/net.hpp>
 #include <ilias/sync.hpp>
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <optional>
+#include <vector>
 
 MKS_BEGIN
 
@@ -34,7 +38,31 @@ using ilias::IPEndpoint;
 class ServerInputRouter {
 public:
     /** Endpoint → session write queue for remote InputMessage delivery. */
-    using ClientSenders = std::map<IPEndpoint, ilias::mpsc::Sender<RpcMessage>>;
+    using ClientSenders = std::map<IPEndpoint, OutboundSender>;
+
+    /**
+     * @brief Observers of drags: the cursor moving between screens with a
+     *        mouse button held (file drag-and-drop, @ref ServerDrag).
+     *
+     * Called synchronously while routing; the screens are store nodes that
+     * must not be kept past the call.
+     */
+    struct DragHandlers {
+        // A held button carried the cursor from @p from onto @p to. Runs after
+        // the entry move was queued, so messages queued here follow it.
+        std::function<void(const VirtualScreen &from, const VirtualScreen &to)> onCross;
+        // The last held button came up over @p target, after the release was routed.
+        std::function<void(const VirtualScreen &target)> onRelease;
+    };
+
+    /**
+     * @brief Observer of screen switches, called once the new screen is active.
+     *
+     * Like DragHandlers it runs synchronously while routing and must not keep
+     * the screens past the call; @p entry is the cursor on @p to.
+     */
+    using SwitchHandler =
+        std::function<void(const VirtualScreen &from, const VirtualScreen &to, const ScreenPoint &entry)>;
 
     /**
      * @param screens Topology and VirtualScreen storage (not owned).
@@ -47,6 +75,12 @@ public:
      */
     auto setCapture(InputCapture *capture) -> void;
 
+    /** @brief Attach drag observers; empty handlers detach them. */
+    auto setDragHandlers(DragHandlers handlers) -> void;
+
+    /** @brief Attach the screen switch observer; an empty handler detaches it. */
+    auto setSwitchHandler(SwitchHandler handler) -> void;
+
     /** @brief Process one captured event (hotkeys, local edge, remote motion). */
     auto handleInputEvent(const InputEvent &event) -> void;
 
@@ -69,11 +103,44 @@ public:
      */
     auto ensureActiveLocalScreen(bool preferLocalPrimary = false) -> void;
 
+    /**
+     * @brief Keep the cursor inside the active screen after it changed in place.
+     *
+     * Call after a hot-plug report resized the active screen. A remote client
+     * is sent the clamped position so its cursor does not sit off-screen.
+     */
+    auto clampActivePoint() -> void;
+
+    // MARK: Session resumption
+
+    /**
+     * @brief Start buffering key/button releases for a suspended endpoint.
+     *
+     * While the route is suspended the active screen may stay on it; events
+     * that would have gone there are dropped quietly, except releases, which
+     * are kept for @c resumeRoute so no key stays stuck on the client.
+     */
+    auto holdReleases(IPEndpoint endpoint) -> void;
+
+    /**
+     * @brief Continue routing to @p to after a session resumed from @p from.
+     *
+     * Store nodes must already be re-keyed and the new sender published.
+     * Re-sends the cursor position when the active screen is on @p to, then
+     * replays the held releases.
+     */
+    auto resumeRoute(IPEndpoint from, IPEndpoint to) -> void;
+
+    /** @brief Forget held releases once a suspended route expires. */
+    auto dropHeldReleases(IPEndpoint endpoint) -> void;
+
 private:
     auto tryHandleLocalHotkey(const InputEvent &event) -> bool;
+    auto routeInputEvent(const InputEvent &event) -> void;
     auto handleMouseMove(const MouseMoveEvent &event) -> void;
     auto handleRemoteMouseMove(const MouseMoveEvent &event) -> void;
-    auto switchActiveScreen(ScreenPoint point) -> void;
+    /** @brief Make @p point active; false when its screen is gone, changing nothing. */
+    auto switchActiveScreen(ScreenPoint point) -> bool;
     auto eventAtActivePoint(InputEvent event) const -> InputEvent;
     auto suppressPendingLocalWarp(const ScreenPoint &point) -> bool;
     auto moveLocalCursorToActivePoint() -> void;
@@ -93,6 +160,12 @@ private:
     std::optional<MouseMoveEvent> mLastLocalMouse;
     // Suppress one local motion echo after SetCursorPos / warp on return home.
     std::optional<ScreenPoint> mPendingLocalWarp;
+    // Suspended endpoint → releases to replay when its session resumes.
+    std::map<IPEndpoint, std::vector<InputEvent>> mHeldReleases;
+    // Bit per MouseButton currently down; non-zero while a drag can be in progress.
+    uint32_t mHeldButtons = 0;
+    DragHandlers mDrag;
+    SwitchHandler mOnSwitch;
 };
 
 MKS_END
@@ -1,9 +1,49 @@
 #include "server_screens.hpp"
+#include "worker_pool.hpp"
 
 #include <algorithm>
+#include <mutex>
+#include <utility>
 
 MKS_BEGIN
 
+namespace {
+
+auto writeConfig(const std::filesystem::path &path, const AppConfig &config) -> void {
+    auto saved = saveConfig(path, config);
+    if (!saved) {
+        SPDLOG_WARN(
+            "Server failed to save config {}: {}",
+            path.string(),
+            saved.error().message()
+        );
+    }
+}
+
+// A whole layout takes longer to format than an event takes to route, so
+// with a pool the formatting happens there, from a copy.
+template <typename Snapshot>
+auto logLayout(WorkerPool *workers, std::string_view what, Snapshot snapshot) -> void {
+    if (!spdlog::should_log(spdlog::level::info)) {
+        return;
+    }
+    if (!workers) {
+        SPDLOG_INFO("Server {} {}", what, snapshot);
+        return;
+    }
+    workers->post([what, snapshot = std::move(snapshot)] {
+        SPDLOG_INFO("Server {} {}", what, snapshot);
+    });
+}
+
+} // namespace
+
+struct ServerScreenStore::PendingSave {
+    std::mutex mutex;
+    std::optional<AppConfig> config;
+    bool writing = false;
+};
+
 // MARK: Construction / queries
 
 ServerScreenStore::ServerScreenStore(AppConfig config, std::filesystem::path configPath)
@@ -11,6 +51,10 @@ ServerScreenStore::ServerScreenStore(AppConfig config, std::filesystem::path con
       mConfigPath(std::move(configPath)) {
 }
 
+auto ServerScreenStore::setWorkerPool(WorkerPool *workers) -> void {
+    mWorkers = workers;
+}
+
 auto ServerScreenStore::config() const -> const AppConfig & {
     return mConfig;
 }
@@ -102,7 +146,7 @@ auto ServerScreenStore::registerScreens(
         addScreen(endpoint, std::move(key), cell, info, local);
     }
 
-    SPDLOG_INFO("Server topology screens {}", mTopology.screens());
+    logTopology();
 }
 
 auto ServerScreenStore::addScreen(
@@ -140,7 +184,7 @@ auto ServerScreenStore::addScreen(
     // Only successful registrations are persisted; failed topology mutations
     // would otherwise corrupt the remembered layout.
     rememberScreenLayout(it->second.key, it->second.cell);
-    SPDLOG_INFO("Server current screens {}", mScreens);
+    logScreens();
     return &it->second;
 }
 
@@ -162,10 +206,104 @@ auto ServerScreenStore::removeScreen(IPEndpoint endpoint, VirtualScreen *activeS
     for (const auto &registeredOwnerId : ownerIds) {
         mTopology.removeOwner(registeredOwnerId);
     }
-    SPDLOG_INFO("Server current screens {}", mScreens);
+    logScreens();
     return activeRemoved;
 }
 
+auto ServerScreenStore::applyScreenChanges(
+    IPEndpoint endpoint,
+    const ScreensChangedMessage &changes,
+    bool local,
+    VirtualScreen *activeScreen
+) -> bool {
+    auto range = mScreens.equal_range(endpoint);
+    auto ownerId = range.first != range.second
+        ? range.first->second.key.ownerId
+        : defaultOwnerId(endpoint, local);
+
+    // Unplugged screens go first so the cells they free can take new screens.
+    auto activeRemoved = false;
+    for (auto it = range.first; it != range.second;) {
+        if (it->second.key.screenIndex < changes.count) {
+            ++it;
+            continue;
+        }
+        SPDLOG_INFO("Server screen {}:{} was unplugged", ownerId, it->second.key.screenIndex);
+        if (activeScreen != nullptr && &it->second == activeScreen) {
+            activeRemoved = true;
+        }
+        mTopology.removeScreen(it->second.key);
+        it = mScreens.erase(it);
+    }
+
+    for (const auto &update : changes.updates) {
+        if (update.screenIndex >= changes.count) {
+            continue;
+        }
+        auto key = ScreenKey {
+            .ownerId = ownerId,
+            .screenIndex = update.screenIndex,
+        };
+        range = mScreens.equal_range(endpoint);
+        auto existing = std::find_if(range.first, range.second, [&](const auto &entry) {
+            return entry.second.key.screenIndex == update.screenIndex;
+        });
+        if (existing != range.second) {
+            // Resolution, position or primary changed; the cell stays.
+            if (auto updated = mTopology.updateScreenInfo(key, update.info); !updated) {
+                SPDLOG_ERROR(
+                    "Server failed to update screen {}:{}: {}",
+                    key.ownerId,
+                    key.screenIndex,
+                    updated.error().message()
+                );
+                continue;
+            }
+            existing->second.info = update.info;
+            continue;
+        }
+
+        // A re-docked monitor gets its remembered cell back unless another
+        // screen took it meanwhile.
+        auto cell = configuredCell(key);
+        if (cell && std::ranges::any_of(mTopology.screens(), [&](const auto &screen) {
+            return screen.cell == *cell;
+        })) {
+            cell.reset();
+        }
+        addScreen(endpoint, std::move(key), cell ? *cell : nextFreeCell(1), update.info, local);
+    }
+
+    logTopology();
+    return activeRemoved;
+}
+
+auto ServerScreenStore::moveEndpoint(IPEndpoint from, IPEndpoint to) -> void {
+    if (from == to) {
+        return;
+    }
+    while (auto node = mScreens.extract(from)) {
+        node.key() = to;
+        node.mapped().endpoint = to;
+        mScreens.insert(std::move(node));
+    }
+    if (auto owner = mEndpointOwners.extract(from)) {
+        owner.key() = to;
+        mEndpointOwners.insert_or_assign(to, std::move(owner.mapped()));
+    }
+}
+
+auto ServerScreenStore::matchesScreens(IPEndpoint endpoint, const std::vector<ScreenInfo> &screens) const -> bool {
+    auto range = mScreens.equal_range(endpoint);
+    if (static_cast<size_t>(std::distance(range.first, range.second)) != screens.size()) {
+        return false;
+    }
+    return std::all_of(range.first, range.second, [&](const auto &entry) {
+        const auto &screen = entry.second;
+        return screen.key.screenIndex < screens.size() && screens[screen.key.screenIndex] == screen.info;
+    });
+}
+
 // MARK: Lookup / owners
 
 auto ServerScreenStore::findScreen(const ScreenKey &key) -> VirtualScreen * {
@@ -186,6 +324,11 @@ auto ServerScreenStore::findScreen(const ScreenKey &key) const -> const VirtualS
     return nullptr;
 }
 
+auto ServerScreenStore::findEndpointScreen(IPEndpoint endpoint) -> VirtualScreen * {
+    auto it = mScreens.find(endpoint);
+    return it == mScreens.end() ? nullptr : &it->second;
+}
+
 auto ServerScreenStore::firstLocalScreen() -> VirtualScreen * {
     auto selected = mScreens.end();
     for (auto it = mScreens.begin(); it != mScreens.end(); ++it) {
@@ -252,15 +395,47 @@ auto ServerScreenStore::saveConfigIfNeeded() -> void {
     if (mConfigPath.empty()) {
         return;
     }
+    if (!mWorkers) {
+        writeConfig(mConfigPath, mConfig);
+        return;
+    }
 
-    auto saved = saveConfig(mConfigPath, mConfig);
-    if (!saved) {
-        SPDLOG_WARN(
-            "Server failed to save config {}: {}",
-            mConfigPath.string(),
-            saved.error().message()
-        );
+    // One writer at a time per store, always writing the newest snapshot: a
+    // burst of registrations costs one or two writes, and an older layout can
+    // never land after a newer one.
+    if (!mPendingSave) {
+        mPendingSave = std::make_shared<PendingSave>();
     }
+    {
+        auto lock = std::scoped_lock {mPendingSave->mutex};
+        mPendingSave->config = mConfig;
+        if (mPendingSave->writing) {
+            return;
+        }
+        mPendingSave->writing = true;
+    }
+    mWorkers->post([pending = mPendingSave, path = mConfigPath] {
+        while (true) {
+            auto config = std::optional<AppConfig> {};
+            {
+                auto lock = std::scoped_lock {pending->mutex};
+                config = std::exchange(pending->config, std::nullopt);
+                if (!config) {
+                    pending->writing = false;
+                    return;
+                }
+            }
+            writeConfig(path, *config);
+        }
+    });
+}
+
+auto ServerScreenStore::logScreens() const -> void {
+    logLayout(mWorkers, "current screens", mScreens);
+}
+
+auto ServerScreenStore::logTopology() const -> void {
+    logLayout(mWorkers, "topology screens", mTopology.screens());
 }
 
 auto ServerScreenStore::nextFreeCell(int32_t startX) const -> GridPosition {
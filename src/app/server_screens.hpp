@@ -3,9 +3,11 @@
 #include "preinclude.hpp"
 #include "config/app_config.hpp"
 #include "core.hpp"
+#include "rpc/message.hpp"
 #include "server_types.hpp"
 #include <filesystem>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -13,13 +15,17 @@
 
 MKS_BEGIN
 
+class WorkerPool;
+
 /**
  * @brief Topology cells, VirtualScreen routes, owner ids, and layout config.
  *
  * Responsibilities:
- * - Register / replace / remove screens for an endpoint.
+ * - Register / replace / remove screens for an endpoint, or patch them in
+ *   place from a hot-plug report.
  * - Map @c ScreenKey to square-grid neighbors via @ref ScreenTopology.
- * - Persist layout cells into @ref AppConfig when a config path is set.
+ * - Persist layout cells into @ref AppConfig when a config path is set. With
+ *   a worker pool the file is written there; saves coalesce and land in order.
  * - Resolve owner id (local machineId vs remote Hello machineId vs endpoint).
  *
  * Non-responsibilities:
@@ -38,6 +44,14 @@ public:
      */
     ServerScreenStore(AppConfig config, std::filesystem::path configPath);
 
+    /**
+     * @brief Serialize, write the config and format layout logs on @p workers.
+     *
+     * Without one (the default) that work runs inline, which is what tests
+     * reading the file right after a change rely on.
+     */
+    auto setWorkerPool(WorkerPool *workers) -> void;
+
     auto config() const -> const AppConfig &;
     auto topologyScreens() const -> std::vector<TopologyScreen>;
     auto topology() const -> const ScreenTopology &;
@@ -70,8 +84,39 @@ public:
      */
     auto removeScreen(IPEndpoint endpoint, VirtualScreen *activeScreen) -> bool;
 
+    /**
+     * @brief Apply an incremental report (hot-plug) to @p endpoint in place.
+     *
+     * Removed indices are erased first, changed ones keep their node and cell,
+     * and added ones take their configured cell or the next free one. Nodes
+     * that are not removed stay where they are, so an active pointer to them
+     * stays valid. Screens are registered for @p endpoint when it has none.
+     *
+     * @return true if @p activeScreen was among the removed screens (same
+     *         contract as @ref removeScreen).
+     */
+    auto applyScreenChanges(
+        IPEndpoint endpoint,
+        const ScreensChangedMessage &changes,
+        bool local,
+        VirtualScreen *activeScreen
+    ) -> bool;
+
+    /**
+     * @brief Re-key every screen of @p from to @p to (a resumed session's new socket).
+     *
+     * Nodes are moved, not copied, so @c VirtualScreen pointers held by the
+     * input router stay valid. Cells, topology and owner ids are unchanged.
+     */
+    auto moveEndpoint(IPEndpoint from, IPEndpoint to) -> void;
+
+    /** @brief True if @p endpoint currently owns exactly @p screens, in index order. */
+    auto matchesScreens(IPEndpoint endpoint, const std::vector<ScreenInfo> &screens) const -> bool;
+
     auto findScreen(const ScreenKey &key) -> VirtualScreen *;
     auto findScreen(const ScreenKey &key) const -> const VirtualScreen *;
+    /** @brief Any one screen owned by @p endpoint, or null. */
+    auto findEndpointScreen(IPEndpoint endpoint) -> VirtualScreen *;
 
     /**
      * @brief Prefer primary local screen; otherwise first local in map order.
@@ -94,6 +139,8 @@ private:
     auto configuredCell(const ScreenKey &key) const -> std::optional<GridPosition>;
     auto rememberScreenLayout(const ScreenKey &key, GridPosition cell) -> void;
     auto saveConfigIfNeeded() -> void;
+    auto logScreens() const -> void;
+    auto logTopology() const -> void;
     auto nextFreeCell(int32_t startX) const -> GridPosition;
 
     AppConfig mConfig;
@@ -103,6 +150,10 @@ private:
     ScreenTopology mTopology;
     // endpoint → last Hello machineId / owner string for re-registration.
     std::map<IPEndpoint, std::string> mEndpointOwners;
+    WorkerPool *mWorkers = nullptr;
+    // Latest config waiting for the worker writing it; shared with that job.
+    struct PendingSave;
+    std::shared_ptr<PendingSave> mPendingSave;
 };
 
 MKS_END
@@ -1,17 +1,75 @@
 #include "server_session.hpp"
+#include "clipboard_transfer.hpp"
+#include "diag/flight_recorder.hpp"
+#include "diag/metrics.hpp"
+#include "diag/trace.hpp"
 
+#include <algorithm>
+#include <system_error>
 #include <utility>
 
 MKS_BEGIN
 
+namespace {
+
+// Queued input per client; small on purpose, see writeLoop().
+constexpr auto kInputDepth = size_t {10};
+
+struct SessionMetrics {
+    Gauge &active;
+    Counter &opened;
+    Counter &closed;
+    Counter &rejected;
+    Gauge &pendingInput;
+};
+
+auto sessionMetrics() -> SessionMetrics & {
+    static auto result = SessionMetrics {
+        .active = metrics().gauge("server.sessions.active"),
+        .opened = metrics().counter("server.sessions.opened"),
+        .closed = metrics().counter("server.sessions.closed"),
+        .rejected = metrics().counter("server.sessions.rejected"),
+        .pendingInput = metrics().gauge("server.input.pending"),
+    };
+    return result;
+}
+
+// Errors of the connection itself, as opposed to the peer closing it,
+// breaking the protocol (RpcError) or this side cancelling the session (e.g.
+// a shard writer whose queue shutdown() closed).
+auto isTransportFailure(std::error_code error) -> bool {
+    if (error == std::errc::operation_canceled) {
+        return false;
+    }
+    return error.category() != make_error_code(RpcError::Closed).category();
+}
+
+} // namespace
+
 ServerSession::ServerSession(Context context, TcpStream stream, IPEndpoint endpoint)
     : mContext(std::move(context)),
       mTransport(std::move(stream)),
       mEndpoint(endpoint) {
 }
 
+ServerSession::ServerSession(
+    Context context,
+    SocketStream stream,
+    IPEndpoint endpoint,
+    IoShards &shards,
+    SocketStream writer
+)
+    : mContext(std::move(context)),
+      mTransport(std::move(stream)),
+      mEndpoint(endpoint),
+      mShards(&shards),
+      mWriter(std::move(writer)) {
+}
+
 auto ServerSession::run() -> IoTask<void> {
     SPDLOG_INFO("Server accepted incoming connection from {}", mEndpoint);
+    sessionMetrics().opened.add();
+    sessionMetrics().active.add(1);
 
     // Always detach this peer from topology/routing when the session ends —
     // handshake failure, protocol error, cancel, or clean stop.
@@ -20,20 +78,59 @@ auto ServerSession::run() -> IoTask<void> {
 
         ~Guard() {
             SPDLOG_INFO("Server closing connection from {}", self->mEndpoint);
+            sessionMetrics().closed.add();
+            sessionMetrics().active.add(-1);
             if (self->mContext.onClosed) {
-                self->mContext.onClosed(self->mEndpoint);
+                self->mContext.onClosed(self->mEndpoint, self->mBroken);
             }
         }
     } guard {this};
 
-    ILIAS_CO_TRYV(co_await handshake());
+    if (auto handshaken = co_await handshake(); !handshaken) {
+        mBroken = isTransportFailure(handshaken.error());
+        co_return Err(handshaken.error());
+    }
+
+    if (mFileOffer) {
+        auto received = mContext.onFileOffer
+            ? co_await mContext.onFileOffer(mOwnerId, mTransport, std::move(*mFileOffer))
+            : IoResult<void> {Err(RpcError::ProtocolError)};
+        co_await shutdown();
+        co_return received;
+    }
+    if (mFileFetch) {
+        auto served = mContext.onFileFetch
+            ? co_await mContext.onFileFetch(mOwnerId, mTransport, std::move(*mFileFetch))
+            : IoResult<void> {Err(RpcError::ProtocolError)};
+        co_await shutdown();
+        co_return served;
+    }
 
-    auto [readResult, writeResult] = co_await ilias::finally(
-        ilias::whenAny(readLoop(), writeLoop()),
+    auto [readResult, writeResult, stopped] = co_await ilias::finally(
+        ilias::whenAny(readLoop(), writeLoop(), waitStopped()),
         shutdown()
     );
 
+    if (stopped) {
+        SPDLOG_INFO(
+            "Server stopped superseded connection endpoint={} owner={} name={}",
+            mEndpoint,
+            mOwnerId,
+            mName
+        );
+        co_return {};
+    }
+    if (readResult && !*readResult && readResult->error() == RpcError::Closed) {
+        SPDLOG_INFO(
+            "Server client closed the connection endpoint={} owner={} name={}",
+            mEndpoint,
+            mOwnerId,
+            mName
+        );
+        co_return {};
+    }
     if (readResult && !*readResult) {
+        mBroken = isTransportFailure(readResult->error());
         SPDLOG_WARN(
             "Server client read loop ended unexpectedly endpoint={} owner={} name={}: {}",
             mEndpoint,
@@ -44,6 +141,7 @@ auto ServerSession::run() -> IoTask<void> {
         co_return Err(readResult->error());
     }
     if (writeResult && !*writeResult) {
+        mBroken = isTransportFailure(writeResult->error());
         SPDLOG_WARN(
             "Server client write loop ended unexpectedly endpoint={} owner={} name={}: {}",
             mEndpoint,
@@ -73,13 +171,46 @@ auto ServerSession::handshake() -> IoTask<void> {
     mContext.screens.rememberOwner(mEndpoint, mOwnerId);
     mName = hello->name;
 
+    // Clients send Screens in the same flush as Hello. It is read before the
+    // version and trust decisions so a rejected peer has nothing left unread
+    // when the socket closes (which would turn the close into a reset and
+    // could drop the ErrorMessage). A peer on another version may lay it out
+    // differently, so only its framing has to hold then.
+    auto read = co_await mTransport.readMessage();
+    if (hello->version != kProtocolVersion) {
+        SPDLOG_WARN(
+            "Server rejected client {} name={}: protocol version {}, expected {}",
+            mEndpoint,
+            hello->name,
+            hello->version,
+            kProtocolVersion
+        );
+        co_return co_await reject(
+            "protocol version " + std::to_string(hello->version) + " is not supported, server speaks " +
+            std::to_string(kProtocolVersion)
+        );
+    }
+    ILIAS_CO_TRY(auto next, std::move(read));
+    if (auto *offer = std::get_if<FileOfferMessage>(&next)) {
+        mFileOffer = std::move(*offer);
+    }
+    if (auto *fetch = std::get_if<FileFetchMessage>(&next)) {
+        mFileFetch = std::move(*fetch);
+    }
+    const auto fileConnection = mFileOffer || mFileFetch;
+    auto screens = std::get_if<ScreensMessage>(&next);
+    if (!screens && !fileConnection) {
+        SPDLOG_ERROR("Server expected screens from {}, got {}", mEndpoint, next);
+        co_return Err(RpcError::ProtocolError);
+    }
+
     if (!isClientTrusted(*hello)) {
         SPDLOG_WARN(
             "Server rejected untrusted client {} name={}",
             mEndpoint,
             hello->name
         );
-        co_return Err(RpcError::ProtocolError);
+        co_return co_await reject("client is not trusted");
     }
 
     SPDLOG_INFO(
@@ -88,21 +219,113 @@ auto ServerSession::handshake() -> IoTask<void> {
         hello->version,
         hello->name
     );
-    co_return {};
+    if (fileConnection) {
+        // A file connection carries no input; it never gets a sender.
+        co_return {};
+    }
+
+    // Registering here, with the sender already published, makes the peer
+    // routable the moment the handshake completes rather than after the
+    // loops start. A resumed route replays held releases into it right away.
+    if (mShards) {
+        auto queue = OutboundQueue::create(kInputDepth, kClipboardBulkDepth);
+        if (!queue) {
+            co_return Err(queue.error());
+        }
+        mOutbound = std::move(*queue);
+        mContext.senders[mEndpoint] = OutboundSender {mOutbound, OutboundQueue::Lane::Urgent};
+        mContext.bulkSenders[mEndpoint] = OutboundSender {mOutbound, OutboundQueue::Lane::Bulk};
+    }
+    else {
+        auto [sender, receiver] = ilias::mpsc::channel<RpcMessage>(kInputDepth);
+        mSender = sender;
+        mReceiver = std::move(receiver);
+        mContext.senders[mEndpoint] = sender;
+        auto [bulkSender, bulkReceiver] = ilias::mpsc::channel<RpcMessage>(kClipboardBulkDepth);
+        mBulkSender = bulkSender;
+        mBulkReceiver = std::move(bulkReceiver);
+        mContext.bulkSenders[mEndpoint] = bulkSender;
+    }
+    auto [stop, stopped] = ilias::oneshot::channel<std::monostate>();
+    mContext.stops.insert_or_assign(mEndpoint, std::move(stop));
+    mStopped.emplace(std::move(stopped));
+    if (!mContext.onHandshake) {
+        acceptScreens(*screens);
+        co_return {};
+    }
+
+    auto welcome = mContext.onHandshake(mEndpoint, mOwnerId, hello->resumeToken, screens->screens);
+    if (welcome.resumed) {
+        SPDLOG_INFO("Server resumed route for {} owner={}", mEndpoint, mOwnerId);
+    }
+    // Written before the loops start, so it precedes any queued input.
+    co_return co_await mTransport.writeMessage(RpcMessage {std::move(welcome)});
+}
+
+auto ServerSession::reject(std::string reason) -> IoTask<void> {
+    sessionMetrics().rejected.add();
+    // Tell the client why, so it can release the injector it brought up
+    // while connecting instead of retrying blindly.
+    (void) co_await mTransport.writeMessage(RpcMessage {ErrorMessage {
+        .message = std::move(reason),
+    }});
+    (void) co_await mTransport.shutdown();
+    co_return Err(RpcError::Rejected);
+}
+
+auto ServerSession::acceptScreens(const ScreensMessage &screens) -> void {
+    SPDLOG_TRACE(
+        "Server received screens endpoint={} owner={} count={}",
+        mEndpoint,
+        mOwnerId,
+        screens.screens.size()
+    );
+    if (mContext.onScreens) {
+        mContext.onScreens(mEndpoint, mOwnerId, screens.screens);
+    }
+}
+
+auto ServerSession::acceptScreenChanges(const ScreensChangedMessage &changes) -> IoResult<void> {
+    for (const auto &update : changes.updates) {
+        if (update.screenIndex >= changes.count) {
+            SPDLOG_ERROR(
+                "Server received screen update {} past count {} from {}",
+                update.screenIndex,
+                changes.count,
+                mEndpoint
+            );
+            return Err(RpcError::ProtocolError);
+        }
+    }
+    SPDLOG_INFO(
+        "Server received screen changes endpoint={} owner={} count={} updated={}",
+        mEndpoint,
+        mOwnerId,
+        changes.count,
+        changes.updates.size()
+    );
+    if (mContext.onScreensChanged) {
+        mContext.onScreensChanged(mEndpoint, changes);
+    }
+    return {};
 }
 
 auto ServerSession::readLoop() -> IoTask<void> {
     while (true) {
         ILIAS_CO_TRY(auto msg, co_await mTransport.readMessage());
         if (auto screens = std::get_if<ScreensMessage>(&msg)) {
-            SPDLOG_TRACE(
-                "Server received screens endpoint={} owner={} count={}",
-                mEndpoint,
-                mOwnerId,
-                screens->screens.size()
-            );
-            if (mContext.onScreens) {
-                mContext.onScreens(mEndpoint, mOwnerId, screens->screens);
+            acceptScreens(*screens);
+            continue;
+        }
+        if (auto changes = std::get_if<ScreensChangedMessage>(&msg)) {
+            ILIAS_CO_TRYV(acceptScreenChanges(*changes));
+            continue;
+        }
+        if (std::holds_alternative<ClipboardOfferMessage>(msg) ||
+            std::holds_alternative<ClipboardRequestMessage>(msg) ||
+            std::holds_alternative<ClipboardDataMessage>(msg)) {
+            if (mContext.onClipboard) {
+                co_await mContext.onClipboard(mEndpoint, std::move(msg));
             }
             continue;
         }
@@ -112,21 +335,76 @@ auto ServerSession::readLoop() -> IoTask<void> {
 }
 
 auto ServerSession::writeLoop() -> IoTask<void> {
-    // Publish the sender so ServerInputRouter can enqueue InputMessage without
-    // owning this writer coroutine. Channel depth is intentionally small for
-    // now; backpressure policy is still open (see docs M8).
-    auto [sender, reader] = ilias::mpsc::channel<RpcMessage>(10);
-    mSender = sender;
-    mContext.senders[mEndpoint] = sender;
-
+    // handshake() published the sender so ServerInputRouter can enqueue
+    // InputMessage without owning this writer coroutine. Channel depth is
+    // intentionally small for now; backpressure policy is still open (see docs M8).
+    // Clipboard chunks wait in the bulk queue until nothing else is pending.
+    if (mOutbound) {
+        // Encoding and socket writes happen on the shard; this only waits
+        // for the writer to end. shutdown() closes the queue, which ends it.
+        co_return co_await mShards->run(
+            [queue = mOutbound, writer = std::move(*mWriter), endpoint = mEndpoint]() mutable {
+                return writeFromShard(std::move(queue), std::move(writer), endpoint);
+            }
+        );
+    }
     while (true) {
-        auto msg = (co_await reader.recv()).value();
+        auto msg = (co_await nextOutbound(mReceiver, mBulkReceiver)).value();
+        if (const auto *input = std::get_if<InputMessage>(&msg)) {
+            sessionMetrics().pendingInput.add(-1);
+            traceAsyncEnd("channel", input->traceId);
+            flightRecord(
+                FlightStage::Send,
+                input->event,
+                FlightRecord::kNoScreen,
+                static_cast<uint32_t>(std::max<int64_t>(0, sessionMetrics().pendingInput.value()))
+            );
+        }
         SPDLOG_TRACE("Server writing message to {}: {}", mEndpoint, msg);
         ILIAS_CO_TRYV(co_await mTransport.writeMessage(std::move(msg)));
     }
     co_return {};
 }
 
+auto ServerSession::waitStopped() -> IoTask<void> {
+    // Sent or dropped alike: the host is done with this connection.
+    (void) co_await std::move(*mStopped);
+    co_return {};
+}
+
+auto ServerSession::writeFromShard(
+    std::shared_ptr<OutboundQueue> queue,
+    SocketStream writer,
+    IPEndpoint endpoint
+) -> IoTask<void> {
+    auto receiver = OutboundReceiver {queue};
+    auto transport = RpcTransport {std::move(writer)};
+    // writeLoop() on the shard's thread; a dead writer closes the queue, so
+    // producers see the connection gone instead of filling it.
+    while (true) {
+        auto msg = co_await receiver.recv();
+        if (!msg) {
+            queue->close();
+            co_return Err(msg.error());
+        }
+        if (const auto *input = std::get_if<InputMessage>(&*msg)) {
+            sessionMetrics().pendingInput.add(-1);
+            traceAsyncEnd("channel", input->traceId);
+            flightRecord(
+                FlightStage::Send,
+                input->event,
+                FlightRecord::kNoScreen,
+                static_cast<uint32_t>(std::max<int64_t>(0, sessionMetrics().pendingInput.value()))
+            );
+        }
+        SPDLOG_TRACE("Server writing message to {}: {}", endpoint, *msg);
+        if (auto written = co_await transport.writeMessage(std::move(*msg)); !written) {
+            queue->close();
+            co_return Err(written.error());
+        }
+    }
+}
+
 auto ServerSession::shutdown() -> Task<void> {
     SPDLOG_INFO(
         "Server shutting down client connection endpoint={} owner={} name={}",
@@ -134,6 +412,9 @@ auto ServerSession::shutdown() -> Task<void> {
         mOwnerId,
         mName
     );
+    if (mOutbound) {
+        mOutbound->close();
+    }
     auto result = co_await mTransport.shutdown();
     if (!result) {
         SPDLOG_WARN(
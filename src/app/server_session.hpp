@@ -2,15 +2,22 @@
 
 #include "preinclude.hpp"
 #include "core.hpp"
+#include "io_shards.hpp"
+#include "outbound_queue.hpp"
 #include "rpc/message.hpp"
 #include "rpc/transport.hpp"
 #include "server_input.hpp"
 #include "server_screens.hpp"
 #include <functional>
 #include <ilias/net.hpp>
+#include <ilias/sync/oneshot.hpp>
 #include <ilias/task.hpp>
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <variant>
 #include <vector>
 
 MKS_BEGIN
@@ -28,12 +35,34 @@ using ilias::TcpStream;
  * Lifecycle:
  * 1. Host accepts a @c TcpStream and resolves @c endpoint.
  * 2. Construct the session and call @c run().
- * 3. Hello handshake, then concurrent read/write until failure or cancel.
- * 4. On exit (any path), @c Context::onClosed removes this endpoint from
- *    routing/topology. Persisted config layout is intentionally kept.
+ * 3. Handshake: Hello (protocol version and trust checks, ErrorMessage on
+ *    rejection), then the sender is published and @c Context::onHandshake
+ *    registers the client's first ScreensMessage or resumes its suspended
+ *    route; the result goes back as a WelcomeMessage. A FileOfferMessage in
+ *    place of the screens makes this a file connection instead: after the
+ *    same trust check it is handed to @c Context::onFileOffer and closed,
+ *    without ever becoming routable. A FileFetchMessage there does the same in the other
+ *    direction, through @c Context::onFileFetch.
+ * 4. Concurrent read/write until failure or cancel. Hot-plug reports
+ *    (@c ScreensChangedMessage) go to @c Context::onScreensChanged and
+ *    clipboard messages to @c Context::onClipboard. The writer drains the
+ *    clipboard bulk queue only while no input is queued. A session built
+ *    with @ref IoShards runs its writer on a shard instead, fed through an
+ *    @ref OutboundQueue; the reader and every callback stay on the host's
+ *    thread either way.
+ * 5. On exit (any path), @c Context::onClosed detaches this endpoint from
+ *    routing. When the connection broke, the host may keep the route
+ *    suspended for a grace period; a clean close releases it at once.
+ *    Persisted config layout is intentionally kept.
  */
 class ServerSession {
 public:
+    /**
+     * @brief Published per endpoint with the senders; dropping it ends that
+     * session's @c run() as if the peer had closed.
+     */
+    using StopHandle = ilias::oneshot::Sender<std::monostate>;
+
     /**
      * @brief Host-owned state and callbacks required by a session.
      *
@@ -42,9 +71,28 @@ public:
     struct Context {
         ServerScreenStore &screens;
         ServerInputRouter::ClientSenders &senders;
+        // Endpoint → clipboard chunk queue, written behind @c senders.
+        ServerInputRouter::ClientSenders &bulkSenders;
+        // Endpoint → handle the host drops to stop that session, e.g. once a
+        // resume moved its route to a new connection.
+        std::map<IPEndpoint, StopHandle> &stops;
 
         /**
-         * @brief Replace remote screens after a @c ScreensMessage.
+         * @brief Complete an accepted handshake.
+         *
+         * Resumes the route named by @p resumeToken when it is still
+         * suspended and the screens are unchanged; otherwise registers
+         * @p screens like @c onScreens. Returns the reply for the client.
+         */
+        std::function<WelcomeMessage(
+            IPEndpoint endpoint,
+            std::string_view ownerId,
+            std::string_view resumeToken,
+            const std::vector<ScreenInfo> &screens
+        )> onHandshake;
+
+        /**
+         * @brief Replace remote screens after a later @c ScreensMessage.
          *
          * Implemented by Server so store + input active-screen invariants stay
          * consistent (clear active pointer before erasing map nodes).
@@ -55,12 +103,57 @@ public:
             const std::vector<ScreenInfo> &screens
         )> onScreens;
 
+        /**
+         * @brief Patch remote screens in place after a @c ScreensChangedMessage.
+         *
+         * Unlike @c onScreens this keeps unaffected screens and the active
+         * cursor on them, so a dock/undock does not interrupt control.
+         */
+        std::function<void(
+            IPEndpoint endpoint,
+            const ScreensChangedMessage &changes
+        )> onScreensChanged;
+
+        /**
+         * @brief Handle a clipboard offer, request or data chunk.
+         *
+         * Awaited before the next read, so a relay waiting for room in
+         * another peer's bulk queue slows this peer down rather than
+         * buffering its chunks.
+         */
+        std::function<Task<void>(IPEndpoint endpoint, RpcMessage message)> onClipboard;
+
+        /**
+         * @brief Receive the file offered instead of screens at handshake.
+         *
+         * Owns @p transport until it returns; the session closes it after.
+         */
+        std::function<IoTask<void>(
+            std::string_view ownerId,
+            RpcTransport &transport,
+            FileOfferMessage offer
+        )> onFileOffer;
+
+        /**
+         * @brief Serve the dragged file asked for instead of screens at handshake.
+         *
+         * Owns @p transport until it returns; the session closes it after.
+         */
+        std::function<IoTask<void>(
+            std::string_view ownerId,
+            RpcTransport &transport,
+            FileFetchMessage fetch
+        )> onFileFetch;
+
         /**
          * @brief Cleanup after the session ends (always, including failed handshake).
          *
-         * Typical work: drop endpoint screens, erase sender, forget owner id.
+         * Typical work: erase sender, then suspend the route when @p broken
+         * or drop endpoint screens and forget the owner id. @p broken means
+         * the connection failed (I/O error, reset, a frame cut short); a
+         * clean close, a rejection, a protocol error or a cancel is not.
          */
-        std::function<void(IPEndpoint endpoint)> onClosed;
+        std::function<void(IPEndpoint endpoint, bool broken)> onClosed;
     };
 
     /**
@@ -70,6 +163,20 @@ public:
      *                 does not expose remoteEndpoint on the buffered stream).
      */
     ServerSession(Context context, TcpStream stream, IPEndpoint endpoint);
+
+    /**
+     * @brief Session whose writer runs on one of @p shards.
+     *
+     * @param stream Read and handshake on the calling thread.
+     * @param writer Duplicate of @p stream, written only from the shard.
+     */
+    ServerSession(
+        Context context,
+        SocketStream stream,
+        IPEndpoint endpoint,
+        IoShards &shards,
+        SocketStream writer
+    );
     ServerSession(const ServerSession &) = delete;
     ServerSession(ServerSession &&) = delete;
     auto operator=(const ServerSession &) -> ServerSession & = delete;
@@ -83,8 +190,19 @@ public:
 
 private:
     auto handshake() -> IoTask<void>;
+    /** @brief Send @p reason as an ErrorMessage and end the handshake with Rejected. */
+    auto reject(std::string reason) -> IoTask<void>;
+    auto acceptScreens(const ScreensMessage &screens) -> void;
+    auto acceptScreenChanges(const ScreensChangedMessage &changes) -> IoResult<void>;
     auto readLoop() -> IoTask<void>;
     auto writeLoop() -> IoTask<void>;
+    /** @brief Completes once the host dropped (or sent to) this session's StopHandle. */
+    auto waitStopped() -> IoTask<void>;
+    static auto writeFromShard(
+        std::shared_ptr<OutboundQueue> queue,
+        SocketStream writer,
+        IPEndpoint endpoint
+    ) -> IoTask<void>;
     auto shutdown() -> Task<void>;
     auto isClientTrusted(const HelloMessage &hello) const -> bool;
 
@@ -98,6 +216,24 @@ private:
     std::string mName;
     // Outbound queue handle mirrored into Context::senders for input routing.
     ilias::mpsc::Sender<RpcMessage> mSender;
+    // Drained by writeLoop(); created during the handshake.
+    ilias::mpsc::Receiver<RpcMessage> mReceiver;
+    // Clipboard chunks, mirrored into Context::bulkSenders; written only when mReceiver is empty.
+    ilias::mpsc::Sender<RpcMessage> mBulkSender;
+    ilias::mpsc::Receiver<RpcMessage> mBulkReceiver;
+    // Other end of the StopHandle in Context::stops; created during the handshake.
+    std::optional<ilias::oneshot::Receiver<std::monostate>> mStopped;
+    // Sharded sessions only: where the writer runs, the socket it writes to
+    // until handed over, and its queue, mirrored into both sender maps.
+    IoShards *mShards = nullptr;
+    std::optional<SocketStream> mWriter;
+    std::shared_ptr<OutboundQueue> mOutbound;
+    // Set by a file connection's handshake; run() then receives the file only.
+    std::optional<FileOfferMessage> mFileOffer;
+    // Likewise for a connection fetching a dragged file; run() then serves it only.
+    std::optional<FileFetchMessage> mFileFetch;
+    // Set when run() ends on a failed connection; see Context::onClosed.
+    bool mBroken = false;
 };
 
 MKS_END
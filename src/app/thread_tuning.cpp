@@ -0,0 +1,283 @@
+#include "thread_tuning.hpp"
+#include "diag/metrics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+#if defined(__linux__)
+    #include <sched.h>
+    #include <sys/mman.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+MKS_BEGIN
+
+namespace {
+
+struct SchedulingMetrics {
+    Histogram &wakeupLateNs;
+    Counter &runDelayNs;
+    Counter &involuntarySwitches;
+    Gauge &policy;
+    Gauge &nice;
+};
+
+auto schedulingMetrics() -> SchedulingMetrics & {
+    static auto result = SchedulingMetrics {
+        .wakeupLateNs = metrics().histogram("sched.wakeup_late_ns"),
+        .runDelayNs = metrics().counter("sched.run_delay_ns"),
+        .involuntarySwitches = metrics().counter("sched.involuntary_switches"),
+        // 0 normal, 1 fifo, 2 round robin; as applied, not as asked for.
+        .policy = metrics().gauge("sched.policy"),
+        .nice = metrics().gauge("sched.nice"),
+    };
+    return result;
+}
+
+auto parseIndex(std::string_view text) -> IoResult<size_t> {
+    auto value = size_t {0};
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || ec != std::errc {} || end != text.data() + text.size()) {
+        return Err(std::make_error_code(std::errc::invalid_argument));
+    }
+    return value;
+}
+
+#if defined(__linux__)
+
+// Ticks of watchSchedulingDelay() between two reads of the kernel's counters.
+constexpr auto kKernelSampleEvery = 10;
+
+auto lastError() -> std::error_code {
+    return std::error_code(errno, std::generic_category());
+}
+
+auto cpuListText(const std::vector<size_t> &cpus) -> std::string {
+    auto text = std::string {};
+    for (const auto cpu : cpus) {
+        text += text.empty() ? "" : ",";
+        text += std::to_string(cpu);
+    }
+    return text;
+}
+
+auto policyName(ThreadTuning::Policy policy) -> std::string_view {
+    switch (policy) {
+        case ThreadTuning::Policy::Fifo:
+            return "SCHED_FIFO";
+        case ThreadTuning::Policy::RoundRobin:
+            return "SCHED_RR";
+        default:
+            return "SCHED_OTHER";
+    }
+}
+
+// The process's CPU set from before a thread was pinned; written once,
+// before gPinned is set, and only read after seeing it set.
+cpu_set_t gUnpinned {};
+std::atomic<bool> gPinned {false};
+
+auto pinThread(const std::vector<size_t> &cpus) -> IoResult<void> {
+    auto before = cpu_set_t {};
+    if (::sched_getaffinity(0, sizeof(before), &before) != 0) {
+        return Err(lastError());
+    }
+    auto wanted = cpu_set_t {};
+    CPU_ZERO(&wanted);
+    for (const auto cpu : cpus) {
+        if (cpu >= CPU_SETSIZE) {
+            return Err(std::make_error_code(std::errc::invalid_argument));
+        }
+        CPU_SET(cpu, &wanted);
+    }
+    if (::sched_setaffinity(0, sizeof(wanted), &wanted) != 0) {
+        return Err(lastError());
+    }
+    if (!gPinned.load(std::memory_order_acquire)) {
+        gUnpinned = before;
+        gPinned.store(true, std::memory_order_release);
+    }
+    return {};
+}
+
+// Real-time first, a raised nice value when that is refused.
+auto raisePriority(const ThreadTuning &tuning, AppliedTuning &applied) -> void {
+    const auto policy = tuning.policy == ThreadTuning::Policy::Fifo ? SCHED_FIFO : SCHED_RR;
+    auto param = sched_param {};
+    param.sched_priority = std::clamp(
+        tuning.priority,
+        ::sched_get_priority_min(policy),
+        ::sched_get_priority_max(policy)
+    );
+    if (::sched_setscheduler(0, policy | SCHED_RESET_ON_FORK, &param) == 0) {
+        applied.policy = tuning.policy;
+        SPDLOG_INFO("Thread scheduled {} at priority {}", policyName(tuning.policy), param.sched_priority);
+        return;
+    }
+    SPDLOG_WARN(
+        "{} not permitted ({}), raising the thread's nice value to {} instead",
+        policyName(tuning.policy),
+        lastError().message(),
+        kFallbackNice
+    );
+    // Still reset on fork, so helper threads do not inherit the nice value.
+    auto normal = sched_param {};
+    (void) ::sched_setscheduler(0, SCHED_OTHER | SCHED_RESET_ON_FORK, &normal);
+    const auto tid = static_cast<id_t>(::syscall(SYS_gettid));
+    if (::setpriority(PRIO_PROCESS, tid, kFallbackNice) != 0) {
+        SPDLOG_WARN("Thread left at normal priority: {}", lastError().message());
+        return;
+    }
+    applied.nice = kFallbackNice;
+}
+
+// "cpu_ns run_delay_ns timeslices"; zero when the kernel keeps no schedstats.
+auto threadRunDelay() -> uint64_t {
+    auto file = std::ifstream {"/proc/thread-self/schedstat"};
+    auto cpuNs = uint64_t {0};
+    auto runDelayNs = uint64_t {0};
+    if (!(file >> cpuNs >> runDelayNs)) {
+        return 0;
+    }
+    return runDelayNs;
+}
+
+auto threadInvoluntarySwitches() -> uint64_t {
+    auto usage = rusage {};
+    if (::getrusage(RUSAGE_THREAD, &usage) != 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(usage.ru_nivcsw);
+}
+
+#endif
+
+} // namespace
+
+// MARK: Parsing
+
+auto parseSchedulingPolicy(std::string_view text) -> IoResult<ThreadTuning::Policy> {
+    if (text.empty() || text == "off") {
+        return ThreadTuning::Policy::Normal;
+    }
+    if (text == "fifo") {
+        return ThreadTuning::Policy::Fifo;
+    }
+    if (text == "rr") {
+        return ThreadTuning::Policy::RoundRobin;
+    }
+    return Err(std::make_error_code(std::errc::invalid_argument));
+}
+
+auto parseCpuList(std::string_view text) -> IoResult<std::vector<size_t>> {
+    auto cpus = std::vector<size_t> {};
+    while (!text.empty()) {
+        const auto comma = text.find(',');
+        const auto item = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view {} : text.substr(comma + 1);
+
+        const auto dash = item.find('-');
+        ILIAS_TRY(auto first, parseIndex(item.substr(0, dash)));
+        auto last = first;
+        if (dash != std::string_view::npos) {
+            ILIAS_TRY(last, parseIndex(item.substr(dash + 1)));
+        }
+        if (last < first) {
+            return Err(std::make_error_code(std::errc::invalid_argument));
+        }
+        for (auto cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    std::ranges::sort(cpus);
+    const auto [end, _] = std::ranges::unique(cpus);
+    cpus.erase(end, cpus.end());
+    return cpus;
+}
+
+// MARK: Tuning
+
+auto applyThreadTuning(const ThreadTuning &tuning) -> AppliedTuning {
+    auto applied = AppliedTuning {};
+    if (!tuning.enabled()) {
+        return applied;
+    }
+#if defined(__linux__)
+    // Locked first, so the pages the loop touches from here on are already in.
+    if (tuning.lockMemory) {
+        if (::mlockall(MCL_CURRENT) == 0) {
+            applied.memoryLocked = true;
+            SPDLOG_INFO("Locked the process's mapped memory");
+        }
+        else {
+            SPDLOG_WARN("Failed to lock memory: {}", lastError().message());
+        }
+    }
+    if (!tuning.cpus.empty()) {
+        if (auto pinned = pinThread(tuning.cpus); pinned) {
+            applied.pinned = true;
+            SPDLOG_INFO("Thread pinned to CPUs {}", cpuListText(tuning.cpus));
+        }
+        else {
+            SPDLOG_WARN("Failed to pin the thread to CPUs {}: {}", cpuListText(tuning.cpus), pinned.error().message());
+        }
+    }
+    if (tuning.policy != ThreadTuning::Policy::Normal) {
+        raisePriority(tuning, applied);
+    }
+#else
+    SPDLOG_WARN("Thread scheduling options are only supported on Linux, ignoring them");
+#endif
+    auto &metrics = schedulingMetrics();
+    metrics.policy.set(static_cast<int64_t>(applied.policy));
+    metrics.nice.set(applied.nice);
+    return applied;
+}
+
+auto resetThreadTuning() noexcept -> void {
+#if defined(__linux__)
+    if (gPinned.load(std::memory_order_acquire)) {
+        (void) ::sched_setaffinity(0, sizeof(gUnpinned), &gUnpinned);
+    }
+#endif
+}
+
+// MARK: Probe
+
+auto watchSchedulingDelay(std::chrono::milliseconds period) -> Task<void> {
+    auto &metrics = schedulingMetrics();
+#if defined(__linux__)
+    auto runDelay = threadRunDelay();
+    auto switches = threadInvoluntarySwitches();
+#endif
+    for (auto tick = 1;; ++tick) {
+        const auto deadline = std::chrono::steady_clock::now() + period;
+        co_await ilias::sleep(period);
+        const auto late = std::chrono::steady_clock::now() - deadline;
+        metrics.wakeupLateNs.record(static_cast<uint64_t>(
+            std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(late).count())
+        ));
+#if defined(__linux__)
+        if (tick % kKernelSampleEvery != 0) {
+            continue;
+        }
+        // Both only grow; max() guards a counter that is unavailable (0).
+        const auto nextRunDelay = threadRunDelay();
+        metrics.runDelayNs.add(std::max(nextRunDelay, runDelay) - runDelay);
+        runDelay = nextRunDelay;
+        const auto nextSwitches = threadInvoluntarySwitches();
+        metrics.involuntarySwitches.add(std::max(nextSwitches, switches) - switches);
+        switches = nextSwitches;
+#endif
+    }
+}
+
+MKS_END
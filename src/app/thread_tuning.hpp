@@ -0,0 +1,89 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include <ilias/task.hpp>
+#include <chrono>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+MKS_BEGIN
+
+/**
+ * @brief How the latency-critical thread of a role is scheduled.
+ *
+ * That is the event loop thread: it captures and routes input on the server
+ * and injects it on the client. Everything here is opt-in; a default value
+ * leaves the thread as the OS started it.
+ */
+struct ThreadTuning {
+    enum class Policy {
+        Normal,
+        Fifo,
+        RoundRobin,
+    };
+
+    Policy policy = Policy::Normal;
+    /** @brief @c SCHED_FIFO / @c SCHED_RR priority, clamped to what the system allows. */
+    int priority = 10;
+    /** @brief CPUs the thread may run on; empty leaves its placement alone. */
+    std::vector<size_t> cpus;
+    /** @brief Keep the pages mapped so far resident (@c mlockall(MCL_CURRENT)). */
+    bool lockMemory = false;
+
+    auto enabled() const noexcept -> bool {
+        return policy != Policy::Normal || !cpus.empty() || lockMemory;
+    }
+};
+
+/** @brief What @ref applyThreadTuning got, after fallbacks. */
+struct AppliedTuning {
+    ThreadTuning::Policy policy = ThreadTuning::Policy::Normal;
+    /** @brief Nice value set when a real-time policy was refused; 0 otherwise. */
+    int nice = 0;
+    bool pinned = false;
+    bool memoryLocked = false;
+};
+
+/** @brief Nice value used when a real-time policy is not permitted. */
+inline constexpr int kFallbackNice = -10;
+
+/** @brief How often @ref watchSchedulingDelay wakes up. */
+inline constexpr auto kSchedulingProbePeriod = std::chrono::milliseconds {100};
+
+/** @brief "off", "fifo" or "rr". */
+auto parseSchedulingPolicy(std::string_view text) -> IoResult<ThreadTuning::Policy>;
+
+/** @brief CPU list like "2", "0,2" or "4-7"; empty text gives an empty list. */
+auto parseCpuList(std::string_view text) -> IoResult<std::vector<size_t>>;
+
+/**
+ * @brief Apply @p tuning to the calling thread, logging what was applied.
+ *
+ * A real-time policy that is not permitted (no @c CAP_SYS_NICE or
+ * @c RLIMIT_RTPRIO) falls back to @ref kFallbackNice; a step that fails
+ * logs a warning and leaves the rest in place. Threads started afterwards
+ * come up at normal priority (@c SCHED_RESET_ON_FORK); those of ours that
+ * start from a tuned thread call @ref resetThreadTuning for the CPU pin.
+ *
+ * Memory is locked as mapped now, not @c MCL_FUTURE: file transfers map
+ * whole files, which must not be pinned or fail against @c RLIMIT_MEMLOCK.
+ *
+ * Linux only; elsewhere an enabled @p tuning logs a warning.
+ */
+auto applyThreadTuning(const ThreadTuning &tuning) -> AppliedTuning;
+
+/** @brief On a helper thread: drop the CPU pin it inherited from a tuned thread. */
+auto resetThreadTuning() noexcept -> void;
+
+/**
+ * @brief Measure how late the calling thread gets to run; never returns.
+ *
+ * Sleeps @p period at a time and records into:
+ * - @c sched.wakeup_late_ns: wake-up time past the deadline;
+ * - @c sched.run_delay_ns: time runnable but waiting for a CPU (Linux);
+ * - @c sched.involuntary_switches: preemptions of this thread (Linux).
+ */
+auto watchSchedulingDelay(std::chrono::milliseconds period = kSchedulingProbePeriod) -> Task<void>;
+
+MKS_END
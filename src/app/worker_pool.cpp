@@ -0,0 +1,158 @@
+#include "worker_pool.hpp"
+#include "diag/metrics.hpp"
+#include "thread_tuning.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+MKS_BEGIN
+
+namespace {
+
+struct WorkerMetrics {
+    Counter &jobs;
+    Counter &steals;
+    Counter &failures;
+    Gauge &pending;
+    Histogram &queuedNs;
+};
+
+auto workerMetrics() -> WorkerMetrics & {
+    static auto result = WorkerMetrics {
+        .jobs = metrics().counter("workers.jobs"),
+        .steals = metrics().counter("workers.steals"),
+        .failures = metrics().counter("workers.failures"),
+        .pending = metrics().gauge("workers.pending"),
+        // post() until a worker starts the job.
+        .queuedNs = metrics().histogram("workers.queued_ns"),
+    };
+    return result;
+}
+
+// Set on worker threads, so a job that posts more work keeps it local.
+thread_local constinit const WorkerPool *gCurrentPool = nullptr;
+thread_local constinit size_t gCurrentQueue = 0;
+
+} // namespace
+
+WorkerPool::WorkerPool(size_t threads) {
+    // Registered before any worker runs, so the metrics outlive a pool that
+    // is itself a static and drains its queue at exit.
+    (void) workerMetrics();
+    const auto count = threads == 0 ? defaultThreads() : threads;
+    mQueues.reserve(count);
+    for (auto index = size_t {0}; index < count; ++index) {
+        mQueues.push_back(std::make_unique<Queue>());
+    }
+    mThreads.reserve(count);
+    for (auto index = size_t {0}; index < count; ++index) {
+        mThreads.emplace_back([this, index] { loop(index); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        auto lock = std::scoped_lock {mSleepMutex};
+        mStopping = true;
+    }
+    mWake.notify_all();
+    mThreads.clear();
+}
+
+auto WorkerPool::defaultThreads() noexcept -> size_t {
+    return std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 4);
+}
+
+auto WorkerPool::post(Job job) -> void {
+    const auto index = gCurrentPool == this
+        ? gCurrentQueue
+        : mNextQueue.fetch_add(1, std::memory_order_relaxed) % mQueues.size();
+    {
+        auto &queue = *mQueues[index];
+        auto lock = std::scoped_lock {queue.mutex};
+        queue.jobs.push_back(Queued {
+            .job = std::move(job),
+            .postedAt = std::chrono::steady_clock::now(),
+        });
+    }
+    {
+        auto lock = std::scoped_lock {mSleepMutex};
+        ++mPending;
+    }
+    workerMetrics().pending.add(1);
+    mWake.notify_one();
+}
+
+auto WorkerPool::take(size_t index) -> std::optional<Queued> {
+    // Own queue from the front, in posting order...
+    {
+        auto &queue = *mQueues[index];
+        auto lock = std::scoped_lock {queue.mutex};
+        if (!queue.jobs.empty()) {
+            auto queued = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            return queued;
+        }
+    }
+    // ...then the newest job of the next busy worker.
+    for (auto offset = size_t {1}; offset < mQueues.size(); ++offset) {
+        auto &queue = *mQueues[(index + offset) % mQueues.size()];
+        auto lock = std::scoped_lock {queue.mutex};
+        if (!queue.jobs.empty()) {
+            auto queued = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            workerMetrics().steals.add();
+            return queued;
+        }
+    }
+    return std::nullopt;
+}
+
+auto WorkerPool::loop(size_t index) -> void {
+    resetThreadTuning();
+    gCurrentPool = this;
+    gCurrentQueue = index;
+    while (true) {
+        {
+            auto lock = std::unique_lock {mSleepMutex};
+            mWake.wait(lock, [this] { return mPending > 0 || mStopping; });
+            if (mPending == 0) {
+                // Stopping with nothing left: queued jobs always run first.
+                return;
+            }
+            // Claim one job. Jobs are queued before they are counted, so some
+            // queue holds one for every claim; a scan racing another thief
+            // can still miss it and simply scans again.
+            --mPending;
+        }
+        auto queued = take(index);
+        while (!queued) {
+            std::this_thread::yield();
+            queued = take(index);
+        }
+        workerMetrics().pending.add(-1);
+        workerMetrics().queuedNs.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - queued->postedAt
+            ).count()
+        ));
+        try {
+            queued->job();
+            workerMetrics().jobs.add();
+        }
+        catch (const std::exception &error) {
+            // Dropping the job drops its result sender; submit() then reports
+            // operation_canceled instead of the process terminating.
+            workerMetrics().failures.add();
+            SPDLOG_ERROR("Worker job failed: {}", error.what());
+        }
+    }
+}
+
+auto workerPool() -> WorkerPool & {
+    static auto pool = WorkerPool {};
+    return pool;
+}
+
+MKS_END
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include <ilias/sync/oneshot.hpp>
+#include <ilias/task.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+MKS_BEGIN
+
+namespace detail {
+
+// What submit() hands back: a job returning IoResult<T> yields T (its error
+// passes through), any other job yields its own return value.
+template <typename T>
+struct SubmitValue {
+    using Type = T;
+};
+
+template <typename T>
+struct SubmitValue<IoResult<T>> {
+    using Type = T;
+};
+
+} // namespace detail
+
+/**
+ * @brief Work-stealing threads for CPU work that must not run on the event loop.
+ *
+ * The loop thread captures and routes input; anything that can take longer
+ * than an event (serializing and writing the config, formatting topology
+ * dumps, encoding clipboard chunks) is submitted here instead. Each worker
+ * drains its own queue and steals from the others when it runs dry, so one
+ * long job does not hold up the rest.
+ *
+ * @c submit() is awaited from a coroutine: the job runs on a worker and the
+ * coroutine resumes on its own executor with the result. A job must own what
+ * it touches (values, shared_ptr), since the awaiting coroutine may be
+ * cancelled while the job is still running.
+ */
+class WorkerPool {
+public:
+    using Job = std::move_only_function<void()>;
+
+    /** @param threads Worker count; 0 picks @ref defaultThreads. */
+    explicit WorkerPool(size_t threads = 0);
+    WorkerPool(const WorkerPool &) = delete;
+    /** @brief Runs every queued job, then joins the workers. */
+    ~WorkerPool();
+
+    /** @brief Half the cores, at least one and at most four; the loop thread keeps a core. */
+    static auto defaultThreads() noexcept -> size_t;
+
+    auto size() const noexcept -> size_t { return mQueues.size(); }
+
+    /** @brief Queue @p job without waiting for it (fire and forget). */
+    auto post(Job job) -> void;
+
+    /**
+     * @brief Run @p fn on a worker and resume with its result.
+     *
+     * @return The value @p fn returned, or its error when it returns an
+     *         IoResult; operation_canceled if the job was dropped (it threw,
+     *         or the pool shut down first).
+     */
+    template <typename Fn>
+    auto submit(Fn fn) -> IoTask<typename detail::SubmitValue<std::invoke_result_t<Fn &>>::Type> {
+        using Returned = std::invoke_result_t<Fn &>;
+        using Result = IoResult<typename detail::SubmitValue<Returned>::Type>;
+        auto [sender, receiver] = ilias::oneshot::channel<Result>();
+        post([fn = std::move(fn), sender = std::move(sender)]() mutable {
+            if constexpr (std::is_void_v<Returned>) {
+                fn();
+                (void) sender.send(Result {});
+            }
+            else {
+                (void) sender.send(Result {fn()});
+            }
+        });
+        auto result = co_await std::move(receiver);
+        if (!result) {
+            co_return Err(std::make_error_code(std::errc::operation_canceled));
+        }
+        co_return std::move(*result);
+    }
+
+private:
+    struct Queued {
+        Job job;
+        std::chrono::steady_clock::time_point postedAt;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Queued> jobs;
+    };
+
+    auto loop(size_t index) -> void;
+    auto take(size_t index) -> std::optional<Queued>;
+
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    std::atomic<size_t> mNextQueue {0};
+    // Jobs queued anywhere; guarded by mSleepMutex for writes so a worker
+    // going to sleep cannot miss a post.
+    std::mutex mSleepMutex;
+    std::condition_variable mWake;
+    size_t mPending = 0;
+    bool mStopping = false;
+    std::vector<std::jthread> mThreads; // Last, so workers stop before the queues go away
+};
+
+/**
+ * @brief The process-wide pool, created on first use.
+ *
+ * Server and Client share it; it is small on purpose, housekeeping never
+ * needs more than a few threads.
+ */
+auto workerPool() -> WorkerPool &;
+
+MKS_END
@@ -16,10 +16,28 @@ struct CommonConfig {
     std::string configPath = "mksync.json";
     std::string logLevel   = "info";
     std::string backend;
+    // Loopback diagnostics socket; empty picks the role default, "off" disables it.
+    std::string control;
+    // Chrome Trace Event JSON written on exit; empty disables tracing.
+    std::string traceFile;
+    // Scheduling of the event loop thread (server capture/routing, client injection).
+    std::string realtime = "off";
+    uint32_t    realtimePriority = 10;
+    // CPUs that thread may run on, like "2" or "2-3"; empty leaves it alone.
+    std::string cpuAffinity;
+    bool        lockMemory = false;
 };
 
 struct ServerCommand {
     std::string  endpoint;
+    // Plugin libraries, separated like PATH entries (':' or ';' on Windows).
+    std::string  plugins;
+    // Unix socket for event subscriber processes; empty serves none.
+    std::string  eventSocket;
+    // Threads writing to clients; 0 writes from the routing thread.
+    uint32_t     ioThreads = 0;
+    // Read and translate local input on a thread of its own.
+    bool         captureThread = false;
     CommonConfig common;
 };
 
@@ -37,14 +55,54 @@ struct BackendCommand {
     bool checked = false;
 };
 
+struct StatsCommand {
+    std::string control;
+};
+
+struct FlightCommand {
+    std::string control;
+    std::string decode;
+};
+
+struct RecordCommand {
+    std::string  output;
+    // Also serve clients from the recorded capture; empty only records.
+    std::string  listen;
+    CommonConfig common;
+};
+
+struct ReplayCommand {
+    std::string  input;
+    std::string  endpoint;
+    std::string  speed = "1";
+    bool         loop  = false;
+    uint32_t     waitClients = 0;
+    CommonConfig common;
+};
+
+struct SendCommand {
+    std::string  path;
+    std::string  endpoint;
+    // Store next to the server's copy instead of replacing it (no delta).
+    bool         keepBoth = false;
+    CommonConfig common;
+};
+
 struct CliCommands {
     ServerCommand        server;
     ClientCommand        client;
     CheckPlatformCommand checkPlatform;
     BackendCommand       backend;
+    StatsCommand         stats;
+    FlightCommand        flight;
+    RecordCommand        record;
+    ReplayCommand        replay;
+    SendCommand          send;
 };
 
-using CliCommand = std::variant<ServerCommand, ClientCommand, CheckPlatformCommand, BackendCommand>;
+using CliCommand = std::variant<ServerCommand, ClientCommand, CheckPlatformCommand, BackendCommand,
+                                StatsCommand, FlightCommand, RecordCommand, ReplayCommand,
+                                SendCommand>;
 
 auto makeCliParserConfig() -> NekoProto::argparser::ArgParserConfig;
 auto parseCliArguments(int argc, const char *const *argv) -> ilias::IoResult<CliCommand>;
@@ -67,6 +125,29 @@ namespace NekoProto
                              mksArgparser::arg_help<"listen endpoint">,
                              mksArgparser::ArgTags{.required = true, .positional = true}>(
                        &::mks::ServerCommand::endpoint),
+                   "plugins",
+                   make_tags<mksArgparser::arg_long_name<"plugins">,
+                             mksArgparser::arg_value_name<"PATHS">,
+                             mksArgparser::arg_env<"MKSYNC_PLUGINS">,
+                             mksArgparser::arg_help<"plugin libraries to load, separated like PATH">>(
+                       &::mks::ServerCommand::plugins),
+                   "eventSocket",
+                   make_tags<mksArgparser::arg_long_name<"event-socket">,
+                             mksArgparser::arg_value_name<"PATH">,
+                             mksArgparser::arg_env<"MKSYNC_EVENT_SOCKET">,
+                             mksArgparser::arg_help<"Unix socket serving event rings to subscriber processes">>(
+                       &::mks::ServerCommand::eventSocket),
+                   "ioThreads",
+                   make_tags<mksArgparser::arg_long_name<"io-threads">,
+                             mksArgparser::arg_value_name<"N">,
+                             mksArgparser::arg_env<"MKSYNC_IO_THREADS">,
+                             mksArgparser::arg_help<"threads writing to clients, off the routing thread (Linux)">>(
+                       &::mks::ServerCommand::ioThreads),
+                   "captureThread",
+                   make_tags<mksArgparser::arg_long_name<"capture-thread">,
+                             mksArgparser::arg_help<"read local input on a thread of its own (Linux X11)">,
+                             mksArgparser::ArgTags{.flag = true}>(
+                       &::mks::ServerCommand::captureThread),
                    "common", &::mks::ServerCommand::common);
     };
 
@@ -100,7 +181,40 @@ namespace NekoProto
             make_tags<mksArgparser::arg_long_name<"backend">, mksArgparser::arg_aliases<"backend">,
                       mksArgparser::arg_value_name<"NAME">, mksArgparser::arg_env<"MKSYNC_BACKEND">,
                       mksArgparser::arg_help<"platform backend (default: auto)">>(
-                &::mks::CommonConfig::backend));
+                &::mks::CommonConfig::backend),
+            "control",
+            make_tags<mksArgparser::arg_long_name<"control">, mksArgparser::arg_aliases<"control">,
+                      mksArgparser::arg_value_name<"HOST:PORT|off">,
+                      mksArgparser::arg_env<"MKSYNC_CONTROL">,
+                      mksArgparser::arg_help<"diagnostics socket (default: role loopback port)">>(
+                &::mks::CommonConfig::control),
+            "traceFile",
+            make_tags<mksArgparser::arg_long_name<"trace-file">, mksArgparser::arg_aliases<"trace-file">,
+                      mksArgparser::arg_value_name<"PATH">,
+                      mksArgparser::arg_env<"MKSYNC_TRACE_FILE">,
+                      mksArgparser::arg_help<"write a Chrome trace of the input pipeline on exit">>(
+                &::mks::CommonConfig::traceFile),
+            "realtime",
+            make_tags<mksArgparser::arg_long_name<"realtime">, mksArgparser::arg_aliases<"realtime">,
+                      mksArgparser::arg_value_name<"POLICY">,
+                      mksArgparser::arg_choices<"off", "fifo", "rr">,
+                      mksArgparser::arg_default<"off"_cs>, mksArgparser::arg_env<"MKSYNC_REALTIME">,
+                      mksArgparser::arg_help<"real-time scheduling of the input thread, else a raised nice value (Linux)">>(
+                &::mks::CommonConfig::realtime),
+            "realtimePriority",
+            make_tags<mksArgparser::arg_long_name<"realtime-priority">,
+                      mksArgparser::arg_aliases<"realtime-priority">, mksArgparser::arg_value_name<"N">,
+                      mksArgparser::arg_help<"SCHED_FIFO / SCHED_RR priority, 1-99 (default: 10)">>(
+                &::mks::CommonConfig::realtimePriority),
+            "cpuAffinity",
+            make_tags<mksArgparser::arg_long_name<"cpu-affinity">, mksArgparser::arg_aliases<"cpu-affinity">,
+                      mksArgparser::arg_value_name<"CPUS">, mksArgparser::arg_env<"MKSYNC_CPU_AFFINITY">,
+                      mksArgparser::arg_help<"pin the input thread to these CPUs, like 2 or 2-3 (Linux)">>(
+                &::mks::CommonConfig::cpuAffinity),
+            "lockMemory",
+            make_tags<mksArgparser::arg_long_name<"lock-memory">, mksArgparser::arg_aliases<"lock-memory">,
+                      mksArgparser::arg_help<"lock mapped memory so input never waits on a page fault (Linux)">,
+                      mksArgparser::ArgTags{.flag = true}>(&::mks::CommonConfig::lockMemory));
     };
 
     template <>
@@ -126,6 +240,96 @@ namespace NekoProto
                              mksArgparser::ArgTags{.flag = true}>(&::mks::BackendCommand::checked));
     };
 
+    template <>
+    struct Meta<::mks::StatsCommand, void> {
+        constexpr static auto value = Object(
+            "control",
+            make_tags<mksArgparser::arg_long_name<"control">,
+                      mksArgparser::arg_value_name<"HOST:PORT">,
+                      mksArgparser::arg_env<"MKSYNC_CONTROL">,
+                      mksArgparser::arg_help<"control socket to query (default: 127.0.0.1:24860)">>(
+                &::mks::StatsCommand::control));
+    };
+
+    template <>
+    struct Meta<::mks::FlightCommand, void> {
+        constexpr static auto value = Object(
+            "control",
+            make_tags<mksArgparser::arg_long_name<"control">,
+                      mksArgparser::arg_value_name<"HOST:PORT">,
+                      mksArgparser::arg_env<"MKSYNC_CONTROL">,
+                      mksArgparser::arg_help<"control socket to ask for a dump">>(
+                &::mks::FlightCommand::control),
+            "decode",
+            make_tags<mksArgparser::arg_long_name<"decode">, mksArgparser::arg_value_name<"PATH">,
+                      mksArgparser::arg_help<"print an existing dump instead of requesting one">>(
+                &::mks::FlightCommand::decode));
+    };
+
+    template <>
+    struct Meta<::mks::RecordCommand, void> {
+        constexpr static auto value = Object(
+            "output",
+            make_tags<mksArgparser::arg_value_name<"PATH">,
+                      mksArgparser::arg_help<"recording file to write">,
+                      mksArgparser::ArgTags{.required = true, .positional = true}>(
+                &::mks::RecordCommand::output),
+            "listen",
+            make_tags<mksArgparser::arg_long_name<"listen">, mksArgparser::arg_value_name<"HOST:PORT">,
+                      mksArgparser::arg_help<"also run a server on this endpoint while recording">>(
+                &::mks::RecordCommand::listen),
+            "common", &::mks::RecordCommand::common);
+    };
+
+    template <>
+    struct Meta<::mks::ReplayCommand, void> {
+        constexpr static auto value = Object(
+            "input",
+            make_tags<mksArgparser::arg_value_name<"PATH">,
+                      mksArgparser::arg_help<"recording file to play back">,
+                      mksArgparser::ArgTags{.required = true, .positional = true}>(
+                &::mks::ReplayCommand::input),
+            "endpoint",
+            make_tags<mksArgparser::arg_value_name<"HOST:PORT">,
+                      mksArgparser::arg_help<"listen endpoint">,
+                      mksArgparser::ArgTags{.required = true, .positional = true}>(
+                &::mks::ReplayCommand::endpoint),
+            "speed",
+            make_tags<mksArgparser::arg_long_name<"speed">, mksArgparser::arg_value_name<"N|max">,
+                      mksArgparser::arg_default<"1"_cs>,
+                      mksArgparser::arg_help<"playback rate (1 = original timing, max = no delays)">>(
+                &::mks::ReplayCommand::speed),
+            "loop",
+            make_tags<mksArgparser::arg_long_name<"loop">,
+                      mksArgparser::arg_help<"start over at the end of the recording">,
+                      mksArgparser::ArgTags{.flag = true}>(&::mks::ReplayCommand::loop),
+            "waitClients",
+            make_tags<mksArgparser::arg_long_name<"wait-clients">, mksArgparser::arg_value_name<"N">,
+                      mksArgparser::arg_help<"hold playback until N client screens are connected">>(
+                &::mks::ReplayCommand::waitClients),
+            "common", &::mks::ReplayCommand::common);
+    };
+
+    template <>
+    struct Meta<::mks::SendCommand, void> {
+        constexpr static auto value = Object(
+            "path",
+            make_tags<mksArgparser::arg_value_name<"PATH">,
+                      mksArgparser::arg_help<"file to send">,
+                      mksArgparser::ArgTags{.required = true, .positional = true}>(
+                &::mks::SendCommand::path),
+            "endpoint",
+            make_tags<mksArgparser::arg_value_name<"HOST:PORT">,
+                      mksArgparser::arg_help<"server endpoint">,
+                      mksArgparser::ArgTags{.required = true, .positional = true}>(
+                &::mks::SendCommand::endpoint),
+            "keepBoth",
+            make_tags<mksArgparser::arg_long_name<"keep-both">,
+                      mksArgparser::arg_help<"store a new copy instead of updating the server's">,
+                      mksArgparser::ArgTags{.flag = true}>(&::mks::SendCommand::keepBoth),
+            "common", &::mks::SendCommand::common);
+    };
+
     template <>
     struct Meta<::mks::CliCommands, void> {
         constexpr static auto value = Object(
@@ -141,7 +345,22 @@ namespace NekoProto
                       mksArgparser::ArgTags{.command = true}>(&::mks::CliCommands::checkPlatform),
             "backend",
             make_tags<mksArgparser::arg_help<"list and check platform backends">,
-                      mksArgparser::ArgTags{.command = true}>(&::mks::CliCommands::backend));
+                      mksArgparser::ArgTags{.command = true}>(&::mks::CliCommands::backend),
+            "stats",
+            make_tags<mksArgparser::arg_help<"print runtime counters of a running server or client">,
+                      mksArgparser::ArgTags{.command = true}>(&::mks::CliCommands::stats),
+            "flight",
+            make_tags<mksArgparser::arg_help<"dump and print the recent input event recorder">,
+                      mksArgparser::ArgTags{.command = true}>(&::mks::CliCommands::flight),
+            "record",
+            make_tags<mksArgparser::arg_help<"record captured input to a file">,
+                      mksArgparser::ArgTags{.command = true}>(&::mks::CliCommands::record),
+            "replay",
+            make_tags<mksArgparser::arg_help<"serve a recorded input file to clients">,
+                      mksArgparser::ArgTags{.command = true}>(&::mks::CliCommands::replay),
+            "send",
+            make_tags<mksArgparser::arg_help<"send a file to a server, as a delta when it has an older copy">,
+                      mksArgparser::ArgTags{.command = true}>(&::mks::CliCommands::send));
     };
 
 } // namespace NekoProto
@@ -0,0 +1,164 @@
+#include "backend_cache.hpp"
+#include "app_config.hpp"
+
+#include "refl/serde.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+
+MKS_BEGIN
+
+namespace {
+
+auto streamError() -> std::error_code {
+    if (errno != 0) {
+        return {errno, std::generic_category()};
+    }
+    return ConfigError::IoError;
+}
+
+auto environmentValue(const char *name) -> std::string {
+    const auto *value = std::getenv(name);
+    return value ? std::string {value} : std::string {};
+}
+
+auto cacheFeature(const BackendFeatureCheck &feature) -> BackendCacheFeature {
+    return BackendCacheFeature {.supported = feature.supported, .detail = feature.detail};
+}
+
+} // namespace
+
+auto currentBackendEnvironment() -> BackendEnvironment {
+    return BackendEnvironment {
+        .sessionType = environmentValue("XDG_SESSION_TYPE"),
+        .waylandDisplay = environmentValue("WAYLAND_DISPLAY"),
+        .display = environmentValue("DISPLAY"),
+        .desktop = environmentValue("XDG_CURRENT_DESKTOP"),
+    };
+}
+
+auto backendCachePath(const std::filesystem::path &configPath) -> std::filesystem::path {
+    auto path = configPath;
+    path.replace_filename(configPath.stem().string() + ".backend.json");
+    return path;
+}
+
+auto makeBackendCacheEntry(
+    BackendEnvironment environment,
+    BackendRequirement requirements,
+    std::string_view backend,
+    const BackendCheck &check
+) -> BackendCacheEntry {
+    return BackendCacheEntry {
+        .environment = std::move(environment),
+        .backend = std::string {backend},
+        .requirements = static_cast<uint8_t>(requirements),
+        .detail = check.detail,
+        .screens = cacheFeature(check.screens),
+        .capture = cacheFeature(check.capture),
+        .injection = cacheFeature(check.injection),
+    };
+}
+
+auto cachedBackendFor(
+    const BackendCacheEntry &entry,
+    const BackendEnvironment &environment,
+    BackendRequirement requirements
+) -> std::optional<std::string> {
+    // A server-side entry (Capture) says nothing about Injection, so the
+    // cached requirements must cover the requested ones.
+    const auto required = static_cast<uint8_t>(requirements);
+    if (entry.version != BackendCacheEntry {}.version || entry.backend.empty() ||
+        entry.environment != environment || (entry.requirements & required) != required) {
+        return std::nullopt;
+    }
+    return entry.backend;
+}
+
+auto loadBackendCache(const std::filesystem::path &path) -> IoResult<BackendCacheEntry> {
+    errno = 0;
+    auto input = std::ifstream {path, std::ios::binary};
+    if (!input) {
+        return Err(streamError());
+    }
+
+    auto text = std::string {
+        std::istreambuf_iterator<char> {input},
+        std::istreambuf_iterator<char> {}
+    };
+    if (input.bad()) {
+        return Err(streamError());
+    }
+
+    auto entry = BackendCacheEntry {};
+    auto deserializer = Deserializer {text.data(), text.size()};
+    if (!deserializer(entry)) {
+        return Err(ConfigError::DeserializeFailed);
+    }
+    return entry;
+}
+
+auto saveBackendCache(const std::filesystem::path &path, const BackendCacheEntry &entry) -> IoResult<void> {
+    if (path.has_parent_path()) {
+        auto error = std::error_code {};
+        std::filesystem::create_directories(path.parent_path(), error);
+        if (error) {
+            return Err(error);
+        }
+    }
+
+    auto buffer = std::vector<char> {};
+    {
+        auto serializer = Serializer {buffer, JsonOutputFormatOptions::Default()};
+        if (!serializer(entry)) {
+            return Err(ConfigError::SerializeFailed);
+        }
+    }
+
+    errno = 0;
+    auto output = std::ofstream {path, std::ios::binary | std::ios::trunc};
+    if (!output) {
+        return Err(streamError());
+    }
+    output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    if (!output) {
+        return Err(streamError());
+    }
+    return {};
+}
+
+auto selectCachedBackend(
+    std::string_view name,
+    BackendRequirement requirements,
+    const std::filesystem::path &cachePath
+) -> IoTask<PlatformSelection> {
+    if (!name.empty() && name != "auto") {
+        co_return co_await selectBackend(name, requirements);
+    }
+
+    const auto environment = currentBackendEnvironment();
+    auto cached = std::optional<std::string> {};
+    if (auto entry = loadBackendCache(cachePath)) {
+        cached = cachedBackendFor(*entry, environment, requirements);
+    }
+    if (cached) {
+        SPDLOG_INFO("Trying cached platform backend '{}'", *cached);
+    }
+
+    auto selected = co_await selectBackend({}, requirements, cached.value_or(""));
+    if (!selected) {
+        auto error = std::error_code {};
+        std::filesystem::remove(cachePath, error);
+        co_return selected;
+    }
+    if (cached != selected->descriptor.name) {
+        auto entry = makeBackendCacheEntry(environment, requirements, selected->descriptor.name, selected->check);
+        if (auto saved = saveBackendCache(cachePath, entry); !saved) {
+            SPDLOG_WARN("Failed to save backend cache {}: {}", cachePath.string(), saved.error().message());
+        }
+    }
+    co_return selected;
+}
+
+MKS_END
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "platform/backend.hpp"
+#include "refl/formatter.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+MKS_BEGIN
+
+/**
+ * @brief Session variables that decide which platform backend can work.
+ *
+ * A cached selection is only trusted while all of these are unchanged; logging
+ * into another session type or desktop invalidates it.
+ */
+struct BackendEnvironment {
+    std::string sessionType;    // XDG_SESSION_TYPE
+    std::string waylandDisplay; // WAYLAND_DISPLAY
+    std::string display;        // DISPLAY
+    std::string desktop;        // XDG_CURRENT_DESKTOP
+
+    auto operator==(const BackendEnvironment &) const -> bool = default;
+};
+FORMATTER(BackendEnvironment);
+
+struct BackendCacheFeature {
+    bool supported = false;
+    std::string detail;
+};
+FORMATTER(BackendCacheFeature);
+
+/**
+ * @brief Last automatic backend selection and the check that chose it.
+ */
+struct BackendCacheEntry {
+    uint32_t version = 1;
+    BackendEnvironment environment;
+    std::string backend;
+    // BackendRequirement bits the backend was selected for.
+    uint8_t requirements = 0;
+    std::string detail;
+    BackendCacheFeature screens;
+    BackendCacheFeature capture;
+    BackendCacheFeature injection;
+};
+FORMATTER(BackendCacheEntry);
+
+auto currentBackendEnvironment() -> BackendEnvironment;
+
+/** @brief Cache file kept next to the config, e.g. mksync.json -> mksync.backend.json. */
+auto backendCachePath(const std::filesystem::path &configPath) -> std::filesystem::path;
+
+auto makeBackendCacheEntry(
+    BackendEnvironment environment,
+    BackendRequirement requirements,
+    std::string_view backend,
+    const BackendCheck &check
+) -> BackendCacheEntry;
+
+/**
+ * @brief Backend name to try first, if the entry was made for @p environment
+ * and covers @p requirements.
+ */
+auto cachedBackendFor(
+    const BackendCacheEntry &entry,
+    const BackendEnvironment &environment,
+    BackendRequirement requirements
+) -> std::optional<std::string>;
+
+auto loadBackendCache(const std::filesystem::path &path) -> IoResult<BackendCacheEntry>;
+auto saveBackendCache(const std::filesystem::path &path, const BackendCacheEntry &entry) -> IoResult<void>;
+
+/**
+ * @brief selectBackend() that remembers automatic choices in @p cachePath.
+ *
+ * With @p name empty or "auto", the backend cached for the current session
+ * environment is fully probed first and the other backends only when it is
+ * unsuitable. The cache is rewritten when another backend wins and removed
+ * when none does. Explicit names bypass the cache.
+ */
+auto selectCachedBackend(
+    std::string_view name,
+    BackendRequirement requirements,
+    const std::filesystem::path &cachePath
+) -> IoTask<PlatformSelection>;
+
+MKS_END
+
+REFL_REGISTER_FMT_FORMATTER(mks::BackendEnvironment);
+REFL_REGISTER_FMT_FORMATTER(mks::BackendCacheFeature);
+REFL_REGISTER_FMT_FORMATTER(mks::BackendCacheEntry);
@@ -18,4 +18,11 @@ FORMATTER_IMPL(KeyEvent);
 FORMATTER_IMPL(ScreenInfo);
 FORMATTER_IMPL(ScreenChangeEvent);
 
+// Clipboard
+FORMATTER_IMPL(ClipboardFormat);
+FORMATTER_IMPL(ClipboardOffer);
+
+// Files
+FORMATTER_IMPL(FileManifest);
+
 MKS_END
\ No newline at end of file
@@ -4,3 +4,5 @@
 #include "core/mouse.hpp"
 #include "core/key.hpp"
 #include "core/topology.hpp"
+#include "core/clipboard.hpp"
+#include "core/file_manifest.hpp"
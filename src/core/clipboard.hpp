@@ -0,0 +1,68 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "refl/formatter.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+MKS_BEGIN
+
+// Clipboard sharing only moves advertisements eagerly; bytes follow on paste.
+struct ClipboardFormat {
+    std::string mime;  // e.g. "text/plain;charset=utf-8", "image/png"
+    uint64_t size = 0; // Bytes in this format
+
+    auto operator==(const ClipboardFormat &) const -> bool = default;
+};
+FORMATTER(ClipboardFormat);
+
+struct ClipboardOffer {
+    uint32_t serial = 0; // Assigned by the machine advertising it; names the offer in requests
+    std::string hash;    // Content hash over every format, used to drop echoes of our own copy
+    std::vector<ClipboardFormat> formats;
+};
+FORMATTER(ClipboardOffer);
+
+/**
+ * @brief Bytes of one format held by the local clipboard.
+ */
+struct ClipboardContent {
+    std::string mime;
+    std::vector<std::byte> bytes;
+};
+
+/**
+ * @brief Build the advertisement for @p contents (serial left at 0).
+ *
+ * The hash is FNV-1a over each mime and its bytes, so the same copy seen by
+ * two machines hashes the same.
+ */
+inline auto makeClipboardOffer(std::span<const ClipboardContent> contents) -> ClipboardOffer {
+    auto hash = uint64_t {0xcbf29ce484222325ULL};
+    auto mix = [&hash](std::span<const std::byte> bytes) {
+        for (auto byte : bytes) {
+            hash ^= static_cast<uint8_t>(byte);
+            hash *= 0x100000001b3ULL;
+        }
+    };
+
+    auto offer = ClipboardOffer {};
+    for (const auto &content : contents) {
+        mix(std::as_bytes(std::span {content.mime}));
+        mix(content.bytes);
+        offer.formats.push_back(ClipboardFormat {
+            .mime = content.mime,
+            .size = content.bytes.size(),
+        });
+    }
+    offer.hash = fmtlib::format("{:016x}", hash);
+    return offer;
+}
+
+MKS_END
+
+REFL_REGISTER_FMT_FORMATTER(mks::ClipboardFormat);
+REFL_REGISTER_FMT_FORMATTER(mks::ClipboardOffer);
@@ -54,6 +54,8 @@ struct ScreenInfo {
     int32_t dpi = 72;
     std::string name;
     bool primary = false;
+
+    auto operator==(const ScreenInfo &) const -> bool = default;
 };
 FORMATTER(ScreenInfo);
 
@@ -0,0 +1,115 @@
+#include "file_delta.hpp"
+
+MKS_BEGIN
+
+namespace {
+
+// Appends @p op, merging it into the last one when they continue each other.
+auto appendOp(std::vector<FileDeltaOp> &ops, FileDeltaOp op, uint32_t blockSize) -> void {
+    if (!ops.empty()) {
+        auto &last = ops.back();
+        if (op.block == kDeltaLiteral && last.block == kDeltaLiteral && last.source + last.length == op.source) {
+            last.length += op.length;
+            return;
+        }
+        // Whole blocks only, so the merged copy still starts on a block boundary.
+        if (op.block != kDeltaLiteral && last.block != kDeltaLiteral && last.length % blockSize == 0 &&
+            uint64_t {last.block} + last.length / blockSize == op.block) {
+            last.length += op.length;
+            return;
+        }
+    }
+    ops.push_back(op);
+}
+
+} // namespace
+
+auto signBlocks(std::span<const std::byte> basis, uint32_t blockSize, uint64_t first, uint64_t count)
+    -> FileSignature {
+    auto result = FileSignature {
+        .blockSize = blockSize,
+        .basisSize = basis.size(),
+    };
+    result.weak.reserve(count);
+    result.strong.reserve(count);
+    for (auto block = first; block < first + count; ++block) {
+        const auto begin = block * blockSize;
+        if (begin >= basis.size()) {
+            break;
+        }
+        const auto bytes = basis.subspan(begin, std::min<uint64_t>(blockSize, basis.size() - begin));
+        result.weak.push_back(rollingChecksum(bytes));
+        result.strong.push_back(xxhash64(bytes));
+    }
+    return result;
+}
+
+FileSignatureIndex::FileSignatureIndex(FileSignature signature) : mSignature(std::move(signature)) {
+    const auto fullBlocks = mSignature.blockSize == 0 ? 0 : mSignature.basisSize / mSignature.blockSize;
+    const auto count = std::min<uint64_t>(fullBlocks, mSignature.weak.size());
+    mBlocks.reserve(count);
+    // A short last block can only match at the very end of the new file;
+    // it is left to the literal bytes instead.
+    for (auto block = uint32_t {0}; block < count; ++block) {
+        mBlocks[mSignature.weak[block]].push_back(block);
+    }
+}
+
+auto FileSignatureIndex::find(uint32_t weak, std::span<const std::byte> window, std::optional<uint32_t> hint) const
+    -> std::optional<uint32_t> {
+    auto it = mBlocks.find(weak);
+    if (it == mBlocks.end()) {
+        return std::nullopt;
+    }
+    // The strong hash is only computed once the weak one matched.
+    const auto strong = xxhash64(window);
+    if (hint && std::ranges::find(it->second, *hint) != it->second.end() && mSignature.strong[*hint] == strong) {
+        return hint;
+    }
+    for (auto block : it->second) {
+        if (mSignature.strong[block] == strong) {
+            return block;
+        }
+    }
+    return std::nullopt;
+}
+
+auto diffRange(const FileSignatureIndex &index, std::span<const std::byte> target, uint64_t begin, uint64_t end)
+    -> std::vector<FileDeltaOp> {
+    const auto blockSize = uint64_t {index.blockSize()};
+    auto ops = std::vector<FileDeltaOp> {};
+    auto literalStart = begin;
+    auto position = begin;
+    auto checksum = RollingChecksum {};
+    auto primed = false;
+    auto hint = std::optional<uint32_t> {};
+
+    while (position + blockSize <= end) {
+        const auto window = target.subspan(position, blockSize);
+        if (!primed) {
+            checksum.reset(window);
+            primed = true;
+        }
+        if (auto block = index.find(checksum.value(), window, hint)) {
+            if (position > literalStart) {
+                appendOp(ops, FileDeltaOp {.length = position - literalStart, .source = literalStart}, index.blockSize());
+            }
+            appendOp(ops, FileDeltaOp {.block = *block, .length = blockSize}, index.blockSize());
+            position += blockSize;
+            literalStart = position;
+            primed = false;
+            hint = *block + 1;
+            continue;
+        }
+        if (position + blockSize < end) {
+            checksum.roll(target[position], target[position + blockSize]);
+        }
+        ++position;
+    }
+    if (end > literalStart) {
+        appendOp(ops, FileDeltaOp {.length = end - literalStart, .source = literalStart}, index.blockSize());
+    }
+    return ops;
+}
+
+MKS_END
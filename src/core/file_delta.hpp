@@ -0,0 +1,109 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+MKS_BEGIN
+
+// A file that replaces an earlier version of itself is sent as a delta: the
+// receiver describes the old copy as block signatures, the sender finds
+// those blocks at any offset of the new file and sends only what lies
+// between them (the rsync algorithm).
+
+/** @brief Marks a delta op whose bytes come from the sender instead of a basis block. */
+inline constexpr uint32_t kDeltaLiteral = 0xFFFFFFFF;
+
+inline constexpr uint32_t kMinDeltaBlockSize = 2 * 1024;
+inline constexpr uint32_t kMaxDeltaBlockSize = 1024 * 1024;
+
+/**
+ * @brief Most blocks in one signature.
+ *
+ * About 16 bytes each on the wire; larger basis files get larger blocks.
+ */
+inline constexpr uint64_t kMaxDeltaBlocks = 64 * 1024;
+
+/**
+ * @brief Block size for a basis of @p basisSize bytes.
+ *
+ * About the square root of the size, as rsync picks it: small enough to
+ * find an edit's neighbours, large enough that the signature stays a small
+ * fraction of the file. A power of two within the limits above.
+ */
+inline auto deltaBlockSize(uint64_t basisSize) noexcept -> uint32_t {
+    auto wanted = uint64_t {1};
+    while (wanted * wanted < basisSize) {
+        wanted <<= 1;
+    }
+    wanted = std::max(wanted, (basisSize + kMaxDeltaBlocks - 1) / kMaxDeltaBlocks);
+    wanted = std::bit_ceil(std::max<uint64_t>(wanted, 1));
+    return static_cast<uint32_t>(std::clamp<uint64_t>(wanted, kMinDeltaBlockSize, kMaxDeltaBlockSize));
+}
+
+/** @brief Weak and strong checksum of each block of a basis file, in order. */
+struct FileSignature {
+    uint32_t blockSize = 0;
+    uint64_t basisSize = 0;
+    std::vector<uint32_t> weak;   // RollingChecksum of each block
+    std::vector<uint64_t> strong; // xxhash64 of each block
+};
+
+/** @brief Number of blocks a basis of @p basisSize splits into; the last may be short. */
+inline auto deltaBlockCount(uint64_t basisSize, uint32_t blockSize) noexcept -> uint64_t {
+    return blockSize == 0 ? 0 : (basisSize + blockSize - 1) / blockSize;
+}
+
+/**
+ * @brief Signatures of blocks [@p first, @p first + @p count) of @p basis.
+ *
+ * Independent per block range, so a large basis is signed on several
+ * threads and the pieces appended in order.
+ */
+auto signBlocks(std::span<const std::byte> basis, uint32_t blockSize, uint64_t first, uint64_t count)
+    -> FileSignature;
+
+/** @brief One step of rebuilding the new file, front to back. */
+struct FileDeltaOp {
+    // Basis block to copy from, or kDeltaLiteral.
+    uint32_t block = kDeltaLiteral;
+    // Bytes this op produces; a copy may run on through the following blocks.
+    uint64_t length = 0;
+    // Offset of a literal's bytes in the new file (sender side only).
+    uint64_t source = 0;
+};
+
+/** @brief Weak checksum → blocks, built once per signature and shared read-only. */
+class FileSignatureIndex {
+public:
+    explicit FileSignatureIndex(FileSignature signature);
+
+    auto blockSize() const noexcept -> uint32_t { return mSignature.blockSize; }
+
+    /** @brief A full-size block whose checksums match @p window, preferring @p hint. */
+    auto find(uint32_t weak, std::span<const std::byte> window, std::optional<uint32_t> hint) const
+        -> std::optional<uint32_t>;
+
+private:
+    FileSignature mSignature;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> mBlocks;
+};
+
+/**
+ * @brief Delta of @p target's bytes [@p begin, @p end) against the indexed basis.
+ *
+ * Matches never reach past @p end, so disjoint ranges are diffed in
+ * parallel and their ops concatenated; each boundary costs at most one
+ * block of literal bytes.
+ */
+auto diffRange(const FileSignatureIndex &index, std::span<const std::byte> target, uint64_t begin, uint64_t end)
+    -> std::vector<FileDeltaOp>;
+
+MKS_END
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include "refl/formatter.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+MKS_BEGIN
+
+// A file is offered as its size and per-chunk hashes; the receiver fetches
+// only the chunks it does not already hold, which is what makes resume work.
+struct FileManifest {
+    std::string name;        // File name only, never a path
+    uint64_t size = 0;
+    uint32_t chunkSize = 0;
+    std::vector<uint64_t> chunkHashes; // xxhash64 of each chunk, the last one may be short
+};
+FORMATTER(FileManifest);
+
+/** @brief Smallest chunk; large enough that per-chunk overhead vanishes at 10 GbE. */
+inline constexpr uint32_t kMinFileChunkSize = 4 * 1024 * 1024;
+
+/**
+ * @brief Most chunks in one manifest.
+ *
+ * Keeps the hash list of an offer (about 30 bytes per hash as JSON), and the
+ * chunk list of its reply, inside one RPC frame. Larger files get larger
+ * chunks instead.
+ */
+inline constexpr uint32_t kMaxFileChunks = 1024;
+
+/** @brief Chunk size for a file of @p size bytes: a power of two, at least kMinFileChunkSize. */
+inline auto fileChunkSize(uint64_t size) noexcept -> uint32_t {
+    const auto wanted = std::max<uint64_t>(kMinFileChunkSize, (size + kMaxFileChunks - 1) / kMaxFileChunks);
+    return static_cast<uint32_t>(std::min<uint64_t>(std::bit_ceil(wanted), uint64_t {1} << 31));
+}
+
+/** @brief Number of chunks @p manifest describes by its size. */
+inline auto fileChunkCount(const FileManifest &manifest) noexcept -> uint64_t {
+    if (manifest.chunkSize == 0) {
+        return 0;
+    }
+    return (manifest.size + manifest.chunkSize - 1) / manifest.chunkSize;
+}
+
+/** @brief Byte length of chunk @p index (the last one may be short). */
+inline auto fileChunkLength(const FileManifest &manifest, uint32_t index) noexcept -> uint64_t {
+    const auto begin = uint64_t {index} * manifest.chunkSize;
+    if (begin >= manifest.size) {
+        return 0;
+    }
+    return std::min<uint64_t>(manifest.chunkSize, manifest.size - begin);
+}
+
+/**
+ * @brief Stable id of @p manifest's content.
+ *
+ * Offering the same file again yields the same id, so an interrupted
+ * transfer picks up where it stopped; a changed file gets a new one.
+ */
+inline auto fileTransferId(const FileManifest &manifest) -> std::string {
+    auto hash = xxhash64(std::as_bytes(std::span {manifest.name}));
+    const uint64_t header[] = {manifest.size, manifest.chunkSize};
+    hash = xxhash64(std::as_bytes(std::span {header}), hash);
+    hash = xxhash64(std::as_bytes(std::span {manifest.chunkHashes}), hash);
+    return fmtlib::format("{:016x}", hash);
+}
+
+MKS_END
+
+REFL_REGISTER_FMT_FORMATTER(mks::FileManifest);
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+MKS_BEGIN
+
+/**
+ * @brief Streaming XXH64.
+ *
+ * Fast enough to hash file chunks at more than disk speed; not a
+ * cryptographic hash, it only detects corrupted or stale data. Feeding the
+ * same bytes in any split gives the same digest as @ref xxhash64.
+ */
+class XxHash64 {
+public:
+    explicit XxHash64(uint64_t seed = 0) noexcept
+        : mSeed(seed),
+          mLanes {seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1} {
+    }
+
+    auto update(std::span<const std::byte> bytes) noexcept -> void {
+        if (bytes.empty()) {
+            return;
+        }
+        const auto *data = bytes.data();
+        const auto *end = data + bytes.size();
+        mTotal += bytes.size();
+
+        if (mPending > 0) {
+            const auto take = std::min<size_t>(kStripe - mPending, bytes.size());
+            std::memcpy(mStripe + mPending, data, take);
+            mPending += take;
+            data += take;
+            if (mPending < kStripe) {
+                return;
+            }
+            consume(mStripe);
+            mPending = 0;
+        }
+        for (; end - data >= static_cast<std::ptrdiff_t>(kStripe); data += kStripe) {
+            consume(data);
+        }
+        mPending = static_cast<size_t>(end - data);
+        if (mPending > 0) {
+            std::memcpy(mStripe, data, mPending);
+        }
+    }
+
+    auto digest() const noexcept -> uint64_t {
+        auto hash = uint64_t {0};
+        if (mTotal >= kStripe) {
+            hash = std::rotl(mLanes[0], 1) + std::rotl(mLanes[1], 7) +
+                std::rotl(mLanes[2], 12) + std::rotl(mLanes[3], 18);
+            for (auto lane : mLanes) {
+                hash ^= round(0, lane);
+                hash = hash * kPrime1 + kPrime4;
+            }
+        }
+        else {
+            hash = mSeed + kPrime5;
+        }
+        hash += mTotal;
+
+        const auto *data = mStripe;
+        const auto *end = mStripe + mPending;
+        for (; data + 8 <= end; data += 8) {
+            hash ^= round(0, read64(data));
+            hash = std::rotl(hash, 27) * kPrime1 + kPrime4;
+        }
+        if (data + 4 <= end) {
+            hash ^= read32(data) * kPrime1;
+            hash = std::rotl(hash, 23) * kPrime2 + kPrime3;
+            data += 4;
+        }
+        for (; data < end; ++data) {
+            hash ^= std::to_integer<uint64_t>(*data) * kPrime5;
+            hash = std::rotl(hash, 11) * kPrime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= kPrime2;
+        hash ^= hash >> 29;
+        hash *= kPrime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+private:
+    static constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+    static constexpr size_t kStripe = 32;
+
+    // Little-endian reads, so every machine hashes a file the same way.
+    static auto read64(const std::byte *data) noexcept -> uint64_t {
+        auto value = uint64_t {0};
+        std::memcpy(&value, data, sizeof(value));
+        if constexpr (std::endian::native == std::endian::big) {
+            value = std::byteswap(value);
+        }
+        return value;
+    }
+
+    static auto read32(const std::byte *data) noexcept -> uint64_t {
+        auto value = uint32_t {0};
+        std::memcpy(&value, data, sizeof(value));
+        if constexpr (std::endian::native == std::endian::big) {
+            value = std::byteswap(value);
+        }
+        return value;
+    }
+
+    static auto round(uint64_t acc, uint64_t input) noexcept -> uint64_t {
+        acc += input * kPrime2;
+        acc = std::rotl(acc, 31);
+        return acc * kPrime1;
+    }
+
+    auto consume(const std::byte *stripe) noexcept -> void {
+        for (auto lane = 0; lane < 4; ++lane) {
+            mLanes[lane] = round(mLanes[lane], read64(stripe + lane * 8));
+        }
+    }
+
+    uint64_t mSeed;
+    uint64_t mLanes[4];
+    uint64_t mTotal = 0;
+    std::byte mStripe[kStripe] {};
+    size_t mPending = 0;
+};
+
+/** @brief XXH64 of @p bytes in one call. */
+inline auto xxhash64(std::span<const std::byte> bytes, uint64_t seed = 0) noexcept -> uint64_t {
+    auto hash = XxHash64 {seed};
+    hash.update(bytes);
+    return hash.digest();
+}
+
+/**
+ * @brief rsync's weak block checksum, slid one byte at a time.
+ *
+ * Two 16-bit sums: @c a of the bytes and @c b of the running @c a, both
+ * modulo 2^16. @ref reset sums a whole window in one pass the compiler
+ * vectorizes; @ref roll then moves it by one byte in O(1), which is what
+ * lets the sender look for the receiver's blocks at every offset.
+ */
+class RollingChecksum {
+public:
+    /** @brief Start over on @p window. */
+    auto reset(std::span<const std::byte> window) noexcept -> void {
+        // Summed in 32 bits and truncated at the end; mod 2^16 commutes with that.
+        auto a = uint32_t {0};
+        auto b = uint32_t {0};
+        const auto length = static_cast<uint32_t>(window.size());
+        for (auto index = uint32_t {0}; index < length; ++index) {
+            const auto value = std::to_integer<uint32_t>(window[index]);
+            a += value;
+            b += (length - index) * value;
+        }
+        mA = a & 0xFFFF;
+        mB = b & 0xFFFF;
+        mLength = length;
+    }
+
+    /** @brief Slide the window: @p out leaves at the front, @p in enters at the back. */
+    auto roll(std::byte out, std::byte in) noexcept -> void {
+        const auto leaving = std::to_integer<uint32_t>(out);
+        mA = (mA - leaving + std::to_integer<uint32_t>(in)) & 0xFFFF;
+        mB = (mB - mLength * leaving + mA) & 0xFFFF;
+    }
+
+    auto value() const noexcept -> uint32_t { return mA | (mB << 16); }
+
+private:
+    uint32_t mA = 0;
+    uint32_t mB = 0;
+    uint32_t mLength = 0;
+};
+
+/** @brief RollingChecksum of @p window in one call. */
+inline auto rollingChecksum(std::span<const std::byte> window) noexcept -> uint32_t {
+    auto checksum = RollingChecksum {};
+    checksum.reset(window);
+    return checksum.value();
+}
+
+MKS_END
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "preinclude.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+MKS_BEGIN
+
+/**
+ * @brief Bounded lock-free ring for exactly one producer and one consumer thread.
+ *
+ * Each side owns one cursor and publishes it with a release store; the other
+ * side reads it with an acquire load only when its cached copy says the ring
+ * is full (producer) or empty (consumer), so a steady stream costs no shared
+ * cache line traffic per element. A full ring refuses the push; what to do
+ * then (wait, drop) is the caller's policy.
+ *
+ * @c tryPush belongs to the producer; @c tryPop and @c empty to the consumer.
+ */
+template <typename T>
+class SpscRing {
+public:
+    /** @param capacity Slots, rounded up to a power of two (at least 2). */
+    explicit SpscRing(size_t capacity)
+        : mMask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+          mSlots(std::make_unique<std::optional<T>[]>(mMask + 1)) {
+    }
+
+    SpscRing(const SpscRing &) = delete;
+
+    auto capacity() const noexcept -> size_t { return mMask + 1; }
+
+    /**
+     * @brief Queue @p value; producer only.
+     *
+     * @return false when the ring is full, leaving @p value untouched.
+     */
+    auto tryPush(T &&value) -> bool {
+        const auto head = mHead.load(std::memory_order_relaxed);
+        if (head - mCachedTail > mMask) {
+            mCachedTail = mTail.load(std::memory_order_acquire);
+            if (head - mCachedTail > mMask) {
+                return false;
+            }
+        }
+        mSlots[head & mMask].emplace(std::move(value));
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** @brief Oldest value, if any; consumer only. */
+    auto tryPop() -> std::optional<T> {
+        const auto tail = mTail.load(std::memory_order_relaxed);
+        if (tail == mCachedHead) {
+            mCachedHead = mHead.load(std::memory_order_acquire);
+            if (tail == mCachedHead) {
+                return std::nullopt;
+            }
+        }
+        auto &slot = mSlots[tail & mMask];
+        auto value = std::move(*slot);
+        slot.reset();
+        mTail.store(tail + 1, std::memory_order_release);
+        return value;
+    }
+
+    /** @brief Whether tryPop() would return nothing right now; consumer only. */
+    auto empty() const noexcept -> bool {
+        return mTail.load(std::memory_order_relaxed) == mHead.load(std::memory_order_acquire);
+    }
+
+private:
+    const size_t mMask;
+    std::unique_ptr<std::optional<T>[]> mSlots;
+    // One cache line per side: its published cursor next to its copy of the
+    // other side's, which only it reads and writes.
+    alignas(64) std::atomic<size_t> mHead {0};
+    size_t mCachedTail = 0;
+    alignas(64) std::atomic<size_t> mTail {0};
+    size_t mCachedHead = 0;
+};
+
+MKS_END
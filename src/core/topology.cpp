@@ -69,6 +69,27 @@ auto ScreenTopology::addScreen(TopologyScreen screen) -> IoResult<void> {
     return {};
 }
 
+auto ScreenTopology::removeScreen(const ScreenKey &key) -> void {
+    auto it = mScreens.find(key);
+    if (it == mScreens.end()) {
+        return;
+    }
+    mCells.erase(it->second.cell);
+    mScreens.erase(it);
+}
+
+auto ScreenTopology::updateScreenInfo(const ScreenKey &key, ScreenInfo info) -> IoResult<void> {
+    if (!isValidRect(info)) {
+        return Err(TopologyError::InvalidScreenRect);
+    }
+    auto it = mScreens.find(key);
+    if (it == mScreens.end()) {
+        return Err(TopologyError::UnknownScreen);
+    }
+    it->second.info = std::move(info);
+    return {};
+}
+
 auto ScreenTopology::removeOwner(std::string_view ownerId) -> void {
     for (auto it = mScreens.begin(); it != mScreens.end();) {
         if (it->first.ownerId == ownerId) {
@@ -72,7 +72,10 @@ FORMATTER(ScreenPoint);
 class ScreenTopology {
 public:
     auto addScreen(TopologyScreen screen) -> IoResult<void>;
+    auto removeScreen(const ScreenKey &key) -> void;
     auto removeOwner(std::string_view ownerId) -> void;
+    // Replace the real rect/metadata of a screen in place; its cell is kept.
+    auto updateScreenInfo(const ScreenKey &key, ScreenInfo info) -> IoResult<void>;
 
     auto findScreen(const ScreenKey &key) const -> const TopologyScreen *;
     auto screens() const -> std::vector<TopologyScreen>;
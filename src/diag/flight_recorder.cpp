@@ -0,0 +1,371 @@
+#include "flight_recorder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <variant>
+
+#include <fcntl.h>
+#if defined(_WIN32)
+    #include <io.h>
+    #include <sys/stat.h>
+#else
+    #include <unistd.h>
+#endif
+
+MKS_BEGIN
+
+THIS_ERROR_IMPL(FlightDumpError);
+
+namespace {
+
+static_assert(std::has_single_bit(kFlightRecordsPerThread), "ring index masks need a power of two");
+
+constexpr size_t kMaxThreads = 64;
+constexpr uint32_t kDumpVersion = 1;
+constexpr char kDumpMagic[8] = {'M', 'K', 'S', 'F', 'L', 'T', '\0', '\0'};
+
+// File layout: DumpHeader, then per thread a ThreadHeader followed by
+// recordCount FlightRecords (oldest first). Host endianness; the dump is
+// meant to be decoded by the same build that wrote it.
+struct DumpHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t threadCount;
+    uint32_t reserved;
+    uint64_t dumpTimeNs;
+};
+
+struct ThreadHeader {
+    uint32_t index;
+    uint32_t recordCount;
+};
+
+// Single writer (the owning thread), any number of best-effort readers.
+struct FlightRing {
+    uint32_t index = 0;
+    std::atomic<uint64_t> head {0};
+    std::array<FlightRecord, kFlightRecordsPerThread> records {};
+};
+
+std::array<std::atomic<FlightRing *>, kMaxThreads> gRings {};
+std::atomic<uint32_t> gRingCount {0};
+
+// Fixed buffer so the signal handler never touches std::filesystem.
+char gDumpPath[4096] = "mksync.flight";
+std::atomic<bool> gDumpPathReady {true};
+
+auto nowNs() noexcept -> uint64_t {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count());
+}
+
+auto threadRing() noexcept -> FlightRing * {
+    thread_local FlightRing *ring = nullptr;
+    thread_local bool exhausted = false;
+    if (ring || exhausted) {
+        return ring;
+    }
+
+    const auto slot = gRingCount.fetch_add(1, std::memory_order_relaxed);
+    if (slot >= kMaxThreads) {
+        exhausted = true;
+        return nullptr;
+    }
+    try {
+        // Intentionally leaked: a crash dump must still see rings of threads
+        // that already exited.
+        ring = new FlightRing {};
+    }
+    catch (...) {
+        exhausted = true;
+        return nullptr;
+    }
+    ring->index = slot;
+    gRings[slot].store(ring, std::memory_order_release);
+    return ring;
+}
+
+auto push(const FlightRecord &record) noexcept -> void {
+    auto *ring = threadRing();
+    if (!ring) {
+        return;
+    }
+    const auto head = ring->head.load(std::memory_order_relaxed);
+    ring->records[head & (kFlightRecordsPerThread - 1)] = record;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+auto describe(FlightRecord &record, const InputEvent &event) noexcept -> void {
+    std::visit(Overloads {
+        [&](const KeyEvent &key) {
+            record.eventType = FlightEventType::Key;
+            record.detail = static_cast<uint32_t>(key.key);
+            record.release = key.release;
+        },
+        [&](const MouseButtonEvent &button) {
+            record.eventType = FlightEventType::MouseButton;
+            record.x = button.x;
+            record.y = button.y;
+            record.detail = static_cast<uint32_t>(button.button);
+            record.release = button.release;
+        },
+        [&](const MouseMoveEvent &move) {
+            record.eventType = FlightEventType::MouseMove;
+            record.x = move.x;
+            record.y = move.y;
+        },
+        [&](const MouseWheelEvent &wheel) {
+            record.eventType = FlightEventType::MouseWheel;
+            record.x = wheel.deltaX;
+            record.y = wheel.deltaY;
+        },
+    }, event);
+}
+
+// MARK: Raw file helpers (async-signal-safe)
+
+auto openForWrite(const char *path) noexcept -> int {
+#if defined(_WIN32)
+    return ::_open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+#endif
+}
+
+auto closeFile(int fd) noexcept -> void {
+#if defined(_WIN32)
+    ::_close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+auto writeAll(int fd, const void *data, size_t size) noexcept -> bool {
+    auto *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+#if defined(_WIN32)
+        const auto written = ::_write(fd, bytes, static_cast<unsigned int>(size));
+#else
+        const auto written = ::write(fd, bytes, size);
+#endif
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+auto writeDump(int fd) noexcept -> bool {
+    const auto threadCount =
+        std::min<uint32_t>(gRingCount.load(std::memory_order_acquire), kMaxThreads);
+    auto header = DumpHeader {};
+    std::memcpy(header.magic, kDumpMagic, sizeof(header.magic));
+    header.version = kDumpVersion;
+    header.recordSize = sizeof(FlightRecord);
+    header.dumpTimeNs = nowNs();
+
+    // A slot can be claimed but not yet published; count only visible rings.
+    for (auto slot = 0U; slot < threadCount; ++slot) {
+        if (gRings[slot].load(std::memory_order_acquire)) {
+            ++header.threadCount;
+        }
+    }
+    if (!writeAll(fd, &header, sizeof(header))) {
+        return false;
+    }
+
+    for (auto slot = 0U; slot < threadCount; ++slot) {
+        auto *ring = gRings[slot].load(std::memory_order_acquire);
+        if (!ring) {
+            continue;
+        }
+        const auto head = ring->head.load(std::memory_order_acquire);
+        const auto count = std::min<uint64_t>(head, kFlightRecordsPerThread);
+        const auto thread = ThreadHeader {
+            .index = ring->index,
+            .recordCount = static_cast<uint32_t>(count),
+        };
+        if (!writeAll(fd, &thread, sizeof(thread))) {
+            return false;
+        }
+
+        // Oldest record first: [start, end) of the ring, then the wrapped part.
+        const auto start = static_cast<size_t>((head - count) & (kFlightRecordsPerThread - 1));
+        const auto firstPart = std::min<size_t>(count, kFlightRecordsPerThread - start);
+        if (!writeAll(fd, ring->records.data() + start, firstPart * sizeof(FlightRecord))) {
+            return false;
+        }
+        if (!writeAll(fd, ring->records.data(), (count - firstPart) * sizeof(FlightRecord))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+auto readPod(std::span<const std::byte> &data, T &value) -> bool {
+    if (data.size() < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, data.data(), sizeof(T));
+    data = data.subspan(sizeof(T));
+    return true;
+}
+
+} // namespace
+
+// MARK: Recording
+
+auto flightRecord(
+    FlightStage stage,
+    const InputEvent &event,
+    uint32_t screenIndex,
+    uint32_t queueDepth
+) noexcept -> void {
+    auto record = FlightRecord {};
+    record.timestampNs = nowNs();
+    record.stage = stage;
+    record.screenIndex = screenIndex;
+    record.queueDepth = static_cast<uint16_t>(
+        std::min<uint32_t>(queueDepth, std::numeric_limits<uint16_t>::max())
+    );
+    describe(record, event);
+    push(record);
+}
+
+auto flightRecord(FlightStage stage, uint32_t screenIndex) noexcept -> void {
+    auto record = FlightRecord {};
+    record.timestampNs = nowNs();
+    record.stage = stage;
+    record.screenIndex = screenIndex;
+    push(record);
+}
+
+// MARK: Dump
+
+auto setFlightDumpPath(const std::filesystem::path &path) -> void {
+    const auto text = path.string();
+    // Handlers that race with this see either the old path or no path, never
+    // a half-copied one.
+    gDumpPathReady.store(false, std::memory_order_release);
+    const auto size = std::min(text.size(), sizeof(gDumpPath) - 1);
+    std::memcpy(gDumpPath, text.data(), size);
+    gDumpPath[size] = '\0';
+    gDumpPathReady.store(true, std::memory_order_release);
+}
+
+auto flightDumpPath() -> std::filesystem::path {
+    return std::filesystem::path {gDumpPath};
+}
+
+auto dumpFlightRecorder() noexcept -> bool {
+    if (!gDumpPathReady.load(std::memory_order_acquire)) {
+        return false;
+    }
+    const auto fd = openForWrite(gDumpPath);
+    if (fd < 0) {
+        return false;
+    }
+    const auto ok = writeDump(fd);
+    closeFile(fd);
+    return ok;
+}
+
+auto dumpFlightRecorder(const std::filesystem::path &path) -> IoResult<void> {
+    const auto text = path.string();
+    const auto fd = openForWrite(text.c_str());
+    if (fd < 0) {
+        return Err(std::error_code(errno, std::generic_category()));
+    }
+    const auto ok = writeDump(fd);
+    closeFile(fd);
+    if (!ok) {
+        return Err(FlightDumpError::IoError);
+    }
+    return {};
+}
+
+// MARK: Decode
+
+auto decodeFlightDump(std::span<const std::byte> data) -> IoResult<FlightDump> {
+    auto header = DumpHeader {};
+    if (!readPod(data, header)) {
+        return Err(FlightDumpError::Truncated);
+    }
+    if (std::memcmp(header.magic, kDumpMagic, sizeof(kDumpMagic)) != 0) {
+        return Err(FlightDumpError::BadMagic);
+    }
+    if (header.version != kDumpVersion || header.recordSize != sizeof(FlightRecord)) {
+        return Err(FlightDumpError::UnsupportedVersion);
+    }
+
+    auto dump = FlightDump {};
+    dump.dumpTimeNs = header.dumpTimeNs;
+    for (auto index = 0U; index < header.threadCount; ++index) {
+        auto thread = ThreadHeader {};
+        if (!readPod(data, thread) || data.size() / sizeof(FlightRecord) < thread.recordCount) {
+            return Err(FlightDumpError::Truncated);
+        }
+        auto &decoded = dump.threads.emplace_back();
+        decoded.index = thread.index;
+        decoded.records.resize(thread.recordCount);
+        std::memcpy(decoded.records.data(), data.data(), thread.recordCount * sizeof(FlightRecord));
+        data = data.subspan(thread.recordCount * sizeof(FlightRecord));
+    }
+    return dump;
+}
+
+auto readFlightDump(const std::filesystem::path &path) -> IoResult<FlightDump> {
+    auto file = std::ifstream {path, std::ios::binary};
+    if (!file) {
+        return Err(FlightDumpError::IoError);
+    }
+    auto bytes = std::vector<char>(
+        std::istreambuf_iterator<char> {file},
+        std::istreambuf_iterator<char> {}
+    );
+    return decodeFlightDump(std::as_bytes(std::span {bytes}));
+}
+
+auto formatFlightDump(const FlightDump &dump) -> std::string {
+    struct Entry {
+        uint32_t thread;
+        const FlightRecord *record;
+    };
+    auto entries = std::vector<Entry> {};
+    for (const auto &thread : dump.threads) {
+        for (const auto &record : thread.records) {
+            entries.push_back(Entry {.thread = thread.index, .record = &record});
+        }
+    }
+    std::ranges::stable_sort(entries, {}, [](const Entry &entry) {
+        return entry.record->timestampNs;
+    });
+
+    auto text = std::string {};
+    auto out = std::back_inserter(text);
+    for (const auto &entry : entries) {
+        const auto ageNs = static_cast<int64_t>(dump.dumpTimeNs - entry.record->timestampNs);
+        out = fmtlib::format_to(
+            out,
+            "-{:.3f}ms t{} {}\n",
+            static_cast<double>(ageNs) / 1e6,
+            entry.thread,
+            *entry.record
+        );
+    }
+    return text;
+}
+
+MKS_END
@@ -0,0 +1,130 @@
+/**
+ * @file flight_recorder.hpp
+ * @brief Per-thread ring of the most recent input pipeline events.
+ *
+ * Every thread that records gets its own fixed-size ring, so the hot path is
+ * a clock read, a 32-byte store and a release increment. Rings are never
+ * freed; a crash handler can walk them without locks or allocation and write
+ * them straight to a file descriptor.
+ */
+#pragma once
+
+#include "preinclude.hpp"
+#include "refl/formatter.hpp"
+#include "refl/this_error.hpp"
+#include "core.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+MKS_BEGIN
+
+/**
+ * @brief Where in the pipeline a record was taken.
+ */
+enum class FlightStage : uint8_t {
+    Capture = 0,   // InputCapture produced the event (server)
+    Queue,         // Enqueued on a session channel
+    Drop,          // Router dropped it (no sender / queue full)
+    Send,          // Session writer handed it to RpcTransport
+    Receive,       // Client read it from RpcTransport
+    Inject,        // Client injected it
+    InjectFailed,  // Client injection returned an error
+    ScreenSwitch,  // Active screen changed, screenIndex is the new screen
+};
+FORMATTER(FlightStage);
+
+enum class FlightEventType : uint8_t {
+    None = 0,
+    Key,
+    MouseButton,
+    MouseMove,
+    MouseWheel,
+};
+FORMATTER(FlightEventType);
+
+/**
+ * @brief One fixed-size, trivially copyable record; the dump file stores these verbatim.
+ */
+struct FlightRecord {
+    static constexpr uint32_t kNoScreen = std::numeric_limits<uint32_t>::max();
+
+    uint64_t        timestampNs = 0; // steady_clock, only meaningful relative to other records
+    FlightStage     stage = FlightStage::Capture;
+    FlightEventType eventType = FlightEventType::None;
+    uint16_t        queueDepth = 0;
+    uint32_t        screenIndex = kNoScreen;
+    int32_t         x = 0;           // Position, or wheel delta for MouseWheel
+    int32_t         y = 0;
+    uint32_t        detail = 0;      // Key / MouseButton value
+    bool            release = false;
+};
+FORMATTER(FlightRecord);
+static_assert(std::is_trivially_copyable_v<FlightRecord>);
+static_assert(sizeof(FlightRecord) == 32);
+
+enum class FlightDumpError {
+    Ok = 0,
+    BadMagic,
+    UnsupportedVersion,
+    Truncated,
+    IoError,
+};
+THIS_ERROR(FlightDumpError);
+
+struct FlightThread {
+    uint32_t                  index = 0; // Registration order, not an OS thread id
+    std::vector<FlightRecord> records;   // Oldest first
+};
+
+struct FlightDump {
+    uint64_t                  dumpTimeNs = 0;
+    std::vector<FlightThread> threads;
+};
+
+/** @brief Records kept per thread; older ones are overwritten. */
+inline constexpr size_t kFlightRecordsPerThread = 4096;
+
+/** @brief Record an event passing @p stage. Never blocks or allocates after the first call per thread. */
+auto flightRecord(
+    FlightStage stage,
+    const InputEvent &event,
+    uint32_t screenIndex = FlightRecord::kNoScreen,
+    uint32_t queueDepth = 0
+) noexcept -> void;
+
+/** @brief Record an event-less stage such as ScreenSwitch. */
+auto flightRecord(FlightStage stage, uint32_t screenIndex) noexcept -> void;
+
+/** @brief Set the file used by signal-triggered dumps. Call before installing handlers. */
+auto setFlightDumpPath(const std::filesystem::path &path) -> void;
+auto flightDumpPath() -> std::filesystem::path;
+
+/**
+ * @brief Write all rings to the configured path.
+ *
+ * Async-signal-safe: only open/write/close on preallocated memory. Records
+ * being written concurrently may come out torn.
+ */
+auto dumpFlightRecorder() noexcept -> bool;
+
+/** @brief Write all rings to @p path (normal context, e.g. a control command). */
+auto dumpFlightRecorder(const std::filesystem::path &path) -> IoResult<void>;
+
+/** @brief Parse a dump written by @ref dumpFlightRecorder. */
+auto decodeFlightDump(std::span<const std::byte> data) -> IoResult<FlightDump>;
+auto readFlightDump(const std::filesystem::path &path) -> IoResult<FlightDump>;
+
+/** @brief Merge threads by time and print each record with its age before the dump. */
+auto formatFlightDump(const FlightDump &dump) -> std::string;
+
+MKS_END
+
+REFL_REGISTER_FMT_FORMATTER(mks::FlightStage);
+REFL_REGISTER_FMT_FORMATTER(mks::FlightEventType);
+REFL_REGISTER_FMT_FORMATTER(mks::FlightRecord);
+REFL_REGISTER_FMT_FORMATTER(mks::FlightDumpError);
@@ -0,0 +1,154 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <bit>
+
+MKS_BEGIN
+
+// MARK: Histogram
+
+auto Histogram::bucketIndex(uint64_t value) noexcept -> size_t {
+    if (value < kSubBuckets) {
+        return static_cast<size_t>(value);
+    }
+    // value lies in [2^msb, 2^(msb+1)); keep the kSubBucketBits bits below the
+    // leading one as the linear slice inside that power of two.
+    const auto msb = static_cast<size_t>(std::bit_width(value)) - 1;
+    const auto shift = msb - kSubBucketBits;
+    const auto slice = static_cast<size_t>(value >> shift) - kSubBuckets;
+    return kSubBuckets + shift * kSubBuckets + slice;
+}
+
+auto Histogram::bucketUpperBound(size_t index) noexcept -> uint64_t {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    const auto shift = (index - kSubBuckets) / kSubBuckets;
+    const auto slice = (index - kSubBuckets) % kSubBuckets;
+    const auto lower = static_cast<uint64_t>(kSubBuckets + slice) << shift;
+    return lower + ((uint64_t {1} << shift) - 1);
+}
+
+auto Histogram::record(uint64_t value) noexcept -> void {
+    mBuckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+    mSum.fetch_add(value, std::memory_order_relaxed);
+    auto previous = mMax.load(std::memory_order_relaxed);
+    while (previous < value &&
+           !mMax.compare_exchange_weak(previous, value, std::memory_order_relaxed)) {
+    }
+}
+
+auto Histogram::snapshot() const -> HistogramSnapshot {
+    auto result = HistogramSnapshot {};
+    result.count = mCount.load(std::memory_order_relaxed);
+    result.sum = mSum.load(std::memory_order_relaxed);
+    result.max = mMax.load(std::memory_order_relaxed);
+    for (auto index = 0U; index < kBucketCount; ++index) {
+        if (auto count = mBuckets[index].load(std::memory_order_relaxed); count != 0) {
+            result.buckets.emplace_back(bucketUpperBound(index), count);
+        }
+    }
+    return result;
+}
+
+auto HistogramSnapshot::percentile(double q) const -> uint64_t {
+    // Buckets are read one by one without a global lock, so their total can
+    // drift from count while writers are active. Rank against the buckets.
+    auto total = uint64_t {0};
+    for (const auto &[_, bucketCount] : buckets) {
+        total += bucketCount;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::clamp(q, 0.0, 1.0) * total + 0.5));
+    auto seen = uint64_t {0};
+    for (const auto &[upper, bucketCount] : buckets) {
+        seen += bucketCount;
+        if (seen >= rank) {
+            return std::min(upper, max);
+        }
+    }
+    return max;
+}
+
+auto HistogramSnapshot::mean() const -> uint64_t {
+    return count == 0 ? 0 : sum / count;
+}
+
+// MARK: Registry
+
+template <typename T>
+auto MetricsRegistry::findOrAdd(std::deque<Named<T>> &table, std::string_view name) -> T & {
+    auto it = std::ranges::find(table, name, &Named<T>::name);
+    if (it != table.end()) {
+        return it->metric;
+    }
+    return table.emplace_back(name).metric;
+}
+
+auto MetricsRegistry::counter(std::string_view name) -> Counter & {
+    auto lock = std::scoped_lock {mMutex};
+    return findOrAdd(mCounters, name);
+}
+
+auto MetricsRegistry::gauge(std::string_view name) -> Gauge & {
+    auto lock = std::scoped_lock {mMutex};
+    return findOrAdd(mGauges, name);
+}
+
+auto MetricsRegistry::histogram(std::string_view name) -> Histogram & {
+    auto lock = std::scoped_lock {mMutex};
+    return findOrAdd(mHistograms, name);
+}
+
+auto MetricsRegistry::snapshot() const -> MetricsSnapshot {
+    auto lock = std::scoped_lock {mMutex};
+    auto result = MetricsSnapshot {};
+    for (const auto &entry : mCounters) {
+        result.counters.emplace_back(entry.name, entry.metric.value());
+    }
+    for (const auto &entry : mGauges) {
+        result.gauges.emplace_back(entry.name, entry.metric.value());
+    }
+    for (const auto &entry : mHistograms) {
+        result.histograms.emplace_back(entry.name, entry.metric.snapshot());
+    }
+    std::ranges::sort(result.counters);
+    std::ranges::sort(result.gauges);
+    std::ranges::sort(result.histograms, {}, &std::pair<std::string, HistogramSnapshot>::first);
+    return result;
+}
+
+auto metrics() -> MetricsRegistry & {
+    static auto registry = MetricsRegistry {};
+    return registry;
+}
+
+auto formatMetrics(const MetricsSnapshot &snapshot) -> std::string {
+    auto text = std::string {};
+    auto out = std::back_inserter(text);
+    for (const auto &[name, value] : snapshot.counters) {
+        out = fmtlib::format_to(out, "counter   {} {}\n", name, value);
+    }
+    for (const auto &[name, value] : snapshot.gauges) {
+        out = fmtlib::format_to(out, "gauge     {} {}\n", name, value);
+    }
+    for (const auto &[name, histogram] : snapshot.histograms) {
+        out = fmtlib::format_to(
+            out,
+            "histogram {} count={} mean={} p50={} p90={} p99={} max={}\n",
+            name,
+            histogram.count,
+            histogram.mean(),
+            histogram.percentile(0.50),
+            histogram.percentile(0.90),
+            histogram.percentile(0.99),
+            histogram.max
+        );
+    }
+    return text;
+}
+
+MKS_END
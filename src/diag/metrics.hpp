@@ -0,0 +1,141 @@
+/**
+ * @file metrics.hpp
+ * @brief In-process counters, gauges and histograms for runtime diagnostics.
+ *
+ * Hot paths only touch relaxed atomics. Registration takes a lock once per
+ * metric name; callers keep the returned reference (usually in a function
+ * local static) so steady-state updates never look the name up again.
+ */
+#pragma once
+
+#include "preinclude.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+MKS_BEGIN
+
+/**
+ * @brief Monotonic event count.
+ */
+class Counter {
+public:
+    auto add(uint64_t value = 1) noexcept -> void {
+        mValue.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    auto value() const noexcept -> uint64_t {
+        return mValue.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> mValue {0};
+};
+
+/**
+ * @brief Instantaneous level (sessions, queue depth, ...).
+ */
+class Gauge {
+public:
+    auto set(int64_t value) noexcept -> void {
+        mValue.store(value, std::memory_order_relaxed);
+    }
+
+    auto add(int64_t value) noexcept -> void {
+        mValue.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    auto value() const noexcept -> int64_t {
+        return mValue.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int64_t> mValue {0};
+};
+
+struct HistogramSnapshot {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    // Non-empty buckets only, as (inclusive upper bound, count).
+    std::vector<std::pair<uint64_t, uint64_t>> buckets;
+
+    /** @brief Upper bound of the bucket holding quantile @p q in [0, 1]. */
+    auto percentile(double q) const -> uint64_t;
+    auto mean() const -> uint64_t;
+};
+
+/**
+ * @brief Log-linear histogram over the full uint64 range.
+ *
+ * Values below @c kSubBuckets map 1:1; above that every power of two is split
+ * into @c kSubBuckets linear slices, bounding the relative error to 1/8.
+ */
+class Histogram {
+public:
+    static constexpr size_t kSubBucketBits = 3;
+    static constexpr size_t kSubBuckets = size_t {1} << kSubBucketBits;
+    static constexpr size_t kBucketCount = kSubBuckets + (64 - kSubBucketBits) * kSubBuckets;
+
+    auto record(uint64_t value) noexcept -> void;
+    auto snapshot() const -> HistogramSnapshot;
+
+    static auto bucketIndex(uint64_t value) noexcept -> size_t;
+    static auto bucketUpperBound(size_t index) noexcept -> uint64_t;
+
+private:
+    std::array<std::atomic<uint64_t>, kBucketCount> mBuckets {};
+    std::atomic<uint64_t> mCount {0};
+    std::atomic<uint64_t> mSum {0};
+    std::atomic<uint64_t> mMax {0};
+};
+
+struct MetricsSnapshot {
+    std::vector<std::pair<std::string, uint64_t>> counters;
+    std::vector<std::pair<std::string, int64_t>> gauges;
+    std::vector<std::pair<std::string, HistogramSnapshot>> histograms;
+};
+
+/**
+ * @brief Name → metric table. Metrics are never removed, so returned
+ *        references stay valid for the process lifetime.
+ */
+class MetricsRegistry {
+public:
+    auto counter(std::string_view name) -> Counter &;
+    auto gauge(std::string_view name) -> Gauge &;
+    auto histogram(std::string_view name) -> Histogram &;
+
+    auto snapshot() const -> MetricsSnapshot;
+
+private:
+    template <typename T>
+    struct Named {
+        explicit Named(std::string_view name) : name(name) {}
+
+        std::string name;
+        T metric;
+    };
+
+    template <typename T>
+    static auto findOrAdd(std::deque<Named<T>> &table, std::string_view name) -> T &;
+
+    mutable std::mutex mMutex;
+    // deque keeps element addresses stable across emplace_back.
+    std::deque<Named<Counter>> mCounters;
+    std::deque<Named<Gauge>> mGauges;
+    std::deque<Named<Histogram>> mHistograms;
+};
+
+/** @brief Process-wide registry updated by server, sessions, transport and backends. */
+auto metrics() -> MetricsRegistry &;
+
+/** @brief Plain-text rendering used by `mksync stats`. */
+auto formatMetrics(const MetricsSnapshot &snapshot) -> std::string;
+
+MKS_END
@@ -0,0 +1,55 @@
+/**
+ * @file probes.hpp
+ * @brief USDT (sys/sdt.h) probes on the input pipeline, provider @c mksync.
+ *
+ * A probe compiles to a single nop plus an ELF note; nothing runs until a
+ * tracer (bpftrace, perf, SystemTap) attaches to the live process. Arguments
+ * should be values already at hand (ints, enum values, sizes) so the disabled
+ * cost stays that one nop.
+ *
+ * Enabled automatically on Linux when <sys/sdt.h> is available
+ * (systemtap-sdt-dev / systemtap-sdt-devel); `xmake f --enable_usdt=n`
+ * defines MKS_USDT=0 and turns every probe into nothing.
+ *
+ * | probe          | arguments                                   |
+ * |----------------|---------------------------------------------|
+ * | capture        | event type (XCB backend)                    |
+ * | screen_switch  | old screen index, new screen index          |
+ * | queue          | screen index, event type, queued (1) / dropped (0) |
+ * | rpc_write      | message id, payload bytes                   |
+ * | rpc_read       | message id, payload bytes                   |
+ * | inject_begin   | event type                                  |
+ * | inject_end     | event type, error value (0 on success)      |
+ *
+ * Event type is the InputEvent variant index: 0 Key, 1 MouseButton,
+ * 2 MouseMove, 3 MouseWheel.
+ */
+#pragma once
+
+#if !defined(MKS_USDT)
+    #if defined(__linux__) && defined(__has_include)
+        #if __has_include(<sys/sdt.h>)
+            #define MKS_USDT 1
+        #endif
+    #endif
+#endif
+#if !defined(MKS_USDT)
+    #define MKS_USDT 0
+#endif
+
+#if MKS_USDT
+    #include <sys/sdt.h>
+
+    #define MKS_PROBE0(name)                   DTRACE_PROBE(mksync, name)
+    #define MKS_PROBE1(name, a1)               DTRACE_PROBE1(mksync, name, a1)
+    #define MKS_PROBE2(name, a1, a2)           DTRACE_PROBE2(mksync, name, a1, a2)
+    #define MKS_PROBE3(name, a1, a2, a3)       DTRACE_PROBE3(mksync, name, a1, a2, a3)
+    #define MKS_PROBE4(name, a1, a2, a3, a4)   DTRACE_PROBE4(mksync, name, a1, a2, a3, a4)
+#else
+    // sizeof keeps arguments unevaluated but "used", so no unused-variable warnings.
+    #define MKS_PROBE0(name)                   ((void)0)
+    #define MKS_PROBE1(name, a1)               ((void)sizeof(a1))
+    #define MKS_PROBE2(name, a1, a2)           ((void)sizeof(a1), (void)sizeof(a2))
+    #define MKS_PROBE3(name, a1, a2, a3)       ((void)sizeof(a1), (void)sizeof(a2), (void)sizeof(a3))
+    #define MKS_PROBE4(name, a1, a2, a3, a4)   ((void)sizeof(a1), (void)sizeof(a2), (void)sizeof(a3), (void)sizeof(a4))
+#endif
@@ -0,0 +1,290 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_WIN32)
+    #include <process.h>
+#else
+    #include <unistd.h>
+#endif
+
+MKS_BEGIN
+
+namespace {
+
+struct TraceEvent {
+    const char *name;
+    uint64_t tsNs;  // system_clock, so server and client files share a time base
+    uint64_t durNs;
+    uint64_t id;
+    char phase;     // Chrome Trace Event "ph"
+};
+
+// Written by its owning thread, drained by stopTracing. The lock is
+// uncontended except during the final drain.
+struct ThreadBuffer {
+    uint32_t tid = 0;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    uint64_t dropped = 0;
+};
+
+std::atomic<bool> gEnabled {false};
+std::atomic<uint64_t> gNextId {1};
+
+std::mutex gMutex;
+// Buffers are never erased: thread_local pointers below keep referring to them.
+std::vector<std::unique_ptr<ThreadBuffer>> gBuffers;
+std::filesystem::path gPath;
+std::string gProcessName;
+
+auto nowNs(std::chrono::system_clock::time_point time) noexcept -> uint64_t {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count()
+    );
+}
+
+auto threadBuffer() -> ThreadBuffer & {
+    thread_local ThreadBuffer *buffer = nullptr;
+    if (!buffer) {
+        auto lock = std::scoped_lock {gMutex};
+        auto &created = gBuffers.emplace_back(std::make_unique<ThreadBuffer>());
+        created->tid = static_cast<uint32_t>(gBuffers.size());
+        buffer = created.get();
+    }
+    return *buffer;
+}
+
+auto push(const TraceEvent &event) noexcept -> void {
+    try {
+        auto &buffer = threadBuffer();
+        auto lock = std::scoped_lock {buffer.mutex};
+        if (buffer.events.size() >= kTraceEventsPerThread) {
+            ++buffer.dropped;
+            return;
+        }
+        buffer.events.push_back(event);
+    }
+    catch (...) {
+        // Tracing is best effort; never let it take down the pipeline.
+    }
+}
+
+auto processId() -> uint64_t {
+#if defined(_WIN32)
+    return static_cast<uint64_t>(::_getpid());
+#else
+    return static_cast<uint64_t>(::getpid());
+#endif
+}
+
+auto escapeJson(std::string_view text) -> std::string {
+    auto result = std::string {};
+    for (auto ch : text) {
+        if (ch == '"' || ch == '\\') {
+            result.push_back('\\');
+            result.push_back(ch);
+        }
+        else if (static_cast<unsigned char>(ch) < 0x20) {
+            result += fmtlib::format("\\u{:04x}", static_cast<unsigned>(ch));
+        }
+        else {
+            result.push_back(ch);
+        }
+    }
+    return result;
+}
+
+// Chrome wants microseconds; keep the nanosecond part as a fraction.
+auto formatMicros(uint64_t ns) -> std::string {
+    return fmtlib::format("{}.{:03}", ns / 1000, ns % 1000);
+}
+
+auto appendEvent(std::string &out, const TraceEvent &event, uint64_t pid, uint32_t tid) -> void {
+    auto it = std::back_inserter(out);
+    switch (event.phase) {
+        case 'X':
+            it = fmtlib::format_to(
+                it,
+                R"({{"name":"{}","cat":"mksync","ph":"X","ts":{},"dur":{},"pid":{},"tid":{},"args":{{"id":{}}}}})",
+                event.name, formatMicros(event.tsNs), formatMicros(event.durNs), pid, tid, event.id
+            );
+            break;
+        case 'i':
+            it = fmtlib::format_to(
+                it,
+                R"({{"name":"{}","cat":"mksync","ph":"i","s":"t","ts":{},"pid":{},"tid":{},"args":{{"id":{}}}}})",
+                event.name, formatMicros(event.tsNs), pid, tid, event.id
+            );
+            break;
+        case 's':
+        case 't':
+        case 'f':
+            // "bp":"e" binds every hop to the enclosing slice rather than the next one.
+            it = fmtlib::format_to(
+                it,
+                R"({{"name":"input","cat":"input","ph":"{}","bp":"e","id":{},"ts":{},"pid":{},"tid":{}}})",
+                event.phase, event.id, formatMicros(event.tsNs), pid, tid
+            );
+            break;
+        default: // 'b' / 'e'
+            it = fmtlib::format_to(
+                it,
+                R"({{"name":"{}","cat":"mksync","ph":"{}","id":{},"ts":{},"pid":{},"tid":{}}})",
+                event.name, event.phase, event.id, formatMicros(event.tsNs), pid, tid
+            );
+            break;
+    }
+}
+
+} // namespace
+
+// MARK: Session
+
+auto startTracing(const std::filesystem::path &path, std::string processName) -> void {
+    auto lock = std::scoped_lock {gMutex};
+    for (auto &buffer : gBuffers) {
+        auto bufferLock = std::scoped_lock {buffer->mutex};
+        buffer->events.clear();
+        buffer->dropped = 0;
+    }
+    gPath = path;
+    gProcessName = std::move(processName);
+    gEnabled.store(true, std::memory_order_release);
+}
+
+auto stopTracing() -> IoResult<void> {
+    if (!gEnabled.exchange(false, std::memory_order_acq_rel)) {
+        return {};
+    }
+
+    const auto pid = processId();
+    auto lock = std::scoped_lock {gMutex};
+    auto text = std::string {"{\"traceEvents\":[\n"};
+    text += fmtlib::format(
+        R"({{"name":"process_name","ph":"M","pid":{},"tid":0,"args":{{"name":"mksync {}"}}}})",
+        pid,
+        escapeJson(gProcessName)
+    );
+    auto dropped = uint64_t {0};
+    for (auto &buffer : gBuffers) {
+        auto bufferLock = std::scoped_lock {buffer->mutex};
+        for (const auto &event : buffer->events) {
+            text += ",\n";
+            appendEvent(text, event, pid, buffer->tid);
+        }
+        dropped += buffer->dropped;
+        buffer->events.clear();
+        buffer->events.shrink_to_fit();
+        buffer->dropped = 0;
+    }
+    text += fmtlib::format("\n],\"displayTimeUnit\":\"ns\",\"otherData\":{{\"droppedEvents\":{}}}}}\n", dropped);
+
+    auto file = std::ofstream {gPath, std::ios::binary | std::ios::trunc};
+    if (!file) {
+        return Err(std::error_code(errno, std::generic_category()));
+    }
+    file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    if (!file) {
+        return Err(std::make_error_code(std::errc::io_error));
+    }
+    return {};
+}
+
+auto tracingEnabled() noexcept -> bool {
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+// MARK: Ids
+
+auto nextTraceId() noexcept -> uint64_t {
+    if (!tracingEnabled()) {
+        return 0;
+    }
+    return gNextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+// MARK: Events
+
+TraceSpan::TraceSpan(const char *name, uint64_t id) noexcept :
+    mName(name), mId(id), mActive(tracingEnabled()) {
+    if (mActive) {
+        mStart = std::chrono::system_clock::now();
+    }
+}
+
+TraceSpan::~TraceSpan() {
+    if (!mActive || !tracingEnabled()) {
+        return;
+    }
+    const auto end = std::chrono::system_clock::now();
+    push(TraceEvent {
+        .name = mName,
+        .tsNs = nowNs(mStart),
+        .durNs = nowNs(end) - nowNs(mStart),
+        .id = mId,
+        .phase = 'X',
+    });
+}
+
+auto traceInstant(const char *name, uint64_t id) noexcept -> void {
+    if (!tracingEnabled()) {
+        return;
+    }
+    push(TraceEvent {
+        .name = name,
+        .tsNs = nowNs(std::chrono::system_clock::now()),
+        .durNs = 0,
+        .id = id,
+        .phase = 'i',
+    });
+}
+
+auto traceFlow(TraceFlow phase, uint64_t id) noexcept -> void {
+    if (!tracingEnabled() || id == 0) {
+        return;
+    }
+    const auto ph = phase == TraceFlow::Start ? 's' : phase == TraceFlow::Step ? 't' : 'f';
+    push(TraceEvent {
+        .name = "input",
+        .tsNs = nowNs(std::chrono::system_clock::now()),
+        .durNs = 0,
+        .id = id,
+        .phase = ph,
+    });
+}
+
+auto traceAsyncBegin(const char *name, uint64_t id) noexcept -> void {
+    if (!tracingEnabled() || id == 0) {
+        return;
+    }
+    push(TraceEvent {
+        .name = name,
+        .tsNs = nowNs(std::chrono::system_clock::now()),
+        .durNs = 0,
+        .id = id,
+        .phase = 'b',
+    });
+}
+
+auto traceAsyncEnd(const char *name, uint64_t id) noexcept -> void {
+    if (!tracingEnabled() || id == 0) {
+        return;
+    }
+    push(TraceEvent {
+        .name = name,
+        .tsNs = nowNs(std::chrono::system_clock::now()),
+        .durNs = 0,
+        .id = id,
+        .phase = 'e',
+    });
+}
+
+MKS_END
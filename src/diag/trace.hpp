@@ -0,0 +1,85 @@
+/**
+ * @file trace.hpp
+ * @brief Opt-in Chrome Trace Event export of the input pipeline.
+ *
+ * Disabled by default; every entry point first checks one relaxed atomic and
+ * returns. When enabled (`--trace-file`), events are appended to per-thread
+ * buffers and written as Chrome Trace Event JSON on @ref stopTracing, which
+ * loads directly in Perfetto UI or chrome://tracing.
+ *
+ * Every queued InputMessage carries a trace id (InputMessage::traceId) from
+ * the router to the injector, so flow arrows connect the server and client
+ * halves once both files are merged into one @c traceEvents array.
+ */
+#pragma once
+
+#include "preinclude.hpp"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+MKS_BEGIN
+
+/** @brief Events kept per thread; later events are counted and dropped. */
+inline constexpr size_t kTraceEventsPerThread = size_t {1} << 20;
+
+enum class TraceFlow : uint8_t {
+    Start, // First hop of an event (server router)
+    Step,  // Intermediate hop (transport write / read)
+    End,   // Last hop (client injection)
+};
+
+/**
+ * @brief Start collecting events.
+ *
+ * @param path Output file written by @ref stopTracing.
+ * @param processName Shown as the process label in the viewer ("server", "client").
+ */
+auto startTracing(const std::filesystem::path &path, std::string processName) -> void;
+
+/** @brief Stop collecting and write everything recorded so far. No-op when not tracing. */
+auto stopTracing() -> IoResult<void>;
+
+auto tracingEnabled() noexcept -> bool;
+
+/**
+ * @brief Fresh correlation id for one queued InputMessage, 0 when tracing is off.
+ *
+ * Ids come from the server only, so they are unique across a merged trace.
+ */
+auto nextTraceId() noexcept -> uint64_t;
+
+/**
+ * @brief Complete ("X") event covering the object's lifetime.
+ *
+ * @p name must outlive the trace (string literals); it is stored by pointer.
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char *name, uint64_t id = 0) noexcept;
+    TraceSpan(const TraceSpan &) = delete;
+    ~TraceSpan();
+
+    /** @brief Attach a correlation id learned after the span started (e.g. after decode). */
+    auto setId(uint64_t id) noexcept -> void { mId = id; }
+
+private:
+    const char *mName;
+    uint64_t mId;
+    std::chrono::system_clock::time_point mStart;
+    bool mActive;
+};
+
+/** @brief Point-in-time ("i") event. */
+auto traceInstant(const char *name, uint64_t id = 0) noexcept -> void;
+
+/** @brief Flow arrow hop for @p id; must be emitted inside the span it should attach to. */
+auto traceFlow(TraceFlow phase, uint64_t id) noexcept -> void;
+
+/** @brief Async ("b"/"e") slice, for waits that begin and end on different stacks (channel queue). */
+auto traceAsyncBegin(const char *name, uint64_t id) noexcept -> void;
+auto traceAsyncEnd(const char *name, uint64_t id) noexcept -> void;
+
+MKS_END
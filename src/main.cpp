@@ -1,11 +1,20 @@
 #include "app/client.hpp"
+#include "app/control.hpp"
+#include "app/event_subscribers.hpp"
+#include "app/input_replay.hpp"
+#include "app/plugin_host.hpp"
 #include "app/server.hpp"
+#include "app/thread_tuning.hpp"
 #include "config/app_config.hpp"
 #include "config/arg_config.hpp"
+#include "config/backend_cache.hpp"
 #include "core.hpp"
+#include "diag/flight_recorder.hpp"
+#include "diag/trace.hpp"
 #include "platform/backend.hpp"
 #include "platform/platform.hpp"
 #include "preinclude.hpp"
+#include <algorithm>
 #include <cctype>
 #include <csignal>
 #include <cstdlib>
@@ -25,7 +34,12 @@
 
 static void crashHandler()
 {
+    // Dump first: it is signal-safe, the stack trace below is not.
+    const auto flightDumped = mks::dumpFlightRecorder();
     std::println("Crashed");
+    if (flightDumped) {
+        std::println("Flight recorder: {}", mks::flightDumpPath().string());
+    }
     std::println("Stacktrace:");
     std::println("{}", std::stacktrace::current());
     if (auto logger = spdlog::default_logger()) {
@@ -44,6 +58,12 @@ static auto logFilePath() -> std::filesystem::path
     return "mksync.log";
 }
 
+// One file per role so a server and a client on the same host do not clobber each other.
+static auto flightDumpFile(std::string_view role) -> std::filesystem::path
+{
+    return logFilePath().parent_path() / fmtlib::format("mksync-{}.flight", role);
+}
+
 static auto parseLogLevel(std::string_view text) -> spdlog::level::level_enum
 {
     auto normalized = std::string{};
@@ -91,6 +111,7 @@ static void initializeLogging()
             logger->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] [%s:%#] %v");
             logger->flush_on(spdlog::level::info);
             spdlog::set_default_logger(std::move(logger));
+            mks::setFlightDumpPath(flightDumpFile("cli"));
         }
         catch (const std::exception &err) {
             std::cerr << "Failed to initialize file logging: " << err.what() << '\n';
@@ -112,9 +133,19 @@ static void crashHandlerSignal(int signum)
     std::_Exit(128 + signum);
 }
 
+#if !defined(_WIN32)
+static void flightDumpSignal(int)
+{
+    (void)mks::dumpFlightRecorder();
+}
+#endif
+
 static int _init = []() {
     std::signal(SIGSEGV, crashHandlerSignal);
     std::signal(SIGABRT, crashHandlerSignal);
+#if !defined(_WIN32)
+    std::signal(SIGUSR1, flightDumpSignal);
+#endif
 
 #if defined(_WIN32)
     ::SetUnhandledExceptionFilter([](EXCEPTION_POINTERS *) -> LONG {
@@ -187,10 +218,13 @@ static auto runPlatformCheck(std::string_view requestedBackend) -> mks::IoTask<v
     co_return mks::Err(std::make_error_code(std::errc::operation_not_supported));
 }
 
-static auto selectRuntimeBackend(std::string_view name, mks::BackendRequirement requirement)
+static auto selectRuntimeBackend(const mks::CommonConfig &common,
+                                 mks::BackendRequirement  requirement)
     -> mks::IoTask<mks::PlatformSelection>
 {
-    co_return co_await mks::selectBackend(name, mks::BackendRequirement::Screens | requirement);
+    co_return co_await mks::selectCachedBackend(common.backend,
+                                                mks::BackendRequirement::Screens | requirement,
+                                                mks::backendCachePath(common.configPath));
 }
 
 static auto printHelp(int argc, char **argv, NekoProto::argparser::ArgParserConfig config) -> void
@@ -222,6 +256,101 @@ static auto parseCliCommand(int argc, char **argv) -> std::optional<mks::CliComm
     return std::move(*parsed);
 }
 
+// Ask a running server/client over its control socket; returns the reply body.
+static auto queryNode(std::string_view control, std::string command) -> mks::IoTask<std::string>
+{
+    auto endpoint = mks::resolveControlEndpoint(control, mks::kServerControlEndpoint);
+    if (!endpoint) {
+        co_return mks::Err(endpoint.error());
+    }
+    if (!*endpoint) {
+        SPDLOG_ERROR("Control socket 'off' cannot be queried");
+        co_return mks::Err(std::make_error_code(std::errc::invalid_argument));
+    }
+
+    auto reply = co_await mks::queryControl(**endpoint, command);
+    if (!reply) {
+        SPDLOG_ERROR("Failed to query control socket {}: {}", **endpoint, reply.error().message());
+        co_return mks::Err(reply.error());
+    }
+    if (!reply->ok) {
+        SPDLOG_ERROR("Control socket {} rejected {}: {}", **endpoint, command, reply->body);
+        co_return mks::Err(std::make_error_code(std::errc::operation_not_supported));
+    }
+    co_return std::move(reply->body);
+}
+
+static auto printStats(std::string_view control) -> mks::IoTask<void>
+{
+    ILIAS_CO_TRY(auto body, co_await queryNode(control, "stats"));
+    std::print("{}", body);
+    co_return {};
+}
+
+static auto printFlightRecorder(const mks::FlightCommand &command) -> mks::IoTask<void>
+{
+    auto path = std::filesystem::path{command.decode};
+    if (path.empty()) {
+        // The node writes the dump itself and replies with its absolute path.
+        ILIAS_CO_TRY(auto dumped, co_await queryNode(command.control, "flight-dump"));
+        path = std::move(dumped);
+    }
+
+    auto dump = mks::readFlightDump(path);
+    if (!dump) {
+        SPDLOG_ERROR("Failed to read flight dump {}: {}", path.string(), dump.error().message());
+        co_return mks::Err(dump.error());
+    }
+    std::println("# {}", path.string());
+    std::print("{}", mks::formatFlightDump(*dump));
+    co_return {};
+}
+
+// Opt-in pipeline trace (--trace-file); written once the role stops, Ctrl-C included.
+static auto startPipelineTrace(const mks::CommonConfig &common, std::string_view role) -> void
+{
+    if (common.traceFile.empty()) {
+        return;
+    }
+    mks::startTracing(common.traceFile, std::string{role});
+    SPDLOG_INFO("Tracing input pipeline to {}", common.traceFile);
+}
+
+static auto finishPipelineTrace(const mks::CommonConfig &common) -> void
+{
+    if (common.traceFile.empty()) {
+        return;
+    }
+    if (auto written = mks::stopTracing(); !written) {
+        SPDLOG_ERROR("Failed to write trace file {}: {}", common.traceFile, written.error().message());
+        return;
+    }
+    SPDLOG_INFO("Trace written to {}", common.traceFile);
+}
+
+// Opt-in scheduling of the calling thread, the one that captures / injects input.
+// False only for options that do not parse; what the OS refuses is logged and skipped.
+static auto tuneInputThread(const mks::CommonConfig &common) -> bool
+{
+    auto policy = mks::parseSchedulingPolicy(common.realtime);
+    if (!policy) {
+        SPDLOG_ERROR("Invalid --realtime '{}', expected off, fifo or rr", common.realtime);
+        return false;
+    }
+    auto cpus = mks::parseCpuList(common.cpuAffinity);
+    if (!cpus) {
+        SPDLOG_ERROR("Invalid --cpu-affinity '{}', expected a list like 2 or 0,2-3", common.cpuAffinity);
+        return false;
+    }
+    (void)mks::applyThreadTuning(mks::ThreadTuning{
+        .policy     = *policy,
+        .priority   = static_cast<int>(common.realtimePriority),
+        .cpus       = std::move(*cpus),
+        .lockMemory = common.lockMemory,
+    });
+    return true;
+}
+
 struct LoadedAppConfig {
     std::filesystem::path path;
     mks::AppConfig        app;
@@ -241,6 +370,208 @@ static auto loadAppConfig(const std::string &configPathText) -> std::optional<Lo
     return LoadedAppConfig{.path = std::move(configPath), .app = std::move(*configResult)};
 }
 
+// Load each library of --plugins; false after the first that fails (the host logged why).
+static auto loadPlugins(mks::PluginHost &host, std::string_view paths) -> bool
+{
+#if defined(_WIN32)
+    constexpr auto separator = ';';
+#else
+    constexpr auto separator = ':';
+#endif
+    while (!paths.empty()) {
+        const auto end  = paths.find(separator);
+        const auto path = paths.substr(0, end);
+        paths           = end == std::string_view::npos ? std::string_view{} : paths.substr(end + 1);
+        if (path.empty()) {
+            continue;
+        }
+        if (!host.load(std::filesystem::path{path})) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// `record` without --listen: events only pass through RecordingCapture, nothing is forwarded.
+static auto recordLocalInput(mks::Platform &platform) -> mks::IoTask<void>
+{
+    auto capture = platform.createCapture();
+    if (!capture) {
+        SPDLOG_ERROR("Current platform does not provide an input capture backend");
+        co_return mks::Err(std::make_error_code(std::errc::operation_not_supported));
+    }
+    ILIAS_CO_TRYV(co_await capture->initialize());
+    auto drain = [](mks::InputCapture &source) -> mks::Task<void> {
+        while (true) {
+            (void)co_await source.nextEvent();
+        }
+    };
+    co_await ilias::finally(drain(*capture), capture->shutdown());
+    co_return {};
+}
+
+static auto runRecord(const mks::RecordCommand &command) -> mks::Task<bool>
+{
+    spdlog::set_level(parseLogLevel(command.common.logLevel));
+    mks::setFlightDumpPath(flightDumpFile("record"));
+    auto opened = mks::InputRecordWriter::open(command.output);
+    if (!opened) {
+        SPDLOG_ERROR("Failed to create recording {}: {}", command.output, opened.error().message());
+        co_return false;
+    }
+    auto writer   = std::make_shared<mks::InputRecordWriter>(std::move(*opened));
+    auto selected = co_await selectRuntimeBackend(command.common,
+                                                  mks::BackendRequirement::Capture);
+    if (!selected) {
+        SPDLOG_ERROR("Failed to select a platform backend for recording: {}",
+                     selected.error().message());
+        co_return false;
+    }
+    auto platform = std::make_shared<mks::RecordingPlatform>(std::move(selected->platform), writer);
+    SPDLOG_INFO("Recording input to {}, Ctrl-C to stop", command.output);
+
+    auto result = mks::IoResult<void>{};
+    if (command.listen.empty()) {
+        auto [recorded, ctrlc] =
+            co_await ilias::whenAny(recordLocalInput(*platform), ilias::signal::ctrlC());
+        (void)ctrlc;
+        if (recorded) {
+            result = std::move(*recorded);
+        }
+    }
+    else {
+        auto endpoint = ilias::IPEndpoint::fromString(command.listen);
+        if (!endpoint) {
+            SPDLOG_ERROR("Invalid endpoint: {}", command.listen);
+            co_return false;
+        }
+        auto loaded = loadAppConfig(command.common.configPath);
+        if (!loaded) {
+            co_return false;
+        }
+        mks::Server server{platform, *endpoint, loaded->app, loaded->path};
+        auto [serverResult, ctrlc] = co_await ilias::whenAny(server.run(), ilias::signal::ctrlC());
+        (void)ctrlc;
+        if (serverResult) {
+            result = std::move(*serverResult);
+        }
+    }
+
+    if (auto flushed = writer->flush(); !flushed) {
+        SPDLOG_ERROR("Failed to write recording {}: {}", command.output, flushed.error().message());
+        co_return false;
+    }
+    SPDLOG_INFO("Recorded {} events to {}", writer->eventCount(), command.output);
+    if (!result) {
+        SPDLOG_ERROR("Recording stopped: {}", result.error().message());
+        co_return false;
+    }
+    co_return true;
+}
+
+static auto waitReplayFinished(const mks::ReplayPlatform &platform) -> mks::Task<void>
+{
+    using namespace std::chrono_literals;
+    while (true) {
+        if (auto capture = platform.capture(); capture && capture->finished()) {
+            co_return;
+        }
+        co_await ilias::sleep(100ms);
+    }
+}
+
+static auto runReplay(const mks::ReplayCommand &command) -> mks::Task<bool>
+{
+    spdlog::set_level(parseLogLevel(command.common.logLevel));
+    mks::setFlightDumpPath(flightDumpFile("replay"));
+    const auto speed = mks::parseReplaySpeed(command.speed);
+    if (!speed) {
+        SPDLOG_ERROR("Invalid replay speed '{}', expected a positive number or 'max'", command.speed);
+        co_return false;
+    }
+    auto endpoint = ilias::IPEndpoint::fromString(command.endpoint);
+    if (!endpoint) {
+        SPDLOG_ERROR("Invalid endpoint: {}", command.endpoint);
+        co_return false;
+    }
+    auto controlEndpoint =
+        mks::resolveControlEndpoint(command.common.control, mks::kServerControlEndpoint);
+    if (!controlEndpoint) {
+        co_return false;
+    }
+    auto loaded = loadAppConfig(command.common.configPath);
+    if (!loaded) {
+        co_return false;
+    }
+
+    // The gate runs inside Server::run, so the server below is alive whenever it is polled.
+    const mks::Server *server = nullptr;
+    auto options = mks::ReplayOptions{.speed = *speed, .loop = command.loop};
+    if (command.waitClients > 0) {
+        options.startGate = [&server, wanted = command.waitClients] {
+            const auto screens = server->topologyScreens();
+            return std::ranges::count_if(screens, [](const auto &screen) { return !screen.local; }) >=
+                   static_cast<std::ptrdiff_t>(wanted);
+        };
+    }
+    auto platform = mks::ReplayPlatform::open(command.input, std::move(options));
+    if (!platform) {
+        SPDLOG_ERROR("Failed to open recording {}: {}", command.input, platform.error().message());
+        co_return false;
+    }
+
+    mks::Server replayServer{*platform, *endpoint, loaded->app, loaded->path};
+    server = &replayServer;
+    mks::ControlService control{*controlEndpoint};
+    startPipelineTrace(command.common, "replay");
+    auto [serverResult, finished, controlResult, ctrlc] = co_await ilias::whenAny(
+        replayServer.run(), waitReplayFinished(**platform), control.run(), ilias::signal::ctrlC());
+    (void)controlResult;
+    (void)ctrlc;
+    finishPipelineTrace(command.common);
+    if (finished) {
+        SPDLOG_INFO("Replay of {} complete", command.input);
+    }
+    if (serverResult && !*serverResult) {
+        SPDLOG_ERROR("Server error: {}", serverResult->error().message());
+        co_return false;
+    }
+    co_return true;
+}
+
+static auto runSend(const mks::SendCommand &command) -> mks::Task<bool>
+{
+    spdlog::set_level(parseLogLevel(command.common.logLevel));
+    auto endpoint = ilias::IPEndpoint::fromString(command.endpoint);
+    if (!endpoint) {
+        SPDLOG_ERROR("Invalid endpoint: {}", command.endpoint);
+        co_return false;
+    }
+    // The server trusts this machine by the id in the shared config.
+    auto loaded = loadAppConfig(command.common.configPath);
+    if (!loaded) {
+        co_return false;
+    }
+
+    auto files = mks::FileTransfers{};
+    auto [sent, ctrlc] = co_await ilias::whenAny(
+        mks::sendFileTo(*endpoint, loaded->app, files, command.path,
+                        mks::FileSendOptions{.replace = !command.keepBoth}),
+        ilias::signal::ctrlC());
+    if (ctrlc) {
+        SPDLOG_WARN("Ctrl-C received, sending again resumes where this stopped");
+        co_return false;
+    }
+    if (!*sent) {
+        SPDLOG_ERROR("Failed to send {}: {}", command.path, sent->error().message());
+        co_return false;
+    }
+    std::println("Sent {}: {} bytes on the wire, {} chunks resumed, {} bytes reused from the "
+                 "server's copy",
+                 command.path, (*sent)->bytes, (*sent)->reusedChunks, (*sent)->reusedBytes);
+    co_return true;
+}
+
 void ilias_main(int argc, char **argv)
 {
     initializeLogging();
@@ -265,26 +596,88 @@ void ilias_main(int argc, char **argv)
         co_return;
     }
 
+    if (const auto *statsCommand = std::get_if<mks::StatsCommand>(&*command)) {
+        if (!co_await printStats(statsCommand->control)) {
+            std::exit(EXIT_FAILURE);
+        }
+        co_return;
+    }
+
+    if (const auto *flightCommand = std::get_if<mks::FlightCommand>(&*command)) {
+        if (!co_await printFlightRecorder(*flightCommand)) {
+            std::exit(EXIT_FAILURE);
+        }
+        co_return;
+    }
+
+    if (const auto *recordCommand = std::get_if<mks::RecordCommand>(&*command)) {
+        if (!co_await runRecord(*recordCommand)) {
+            std::exit(EXIT_FAILURE);
+        }
+        co_return;
+    }
+
+    if (const auto *replayCommand = std::get_if<mks::ReplayCommand>(&*command)) {
+        if (!co_await runReplay(*replayCommand)) {
+            std::exit(EXIT_FAILURE);
+        }
+        co_return;
+    }
+
+    if (const auto *sendCommand = std::get_if<mks::SendCommand>(&*command)) {
+        if (!co_await runSend(*sendCommand)) {
+            std::exit(EXIT_FAILURE);
+        }
+        co_return;
+    }
+
     if (const auto *serverCommand = std::get_if<mks::ServerCommand>(&*command)) {
         spdlog::set_level(parseLogLevel(serverCommand->common.logLevel));
+        mks::setFlightDumpPath(flightDumpFile("server"));
         auto endpoint = ilias::IPEndpoint::fromString(serverCommand->endpoint);
         if (!endpoint) {
             SPDLOG_ERROR("Invalid endpoint: {}", serverCommand->endpoint);
             co_return;
         }
+        auto controlEndpoint =
+            mks::resolveControlEndpoint(serverCommand->common.control, mks::kServerControlEndpoint);
+        if (!controlEndpoint) {
+            co_return;
+        }
         auto loaded = loadAppConfig(serverCommand->common.configPath);
         if (!loaded) {
             co_return;
         }
-        auto selected = co_await selectRuntimeBackend(serverCommand->common.backend,
+        auto selected = co_await selectRuntimeBackend(serverCommand->common,
                                                       mks::BackendRequirement::Capture);
         if (!selected) {
             SPDLOG_ERROR("Failed to select a platform backend for server mode: {}",
                          selected.error().message());
             co_return;
         }
-        mks::Server server{std::move(selected->platform), *endpoint, loaded->app, loaded->path};
-        auto [serverResult, ctrlc] = co_await ilias::whenAny(server.run(), ilias::signal::ctrlC());
+        // Declared before the server, which publishes to them until it is gone.
+        mks::PluginHost       plugins;
+        mks::EventSubscribers subscribers{plugins};
+        if (!loadPlugins(plugins, serverCommand->plugins)) {
+            co_return;
+        }
+        subscribers.setPath(serverCommand->eventSocket);
+        mks::Server         server{std::move(selected->platform), *endpoint, loaded->app, loaded->path};
+        mks::ControlService control{*controlEndpoint};
+        server.setEvents(&plugins);
+        server.setIoThreads(serverCommand->ioThreads);
+        server.setCaptureThread(serverCommand->captureThread);
+        if (!tuneInputThread(serverCommand->common)) {
+            co_return;
+        }
+        startPipelineTrace(serverCommand->common, "server");
+        auto [serverResult, controlResult, events, probe, ctrlc] =
+            co_await ilias::whenAny(server.run(), control.run(), subscribers.run(),
+                                    mks::watchSchedulingDelay(), ilias::signal::ctrlC());
+        (void)controlResult;
+        (void)events;
+        (void)probe;
+        finishPipelineTrace(serverCommand->common);
         if (ctrlc) {
             SPDLOG_WARN("Ctrl-C received, shutting down...");
         }
@@ -297,24 +690,39 @@ void ilias_main(int argc, char **argv)
     }
     else if (const auto *clientCommand = std::get_if<mks::ClientCommand>(&*command)) {
         spdlog::set_level(parseLogLevel(clientCommand->common.logLevel));
+        mks::setFlightDumpPath(flightDumpFile("client"));
         auto endpoint = ilias::IPEndpoint::fromString(clientCommand->endpoint);
         if (!endpoint) {
             SPDLOG_ERROR("Invalid endpoint: {}", clientCommand->endpoint);
             co_return;
         }
+        auto controlEndpoint =
+            mks::resolveControlEndpoint(clientCommand->common.control, mks::kClientControlEndpoint);
+        if (!controlEndpoint) {
+            co_return;
+        }
         auto loaded = loadAppConfig(clientCommand->common.configPath);
         if (!loaded) {
             co_return;
         }
-        auto selected = co_await selectRuntimeBackend(clientCommand->common.backend,
+        auto selected = co_await selectRuntimeBackend(clientCommand->common,
                                                       mks::BackendRequirement::Injection);
         if (!selected) {
             SPDLOG_ERROR("Failed to select a platform backend for client mode: {}",
                          selected.error().message());
             co_return;
         }
-        mks::Client client{std::move(selected->platform), *endpoint, loaded->app};
-        auto [clientResult, ctrlc] = co_await ilias::whenAny(client.run(), ilias::signal::ctrlC());
+        mks::Client         client{std::move(selected->platform), *endpoint, loaded->app};
+        mks::ControlService control{*controlEndpoint};
+        if (!tuneInputThread(clientCommand->common)) {
+            co_return;
+        }
+        startPipelineTrace(clientCommand->common, "client");
+        auto [clientResult, controlResult, probe, ctrlc] = co_await ilias::whenAny(
+            client.run(), control.run(), mks::watchSchedulingDelay(), ilias::signal::ctrlC());
+        (void)controlResult;
+        (void)probe;
+        finishPipelineTrace(clientCommand->common);
         if (ctrlc) {
             SPDLOG_WARN("Ctrl-C received, shutting down...");
         }
@@ -1,7 +1,10 @@
 #include "backend.hpp"
+#include "diag/metrics.hpp"
 
 #include <algorithm>
+#include <ilias/task.hpp>
 #include <mutex>
+#include <optional>
 #include <system_error>
 #include <utility>
 
@@ -48,6 +51,71 @@ namespace
         }
         return *it;
     }
+
+    auto backendErrors() -> Counter &
+    {
+        static auto &counter = metrics().counter("backend.errors");
+        return counter;
+    }
+
+    auto runCheck(const BackendDescriptor &descriptor, BackendProbe probe) -> Task<BackendCheck>
+    {
+        const auto capabilitiesOnly =
+            probe == BackendProbe::Capabilities && descriptor.capabilities != nullptr;
+        try {
+            auto check  = co_await (capabilitiesOnly ? descriptor.capabilities() : descriptor.check());
+            check.probe = capabilitiesOnly ? BackendProbe::Capabilities : BackendProbe::Full;
+            co_return check;
+        }
+        catch (const std::exception &error) {
+            backendErrors().add();
+            co_return unavailableCheck(error.what());
+        }
+    }
+
+    // One task per backend under a scope: probes mostly wait on display
+    // servers and D-Bus, so running them side by side bounds startup by the
+    // slowest backend instead of the sum.
+    auto runChecks(const std::vector<BackendDescriptor> &descriptors, BackendProbe probe)
+        -> Task<std::vector<BackendCheck>>
+    {
+        auto checks = std::vector<BackendCheck>(descriptors.size());
+        co_await ilias::TaskScope::enter([&](auto &scope) -> Task<void> {
+            for (auto index = size_t{0}; index < descriptors.size(); ++index) {
+                scope.spawn([](const BackendDescriptor &descriptor, BackendProbe probe,
+                               BackendCheck &out) -> Task<void> {
+                    out = co_await runCheck(descriptor, probe);
+                }(descriptors[index], probe, checks[index]));
+            }
+            co_return;
+        });
+        co_return checks;
+    }
+
+    // Turns a finished check into a selection, reusing the probed platform.
+    auto selectChecked(const BackendDescriptor &descriptor, BackendRequirement requirements,
+                       BackendCheck check) -> std::optional<PlatformSelection>
+    {
+        if (!check.supports(requirements)) {
+            SPDLOG_INFO("Platform backend '{}' is not suitable: {}", descriptor.name, check.detail);
+            return std::nullopt;
+        }
+        auto platform = std::move(check.platform);
+        if (!platform) {
+            platform = descriptor.create();
+        }
+        if (!platform) {
+            backendErrors().add();
+            SPDLOG_WARN("Platform backend '{}' passed check but creation failed", descriptor.name);
+            return std::nullopt;
+        }
+        SPDLOG_INFO("Selected platform backend '{}' ({})", descriptor.name, descriptor.displayName);
+        return PlatformSelection{
+            .platform   = std::move(platform),
+            .descriptor = descriptor,
+            .check      = std::move(check),
+        };
+    }
 } // namespace
 
 auto BackendCheck::supports(BackendRequirement requirements) const -> bool
@@ -94,38 +162,48 @@ auto registeredBackends() -> std::vector<BackendDescriptor>
     return result;
 }
 
-auto checkBackend(std::string_view name) -> Task<BackendCheck>
+auto checkBackend(std::string_view name, BackendProbe probe) -> Task<BackendCheck>
 {
     const auto descriptor = findBackend(name);
     if (!descriptor) {
         co_return unavailableCheck(fmtlib::format("Unknown backend '{}'", name));
     }
-    try {
-        co_return co_await descriptor->check();
-    }
-    catch (const std::exception &error) {
-        co_return unavailableCheck(error.what());
-    }
+    co_return co_await runCheck(*descriptor, probe);
 }
 
-auto checkBackends() -> Task<std::vector<CheckedBackend>>
+auto checkBackends(BackendProbe probe) -> Task<std::vector<CheckedBackend>>
 {
-    auto result = std::vector<CheckedBackend>{};
-    for (const auto &descriptor : registeredBackends()) {
+    const auto descriptors = registeredBackends();
+    auto       checks      = co_await runChecks(descriptors, probe);
+    auto       result      = std::vector<CheckedBackend>{};
+    result.reserve(descriptors.size());
+    for (auto index = size_t{0}; index < descriptors.size(); ++index) {
         result.push_back(CheckedBackend{
-            .descriptor = descriptor,
-            .check      = co_await checkBackend(descriptor.name),
+            .descriptor = descriptors[index],
+            .check      = std::move(checks[index]),
         });
     }
     co_return result;
 }
 
-auto selectBackend(std::string_view name, BackendRequirement requirements)
-    -> IoTask<PlatformSelection>
+auto selectBackend(std::string_view name, BackendRequirement requirements,
+                   std::string_view preferred) -> IoTask<PlatformSelection>
 {
     auto candidates = std::vector<BackendDescriptor>{};
     if (name.empty() || name == "auto") {
         candidates = registeredBackends();
+        const auto it = std::ranges::find(candidates, preferred, &BackendDescriptor::name);
+        if (!preferred.empty() && it != candidates.end()) {
+            const auto descriptor = *it;
+            auto       check      = co_await runCheck(descriptor, BackendProbe::Full);
+            if (auto selection = selectChecked(descriptor, requirements, std::move(check))) {
+                co_return std::move(*selection);
+            }
+            // Already fully probed; the usual pass only needs the others.
+            SPDLOG_INFO("Preferred platform backend '{}' is no longer suitable, probing all",
+                        descriptor.name);
+            candidates.erase(it);
+        }
     }
     else if (const auto descriptor = findBackend(name)) {
         candidates.push_back(*descriptor);
@@ -135,23 +213,19 @@ auto selectBackend(std::string_view name, BackendRequirement requirements)
         co_return Err(std::make_error_code(std::errc::no_such_device));
     }
 
-    for (const auto &descriptor : candidates) {
-        auto check = co_await checkBackend(descriptor.name);
-        if (!check.supports(requirements)) {
-            SPDLOG_INFO("Platform backend '{}' is not suitable: {}", descriptor.name, check.detail);
-            continue;
+    // Cheap checks first, all at once; backends without a capability check
+    // are fully probed here already.
+    auto checks = co_await runChecks(candidates, BackendProbe::Capabilities);
+    for (auto index = size_t{0}; index < candidates.size(); ++index) {
+        const auto &descriptor = candidates[index];
+        auto        check      = std::move(checks[index]);
+        if (check.supports(requirements) && check.probe == BackendProbe::Capabilities) {
+            check = co_await runCheck(descriptor, BackendProbe::Full);
         }
-        auto platform = descriptor.create();
-        if (!platform) {
-            SPDLOG_WARN("Platform backend '{}' passed check but creation failed", descriptor.name);
-            continue;
+        // Later candidates' probed platforms are released with `checks`.
+        if (auto selection = selectChecked(descriptor, requirements, std::move(check))) {
+            co_return std::move(*selection);
         }
-        SPDLOG_INFO("Selected platform backend '{}' ({})", descriptor.name, descriptor.displayName);
-        co_return PlatformSelection{
-            .platform   = std::move(platform),
-            .descriptor = descriptor,
-            .check      = std::move(check),
-        };
     }
 
     co_return Err(std::make_error_code(std::errc::operation_not_supported));
@@ -166,6 +240,7 @@ auto probeBackend(std::string_view displayName, BackendDescriptor::CreateFn crea
         platform = create();
     }
     catch (const std::exception &error) {
+        backendErrors().add();
         co_return unavailableCheck(error.what());
     }
     if (!platform) {
@@ -218,7 +293,21 @@ auto probeBackend(std::string_view displayName, BackendDescriptor::CreateFn crea
         result.injection.detail = error.what();
     }
 
+    result.platform = std::move(platform);
     co_return result;
 }
 
+auto assumedBackendCheck(std::string detail) -> BackendCheck
+{
+    const auto unverified = BackendFeatureCheck{.supported = true, .detail = "Not probed yet"};
+    return BackendCheck{
+        .available = true,
+        .detail    = std::move(detail),
+        .screens   = unverified,
+        .capture   = unverified,
+        .injection = unverified,
+        .probe     = BackendProbe::Capabilities,
+    };
+}
+
 MKS_END
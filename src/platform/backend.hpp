@@ -30,6 +30,14 @@ constexpr auto operator&(BackendRequirement left, BackendRequirement right) -> B
                                            static_cast<uint8_t>(right));
 }
 
+enum class BackendProbe : uint8_t
+{
+    // Environment and service discovery only; opens no display connection or session.
+    Capabilities,
+    // Constructs the platform and initializes each public interface.
+    Full,
+};
+
 struct BackendFeatureCheck {
     bool        supported = false;
     std::string detail;
@@ -41,6 +49,10 @@ struct BackendCheck {
     BackendFeatureCheck screens;
     BackendFeatureCheck capture;
     BackendFeatureCheck injection;
+    BackendProbe        probe = BackendProbe::Full;
+    // Platform built by a full probe. selectBackend() hands it over instead of
+    // opening the backend a second time; null when the probe built none.
+    Platform::Ptr       platform;
 
     auto supports(BackendRequirement requirements) const -> bool;
 };
@@ -54,6 +66,9 @@ struct BackendDescriptor {
     uint32_t         order  = 0;
     CheckFn          check  = nullptr;
     CreateFn         create = nullptr;
+    // Optional BackendProbe::Capabilities check. Backends without one always
+    // run the full check.
+    CheckFn          capabilities = nullptr;
 };
 
 struct CheckedBackend {
@@ -73,15 +88,26 @@ public:
 };
 
 auto registeredBackends() -> std::vector<BackendDescriptor>;
-auto checkBackend(std::string_view name) -> Task<BackendCheck>;
-auto checkBackends() -> Task<std::vector<CheckedBackend>>;
-auto selectBackend(std::string_view name, BackendRequirement requirements)
-    -> IoTask<PlatformSelection>;
+auto checkBackend(std::string_view name, BackendProbe probe = BackendProbe::Full)
+    -> Task<BackendCheck>;
+// Checks every registered backend concurrently; results keep registry order.
+auto checkBackends(BackendProbe probe = BackendProbe::Full) -> Task<std::vector<CheckedBackend>>;
+// Runs capability checks for all candidates at once, then fully probes them in
+// preference order and keeps the first suitable platform the probe built.
+// For automatic selection, @p preferred (e.g. the backend cached for this
+// session) is fully probed first and the rest only run if it is unsuitable.
+auto selectBackend(std::string_view name, BackendRequirement requirements,
+                   std::string_view preferred = {}) -> IoTask<PlatformSelection>;
 
 // Shared implementation for backends whose check consists of constructing the
 // backend and initializing each public interface. A backend may wrap or replace
-// this to apply stricter rules.
+// this to apply stricter rules. The constructed platform is returned in
+// BackendCheck::platform, so @p create must build one fit for real use.
 auto probeBackend(std::string_view displayName, BackendDescriptor::CreateFn create)
     -> Task<BackendCheck>;
 
+// Capability-check result for a backend nothing has ruled out yet: every
+// feature is reported as supported but unverified, and the full probe decides.
+auto assumedBackendCheck(std::string detail) -> BackendCheck;
+
 MKS_END
@@ -3,6 +3,10 @@
 #include "preinclude.hpp"
 #include <ilias/task.hpp>
 #include <ilias/io.hpp>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <optional>
 #include <variant>
 #include <format>
 #include <system_error>
@@ -28,6 +32,19 @@ public:
     
     virtual auto setRemoteControlActive(bool active) -> IoResult<void> = 0;
     virtual auto moveLocalCursor(uint32_t screenIndex, int32_t x, int32_t y) -> IoResult<void> = 0;
+
+    /**
+     * @brief Read and translate events on a thread of the capture's own.
+     *
+     * @ref nextEvent then only takes translated events off a queue, so a
+     * busy event loop no longer leaves them unread at the source. Call
+     * before @ref initialize. The default supports no such thread.
+     *
+     * @return false when the backend captures on the calling thread only.
+     */
+    virtual auto setDedicatedThread(bool enabled) -> bool {
+        return !enabled;
+    }
 };
 
 class InputInjector {
@@ -39,6 +56,75 @@ public:
     virtual auto initialize() -> IoTask<void> = 0;
     virtual auto shutdown() -> Task<void> = 0;
     virtual auto inject(const InputEvent &event) -> IoTask<void> = 0;
+
+    /**
+     * @brief Inject without suspending, when the backend can do so right now.
+     *
+     * Per-event callers try this first to skip the coroutine frame of
+     * @ref inject. nullopt means the event needs to wait (e.g. the display
+     * socket is full): call @ref inject with the same event next, which may
+     * pick up where this left off. The default always defers.
+     */
+    virtual auto tryInject(const InputEvent &event) -> std::optional<IoResult<void>> {
+        (void) event;
+        return std::nullopt;
+    }
+};
+
+/**
+ * @brief The system clipboard, shared lazily
+ *
+ * Only advertisements move eagerly: @ref nextOffer reports a local copy by
+ * its formats and hash, and @ref publish makes a remote offer pasteable here
+ * without any of its bytes. A local paste then pulls just the requested
+ * format through the @c Fetch handed to @ref publish.
+ */
+class Clipboard {
+public:
+    using Ptr = std::shared_ptr<Clipboard>;
+    /** @brief Bytes of the published offer in the given mime, usually from the network. */
+    using Fetch = std::function<IoTask<std::vector<std::byte>>(std::string mime)>;
+
+    virtual ~Clipboard() = default;
+
+    virtual auto initialize() -> IoTask<void> = 0;
+    virtual auto shutdown() -> Task<void> = 0;
+
+    /**
+     * @brief Wait for the next local copy.
+     *
+     * Ownership taken through @ref publish is not reported, so a forwarded
+     * offer does not bounce back to its sender.
+     */
+    virtual auto nextOffer() -> IoTask<ClipboardOffer> = 0;
+
+    /** @brief Bytes of the last offer returned by @ref nextOffer in @p mime. */
+    virtual auto read(std::string mime) -> IoTask<std::vector<std::byte>> = 0;
+
+    /** @brief Take the local clipboard with a remote @p offer served by @p fetch. */
+    virtual auto publish(ClipboardOffer offer, Fetch fetch) -> IoResult<void> = 0;
+};
+
+/**
+ * @brief Files of a drag-and-drop in progress on this machine
+ *
+ * Asked when a held button carries the cursor off the local screens. Only
+ * reads what the dragging application offers; the drop itself is left to
+ * the local drag machinery, which sees the button come up as usual.
+ */
+class DragSource {
+public:
+    using Ptr = std::shared_ptr<DragSource>;
+
+    virtual ~DragSource() = default;
+
+    /**
+     * @brief Local files being dragged right now.
+     *
+     * Empty when nothing is dragged, or the drag carries no local files
+     * (text, remote URIs).
+     */
+    virtual auto draggedFiles() -> IoTask<std::vector<std::filesystem::path>> = 0;
 };
 
 /**
@@ -55,6 +141,39 @@ public:
     virtual auto createCapture() -> InputCapture::Ptr = 0;
     virtual auto createInjector() -> InputInjector::Ptr = 0;
 
+    /**
+     * @brief Wait until the screen layout differs from @p known.
+     *
+     * Returns the new layout, which the caller passes back in as @p known for
+     * the next change. Backends with a native notification (RandR) override
+     * this; the default polls @ref screens(), which is enough for backends
+     * that already refresh their cached layout from their own event loop.
+     */
+    virtual auto nextScreenChange(std::vector<ScreenInfo> known) -> IoTask<ScreenChangeEvent> {
+        using namespace std::chrono_literals;
+        while (true) {
+            auto current = screens();
+            if (current != known) {
+                co_return ScreenChangeEvent {.screens = std::move(current)};
+            }
+            co_await ilias::sleep(500ms);
+        }
+    }
+
+    /**
+     * @brief Clipboard sharing for this backend, or null when it has none.
+     */
+    virtual auto createClipboard() -> Clipboard::Ptr {
+        return nullptr;
+    }
+
+    /**
+     * @brief Local file drags for this backend, or null when it cannot read them.
+     */
+    virtual auto createDragSource() -> DragSource::Ptr {
+        return nullptr;
+    }
+
     /**
      * @brief Create current compiled platform
      * 
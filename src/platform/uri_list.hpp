@@ -0,0 +1,94 @@
+#pragma once
+
+#include "preinclude.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+MKS_BEGIN
+
+namespace detail
+{
+
+    constexpr auto hexValue(char c) -> int
+    {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+} // namespace detail
+
+// Percent-decodes one URI component; nullopt on a malformed escape or an
+// embedded NUL, which no local path can hold.
+inline auto percentDecode(std::string_view text) -> std::optional<std::string>
+{
+    auto result = std::string{};
+    result.reserve(text.size());
+    for (auto index = size_t{0}; index < text.size(); ++index) {
+        if (text[index] != '%') {
+            result.push_back(text[index]);
+            continue;
+        }
+        if (index + 2 >= text.size()) {
+            return std::nullopt;
+        }
+        const auto high = detail::hexValue(text[index + 1]);
+        const auto low  = detail::hexValue(text[index + 2]);
+        if (high < 0 || low < 0 || (high == 0 && low == 0)) {
+            return std::nullopt;
+        }
+        result.push_back(static_cast<char>(high * 16 + low));
+        index += 2;
+    }
+    return result;
+}
+
+// Local files named by a text/uri-list (RFC 2483), as file managers put them
+// on a drag or copy. Comments, blank lines, other schemes and files on other
+// hosts are skipped.
+inline auto parseFileUriList(std::string_view list) -> std::vector<std::filesystem::path>
+{
+    using namespace std::string_view_literals;
+
+    auto result = std::vector<std::filesystem::path>{};
+    while (!list.empty()) {
+        const auto end  = list.find('\n');
+        auto       line = list.substr(0, end);
+        list            = end == std::string_view::npos ? std::string_view{} : list.substr(end + 1);
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+            line.remove_suffix(1);
+        }
+        if (line.empty() || line.front() == '#' || !line.starts_with("file://"sv)) {
+            continue;
+        }
+        // file://host/path: only an empty host or localhost is this machine.
+        auto       rest  = line.substr(7);
+        const auto slash = rest.find('/');
+        if (slash == std::string_view::npos) {
+            continue;
+        }
+        const auto host = rest.substr(0, slash);
+        if (!host.empty() && host != "localhost"sv) {
+            continue;
+        }
+        auto path = percentDecode(rest.substr(slash));
+        if (!path) {
+            continue;
+        }
+        result.emplace_back(std::move(*path));
+    }
+    return result;
+}
+
+MKS_END
@@ -33,6 +33,7 @@
     #include <spdlog/spdlog.h>
 
     #include "backend.hpp"
+    #include "diag/probes.hpp"
     #include "platform.hpp"
     #include "wayland_keymap.hpp"
 
@@ -177,6 +178,28 @@ public:
     auto createCapture() -> InputCapture::Ptr override;
     auto createInjector() -> InputInjector::Ptr override;
 
+    // Nothing else reads the display socket after construction, so output
+    // hot-plug and mode events sit queued until this drains them. A burst is
+    // completed with a roundtrip before it is compared, so half-applied
+    // geometry (mode without xdg-output size) is never reported.
+    auto nextScreenChange(std::vector<ScreenInfo> known) -> IoTask<ScreenChangeEvent> override
+    {
+        using namespace std::chrono_literals;
+        while (true) {
+            ILIAS_CO_TRYV(dispatchQueuedEvents());
+            const auto attached = attachXdgOutputs();
+            if (attached || screens() != known) {
+                if (wl_display_roundtrip(mDisplay) < 0) {
+                    co_return Err(displayError());
+                }
+                if (auto current = screens(); current != known) {
+                    co_return ScreenChangeEvent{.screens = std::move(current)};
+                }
+            }
+            co_await ilias::sleep(1s);
+        }
+    }
+
     auto display() const -> wl_display * { return mDisplay; }
 
     auto seat() const -> wl_seat * { return mSeat; }
@@ -279,6 +302,30 @@ private:
         }
     }
 
+    // Read whatever the compositor already sent without blocking.
+    auto dispatchQueuedEvents() -> IoResult<void>
+    {
+        while (wl_display_prepare_read(mDisplay) != 0) {
+            if (wl_display_dispatch_pending(mDisplay) < 0) {
+                return Err(displayError());
+            }
+        }
+        (void)wl_display_flush(mDisplay);
+        auto descriptor = pollfd{.fd = wl_display_get_fd(mDisplay), .events = POLLIN, .revents = 0};
+        if (::poll(&descriptor, 1, 0) > 0 && (descriptor.revents & POLLIN) != 0) {
+            if (wl_display_read_events(mDisplay) < 0) {
+                return Err(displayError());
+            }
+        }
+        else {
+            wl_display_cancel_read(mDisplay);
+        }
+        if (wl_display_dispatch_pending(mDisplay) < 0) {
+            return Err(displayError());
+        }
+        return {};
+    }
+
     auto displayError() const -> std::error_code
     {
         const auto error = wl_display_get_error(mDisplay);
@@ -335,23 +382,27 @@ private:
         };
     }
 
-    auto attachXdgOutput(Output &output) -> void
+    auto attachXdgOutput(Output &output) -> bool
     {
         if (!mXdgOutputManager || output.xdgObject) {
-            return;
+            return false;
         }
         output.xdgObject = zxdg_output_manager_v1_get_xdg_output(mXdgOutputManager, output.object);
         if (!output.xdgObject ||
             zxdg_output_v1_add_listener(output.xdgObject, &kXdgOutputListener, &output) != 0) {
             throw std::runtime_error("Failed to create xdg-output object");
         }
+        return true;
     }
 
-    auto attachXdgOutputs() -> void
+    // True when an output got its xdg-output object just now.
+    auto attachXdgOutputs() -> bool
     {
+        auto attached = false;
         for (auto &output : mOutputs) {
-            attachXdgOutput(*output);
+            attached = attachXdgOutput(*output) || attached;
         }
+        return attached;
     }
 
     static auto destroyOutput(Output &output) -> void
@@ -630,21 +681,32 @@ public:
 
     auto inject(const InputEvent &event) -> IoTask<void> override
     {
-        if (!mVirtualPointer || !mVirtualKeyboard || !mPoller) {
-            co_return Err(makeIoError(std::errc::not_connected));
-        }
-
-        auto error = std::error_code{};
-        std::visit([&](const auto &value) { error = injectOne(value); }, event);
-        if (error) {
-            SPDLOG_WARN("Wayland failed to queue input event {}: {}", event, error.message());
-            co_return Err(error);
+        // A deferred tryInject() already queued this event; only the flush is left.
+        if (!std::exchange(mFlushPending, false)) {
+            ILIAS_CO_TRYV(queue(event));
         }
         ILIAS_CO_TRYV(co_await flush());
         SPDLOG_TRACE("Wayland injected input event {}", event);
         co_return {};
     }
 
+    // Requests are queued locally; only a full display socket makes us wait.
+    auto tryInject(const InputEvent &event) -> std::optional<IoResult<void>> override
+    {
+        if (auto queued = queue(event); !queued) {
+            return queued;
+        }
+        if (wl_display_flush(mPlatform->display()) >= 0) {
+            SPDLOG_TRACE("Wayland injected input event {}", event);
+            return IoResult<void>{};
+        }
+        if (errno != EAGAIN) {
+            return Err(systemError());
+        }
+        mFlushPending = true;
+        return std::nullopt;
+    }
+
 private:
     auto close() -> void
     {
@@ -664,6 +726,23 @@ private:
         mXkbContext.reset();
     }
 
+    auto queue(const InputEvent &event) -> IoResult<void>
+    {
+        if (!mVirtualPointer || !mVirtualKeyboard || !mPoller) {
+            return Err(makeIoError(std::errc::not_connected));
+        }
+
+        auto error = std::error_code{};
+        MKS_PROBE1(inject_begin, event.index());
+        std::visit([&](const auto &value) { error = injectOne(value); }, event);
+        MKS_PROBE2(inject_end, event.index(), error.value());
+        if (error) {
+            SPDLOG_WARN("Wayland failed to queue input event {}: {}", event, error.message());
+            return Err(error);
+        }
+        return {};
+    }
+
     auto flush() -> IoTask<void>
     {
         while (true) {
@@ -869,6 +948,8 @@ private:
     uint32_t                         mCtrlMask  = 0;
     uint32_t                         mAltMask   = 0;
     uint32_t                         mLogoMask  = 0;
+    // tryInject() queued an event but the socket was full; inject() finishes it.
+    bool                             mFlushPending = false;
 };
 
 auto WaylandPlatform::createCapture() -> InputCapture::Ptr
@@ -904,6 +985,8 @@ auto createWaylandPlatform() -> Platform::Ptr
 
 namespace
 {
+    // Quiet about compositor limitations: the check reports them as feature
+    // details, and selectBackend() may keep this platform for real use.
     auto createWaylandPlatformForCheck() -> Platform::Ptr
     {
         try {
@@ -920,13 +1003,37 @@ namespace
         co_return co_await probeBackend("Wayland wlroots protocols", createWaylandPlatformForCheck);
     }
 
+    // Opens no compositor connection: only looks for a Wayland session.
+    auto waylandCapabilities() -> Task<BackendCheck>
+    {
+        const auto *display     = std::getenv("WAYLAND_DISPLAY");
+        const auto *socket      = std::getenv("WAYLAND_SOCKET");
+        const auto *sessionType = std::getenv("XDG_SESSION_TYPE");
+        const auto  hasDisplay  = (display && *display) || (socket && *socket);
+        if (!hasDisplay && (!sessionType || std::string_view{sessionType} != "wayland")) {
+            const auto missing =
+                BackendFeatureCheck{.supported = false, .detail = "Wayland session unavailable"};
+            co_return BackendCheck{
+                .available = false,
+                .detail    = "Not running in a Wayland session",
+                .screens   = missing,
+                .capture   = missing,
+                .injection = missing,
+                .probe     = BackendProbe::Capabilities,
+            };
+        }
+        co_return assumedBackendCheck(
+            fmtlib::format("WAYLAND_DISPLAY={}", display && *display ? display : "<default>"));
+    }
+
     const BackendRegistration kWaylandBackendRegistration{
         BackendDescriptor{
                           .name        = "wayland-wlr",
                           .displayName = "Wayland (wlroots protocols)",
                           .order       = 100,
-                          .check       = checkWaylandBackend,
-                          .create      = createWaylandPlatform,
+                          .check        = checkWaylandBackend,
+                          .create       = createWaylandPlatform,
+                          .capabilities = waylandCapabilities,
                           }
     };
 } // namespace
@@ -31,6 +31,7 @@
     #include <spdlog/spdlog.h>
 
     #include "backend.hpp"
+    #include "diag/probes.hpp"
     #include "platform.hpp"
     #include "wayland_keymap.hpp"
 
@@ -1064,23 +1065,28 @@ public:
         co_return;
     }
 
-    auto inject(const InputEvent &event) -> IoTask<void> override
+    auto inject(const InputEvent &event) -> IoTask<void> override { co_return *tryInject(event); }
+
+    // libei buffers frames itself and ei_dispatch() does not block.
+    auto tryInject(const InputEvent &event) -> std::optional<IoResult<void>> override
     {
         if (!mEi || !ready()) {
-            co_return Err(makeIoError(std::errc::not_connected));
+            return Err(makeIoError(std::errc::not_connected));
         }
         dispatchEi();
         if (mDisconnected) {
-            co_return Err(makeIoError(std::errc::connection_reset));
+            return Err(makeIoError(std::errc::connection_reset));
         }
 
         auto error = std::error_code{};
+        MKS_PROBE1(inject_begin, event.index());
         std::visit([&](const auto &value) { error = injectOne(value); }, event);
+        MKS_PROBE2(inject_end, event.index(), error.value());
         if (error) {
-            co_return Err(error);
+            return Err(error);
         }
         ei_dispatch(mEi);
-        co_return {};
+        return IoResult<void>{};
     }
 
 private:
@@ -24,6 +24,7 @@
 #include <spdlog/spdlog.h>
 
 #include "backend.hpp"
+#include "diag/probes.hpp"
 #include "platform.hpp"
 #include "win32_key.hpp"
 
@@ -873,22 +874,29 @@ public:
     }
 
     auto inject(const InputEvent &event) -> IoTask<void> override {
+        co_return *tryInject(event);
+    }
+
+    // SendInput / SetCursorPos never wait, so every event takes the fast path.
+    auto tryInject(const InputEvent &event) -> std::optional<IoResult<void>> override {
         if (!mInitialized.load(std::memory_order_acquire)) {
-            co_return Err(std::make_error_code(std::errc::not_connected));
+            return Err(std::make_error_code(std::errc::not_connected));
         }
 
         SPDLOG_TRACE("Win32 injecting event {}", event);
         auto error = std::error_code {};
+        MKS_PROBE1(inject_begin, event.index());
         std::visit([&](const auto &value) {
             error = injectOne(value);
         }, event);
+        MKS_PROBE2(inject_end, event.index(), error.value());
 
         if (error) {
             SPDLOG_WARN("Win32 failed to inject event {}: {}", event, error.message());
-            co_return Err(error);
+            return Err(error);
         }
         SPDLOG_TRACE("Win32 injected event {}", event);
-        co_return {};
+        return IoResult<void> {};
     }
 
 private:
@@ -5,22 +5,35 @@
     #include <X11/XF86keysym.h>
     #include <X11/keysym.h>
     #include <poll.h>
+    #include <sched.h>
+    #include <sys/eventfd.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
     #include <xcb/randr.h>
     #include <xcb/xcb.h>
     #include <xcb/xcb_keysyms.h>
+    #include <xcb/xfixes.h>
     #include <xcb/xinput.h>
     #include <xcb/xtest.h>
 
     #include <algorithm>
+    #include <atomic>
+    #include <cerrno>
+    #include <chrono>
     #include <cmath>
     #include <cstdlib>
+    #include <deque>
     #include <limits>
+    #include <map>
     #include <memory>
     #include <mutex>
     #include <optional>
+    #include <span>
     #include <string>
     #include <string_view>
     #include <system_error>
+    #include <thread>
     #include <utility>
     #include <vector>
 
@@ -29,11 +42,17 @@
     #include <spdlog/spdlog.h>
 
     #include "backend.hpp"
+    #include "core/spsc_ring.hpp"
+    #include "diag/metrics.hpp"
+    #include "diag/probes.hpp"
     #include "platform.hpp"
+    #include "uri_list.hpp"
     #include "xcb_connection.hpp"
 
 MKS_BEGIN
 
+class XcbClipboard;
+class XcbDragSource;
 class XcbInputCapture;
 class XcbInputInjector;
 class XcbPlatform;
@@ -111,6 +130,82 @@ namespace
                static_cast<double>(value.frac) / kFractionScale;
     }
 
+    // Translated events the capture thread may run ahead of the routing loop,
+    // and how long it waits before retrying a push into a full ring.
+    constexpr auto kCaptureRingDepth = size_t{1024};
+    constexpr auto kCaptureRingRetry = std::chrono::milliseconds{1};
+
+    struct CaptureMetrics {
+        Histogram &queuedNs;
+        Counter   &ringFull;
+    };
+
+    auto captureMetrics() -> CaptureMetrics &
+    {
+        static auto result = CaptureMetrics{
+            // Read off the socket to taken off the ring by the routing loop.
+            .queuedNs = metrics().histogram("xcb.capture.queued_ns"),
+            .ringFull = metrics().counter("xcb.capture.ring_full"),
+        };
+        return result;
+    }
+
+    auto signalEventFd(int fd) -> void
+    {
+        const auto one = uint64_t{1};
+        // Only fails once the counter is near overflow, when it is readable anyway.
+        (void)::write(fd, &one, sizeof one);
+    }
+
+    auto drainEventFd(int fd) -> void
+    {
+        auto count = uint64_t{0};
+        (void)::read(fd, &count, sizeof count);
+    }
+
+    // Scheduling of the thread that starts a helper. Helpers start at normal
+    // priority (SCHED_RESET_ON_FORK); the capture thread takes this back on.
+    struct ThreadScheduling {
+        int         policy = SCHED_OTHER;
+        sched_param param{};
+        int         nice = 0;
+    };
+
+    auto currentThreadId() -> id_t
+    {
+        return static_cast<id_t>(::syscall(SYS_gettid));
+    }
+
+    auto callerScheduling() -> ThreadScheduling
+    {
+        auto scheduling   = ThreadScheduling{};
+        scheduling.policy = ::sched_getscheduler(0) & ~SCHED_RESET_ON_FORK;
+        (void)::sched_getparam(0, &scheduling.param);
+        errno           = 0;
+        scheduling.nice = ::getpriority(PRIO_PROCESS, currentThreadId());
+        if (errno != 0) {
+            scheduling.nice = 0;
+        }
+        return scheduling;
+    }
+
+    auto adoptScheduling(const ThreadScheduling &scheduling) -> void
+    {
+        if (scheduling.policy == SCHED_FIFO || scheduling.policy == SCHED_RR) {
+            if (::sched_setscheduler(0, scheduling.policy | SCHED_RESET_ON_FORK,
+                                     &scheduling.param) != 0) {
+                SPDLOG_WARN("XInput2 capture thread left at normal priority: {}",
+                            std::error_code(errno, std::generic_category()).message());
+            }
+            return;
+        }
+        if (scheduling.nice < 0 &&
+            ::setpriority(PRIO_PROCESS, currentThreadId(), scheduling.nice) != 0) {
+            SPDLOG_WARN("XInput2 capture thread left at nice 0: {}",
+                        std::error_code(errno, std::generic_category()).message());
+        }
+    }
+
 } // namespace
 
 struct XcbScreen {
@@ -145,6 +240,14 @@ public:
         enumerateScreens();
     }
 
+    ~XcbPlatform() override
+    {
+        if (mScreenPoller) {
+            auto ignored = mScreenPoller.cancel();
+            mScreenPoller.close();
+        }
+    }
+
     auto screens() const -> std::vector<ScreenInfo> override
     {
         auto                    lock = std::scoped_lock(mScreenMutex);
@@ -228,8 +331,82 @@ public:
 
     auto createCapture() -> InputCapture::Ptr override;
     auto createInjector() -> InputInjector::Ptr override;
+    auto createClipboard() -> Clipboard::Ptr override;
+    auto createDragSource() -> DragSource::Ptr override;
+
+    auto nextScreenChange(std::vector<ScreenInfo> known) -> IoTask<ScreenChangeEvent> override
+    {
+        if (!mScreenPoller && !mScreenEventsUnavailable) {
+            if (auto selected = co_await selectScreenEvents(); !selected) {
+                SPDLOG_WARN("RandR screen notifications unavailable ({}); polling the layout instead",
+                            selected.error().message());
+                mScreenEventsUnavailable = true;
+            }
+        }
+        if (mScreenEventsUnavailable) {
+            co_return co_await Platform::nextScreenChange(std::move(known));
+        }
+
+        // The platform connection only serves layout queries, so its event
+        // queue holds nothing but the RandR notifications selected below.
+        auto changed = screens() != known;
+        while (true) {
+            while (auto *rawEvent = xcb_poll_for_event(mConnection->get())) {
+                XcbPtr<xcb_generic_event_t> event{rawEvent};
+                changed = handleScreenEvent(event.get()) || changed;
+            }
+            if (xcb_connection_has_error(mConnection->get()) != 0) {
+                co_return Err(makeIoError(std::errc::connection_reset));
+            }
+            if (changed) {
+                enumerateScreens();
+                if (auto current = screens(); current != known) {
+                    co_return ScreenChangeEvent{.screens = std::move(current)};
+                }
+                changed = false;
+            }
+
+            ILIAS_CO_TRY(auto revents, co_await mScreenPoller.poll(POLLIN));
+            if ((revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
+                co_return Err(makeIoError(std::errc::connection_reset));
+            }
+        }
+    }
 
 private:
+    auto selectScreenEvents() -> IoTask<void>
+    {
+        const auto *extension = xcb_get_extension_data(mConnection->get(), &xcb_randr_id);
+        if (!extension || extension->present == 0) {
+            co_return Err(makeIoError(std::errc::function_not_supported));
+        }
+        ILIAS_CO_TRYV(mConnection->check(xcb_randr_select_input_checked(
+            mConnection->get(), mRoot,
+            XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE | XCB_RANDR_NOTIFY_MASK_OUTPUT_CHANGE |
+                XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE)));
+        ILIAS_CO_TRY(auto poller, co_await ilias::Poller::make(mConnection->fileDescriptor(),
+                                                               ilias::IoDescriptor::Socket));
+        mScreenPoller   = std::move(poller);
+        mRandrEventBase = extension->first_event;
+        SPDLOG_INFO("Watching RandR screen changes");
+        co_return {};
+    }
+
+    // True for the RandR notifications that can move, add or remove a monitor.
+    auto handleScreenEvent(const xcb_generic_event_t *event) -> bool
+    {
+        const auto type = static_cast<uint8_t>(event->response_type & ~0x80);
+        if (type == mRandrEventBase + XCB_RANDR_SCREEN_CHANGE_NOTIFY) {
+            const auto *change = reinterpret_cast<const xcb_randr_screen_change_notify_event_t *>(event);
+            if (change->root == mRoot) {
+                mRootWidth  = change->width;
+                mRootHeight = change->height;
+            }
+            return true;
+        }
+        return type == mRandrEventBase + XCB_RANDR_NOTIFY;
+    }
+
     auto logSessionEnvironment() const -> void
     {
         SPDLOG_INFO("X11/XCB session display={} DISPLAY={} XDG_SESSION_TYPE={} WAYLAND_DISPLAY={} "
@@ -405,8 +582,12 @@ private:
 
     std::weak_ptr<XcbInputCapture>  mInputCapture;
     std::weak_ptr<XcbInputInjector> mInputInjector;
+    std::weak_ptr<XcbClipboard>     mClipboard;
     mutable std::mutex              mScreenMutex;
     std::vector<XcbScreen>          mScreens;
+    ilias::Poller                   mScreenPoller;
+    uint8_t                         mRandrEventBase          = 0;
+    bool                            mScreenEventsUnavailable = false;
 };
 
 class XcbInputCapture final : public InputCapture {
@@ -438,6 +619,14 @@ public:
             co_return Err(makeIoError(std::errc::not_enough_memory));
         }
 
+        if (mDedicatedThread) {
+            if (auto started = co_await startCaptureThread(); !started) {
+                closeConnection();
+                co_return Err(started.error());
+            }
+            SPDLOG_INFO("XInput2 capture started on a thread of its own");
+            co_return {};
+        }
         ILIAS_CO_TRY(auto poller, co_await ilias::Poller::make(mConnection->fileDescriptor(),
                                                                ilias::IoDescriptor::Socket));
         mPoller = std::move(poller);
@@ -451,19 +640,29 @@ public:
         co_return;
     }
 
+    auto setDedicatedThread(bool enabled) -> bool override
+    {
+        mDedicatedThread = enabled;
+        return true;
+    }
+
     auto setRemoteControlActive(bool active) -> IoResult<void> override
     {
         if (!mConnection) {
             return Err(makeIoError(std::errc::not_connected));
         }
+        auto lock = std::unique_lock{mStateMutex};
         if (active == mRemoteControlActive) {
             return {};
         }
         if (!active) {
             releaseRemoteControl();
+            pokeCaptureThread();
             return {};
         }
-        return acquireRemoteControl();
+        auto acquired = acquireRemoteControl();
+        pokeCaptureThread();
+        return acquired;
     }
 
     auto moveLocalCursor(uint32_t screenIndex, int32_t x, int32_t y) -> IoResult<void> override
@@ -476,9 +675,11 @@ public:
             return Err(makeIoError(std::errc::invalid_argument));
         }
         const auto root  = mPlatform->root(screenIndex).value_or(mPlatform->root());
+        auto       lock  = std::unique_lock{mStateMutex};
         auto       moved = mConnection->check(xcb_warp_pointer_checked(
             mConnection->get(), XCB_NONE, root, 0, 0, 0, 0, static_cast<int16_t>(global->first),
             static_cast<int16_t>(global->second)));
+        pokeCaptureThread();
         if (!moved) {
             return Err(moved.error());
         }
@@ -488,14 +689,18 @@ public:
 
     auto nextEvent() -> Task<InputEvent> override
     {
-        if (!mConnection || !mPoller) {
+        if (!mConnection || (!mPoller && !mRing)) {
             throw std::runtime_error("InputCapture::nextEvent called after shutdown");
         }
+        if (mRing) {
+            co_return co_await nextCapturedEvent();
+        }
 
         while (true) {
             while (auto *rawEvent = xcb_poll_for_event(mConnection->get())) {
                 XcbPtr<xcb_generic_event_t> event{rawEvent};
                 if (auto translated = translateEvent(event.get())) {
+                    MKS_PROBE1(capture, translated->index());
                     SPDLOG_TRACE("XInput2 capture event {}", *translated);
                     co_return std::move(*translated);
                 }
@@ -545,6 +750,7 @@ private:
 
     auto closeConnection() -> void
     {
+        stopCaptureThread();
         if (mPoller) {
             auto ignored = mPoller.cancel();
             mPoller.close();
@@ -561,6 +767,180 @@ private:
         SPDLOG_INFO("XInput2 capture stopped");
     }
 
+    // MARK: Capture thread
+    //
+    // With setDedicatedThread, mThread owns reading the connection: it blocks
+    // in poll() on the XCB fd, translates what arrives and queues it in mRing
+    // for nextEvent(), so a routing loop busy writing to a slow client does not
+    // leave events unread. Translation state (grabs, mLastCorePointer, key
+    // symbols) is shared with setRemoteControlActive and moveLocalCursor on the
+    // routing thread under mStateMutex. Their round trips can pull events into
+    // libxcb's queue behind the thread's poll(), hence pokeCaptureThread().
+
+    struct CapturedEvent {
+        InputEvent                            event;
+        std::chrono::steady_clock::time_point readAt;
+    };
+
+    auto startCaptureThread() -> IoTask<void>
+    {
+        mWakeFd  = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        mReadyFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (mWakeFd < 0 || mReadyFd < 0) {
+            co_return Err(std::error_code(errno, std::generic_category()));
+        }
+        ILIAS_CO_TRY(auto poller,
+                     co_await ilias::Poller::make(mReadyFd, ilias::IoDescriptor::Socket));
+        mReadyPoller = std::move(poller);
+        mRing        = std::make_unique<SpscRing<CapturedEvent>>(kCaptureRingDepth);
+        mStopping.store(false);
+        mCaptureFailed.store(false);
+        mThread = std::jthread([this, scheduling = callerScheduling()] {
+            adoptScheduling(scheduling);
+            captureLoop();
+        });
+        co_return {};
+    }
+
+    auto stopCaptureThread() -> void
+    {
+        if (mThread.joinable()) {
+            mStopping.store(true);
+            signalEventFd(mWakeFd);
+            mThread.join();
+        }
+        if (mReadyPoller) {
+            auto ignored = mReadyPoller.cancel();
+            mReadyPoller.close();
+        }
+        for (auto *fd : {&mWakeFd, &mReadyFd}) {
+            if (*fd >= 0) {
+                ::close(std::exchange(*fd, -1));
+            }
+        }
+        mRing.reset();
+    }
+
+    // Called with mStateMutex held, after the routing thread used the connection.
+    auto pokeCaptureThread() const -> void
+    {
+        if (mWakeFd >= 0) {
+            signalEventFd(mWakeFd);
+        }
+    }
+
+    auto captureLoop() -> void
+    {
+        pollfd fds[] = {
+            {.fd = mConnection->fileDescriptor(), .events = POLLIN, .revents = 0},
+            {.fd = mWakeFd,                       .events = POLLIN, .revents = 0},
+        };
+        while (!mStopping.load()) {
+            drainConnection();
+            if (xcb_connection_has_error(mConnection->get()) != 0) {
+                SPDLOG_ERROR("XInput2 XCB connection failed");
+                break;
+            }
+            if (::poll(fds, std::size(fds), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                SPDLOG_ERROR("XInput2 capture poll failed: {}",
+                             std::error_code(errno, std::generic_category()).message());
+                break;
+            }
+            if ((fds[1].revents & POLLIN) != 0) {
+                drainEventFd(mWakeFd);
+            }
+            if ((fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
+                SPDLOG_ERROR("XInput2 capture fd closed or failed");
+                break;
+            }
+        }
+        if (!mStopping.load()) {
+            mCaptureFailed.store(true);
+            notifyCaptured();
+        }
+    }
+
+    auto drainConnection() -> void
+    {
+        while (!mStopping.load()) {
+            XcbPtr<xcb_generic_event_t> event{xcb_poll_for_event(mConnection->get())};
+            if (!event) {
+                return;
+            }
+            const auto readAt     = std::chrono::steady_clock::now();
+            auto       translated = std::optional<InputEvent>{};
+            {
+                auto lock  = std::unique_lock{mStateMutex};
+                translated = translateEvent(event.get());
+            }
+            if (!translated) {
+                continue;
+            }
+            MKS_PROBE1(capture, translated->index());
+            SPDLOG_TRACE("XInput2 capture event {}", *translated);
+            pushCaptured(CapturedEvent{.event = std::move(*translated), .readAt = readAt});
+        }
+    }
+
+    // A full ring means the routing loop is stalled; hold the event rather
+    // than drop it, since a lost release leaves a key stuck on the client.
+    auto pushCaptured(CapturedEvent captured) -> void
+    {
+        auto counted = false;
+        while (!mRing->tryPush(std::move(captured))) {
+            if (mStopping.load()) {
+                return;
+            }
+            if (!counted) {
+                captureMetrics().ringFull.add();
+                counted = true;
+            }
+            std::this_thread::sleep_for(kCaptureRingRetry);
+        }
+        notifyCaptured();
+    }
+
+    auto notifyCaptured() -> void
+    {
+        // The ring publishes with a release store, which a later load may
+        // pass; the fence, paired with the one in nextCapturedEvent(), keeps
+        // it first. Then either its second look at the ring sees the event or
+        // this sees it waiting.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mReadyWaiting.load(std::memory_order_relaxed) && mReadyWaiting.exchange(false)) {
+            signalEventFd(mReadyFd);
+        }
+    }
+
+    auto nextCapturedEvent() -> Task<InputEvent>
+    {
+        while (true) {
+            if (auto captured = mRing->tryPop()) {
+                const auto queued = std::chrono::steady_clock::now() - captured->readAt;
+                captureMetrics().queuedNs.record(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(queued).count()));
+                co_return std::move(captured->event);
+            }
+            if (mCaptureFailed.load()) {
+                throw std::runtime_error("XInput2 capture thread stopped");
+            }
+            mReadyWaiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!mRing->empty() || mCaptureFailed.load()) {
+                mReadyWaiting.store(false);
+                continue;
+            }
+            auto pollResult = co_await mReadyPoller.poll(POLLIN);
+            if (!pollResult) {
+                throw std::system_error(pollResult.error(), "XInput2 capture poll failed");
+            }
+            drainEventFd(mReadyFd);
+        }
+    }
+
     static auto grabStatusName(uint8_t status) -> std::string_view
     {
         switch (status) {
@@ -1199,6 +1579,16 @@ private:
     std::optional<std::pair<int32_t, int32_t>> mLastCorePointer;
     ilias::Poller                              mPoller;
     std::shared_ptr<XcbPlatform>               mPlatform;
+    bool                                       mDedicatedThread = false;
+    std::mutex                                 mStateMutex;
+    std::unique_ptr<SpscRing<CapturedEvent>>   mRing;
+    int                                        mWakeFd  = -1;
+    int                                        mReadyFd = -1;
+    ilias::Poller                              mReadyPoller;
+    std::atomic<bool>                          mReadyWaiting{false};
+    std::atomic<bool>                          mStopping{false};
+    std::atomic<bool>                          mCaptureFailed{false};
+    std::jthread                               mThread;
 };
 
 class XcbInputInjector final : public InputInjector {
@@ -1252,20 +1642,25 @@ public:
         co_return;
     }
 
-    auto inject(const InputEvent &event) -> IoTask<void> override
+    auto inject(const InputEvent &event) -> IoTask<void> override { co_return *tryInject(event); }
+
+    // XTest requests are written and flushed synchronously; nothing here waits.
+    auto tryInject(const InputEvent &event) -> std::optional<IoResult<void>> override
     {
         if (!mConnection) {
-            co_return Err(makeIoError(std::errc::not_connected));
+            return Err(makeIoError(std::errc::not_connected));
         }
 
         SPDLOG_TRACE("XTest/XCB injecting event {}", event);
         auto error = std::error_code{};
+        MKS_PROBE1(inject_begin, event.index());
         std::visit([&](const auto &value) { error = injectOne(value); }, event);
+        MKS_PROBE2(inject_end, event.index(), error.value());
         if (error) {
             SPDLOG_WARN("XTest/XCB failed to inject event {}: {}", event, error.message());
-            co_return Err(error);
+            return Err(error);
         }
-        co_return {};
+        return IoResult<void>{};
     }
 
 private:
@@ -1575,6 +1970,682 @@ private:
     std::shared_ptr<XcbPlatform>   mPlatform;
 };
 
+// Shares the CLIPBOARD selection through a dedicated connection and an
+// unmapped InputOnly window. XFixes reports owner changes; a new copy is read
+// in every supported format right away, since the advertisement carries sizes
+// and a hash and the copying application may exit before anyone pastes.
+// Remote offers are published by taking ownership, and their bytes are only
+// fetched when a SelectionRequest names a format.
+//
+// All events are handled while nextOffer() is awaited. A request for a remote
+// offer waits there for the fetch, so other requests queue behind it.
+class XcbClipboard final : public Clipboard {
+public:
+    explicit XcbClipboard(std::shared_ptr<XcbPlatform> platform) : mPlatform(std::move(platform))
+    {
+    }
+
+    ~XcbClipboard() override { closeConnection(); }
+
+    auto initialize() -> IoTask<void> override
+    {
+        closeConnection();
+        auto connection = XcbConnection::connect(mPlatform->displayName());
+        if (!connection) {
+            co_return Err(connection.error());
+        }
+        mConnection = std::move(*connection);
+
+        if (auto prepared = prepare(); !prepared) {
+            auto error = prepared.error();
+            closeConnection();
+            co_return Err(error);
+        }
+        ILIAS_CO_TRY(auto poller, co_await ilias::Poller::make(mConnection->fileDescriptor(),
+                                                               ilias::IoDescriptor::Socket));
+        mPoller = std::move(poller);
+        SPDLOG_INFO("XFixes clipboard sharing started through a dedicated XCB connection");
+        co_return {};
+    }
+
+    auto shutdown() -> Task<void> override
+    {
+        closeConnection();
+        co_return;
+    }
+
+    auto nextOffer() -> IoTask<ClipboardOffer> override
+    {
+        if (!mConnection || !mPoller) {
+            co_return Err(makeIoError(std::errc::not_connected));
+        }
+        while (true) {
+            ILIAS_CO_TRY(auto event, co_await nextEvent());
+            const auto type = static_cast<uint8_t>(event->response_type & ~0x80);
+            if (type == mXfixesEventBase + XCB_XFIXES_SELECTION_NOTIFY) {
+                const auto *notify =
+                    reinterpret_cast<const xcb_xfixes_selection_notify_event_t *>(event.get());
+                // Our own publish() and a cleared selection are not copies.
+                if (notify->owner == mWindow || notify->owner == XCB_NONE) {
+                    continue;
+                }
+                mRemote.reset();
+                mFetch   = {};
+                auto offer = co_await readSelection();
+                if (!offer) {
+                    SPDLOG_WARN("Failed to read the X11 clipboard: {}", offer.error().message());
+                    continue;
+                }
+                if (offer->formats.empty()) {
+                    SPDLOG_DEBUG("X11 clipboard owner offers no shareable format");
+                    continue;
+                }
+                co_return std::move(*offer);
+            }
+            if (type == XCB_SELECTION_REQUEST) {
+                co_await serveRequest(
+                    *reinterpret_cast<const xcb_selection_request_event_t *>(event.get()));
+                continue;
+            }
+            if (type == XCB_SELECTION_CLEAR) {
+                // Another application copied; XFixes reports it separately.
+                mRemote.reset();
+                mFetch = {};
+                mRemoteCache.clear();
+            }
+        }
+    }
+
+    auto read(std::string mime) -> IoTask<std::vector<std::byte>> override
+    {
+        for (const auto &content : mContents) {
+            if (content.mime == mime) {
+                co_return content.bytes;
+            }
+        }
+        co_return Err(makeIoError(std::errc::invalid_argument));
+    }
+
+    auto publish(ClipboardOffer offer, Fetch fetch) -> IoResult<void> override
+    {
+        if (!mConnection) {
+            return Err(makeIoError(std::errc::not_connected));
+        }
+        xcb_set_selection_owner(mConnection->get(), mWindow, mClipboardAtom, XCB_CURRENT_TIME);
+        if (auto flushed = mConnection->flush(); !flushed) {
+            return flushed;
+        }
+        mRemote = std::move(offer);
+        mFetch  = std::move(fetch);
+        mRemoteCache.clear();
+        mContents.clear();
+        return {};
+    }
+
+private:
+    struct MimeAtom {
+        std::string_view mime;
+        std::string_view atomName;
+        xcb_atom_t       atom = XCB_NONE;
+    };
+
+    // Longest wait for a selection owner to answer one conversion.
+    static constexpr auto kConvertTimeout = std::chrono::seconds{2};
+    // Larger copies are not read; they would be held in memory until the next copy.
+    static constexpr auto kMaxContentBytes = size_t{64} * 1024 * 1024;
+
+    auto prepare() -> IoResult<void>
+    {
+        auto *connection = mConnection->get();
+        const auto *extension = xcb_get_extension_data(connection, &xcb_xfixes_id);
+        if (!extension || extension->present == 0) {
+            return Err(makeIoError(std::errc::function_not_supported));
+        }
+        xcb_generic_error_t                   *error = nullptr;
+        XcbPtr<xcb_xfixes_query_version_reply_t> version{xcb_xfixes_query_version_reply(
+            connection,
+            xcb_xfixes_query_version(connection, XCB_XFIXES_MAJOR_VERSION,
+                                     XCB_XFIXES_MINOR_VERSION),
+            &error)};
+        if (protocolError(error, "XFixes QueryVersion") || !version) {
+            return Err(makeIoError(std::errc::function_not_supported));
+        }
+        mXfixesEventBase = extension->first_event;
+
+        const auto *screen = mConnection->screen(mConnection->defaultScreen());
+        if (!screen) {
+            return Err(makeIoError(std::errc::no_such_device));
+        }
+        mWindow                 = xcb_generate_id(connection);
+        const uint32_t events[] = {XCB_EVENT_MASK_PROPERTY_CHANGE};
+        if (auto created = mConnection->check(xcb_create_window_checked(
+                connection, XCB_COPY_FROM_PARENT, mWindow, screen->root, 0, 0, 1, 1, 0,
+                XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, XCB_CW_EVENT_MASK, events));
+            !created) {
+            mWindow = XCB_NONE;
+            return created;
+        }
+
+        // One round trip for every atom.
+        auto names = std::vector<std::string_view>{"CLIPBOARD", "TARGETS", "INCR",
+                                                   "MKS_CLIPBOARD"};
+        for (const auto &mime : mMimes) {
+            names.push_back(mime.atomName);
+        }
+        auto cookies = std::vector<xcb_intern_atom_cookie_t>{};
+        for (const auto name : names) {
+            cookies.push_back(xcb_intern_atom(connection, 0, static_cast<uint16_t>(name.size()),
+                                              name.data()));
+        }
+        auto atoms = std::vector<xcb_atom_t>{};
+        for (auto cookie : cookies) {
+            XcbPtr<xcb_intern_atom_reply_t> reply{
+                xcb_intern_atom_reply(connection, cookie, &error)};
+            if (protocolError(error, "InternAtom") || !reply) {
+                return Err(makeIoError(std::errc::io_error));
+            }
+            atoms.push_back(reply->atom);
+        }
+        mClipboardAtom = atoms[0];
+        mTargetsAtom   = atoms[1];
+        mIncrAtom      = atoms[2];
+        mProperty      = atoms[3];
+        for (auto index = 0U; index < mMimes.size(); ++index) {
+            mMimes[index].atom = atoms[4 + index];
+        }
+
+        if (auto selected = mConnection->check(xcb_xfixes_select_selection_input_checked(
+                connection, mWindow, mClipboardAtom,
+                XCB_XFIXES_SELECTION_EVENT_MASK_SET_SELECTION_OWNER |
+                    XCB_XFIXES_SELECTION_EVENT_MASK_SELECTION_WINDOW_DESTROY |
+                    XCB_XFIXES_SELECTION_EVENT_MASK_SELECTION_CLIENT_CLOSE));
+            !selected) {
+            return selected;
+        }
+        // Requests use the core BIG-REQUESTS limit, in 4-byte units.
+        mMaxPropertyBytes = static_cast<size_t>(xcb_get_maximum_request_length(connection)) * 4;
+        return mConnection->flush();
+    }
+
+    auto closeConnection() -> void
+    {
+        if (mPoller) {
+            auto ignored = mPoller.cancel();
+            mPoller.close();
+        }
+        if (mConnection && mWindow != XCB_NONE) {
+            xcb_destroy_window(mConnection->get(), mWindow);
+            (void)mConnection->flush();
+        }
+        mWindow = XCB_NONE;
+        mDeferred.clear();
+        mContents.clear();
+        mRemote.reset();
+        mFetch = {};
+        mRemoteCache.clear();
+        mConnection.reset();
+    }
+
+    auto mimeForAtom(xcb_atom_t atom) const -> std::optional<std::string_view>
+    {
+        for (const auto &mime : mMimes) {
+            if (mime.atom == atom) {
+                return mime.mime;
+            }
+        }
+        return std::nullopt;
+    }
+
+    auto atomForMime(std::string_view mime) const -> xcb_atom_t
+    {
+        for (const auto &entry : mMimes) {
+            if (entry.mime == mime) {
+                return entry.atom;
+            }
+        }
+        return XCB_NONE;
+    }
+
+    // MARK: Events
+
+    auto receiveEvent() -> IoTask<XcbPtr<xcb_generic_event_t>>
+    {
+        while (true) {
+            if (auto *rawEvent = xcb_poll_for_event(mConnection->get())) {
+                co_return XcbPtr<xcb_generic_event_t>{rawEvent};
+            }
+            if (xcb_connection_has_error(mConnection->get()) != 0) {
+                co_return Err(makeIoError(std::errc::connection_reset));
+            }
+            ILIAS_CO_TRY(auto revents, co_await mPoller.poll(POLLIN));
+            if ((revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
+                co_return Err(makeIoError(std::errc::connection_reset));
+            }
+        }
+    }
+
+    // Events put aside while a conversion waited for its own come first.
+    auto nextEvent() -> IoTask<XcbPtr<xcb_generic_event_t>>
+    {
+        if (!mDeferred.empty()) {
+            auto event = std::move(mDeferred.front());
+            mDeferred.pop_front();
+            co_return event;
+        }
+        co_return co_await receiveEvent();
+    }
+
+    template <typename Predicate>
+    auto receiveMatching(Predicate matches) -> IoTask<XcbPtr<xcb_generic_event_t>>
+    {
+        while (true) {
+            ILIAS_CO_TRY(auto event, co_await receiveEvent());
+            if (matches(event.get())) {
+                co_return event;
+            }
+            mDeferred.push_back(std::move(event));
+        }
+    }
+
+    template <typename Predicate>
+    auto waitFor(Predicate matches) -> IoTask<XcbPtr<xcb_generic_event_t>>
+    {
+        auto [event, timeout] =
+            co_await ilias::whenAny(receiveMatching(matches), ilias::sleep(kConvertTimeout));
+        if (!event) {
+            co_return Err(makeIoError(std::errc::timed_out));
+        }
+        co_return std::move(*event);
+    }
+
+    // MARK: Reading
+
+    auto readSelection() -> IoTask<ClipboardOffer>
+    {
+        ILIAS_CO_TRY(auto targets, co_await convert(mTargetsAtom));
+        auto available = std::span{reinterpret_cast<const xcb_atom_t *>(targets.data()),
+                                   targets.size() / sizeof(xcb_atom_t)};
+
+        auto contents = std::vector<ClipboardContent>{};
+        for (const auto &mime : mMimes) {
+            if (std::ranges::find(available, mime.atom) == available.end()) {
+                continue;
+            }
+            auto bytes = co_await convert(mime.atom);
+            if (!bytes) {
+                SPDLOG_DEBUG("X11 clipboard owner did not convert to {}: {}", mime.mime,
+                             bytes.error().message());
+                continue;
+            }
+            contents.push_back(ClipboardContent{
+                .mime  = std::string{mime.mime},
+                .bytes = std::move(*bytes),
+            });
+        }
+        mContents = std::move(contents);
+        co_return makeClipboardOffer(mContents);
+    }
+
+    // ConvertSelection into our property, following INCR for large data.
+    auto convert(xcb_atom_t target) -> IoTask<std::vector<std::byte>>
+    {
+        auto *connection = mConnection->get();
+        xcb_delete_property(connection, mWindow, mProperty);
+        xcb_convert_selection(connection, mWindow, mClipboardAtom, target, mProperty,
+                              XCB_CURRENT_TIME);
+        ILIAS_CO_TRYV(mConnection->flush());
+
+        ILIAS_CO_TRY(auto event, co_await waitFor([&](const xcb_generic_event_t *candidate) {
+                         if ((candidate->response_type & ~0x80) != XCB_SELECTION_NOTIFY) {
+                             return false;
+                         }
+                         const auto *notify =
+                             reinterpret_cast<const xcb_selection_notify_event_t *>(candidate);
+                         return notify->requestor == mWindow && notify->target == target;
+                     }));
+        const auto *notify = reinterpret_cast<const xcb_selection_notify_event_t *>(event.get());
+        if (notify->property == XCB_NONE) {
+            co_return Err(makeIoError(std::errc::invalid_argument));
+        }
+
+        ILIAS_CO_TRY(auto first, readProperty());
+        if (first.first != mIncrAtom) {
+            co_return std::move(first.second);
+        }
+
+        // INCR: the owner writes chunks as we delete the property; an empty one ends it.
+        auto result = std::vector<std::byte>{};
+        while (true) {
+            ILIAS_CO_TRYV(co_await waitFor([&](const xcb_generic_event_t *candidate) {
+                if ((candidate->response_type & ~0x80) != XCB_PROPERTY_NOTIFY) {
+                    return false;
+                }
+                const auto *property =
+                    reinterpret_cast<const xcb_property_notify_event_t *>(candidate);
+                return property->window == mWindow && property->atom == mProperty &&
+                       property->state == XCB_PROPERTY_NEW_VALUE;
+            }));
+            ILIAS_CO_TRY(auto chunk, readProperty());
+            if (chunk.second.empty()) {
+                co_return result;
+            }
+            if (result.size() + chunk.second.size() > kMaxContentBytes) {
+                co_return Err(makeIoError(std::errc::file_too_large));
+            }
+            result.insert(result.end(), chunk.second.begin(), chunk.second.end());
+        }
+    }
+
+    // Read and delete our property; returns its type and bytes.
+    auto readProperty() -> IoResult<std::pair<xcb_atom_t, std::vector<std::byte>>>
+    {
+        auto                             *connection = mConnection->get();
+        xcb_generic_error_t              *error      = nullptr;
+        XcbPtr<xcb_get_property_reply_t> reply{xcb_get_property_reply(
+            connection,
+            xcb_get_property(connection, 1, mWindow, mProperty, XCB_GET_PROPERTY_TYPE_ANY, 0,
+                             kMaxContentBytes / 4),
+            &error)};
+        if (protocolError(error, "GetProperty") || !reply) {
+            return Err(makeIoError(std::errc::io_error));
+        }
+        if (reply->bytes_after != 0) {
+            return Err(makeIoError(std::errc::file_too_large));
+        }
+        const auto *value = static_cast<const std::byte *>(xcb_get_property_value(reply.get()));
+        const auto  length = static_cast<size_t>(xcb_get_property_value_length(reply.get()));
+        return std::pair{reply->type, std::vector<std::byte>(value, value + length)};
+    }
+
+    // MARK: Serving
+
+    auto serveRequest(const xcb_selection_request_event_t &request) -> Task<void>
+    {
+        // Obsolete requestors leave the property None and expect the target name.
+        const auto property = request.property == XCB_NONE ? request.target : request.property;
+        auto       served   = false;
+        if (mRemote && request.selection == mClipboardAtom) {
+            if (request.target == mTargetsAtom) {
+                served = answerTargets(request.requestor, property);
+            }
+            else if (auto mime = mimeForAtom(request.target)) {
+                served = co_await answerData(request.requestor, property, request.target, *mime);
+            }
+        }
+
+        auto notify          = xcb_selection_notify_event_t{};
+        notify.response_type = XCB_SELECTION_NOTIFY;
+        notify.time          = request.time;
+        notify.requestor     = request.requestor;
+        notify.selection     = request.selection;
+        notify.target        = request.target;
+        notify.property      = served ? property : XCB_NONE;
+        xcb_send_event(mConnection->get(), 0, request.requestor, XCB_EVENT_MASK_NO_EVENT,
+                       reinterpret_cast<const char *>(&notify));
+        (void)mConnection->flush();
+    }
+
+    auto answerTargets(xcb_window_t requestor, xcb_atom_t property) -> bool
+    {
+        auto targets = std::vector<xcb_atom_t>{mTargetsAtom};
+        for (const auto &format : mRemote->formats) {
+            if (auto atom = atomForMime(format.mime); atom != XCB_NONE) {
+                targets.push_back(atom);
+            }
+        }
+        xcb_change_property(mConnection->get(), XCB_PROP_MODE_REPLACE, requestor, property,
+                            XCB_ATOM_ATOM, 32, static_cast<uint32_t>(targets.size()),
+                            targets.data());
+        return true;
+    }
+
+    auto answerData(xcb_window_t requestor, xcb_atom_t property, xcb_atom_t target,
+                    std::string_view mime) -> Task<bool>
+    {
+        const auto offered = std::ranges::any_of(
+            mRemote->formats, [&](const ClipboardFormat &format) { return format.mime == mime; });
+        if (!offered || !mFetch) {
+            co_return false;
+        }
+
+        auto cached = mRemoteCache.find(std::string{mime});
+        if (cached == mRemoteCache.end()) {
+            const auto serial = mRemote->serial;
+            auto       bytes  = co_await mFetch(std::string{mime});
+            if (!bytes) {
+                SPDLOG_WARN("Failed to fetch clipboard offer {} as {}: {}", serial, mime,
+                            bytes.error().message());
+                co_return false;
+            }
+            // A newer copy may have replaced the offer while the bytes were on the way.
+            if (!mRemote || mRemote->serial != serial) {
+                co_return false;
+            }
+            cached = mRemoteCache.insert_or_assign(std::string{mime}, std::move(*bytes)).first;
+        }
+
+        const auto &bytes = cached->second;
+        // Sending INCR is not implemented; this covers anything below the
+        // request limit (16 MiB with BIG-REQUESTS).
+        if (bytes.size() + 64 > mMaxPropertyBytes) {
+            SPDLOG_WARN("Clipboard data for {} is {} bytes, over the X11 request limit", mime,
+                        bytes.size());
+            co_return false;
+        }
+        xcb_change_property(mConnection->get(), XCB_PROP_MODE_REPLACE, requestor, property,
+                            target, 8, static_cast<uint32_t>(bytes.size()), bytes.data());
+        co_return true;
+    }
+
+    std::shared_ptr<XcbPlatform>   mPlatform;
+    std::unique_ptr<XcbConnection> mConnection;
+    ilias::Poller                  mPoller;
+    xcb_window_t                   mWindow           = XCB_NONE;
+    uint8_t                        mXfixesEventBase  = 0;
+    size_t                         mMaxPropertyBytes = 0;
+    xcb_atom_t                     mClipboardAtom    = XCB_NONE;
+    xcb_atom_t                     mTargetsAtom      = XCB_NONE;
+    xcb_atom_t                     mIncrAtom         = XCB_NONE;
+    xcb_atom_t                     mProperty         = XCB_NONE;
+    // Formats shared, in the order they are advertised.
+    std::vector<MimeAtom> mMimes{
+        {.mime = "text/plain;charset=utf-8", .atomName = "UTF8_STRING"},
+        {.mime = "text/html", .atomName = "text/html"},
+        {.mime = "text/uri-list", .atomName = "text/uri-list"},
+        {.mime = "image/png", .atomName = "image/png"},
+    };
+    std::deque<XcbPtr<xcb_generic_event_t>> mDeferred;
+    // Local copy, read when XFixes reported it.
+    std::vector<ClipboardContent> mContents;
+    // Published remote offer and the bytes fetched for it so far.
+    std::optional<ClipboardOffer>                              mRemote;
+    Fetch                                                      mFetch;
+    std::map<std::string, std::vector<std::byte>, std::less<>> mRemoteCache;
+};
+
+// Reads what a local XDND drag carries. The dragging application owns
+// XdndSelection while the button is down and converts it to text/uri-list
+// like any selection, so no XDND messages are exchanged here.
+class XcbDragSource final : public DragSource {
+public:
+    explicit XcbDragSource(std::shared_ptr<XcbPlatform> platform) : mPlatform(std::move(platform))
+    {
+    }
+
+    ~XcbDragSource() override { closeConnection(); }
+
+    auto draggedFiles() -> IoTask<std::vector<std::filesystem::path>> override
+    {
+        if (!mConnection) {
+            ILIAS_CO_TRYV(co_await open());
+        }
+        auto *connection = mConnection->get();
+        xcb_generic_error_t                   *error = nullptr;
+        XcbPtr<xcb_get_selection_owner_reply_t> owner{xcb_get_selection_owner_reply(
+            connection, xcb_get_selection_owner(connection, mSelectionAtom), &error)};
+        if (protocolError(error, "GetSelectionOwner") || !owner) {
+            closeConnection();
+            co_return Err(makeIoError(std::errc::io_error));
+        }
+        if (owner->owner == XCB_NONE) {
+            // Not an XDND drag: a window move, a selection or a drag inside one window.
+            co_return std::vector<std::filesystem::path>{};
+        }
+
+        xcb_delete_property(connection, mWindow, mProperty);
+        xcb_convert_selection(connection, mWindow, mSelectionAtom, mUriListAtom, mProperty,
+                              XCB_CURRENT_TIME);
+        ILIAS_CO_TRYV(mConnection->flush());
+        auto [notified, timeout] =
+            co_await ilias::whenAny(receiveNotify(), ilias::sleep(kConvertTimeout));
+        if (!notified) {
+            co_return Err(makeIoError(std::errc::timed_out));
+        }
+        if (!*notified) {
+            auto error = notified->error();
+            closeConnection();
+            co_return Err(error);
+        }
+        if (**notified == XCB_NONE) {
+            // The owner has no file list, e.g. text dragged out of an editor.
+            co_return std::vector<std::filesystem::path>{};
+        }
+        ILIAS_CO_TRY(auto list, readProperty());
+        co_return parseFileUriList(list);
+    }
+
+private:
+    // Longest wait for the dragging application to answer.
+    static constexpr auto kConvertTimeout = std::chrono::milliseconds{500};
+    // A uri-list this long names far more files than a drag is offered.
+    static constexpr auto kMaxListBytes = size_t{1024} * 1024;
+
+    auto open() -> IoTask<void>
+    {
+        auto connection = XcbConnection::connect(mPlatform->displayName());
+        if (!connection) {
+            co_return Err(connection.error());
+        }
+        mConnection = std::move(*connection);
+        if (auto prepared = prepare(); !prepared) {
+            auto error = prepared.error();
+            closeConnection();
+            co_return Err(error);
+        }
+        ILIAS_CO_TRY(auto poller, co_await ilias::Poller::make(mConnection->fileDescriptor(),
+                                                               ilias::IoDescriptor::Socket));
+        mPoller = std::move(poller);
+        co_return {};
+    }
+
+    auto prepare() -> IoResult<void>
+    {
+        auto       *connection = mConnection->get();
+        const auto *screen     = mConnection->screen(mConnection->defaultScreen());
+        if (!screen) {
+            return Err(makeIoError(std::errc::no_such_device));
+        }
+        mWindow = xcb_generate_id(connection);
+        if (auto created = mConnection->check(xcb_create_window_checked(
+                connection, XCB_COPY_FROM_PARENT, mWindow, screen->root, 0, 0, 1, 1, 0,
+                XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, 0, nullptr));
+            !created) {
+            mWindow = XCB_NONE;
+            return created;
+        }
+
+        const std::string_view names[] = {"XdndSelection", "text/uri-list", "MKS_DRAG"};
+        xcb_intern_atom_cookie_t cookies[std::size(names)];
+        for (auto index = 0U; index < std::size(names); ++index) {
+            cookies[index] = xcb_intern_atom(
+                connection, 0, static_cast<uint16_t>(names[index].size()), names[index].data());
+        }
+        xcb_atom_t atoms[std::size(names)];
+        for (auto index = 0U; index < std::size(names); ++index) {
+            xcb_generic_error_t            *error = nullptr;
+            XcbPtr<xcb_intern_atom_reply_t> reply{
+                xcb_intern_atom_reply(connection, cookies[index], &error)};
+            if (protocolError(error, "InternAtom") || !reply) {
+                return Err(makeIoError(std::errc::io_error));
+            }
+            atoms[index] = reply->atom;
+        }
+        mSelectionAtom = atoms[0];
+        mUriListAtom   = atoms[1];
+        mProperty      = atoms[2];
+        return mConnection->flush();
+    }
+
+    auto closeConnection() -> void
+    {
+        if (mPoller) {
+            auto ignored = mPoller.cancel();
+            mPoller.close();
+        }
+        if (mConnection && mWindow != XCB_NONE) {
+            xcb_destroy_window(mConnection->get(), mWindow);
+            (void)mConnection->flush();
+        }
+        mWindow = XCB_NONE;
+        mConnection.reset();
+    }
+
+    // The property the owner wrote, or XCB_NONE when it refused. Nothing else
+    // is selected on this connection, so other events are dropped.
+    auto receiveNotify() -> IoTask<xcb_atom_t>
+    {
+        while (true) {
+            while (auto *rawEvent = xcb_poll_for_event(mConnection->get())) {
+                auto event = XcbPtr<xcb_generic_event_t>{rawEvent};
+                if ((event->response_type & ~0x80) != XCB_SELECTION_NOTIFY) {
+                    continue;
+                }
+                const auto *notify =
+                    reinterpret_cast<const xcb_selection_notify_event_t *>(event.get());
+                if (notify->requestor == mWindow && notify->target == mUriListAtom) {
+                    co_return notify->property;
+                }
+            }
+            if (xcb_connection_has_error(mConnection->get()) != 0) {
+                co_return Err(makeIoError(std::errc::connection_reset));
+            }
+            ILIAS_CO_TRY(auto revents, co_await mPoller.poll(POLLIN));
+            if ((revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
+                co_return Err(makeIoError(std::errc::connection_reset));
+            }
+        }
+    }
+
+    auto readProperty() -> IoResult<std::string>
+    {
+        auto                             *connection = mConnection->get();
+        xcb_generic_error_t              *error      = nullptr;
+        XcbPtr<xcb_get_property_reply_t> reply{xcb_get_property_reply(
+            connection,
+            xcb_get_property(connection, 1, mWindow, mProperty, XCB_GET_PROPERTY_TYPE_ANY, 0,
+                             kMaxListBytes / 4),
+            &error)};
+        if (protocolError(error, "GetProperty") || !reply) {
+            return Err(makeIoError(std::errc::io_error));
+        }
+        // INCR is not followed: a list over the request limit is no drag we offer.
+        if (reply->bytes_after != 0 || reply->type != mUriListAtom) {
+            return Err(makeIoError(std::errc::file_too_large));
+        }
+        const auto *value  = static_cast<const char *>(xcb_get_property_value(reply.get()));
+        const auto  length = static_cast<size_t>(xcb_get_property_value_length(reply.get()));
+        return std::string(value, length);
+    }
+
+    std::shared_ptr<XcbPlatform>   mPlatform;
+    std::unique_ptr<XcbConnection> mConnection;
+    ilias::Poller                  mPoller;
+    xcb_window_t                   mWindow        = XCB_NONE;
+    xcb_atom_t                     mSelectionAtom = XCB_NONE;
+    xcb_atom_t                     mUriListAtom   = XCB_NONE;
+    xcb_atom_t                     mProperty      = XCB_NONE;
+};
+
 auto XcbPlatform::createCapture() -> InputCapture::Ptr
 {
     if (!mInputCapture.expired()) {
@@ -1595,6 +2666,21 @@ auto XcbPlatform::createInjector() -> InputInjector::Ptr
     return injector;
 }
 
+auto XcbPlatform::createClipboard() -> Clipboard::Ptr
+{
+    if (!mClipboard.expired()) {
+        throw std::runtime_error("Clipboard already created");
+    }
+    auto clipboard = std::make_shared<XcbClipboard>(shared_from_this());
+    mClipboard     = clipboard;
+    return clipboard;
+}
+
+auto XcbPlatform::createDragSource() -> DragSource::Ptr
+{
+    return std::make_shared<XcbDragSource>(shared_from_this());
+}
+
 namespace
 {
 
@@ -1609,30 +2695,55 @@ namespace
         }
     }
 
+    auto waylandSessionCheck() -> BackendCheck
+    {
+        return BackendCheck{
+            .available = false,
+            .detail = "Wayland session detected; XWayland is not a system-wide input backend",
+            .screens =
+                {
+                          .supported = false,
+                          .detail    = "X11 output discovery is not used in a Wayland session",
+                          },
+            .capture =
+                {
+                          .supported = false,
+                          .detail    = "XWayland cannot capture native Wayland input",
+                          },
+            .injection =
+                {
+                          .supported = false,
+                          .detail    = "XWayland cannot inject into native Wayland windows",
+                          },
+        };
+    }
+
     auto checkX11Backend() -> Task<BackendCheck>
     {
         if (isWaylandSession() || envIsSet("WAYLAND_DISPLAY")) {
+            co_return waylandSessionCheck();
+        }
+        co_return co_await probeBackend("X11/XCB", createX11Backend);
+    }
+
+    // Opens no X connection: only rules out sessions that cannot have one.
+    auto x11Capabilities() -> Task<BackendCheck>
+    {
+        if (isWaylandSession() || envIsSet("WAYLAND_DISPLAY")) {
+            co_return waylandSessionCheck();
+        }
+        if (!envIsSet("DISPLAY")) {
+            const auto missing = BackendFeatureCheck{.supported = false, .detail = "No X display"};
             co_return BackendCheck{
                 .available = false,
-                .detail = "Wayland session detected; XWayland is not a system-wide input backend",
-                .screens =
-                    {
-                              .supported = false,
-                              .detail    = "X11 output discovery is not used in a Wayland session",
-                              },
-                .capture =
-                    {
-                              .supported = false,
-                              .detail    = "XWayland cannot capture native Wayland input",
-                              },
-                .injection =
-                    {
-                              .supported = false,
-                              .detail    = "XWayland cannot inject into native Wayland windows",
-                              },
+                .detail    = "DISPLAY is not set",
+                .screens   = missing,
+                .capture   = missing,
+                .injection = missing,
+                .probe     = BackendProbe::Capabilities,
             };
         }
-        co_return co_await probeBackend("X11/XCB", createX11Backend);
+        co_return assumedBackendCheck(fmtlib::format("DISPLAY={}", envString("DISPLAY")));
     }
 
     const BackendRegistration kX11BackendRegistration{
@@ -1640,8 +2751,9 @@ namespace
                           .name        = "x11",
                           .displayName = "X11 (XCB/XInput2/XTest)",
                           .order       = 200,
-                          .check       = checkX11Backend,
-                          .create      = createX11Backend,
+                          .check        = checkX11Backend,
+                          .create       = createX11Backend,
+                          .capabilities = x11Capabilities,
                           }
     };
 
@@ -0,0 +1,125 @@
+/**
+ * @file mks_event_ring.h
+ * @brief Shared-memory event rings for subscriber processes (Linux).
+ *
+ * A subscriber connects to the server's event socket (@c --event-socket),
+ * sends one @ref mks_event_ring_request and reads one
+ * @ref mks_event_ring_reply. On success the reply carries two descriptors
+ * as @c SCM_RIGHTS: a sealed @c memfd holding the ring, then an @c eventfd.
+ * The subscription lasts as long as the connection; closing it unsubscribes.
+ *
+ * The ring is single-producer, single-consumer. mksync writes a record into
+ * slot @c head & (capacity - 1) and then release-stores @c head + 1; the
+ * subscriber acquire-loads @c head, copies records out and release-stores
+ * @c tail. Both cursors count records since the ring was created and never
+ * wrap. mksync never waits for the subscriber: a record that finds the ring
+ * full is dropped and counted in @c dropped, so a slow subscriber loses its
+ * own records and nothing else.
+ *
+ * To sleep, the subscriber stores 1 to @c waiting, checks @c head once more
+ * and only then polls the eventfd (it is non-blocking). mksync writes the
+ * eventfd only when it finds @c waiting set, clearing it, so a busy
+ * subscriber costs no system calls at all. All cursor, flag and counter
+ * accesses are atomic (@c __atomic builtins or @c atomic_ref), sequentially
+ * consistent for @c head and @c waiting.
+ *
+ * Records are plain fixed-layout structs; there is nothing to decode. Input
+ * records reuse the @c mks_plugin.h event structs, strings are NUL-padded
+ * arrays and are truncated when longer.
+ */
+#ifndef MKS_EVENT_RING_H
+#define MKS_EVENT_RING_H
+
+#include "mks_plugin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MKS_EVENT_RING_VERSION 1u
+#define MKS_EVENT_RING_MAGIC   0x52454b4du /* "MKER" */
+
+/* Events a ring can carry; other bits in a request are ignored. */
+#define MKS_EVENT_RING_EVENTS (MKS_EVENT_INPUT | MKS_EVENT_SCREEN_SWITCH | MKS_EVENT_SESSION)
+
+/* Capacity in records when the request leaves it 0, and the largest granted. */
+#define MKS_EVENT_RING_DEFAULT_CAPACITY 4096u
+#define MKS_EVENT_RING_MAX_CAPACITY     65536u
+
+#define MKS_EVENT_RING_ID_SIZE       40
+#define MKS_EVENT_RING_ENDPOINT_SIZE 48
+
+/* Subscriber -> mksync, the first and only message on the socket. */
+typedef struct mks_event_ring_request {
+    uint32_t version;  /* MKS_EVENT_RING_VERSION */
+    uint32_t events;   /* MKS_EVENT_* bits */
+    uint32_t capacity; /* records, rounded up to a power of two; 0 for the default */
+} mks_event_ring_request;
+
+/* mksync -> subscriber. */
+typedef struct mks_event_ring_reply {
+    uint32_t version;
+    int32_t  status;   /* 0, or an errno value; no descriptors follow an error */
+    uint64_t size;     /* bytes to map from the memfd */
+} mks_event_ring_reply;
+
+/* MKS_EVENT_SCREEN_SWITCH. */
+typedef struct mks_screen_switch_record {
+    char     from_owner_id[MKS_EVENT_RING_ID_SIZE];
+    char     to_owner_id[MKS_EVENT_RING_ID_SIZE];
+    uint32_t from_screen_index;
+    uint32_t to_screen_index;
+    int32_t  x;
+    int32_t  y;
+    bool     to_local;
+} mks_screen_switch_record;
+
+/* MKS_EVENT_SESSION_OPENED / MKS_EVENT_SESSION_CLOSED. */
+typedef struct mks_session_record {
+    char owner_id[MKS_EVENT_RING_ID_SIZE];
+    char endpoint[MKS_EVENT_RING_ENDPOINT_SIZE];
+    bool resumed;
+    bool suspended;
+} mks_session_record;
+
+/* One slot of the ring; 128 bytes. */
+typedef struct mks_event_record {
+    uint64_t timestamp_ns; /* CLOCK_MONOTONIC when mksync published it */
+    uint32_t type;         /* exactly one MKS_EVENT_* bit; selects the union member */
+    uint32_t reserved;
+    union {
+        mks_key_event            key;
+        mks_mouse_button_event   mouse_button;
+        mks_mouse_move_event     mouse_move;
+        mks_mouse_wheel_event    mouse_wheel;
+        mks_screen_switch_record screen_switch;
+        mks_session_record       session;
+        uint8_t                  bytes[112];
+    } data;
+} mks_event_record;
+
+/* Start of the mapping; records follow at records_offset. */
+typedef struct mks_event_ring_header {
+    uint32_t magic;          /* MKS_EVENT_RING_MAGIC */
+    uint32_t version;        /* MKS_EVENT_RING_VERSION */
+    uint32_t record_size;    /* sizeof(mks_event_record) */
+    uint32_t capacity;       /* records, a power of two */
+    uint32_t events;         /* the subscription as granted */
+    uint32_t records_offset;
+    uint8_t  pad0[40];
+    /* Each cursor has a cache line of its own, so neither side's stores
+       invalidate the line the other one polls. */
+    uint64_t head;           /* written by mksync */
+    uint8_t  pad1[56];
+    uint64_t tail;           /* written by the subscriber */
+    uint8_t  pad2[56];
+    uint64_t dropped;        /* written by mksync */
+    uint32_t waiting;        /* set by the subscriber, cleared by mksync */
+    uint8_t  pad3[52];
+} mks_event_ring_header;
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* MKS_EVENT_RING_H */
@@ -0,0 +1,200 @@
+/**
+ * @file mks_plugin.h
+ * @brief The C ABI between mksync and plugins loaded from shared libraries.
+ *
+ * A plugin is a shared library exporting one function, @c mks_plugin_entry,
+ * that returns a static @ref mks_plugin. The host checks its ABI version,
+ * calls @c create once, then calls @c on_event for every event whose bit is
+ * in the plugin's subscription and never for any other. Events the plugin
+ * did not subscribe to cost it nothing: the host tests the bits before it
+ * builds or dispatches anything.
+ *
+ * Everything an event points to belongs to the host and is valid only for
+ * the duration of the @c on_event call. Input events point straight at the
+ * captured event, screens and clipboard events into the server's own state;
+ * strings are @ref mks_string views and are not NUL-terminated. @c on_event
+ * runs on the server's event loop thread, so it must return quickly; a
+ * plugin that does real work hands it to a thread of its own.
+ *
+ * Compatibility: structs here only ever grow at the end, and new event bits
+ * are only ever added. Any other change bumps @c MKS_PLUGIN_ABI_VERSION and
+ * the host refuses plugins built against another version.
+ */
+#ifndef MKS_PLUGIN_H
+#define MKS_PLUGIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MKS_PLUGIN_ABI_VERSION 1u
+
+/* Name of the exported mks_plugin_entry_fn. */
+#define MKS_PLUGIN_ENTRY_NAME "mks_plugin_entry"
+
+#if defined(_WIN32)
+    #define MKS_PLUGIN_EXPORT __declspec(dllexport)
+#else
+    #define MKS_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+/* Event bits. A subscription is any OR of them; an event carries exactly one. */
+#define MKS_EVENT_KEY            (1u << 0)
+#define MKS_EVENT_MOUSE_BUTTON   (1u << 1)
+#define MKS_EVENT_MOUSE_MOVE     (1u << 2)
+#define MKS_EVENT_MOUSE_WHEEL    (1u << 3)
+#define MKS_EVENT_SCREENS        (1u << 4)
+#define MKS_EVENT_CLIPBOARD      (1u << 5)
+#define MKS_EVENT_SESSION_OPENED (1u << 6)
+#define MKS_EVENT_SESSION_CLOSED (1u << 7)
+#define MKS_EVENT_SCREEN_SWITCH  (1u << 8)
+
+#define MKS_EVENT_INPUT   (MKS_EVENT_KEY | MKS_EVENT_MOUSE_BUTTON | MKS_EVENT_MOUSE_MOVE | MKS_EVENT_MOUSE_WHEEL)
+#define MKS_EVENT_SESSION (MKS_EVENT_SESSION_OPENED | MKS_EVENT_SESSION_CLOSED)
+
+/* Levels for mks_plugin_host::log. */
+#define MKS_LOG_DEBUG 0
+#define MKS_LOG_INFO  1
+#define MKS_LOG_WARN  2
+#define MKS_LOG_ERROR 3
+
+/* A view of host-owned bytes; not NUL-terminated. */
+typedef struct mks_string {
+    const char *data;
+    size_t      size;
+} mks_string;
+
+/* MKS_EVENT_KEY. key is a USB HID usage, modifiers the HID modifier byte. */
+typedef struct mks_key_event {
+    uint32_t key;
+    uint8_t  modifiers;
+    uint32_t native_code;
+    bool     repeat;
+    bool     release;
+} mks_key_event;
+
+/* MKS_EVENT_MOUSE_BUTTON. button: 1 left, 2 right, 3 middle. */
+typedef struct mks_mouse_button_event {
+    int32_t  x;
+    int32_t  y;
+    uint32_t screen_index;
+    int32_t  button;
+    bool     release;
+} mks_mouse_button_event;
+
+/* MKS_EVENT_MOUSE_MOVE. delta_x/y are raw motion when the backend reports it, else 0. */
+typedef struct mks_mouse_move_event {
+    int32_t  x;
+    int32_t  y;
+    uint32_t screen_index;
+    int32_t  delta_x;
+    int32_t  delta_y;
+} mks_mouse_move_event;
+
+/* MKS_EVENT_MOUSE_WHEEL. */
+typedef struct mks_mouse_wheel_event {
+    int32_t x;
+    int32_t y;
+    int32_t delta_x;
+    int32_t delta_y;
+} mks_mouse_wheel_event;
+
+/* One screen of the server's layout. */
+typedef struct mks_screen {
+    mks_string owner_id; /* machine id of the owner */
+    uint32_t   screen_index;
+    int32_t    cell_x;   /* grid cell; neighbouring screens are one cell apart */
+    int32_t    cell_y;
+    int32_t    x;        /* geometry as the owner reported it */
+    int32_t    y;
+    int32_t    width;
+    int32_t    height;
+    int32_t    dpi;
+    mks_string name;
+    bool       primary;
+    bool       local;    /* a screen of the server itself */
+} mks_screen;
+
+/* MKS_EVENT_SCREENS: the whole layout after any screen was added, removed or changed. */
+typedef struct mks_screens_event {
+    const mks_screen *screens;
+    size_t            count;
+} mks_screens_event;
+
+typedef struct mks_clipboard_format {
+    mks_string mime;
+    uint64_t   size;
+} mks_clipboard_format;
+
+/* MKS_EVENT_CLIPBOARD: a machine copied; the formats are advertised, not yet transferred. */
+typedef struct mks_clipboard_event {
+    uint32_t                    serial;
+    mks_string                  hash;
+    mks_string                  owner; /* endpoint of the copying client; empty for the server */
+    const mks_clipboard_format *formats;
+    size_t                      format_count;
+} mks_clipboard_event;
+
+/* MKS_EVENT_SESSION_OPENED / MKS_EVENT_SESSION_CLOSED. */
+typedef struct mks_session_event {
+    mks_string owner_id;
+    mks_string endpoint;
+    bool       resumed;   /* opened: a reconnect took over a suspended route */
+    bool       suspended; /* closed: the route waits for the client to resume */
+} mks_session_event;
+
+/* MKS_EVENT_SCREEN_SWITCH: keyboard and mouse moved to another screen. */
+typedef struct mks_screen_switch_event {
+    mks_string from_owner_id;
+    uint32_t   from_screen_index;
+    mks_string to_owner_id;
+    uint32_t   to_screen_index;
+    int32_t    x;        /* entry point on the new screen */
+    int32_t    y;
+    bool       to_local; /* the new screen is one of the server's */
+} mks_screen_switch_event;
+
+typedef struct mks_event {
+    uint32_t type; /* exactly one MKS_EVENT_* bit; selects the union member */
+    union {
+        const mks_key_event           *key;
+        const mks_mouse_button_event  *mouse_button;
+        const mks_mouse_move_event    *mouse_move;
+        const mks_mouse_wheel_event   *mouse_wheel;
+        const mks_screens_event       *screens;
+        const mks_clipboard_event     *clipboard;
+        const mks_session_event       *session;
+        const mks_screen_switch_event *screen_switch;
+    } data;
+} mks_event;
+
+/* What the host offers a plugin instance; valid until its destroy returns. */
+typedef struct mks_plugin_host {
+    uint32_t abi_version;
+    void    *context; /* pass back unchanged */
+    void (*log)(void *context, int level, const char *message);
+    /* Replace the instance's subscription; takes effect with the next event. */
+    void (*subscribe)(void *context, uint32_t events);
+} mks_plugin_host;
+
+typedef struct mks_plugin {
+    uint32_t    abi_version; /* MKS_PLUGIN_ABI_VERSION the plugin was built against */
+    const char *name;
+    uint32_t    events;      /* initial subscription */
+    /* Returns the instance passed to the calls below; NULL refuses to load. */
+    void *(*create)(const mks_plugin_host *host);
+    void (*destroy)(void *instance);
+    void (*on_event)(void *instance, const mks_event *event);
+} mks_plugin;
+
+typedef const mks_plugin *(*mks_plugin_entry_fn)(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* MKS_PLUGIN_H */
@@ -1,11 +1,168 @@
 #include "message.hpp"
 
+#include <algorithm>
+#include <string_view>
+
 MKS_BEGIN
 
 // Debug formatters...
 FORMATTER_IMPL(HelloMessage);
+FORMATTER_IMPL(WelcomeMessage);
 FORMATTER_IMPL(ScreensMessage);
+FORMATTER_IMPL(ScreenUpdate);
+FORMATTER_IMPL(ScreensChangedMessage);
 FORMATTER_IMPL(InputMessage);
 FORMATTER_IMPL(ErrorMessage);
+FORMATTER_IMPL(ControlRequestMessage);
+FORMATTER_IMPL(ControlReplyMessage);
+FORMATTER_IMPL(ClipboardOfferMessage);
+FORMATTER_IMPL(ClipboardRequestMessage);
+FORMATTER_IMPL(ClipboardDataMessage);
+FORMATTER_IMPL(FileOfferMessage);
+FORMATTER_IMPL(FileAcceptMessage);
+FORMATTER_IMPL(FileCompleteMessage);
+FORMATTER_IMPL(DragOfferMessage);
+FORMATTER_IMPL(DragEndMessage);
+FORMATTER_IMPL(FileFetchMessage);
+FORMATTER_IMPL(FileSignatureMessage);
+FORMATTER_IMPL(FileDeltaMessage);
+
+namespace {
+
+constexpr auto kBase64Alphabet = std::string_view {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+};
+
+auto base64Value(char c) -> int {
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    }
+    if (c == '+') {
+        return 62;
+    }
+    if (c == '/') {
+        return 63;
+    }
+    return -1;
+}
+
+auto encodeBase64(std::span<const std::byte> bytes) -> std::string {
+    auto result = std::string {};
+    result.reserve((bytes.size() + 2) / 3 * 4);
+    for (auto index = size_t {0}; index < bytes.size(); index += 3) {
+        const auto remaining = bytes.size() - index;
+        auto group = static_cast<uint32_t>(bytes[index]) << 16U;
+        if (remaining > 1) {
+            group |= static_cast<uint32_t>(bytes[index + 1]) << 8U;
+        }
+        if (remaining > 2) {
+            group |= static_cast<uint32_t>(bytes[index + 2]);
+        }
+        result.push_back(kBase64Alphabet[(group >> 18U) & 0x3FU]);
+        result.push_back(kBase64Alphabet[(group >> 12U) & 0x3FU]);
+        result.push_back(remaining > 1 ? kBase64Alphabet[(group >> 6U) & 0x3FU] : '=');
+        result.push_back(remaining > 2 ? kBase64Alphabet[group & 0x3FU] : '=');
+    }
+    return result;
+}
+
+auto decodeBase64(std::string_view text, std::vector<std::byte> &out) -> bool {
+    if (text.size() % 4 != 0) {
+        return false;
+    }
+    for (auto index = size_t {0}; index < text.size(); index += 4) {
+        auto group = uint32_t {0};
+        auto padding = 0;
+        for (auto offset = 0; offset < 4; ++offset) {
+            const auto c = text[index + offset];
+            // Padding is only valid as the last one or two characters.
+            if (c == '=' && offset >= 2 && index + 4 == text.size()) {
+                ++padding;
+                group <<= 6U;
+                continue;
+            }
+            const auto value = base64Value(c);
+            if (value < 0 || padding > 0) {
+                return false;
+            }
+            group = (group << 6U) | static_cast<uint32_t>(value);
+        }
+        out.push_back(static_cast<std::byte>((group >> 16U) & 0xFFU));
+        if (padding < 2) {
+            out.push_back(static_cast<std::byte>((group >> 8U) & 0xFFU));
+        }
+        if (padding < 1) {
+            out.push_back(static_cast<std::byte>(group & 0xFFU));
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+auto diffScreens(const std::vector<ScreenInfo> &before, const std::vector<ScreenInfo> &after)
+    -> ScreensChangedMessage {
+    auto changes = ScreensChangedMessage {
+        .count = static_cast<uint32_t>(after.size()),
+    };
+    for (auto index = 0U; index < after.size(); ++index) {
+        if (index >= before.size() || before[index] != after[index]) {
+            changes.updates.push_back(ScreenUpdate {
+                .screenIndex = index,
+                .info = after[index],
+            });
+        }
+    }
+    return changes;
+}
+
+auto applyScreenChanges(std::vector<ScreenInfo> &screens, const ScreensChangedMessage &changes) -> bool {
+    auto result = screens;
+    result.resize(changes.count);
+    auto known = std::vector<bool>(changes.count, false);
+    std::fill_n(known.begin(), std::min<size_t>(screens.size(), changes.count), true);
+    for (const auto &update : changes.updates) {
+        if (update.screenIndex >= changes.count) {
+            return false;
+        }
+        result[update.screenIndex] = update.info;
+        known[update.screenIndex] = true;
+    }
+    if (std::ranges::find(known, false) != known.end()) {
+        return false;
+    }
+    screens = std::move(result);
+    return true;
+}
+
+auto makeClipboardChunk(uint32_t requestId, std::span<const std::byte> bytes, uint64_t offset)
+    -> ClipboardDataMessage {
+    const auto begin = std::min<uint64_t>(offset, bytes.size());
+    const auto size = std::min<uint64_t>(bytes.size() - begin, kClipboardChunkBytes);
+    return ClipboardDataMessage {
+        .requestId = requestId,
+        .offset = begin,
+        .data = encodeBase64(bytes.subspan(begin, size)),
+        .last = begin + size == bytes.size(),
+    };
+}
+
+auto appendClipboardChunk(std::vector<std::byte> &bytes, const ClipboardDataMessage &chunk) -> bool {
+    if (chunk.offset != bytes.size()) {
+        return false;
+    }
+    const auto size = bytes.size();
+    if (!decodeBase64(chunk.data, bytes)) {
+        bytes.resize(size);
+        return false;
+    }
+    return true;
+}
 
 MKS_END
@@ -14,6 +14,8 @@
 #include "refl/formatter.hpp"
 #include "refl/serde.hpp"
 #include "core.hpp"
+#include <cstddef>
+#include <span>
 #include <variant>
 #include <format>
 
@@ -31,22 +33,69 @@ enum class MessageId : uint16_t {
     Ping,
     Pong,
 
+    ControlRequest,
+    ControlReply,
+
+    Welcome,
+    ScreensChanged,
+
+    ClipboardOffer,
+    ClipboardRequest,
+    ClipboardData,
+
+    FileOffer,
+    FileAccept,
+    FileComplete,
+
+    DragOffer,
+    DragEnd,
+    FileFetch,
+
+    FileSignature,
+    FileDelta,
+
     Error = 0xFFFF
 };
 FORMATTER(MessageId);
 
+/**
+ * @brief Handshake version carried by @ref HelloMessage
+ *
+ * The server rejects a Hello with any other version through an ErrorMessage.
+ * Bump it whenever the handshake or a message layout changes.
+ * 1: resume tokens and WelcomeMessage, trace ids, screen / clipboard / file messages.
+ */
+inline constexpr uint16_t kProtocolVersion = 1;
+
 /**
  * @brief Hello message, the first message sent by client to server
  * 
  */
 struct HelloMessage {
     static constexpr auto Id = MessageId::Hello;
-    uint16_t    version = 0;
+    uint16_t    version = kProtocolVersion;
     std::string machineId;
     std::string name;
+    // Token from the last WelcomeMessage; lets the server resume a suspended route
+    std::string resumeToken;
 };
 FORMATTER(HelloMessage);
 
+/**
+ * @brief Server reply to an accepted Hello
+ *
+ * Carries the token the client presents when it reconnects. @c resumed is true
+ * when the server kept the previous route (screens, cells, active cursor).
+ */
+struct WelcomeMessage {
+    static constexpr auto Id = MessageId::Welcome;
+    std::string resumeToken;
+    bool        resumed = false;
+    // How long the server holds the route after this connection drops
+    uint32_t    resumeGraceMs = 0;
+};
+FORMATTER(WelcomeMessage);
+
 /**
  * @brief The message sent by client to server when screens are changed
  * 
@@ -57,6 +106,45 @@ struct ScreensMessage {
 };
 FORMATTER(ScreensMessage);
 
+/**
+ * @brief One added or changed screen in a @ref ScreensChangedMessage
+ *
+ */
+struct ScreenUpdate {
+    uint32_t   screenIndex = 0;
+    ScreenInfo info;
+};
+FORMATTER(ScreenUpdate);
+
+/**
+ * @brief Incremental screen report sent by the client after a hot-plug
+ *
+ * Screens are identified by index, like the server's screen keys. Indices at
+ * or past @c count were unplugged; @c updates lists only the indices below
+ * @c count that were added or changed, so the server keeps every untouched
+ * screen (and the cursor on it) as it is.
+ */
+struct ScreensChangedMessage {
+    static constexpr auto Id = MessageId::ScreensChanged;
+    uint32_t count = 0;
+    std::vector<ScreenUpdate> updates;
+};
+FORMATTER(ScreensChangedMessage);
+
+/**
+ * @brief Diff two layouts of the same machine into a ScreensChangedMessage.
+ */
+auto diffScreens(const std::vector<ScreenInfo> &before, const std::vector<ScreenInfo> &after)
+    -> ScreensChangedMessage;
+
+/**
+ * @brief Apply @p changes to @p screens.
+ *
+ * @return false, leaving @p screens untouched, if an update is at or past
+ *         @c count or would leave a gap of unknown screens.
+ */
+auto applyScreenChanges(std::vector<ScreenInfo> &screens, const ScreensChangedMessage &changes) -> bool;
+
 /**
  * @brief The message used by server to forward an input event to a client.
  *
@@ -64,6 +152,7 @@ FORMATTER(ScreensMessage);
 struct InputMessage {
     static constexpr auto Id = MessageId::Input;
     InputEvent event;
+    uint64_t traceId = 0; // Server-assigned correlation id for trace export, 0 when tracing is off
 };
 FORMATTER(InputMessage);
 
@@ -92,6 +181,218 @@ struct PongMessage {
 FORMATTER(PingMessage);
 FORMATTER(PongMessage);
 
+/**
+ * @brief Local diagnostic query sent to the control socket (e.g. by `mksync stats`)
+ *
+ */
+struct ControlRequestMessage {
+    static constexpr auto Id = MessageId::ControlRequest;
+    std::string command;
+};
+FORMATTER(ControlRequestMessage);
+
+/**
+ * @brief Reply to a ControlRequestMessage, `ok == false` carries the error text in `body`
+ *
+ */
+struct ControlReplyMessage {
+    static constexpr auto Id = MessageId::ControlReply;
+    bool        ok = true;
+    std::string body;
+};
+FORMATTER(ControlReplyMessage);
+
+/**
+ * @brief A machine copied something; carries formats and sizes, never bytes
+ *
+ * The server re-serials offers it forwards, so a client only ever requests
+ * serials it heard from the server.
+ */
+struct ClipboardOfferMessage {
+    static constexpr auto Id = MessageId::ClipboardOffer;
+    ClipboardOffer offer;
+};
+FORMATTER(ClipboardOfferMessage);
+
+/**
+ * @brief Ask the owner of offer @c serial for its bytes in @c mime
+ *
+ */
+struct ClipboardRequestMessage {
+    static constexpr auto Id = MessageId::ClipboardRequest;
+    uint32_t    serial = 0;
+    uint32_t    requestId = 0; // Chosen by the requester, echoed in every reply chunk
+    std::string mime;
+};
+FORMATTER(ClipboardRequestMessage);
+
+/**
+ * @brief One chunk of a clipboard transfer
+ *
+ * @c data is base64 so a chunk stays a single frame. A non-empty @c error
+ * ends the transfer without data (offer replaced, format gone, ...).
+ */
+struct ClipboardDataMessage {
+    static constexpr auto Id = MessageId::ClipboardData;
+    uint32_t    requestId = 0;
+    uint64_t    offset = 0;
+    std::string data;
+    bool        last = false;
+    std::string error;
+};
+FORMATTER(ClipboardDataMessage);
+
+/**
+ * @brief Raw bytes per ClipboardDataMessage.
+ *
+ * Base64 makes this ~43.7 KB of payload, well under the 64 KiB frame limit,
+ * and small enough that an InputMessage never waits behind more than one chunk.
+ */
+inline constexpr size_t kClipboardChunkBytes = 32 * 1024;
+
+/**
+ * @brief Encode the chunk of @p bytes starting at @p offset.
+ *
+ * Sets @c last on the chunk that reaches the end; empty @p bytes give one
+ * empty last chunk.
+ */
+auto makeClipboardChunk(uint32_t requestId, std::span<const std::byte> bytes, uint64_t offset)
+    -> ClipboardDataMessage;
+
+/**
+ * @brief Append the decoded @p chunk to @p bytes.
+ *
+ * @return false, leaving @p bytes untouched, if the chunk is not the next one
+ *         (offset mismatch) or is not valid base64.
+ */
+auto appendClipboardChunk(std::vector<std::byte> &bytes, const ClipboardDataMessage &chunk) -> bool;
+
+/**
+ * @brief First message after Hello on a file transfer connection
+ *
+ * File transfers never share a connection with input: the sender opens a
+ * second one, so file bytes never queue in front of an InputMessage.
+ */
+struct FileOfferMessage {
+    static constexpr auto Id = MessageId::FileOffer;
+    std::string  transferId; // fileTransferId(manifest)
+    FileManifest manifest;
+    // Replace the receiver's file of this name instead of storing a new copy
+    // next to it; its old content is then the basis of a delta.
+    bool replace = false;
+};
+FORMATTER(FileOfferMessage);
+
+/**
+ * @brief Receiver's answer to a FileOfferMessage
+ *
+ * Lists the chunks still missing, in the order the sender must write them.
+ * After this message the connection carries exactly those chunks as raw
+ * bytes, back to back, then the receiver's FileCompleteMessage. A non-empty
+ * @c error refuses the offer.
+ */
+struct FileAcceptMessage {
+    static constexpr auto Id = MessageId::FileAccept;
+    std::string           transferId;
+    std::vector<uint32_t> chunks;
+    std::string           error;
+};
+FORMATTER(FileAcceptMessage);
+
+/**
+ * @brief The receiver verified and stored the file, or @c error says why not
+ *
+ */
+struct FileCompleteMessage {
+    static constexpr auto Id = MessageId::FileComplete;
+    std::string transferId;
+    std::string error;
+};
+FORMATTER(FileCompleteMessage);
+
+/**
+ * @brief Receiver's answer to a replacing FileOfferMessage when it holds an older copy
+ *
+ * Sent instead of FileAcceptMessage, split over as many messages as the
+ * blocks need (@ref kSignatureBlocksPerMessage each); @c last ends the
+ * signature. The sender answers with FileDeltaMessages, then the receiver
+ * with its FileCompleteMessage.
+ */
+struct FileSignatureMessage {
+    static constexpr auto Id = MessageId::FileSignature;
+    std::string           transferId;
+    uint32_t              blockSize = 0;
+    uint64_t              basisSize = 0;
+    std::vector<uint32_t> weak;   // Continues the previous message's blocks
+    std::vector<uint64_t> strong;
+    bool                  last = false;
+};
+FORMATTER(FileSignatureMessage);
+
+/**
+ * @brief Next ops that rebuild the file from the receiver's older copy
+ *
+ * Op @c i produces @c lengths[i] bytes: copied from basis block
+ * @c blocks[i] on (running on through the following blocks), or, for
+ * kDeltaLiteral, taken from the connection. The literal bytes of all ops
+ * follow the message raw, in op order. Messages keep coming until the ops
+ * add up to the manifest's size.
+ */
+struct FileDeltaMessage {
+    static constexpr auto Id = MessageId::FileDelta;
+    std::string           transferId;
+    std::vector<uint32_t> blocks;
+    std::vector<uint64_t> lengths;
+};
+FORMATTER(FileDeltaMessage);
+
+/** @brief Blocks per FileSignatureMessage and ops per FileDeltaMessage; either stays well inside one frame. */
+inline constexpr size_t kSignatureBlocksPerMessage = 1024;
+inline constexpr size_t kDeltaOpsPerMessage = 1024;
+
+/**
+ * @brief One file of a drag that just crossed onto the client's screen
+ *
+ * Sent while the button is still held, one message per file, so the client
+ * can start fetching before the drop. Fetching is optional: the drag may
+ * still end anywhere. @c transferId names the file in a FileFetchMessage.
+ */
+struct DragOfferMessage {
+    static constexpr auto Id = MessageId::DragOffer;
+    uint32_t     dragId    = 0;
+    uint32_t     fileIndex = 0;
+    uint32_t     fileCount = 0;
+    std::string  transferId; // fileTransferId(manifest)
+    FileManifest manifest;
+};
+FORMATTER(DragOfferMessage);
+
+/**
+ * @brief The button of a drag came up
+ *
+ * @c dropped is true only for the client the cursor was on; every other
+ * client that got offers discards what it fetched.
+ */
+struct DragEndMessage {
+    static constexpr auto Id = MessageId::DragEnd;
+    uint32_t dragId  = 0;
+    bool     dropped = false;
+};
+FORMATTER(DragEndMessage);
+
+/**
+ * @brief First message after Hello on a connection that fetches a dragged file
+ *
+ * The server answers with the FileOfferMessage of @c transferId and the
+ * transfer continues as if the client had been offered the file, or with an
+ * ErrorMessage when the drag is gone.
+ */
+struct FileFetchMessage {
+    static constexpr auto Id = MessageId::FileFetch;
+    std::string transferId;
+};
+FORMATTER(FileFetchMessage);
+
 
 template<typename... Ts>
 struct VariantBase : std::variant<Ts...> {
@@ -109,6 +410,21 @@ struct RpcMessage : VariantBase<
     InputMessage,
     PingMessage,
     PongMessage,
+    ControlRequestMessage,
+    ControlReplyMessage,
+    WelcomeMessage,
+    ScreensChangedMessage,
+    ClipboardOfferMessage,
+    ClipboardRequestMessage,
+    ClipboardDataMessage,
+    FileOfferMessage,
+    FileAcceptMessage,
+    FileCompleteMessage,
+    DragOfferMessage,
+    DragEndMessage,
+    FileFetchMessage,
+    FileSignatureMessage,
+    FileDeltaMessage,
     ErrorMessage
 > {};
 VARIANT_FORMATTER(RpcMessage);
@@ -125,9 +441,25 @@ MKS_END
 
 REFL_REGISTER_FMT_FORMATTER(mks::MessageId);
 REFL_REGISTER_FMT_FORMATTER(mks::HelloMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::WelcomeMessage);
 REFL_REGISTER_FMT_FORMATTER(mks::ScreensMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::ScreenUpdate);
+REFL_REGISTER_FMT_FORMATTER(mks::ScreensChangedMessage);
 REFL_REGISTER_FMT_FORMATTER(mks::InputMessage);
 REFL_REGISTER_FMT_FORMATTER(mks::ErrorMessage);
 REFL_REGISTER_FMT_FORMATTER(mks::PingMessage);
 REFL_REGISTER_FMT_FORMATTER(mks::PongMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::ControlRequestMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::ControlReplyMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::ClipboardOfferMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::ClipboardRequestMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::ClipboardDataMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::FileOfferMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::FileAcceptMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::FileCompleteMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::DragOfferMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::DragEndMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::FileFetchMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::FileSignatureMessage);
+REFL_REGISTER_FMT_FORMATTER(mks::FileDeltaMessage);
 REFL_REGISTER_FMT_FORMATTER(mks::RpcMessage);
@@ -1,38 +1,120 @@
 #include "transport.hpp"
 #include <ilias/io.hpp>
+#include <array>
+#include <cstddef>
 #include <limits>
+#include <system_error>
 
 #include "message.hpp"
+#include "diag/metrics.hpp"
+#include "diag/probes.hpp"
+#include "diag/trace.hpp"
 
 MKS_BEGIN
 
 THIS_ERROR_IMPL(RpcError);
 
+namespace {
+
+constexpr size_t kHeaderSize = sizeof(uint16_t) * 2;
+
+struct TransportMetrics {
+    Counter &framesWritten;
+    Counter &bytesWritten;
+    Counter &framesRead;
+    Counter &bytesRead;
+    Counter &decodeErrors;
+};
+
+auto transportMetrics() -> TransportMetrics & {
+    static auto result = TransportMetrics {
+        .framesWritten = metrics().counter("rpc.frames_written"),
+        .bytesWritten = metrics().counter("rpc.bytes_written"),
+        .framesRead = metrics().counter("rpc.frames_read"),
+        .bytesRead = metrics().counter("rpc.bytes_read"),
+        .decodeErrors = metrics().counter("rpc.decode_errors"),
+    };
+    return result;
+}
+
+// Big-endian u16 size, u16 type; see the wire format in transport.hpp.
+auto encodeHeader(uint16_t size, MessageId id) -> std::array<std::byte, kHeaderSize> {
+    const auto type = static_cast<uint16_t>(id);
+    return {
+        std::byte(size >> 8), std::byte(size & 0xFF),
+        std::byte(type >> 8), std::byte(type & 0xFF),
+    };
+}
+
+// A connection that ends inside a frame broke off rather than closed.
+auto truncatedFrame() -> std::error_code {
+    return std::make_error_code(std::errc::connection_aborted);
+}
+
+} // namespace
+
 RpcTransport::RpcTransport(ilias::DynStream stream) : mStream(std::move(stream)) {
     
 }
 
 // TODO: Use serialization library
-auto RpcTransport::writeMessage(const RpcMessage &message) -> IoTask<void> {
-    ILIAS_CO_TRYV(co_await std::visit([&](const auto &wr) -> IoTask<void> {
-        std::vector<char> buffer;
-        {
-            Serializer serializer(buffer);
-            if (!serializer(wr)) {
-                SPDLOG_ERROR("RpcTransport::writeMessage: Failed to serialize message");
-                co_return Err(RpcError::UnknownMessageType);
-            }
-        }
-        if (buffer.size() > std::numeric_limits<uint16_t>::max()) {
-            SPDLOG_ERROR("RpcTransport::writeMessage: Message too large: {} bytes", buffer.size());
-            co_return Err(RpcError::MessageTooLarge);
+auto RpcTransport::encodeMessage(const RpcMessage &message) -> IoResult<MessageId> {
+    auto &buffer = mWriteBuffer;
+    buffer.clear();
+    auto id = std::visit([&](const auto &wr) -> IoResult<MessageId> {
+        Serializer serializer(buffer);
+        if (!serializer(wr)) {
+            SPDLOG_ERROR("RpcTransport::writeMessage: Failed to serialize message");
+            return Err(RpcError::UnknownMessageType);
         }
-        SPDLOG_TRACE("RpcTransport writing id={} size={} message={}", wr.Id, buffer.size(), message);
-        ILIAS_CO_TRYV(co_await writeHeader(static_cast<uint16_t>(buffer.size()), wr.Id));
-        ILIAS_CO_TRYV(co_await mStream.writeAll(ilias::makeBuffer(buffer)));
-        co_return {};
-    }, message));
+        return wr.Id;
+    }, message);
+    if (!id) {
+        return Err(id.error());
+    }
+    if (buffer.size() > std::numeric_limits<uint16_t>::max()) {
+        SPDLOG_ERROR("RpcTransport::writeMessage: Message too large: {} bytes", buffer.size());
+        return Err(RpcError::MessageTooLarge);
+    }
+    SPDLOG_TRACE("RpcTransport writing id={} size={} message={}", *id, buffer.size(), message);
+    MKS_PROBE2(rpc_write, static_cast<uint16_t>(*id), buffer.size());
+    return id;
+}
+
+auto RpcTransport::writeMessage(const RpcMessage &message) -> IoTask<void> {
+    auto span = TraceSpan {"RpcTransport::writeMessage"};
+    if (const auto *input = std::get_if<InputMessage>(&message)) {
+        span.setId(input->traceId);
+        traceFlow(TraceFlow::Step, input->traceId);
+    }
+    // Serialization never suspends, so it runs as a plain function; only the
+    // stream writes below need the coroutine.
+    ILIAS_CO_TRY(auto id, encodeMessage(message));
+    // Both writes land in the BufStream buffer; flush() is the only real I/O.
+    const auto header = encodeHeader(static_cast<uint16_t>(mWriteBuffer.size()), id);
+    ILIAS_CO_TRYV(co_await mStream.writeAll(ilias::makeBuffer(header)));
+    ILIAS_CO_TRYV(co_await mStream.writeAll(ilias::makeBuffer(mWriteBuffer)));
+    const auto bytes = kHeaderSize + mWriteBuffer.size();
+    ILIAS_CO_TRYV(co_await mStream.flush());
+    // Counted once flushed, so a failed or cancelled write is not reported as sent.
+    transportMetrics().framesWritten.add();
+    transportMetrics().bytesWritten.add(bytes);
+    co_return {};
+}
+
+auto RpcTransport::writeMessages(std::span<const RpcMessage> messages) -> IoTask<void> {
+    auto span = TraceSpan {"RpcTransport::writeMessages"};
+    auto bytes = size_t {0};
+    for (const auto &message : messages) {
+        ILIAS_CO_TRY(auto id, encodeMessage(message));
+        const auto header = encodeHeader(static_cast<uint16_t>(mWriteBuffer.size()), id);
+        ILIAS_CO_TRYV(co_await mStream.writeAll(ilias::makeBuffer(header)));
+        ILIAS_CO_TRYV(co_await mStream.writeAll(ilias::makeBuffer(mWriteBuffer)));
+        bytes += kHeaderSize + mWriteBuffer.size();
+    }
     ILIAS_CO_TRYV(co_await mStream.flush());
+    transportMetrics().framesWritten.add(messages.size());
+    transportMetrics().bytesWritten.add(bytes);
     co_return {};
 }
 
@@ -61,13 +143,35 @@ auto findById(MessageId targetId, Func&& func) -> IoResult<Variant> {
 }
 
 auto RpcTransport::readMessage() -> IoTask<RpcMessage> {
-    ILIAS_CO_TRY(auto header, co_await readHeader());
-    auto [size, id] = header;
+    // Header fields are read straight from the buffered stream instead of
+    // through a helper coroutine per field.
+    auto header = std::array<std::byte, kHeaderSize> {};
+    ILIAS_CO_TRY(auto headerRead, co_await mStream.read(header));
+    if (headerRead == 0) {
+        co_return Err(RpcError::Closed);
+    }
+    if (headerRead < kHeaderSize) {
+        ILIAS_CO_TRY(auto rest, co_await mStream.readAll(std::span {header}.subspan(headerRead)));
+        if (headerRead + rest < kHeaderSize) {
+            co_return Err(truncatedFrame());
+        }
+    }
+    const auto size = static_cast<uint16_t>(
+        (std::to_integer<uint16_t>(header[0]) << 8) | std::to_integer<uint16_t>(header[1])
+    );
+    const auto id = static_cast<MessageId>(
+        (std::to_integer<uint16_t>(header[2]) << 8) | std::to_integer<uint16_t>(header[3])
+    );
+    // Starts after the header so idle time waiting for the peer is not counted.
+    auto span = TraceSpan {"RpcTransport::readMessage"};
 
     // Read payload into buffer
-    std::vector<std::byte> buffer;
+    auto &buffer = mReadBuffer;
     buffer.resize(size);
-    ILIAS_CO_TRYV(co_await mStream.readAll(buffer));
+    ILIAS_CO_TRY(auto payloadRead, co_await mStream.readAll(buffer));
+    if (payloadRead < size) {
+        co_return Err(truncatedFrame());
+    }
 
     auto parser = [&]<typename T>() -> IoResult<T> {
         T result;
@@ -79,12 +183,35 @@ auto RpcTransport::readMessage() -> IoTask<RpcMessage> {
         return result;
     };
     auto message = findById<RpcMessage>(id, parser);
-    if (message) {
+    MKS_PROBE2(rpc_read, static_cast<uint16_t>(id), size);
+    transportMetrics().framesRead.add();
+    transportMetrics().bytesRead.add(kHeaderSize + size);
+    if (!message) {
+        transportMetrics().decodeErrors.add();
+    }
+    else {
         SPDLOG_TRACE("RpcTransport read id={} size={} message={}", id, size, *message);
+        if (const auto *input = std::get_if<InputMessage>(&*message)) {
+            span.setId(input->traceId);
+            traceFlow(TraceFlow::Step, input->traceId);
+        }
     }
     co_return message;
 }
 
+auto RpcTransport::writeRaw(std::span<const std::byte> bytes) -> IoTask<void> {
+    // Frames written before must not end up behind the raw bytes.
+    ILIAS_CO_TRYV(co_await mStream.flush());
+    ILIAS_CO_TRYV(co_await mStream.nextLayer().writeAll(ilias::makeBuffer(bytes)));
+    transportMetrics().bytesWritten.add(bytes.size());
+    co_return {};
+}
+
+auto RpcTransport::readRaw(std::span<std::byte> bytes) -> IoTask<void> {
+    ILIAS_CO_TRYV(co_await mStream.readAll(bytes));
+    co_return {};
+}
+
 auto RpcTransport::shutdown() -> IoTask<void> {
     if (!mStream) {
         SPDLOG_TRACE("RpcTransport shutdown skipped because stream is already closed");
@@ -110,17 +237,4 @@ auto RpcTransport::close() -> void {
     mStream.nextLayer().close();
 }
 
-// Header ...
-auto RpcTransport::writeHeader(uint16_t size, MessageId id) -> IoTask<void> {
-    ILIAS_CO_TRYV(co_await mStream.writeU16Be(size));
-    ILIAS_CO_TRYV(co_await mStream.writeU16Be(static_cast<uint16_t>(id)));
-    co_return {};
-}
-
-auto RpcTransport::readHeader() -> IoTask<std::pair<uint16_t, MessageId> > {
-    ILIAS_CO_TRY(auto size, co_await mStream.readU16Be());
-    ILIAS_CO_TRY(auto id, co_await mStream.readU16Be());
-    co_return std::pair {size, static_cast<MessageId>(id)};
-}
-
 MKS_END
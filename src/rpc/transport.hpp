@@ -4,6 +4,9 @@
 #include "refl/this_error.hpp"
 #include "message.hpp"
 #include <ilias/io.hpp>
+#include <cstddef>
+#include <span>
+#include <vector>
 
 MKS_BEGIN
 
@@ -17,6 +20,9 @@ enum class RpcError {
     MessageTooLarge,
     UnknownMessageType,
     ProtocolError,
+    Rejected,
+    // The peer closed the connection between two frames.
+    Closed,
 };
 THIS_ERROR(RpcError);
 
@@ -30,14 +36,38 @@ public:
     RpcTransport(RpcTransport &&) = default;
 
     auto writeMessage(const RpcMessage &msg) -> IoTask<void>;
+    /**
+     * @brief Write several messages with a single flush, e.g. Hello + Screens
+     * so the handshake costs the peer one round of reads.
+     */
+    auto writeMessages(std::span<const RpcMessage> messages) -> IoTask<void>;
+    /**
+     * @brief Read the next frame.
+     *
+     * Fails with RpcError::Closed when the peer closed the connection before
+     * the frame began, and with an I/O error when it ended partway through.
+     */
     auto readMessage() -> IoTask<RpcMessage>;
+    /**
+     * @brief Write unframed bytes, e.g. file chunks after a FileAcceptMessage.
+     *
+     * @p bytes bypass the write buffer and go to the socket as they are, so a
+     * mapped file is sent without being copied into it first.
+     */
+    auto writeRaw(std::span<const std::byte> bytes) -> IoTask<void>;
+    /** @brief Fill @p bytes with unframed data, starting with anything already buffered. */
+    auto readRaw(std::span<std::byte> bytes) -> IoTask<void>;
     auto shutdown() -> IoTask<void>;
     auto close() -> void;
 private:
-    auto writeHeader(uint16_t size, MessageId id) -> IoTask<void>;
-    auto readHeader() -> IoTask<std::pair<uint16_t, MessageId> >;
+    // Serializes @p msg into mWriteBuffer and checks it fits one frame.
+    auto encodeMessage(const RpcMessage &msg) -> IoResult<MessageId>;
 
     ilias::BufStream<ilias::DynStream> mStream;
+    // Payload scratch reused across messages so steady-state framing keeps its
+    // capacity. One writer and one reader at a time, like the stream itself.
+    std::vector<char> mWriteBuffer;
+    std::vector<std::byte> mReadBuffer;
 };
 
 MKS_END
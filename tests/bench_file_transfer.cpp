@@ -0,0 +1,502 @@
+// File transfer vs. input latency on one event loop. Input runs MockInputCapture -> Server ->
+// TCP 127.0.0.1 -> Client -> MockInputInjector as in bench_input_pipeline; a FileTransfers
+// pair moves a file over a second loopback connection on the same ilias context, where the
+// server serves its file connections. Three runs:
+//
+//   transfer_alone      transfer rate with no input
+//   input_alone         key press/release at kInputHz, capture -> inject latency
+//   input_with_transfer the same input for as long as the transfer runs, and its rate
+//
+// Keys rather than motion, so nothing coalesces and the i-th injection is the i-th capture.
+//
+// Usage: bench_file_transfer [--json PATH] [--size MIB]   (default: bench_file_transfer.json, 256)
+
+#include "app/client.hpp"
+#include "app/file_transfer.hpp"
+#include "app/server.hpp"
+#include "diag/metrics.hpp"
+#include "platform/platform.hpp"
+#include "rpc/message.hpp"
+#include "rpc/transport.hpp"
+#include "support/mock_platform.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <ilias/net.hpp>
+#include <ilias/platform.hpp>
+#include <memory>
+#include <optional>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+auto mks::Platform::create() -> Ptr
+{
+    return nullptr;
+}
+
+namespace
+{
+
+    using namespace std::chrono_literals;
+    using Clock = std::chrono::steady_clock;
+
+    constexpr uint16_t kInputPort    = 30233;
+    constexpr uint16_t kTransferPort = 30234;
+
+    constexpr auto kInputHz       = 1000U;
+    constexpr auto kInputEvents   = size_t{2000}; // input_alone only; the other run follows the transfer
+    constexpr auto kSettleTimeout = 500ms;
+
+    struct LatencySummary {
+        uint64_t p50  = 0;
+        uint64_t p99  = 0;
+        uint64_t max  = 0;
+        uint64_t mean = 0;
+    };
+
+    struct InputResult {
+        size_t                        sent     = 0;
+        size_t                        injected = 0;
+        size_t                        dropped  = 0;
+        std::optional<LatencySummary> latency; // Only when every event arrived
+    };
+
+    struct TransferResult {
+        uint64_t bytes   = 0;
+        double   seconds = 0;
+
+        auto bytesPerSecond() const -> double { return static_cast<double>(bytes) / std::max(seconds, 1e-9); }
+    };
+
+    struct RunResult {
+        std::string                   name;
+        std::optional<InputResult>    input;
+        std::optional<TransferResult> transfer;
+    };
+
+    struct Recorder {
+        std::vector<Clock::time_point> captured;
+        std::vector<Clock::time_point> injected;
+    };
+
+    auto makeEndpoint(uint16_t port) -> mks::IPEndpoint
+    {
+        auto endpoint = mks::IPEndpoint::fromString(fmtlib::format("127.0.0.1:{}", port));
+        if (!endpoint) {
+            throw std::runtime_error("invalid bench endpoint");
+        }
+        return *endpoint;
+    }
+
+    auto makeScreen(std::string name, int32_t width, int32_t height) -> mks::ScreenInfo
+    {
+        return mks::ScreenInfo{
+            .x       = 0,
+            .y       = 0,
+            .width   = width,
+            .height  = height,
+            .dpi     = 72,
+            .name    = std::move(name),
+            .primary = true,
+        };
+    }
+
+    auto makeKey(size_t index) -> mks::InputEvent
+    {
+        const auto key = static_cast<mks::Key>(static_cast<uint32_t>(mks::Key::A) + index / 2 % 26);
+        return mks::KeyEvent{.key = key, .release = index % 2 == 1};
+    }
+
+    auto routerDrops() -> uint64_t
+    {
+        return mks::metrics().counter("server.input.dropped_no_sender").value() +
+               mks::metrics().counter("server.input.dropped_queue_full").value();
+    }
+
+    auto summarize(const Recorder &recorder) -> LatencySummary
+    {
+        auto samples = std::vector<uint64_t>{};
+        samples.reserve(recorder.captured.size());
+        for (auto index = 0U; index < recorder.captured.size(); ++index) {
+            samples.push_back(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(recorder.injected[index] -
+                                                                     recorder.captured[index])
+                    .count()));
+        }
+        std::ranges::sort(samples);
+        auto at = [&](double q) {
+            return samples[std::min(samples.size() - 1,
+                                    static_cast<size_t>(q * static_cast<double>(samples.size())))];
+        };
+        auto sum = uint64_t{0};
+        for (auto sample : samples) {
+            sum += sample;
+        }
+        return LatencySummary{
+            .p50  = at(0.50),
+            .p99  = at(0.99),
+            .max  = samples.back(),
+            .mean = sum / samples.size(),
+        };
+    }
+
+    // Incompressible and cheap to generate, so the bench measures the transfer.
+    auto writeSource(const std::filesystem::path &path, uint64_t size) -> bool
+    {
+        auto file  = std::ofstream{path, std::ios::binary | std::ios::trunc};
+        auto block = std::vector<uint64_t>(128 * 1024);
+        auto state = uint64_t{0x9E3779B97F4A7C15ULL};
+        for (auto left = size; left > 0 && file;) {
+            for (auto &word : block) {
+                state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                word  = state;
+            }
+            const auto count = std::min<uint64_t>(left, block.size() * sizeof(uint64_t));
+            file.write(reinterpret_cast<const char *>(block.data()), static_cast<std::streamsize>(count));
+            left -= count;
+        }
+        return static_cast<bool>(file);
+    }
+
+    class FileTransferBench {
+    public:
+        explicit FileTransferBench(uint64_t fileBytes)
+            : mServerPlatform(std::make_shared<mks::test::MockPlatform>(
+                  std::vector{makeScreen("server", 1920, 1080)})),
+              mClientPlatform(std::make_shared<mks::test::MockPlatform>(
+                  std::vector{makeScreen("client", 2560, 1440)})),
+              mServer(mServerPlatform, makeEndpoint(kInputPort)),
+              mClient(mClientPlatform, makeEndpoint(kInputPort)),
+              mDirectory(std::filesystem::temp_directory_path() / "mks_bench_file_transfer"),
+              mFileBytes(fileBytes)
+        {
+            mClientPlatform->injector()->setObserver(
+                [this](const mks::InputEvent &) { mRecorder.injected.push_back(Clock::now()); });
+        }
+
+        ~FileTransferBench()
+        {
+            auto error = std::error_code{};
+            std::filesystem::remove_all(mDirectory, error);
+        }
+
+        auto run() -> mks::Task<bool>
+        {
+            auto runClient = [&]() -> mks::IoTask<void> {
+                co_await ilias::sleep(20ms);
+                co_return co_await mClient.run();
+            };
+            auto [serverResult, clientResult, finished] =
+                co_await ilias::whenAny(mServer.run(), runClient(), runAll());
+            if (!finished) {
+                std::println(stderr, "server or client stopped before the benchmark finished");
+                co_return false;
+            }
+            co_return *finished;
+        }
+
+        auto results() const -> const std::vector<RunResult> & { return mResults; }
+
+        auto fileBytes() const -> uint64_t { return mFileBytes; }
+
+    private:
+        auto runAll() -> mks::Task<bool>
+        {
+            std::filesystem::remove_all(mDirectory);
+            std::filesystem::create_directories(mDirectory);
+            mSource = mDirectory / "payload.bin";
+            if (!writeSource(mSource, mFileBytes)) {
+                std::println(stderr, "failed to write {}", mSource.string());
+                co_return false;
+            }
+            auto offer = co_await mSender.makeOffer(mSource);
+            if (!offer) {
+                std::println(stderr, "offer failed: {}", offer.error().message());
+                co_return false;
+            }
+            mOffer = std::move(*offer);
+            if (!co_await enterRemoteScreen()) {
+                std::println(stderr, "client never became the active remote screen");
+                co_return false;
+            }
+
+            auto alone = co_await runTransfer();
+            if (!alone) {
+                co_return false;
+            }
+            mResults.push_back(RunResult{.name = "transfer_alone", .transfer = alone});
+            mResults.push_back(RunResult{
+                .name  = "input_alone",
+                .input = co_await runInput([&](size_t sent) { return sent >= kInputEvents; }),
+            });
+
+            auto done    = false;
+            auto measure = [&]() -> mks::Task<std::optional<TransferResult>> {
+                auto result = co_await runTransfer();
+                done        = true;
+                co_return result;
+            };
+            auto [input, transfer] =
+                co_await ilias::whenAll(runInput([&](size_t) { return done; }), measure());
+            if (!transfer) {
+                co_return false;
+            }
+            mResults.push_back(RunResult{.name = "input_with_transfer", .input = input, .transfer = transfer});
+            co_return true;
+        }
+
+        // As bench_input_pipeline: cross the right edge, then move off the client's left edge.
+        auto enterRemoteScreen() -> mks::Task<bool>
+        {
+            if (!co_await waitFor([&] { return mServer.topologyScreens().size() == 2; }, 2s)) {
+                co_return false;
+            }
+            auto capture = mServerPlatform->capture();
+            (void)capture->push(mks::MouseMoveEvent{.x = 1919, .y = 540});
+            (void)capture->push(
+                mks::MouseMoveEvent{.x = 1929, .y = 550, .deltaX = 10, .deltaY = 10});
+            if (!co_await waitFor([&] { return capture->remoteControlActive(); }, 2s)) {
+                co_return false;
+            }
+            (void)capture->push(mks::MouseMoveEvent{.x = 960, .y = 540, .deltaX = 100});
+            co_await waitFor([&] { return mRecorder.injected.size() >= 2; }, 1s);
+            co_return true;
+        }
+
+        // One file connection, offer first, as a client's file connection starts. The
+        // receiving directory is emptied first: a stored copy would be kept, not replaced.
+        auto runTransfer() -> mks::Task<std::optional<TransferResult>>
+        {
+            const auto incoming = mDirectory / "in";
+            std::filesystem::remove_all(incoming);
+            mReceiver.setDirectory(incoming);
+
+            auto listener = co_await ilias::TcpListener::bind(makeEndpoint(kTransferPort));
+            if (!listener) {
+                std::println(stderr, "transfer listen failed: {}", listener.error().message());
+                co_return std::nullopt;
+            }
+            auto sendSide = [&]() -> mks::IoTask<mks::FileTransferStats> {
+                ILIAS_CO_TRY(auto stream, co_await ilias::TcpStream::connect(makeEndpoint(kTransferPort)));
+                auto transport = mks::RpcTransport{std::move(stream)};
+                ILIAS_CO_TRYV(co_await transport.writeMessage(mks::RpcMessage{mOffer}));
+                auto result = co_await mSender.send(transport, mSource, mOffer);
+                (void)co_await transport.shutdown();
+                co_return result;
+            };
+            auto receiveSide = [&]() -> mks::IoTask<std::filesystem::path> {
+                ILIAS_CO_TRY(auto accepted, co_await listener->accept());
+                auto &[stream, endpoint] = accepted;
+                (void)endpoint;
+                auto transport = mks::RpcTransport{std::move(stream)};
+                ILIAS_CO_TRY(auto message, co_await transport.readMessage());
+                auto *offer = std::get_if<mks::FileOfferMessage>(&message);
+                if (!offer) {
+                    co_return mks::Err(mks::RpcError::ProtocolError);
+                }
+                auto result = co_await mReceiver.receive(transport, std::move(*offer));
+                (void)co_await transport.shutdown();
+                co_return result;
+            };
+
+            const auto start    = Clock::now();
+            auto [sent, stored] = co_await ilias::whenAll(sendSide(), receiveSide());
+            const auto elapsed  = Clock::now() - start;
+            if (!sent || !stored) {
+                std::println(stderr, "transfer failed: {}",
+                             (!sent ? sent.error() : stored.error()).message());
+                co_return std::nullopt;
+            }
+            co_return TransferResult{
+                .bytes   = sent->bytes,
+                .seconds = std::chrono::duration<double>(elapsed).count(),
+            };
+        }
+
+        template <typename Stop>
+        auto runInput(Stop stop) -> mks::Task<InputResult>
+        {
+            mRecorder.captured.clear();
+            mRecorder.injected.clear();
+            mClientPlatform->injector()->clear();
+
+            auto       capture     = mServerPlatform->capture();
+            const auto dropsBefore = routerDrops();
+            const auto tick        = std::chrono::nanoseconds{1s} / kInputHz;
+            auto       overflow    = size_t{0};
+            auto       deadline    = Clock::now();
+            auto       sent        = size_t{0};
+            for (; !stop(sent); ++sent) {
+                mRecorder.captured.push_back(Clock::now());
+                if (!capture->push(makeKey(sent))) {
+                    mRecorder.captured.pop_back();
+                    ++overflow;
+                }
+                // No catch-up bursts when the timer oversleeps; see bench_input_pipeline.
+                deadline = std::max(deadline + tick, Clock::now());
+                co_await ilias::sleep(std::max(std::chrono::nanoseconds::zero(),
+                                               std::chrono::nanoseconds{deadline - Clock::now()}));
+            }
+
+            auto seen = mRecorder.injected.size();
+            while (mRecorder.injected.size() < mRecorder.captured.size()) {
+                co_await waitFor([&] { return mRecorder.injected.size() >= mRecorder.captured.size(); },
+                                 kSettleTimeout);
+                if (mRecorder.injected.size() == seen) {
+                    break;
+                }
+                seen = mRecorder.injected.size();
+            }
+
+            auto result     = InputResult{};
+            result.sent     = sent;
+            result.injected = mRecorder.injected.size();
+            result.dropped  = overflow + static_cast<size_t>(routerDrops() - dropsBefore);
+            if (result.dropped == 0 && mRecorder.injected.size() == mRecorder.captured.size() &&
+                !mRecorder.captured.empty()) {
+                result.latency = summarize(mRecorder);
+            }
+            co_return result;
+        }
+
+        template <typename Predicate>
+        static auto waitFor(Predicate predicate, std::chrono::milliseconds timeout) -> mks::Task<bool>
+        {
+            const auto deadline = Clock::now() + timeout;
+            while (!predicate()) {
+                if (Clock::now() >= deadline) {
+                    co_return false;
+                }
+                co_await ilias::sleep(1ms);
+            }
+            co_return true;
+        }
+
+        std::shared_ptr<mks::test::MockPlatform> mServerPlatform;
+        std::shared_ptr<mks::test::MockPlatform> mClientPlatform;
+        mks::Server                              mServer;
+        mks::Client                              mClient;
+        mks::FileTransfers                       mSender;
+        mks::FileTransfers                       mReceiver;
+        std::filesystem::path                    mDirectory;
+        std::filesystem::path                    mSource;
+        mks::FileOfferMessage                    mOffer;
+        uint64_t                                 mFileBytes;
+        Recorder                                 mRecorder;
+        std::vector<RunResult>                   mResults;
+    };
+
+    auto resultJson(const RunResult &result) -> std::string
+    {
+        auto input = std::string{"null"};
+        if (result.input) {
+            auto latency = std::string{"null"};
+            if (result.input->latency) {
+                latency = fmtlib::format(R"({{"p50":{},"p99":{},"max":{},"mean":{}}})",
+                                         result.input->latency->p50, result.input->latency->p99,
+                                         result.input->latency->max, result.input->latency->mean);
+            }
+            input = fmtlib::format(R"({{"sent":{},"injected":{},"dropped":{},"latencyNs":{}}})",
+                                   result.input->sent, result.input->injected, result.input->dropped,
+                                   latency);
+        }
+        auto transfer = std::string{"null"};
+        if (result.transfer) {
+            transfer = fmtlib::format(R"({{"bytes":{},"seconds":{:.3f},"bytesPerSecond":{:.1f}}})",
+                                      result.transfer->bytes, result.transfer->seconds,
+                                      result.transfer->bytesPerSecond());
+        }
+        return fmtlib::format(R"({{"name":"{}","input":{},"transfer":{}}})", result.name, input, transfer);
+    }
+
+    auto writeJson(const FileTransferBench &bench, const std::string &path) -> bool
+    {
+#if defined(NDEBUG)
+        constexpr std::string_view build = "release";
+#else
+        constexpr std::string_view build = "debug";
+#endif
+        auto runs = std::string{};
+        for (const auto &result : bench.results()) {
+            runs += runs.empty() ? "\n    " : ",\n    ";
+            runs += resultJson(result);
+        }
+        auto file = std::ofstream{path, std::ios::trunc};
+        if (!file) {
+            return false;
+        }
+        file << fmtlib::format(
+            "{{\n  \"benchmark\": \"file_transfer\",\n  \"build\": \"{}\",\n  \"timestamp\": {},\n"
+            "  \"fileBytes\": {},\n  \"inputHz\": {},\n  \"runs\": [{}\n  ]\n}}\n",
+            build, static_cast<long long>(std::time(nullptr)), bench.fileBytes(), kInputHz, runs);
+        return static_cast<bool>(file);
+    }
+
+    auto printResult(const RunResult &result) -> void
+    {
+        std::print("{:<20}", result.name);
+        if (result.transfer) {
+            std::print(" transfer={:>8.1f}MiB/s", result.transfer->bytesPerSecond() / (1024 * 1024));
+        }
+        if (result.input) {
+            std::print(" injected={:>6}/{:<6} dropped={:<5}", result.input->injected, result.input->sent,
+                       result.input->dropped);
+            if (result.input->latency) {
+                std::print(" p50={:.1f}us p99={:.1f}us max={:.1f}us",
+                           static_cast<double>(result.input->latency->p50) / 1e3,
+                           static_cast<double>(result.input->latency->p99) / 1e3,
+                           static_cast<double>(result.input->latency->max) / 1e3);
+            }
+            else {
+                std::print(" latency=n/a");
+            }
+        }
+        std::println("");
+    }
+
+} // namespace
+
+void ilias_main(int argc, char **argv)
+{
+    auto jsonPath = std::string{"bench_file_transfer.json"};
+    auto sizeMiB  = uint64_t{256};
+    for (auto index = 1; index + 1 < argc; ++index) {
+        const auto name = std::string_view{argv[index]};
+        if (name == "--json") {
+            jsonPath = argv[++index];
+        }
+        else if (name == "--size") {
+            const auto text = std::string_view{argv[++index]};
+            auto [ptr, error] = std::from_chars(text.data(), text.data() + text.size(), sizeMiB);
+            if (error != std::errc{} || ptr != text.data() + text.size() || sizeMiB == 0) {
+                std::println(stderr, "--size takes a positive number of MiB");
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+    spdlog::set_level(spdlog::level::warn);
+
+    auto bench = FileTransferBench{sizeMiB * 1024 * 1024};
+    if (!co_await bench.run()) {
+        std::exit(EXIT_FAILURE);
+    }
+    for (const auto &result : bench.results()) {
+        printResult(result);
+    }
+
+    if (!writeJson(bench, jsonPath)) {
+        std::println(stderr, "failed to write {}", jsonPath);
+        std::exit(EXIT_FAILURE);
+    }
+    std::println("results: {}", jsonPath);
+    co_return;
+}
@@ -0,0 +1,448 @@
+// End-to-end loopback benchmark: MockInputCapture -> Server -> TCP 127.0.0.1 -> Client ->
+// MockInputInjector, all on one ilias context like test_input_pipeline. Each event is
+// timestamped when pushed into the capture and when the mock injector records it; the
+// pipeline preserves order, so the i-th injection belongs to the i-th capture as long as
+// nothing was dropped.
+//
+// Usage: bench_input_pipeline [--json PATH]   (default: bench_input_pipeline.json)
+
+#include "app/client.hpp"
+#include "app/server.hpp"
+#include "diag/metrics.hpp"
+#include "platform/platform.hpp"
+#include "support/mock_platform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <ilias/platform.hpp>
+#include <memory>
+#include <optional>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+auto mks::Platform::create() -> Ptr
+{
+    return nullptr;
+}
+
+namespace
+{
+
+    using namespace std::chrono_literals;
+    using Clock = std::chrono::steady_clock;
+
+    constexpr uint16_t kBenchPort = 30231;
+
+    enum class Pattern
+    {
+        Motion, // Alternating +1/-1 raw motion, stays inside the remote screen
+        Typing, // Press/release pairs cycling A..Z
+        Mixed,  // Two moves, one key press, one key release
+    };
+
+    struct Scenario {
+        std::string_view         name;
+        Pattern                  pattern;
+        std::chrono::nanoseconds tick;   // Time between batches
+        size_t                   batch;  // Events pushed back-to-back per tick
+        size_t                   events; // Total events
+    };
+
+    // Router queues are 10 deep and the server drains a ready capture channel without
+    // yielding, so batches above ~10 measure burst tolerance rather than latency.
+    constexpr Scenario kScenarios[] = {
+        {.name = "motion_1khz",   .pattern = Pattern::Motion, .tick = 1ms,  .batch = 1, .events = 2000},
+        {.name = "typing_bursts", .pattern = Pattern::Typing, .tick = 40ms, .batch = 8, .events = 400 },
+        {.name = "mixed_2khz",    .pattern = Pattern::Mixed,  .tick = 1ms,  .batch = 2, .events = 4000},
+    };
+
+    // Offered rates for the throughput ramp; each step runs for kRampStepDuration.
+    constexpr uint32_t kRampHertz[]      = {1000, 2000, 5000, 10000, 20000, 50000, 100000};
+    constexpr auto     kRampBatch        = size_t{8};
+    constexpr auto     kRampStepDuration = 250ms;
+    constexpr auto     kSettleTimeout    = 500ms;
+
+    struct LatencySummary {
+        uint64_t p50  = 0;
+        uint64_t p99  = 0;
+        uint64_t max  = 0;
+        uint64_t mean = 0;
+    };
+
+    struct ScenarioResult {
+        std::string                   name;
+        double                        offeredHz       = 0;
+        size_t                        sent            = 0;
+        size_t                        injected        = 0;
+        size_t                        dropped         = 0;
+        double                        eventsPerSecond = 0;
+        std::optional<LatencySummary> latency; // Only when every event arrived
+    };
+
+    struct Recorder {
+        std::vector<Clock::time_point> captured;
+        std::vector<Clock::time_point> injected;
+    };
+
+    auto makeEndpoint(uint16_t port) -> mks::IPEndpoint
+    {
+        auto endpoint = mks::IPEndpoint::fromString(fmtlib::format("127.0.0.1:{}", port));
+        if (!endpoint) {
+            throw std::runtime_error("invalid bench endpoint");
+        }
+        return *endpoint;
+    }
+
+    auto makeScreen(std::string name, int32_t width, int32_t height) -> mks::ScreenInfo
+    {
+        return mks::ScreenInfo{
+            .x       = 0,
+            .y       = 0,
+            .width   = width,
+            .height  = height,
+            .dpi     = 72,
+            .name    = std::move(name),
+            .primary = true,
+        };
+    }
+
+    auto makeMove(int32_t deltaX) -> mks::InputEvent
+    {
+        return mks::MouseMoveEvent{.x = 960, .y = 540, .deltaX = deltaX};
+    }
+
+    auto makeKey(size_t index, bool release) -> mks::InputEvent
+    {
+        const auto key = static_cast<mks::Key>(static_cast<uint32_t>(mks::Key::A) + index % 26);
+        return mks::KeyEvent{.key = key, .release = release};
+    }
+
+    auto makeEvent(Pattern pattern, size_t index) -> mks::InputEvent
+    {
+        switch (pattern) {
+            case Pattern::Motion:
+                return makeMove(index % 2 == 0 ? 1 : -1);
+            case Pattern::Typing:
+                return makeKey(index / 2, index % 2 == 1);
+            case Pattern::Mixed:
+                switch (index % 4) {
+                    case 0:
+                        return makeMove(1);
+                    case 1:
+                        return makeMove(-1);
+                    default:
+                        return makeKey(index / 4, index % 4 == 3);
+                }
+        }
+        return makeMove(0);
+    }
+
+    auto routerDrops() -> uint64_t
+    {
+        return mks::metrics().counter("server.input.dropped_no_sender").value() +
+               mks::metrics().counter("server.input.dropped_queue_full").value();
+    }
+
+    auto summarize(const Recorder &recorder) -> LatencySummary
+    {
+        auto samples = std::vector<uint64_t>{};
+        samples.reserve(recorder.captured.size());
+        for (auto index = 0U; index < recorder.captured.size(); ++index) {
+            samples.push_back(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(recorder.injected[index] -
+                                                                     recorder.captured[index])
+                    .count()));
+        }
+        std::ranges::sort(samples);
+        auto at = [&](double q) {
+            return samples[std::min(samples.size() - 1,
+                                    static_cast<size_t>(q * static_cast<double>(samples.size())))];
+        };
+        auto sum = uint64_t{0};
+        for (auto sample : samples) {
+            sum += sample;
+        }
+        return LatencySummary{
+            .p50  = at(0.50),
+            .p99  = at(0.99),
+            .max  = samples.back(),
+            .mean = sum / samples.size(),
+        };
+    }
+
+    class PipelineBench {
+    public:
+        PipelineBench()
+            : mServerPlatform(std::make_shared<mks::test::MockPlatform>(
+                  std::vector{makeScreen("server", 1920, 1080)})),
+              mClientPlatform(std::make_shared<mks::test::MockPlatform>(
+                  std::vector{makeScreen("client", 2560, 1440)})),
+              mServer(mServerPlatform, makeEndpoint(kBenchPort)),
+              mClient(mClientPlatform, makeEndpoint(kBenchPort))
+        {
+            mClientPlatform->injector()->setObserver(
+                [this](const mks::InputEvent &) { mRecorder.injected.push_back(Clock::now()); });
+        }
+
+        auto run() -> mks::Task<bool>
+        {
+            auto runClient = [&]() -> mks::IoTask<void> {
+                co_await ilias::sleep(20ms);
+                co_return co_await mClient.run();
+            };
+            auto [serverResult, clientResult, finished] =
+                co_await ilias::whenAny(mServer.run(), runClient(), runAll());
+            if (!finished) {
+                std::println(stderr, "server or client stopped before the benchmark finished");
+                co_return false;
+            }
+            co_return *finished;
+        }
+
+        auto scenarios() const -> const std::vector<ScenarioResult> & { return mScenarios; }
+
+        auto ramp() const -> const std::vector<ScenarioResult> & { return mRamp; }
+
+        auto sustainedEventsPerSecond() const -> double
+        {
+            auto best = 0.0;
+            for (const auto &step : mRamp) {
+                if (step.dropped != 0) {
+                    break;
+                }
+                best = std::max(best, step.eventsPerSecond);
+            }
+            return best;
+        }
+
+    private:
+        auto runAll() -> mks::Task<bool>
+        {
+            if (!co_await enterRemoteScreen()) {
+                std::println(stderr, "client never became the active remote screen");
+                co_return false;
+            }
+            for (const auto &scenario : kScenarios) {
+                mScenarios.push_back(co_await runScenario(scenario));
+            }
+            for (auto hertz : kRampHertz) {
+                const auto tick =
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(1s) * kRampBatch / hertz;
+                const auto events = static_cast<size_t>(
+                    hertz * std::chrono::duration<double>(kRampStepDuration).count());
+                auto step = co_await runScenario(Scenario{
+                    .name    = "ramp",
+                    .pattern = Pattern::Motion,
+                    .tick    = tick,
+                    .batch   = kRampBatch,
+                    .events  = events,
+                });
+                step.name = fmtlib::format("ramp_{}hz", hertz);
+                const auto keptUp = step.dropped == 0;
+                mRamp.push_back(std::move(step));
+                if (!keptUp) {
+                    break;
+                }
+            }
+            co_return true;
+        }
+
+        // Cross the right edge the same way test_input_pipeline does, then move away from
+        // the client's left edge so benchmark motion never switches back.
+        auto enterRemoteScreen() -> mks::Task<bool>
+        {
+            if (!co_await waitFor([&] { return mServer.topologyScreens().size() == 2; }, 2s)) {
+                co_return false;
+            }
+            auto capture = mServerPlatform->capture();
+            (void)capture->push(mks::MouseMoveEvent{.x = 1919, .y = 540});
+            (void)capture->push(
+                mks::MouseMoveEvent{.x = 1929, .y = 550, .deltaX = 10, .deltaY = 10});
+            if (!co_await waitFor([&] { return capture->remoteControlActive(); }, 2s)) {
+                co_return false;
+            }
+            (void)capture->push(makeMove(100));
+            co_await waitFor([&] { return mRecorder.injected.size() >= 2; }, 1s);
+            co_return true;
+        }
+
+        auto runScenario(const Scenario &scenario) -> mks::Task<ScenarioResult>
+        {
+            mRecorder.captured.clear();
+            mRecorder.injected.clear();
+            mRecorder.captured.reserve(scenario.events);
+            mRecorder.injected.reserve(scenario.events);
+            mClientPlatform->injector()->clear();
+
+            auto       capture     = mServerPlatform->capture();
+            const auto dropsBefore = routerDrops();
+            auto       overflow    = size_t{0};
+            const auto start       = Clock::now();
+            auto       deadline    = start;
+            for (auto index = size_t{0}; index < scenario.events;) {
+                for (auto inBatch = 0U; inBatch < scenario.batch && index < scenario.events;
+                     ++inBatch, ++index) {
+                    mRecorder.captured.push_back(Clock::now());
+                    if (!capture->push(makeEvent(scenario.pattern, index))) {
+                        mRecorder.captured.pop_back();
+                        ++overflow;
+                    }
+                }
+                // No catch-up bursts when the timer oversleeps: a late tick just lowers
+                // the offered rate, which is reported as measured.
+                deadline = std::max(deadline + scenario.tick, Clock::now());
+                co_await ilias::sleep(std::max(std::chrono::nanoseconds::zero(),
+                                               std::chrono::nanoseconds{deadline - Clock::now()}));
+            }
+            const auto pushed = Clock::now();
+
+            // Wait until everything that was accepted shows up or progress stalls.
+            auto seen = mRecorder.injected.size();
+            while (mRecorder.injected.size() < mRecorder.captured.size()) {
+                co_await waitFor([&] { return mRecorder.injected.size() >= mRecorder.captured.size(); },
+                                 kSettleTimeout);
+                if (mRecorder.injected.size() == seen) {
+                    break;
+                }
+                seen = mRecorder.injected.size();
+            }
+
+            auto result     = ScenarioResult{};
+            result.name     = std::string{scenario.name};
+            result.sent     = scenario.events;
+            result.injected = mRecorder.injected.size();
+            result.dropped  = overflow + static_cast<size_t>(routerDrops() - dropsBefore);
+            result.offeredHz =
+                static_cast<double>(scenario.events) /
+                std::max(std::chrono::duration<double>(pushed - start).count(), 1e-9);
+            if (!mRecorder.injected.empty()) {
+                const auto elapsed =
+                    std::chrono::duration<double>(mRecorder.injected.back() - start).count();
+                result.eventsPerSecond = static_cast<double>(result.injected) / std::max(elapsed, 1e-9);
+            }
+            if (result.dropped == 0 && mRecorder.injected.size() == mRecorder.captured.size() &&
+                !mRecorder.captured.empty()) {
+                result.latency = summarize(mRecorder);
+            }
+            co_return result;
+        }
+
+        template <typename Predicate>
+        static auto waitFor(Predicate predicate, std::chrono::milliseconds timeout) -> mks::Task<bool>
+        {
+            const auto deadline = Clock::now() + timeout;
+            while (!predicate()) {
+                if (Clock::now() >= deadline) {
+                    co_return false;
+                }
+                co_await ilias::sleep(1ms);
+            }
+            co_return true;
+        }
+
+        std::shared_ptr<mks::test::MockPlatform> mServerPlatform;
+        std::shared_ptr<mks::test::MockPlatform> mClientPlatform;
+        mks::Server                              mServer;
+        mks::Client                              mClient;
+        Recorder                                 mRecorder;
+        std::vector<ScenarioResult>              mScenarios;
+        std::vector<ScenarioResult>              mRamp;
+    };
+
+    auto resultJson(const ScenarioResult &result) -> std::string
+    {
+        auto latency = std::string{"null"};
+        if (result.latency) {
+            latency = fmtlib::format(R"({{"p50":{},"p99":{},"max":{},"mean":{}}})",
+                                     result.latency->p50, result.latency->p99,
+                                     result.latency->max, result.latency->mean);
+        }
+        return fmtlib::format(
+            R"({{"name":"{}","offeredHz":{:.1f},"sent":{},"injected":{},"dropped":{},"eventsPerSecond":{:.1f},"latencyNs":{}}})",
+            result.name, result.offeredHz, result.sent, result.injected, result.dropped,
+            result.eventsPerSecond, latency);
+    }
+
+    auto joinJson(const std::vector<ScenarioResult> &results) -> std::string
+    {
+        auto text = std::string{};
+        for (const auto &result : results) {
+            text += text.empty() ? "\n    " : ",\n    ";
+            text += resultJson(result);
+        }
+        return text;
+    }
+
+    auto writeJson(const PipelineBench &bench, const std::string &path) -> bool
+    {
+#if defined(NDEBUG)
+        constexpr std::string_view build = "release";
+#else
+        constexpr std::string_view build = "debug";
+#endif
+        auto file = std::ofstream{path, std::ios::trunc};
+        if (!file) {
+            return false;
+        }
+        file << fmtlib::format(
+            "{{\n  \"benchmark\": \"input_pipeline\",\n  \"build\": \"{}\",\n  \"timestamp\": {},\n"
+            "  \"scenarios\": [{}\n  ],\n  \"ramp\": [{}\n  ],\n"
+            "  \"sustainedEventsPerSecond\": {:.1f}\n}}\n",
+            build, static_cast<long long>(std::time(nullptr)), joinJson(bench.scenarios()),
+            joinJson(bench.ramp()), bench.sustainedEventsPerSecond());
+        return static_cast<bool>(file);
+    }
+
+    auto printResult(const ScenarioResult &result) -> void
+    {
+        std::print("{:<16} offered={:>9.1f}/s injected={:>6}/{:<6} dropped={:<5} rate={:>9.1f}/s",
+                   result.name, result.offeredHz, result.injected, result.sent, result.dropped,
+                   result.eventsPerSecond);
+        if (result.latency) {
+            std::println(" p50={:.1f}us p99={:.1f}us max={:.1f}us",
+                         static_cast<double>(result.latency->p50) / 1e3,
+                         static_cast<double>(result.latency->p99) / 1e3,
+                         static_cast<double>(result.latency->max) / 1e3);
+        }
+        else {
+            std::println(" latency=n/a");
+        }
+    }
+
+} // namespace
+
+void ilias_main(int argc, char **argv)
+{
+    auto jsonPath = std::string{"bench_input_pipeline.json"};
+    for (auto index = 1; index < argc; ++index) {
+        if (std::string_view{argv[index]} == "--json" && index + 1 < argc) {
+            jsonPath = argv[++index];
+        }
+    }
+    spdlog::set_level(spdlog::level::warn);
+
+    auto bench = PipelineBench{};
+    if (!co_await bench.run()) {
+        std::exit(EXIT_FAILURE);
+    }
+    for (const auto &result : bench.scenarios()) {
+        printResult(result);
+    }
+    for (const auto &result : bench.ramp()) {
+        printResult(result);
+    }
+    std::println("sustained without drops: {:.1f} events/s", bench.sustainedEventsPerSecond());
+
+    if (!writeJson(bench, jsonPath)) {
+        std::println(stderr, "failed to write {}", jsonPath);
+        std::exit(EXIT_FAILURE);
+    }
+    std::println("results: {}", jsonPath);
+    co_return;
+}
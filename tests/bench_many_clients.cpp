@@ -0,0 +1,634 @@
+// Many-client soak / scaling harness. A real Server runs on its own thread and ilias context
+// with a mock capture; the main thread drives N protocol-level clients (Hello, Screens, then
+// a reader that discards input) that reconnect after random lifetimes. One extra "anchor"
+// client stays connected and owns the active screen so routing latency can be measured
+// while the others churn.
+//
+// Usage: bench_many_clients [--clients 1,10,25,50,100] [--step-seconds 5]
+//                           [--reconnect-ms 2000] [--port 30241] [--io-threads 0]
+//                           [--json PATH]
+//
+// --reconnect-ms is the mean client lifetime (exponential); 0 keeps clients connected.
+// --io-threads moves the per-client writers onto that many I/O shard threads (Linux).
+// Linux only for CPU / RSS sampling; elsewhere those fields are reported as 0.
+
+#include "app/server.hpp"
+#include "diag/metrics.hpp"
+#include "platform/platform.hpp"
+#include "rpc/message.hpp"
+#include "rpc/transport.hpp"
+#include "support/mock_platform.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <ilias/net.hpp>
+#include <ilias/platform.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#if defined(__linux__)
+    #include <sys/resource.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+auto mks::Platform::create() -> Ptr
+{
+    return nullptr;
+}
+
+namespace
+{
+
+    using namespace std::chrono_literals;
+    using Clock = std::chrono::steady_clock;
+
+    constexpr std::string_view kAnchorId     = "bench-anchor";
+    constexpr auto             kRouteEvery   = 5ms; // 200 Hz probe keys to the anchor
+    constexpr auto             kPollInterval = 1ms;
+
+    struct Options {
+        std::vector<size_t>       clients     = {1, 10, 25, 50, 100};
+        std::chrono::milliseconds step        = 5s;
+        std::chrono::milliseconds reconnect   = 2s;
+        uint16_t                  port        = 30241;
+        size_t                    ioThreads   = 0;
+        std::string               jsonPath    = "bench_many_clients.json";
+    };
+
+    struct Summary {
+        size_t   count = 0;
+        uint64_t p50   = 0;
+        uint64_t p99   = 0;
+        uint64_t max   = 0;
+    };
+
+    struct StepResult {
+        size_t   clients            = 0;
+        double   seconds            = 0;
+        double   serverCpuPercent   = 0; // Server thread only
+        double   processCpuPercent  = 0; // Server + load generator
+        uint64_t rssBytes           = 0;
+        uint64_t peakRssBytes       = 0;
+        Summary  registration;
+        size_t   unregistered       = 0; // Connects never seen in the topology
+        size_t   connectFailures    = 0;
+        Summary  routing;
+        size_t   routeLost          = 0; // Probe keys captured but never received
+        uint64_t sessionsOpened     = 0;
+        uint64_t sessionsClosed     = 0;
+        int64_t  sessionsActive     = 0;
+        size_t   topologyScreens    = 0;
+        uint64_t routerDrops        = 0;
+    };
+
+    // Everything both threads touch. Plain members are guarded by mutex.
+    struct Shared {
+        std::mutex                               mutex;
+        std::map<std::string, Clock::time_point> pendingRegistrations; // ownerId -> connect start
+        std::vector<uint64_t>                    registrationNs;
+        std::vector<Clock::time_point>           captureTimes; // Indexed by probe sequence
+        std::vector<uint64_t>                    routeNs;
+        size_t                                   routeReceived = 0;
+
+        std::atomic<bool>     stop{false};
+        std::atomic<bool>     serverReady{false};
+        std::atomic<bool>     serverFailed{false};
+        std::atomic<uint64_t> serverCpuNs{0};
+        std::atomic<size_t>   topologyScreens{0};
+    };
+
+    auto makeEndpoint(uint16_t port) -> mks::IPEndpoint
+    {
+        auto endpoint = mks::IPEndpoint::fromString(fmtlib::format("127.0.0.1:{}", port));
+        if (!endpoint) {
+            throw std::runtime_error("invalid bench endpoint");
+        }
+        return *endpoint;
+    }
+
+    auto makeScreen(std::string name) -> mks::ScreenInfo
+    {
+        return mks::ScreenInfo{
+            .x       = 0,
+            .y       = 0,
+            .width   = 1920,
+            .height  = 1080,
+            .dpi     = 96,
+            .name    = std::move(name),
+            .primary = true,
+        };
+    }
+
+    auto elapsedNs(Clock::time_point from, Clock::time_point to) -> uint64_t
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    }
+
+    auto summarize(std::vector<uint64_t> samples) -> Summary
+    {
+        if (samples.empty()) {
+            return {};
+        }
+        std::ranges::sort(samples);
+        auto at = [&](double q) {
+            return samples[std::min(samples.size() - 1,
+                                    static_cast<size_t>(q * static_cast<double>(samples.size())))];
+        };
+        return Summary{
+            .count = samples.size(),
+            .p50   = at(0.50),
+            .p99   = at(0.99),
+            .max   = samples.back(),
+        };
+    }
+
+    // MARK: Process sampling
+
+    auto threadCpuNs() -> uint64_t
+    {
+#if defined(__linux__)
+        auto now = timespec{};
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1'000'000'000ULL +
+               static_cast<uint64_t>(now.tv_nsec);
+#else
+        return 0;
+#endif
+    }
+
+    auto processCpuNs() -> uint64_t
+    {
+#if defined(__linux__)
+        auto usage = rusage{};
+        ::getrusage(RUSAGE_SELF, &usage);
+        auto toNs = [](const timeval &value) {
+            return static_cast<uint64_t>(value.tv_sec) * 1'000'000'000ULL +
+                   static_cast<uint64_t>(value.tv_usec) * 1'000ULL;
+        };
+        return toNs(usage.ru_utime) + toNs(usage.ru_stime);
+#else
+        return 0;
+#endif
+    }
+
+    // Current and peak resident set, from /proc/self/status (VmRSS / VmHWM, in kB).
+    auto residentBytes() -> std::pair<uint64_t, uint64_t>
+    {
+#if defined(__linux__)
+        auto file    = std::ifstream{"/proc/self/status"};
+        auto line    = std::string{};
+        auto current = uint64_t{0};
+        auto peak    = uint64_t{0};
+        auto parse   = [&](std::string_view text) {
+            auto value = uint64_t{0};
+            auto begin = text.find_first_of("0123456789");
+            if (begin != std::string_view::npos) {
+                std::from_chars(text.data() + begin, text.data() + text.size(), value);
+            }
+            return value * 1024;
+        };
+        while (std::getline(file, line)) {
+            if (line.starts_with("VmRSS:")) {
+                current = parse(line);
+            }
+            else if (line.starts_with("VmHWM:")) {
+                peak = parse(line);
+            }
+        }
+        return {current, peak};
+#else
+        return {0, 0};
+#endif
+    }
+
+    // MARK: Server thread
+
+    // Runs beside Server::run on the server context: enters the anchor screen, sends
+    // numbered probe keys, matches pending registrations against the topology and
+    // publishes CPU / screen counts for the main thread.
+    auto driveServer(mks::Server &server, mks::test::MockInputCapture &capture, Shared &shared)
+        -> mks::Task<void>
+    {
+        auto nextRoute = Clock::now();
+        auto sequence  = uint32_t{0};
+        auto entering  = false;
+        shared.serverReady = true;
+        while (!shared.stop) {
+            shared.serverCpuNs = threadCpuNs();
+
+            auto pending = false;
+            {
+                auto lock = std::scoped_lock{shared.mutex};
+                pending   = !shared.pendingRegistrations.empty();
+            }
+            auto owners = std::set<std::string, std::less<>>{};
+            auto screens = server.topologyScreens();
+            shared.topologyScreens = screens.size();
+            for (const auto &screen : screens) {
+                owners.insert(screen.key.ownerId);
+            }
+            if (pending) {
+                const auto now  = Clock::now();
+                auto       lock = std::scoped_lock{shared.mutex};
+                for (auto it = shared.pendingRegistrations.begin();
+                     it != shared.pendingRegistrations.end();) {
+                    if (owners.contains(it->first)) {
+                        shared.registrationNs.push_back(elapsedNs(it->second, now));
+                        it = shared.pendingRegistrations.erase(it);
+                    }
+                    else {
+                        ++it;
+                    }
+                }
+            }
+
+            // The anchor is placed right of the server screen; cross that edge once.
+            if (!capture.remoteControlActive() && owners.contains(kAnchorId) && !entering) {
+                (void)capture.push(mks::MouseMoveEvent{.x = 1919, .y = 540});
+                (void)capture.push(
+                    mks::MouseMoveEvent{.x = 1929, .y = 540, .deltaX = 10, .deltaY = 0});
+                entering = true;
+            }
+            entering = entering && !capture.remoteControlActive();
+
+            if (capture.remoteControlActive() && Clock::now() >= nextRoute) {
+                nextRoute += kRouteEvery;
+                {
+                    auto lock = std::scoped_lock{shared.mutex};
+                    shared.captureTimes.push_back(Clock::now());
+                }
+                // nativeCode survives routing untouched, so it carries the sequence.
+                (void)capture.push(mks::KeyEvent{
+                    .key        = mks::Key::A,
+                    .nativeCode = sequence,
+                    .release    = sequence % 2 == 1,
+                });
+                ++sequence;
+            }
+            co_await ilias::sleep(kPollInterval);
+        }
+    }
+
+    auto runServerThread(Shared &shared, mks::IPEndpoint endpoint, size_t ioThreads) -> void
+    {
+        auto context = ilias::PlatformContext{};
+        context.install();
+
+        auto platform =
+            std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("server")});
+        auto server = mks::Server{platform, endpoint};
+        // Churned clients reconnect without a token; a suspended route would
+        // keep their screen in the topology and hide the registration cost.
+        server.setResumeGracePeriod(std::chrono::milliseconds{0});
+        server.setIoThreads(ioThreads);
+        auto body   = [&]() -> mks::Task<void> {
+            auto [serverResult, driven] =
+                co_await ilias::whenAny(server.run(), driveServer(server, *platform->capture(), shared));
+            if (serverResult) {
+                // Server::run only returns on failure (e.g. the port is taken).
+                if (!*serverResult) {
+                    std::println(stderr, "server stopped: {}", serverResult->error().message());
+                }
+                shared.serverFailed = true;
+            }
+        };
+        body().wait();
+    }
+
+    // MARK: Synthetic clients
+
+    class LoadGenerator {
+    public:
+        LoadGenerator(Options options, Shared &shared)
+            : mOptions(std::move(options)), mShared(shared), mEndpoint(makeEndpoint(mOptions.port))
+        {
+        }
+
+        auto run() -> mks::Task<std::vector<StepResult>>
+        {
+            auto [anchor, steps] = co_await ilias::whenAny(runAnchor(), runSteps());
+            (void)anchor;
+            if (!steps) {
+                co_return {};
+            }
+            co_return std::move(*steps);
+        }
+
+    private:
+        auto runAnchor() -> mks::Task<void>
+        {
+            while (!mShared.stop) {
+                co_await session(std::string{kAnchorId}, Clock::time_point::max());
+                co_await ilias::sleep(100ms);
+            }
+        }
+
+        auto runSteps() -> mks::Task<std::vector<StepResult>>
+        {
+            auto results = std::vector<StepResult>{};
+            for (auto count : mOptions.clients) {
+                results.push_back(co_await runStep(count));
+                const auto &last = results.back();
+                std::println("clients={:<5} cpu={:>5.1f}% rss={:>6.1f}MiB reg p99={:>8.2f}ms "
+                             "route p99={:>8.2f}ms lost={} opened={} closed={} drops={}",
+                             last.clients, last.serverCpuPercent,
+                             static_cast<double>(last.rssBytes) / (1024.0 * 1024.0),
+                             static_cast<double>(last.registration.p99) / 1e6,
+                             static_cast<double>(last.routing.p99) / 1e6, last.routeLost,
+                             last.sessionsOpened, last.sessionsClosed, last.routerDrops);
+                if (mShared.serverFailed) {
+                    break;
+                }
+            }
+            co_return results;
+        }
+
+        auto runStep(size_t count) -> mks::Task<StepResult>
+        {
+            auto &opened = mks::metrics().counter("server.sessions.opened");
+            auto &closed = mks::metrics().counter("server.sessions.closed");
+            auto &active = mks::metrics().gauge("server.sessions.active");
+
+            {
+                auto lock = std::scoped_lock{mShared.mutex};
+                mShared.registrationNs.clear();
+                mShared.captureTimes.clear();
+                mShared.routeNs.clear();
+                mShared.routeReceived = 0;
+            }
+            mConnectFailures = 0;
+
+            const auto openedBefore = opened.value();
+            const auto closedBefore = closed.value();
+            const auto dropsBefore  = routerDrops();
+            const auto serverCpu    = mShared.serverCpuNs.load();
+            const auto processCpu   = processCpuNs();
+            const auto start        = Clock::now();
+            const auto deadline     = start + mOptions.step;
+
+            co_await ilias::TaskScope::enter([&](auto &scope) -> mks::Task<void> {
+                for (auto index = size_t{0}; index < count; ++index) {
+                    scope.spawn(churn(fmtlib::format("bench-{}", index), deadline, index));
+                }
+                co_return;
+            });
+
+            const auto end     = Clock::now();
+            const auto wallNs  = static_cast<double>(elapsedNs(start, end));
+            auto       result  = StepResult{};
+            result.clients     = count;
+            result.seconds     = wallNs / 1e9;
+            result.serverCpuPercent =
+                100.0 * static_cast<double>(mShared.serverCpuNs.load() - serverCpu) / wallNs;
+            result.processCpuPercent =
+                100.0 * static_cast<double>(processCpuNs() - processCpu) / wallNs;
+            std::tie(result.rssBytes, result.peakRssBytes) = residentBytes();
+            result.connectFailures = mConnectFailures;
+            result.sessionsOpened  = opened.value() - openedBefore;
+            result.sessionsClosed  = closed.value() - closedBefore;
+            result.sessionsActive  = active.value();
+            result.topologyScreens = mShared.topologyScreens.load();
+            result.routerDrops     = routerDrops() - dropsBefore;
+            {
+                auto lock = std::scoped_lock{mShared.mutex};
+                result.registration = summarize(mShared.registrationNs);
+                result.unregistered = mShared.pendingRegistrations.size();
+                mShared.pendingRegistrations.clear();
+                result.routing   = summarize(mShared.routeNs);
+                result.routeLost = mShared.captureTimes.size() - mShared.routeReceived;
+            }
+            co_return result;
+        }
+
+        // One client id reconnecting until the step deadline.
+        auto churn(std::string ownerId, Clock::time_point deadline, size_t seed) -> mks::Task<void>
+        {
+            auto random   = std::mt19937_64{seed};
+            auto lifetime = std::exponential_distribution<double>{
+                mOptions.reconnect.count() > 0 ? 1.0 / static_cast<double>(mOptions.reconnect.count())
+                                               : 1.0};
+            while (Clock::now() < deadline && !mShared.stop) {
+                auto until = deadline;
+                if (mOptions.reconnect.count() > 0) {
+                    until = std::min(deadline, Clock::now() + std::chrono::milliseconds{
+                                                                  static_cast<int64_t>(lifetime(random))});
+                }
+                co_await session(ownerId, until);
+            }
+        }
+
+        // Connect, identify, advertise one screen, then read until @p until.
+        auto session(std::string ownerId, Clock::time_point until) -> mks::Task<void>
+        {
+            {
+                auto lock = std::scoped_lock{mShared.mutex};
+                mShared.pendingRegistrations[ownerId] = Clock::now();
+            }
+            auto stream = co_await mks::TcpStream::connect(mEndpoint);
+            if (!stream) {
+                ++mConnectFailures;
+                auto lock = std::scoped_lock{mShared.mutex};
+                mShared.pendingRegistrations.erase(ownerId);
+                co_await ilias::sleep(50ms);
+                co_return;
+            }
+            (void)stream->setOption(ilias::sockopt::TcpNoDelay(true));
+            auto transport = mks::RpcTransport{std::move(*stream)};
+            auto hello     = co_await transport.writeMessage(mks::RpcMessage{mks::HelloMessage{
+                .version   = mks::kProtocolVersion,
+                .machineId = ownerId,
+                .name      = ownerId,
+            }});
+            auto screens   = co_await transport.writeMessage(mks::RpcMessage{mks::ScreensMessage{
+                .screens = {makeScreen(ownerId)},
+            }});
+            if (!hello || !screens) {
+                ++mConnectFailures;
+                transport.close();
+                co_return;
+            }
+
+            auto wait = [&]() -> mks::Task<void> {
+                while (Clock::now() < until && !mShared.stop) {
+                    co_await ilias::sleep(std::min<std::chrono::nanoseconds>(
+                        until - Clock::now(), std::chrono::milliseconds{100}));
+                }
+            };
+            co_await ilias::whenAny(readInput(transport), wait());
+            (void)co_await transport.shutdown();
+            transport.close();
+        }
+
+        // Null injector: only probe keys are looked at, everything else is discarded.
+        auto readInput(mks::RpcTransport &transport) -> mks::IoTask<void>
+        {
+            while (true) {
+                ILIAS_CO_TRY(auto message, co_await transport.readMessage());
+                const auto *input = std::get_if<mks::InputMessage>(&message);
+                const auto *key   = input ? std::get_if<mks::KeyEvent>(&input->event) : nullptr;
+                if (!key) {
+                    continue;
+                }
+                const auto now  = Clock::now();
+                auto       lock = std::scoped_lock{mShared.mutex};
+                if (key->nativeCode < mShared.captureTimes.size()) {
+                    mShared.routeNs.push_back(elapsedNs(mShared.captureTimes[key->nativeCode], now));
+                    ++mShared.routeReceived;
+                }
+            }
+        }
+
+        static auto routerDrops() -> uint64_t
+        {
+            return mks::metrics().counter("server.input.dropped_no_sender").value() +
+                   mks::metrics().counter("server.input.dropped_queue_full").value();
+        }
+
+        Options         mOptions;
+        Shared         &mShared;
+        mks::IPEndpoint mEndpoint;
+        size_t          mConnectFailures = 0;
+    };
+
+    // MARK: Report
+
+    auto summaryJson(const Summary &summary) -> std::string
+    {
+        return fmtlib::format(R"({{"count":{},"p50":{},"p99":{},"max":{}}})", summary.count,
+                              summary.p50, summary.p99, summary.max);
+    }
+
+    auto writeJson(const Options &options, const std::vector<StepResult> &results) -> bool
+    {
+        auto steps = std::string{};
+        for (const auto &step : results) {
+            steps += steps.empty() ? "\n    " : ",\n    ";
+            steps += fmtlib::format(
+                R"({{"clients":{},"seconds":{:.3f},"serverCpuPercent":{:.2f},"processCpuPercent":{:.2f},)"
+                R"("rssBytes":{},"peakRssBytes":{},"registrationNs":{},"unregistered":{},"connectFailures":{},)"
+                R"("routingNs":{},"routeLost":{},"sessionsOpened":{},"sessionsClosed":{},"sessionsActive":{},)"
+                R"("topologyScreens":{},"routerDrops":{}}})",
+                step.clients, step.seconds, step.serverCpuPercent, step.processCpuPercent,
+                step.rssBytes, step.peakRssBytes, summaryJson(step.registration), step.unregistered,
+                step.connectFailures, summaryJson(step.routing), step.routeLost,
+                step.sessionsOpened, step.sessionsClosed, step.sessionsActive,
+                step.topologyScreens, step.routerDrops);
+        }
+        auto file = std::ofstream{options.jsonPath, std::ios::trunc};
+        if (!file) {
+            return false;
+        }
+        file << fmtlib::format(
+            "{{\n  \"benchmark\": \"many_clients\",\n  \"timestamp\": {},\n"
+            "  \"stepMs\": {},\n  \"reconnectMeanMs\": {},\n  \"ioThreads\": {},\n  \"steps\": [{}\n  ]\n}}\n",
+            static_cast<long long>(std::time(nullptr)), options.step.count(),
+            options.reconnect.count(), options.ioThreads, steps);
+        return static_cast<bool>(file);
+    }
+
+    auto parseNumber(std::string_view text) -> std::optional<uint64_t>
+    {
+        auto value    = uint64_t{0};
+        auto [ptr, e] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (e != std::errc{} || ptr != text.data() + text.size()) {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    auto parseOptions(int argc, char **argv) -> std::optional<Options>
+    {
+        auto options = Options{};
+        for (auto index = 1; index + 1 < argc; index += 2) {
+            const auto name  = std::string_view{argv[index]};
+            const auto value = std::string_view{argv[index + 1]};
+            if (name == "--json") {
+                options.jsonPath = value;
+                continue;
+            }
+            if (name == "--clients") {
+                options.clients.clear();
+                for (auto rest = value; !rest.empty();) {
+                    const auto comma = rest.find(',');
+                    auto       count = parseNumber(rest.substr(0, comma));
+                    if (!count || *count == 0) {
+                        return std::nullopt;
+                    }
+                    options.clients.push_back(static_cast<size_t>(*count));
+                    rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+                }
+                continue;
+            }
+            auto number = parseNumber(value);
+            if (!number) {
+                return std::nullopt;
+            }
+            if (name == "--step-seconds") {
+                options.step = std::chrono::seconds{*number};
+            }
+            else if (name == "--reconnect-ms") {
+                options.reconnect = std::chrono::milliseconds{*number};
+            }
+            else if (name == "--port") {
+                options.port = static_cast<uint16_t>(*number);
+            }
+            else if (name == "--io-threads") {
+                options.ioThreads = static_cast<size_t>(*number);
+            }
+            else {
+                return std::nullopt;
+            }
+        }
+        if (options.clients.empty()) {
+            return std::nullopt;
+        }
+        return options;
+    }
+
+} // namespace
+
+void ilias_main(int argc, char **argv)
+{
+    auto options = parseOptions(argc, argv);
+    if (!options) {
+        std::println(stderr, "usage: bench_many_clients [--clients 1,10,50] [--step-seconds N] "
+                             "[--reconnect-ms N] [--port N] [--io-threads N] [--json PATH]");
+        std::exit(EXIT_FAILURE);
+    }
+    spdlog::set_level(spdlog::level::warn);
+
+    auto shared       = Shared{};
+    auto serverThread = std::jthread{[&] { runServerThread(shared, makeEndpoint(options->port), options->ioThreads); }};
+    while (!shared.serverReady && !shared.serverFailed) {
+        co_await ilias::sleep(10ms);
+    }
+
+    auto generator = LoadGenerator{*options, shared};
+    auto results   = co_await generator.run();
+    shared.stop    = true;
+    serverThread.join();
+
+    if (!writeJson(*options, results)) {
+        std::println(stderr, "failed to write {}", options->jsonPath);
+        std::exit(EXIT_FAILURE);
+    }
+    std::println("results: {}", options->jsonPath);
+    co_return;
+}
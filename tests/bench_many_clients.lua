@@ -0,0 +1,27 @@
+target("bench_many_clients")
+    local test_file = path.join(os.scriptdir(), "bench_many_clients.cpp")
+    mks_apply_bench_settings(test_file)
+    add_files(test_file)
+    add_files(
+        path.join(os.projectdir(), "src/app/server.cpp"),
+        path.join(os.projectdir(), "src/app/server_session.cpp"),
+        path.join(os.projectdir(), "src/app/server_screens.cpp"),
+        path.join(os.projectdir(), "src/app/server_input.cpp"),
+        path.join(os.projectdir(), "src/app/server_clipboard.cpp"),
+        path.join(os.projectdir(), "src/app/server_drag.cpp"),
+        path.join(os.projectdir(), "src/app/clipboard_transfer.cpp"),
+        path.join(os.projectdir(), "src/app/outbound_queue.cpp"),
+        path.join(os.projectdir(), "src/app/io_shards.cpp"),
+        path.join(os.projectdir(), "src/app/file_transfer.cpp"),
+        path.join(os.projectdir(), "src/core/file_delta.cpp"),
+        path.join(os.projectdir(), "src/app/worker_pool.cpp"),
+        path.join(os.projectdir(), "src/app/thread_tuning.cpp"),
+        path.join(os.projectdir(), "src/config/app_config.cpp"),
+        path.join(os.projectdir(), "src/rpc/message.cpp"),
+        path.join(os.projectdir(), "src/rpc/transport.cpp"),
+        path.join(os.projectdir(), "src/diag/flight_recorder.cpp"),
+        path.join(os.projectdir(), "src/diag/metrics.cpp"),
+        path.join(os.projectdir(), "src/diag/trace.cpp"),
+        path.join(os.projectdir(), "src/core/topology.cpp")
+    )
+target_end()
@@ -0,0 +1,148 @@
+// Global operator new / delete replacements backing support/alloc_counter.hpp.
+// Add this file to a test target to enable counting; never to the application.
+
+#include "support/alloc_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+    // Plain integers: thread_local with a constant initializer needs no guard and never
+    // allocates, so it is safe to touch from inside operator new.
+    thread_local uint64_t tAllocations   = 0;
+    thread_local uint64_t tDeallocations = 0;
+
+    auto allocate(std::size_t size) noexcept -> void *
+    {
+        ++tAllocations;
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    auto allocateAligned(std::size_t size, std::align_val_t alignment) noexcept -> void *
+    {
+        ++tAllocations;
+        const auto align = static_cast<std::size_t>(alignment);
+        // aligned_alloc wants a size that is a multiple of the alignment.
+        const auto rounded = (size + align - 1) / align * align;
+#if defined(_WIN32)
+        return ::_aligned_malloc(rounded == 0 ? align : rounded, align);
+#else
+        return std::aligned_alloc(align, rounded == 0 ? align : rounded);
+#endif
+    }
+
+    auto release(void *pointer) noexcept -> void
+    {
+        if (pointer != nullptr) {
+            ++tDeallocations;
+            std::free(pointer);
+        }
+    }
+
+    auto releaseAligned(void *pointer) noexcept -> void
+    {
+        if (pointer != nullptr) {
+            ++tDeallocations;
+#if defined(_WIN32)
+            ::_aligned_free(pointer);
+#else
+            std::free(pointer);
+#endif
+        }
+    }
+
+    auto allocateOrThrow(std::size_t size) -> void *
+    {
+        if (auto *pointer = allocate(size)) {
+            return pointer;
+        }
+        throw std::bad_alloc{};
+    }
+
+    auto allocateAlignedOrThrow(std::size_t size, std::align_val_t alignment) -> void *
+    {
+        if (auto *pointer = allocateAligned(size, alignment)) {
+            return pointer;
+        }
+        throw std::bad_alloc{};
+    }
+
+} // namespace
+
+namespace mks::test
+{
+
+    auto threadAllocations() noexcept -> uint64_t { return tAllocations; }
+
+    auto threadDeallocations() noexcept -> uint64_t { return tDeallocations; }
+
+} // namespace mks::test
+
+// MARK: Replacements
+
+auto operator new(std::size_t size) -> void * { return allocateOrThrow(size); }
+auto operator new[](std::size_t size) -> void * { return allocateOrThrow(size); }
+
+auto operator new(std::size_t size, const std::nothrow_t &) noexcept -> void *
+{
+    return allocate(size);
+}
+
+auto operator new[](std::size_t size, const std::nothrow_t &) noexcept -> void *
+{
+    return allocate(size);
+}
+
+auto operator new(std::size_t size, std::align_val_t alignment) -> void *
+{
+    return allocateAlignedOrThrow(size, alignment);
+}
+
+auto operator new[](std::size_t size, std::align_val_t alignment) -> void *
+{
+    return allocateAlignedOrThrow(size, alignment);
+}
+
+auto operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+    -> void *
+{
+    return allocateAligned(size, alignment);
+}
+
+auto operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+    -> void *
+{
+    return allocateAligned(size, alignment);
+}
+
+auto operator delete(void *pointer) noexcept -> void { release(pointer); }
+auto operator delete[](void *pointer) noexcept -> void { release(pointer); }
+auto operator delete(void *pointer, std::size_t) noexcept -> void { release(pointer); }
+auto operator delete[](void *pointer, std::size_t) noexcept -> void { release(pointer); }
+auto operator delete(void *pointer, const std::nothrow_t &) noexcept -> void { release(pointer); }
+auto operator delete[](void *pointer, const std::nothrow_t &) noexcept -> void { release(pointer); }
+
+auto operator delete(void *pointer, std::align_val_t) noexcept -> void { releaseAligned(pointer); }
+auto operator delete[](void *pointer, std::align_val_t) noexcept -> void { releaseAligned(pointer); }
+
+auto operator delete(void *pointer, std::size_t, std::align_val_t) noexcept -> void
+{
+    releaseAligned(pointer);
+}
+
+auto operator delete[](void *pointer, std::size_t, std::align_val_t) noexcept -> void
+{
+    releaseAligned(pointer);
+}
+
+auto operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept -> void
+{
+    releaseAligned(pointer);
+}
+
+auto operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept -> void
+{
+    releaseAligned(pointer);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// Heap allocation counting for "this path must not allocate" tests.
+//
+// tests/support/alloc_counter.cpp replaces the global operator new / delete with versions
+// that bump per-thread counters, so a target that wants these numbers adds that file to its
+// add_files() list (once per binary). Counters are per thread: work done by another thread
+// or ilias context never shows up in the calling thread's numbers.
+
+#include <cstdint>
+
+namespace mks::test
+{
+
+    /** @brief Allocations made by the calling thread so far. */
+    auto threadAllocations() noexcept -> uint64_t;
+
+    /** @brief Deallocations made by the calling thread so far. */
+    auto threadDeallocations() noexcept -> uint64_t;
+
+    /**
+     * @brief Counts the calling thread's allocations between construction and allocations().
+     *
+     * Usage:
+     * @code
+     * auto scope = AllocationScope{};
+     * router.handleInputEvent(event);
+     * EXPECT_EQ(scope.allocations(), 0U);
+     * @endcode
+     */
+    class AllocationScope
+    {
+    public:
+        AllocationScope() noexcept
+            : mAllocations(threadAllocations()),
+              mDeallocations(threadDeallocations())
+        {
+        }
+
+        auto allocations() const noexcept -> uint64_t { return threadAllocations() - mAllocations; }
+
+        auto deallocations() const noexcept -> uint64_t
+        {
+            return threadDeallocations() - mDeallocations;
+        }
+
+        /** @brief Start counting again from now. */
+        auto reset() noexcept -> void
+        {
+            mAllocations   = threadAllocations();
+            mDeallocations = threadDeallocations();
+        }
+
+    private:
+        uint64_t mAllocations;
+        uint64_t mDeallocations;
+    };
+
+} // namespace mks::test
@@ -0,0 +1,501 @@
+#pragma once
+
+// In-process network impairment for Server <-> Client tests and benchmarks.
+//
+// ImpairedStream::pair() returns two connected stream ends (usable as ilias::DynStream, so
+// RpcTransport runs on them directly) whose directions each apply an Impairment profile:
+// one-way latency, jitter, a bandwidth cap, TCP-like retransmit delay on "lost" chunks,
+// periodic or manual stalls and a connection reset after N bytes. Scheduling uses a seeded
+// mt19937_64 and a VirtualClock, so a manual clock plus a fixed seed gives the same
+// delivery schedule on every run and platform.
+//
+// ImpairedProxy puts the same model between a real TCP client and server (Client only
+// knows how to dial an endpoint), at the cost of loopback noise.
+
+#include "preinclude.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <ilias/net.hpp>
+#include <memory>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace mks::test
+{
+
+    using namespace std::chrono_literals;
+
+    // Readers and blocked writers re-check their pipe this often (real time).
+    inline constexpr auto kImpairmentPollInterval = 250us;
+
+    /**
+     * @brief Time source for impaired links.
+     *
+     * A manual clock only moves on advance(), which makes latency assertions exact; a
+     * realtime clock follows steady_clock and is what proxies and benchmarks use.
+     */
+    class VirtualClock
+    {
+    public:
+        static auto manual() -> std::shared_ptr<VirtualClock>
+        {
+            return std::shared_ptr<VirtualClock>(new VirtualClock(false));
+        }
+
+        static auto realtime() -> std::shared_ptr<VirtualClock>
+        {
+            return std::shared_ptr<VirtualClock>(new VirtualClock(true));
+        }
+
+        /** @brief Time since the clock was created. */
+        auto now() const -> std::chrono::nanoseconds
+        {
+            if (mRealtime) {
+                return std::chrono::steady_clock::now() - mOrigin;
+            }
+            return mNow;
+        }
+
+        auto advance(std::chrono::nanoseconds duration) -> void
+        {
+            if (mRealtime) {
+                throw std::logic_error("cannot advance a realtime VirtualClock");
+            }
+            mNow += duration;
+        }
+
+        auto sleepUntil(std::chrono::nanoseconds deadline) const -> Task<void>
+        {
+            while (now() < deadline) {
+                co_await ilias::sleep(mRealtime ? deadline - now() : kImpairmentPollInterval);
+            }
+        }
+
+    private:
+        explicit VirtualClock(bool realtime) : mRealtime(realtime) {}
+
+        bool                                  mRealtime;
+        std::chrono::steady_clock::time_point mOrigin = std::chrono::steady_clock::now();
+        std::chrono::nanoseconds              mNow{};
+    };
+
+    /** @brief One direction of a link. Zero / default fields disable that impairment. */
+    struct Impairment {
+        std::chrono::nanoseconds latency{};                // One-way delay added to every chunk
+        std::chrono::nanoseconds jitter{};                 // Extra uniform delay in [0, jitter]
+        uint64_t                 bytesPerSecond = 0;       // Link rate; 0 is unlimited
+        double                   lossRate       = 0;       // Chance a chunk needs a retransmit
+        std::chrono::nanoseconds retransmitDelay = 200ms;  // Added per lost chunk (TCP min RTO)
+        std::chrono::nanoseconds stallEvery{};             // Periodic stall period; 0 disables
+        std::chrono::nanoseconds stallFor{};               // Nothing delivered for this long each period
+        uint64_t                 resetAfterBytes = 0;      // Reset the link once this many bytes went out
+        size_t                   bufferBytes = 64 * 1024;  // In-flight bytes before write() blocks
+    };
+
+    namespace detail
+    {
+
+        struct ImpairedChunk {
+            std::vector<std::byte>   bytes;
+            size_t                   offset = 0;
+            std::chrono::nanoseconds deliverAt{};
+        };
+
+        // One direction: written by one end, read by the other.
+        struct ImpairedPipe {
+            Impairment                    profile;
+            std::shared_ptr<VirtualClock> clock;
+            std::mt19937_64               random;
+            std::deque<ImpairedChunk>     chunks;
+            size_t                        buffered = 0;
+            uint64_t                      written  = 0;
+            std::chrono::nanoseconds      linkFree{};
+            std::chrono::nanoseconds      lastDelivery{};
+            std::chrono::nanoseconds      stallUntil{};
+            bool                          eof    = false; // Writer shut down or dropped
+            bool                          closed = false; // Reader dropped
+            bool                          reset  = false;
+
+            // Only raw engine output is used (no std distributions), so a seed maps to the
+            // same schedule with every standard library.
+            auto chance(double rate) -> bool
+            {
+                return rate > 0 && static_cast<double>(random() >> 11) * 0x1.0p-53 < rate;
+            }
+
+            auto schedule(size_t size) -> std::chrono::nanoseconds
+            {
+                const auto now   = clock->now();
+                const auto start = std::max(now, linkFree);
+                auto       sendNs = std::chrono::nanoseconds{};
+                if (profile.bytesPerSecond > 0) {
+                    sendNs = std::chrono::nanoseconds{
+                        static_cast<int64_t>(size * 1'000'000'000ULL / profile.bytesPerSecond)};
+                }
+                linkFree = start + sendNs;
+
+                auto at = linkFree + profile.latency;
+                if (profile.jitter > 0ns) {
+                    at += std::chrono::nanoseconds{static_cast<int64_t>(
+                        random() % (static_cast<uint64_t>(profile.jitter.count()) + 1))};
+                }
+                if (chance(profile.lossRate)) {
+                    at += profile.retransmitDelay;
+                }
+                at = std::max(at, stallUntil);
+                if (profile.stallEvery > 0ns && profile.stallFor > 0ns) {
+                    const auto phase = at % profile.stallEvery;
+                    if (phase < profile.stallFor) {
+                        at += profile.stallFor - phase;
+                    }
+                }
+                // A byte stream never reorders: jitter only ever stretches gaps.
+                at           = std::max(at, lastDelivery);
+                lastDelivery = at;
+                return at;
+            }
+        };
+
+        inline auto resetError() -> std::error_code
+        {
+            return std::make_error_code(std::errc::connection_reset);
+        }
+
+    } // namespace detail
+
+    /**
+     * @brief One end of an impaired in-memory link.
+     *
+     * Reads see the peer's writes no earlier than their scheduled delivery time. Writes
+     * complete as soon as the direction has buffer space, like a socket send buffer, so
+     * a slow or stalled link back-pressures the writer after Impairment::bufferBytes.
+     */
+    class ImpairedStream
+    {
+    public:
+        /**
+         * @brief Create two connected ends.
+         *
+         * @param aToB Applied to bytes written on the first end.
+         * @param bToA Applied to bytes written on the second end.
+         */
+        static auto pair(Impairment aToB, Impairment bToA, std::shared_ptr<VirtualClock> clock,
+                         uint64_t seed = 1) -> std::pair<ImpairedStream, ImpairedStream>
+        {
+            auto forward  = std::make_shared<detail::ImpairedPipe>();
+            auto backward = std::make_shared<detail::ImpairedPipe>();
+            forward->profile  = aToB;
+            forward->clock    = clock;
+            forward->random   = std::mt19937_64{seed};
+            backward->profile = bToA;
+            backward->clock   = clock;
+            backward->random  = std::mt19937_64{seed ^ 0x9e3779b97f4a7c15ULL};
+            return {ImpairedStream{backward, forward}, ImpairedStream{forward, backward}};
+        }
+
+        ImpairedStream(ImpairedStream &&) noexcept = default;
+        auto operator=(ImpairedStream &&) noexcept -> ImpairedStream & = default;
+
+        ~ImpairedStream()
+        {
+            if (mOut) {
+                mOut->eof = true;
+            }
+            if (mIn) {
+                mIn->closed = true;
+            }
+        }
+
+        auto read(ilias::MutableBuffer buffer) -> IoTask<size_t>
+        {
+            while (true) {
+                if (mIn->reset) {
+                    co_return Err(detail::resetError());
+                }
+                if (buffer.empty()) {
+                    co_return 0;
+                }
+                if (mIn->chunks.empty()) {
+                    if (mIn->eof) {
+                        co_return 0;
+                    }
+                    co_await ilias::sleep(kImpairmentPollInterval);
+                    continue;
+                }
+                const auto deliverAt = mIn->chunks.front().deliverAt;
+                if (mIn->clock->now() < deliverAt) {
+                    co_await mIn->clock->sleepUntil(deliverAt);
+                    continue;
+                }
+                auto      &chunk = mIn->chunks.front();
+                const auto count = std::min(buffer.size(), chunk.bytes.size() - chunk.offset);
+                std::memcpy(buffer.data(), chunk.bytes.data() + chunk.offset, count);
+                chunk.offset += count;
+                mIn->buffered -= count;
+                if (chunk.offset == chunk.bytes.size()) {
+                    mIn->chunks.pop_front();
+                }
+                co_return count;
+            }
+        }
+
+        auto write(ilias::Buffer buffer) -> IoTask<size_t>
+        {
+            while (true) {
+                if (mOut->reset) {
+                    co_return Err(detail::resetError());
+                }
+                if (mOut->closed || mOut->eof) {
+                    co_return Err(std::make_error_code(std::errc::broken_pipe));
+                }
+                if (buffer.empty()) {
+                    co_return 0;
+                }
+                const auto limit = mOut->profile.resetAfterBytes;
+                if (limit > 0 && mOut->written >= limit) {
+                    reset();
+                    co_return Err(detail::resetError());
+                }
+                if (mOut->buffered >= mOut->profile.bufferBytes) {
+                    co_await ilias::sleep(kImpairmentPollInterval);
+                    continue;
+                }
+                auto count = std::min(buffer.size(), mOut->profile.bufferBytes - mOut->buffered);
+                if (limit > 0) {
+                    count = std::min<size_t>(count, limit - mOut->written);
+                }
+                mOut->chunks.push_back(detail::ImpairedChunk{
+                    .bytes     = {buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(count)},
+                    .deliverAt = mOut->schedule(count),
+                });
+                mOut->buffered += count;
+                mOut->written += count;
+                co_return count;
+            }
+        }
+
+        auto flush() -> IoTask<void>
+        {
+            co_return {};
+        }
+
+        /** @brief Half-close: the peer reads EOF once everything already written is delivered. */
+        auto shutdown() -> IoTask<void>
+        {
+            mOut->eof = true;
+            co_return {};
+        }
+
+        /** @brief Bytes the next read() would return without waiting. */
+        auto available() const -> size_t
+        {
+            auto       total = size_t{0};
+            const auto now   = mIn->clock->now();
+            for (const auto &chunk : mIn->chunks) {
+                if (chunk.deliverAt > now) {
+                    break;
+                }
+                total += chunk.bytes.size() - chunk.offset;
+            }
+            return total;
+        }
+
+        /** @brief Delivery times of everything still in flight towards this end. */
+        auto pendingDeliveries() const -> std::vector<std::chrono::nanoseconds>
+        {
+            auto result = std::vector<std::chrono::nanoseconds>{};
+            for (const auto &chunk : mIn->chunks) {
+                result.push_back(chunk.deliverAt);
+            }
+            return result;
+        }
+
+        /** @brief Deliver nothing written from now on by this end for @p duration. */
+        auto stall(std::chrono::nanoseconds duration) -> void
+        {
+            mOut->stallUntil = std::max(mOut->stallUntil, mOut->clock->now() + duration);
+        }
+
+        /** @brief Fail both directions with connection_reset; in-flight bytes are discarded. */
+        auto reset() -> void
+        {
+            for (auto *pipe : {mIn.get(), mOut.get()}) {
+                pipe->reset = true;
+                pipe->chunks.clear();
+                pipe->buffered = 0;
+            }
+        }
+
+    private:
+        ImpairedStream(std::shared_ptr<detail::ImpairedPipe> in,
+                       std::shared_ptr<detail::ImpairedPipe> out)
+            : mIn(std::move(in)), mOut(std::move(out))
+        {
+        }
+
+        std::shared_ptr<detail::ImpairedPipe> mIn;
+        std::shared_ptr<detail::ImpairedPipe> mOut;
+    };
+
+    /**
+     * @brief TCP proxy applying an impaired link to every connection it forwards.
+     *
+     * Point a Client at @p listen and the Server at @p upstream. Each accepted connection
+     * gets its own link seeded with seed + connection index.
+     */
+    class ImpairedProxy
+    {
+    public:
+        ImpairedProxy(IPEndpoint listen, IPEndpoint upstream, Impairment toUpstream,
+                      Impairment toDownstream, std::shared_ptr<VirtualClock> clock = VirtualClock::realtime(),
+                      uint64_t seed = 1)
+            : mListen(std::move(listen)), mUpstream(std::move(upstream)), mToUpstream(toUpstream),
+              mToDownstream(toDownstream), mClock(std::move(clock)), mSeed(seed)
+        {
+        }
+
+        /** @brief Accept and forward until cancelled; cancelling closes every forwarded connection. */
+        auto run() -> IoTask<void>
+        {
+            ILIAS_CO_TRY(auto listener, co_await ilias::TcpListener::bind(mListen));
+            co_await ilias::TaskScope::enter([&](auto &scope) -> Task<void> {
+                while (true) {
+                    auto incoming = co_await listener.accept();
+                    if (!incoming) {
+                        co_return;
+                    }
+                    auto &[stream, endpoint] = *incoming;
+                    (void)endpoint;
+                    scope.spawn(forward(std::move(stream), mSeed + mConnections++));
+                }
+            });
+            co_return {};
+        }
+
+        /** @brief Connections accepted so far. */
+        auto connections() const -> uint64_t { return mConnections; }
+
+        /** @brief Stall both directions of every live connection for @p duration. */
+        auto stall(std::chrono::nanoseconds duration) -> void
+        {
+            for (auto &link : mLinks) {
+                link.near->stall(duration);
+                link.far->stall(duration);
+            }
+        }
+
+        /**
+         * @brief Reset every live connection.
+         *
+         * Both sockets are dropped. Whatever the proxy had not read yet from a socket
+         * (say the server kept writing into a stalled link) makes the kernel close it
+         * with RST, so that side sees a broken connection rather than an EOF.
+         */
+        auto reset() -> void
+        {
+            for (auto &link : mLinks) {
+                link.near->reset();
+            }
+        }
+
+    private:
+        // The two ends of one forwarded connection, while forward() runs.
+        struct Link {
+            ImpairedStream *near;
+            ImpairedStream *far;
+        };
+
+        // Pumps reset the link on any failure so the pumps blocked on it stop as well.
+        static auto copyInto(ilias::TcpStream &from, ImpairedStream &to) -> Task<void>
+        {
+            auto buffer = std::vector<std::byte>(16 * 1024);
+            while (true) {
+                auto count = co_await from.read(buffer);
+                if (!count) {
+                    to.reset();
+                    co_return;
+                }
+                if (*count == 0) {
+                    (void)co_await to.shutdown();
+                    co_return;
+                }
+                for (auto offset = size_t{0}; offset < *count;) {
+                    auto written = co_await to.write(std::span{buffer}.subspan(offset, *count - offset));
+                    if (!written) {
+                        co_return;
+                    }
+                    offset += *written;
+                }
+            }
+        }
+
+        static auto copyOut(ImpairedStream &from, ilias::TcpStream &to) -> Task<void>
+        {
+            auto buffer = std::vector<std::byte>(16 * 1024);
+            while (true) {
+                auto count = co_await from.read(buffer);
+                if (!count) {
+                    co_return;
+                }
+                if (*count == 0) {
+                    (void)co_await to.shutdown();
+                    co_return;
+                }
+                for (auto offset = size_t{0}; offset < *count;) {
+                    auto written = co_await to.write(std::span{buffer}.subspan(offset, *count - offset));
+                    if (!written || *written == 0) {
+                        from.reset();
+                        co_return;
+                    }
+                    offset += *written;
+                }
+            }
+        }
+
+        auto forward(ilias::TcpStream downstream, uint64_t seed) -> Task<void>
+        {
+            auto upstream = co_await ilias::TcpStream::connect(mUpstream);
+            if (!upstream) {
+                co_return;
+            }
+            (void)downstream.setOption(ilias::sockopt::TcpNoDelay(true));
+            (void)upstream->setOption(ilias::sockopt::TcpNoDelay(true));
+            auto [near, far] = ImpairedStream::pair(mToUpstream, mToDownstream, mClock, seed);
+            mLinks.push_back(Link{&near, &far});
+            auto unlink = Unlink{mLinks, &near};
+            // The first direction to finish (EOF or reset) ends the connection; dropping the
+            // sockets closes both sides.
+            co_await ilias::whenAny(
+                ilias::whenAll(copyInto(downstream, near), copyOut(far, *upstream)),
+                ilias::whenAll(copyInto(*upstream, far), copyOut(near, downstream)));
+        }
+
+        // Cancellation skips the end of forward(), so the link leaves mLinks from here.
+        struct Unlink {
+            std::vector<Link> &links;
+            ImpairedStream    *near;
+
+            ~Unlink()
+            {
+                std::erase_if(links, [&](const Link &link) { return link.near == near; });
+            }
+        };
+
+        IPEndpoint                    mListen;
+        IPEndpoint                    mUpstream;
+        Impairment                    mToUpstream;
+        Impairment                    mToDownstream;
+        std::shared_ptr<VirtualClock> mClock;
+        uint64_t                      mSeed;
+        uint64_t                      mConnections = 0;
+        std::vector<Link>             mLinks;
+    };
+
+} // namespace mks::test
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "platform/platform.hpp"
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <filesystem>
+#include <functional>
 #include <ilias/sync.hpp>
 #include <mutex>
 #include <optional>
@@ -546,6 +549,7 @@ namespace mks::test
         {
             auto lock    = std::scoped_lock(mMutex);
             mInitialized = true;
+            ++mInitializeCount;
             co_return {};
         }
 
@@ -558,20 +562,47 @@ namespace mks::test
 
         auto inject(const InputEvent &event) -> IoTask<void> override
         {
-            auto lock = std::scoped_lock(mMutex);
-            if (!mInitialized) {
-                throw std::runtime_error("MockInputInjector::inject called before initialize");
-            }
-            mEvents.push_back(event);
+            record(event);
             co_return {};
         }
 
+        auto tryInject(const InputEvent &event) -> std::optional<IoResult<void>> override
+        {
+            if (mDeferTryInject) {
+                return std::nullopt;
+            }
+            record(event);
+            return IoResult<void>{};
+        }
+
+        // Make tryInject() always defer so callers exercise the inject() fallback.
+        auto setDeferTryInject(bool defer) -> void { mDeferTryInject = defer; }
+
+        // Called after each recorded injection, e.g. to timestamp it in benchmarks.
+        auto setObserver(std::function<void(const InputEvent &)> observer) -> void
+        {
+            auto lock = std::scoped_lock(mMutex);
+            mObserver = std::move(observer);
+        }
+
         auto events() const -> std::vector<InputEvent>
         {
             auto lock = std::scoped_lock(mMutex);
             return mEvents;
         }
 
+        auto initialized() const -> bool
+        {
+            auto lock = std::scoped_lock(mMutex);
+            return mInitialized;
+        }
+
+        auto initializeCount() const -> uint32_t
+        {
+            auto lock = std::scoped_lock(mMutex);
+            return mInitializeCount;
+        }
+
         auto clear() -> void
         {
             auto lock = std::scoped_lock(mMutex);
@@ -579,16 +610,131 @@ namespace mks::test
         }
 
     private:
-        mutable std::mutex      mMutex;
-        bool                    mInitialized = false;
-        std::vector<InputEvent> mEvents;
+        auto record(const InputEvent &event) -> void
+        {
+            auto lock = std::scoped_lock(mMutex);
+            if (!mInitialized) {
+                throw std::runtime_error("MockInputInjector::inject called before initialize");
+            }
+            mEvents.push_back(event);
+            if (mObserver) {
+                mObserver(event);
+            }
+        }
+
+        mutable std::mutex                      mMutex;
+        bool                                    mInitialized     = false;
+        uint32_t                                mInitializeCount = 0;
+        std::atomic<bool>                       mDeferTryInject  = false;
+        std::vector<InputEvent>                 mEvents;
+        std::function<void(const InputEvent &)> mObserver;
+    };
+
+    // Clipboard backed by memory. copy() plays a local application copying,
+    // paste() one pasting whatever publish() made available.
+    class MockClipboard final : public Clipboard {
+    public:
+        auto initialize() -> IoTask<void> override
+        {
+            auto [sender, receiver] = ilias::mpsc::channel<ClipboardOffer>(16);
+            mSender                 = std::move(sender);
+            mReceiver               = std::move(receiver);
+            co_return {};
+        }
+
+        auto shutdown() -> Task<void> override
+        {
+            mSender   = {};
+            mReceiver = {};
+            co_return;
+        }
+
+        auto nextOffer() -> IoTask<ClipboardOffer> override
+        {
+            if (auto offer = co_await mReceiver.recv()) {
+                co_return std::move(*offer);
+            }
+            co_return Err(std::make_error_code(std::errc::operation_canceled));
+        }
+
+        auto read(std::string mime) -> IoTask<std::vector<std::byte>> override
+        {
+            ++mReads;
+            for (const auto &content : mContents) {
+                if (content.mime == mime) {
+                    co_return content.bytes;
+                }
+            }
+            co_return Err(std::make_error_code(std::errc::invalid_argument));
+        }
+
+        auto publish(ClipboardOffer offer, Fetch fetch) -> IoResult<void> override
+        {
+            mPublished = std::move(offer);
+            mFetch     = std::move(fetch);
+            return {};
+        }
+
+        auto copy(std::vector<ClipboardContent> contents) -> bool
+        {
+            if (!mSender) {
+                return false;
+            }
+            mContents = std::move(contents);
+            return static_cast<bool>(mSender.trySend(makeClipboardOffer(mContents)));
+        }
+
+        auto paste(std::string mime) -> IoTask<std::vector<std::byte>>
+        {
+            if (!mFetch) {
+                co_return Err(std::make_error_code(std::errc::no_message));
+            }
+            co_return co_await mFetch(std::move(mime));
+        }
+
+        auto published() const -> std::optional<ClipboardOffer> { return mPublished; }
+
+        // How many times the bytes of a local copy were read.
+        auto reads() const -> uint32_t { return mReads; }
+
+    private:
+        ilias::mpsc::Sender<ClipboardOffer>   mSender;
+        ilias::mpsc::Receiver<ClipboardOffer> mReceiver;
+        std::vector<ClipboardContent>         mContents;
+        std::optional<ClipboardOffer>         mPublished;
+        Fetch                                 mFetch;
+        uint32_t                              mReads = 0;
+    };
+
+    // Drag source backed by memory. drag() plays a file manager dragging
+    // files until release() clears it.
+    class MockDragSource final : public DragSource {
+    public:
+        auto draggedFiles() -> IoTask<std::vector<std::filesystem::path>> override
+        {
+            ++mQueries;
+            co_return mFiles;
+        }
+
+        auto drag(std::vector<std::filesystem::path> files) -> void { mFiles = std::move(files); }
+
+        auto release() -> void { mFiles.clear(); }
+
+        // How many times the server asked what is being dragged.
+        auto queries() const -> uint32_t { return mQueries; }
+
+    private:
+        std::vector<std::filesystem::path> mFiles;
+        uint32_t                           mQueries = 0;
     };
 
     class MockPlatform final : public Platform {
     public:
         explicit MockPlatform(std::vector<ScreenInfo> screens)
             : mScreens(std::move(screens)), mCapture(std::make_shared<MockInputCapture>()),
-              mInjector(std::make_shared<MockInputInjector>())
+              mInjector(std::make_shared<MockInputInjector>()),
+              mClipboard(std::make_shared<MockClipboard>()),
+              mDragSource(std::make_shared<MockDragSource>())
         {
         }
 
@@ -608,10 +754,30 @@ namespace mks::test
 
         auto createInjector() -> InputInjector::Ptr override { return mInjector; }
 
+        auto createClipboard() -> Clipboard::Ptr override { return mClipboard; }
+
+        auto createDragSource() -> DragSource::Ptr override { return mDragSource; }
+
+        // Same as the default but fast enough that setScreens() is seen within a test.
+        auto nextScreenChange(std::vector<ScreenInfo> known) -> IoTask<ScreenChangeEvent> override
+        {
+            using namespace std::chrono_literals;
+            while (true) {
+                if (auto current = screens(); current != known) {
+                    co_return ScreenChangeEvent{.screens = std::move(current)};
+                }
+                co_await ilias::sleep(5ms);
+            }
+        }
+
         auto capture() const -> std::shared_ptr<MockInputCapture> { return mCapture; }
 
         auto injector() const -> std::shared_ptr<MockInputInjector> { return mInjector; }
 
+        auto clipboard() const -> std::shared_ptr<MockClipboard> { return mClipboard; }
+
+        auto dragSource() const -> std::shared_ptr<MockDragSource> { return mDragSource; }
+
         auto actions() -> MockActions & { return mActions; }
 
         auto expect() -> MockExpectations & { return mExpectations; }
@@ -678,6 +844,8 @@ namespace mks::test
         std::vector<ScreenInfo>            mScreens;
         std::shared_ptr<MockInputCapture>  mCapture;
         std::shared_ptr<MockInputInjector> mInjector;
+        std::shared_ptr<MockClipboard>     mClipboard;
+        std::shared_ptr<MockDragSource>    mDragSource;
         MockActions                        mActions;
         MockExpectations                   mExpectations;
     };
@@ -0,0 +1,289 @@
+// Steady-state allocation guards for the per-event input path.
+//
+// Routing a motion event on the server must not touch the heap at all. Transport framing and
+// the client receive path still allocate per message (the transport coroutines, JSON
+// serializer state); their ceilings below catch regressions and should only ever go down.
+
+#include "app/client.hpp"
+#include "app/server_input.hpp"
+#include "app/server_screens.hpp"
+#include "rpc/message.hpp"
+#include "rpc/transport.hpp"
+#include "support/alloc_counter.hpp"
+#include "support/mock_platform.hpp"
+
+#include <gtest/gtest.h>
+#include <ilias/testing.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// Events run before counting starts: first-use statics, metric registration,
+// flight recorder rings and channel / buffer capacity all settle here.
+constexpr auto kWarmupEvents = 64U;
+constexpr auto kMeasuredEvents = 512U;
+
+// Per-message ceilings for paths that are not allocation free yet.
+constexpr auto kTransportRoundTripBudget = 48U;
+constexpr auto kClientReceiveBudget = 48U;
+
+constexpr uint16_t kClientTestPort = 30251;
+constexpr uint16_t kDeferredTestPort = 30253;
+
+auto makeEndpoint(uint16_t port) -> mks::IPEndpoint {
+    auto endpoint = mks::IPEndpoint::fromString(fmtlib::format("127.0.0.1:{}", port));
+    if (!endpoint) {
+        throw std::runtime_error("invalid test endpoint");
+    }
+    return *endpoint;
+}
+
+auto makeScreen(std::string name, int32_t width, int32_t height) -> mks::ScreenInfo {
+    return mks::ScreenInfo {
+        .x = 0,
+        .y = 0,
+        .width = width,
+        .height = height,
+        .dpi = 96,
+        .name = std::move(name),
+        .primary = true,
+    };
+}
+
+// Small back-and-forth moves that never reach an edge of a 2560x1440 screen.
+auto inScreenMove(uint32_t sequence) -> mks::InputEvent {
+    const auto delta = sequence % 2 == 0 ? 3 : -3;
+    return mks::MouseMoveEvent {
+        .x = 960,
+        .y = 540,
+        .screenIndex = 0,
+        .deltaX = delta,
+        .deltaY = -delta,
+    };
+}
+
+auto inputMessage(uint32_t sequence) -> mks::RpcMessage {
+    return mks::RpcMessage {mks::InputMessage {
+        .event = mks::MouseMoveEvent {
+            .x = static_cast<int32_t>(sequence % 1000),
+            .y = 240,
+            .screenIndex = 0,
+        },
+    }};
+}
+
+// Plays the server for one Client: accepts it, reads Hello / Screens, sends
+// `count` InputMessages and hangs up. Runs on its own thread and context so
+// none of its allocations land in the client thread's counters.
+auto serveInputMessages(uint16_t port, uint32_t count, std::atomic<bool> &listening) -> void {
+    auto context = ilias::PlatformContext {};
+    context.install();
+
+    auto body = [&]() -> mks::IoTask<void> {
+        ILIAS_CO_TRY(auto listener, co_await ilias::TcpListener::bind(makeEndpoint(port)));
+        listening = true;
+        ILIAS_CO_TRY(auto incoming, co_await listener.accept());
+        auto &[stream, endpoint] = incoming;
+        (void) endpoint;
+        auto transport = mks::RpcTransport {std::move(stream)};
+        ILIAS_CO_TRYV(co_await transport.readMessage()); // Hello
+        ILIAS_CO_TRYV(co_await transport.readMessage()); // Screens
+        for (auto sequence = 0U; sequence < count; ++sequence) {
+            ILIAS_CO_TRYV(co_await transport.writeMessage(inputMessage(sequence)));
+        }
+        ILIAS_CO_TRYV(co_await transport.shutdown());
+        co_return {};
+    };
+    if (auto result = body().wait(); !result) {
+        ADD_FAILURE() << "test server failed: " << result.error().message();
+        listening = true;
+    }
+}
+
+} // namespace
+
+// MARK: Counter
+
+TEST(AllocationCounter, CountsCallingThreadOnly) {
+    auto scope = mks::test::AllocationScope {};
+    auto values = std::make_unique<std::vector<int>>(16);
+    EXPECT_EQ(scope.allocations(), 2U);
+
+    auto otherThread = uint64_t {0};
+    scope.reset();
+    std::thread {[&] {
+        auto inner = mks::test::AllocationScope {};
+        auto text = std::string(256, 'x');
+        otherThread = inner.allocations();
+    }}.join();
+    EXPECT_EQ(otherThread, 1U);
+
+    scope.reset();
+    values.reset();
+    EXPECT_EQ(scope.allocations(), 0U);
+    EXPECT_EQ(scope.deallocations(), 2U);
+}
+
+// MARK: Server routing
+
+ILIAS_TEST(AllocationGuard, RemoteMotionRoutingDoesNotAllocate) {
+    auto screenStore = mks::ServerScreenStore {};
+    auto senders = mks::ServerInputRouter::ClientSenders {};
+    auto input = mks::ServerInputRouter {screenStore, senders};
+    auto [sender, receiver] = ilias::mpsc::channel<mks::RpcMessage>(16);
+
+    const auto localEndpoint = makeEndpoint(30250);
+    const auto remoteEndpoint = makeEndpoint(30252);
+    // Owner ids longer than any small-string buffer, so a stray copy shows up.
+    screenStore.registerScreens(
+        localEndpoint, "machine-allocation-guard-local-0123456789", {makeScreen("local", 1920, 1080)}, true
+    );
+    input.ensureActiveLocalScreen(true);
+    screenStore.registerScreens(
+        remoteEndpoint, "machine-allocation-guard-remote-0123456789", {makeScreen("remote", 2560, 1440)}, false
+    );
+    senders[remoteEndpoint] = sender;
+
+    // Cross the right edge onto the remote screen.
+    input.handleInputEvent(mks::MouseMoveEvent {.x = 1919, .y = 540, .screenIndex = 0});
+    input.handleInputEvent(mks::MouseMoveEvent {.x = 1929, .y = 540, .screenIndex = 0, .deltaX = 10});
+    EXPECT_TRUE(input.activeScreenKey().has_value());
+    if (!input.activeScreenKey() || input.activeScreenKey()->ownerId.find("remote") == std::string::npos) {
+        ADD_FAILURE() << "router did not enter the remote screen";
+        co_return;
+    }
+    (void) co_await receiver.recv(); // Entry move
+    (void) co_await receiver.recv();
+
+    for (auto sequence = 0U; sequence < kWarmupEvents; ++sequence) {
+        input.handleInputEvent(inScreenMove(sequence));
+        (void) co_await receiver.recv();
+    }
+
+    // Only the router call is counted; draining the channel is the session's cost.
+    auto allocations = uint64_t {0};
+    for (auto sequence = 0U; sequence < kMeasuredEvents; ++sequence) {
+        auto scope = mks::test::AllocationScope {};
+        input.handleInputEvent(inScreenMove(sequence));
+        allocations += scope.allocations();
+        auto message = co_await receiver.recv();
+        EXPECT_TRUE(static_cast<bool>(message));
+    }
+    // The channel may grow its storage now and then; anything per event would
+    // add up to at least kMeasuredEvents.
+    EXPECT_LT(allocations, kMeasuredEvents / 8) << allocations << " allocations over " << kMeasuredEvents
+                                                << " routed events";
+}
+
+// MARK: Transport
+
+ILIAS_TEST(AllocationGuard, InputMessageFramingStaysWithinBudget) {
+    auto [clientStream, serverStream] = ilias::DuplexStream::make(64 * 1024);
+    auto writer = mks::RpcTransport {std::move(clientStream)};
+    auto reader = mks::RpcTransport {std::move(serverStream)};
+
+    auto roundTrip = [&](uint32_t sequence) -> mks::IoTask<void> {
+        ILIAS_CO_TRYV(co_await writer.writeMessage(inputMessage(sequence)));
+        ILIAS_CO_TRY(auto message, co_await reader.readMessage());
+        if (!std::holds_alternative<mks::InputMessage>(message)) {
+            co_return mks::Err(mks::RpcError::ProtocolError);
+        }
+        co_return {};
+    };
+
+    for (auto sequence = 0U; sequence < kWarmupEvents; ++sequence) {
+        auto result = co_await roundTrip(sequence);
+        EXPECT_TRUE(result.has_value());
+    }
+
+    auto scope = mks::test::AllocationScope {};
+    for (auto sequence = 0U; sequence < kMeasuredEvents; ++sequence) {
+        auto result = co_await roundTrip(sequence);
+        EXPECT_TRUE(result.has_value());
+    }
+    const auto perMessage = scope.allocations() / kMeasuredEvents;
+    testing::Test::RecordProperty("allocations_per_message", std::to_string(perMessage));
+    EXPECT_LE(perMessage, kTransportRoundTripBudget);
+}
+
+// MARK: Client
+
+ILIAS_TEST(AllocationGuard, ClientReceivePathStaysWithinBudget) {
+    constexpr auto kTotal = kWarmupEvents + kMeasuredEvents;
+    auto listening = std::atomic<bool> {false};
+    auto server = std::jthread {[&] {
+        serveInputMessages(kClientTestPort, kTotal, listening);
+    }};
+    while (!listening) {
+        co_await ilias::sleep(1ms);
+    }
+
+    auto platform = std::make_shared<mks::test::MockPlatform>(std::vector {makeScreen("client", 1920, 1080)});
+    auto injected = uint32_t {0};
+    auto startCount = uint64_t {0};
+    auto endCount = uint64_t {0};
+    // Runs inside tryInject() on this thread; reading a counter does not allocate.
+    platform->injector()->setObserver([&](const mks::InputEvent &) {
+        ++injected;
+        if (injected == kWarmupEvents) {
+            startCount = mks::test::threadAllocations();
+        }
+        else if (injected == kTotal) {
+            endCount = mks::test::threadAllocations();
+        }
+    });
+
+    auto client = mks::Client {platform, makeEndpoint(kClientTestPort)};
+    // Returns once the server hangs up after the last message.
+    (void) co_await client.run();
+
+    EXPECT_EQ(injected, kTotal);
+    if (injected != kTotal) {
+        co_return;
+    }
+    const auto perMessage = (endCount - startCount) / (kTotal - kWarmupEvents);
+    testing::Test::RecordProperty("allocations_per_message", std::to_string(perMessage));
+    EXPECT_LE(perMessage, kClientReceiveBudget);
+}
+
+ILIAS_TEST(AllocationGuard, ClientFallsBackWhenInjectorDefers) {
+    constexpr auto kCount = 32U;
+    auto listening = std::atomic<bool> {false};
+    auto server = std::jthread {[&] {
+        serveInputMessages(kDeferredTestPort, kCount, listening);
+    }};
+    while (!listening) {
+        co_await ilias::sleep(1ms);
+    }
+
+    auto platform = std::make_shared<mks::test::MockPlatform>(std::vector {makeScreen("client", 1920, 1080)});
+    platform->injector()->setDeferTryInject(true);
+    auto client = mks::Client {platform, makeEndpoint(kDeferredTestPort)};
+    (void) co_await client.run();
+
+    const auto events = platform->injector()->events();
+    EXPECT_EQ(events.size(), kCount);
+    for (auto sequence = 0U; sequence < events.size(); ++sequence) {
+        const auto *move = std::get_if<mks::MouseMoveEvent>(&events[sequence]);
+        EXPECT_NE(move, nullptr);
+        if (move) {
+            EXPECT_EQ(move->x, static_cast<int32_t>(sequence));
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    ILIAS_TEST_SETUP_UTF8();
+    ilias::PlatformContext context {};
+    context.install();
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,9 +1,13 @@
+#include "config/backend_cache.hpp"
 #include "platform/backend.hpp"
 #include "support/mock_platform.hpp"
 
 #include <gtest/gtest.h>
 #include <ilias/testing.hpp>
 
+#include <chrono>
+#include <filesystem>
+
 namespace
 {
 
@@ -41,6 +45,87 @@ namespace
         };
     }
 
+    // Probe bookkeeping for the reuse / capability / concurrency tests.
+    auto gCreated        = 0;
+    auto gAbsentFullRuns = 0;
+    auto gRendezvous     = false;
+    auto gArrived        = 0;
+    auto gPeersSeen      = 0;
+
+    // With gRendezvous set, waits (bounded) until another check has arrived:
+    // only possible when checks run concurrently.
+    auto meetPeer() -> mks::Task<void>
+    {
+        if (!gRendezvous) {
+            co_return;
+        }
+        ++gArrived;
+        for (auto attempt = 0; attempt < 100 && gArrived < 2; ++attempt) {
+            co_await ilias::sleep(std::chrono::milliseconds{5});
+        }
+        if (gArrived >= 2) {
+            ++gPeersSeen;
+        }
+    }
+
+    auto countingCreate() -> mks::Platform::Ptr
+    {
+        ++gCreated;
+        return makePlatform();
+    }
+
+    auto probedCheck() -> mks::Task<mks::BackendCheck>
+    {
+        co_await meetPeer();
+        co_return co_await mks::probeBackend("Test probed", countingCreate);
+    }
+
+    auto probedCapabilities() -> mks::Task<mks::BackendCheck>
+    {
+        co_return mks::assumedBackendCheck("test session present");
+    }
+
+    auto absentCheck() -> mks::Task<mks::BackendCheck>
+    {
+        ++gAbsentFullRuns;
+        co_await meetPeer();
+        co_return mks::BackendCheck{.available = false, .detail = "absent backend"};
+    }
+
+    auto absentCapabilities() -> mks::Task<mks::BackendCheck>
+    {
+        co_return mks::BackendCheck{
+            .available = false,
+            .detail    = "no session",
+            .probe     = mks::BackendProbe::Capabilities,
+        };
+    }
+
+    auto cachePath(std::string_view name) -> std::filesystem::path
+    {
+        auto path = std::filesystem::temp_directory_path() / name;
+        std::filesystem::remove(path);
+        return path;
+    }
+
+    // Cache entry for the current session naming @p backend.
+    auto writeCache(const std::filesystem::path &path, std::string_view backend,
+                    mks::BackendEnvironment environment = mks::currentBackendEnvironment())
+        -> void
+    {
+        const auto check = mks::BackendCheck{.available = true, .detail = "cached"};
+        const auto saved = mks::saveBackendCache(
+            path, mks::makeBackendCacheEntry(std::move(environment),
+                                             mks::BackendRequirement::Screens, backend, check));
+        EXPECT_TRUE(saved.has_value());
+    }
+
+    auto cachedName(const std::filesystem::path &path) -> std::string
+    {
+        auto entry = mks::loadBackendCache(path);
+        return entry ? entry->backend : std::string{};
+    }
+
     const mks::BackendRegistration kPartialRegistration{
         mks::BackendDescriptor{
                                .name        = "test-partial",
@@ -61,12 +146,36 @@ namespace
                                }
     };
 
+    const mks::BackendRegistration kProbedRegistration{
+        mks::BackendDescriptor{
+                               .name         = "test-probed",
+                               .displayName  = "Test probed",
+                               .order        = 30,
+                               .check        = probedCheck,
+                               .create       = countingCreate,
+                               .capabilities = probedCapabilities,
+                               }
+    };
+
+    const mks::BackendRegistration kAbsentRegistration{
+        mks::BackendDescriptor{
+                               .name         = "test-absent",
+                               .displayName  = "Test absent",
+                               .order        = 40,
+                               .check        = absentCheck,
+                               .create       = makePlatform,
+                               .capabilities = absentCapabilities,
+                               }
+    };
+
     TEST(BackendRegistry, ListsBackendsInDeclaredOrder)
     {
         const auto backends = mks::registeredBackends();
-        ASSERT_EQ(backends.size(), 2U);
+        ASSERT_EQ(backends.size(), 4U);
         EXPECT_EQ(backends[0].name, "test-partial");
         EXPECT_EQ(backends[1].name, "test-complete");
+        EXPECT_EQ(backends[2].name, "test-probed");
+        EXPECT_EQ(backends[3].name, "test-absent");
     }
 
     ILIAS_TEST(BackendRegistry, AutoSelectionSkipsBackendMissingRequiredCapability)
@@ -90,6 +199,140 @@ namespace
         }
     }
 
+    ILIAS_TEST(BackendRegistry, SelectionReusesProbedPlatform)
+    {
+        gCreated      = 0;
+        auto selected = co_await mks::selectBackend(
+            "test-probed", mks::BackendRequirement::Screens | mks::BackendRequirement::Capture |
+                               mks::BackendRequirement::Injection);
+        EXPECT_TRUE(selected.has_value());
+        if (!selected) {
+            co_return;
+        }
+        EXPECT_NE(selected->platform, nullptr);
+        EXPECT_EQ(selected->check.probe, mks::BackendProbe::Full);
+        EXPECT_EQ(gCreated, 1);
+    }
+
+    ILIAS_TEST(BackendRegistry, FailedCapabilityCheckSkipsFullProbe)
+    {
+        gAbsentFullRuns = 0;
+        auto selected   = co_await mks::selectBackend("test-absent", mks::BackendRequirement::Screens);
+        EXPECT_FALSE(selected.has_value());
+        EXPECT_EQ(gAbsentFullRuns, 0);
+
+        const auto capabilities =
+            co_await mks::checkBackend("test-absent", mks::BackendProbe::Capabilities);
+        EXPECT_EQ(capabilities.probe, mks::BackendProbe::Capabilities);
+        EXPECT_EQ(gAbsentFullRuns, 0);
+    }
+
+    ILIAS_TEST(BackendRegistry, ChecksRunConcurrentlyInRegistryOrder)
+    {
+        gRendezvous = true;
+        gArrived    = 0;
+        gPeersSeen  = 0;
+        const auto checked = co_await mks::checkBackends();
+        gRendezvous        = false;
+
+        EXPECT_EQ(gPeersSeen, 2);
+        EXPECT_EQ(checked.size(), 4U);
+        if (checked.size() != 4U) {
+            co_return;
+        }
+        EXPECT_EQ(checked[0].descriptor.name, "test-partial");
+        EXPECT_EQ(checked[3].descriptor.name, "test-absent");
+        EXPECT_TRUE(checked[2].check.available);
+        EXPECT_FALSE(checked[3].check.available);
+    }
+
+    TEST(BackendCache, KeyedBySessionEnvironment)
+    {
+        const auto environment = mks::BackendEnvironment{
+            .sessionType = "wayland", .waylandDisplay = "wayland-0", .desktop = "sway"};
+        const auto entry =
+            mks::makeBackendCacheEntry(environment, mks::BackendRequirement::Screens |
+                                                        mks::BackendRequirement::Capture,
+                                       "test-complete", mks::BackendCheck{.available = true});
+
+        EXPECT_EQ(mks::cachedBackendFor(entry, environment, mks::BackendRequirement::Capture),
+                  "test-complete");
+        auto moved           = environment;
+        moved.waylandDisplay = "wayland-1";
+        EXPECT_FALSE(mks::cachedBackendFor(entry, moved, mks::BackendRequirement::Capture));
+        auto x11        = environment;
+        x11.sessionType = "x11";
+        EXPECT_FALSE(mks::cachedBackendFor(entry, x11, mks::BackendRequirement::Capture));
+        EXPECT_FALSE(mks::cachedBackendFor(entry, environment, mks::BackendRequirement::Injection));
+    }
+
+    TEST(BackendCache, SavesNextToConfig)
+    {
+        EXPECT_EQ(mks::backendCachePath("conf/mksync.json"),
+                  std::filesystem::path{"conf/mksync.backend.json"});
+
+        const auto path = cachePath("mksync-test-backend-cache.json");
+        writeCache(path, "test-probed");
+        auto loaded = mks::loadBackendCache(path);
+        ASSERT_TRUE(loaded.has_value()) << loaded.error().message();
+        EXPECT_EQ(loaded->backend, "test-probed");
+        EXPECT_EQ(loaded->environment, mks::currentBackendEnvironment());
+        EXPECT_EQ(loaded->detail, "cached");
+        std::filesystem::remove(path);
+    }
+
+    ILIAS_TEST(BackendCache, CachedBackendIsTriedFirst)
+    {
+        // Without the cache, Screens alone would select test-partial (order 10).
+        const auto path = cachePath("mksync-test-backend-cache-hit.json");
+        writeCache(path, "test-probed");
+        gAbsentFullRuns = 0;
+        auto selected =
+            co_await mks::selectCachedBackend("auto", mks::BackendRequirement::Screens, path);
+        EXPECT_TRUE(selected.has_value());
+        if (selected) {
+            EXPECT_EQ(selected->descriptor.name, "test-probed");
+            EXPECT_EQ(selected->check.probe, mks::BackendProbe::Full);
+        }
+        EXPECT_EQ(gAbsentFullRuns, 0);
+        EXPECT_EQ(cachedName(path), "test-probed");
+        std::filesystem::remove(path);
+    }
+
+    ILIAS_TEST(BackendCache, UnsuitableCachedBackendFallsBackAndIsReplaced)
+    {
+        const auto path = cachePath("mksync-test-backend-cache-stale.json");
+        writeCache(path, "test-absent");
+        auto selected =
+            co_await mks::selectCachedBackend({}, mks::BackendRequirement::Screens, path);
+        EXPECT_TRUE(selected.has_value());
+        if (selected) {
+            EXPECT_EQ(selected->descriptor.name, "test-partial");
+        }
+        EXPECT_EQ(cachedName(path), "test-partial");
+        std::filesystem::remove(path);
+    }
+
+    ILIAS_TEST(BackendCache, EnvironmentChangeInvalidatesCache)
+    {
+        const auto path      = cachePath("mksync-test-backend-cache-moved.json");
+        auto       elsewhere = mks::currentBackendEnvironment();
+        elsewhere.display += ":moved";
+        writeCache(path, "test-probed", elsewhere);
+        auto selected =
+            co_await mks::selectCachedBackend({}, mks::BackendRequirement::Screens, path);
+        EXPECT_TRUE(selected.has_value());
+        if (selected) {
+            EXPECT_EQ(selected->descriptor.name, "test-partial");
+        }
+        auto rewritten = mks::loadBackendCache(path);
+        EXPECT_TRUE(rewritten.has_value());
+        if (rewritten) {
+            EXPECT_EQ(rewritten->environment, mks::currentBackendEnvironment());
+        }
+        std::filesystem::remove(path);
+    }
+
 } // namespace
 
 auto main(int argc, char **argv) -> int
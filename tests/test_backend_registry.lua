@@ -3,6 +3,9 @@ target("test_backend_registry")
     mks_apply_test_settings(test_file)
     add_files(
         test_file,
-        path.join(os.projectdir(), "src/platform/backend.cpp")
+        path.join(os.projectdir(), "src/platform/backend.cpp"),
+        path.join(os.projectdir(), "src/config/app_config.cpp"),
+        path.join(os.projectdir(), "src/config/backend_cache.cpp"),
+        path.join(os.projectdir(), "src/diag/metrics.cpp")
     )
 target_end()
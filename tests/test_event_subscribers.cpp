@@ -0,0 +1,295 @@
+#include "preinclude.hpp"
+#include "app/event_subscribers.hpp"
+#include "app/plugin_host.hpp"
+
+#include <gtest/gtest.h>
+#include <ilias/testing.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#if defined(__linux__)
+    #include <sys/mman.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// The subscriber side of mks_event_ring.h, as another process would write it.
+struct Subscription {
+    int socket = -1;
+    int memory = -1;
+    int wakeup = -1;
+    mks_event_ring_reply reply {};
+    void *mapping = nullptr;
+
+    Subscription() = default;
+    Subscription(const Subscription &) = delete;
+
+    ~Subscription() {
+        if (mapping) {
+            ::munmap(mapping, reply.size);
+        }
+        for (auto fd : {socket, memory, wakeup}) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+
+    auto header() const -> mks_event_ring_header & {
+        return *static_cast<mks_event_ring_header *>(mapping);
+    }
+
+    auto head() const -> uint64_t {
+        return std::atomic_ref(header().head).load(std::memory_order_acquire);
+    }
+
+    auto record(uint64_t index) const -> const mks_event_record & {
+        const auto *records = reinterpret_cast<const mks_event_record *>(
+            static_cast<const std::byte *>(mapping) + header().records_offset
+        );
+        return records[index & (header().capacity - 1)];
+    }
+
+    auto hangUp() -> void {
+        ::close(socket);
+        socket = -1;
+    }
+};
+
+// Send the request, then wait for the reply and map the ring it carries.
+auto subscribe(Subscription &subscription, mks_event_ring_request request) -> mks::Task<bool> {
+    if (::send(subscription.socket, &request, sizeof request, MSG_NOSIGNAL) != ssize_t {sizeof request}) {
+        co_return false;
+    }
+    auto payload = iovec {.iov_base = &subscription.reply, .iov_len = sizeof subscription.reply};
+    alignas(cmsghdr) char control[CMSG_SPACE(2 * sizeof(int))] {};
+    auto message = msghdr {};
+    message.msg_iov = &payload;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof control;
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (::recvmsg(subscription.socket, &message, MSG_DONTWAIT | MSG_CMSG_CLOEXEC) < 0) {
+        if (errno != EAGAIN || std::chrono::steady_clock::now() > deadline) {
+            co_return false;
+        }
+        co_await ilias::sleep(1ms);
+    }
+    auto *header = CMSG_FIRSTHDR(&message);
+    if (subscription.reply.status != 0 || !header || header->cmsg_type != SCM_RIGHTS) {
+        co_return false;
+    }
+    int fds[2];
+    std::memcpy(fds, CMSG_DATA(header), sizeof fds);
+    subscription.memory = fds[0];
+    subscription.wakeup = fds[1];
+    auto *mapping =
+        ::mmap(nullptr, subscription.reply.size, PROT_READ | PROT_WRITE, MAP_SHARED, subscription.memory, 0);
+    if (mapping == MAP_FAILED) {
+        co_return false;
+    }
+    subscription.mapping = mapping;
+    co_return true;
+}
+
+auto makeRequest(uint32_t events, uint32_t capacity) -> mks_event_ring_request {
+    return mks_event_ring_request {.version = MKS_EVENT_RING_VERSION, .events = events, .capacity = capacity};
+}
+
+auto keyEvent(mks::Key key) -> mks::InputEvent {
+    return mks::InputEvent {mks::KeyEvent {.key = key, .nativeCode = 30}};
+}
+
+} // namespace
+
+ILIAS_TEST(EventSubscribers, CopiesSubscribedEventsIntoTheRing) {
+    auto host = mks::PluginHost {};
+    auto subscribers = mks::EventSubscribers {host};
+    EXPECT_FALSE(host.wants(MKS_EVENT_RING_EVENTS));
+
+    int pair[2];
+    EXPECT_EQ(::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, pair), 0);
+    auto subscription = Subscription {};
+    subscription.socket = pair[1];
+    auto subscriber = [&]() -> mks::Task<void> {
+        const auto subscribed = co_await subscribe(
+            subscription,
+            makeRequest(MKS_EVENT_KEY | MKS_EVENT_SCREEN_SWITCH | MKS_EVENT_SESSION | MKS_EVENT_CLIPBOARD, 0)
+        );
+        EXPECT_TRUE(subscribed);
+        if (!subscribed) {
+            subscription.hangUp();
+            co_return;
+        }
+        const auto &header = subscription.header();
+        EXPECT_EQ(header.magic, MKS_EVENT_RING_MAGIC);
+        EXPECT_EQ(header.record_size, sizeof(mks_event_record));
+        EXPECT_EQ(header.capacity, MKS_EVENT_RING_DEFAULT_CAPACITY);
+        // Clipboard events are not ring events; the bit was dropped.
+        EXPECT_EQ(header.events, MKS_EVENT_KEY | MKS_EVENT_SCREEN_SWITCH | MKS_EVENT_SESSION);
+        EXPECT_EQ(subscribers.count(), 1U);
+        EXPECT_TRUE(host.wants(MKS_EVENT_KEY));
+        EXPECT_FALSE(host.wants(MKS_EVENT_MOUSE_MOVE | MKS_EVENT_CLIPBOARD));
+
+        host.publish(keyEvent(mks::Key::A));
+        host.publish(mks::InputEvent {mks::MouseMoveEvent {.x = 3, .y = 4}});
+        host.publishScreenSwitch(
+            {.ownerId = "server"},
+            {.key = {.ownerId = "laptop", .screenIndex = 1}, .x = 5, .y = 7},
+            false
+        );
+        host.publishSessionOpened({}, "laptop", true);
+
+        EXPECT_EQ(subscription.head(), 3U);
+        const auto &key = subscription.record(0);
+        EXPECT_EQ(key.type, MKS_EVENT_KEY);
+        EXPECT_EQ(key.data.key.key, static_cast<uint32_t>(mks::Key::A));
+        EXPECT_EQ(key.data.key.native_code, 30U);
+        EXPECT_GT(key.timestamp_ns, 0U);
+
+        const auto &crossed = subscription.record(1);
+        EXPECT_EQ(crossed.type, MKS_EVENT_SCREEN_SWITCH);
+        EXPECT_STREQ(crossed.data.screen_switch.from_owner_id, "server");
+        EXPECT_STREQ(crossed.data.screen_switch.to_owner_id, "laptop");
+        EXPECT_EQ(crossed.data.screen_switch.to_screen_index, 1U);
+        EXPECT_EQ(crossed.data.screen_switch.x, 5);
+        EXPECT_EQ(crossed.data.screen_switch.y, 7);
+        EXPECT_FALSE(crossed.data.screen_switch.to_local);
+        EXPECT_GE(crossed.timestamp_ns, key.timestamp_ns);
+
+        const auto &opened = subscription.record(2);
+        EXPECT_EQ(opened.type, MKS_EVENT_SESSION_OPENED);
+        EXPECT_STREQ(opened.data.session.owner_id, "laptop");
+        EXPECT_TRUE(opened.data.session.resumed);
+        subscription.hangUp();
+    };
+    co_await ilias::whenAll(subscribers.serve(pair[0]), subscriber());
+
+    // Hanging up unsubscribed it.
+    EXPECT_EQ(subscribers.count(), 0U);
+    EXPECT_FALSE(host.wants(MKS_EVENT_RING_EVENTS));
+}
+
+ILIAS_TEST(EventSubscribers, AFullRingDropsAndNeverBlocks) {
+    auto host = mks::PluginHost {};
+    auto subscribers = mks::EventSubscribers {host};
+
+    int pair[2];
+    EXPECT_EQ(::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, pair), 0);
+    auto subscription = Subscription {};
+    subscription.socket = pair[1];
+    auto subscriber = [&]() -> mks::Task<void> {
+        // 3 rounds up to 4 records.
+        const auto subscribed = co_await subscribe(subscription, makeRequest(MKS_EVENT_KEY, 3));
+        EXPECT_TRUE(subscribed);
+        if (!subscribed) {
+            subscription.hangUp();
+            co_return;
+        }
+        auto &header = subscription.header();
+        EXPECT_EQ(header.capacity, 4U);
+        for (auto index = 0; index < 6; ++index) {
+            host.publish(keyEvent(mks::Key::A));
+        }
+        EXPECT_EQ(subscription.head(), 4U);
+        EXPECT_EQ(std::atomic_ref(header.dropped).load(), 2U);
+
+        // Reading two frees two slots; asleep, the subscriber gets woken.
+        std::atomic_ref(header.tail).store(2, std::memory_order_release);
+        std::atomic_ref(header.waiting).store(1);
+        host.publish(keyEvent(mks::Key::B));
+        EXPECT_EQ(subscription.head(), 5U);
+        EXPECT_EQ(subscription.record(4).data.key.key, static_cast<uint32_t>(mks::Key::B));
+        EXPECT_EQ(std::atomic_ref(header.waiting).load(), 0U);
+        auto wakeups = uint64_t {0};
+        EXPECT_EQ(::read(subscription.wakeup, &wakeups, sizeof wakeups), ssize_t {sizeof wakeups});
+        EXPECT_EQ(wakeups, 1U);
+
+        // Awake, it costs no wakeup.
+        host.publish(keyEvent(mks::Key::C));
+        EXPECT_EQ(subscription.head(), 6U);
+        EXPECT_LT(::read(subscription.wakeup, &wakeups, sizeof wakeups), 0);
+
+        // A tail scribbled past head only ever reads as a full ring.
+        std::atomic_ref(header.tail).store(1000, std::memory_order_release);
+        host.publish(keyEvent(mks::Key::D));
+        EXPECT_EQ(subscription.head(), 6U);
+        EXPECT_EQ(std::atomic_ref(header.dropped).load(), 3U);
+        subscription.hangUp();
+    };
+    co_await ilias::whenAll(subscribers.serve(pair[0]), subscriber());
+    EXPECT_EQ(subscribers.count(), 0U);
+}
+
+ILIAS_TEST(EventSubscribers, RefusesAnotherVersion) {
+    auto host = mks::PluginHost {};
+    auto subscribers = mks::EventSubscribers {host};
+
+    int pair[2];
+    EXPECT_EQ(::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, pair), 0);
+    auto subscription = Subscription {};
+    subscription.socket = pair[1];
+    auto request = makeRequest(MKS_EVENT_KEY, 0);
+    request.version = MKS_EVENT_RING_VERSION + 1;
+    auto subscribed = true;
+    auto subscriber = [&]() -> mks::Task<void> {
+        subscribed = co_await subscribe(subscription, request);
+    };
+    // serve() returns on its own after refusing; no hang-up needed.
+    co_await ilias::whenAll(subscribers.serve(pair[0]), subscriber());
+    EXPECT_FALSE(subscribed);
+    EXPECT_EQ(subscription.reply.status, EPROTO);
+    EXPECT_EQ(subscription.memory, -1);
+    EXPECT_EQ(subscribers.count(), 0U);
+    EXPECT_FALSE(host.wants(MKS_EVENT_KEY));
+}
+
+ILIAS_TEST(EventSubscribers, ServesTheSocketAndRemovesIt) {
+    const auto path =
+        std::filesystem::temp_directory_path() / fmtlib::format("mksync-events-{}.sock", ::getpid());
+    std::filesystem::remove(path);
+    auto host = mks::PluginHost {};
+    auto subscribers = mks::EventSubscribers {host};
+    subscribers.setPath(path);
+
+    auto subscription = Subscription {};
+    auto subscriber = [&]() -> mks::Task<void> {
+        // Until run() is listening.
+        co_await ilias::sleep(20ms);
+        EXPECT_EQ(
+            std::filesystem::status(path).permissions(),
+            std::filesystem::perms::owner_read | std::filesystem::perms::owner_write
+        );
+        subscription.socket = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        auto address = sockaddr_un {};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof address.sun_path - 1);
+        EXPECT_EQ(::connect(subscription.socket, reinterpret_cast<const sockaddr *>(&address), sizeof address), 0);
+        EXPECT_TRUE(co_await subscribe(subscription, makeRequest(MKS_EVENT_SESSION, 0)));
+        EXPECT_EQ(subscribers.count(), 1U);
+        host.publishSessionClosed({}, "laptop", false);
+        EXPECT_EQ(subscription.head(), 1U);
+    };
+    co_await ilias::whenAny(subscribers.run(), subscriber());
+
+    // Cancelled with its connection still open: both were cleaned up.
+    EXPECT_EQ(subscribers.count(), 0U);
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+#endif
+
+int main(int argc, char **argv) {
+    ILIAS_TEST_SETUP_UTF8();
+    ilias::PlatformContext context {};
+    context.install();
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
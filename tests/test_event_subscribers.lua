@@ -0,0 +1,12 @@
+target("test_event_subscribers")
+    local test_file = path.join(os.scriptdir(), "test_event_subscribers.cpp")
+    mks_apply_test_settings(test_file)
+    add_files(test_file)
+    add_files(
+        path.join(os.projectdir(), "src/app/event_subscribers.cpp"),
+        path.join(os.projectdir(), "src/app/plugin_host.cpp")
+    )
+    if is_plat("linux") then
+        add_syslinks("dl")
+    end
+target_end()
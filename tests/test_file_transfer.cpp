@@ -0,0 +1,506 @@
+#include "preinclude.hpp"
+#include "app/file_drops.hpp"
+#include "app/file_transfer.hpp"
+#include "core/file_delta.hpp"
+#include "rpc/message.hpp"
+#include "rpc/transport.hpp"
+
+#include <gtest/gtest.h>
+#include <ilias/net.hpp>
+#include <ilias/testing.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+auto makeEndpoint(uint16_t port) -> mks::IPEndpoint {
+    auto endpoint = mks::IPEndpoint::fromString(fmtlib::format("127.0.0.1:{}", port));
+    if (!endpoint) {
+        throw std::runtime_error("invalid test endpoint");
+    }
+    return *endpoint;
+}
+
+// A fresh directory per test, so part files from earlier runs never resume.
+auto testDirectory(std::string_view name) -> std::filesystem::path {
+    auto directory = std::filesystem::temp_directory_path() / fmtlib::format("mks_file_transfer_{}", name);
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "out");
+    std::filesystem::create_directories(directory / "in");
+    return directory;
+}
+
+auto makeContent(size_t size) -> std::vector<std::byte> {
+    auto bytes = std::vector<std::byte>(size);
+    auto state = uint64_t {0x9E3779B97F4A7C15ULL};
+    for (auto &byte : bytes) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        byte = static_cast<std::byte>(state >> 56);
+    }
+    return bytes;
+}
+
+auto writeFile(const std::filesystem::path &path, const std::vector<std::byte> &bytes) -> void {
+    auto file = std::ofstream {path, std::ios::binary | std::ios::trunc};
+    file.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+auto readFile(const std::filesystem::path &path) -> std::vector<std::byte> {
+    auto file = std::ifstream {path, std::ios::binary};
+    auto bytes = std::vector<std::byte>(std::filesystem::file_size(path));
+    file.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return bytes;
+}
+
+struct TransferResult {
+    mks::IoResult<mks::FileTransferStats> sent;
+    mks::IoResult<std::filesystem::path> stored;
+};
+
+// One file connection over loopback: the offer goes out first, as after the
+// client's Hello, then both halves run to completion.
+auto transfer(
+    mks::FileTransfers &sender,
+    mks::FileTransfers &receiver,
+    std::filesystem::path source,
+    mks::FileOfferMessage offer,
+    uint16_t port
+) -> mks::Task<TransferResult> {
+    auto listener = co_await ilias::TcpListener::bind(makeEndpoint(port));
+    if (!listener) {
+        co_return TransferResult {mks::Err(listener.error()), mks::Err(listener.error())};
+    }
+    auto sendSide = [&]() -> mks::IoTask<mks::FileTransferStats> {
+        ILIAS_CO_TRY(auto stream, co_await ilias::TcpStream::connect(makeEndpoint(port)));
+        auto transport = mks::RpcTransport {std::move(stream)};
+        ILIAS_CO_TRYV(co_await transport.writeMessage(mks::RpcMessage {offer}));
+        auto result = co_await sender.send(transport, source, offer);
+        (void) co_await transport.shutdown();
+        co_return result;
+    };
+    auto receiveSide = [&]() -> mks::IoTask<std::filesystem::path> {
+        ILIAS_CO_TRY(auto incoming, co_await listener->accept());
+        auto &[stream, endpoint] = incoming;
+        (void) endpoint;
+        auto transport = mks::RpcTransport {std::move(stream)};
+        ILIAS_CO_TRY(auto message, co_await transport.readMessage());
+        auto *received = std::get_if<mks::FileOfferMessage>(&message);
+        if (!received) {
+            co_return mks::Err(mks::RpcError::ProtocolError);
+        }
+        auto result = co_await receiver.receive(transport, std::move(*received));
+        (void) co_await transport.shutdown();
+        co_return result;
+    };
+    auto [sent, stored] = co_await ilias::whenAll(sendSide(), receiveSide());
+    co_return TransferResult {std::move(sent), std::move(stored)};
+}
+
+// Fetch for FileDrops that serves @p source from @p sender over loopback,
+// as the server does for a FileFetchMessage.
+auto loopbackFetch(
+    mks::FileTransfers &sender,
+    mks::FileTransfers &receiver,
+    std::filesystem::path source,
+    mks::FileOfferMessage offer,
+    uint16_t port
+) -> mks::FileDrops::Fetch {
+    return [&sender, &receiver, source = std::move(source), offer = std::move(offer), port](
+               mks::FileFetchMessage fetch,
+               mks::FileReceiveOptions options
+           ) -> mks::IoTask<std::filesystem::path> {
+        auto listener = co_await ilias::TcpListener::bind(makeEndpoint(port));
+        if (!listener) {
+            co_return mks::Err(listener.error());
+        }
+        auto serveSide = [&]() -> mks::IoTask<mks::FileTransferStats> {
+            ILIAS_CO_TRY(auto incoming, co_await listener->accept());
+            auto &[stream, endpoint] = incoming;
+            (void) endpoint;
+            auto transport = mks::RpcTransport {std::move(stream)};
+            ILIAS_CO_TRYV(co_await transport.writeMessage(mks::RpcMessage {offer}));
+            co_return co_await sender.send(transport, source, offer);
+        };
+        auto fetchSide = [&]() -> mks::IoTask<std::filesystem::path> {
+            ILIAS_CO_TRY(auto stream, co_await ilias::TcpStream::connect(makeEndpoint(port)));
+            auto transport = mks::RpcTransport {std::move(stream)};
+            auto result = co_await receiver.fetch(transport, fetch.transferId, options);
+            (void) co_await transport.shutdown();
+            co_return result;
+        };
+        auto [served, fetched] = co_await ilias::whenAll(serveSide(), fetchSide());
+        co_return std::move(fetched);
+    };
+}
+
+auto dragOffer(const mks::FileOfferMessage &offer) -> mks::DragOfferMessage {
+    return mks::DragOfferMessage {
+        .dragId = 1,
+        .fileIndex = 0,
+        .fileCount = 1,
+        .transferId = offer.transferId,
+        .manifest = offer.manifest,
+    };
+}
+
+} // namespace
+
+// MARK: Manifest
+
+TEST(FileManifest, ChunksCoverTheFile) {
+    EXPECT_EQ(mks::fileChunkSize(0), mks::kMinFileChunkSize);
+    EXPECT_EQ(mks::fileChunkSize(100ULL << 30), 128U << 20);
+
+    auto manifest = mks::FileManifest {
+        .name = "data.bin",
+        .size = 3 * uint64_t {mks::kMinFileChunkSize} + 5,
+        .chunkSize = mks::kMinFileChunkSize,
+    };
+    EXPECT_EQ(mks::fileChunkCount(manifest), 4U);
+    EXPECT_EQ(mks::fileChunkLength(manifest, 3), 5U);
+    EXPECT_EQ(mks::fileChunkLength(manifest, 4), 0U);
+
+    const auto id = mks::fileTransferId(manifest);
+    manifest.chunkHashes.push_back(1);
+    EXPECT_NE(mks::fileTransferId(manifest), id);
+}
+
+TEST(XxHash64, StreamingMatchesOneShot) {
+    const auto bytes = makeContent(1000);
+    auto hash = mks::XxHash64 {};
+    hash.update(std::span {bytes}.first(3));
+    hash.update(std::span {bytes}.subspan(3, 500));
+    hash.update(std::span {bytes}.subspan(503));
+    EXPECT_EQ(hash.digest(), mks::xxhash64(bytes));
+    EXPECT_EQ(mks::xxhash64({}), 0xEF46DB3751D8E999ULL);
+}
+
+// MARK: Transfer
+
+ILIAS_TEST(FileTransfer, StoresTheFileWithoutStallingTheLoop) {
+    const auto directory = testDirectory("stores");
+    const auto content = makeContent(6 * size_t {mks::kMinFileChunkSize} + 123);
+    const auto source = directory / "out" / "video.bin";
+    writeFile(source, content);
+
+    auto sender = mks::FileTransfers {};
+    auto receiver = mks::FileTransfers {};
+    receiver.setDirectory(directory / "in");
+    auto offer = co_await sender.makeOffer(source);
+    EXPECT_TRUE(offer) << (offer ? "" : offer.error().message());
+    if (!offer) {
+        co_return;
+    }
+    EXPECT_EQ(offer->manifest.chunkHashes.size(), 7U);
+
+    // Hashing, page-in and disk writes are off the loop; a ticker on it
+    // should keep firing close to its period the whole time.
+    auto done = false;
+    auto run = [&]() -> mks::Task<TransferResult> {
+        auto result = co_await transfer(sender, receiver, source, *offer, 30261);
+        done = true;
+        co_return result;
+    };
+    auto ticker = [&]() -> mks::Task<std::chrono::nanoseconds> {
+        auto worst = std::chrono::nanoseconds {0};
+        auto last = std::chrono::steady_clock::now();
+        while (!done) {
+            co_await ilias::sleep(1ms);
+            const auto now = std::chrono::steady_clock::now();
+            worst = std::max<std::chrono::nanoseconds>(worst, now - last);
+            last = now;
+        }
+        co_return worst;
+    };
+    auto [result, worstGap] = co_await ilias::whenAll(run(), ticker());
+
+    EXPECT_TRUE(result.sent) << (result.sent ? "" : result.sent.error().message());
+    EXPECT_TRUE(result.stored) << (result.stored ? "" : result.stored.error().message());
+    if (!result.sent || !result.stored) {
+        co_return;
+    }
+    EXPECT_EQ(result.sent->chunks, 7U);
+    EXPECT_EQ(result.sent->reusedChunks, 0U);
+    EXPECT_EQ(result.sent->bytes, content.size());
+    EXPECT_EQ(*result.stored, directory / "in" / "video.bin");
+    EXPECT_TRUE(readFile(*result.stored) == content);
+    EXPECT_LT(worstGap, 250ms);
+}
+
+ILIAS_TEST(FileTransfer, ResumesFromThePartFile) {
+    const auto directory = testDirectory("resumes");
+    auto content = makeContent(6 * size_t {mks::kMinFileChunkSize} + 123);
+    const auto source = directory / "out" / "disk.img";
+    writeFile(source, content);
+
+    auto sender = mks::FileTransfers {};
+    auto receiver = mks::FileTransfers {};
+    receiver.setDirectory(directory / "in");
+    auto offer = co_await sender.makeOffer(source);
+    EXPECT_TRUE(offer);
+    if (!offer) {
+        co_return;
+    }
+
+    // An interrupted attempt left every chunk but 2 and 6 intact.
+    auto partial = content;
+    partial[2 * size_t {mks::kMinFileChunkSize} + 17] ^= std::byte {0xFF};
+    partial.back() ^= std::byte {0x01};
+    writeFile(directory / "in" / fmtlib::format(".{}.mkspart", offer->transferId), partial);
+
+    auto result = co_await transfer(sender, receiver, source, *offer, 30262);
+    EXPECT_TRUE(result.sent) << (result.sent ? "" : result.sent.error().message());
+    EXPECT_TRUE(result.stored) << (result.stored ? "" : result.stored.error().message());
+    if (!result.sent || !result.stored) {
+        co_return;
+    }
+    EXPECT_EQ(result.sent->chunks, 2U);
+    EXPECT_EQ(result.sent->reusedChunks, 5U);
+    EXPECT_EQ(result.sent->bytes, size_t {mks::kMinFileChunkSize} + 123);
+    EXPECT_TRUE(readFile(*result.stored) == content);
+}
+
+ILIAS_TEST(FileTransfer, NeverOverwritesAnExistingFile) {
+    const auto directory = testDirectory("unique");
+    const auto source = directory / "out" / "notes.txt";
+    writeFile(source, makeContent(10));
+    writeFile(directory / "in" / "notes.txt", makeContent(3));
+
+    auto sender = mks::FileTransfers {};
+    auto receiver = mks::FileTransfers {};
+    receiver.setDirectory(directory / "in");
+    auto offer = co_await sender.makeOffer(source);
+    EXPECT_TRUE(offer);
+    if (!offer) {
+        co_return;
+    }
+
+    auto result = co_await transfer(sender, receiver, source, *offer, 30263);
+    EXPECT_TRUE(result.stored);
+    if (result.stored) {
+        EXPECT_EQ(*result.stored, directory / "in" / "notes (1).txt");
+        EXPECT_EQ(readFile(*result.stored).size(), 10U);
+    }
+    EXPECT_EQ(readFile(directory / "in" / "notes.txt").size(), 3U);
+}
+
+ILIAS_TEST(FileTransfer, RejectsNamesThatArePaths) {
+    const auto directory = testDirectory("paths");
+    const auto source = directory / "out" / "payload";
+    writeFile(source, makeContent(64));
+
+    auto sender = mks::FileTransfers {};
+    auto receiver = mks::FileTransfers {};
+    receiver.setDirectory(directory / "in");
+    auto offer = co_await sender.makeOffer(source);
+    EXPECT_TRUE(offer);
+    if (!offer) {
+        co_return;
+    }
+    // Consistent id, so only the name is wrong.
+    offer->manifest.name = "../escaped";
+    offer->transferId = mks::fileTransferId(offer->manifest);
+
+    auto result = co_await transfer(sender, receiver, source, *offer, 30264);
+    EXPECT_FALSE(result.sent);
+    EXPECT_FALSE(result.stored);
+    if (!result.sent && !result.stored) {
+        EXPECT_EQ(result.sent.error(), make_error_code(mks::FileTransferError::Rejected));
+        EXPECT_EQ(result.stored.error(), make_error_code(mks::FileTransferError::InvalidManifest));
+    }
+    EXPECT_FALSE(std::filesystem::exists(directory / "escaped"));
+}
+
+// MARK: Delta
+
+TEST(RollingChecksum, RollMatchesRecompute) {
+    const auto bytes = makeContent(8192);
+    const auto all = std::span<const std::byte> {bytes};
+    constexpr auto kWindow = size_t {700};
+    auto checksum = mks::RollingChecksum {};
+    checksum.reset(all.first(kWindow));
+    for (auto position = size_t {0}; position + kWindow < bytes.size(); ++position) {
+        checksum.roll(bytes[position], bytes[position + kWindow]);
+        ASSERT_EQ(checksum.value(), mks::rollingChecksum(all.subspan(position + 1, kWindow))) << position;
+    }
+}
+
+TEST(FileDelta, RebuildsAnEditedFile) {
+    const auto basis = makeContent(3 * 1024 * 1024);
+    auto target = basis;
+    // An insertion shifts everything after it; blocks must still be found.
+    target.insert(target.begin() + 100'000, 777, std::byte {5});
+    for (auto offset = size_t {2'000'000}; offset < 2'000'100; ++offset) {
+        target[offset] ^= std::byte {1};
+    }
+    target.erase(target.begin() + 2'500'000, target.begin() + 2'510'000);
+
+    const auto blockSize = mks::deltaBlockSize(basis.size());
+    const auto blockCount = mks::deltaBlockCount(basis.size(), blockSize);
+    // Signed in two halves, as on two workers.
+    auto signature = mks::signBlocks(basis, blockSize, 0, blockCount / 2);
+    const auto rest = mks::signBlocks(basis, blockSize, blockCount / 2, blockCount - blockCount / 2);
+    signature.weak.insert(signature.weak.end(), rest.weak.begin(), rest.weak.end());
+    signature.strong.insert(signature.strong.end(), rest.strong.begin(), rest.strong.end());
+    ASSERT_EQ(signature.weak.size(), blockCount);
+    const auto index = mks::FileSignatureIndex {std::move(signature)};
+
+    auto rebuilt = std::vector<std::byte> {};
+    auto literal = uint64_t {0};
+    const auto rangeBytes = uint64_t {256} * blockSize;
+    for (auto begin = uint64_t {0}; begin < target.size(); begin += rangeBytes) {
+        const auto end = std::min<uint64_t>(target.size(), begin + rangeBytes);
+        for (const auto &op : mks::diffRange(index, target, begin, end)) {
+            if (op.block == mks::kDeltaLiteral) {
+                rebuilt.insert(rebuilt.end(), target.begin() + op.source, target.begin() + op.source + op.length);
+                literal += op.length;
+                continue;
+            }
+            const auto from = uint64_t {op.block} * blockSize;
+            rebuilt.insert(rebuilt.end(), basis.begin() + from, basis.begin() + from + op.length);
+        }
+    }
+    EXPECT_TRUE(rebuilt == target);
+    // The edits plus about a block around each of them and each range boundary.
+    EXPECT_LT(literal, 64U * 1024);
+}
+
+ILIAS_TEST(FileTransfer, SendsADeltaAgainstTheOlderCopy) {
+    const auto directory = testDirectory("delta");
+    const auto older = makeContent(6 * size_t {mks::kMinFileChunkSize} + 123);
+    auto newer = older;
+    newer.insert(newer.begin() + 5'000'000, 4096, std::byte {0x42});
+    newer[20'000'000] ^= std::byte {0xFF};
+    const auto source = directory / "out" / "app.bin";
+    writeFile(source, newer);
+    writeFile(directory / "in" / "app.bin", older);
+
+    auto sender = mks::FileTransfers {};
+    auto receiver = mks::FileTransfers {};
+    receiver.setDirectory(directory / "in");
+    auto offer = co_await sender.makeOffer(source, mks::FileSendOptions {.replace = true});
+    EXPECT_TRUE(offer);
+    if (!offer) {
+        co_return;
+    }
+
+    auto result = co_await transfer(sender, receiver, source, *offer, 30267);
+    EXPECT_TRUE(result.sent) << (result.sent ? "" : result.sent.error().message());
+    EXPECT_TRUE(result.stored) << (result.stored ? "" : result.stored.error().message());
+    if (!result.sent || !result.stored) {
+        co_return;
+    }
+    // Replaced in place, from a small fraction of the file.
+    EXPECT_EQ(*result.stored, directory / "in" / "app.bin");
+    EXPECT_TRUE(readFile(*result.stored) == newer);
+    EXPECT_LT(result.sent->bytes, 256U * 1024);
+    EXPECT_EQ(result.sent->bytes + result.sent->reusedBytes, newer.size());
+    EXPECT_FALSE(std::filesystem::exists(directory / "in" / "app (1).bin"));
+}
+
+// MARK: Bandwidth
+
+ILIAS_TEST(BandwidthShare, SpacesReservationsByRate) {
+    auto share = mks::BandwidthShare {10 * 1024 * 1024};
+    const auto start = std::chrono::steady_clock::now();
+    for (auto slice = 0; slice < 4; ++slice) {
+        co_await share.reserve(1024 * 1024);
+    }
+    // The first slice goes at once, each later one waits ~100ms for its turn.
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 250ms);
+
+    share.setRate(0);
+    const auto unlimited = std::chrono::steady_clock::now();
+    co_await share.reserve(1ULL << 40);
+    EXPECT_LT(std::chrono::steady_clock::now() - unlimited, 50ms);
+}
+
+// MARK: Drops
+
+ILIAS_TEST(FileDrops, StoresAFileDroppedHere) {
+    const auto directory = testDirectory("drop_here");
+    const auto content = makeContent(4 * size_t {mks::kMinFileChunkSize});
+    const auto source = directory / "out" / "photos.tar";
+    writeFile(source, content);
+
+    auto sender = mks::FileTransfers {};
+    auto receiver = mks::FileTransfers {};
+    receiver.setDirectory(directory / "in");
+    auto offer = co_await sender.makeOffer(source);
+    EXPECT_TRUE(offer);
+    if (!offer) {
+        co_return;
+    }
+
+    auto drops = mks::FileDrops {receiver, loopbackFetch(sender, receiver, source, *offer, 30265)};
+    auto [messages, received] = ilias::mpsc::channel<mks::RpcMessage>(8);
+    auto session = [&]() -> mks::Task<bool> {
+        (void) co_await messages.send(mks::RpcMessage {dragOffer(*offer)});
+        (void) co_await messages.send(mks::RpcMessage {mks::DragEndMessage {.dragId = 1, .dropped = true}});
+        // The drop lifted the prefetch limit, so this is quick.
+        for (auto waited = 0ms; waited < 5000ms; waited += 10ms) {
+            if (std::filesystem::exists(directory / "in" / "photos.tar")) {
+                break;
+            }
+            co_await ilias::sleep(10ms);
+        }
+        messages = {};
+        co_return std::filesystem::exists(directory / "in" / "photos.tar");
+    };
+    auto [stored, ran] = co_await ilias::whenAll(session(), drops.run(received));
+    (void) ran;
+
+    EXPECT_TRUE(stored);
+    if (stored) {
+        EXPECT_TRUE(readFile(directory / "in" / "photos.tar") == content);
+    }
+    EXPECT_FALSE(std::filesystem::exists(receiver.partPath(offer->transferId)));
+}
+
+ILIAS_TEST(FileDrops, DiscardsAFileDroppedElsewhere) {
+    const auto directory = testDirectory("drop_elsewhere");
+    const auto source = directory / "out" / "photos.tar";
+    writeFile(source, makeContent(4 * size_t {mks::kMinFileChunkSize}));
+
+    auto sender = mks::FileTransfers {};
+    auto receiver = mks::FileTransfers {};
+    receiver.setDirectory(directory / "in");
+    auto offer = co_await sender.makeOffer(source);
+    EXPECT_TRUE(offer);
+    if (!offer) {
+        co_return;
+    }
+
+    auto drops = mks::FileDrops {receiver, loopbackFetch(sender, receiver, source, *offer, 30266)};
+    // Slow enough that the drag ends while the prefetch is still running.
+    drops.setPrefetchRate(256 * 1024);
+    auto [messages, received] = ilias::mpsc::channel<mks::RpcMessage>(8);
+    auto session = [&]() -> mks::Task<void> {
+        (void) co_await messages.send(mks::RpcMessage {dragOffer(*offer)});
+        co_await ilias::sleep(200ms);
+        (void) co_await messages.send(mks::RpcMessage {mks::DragEndMessage {.dragId = 1, .dropped = false}});
+        messages = {};
+    };
+    const auto start = std::chrono::steady_clock::now();
+    co_await ilias::whenAll(session(), drops.run(received));
+
+    // run() returned only after the cancelled prefetch cleaned up.
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+    EXPECT_FALSE(std::filesystem::exists(directory / "in" / "photos.tar"));
+    EXPECT_FALSE(std::filesystem::exists(receiver.partPath(offer->transferId)));
+}
+
+int main(int argc, char **argv) {
+    ILIAS_TEST_SETUP_UTF8();
+    ilias::PlatformContext context {};
+    context.install();
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,16 @@
+target("test_file_transfer")
+    local test_file = path.join(os.scriptdir(), "test_file_transfer.cpp")
+    mks_apply_test_settings(test_file)
+    add_files(test_file)
+    add_files(
+        path.join(os.projectdir(), "src/app/file_drops.cpp"),
+        path.join(os.projectdir(), "src/app/file_transfer.cpp"),
+        path.join(os.projectdir(), "src/app/worker_pool.cpp"),
+        path.join(os.projectdir(), "src/app/thread_tuning.cpp"),
+        path.join(os.projectdir(), "src/core/file_delta.cpp"),
+        path.join(os.projectdir(), "src/rpc/message.cpp"),
+        path.join(os.projectdir(), "src/rpc/transport.cpp"),
+        path.join(os.projectdir(), "src/diag/metrics.cpp"),
+        path.join(os.projectdir(), "src/diag/trace.cpp")
+    )
+target_end()
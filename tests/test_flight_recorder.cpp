@@ -0,0 +1,126 @@
+#include "preinclude.hpp"
+#include "diag/flight_recorder.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+namespace {
+
+auto recordsForScreen(
+    const mks::FlightDump &dump,
+    uint32_t screenIndex
+) -> std::vector<mks::FlightRecord> {
+    auto result = std::vector<mks::FlightRecord> {};
+    for (const auto &thread : dump.threads) {
+        for (const auto &record : thread.records) {
+            if (record.screenIndex == screenIndex) {
+                result.push_back(record);
+            }
+        }
+    }
+    return result;
+}
+
+auto dumpToTemp(std::string_view name) -> mks::FlightDump {
+    const auto path = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove(path);
+    auto dumped = mks::dumpFlightRecorder(path);
+    EXPECT_TRUE(dumped.has_value()) << dumped.error().message();
+    auto dump = mks::readFlightDump(path);
+    std::filesystem::remove(path);
+    EXPECT_TRUE(dump.has_value()) << dump.error().message();
+    return dump ? std::move(*dump) : mks::FlightDump {};
+}
+
+} // namespace
+
+TEST(FlightRecorder, DumpRoundTripsEventDetails) {
+    mks::flightRecord(
+        mks::FlightStage::Queue,
+        mks::InputEvent {mks::MouseButtonEvent {
+            .x = 12,
+            .y = 34,
+            .screenIndex = 0,
+            .button = mks::MouseButton::Right,
+            .release = true,
+        }},
+        7001,
+        3
+    );
+    mks::flightRecord(
+        mks::FlightStage::Inject,
+        mks::InputEvent {mks::KeyEvent {.key = mks::Key::F12}},
+        7001
+    );
+    mks::flightRecord(mks::FlightStage::ScreenSwitch, 7001);
+
+    const auto records = recordsForScreen(dumpToTemp("mksync-flight-details.flight"), 7001);
+    ASSERT_EQ(records.size(), 3U);
+
+    EXPECT_EQ(records[0].stage, mks::FlightStage::Queue);
+    EXPECT_EQ(records[0].eventType, mks::FlightEventType::MouseButton);
+    EXPECT_EQ(records[0].x, 12);
+    EXPECT_EQ(records[0].y, 34);
+    EXPECT_EQ(records[0].detail, static_cast<uint32_t>(mks::MouseButton::Right));
+    EXPECT_TRUE(records[0].release);
+    EXPECT_EQ(records[0].queueDepth, 3U);
+
+    EXPECT_EQ(records[1].eventType, mks::FlightEventType::Key);
+    EXPECT_EQ(records[1].detail, static_cast<uint32_t>(mks::Key::F12));
+
+    EXPECT_EQ(records[2].stage, mks::FlightStage::ScreenSwitch);
+    EXPECT_EQ(records[2].eventType, mks::FlightEventType::None);
+    EXPECT_LE(records[0].timestampNs, records[2].timestampNs);
+}
+
+TEST(FlightRecorder, KeepsOnlyTheNewestRecordsPerThread) {
+    std::thread([]() {
+        const auto total = mks::kFlightRecordsPerThread + 100;
+        for (auto index = 0U; index < total; ++index) {
+            mks::flightRecord(
+                mks::FlightStage::Capture,
+                mks::InputEvent {mks::MouseMoveEvent {.x = static_cast<int32_t>(index)}},
+                7002
+            );
+        }
+    }).join();
+
+    const auto records = recordsForScreen(dumpToTemp("mksync-flight-wrap.flight"), 7002);
+    ASSERT_EQ(records.size(), mks::kFlightRecordsPerThread);
+    EXPECT_EQ(records.front().x, 100);
+    EXPECT_EQ(records.back().x, static_cast<int32_t>(mks::kFlightRecordsPerThread + 99));
+    EXPECT_TRUE(std::ranges::is_sorted(records, {}, &mks::FlightRecord::x));
+}
+
+TEST(FlightRecorder, FormatsRecordsWithReflection) {
+    mks::flightRecord(
+        mks::FlightStage::Drop,
+        mks::InputEvent {mks::MouseWheelEvent {.deltaY = -120}},
+        7003
+    );
+
+    const auto text = mks::formatFlightDump(dumpToTemp("mksync-flight-format.flight"));
+    EXPECT_NE(text.find("Drop"), std::string::npos) << text;
+    EXPECT_NE(text.find("MouseWheel"), std::string::npos) << text;
+    EXPECT_NE(text.find("ms t"), std::string::npos) << text;
+}
+
+TEST(FlightRecorder, RejectsDamagedDumps) {
+    const auto garbage = std::vector<std::byte>(64, std::byte {0x5A});
+    auto badMagic = mks::decodeFlightDump(garbage);
+    ASSERT_FALSE(badMagic.has_value());
+    EXPECT_EQ(badMagic.error(), mks::make_error_code(mks::FlightDumpError::BadMagic));
+
+    auto truncated = mks::decodeFlightDump(std::span<const std::byte> {garbage}.first(8));
+    ASSERT_FALSE(truncated.has_value());
+    EXPECT_EQ(truncated.error(), mks::make_error_code(mks::FlightDumpError::Truncated));
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,6 @@
+target("test_flight_recorder")
+    local test_file = path.join(os.scriptdir(), "test_flight_recorder.cpp")
+    mks_apply_test_settings(test_file)
+    add_files(test_file)
+    add_files(path.join(os.projectdir(), "src/diag/flight_recorder.cpp"))
+target_end()
@@ -0,0 +1,181 @@
+#include "preinclude.hpp"
+#include "rpc/message.hpp"
+#include "rpc/transport.hpp"
+#include "support/impaired_stream.hpp"
+
+#include <array>
+#include <gtest/gtest.h>
+#include <ilias/testing.hpp>
+
+namespace {
+
+using namespace std::chrono_literals;
+using mks::test::Impairment;
+using mks::test::ImpairedStream;
+using mks::test::VirtualClock;
+
+auto bytes(size_t count) -> std::vector<std::byte> {
+    return std::vector<std::byte>(count, std::byte {0x5a});
+}
+
+// Delivery schedule for a fixed write pattern on a fresh link.
+auto scheduleFor(uint64_t seed) -> mks::Task<std::vector<std::chrono::nanoseconds>> {
+    auto clock = VirtualClock::manual();
+    auto [a, b] = ImpairedStream::pair(
+        Impairment {.latency = 10ms, .jitter = 5ms, .lossRate = 0.2},
+        Impairment {},
+        clock,
+        seed
+    );
+    auto payload = bytes(16);
+    for (auto i = 0; i < 32; ++i) {
+        (void) co_await a.write(payload);
+        clock->advance(1ms);
+    }
+    co_return b.pendingDeliveries();
+}
+
+} // namespace
+
+ILIAS_TEST(ImpairedStream, LatencyFollowsVirtualClock) {
+    auto clock = VirtualClock::manual();
+    auto [a, b] = ImpairedStream::pair(Impairment {.latency = 20ms}, Impairment {}, clock);
+
+    auto written = co_await a.write(bytes(4));
+    EXPECT_TRUE(written && *written == 4);
+    EXPECT_EQ(b.available(), 0U);
+
+    clock->advance(19ms);
+    EXPECT_EQ(b.available(), 0U);
+    clock->advance(1ms);
+    EXPECT_EQ(b.available(), 4U);
+
+    auto buffer = std::array<std::byte, 8> {};
+    auto read = co_await b.read(buffer);
+    EXPECT_TRUE(read && *read == 4);
+}
+
+ILIAS_TEST(ImpairedStream, SameSeedSameSchedule) {
+    auto first = co_await scheduleFor(7);
+    auto second = co_await scheduleFor(7);
+    auto other = co_await scheduleFor(8);
+
+    EXPECT_EQ(first.size(), 32U);
+    EXPECT_EQ(first, second);
+    EXPECT_NE(first, other);
+    EXPECT_TRUE(std::ranges::is_sorted(first));
+}
+
+ILIAS_TEST(ImpairedStream, BandwidthSerializesChunks) {
+    auto clock = VirtualClock::manual();
+    auto [a, b] = ImpairedStream::pair(Impairment {.bytesPerSecond = 1000}, Impairment {}, clock);
+
+    (void) co_await a.write(bytes(100));
+    (void) co_await a.write(bytes(100));
+
+    auto deliveries = b.pendingDeliveries();
+    EXPECT_EQ(deliveries.size(), 2U);
+    if (deliveries.size() == 2) {
+        EXPECT_EQ(deliveries[0], 100ms);
+        EXPECT_EQ(deliveries[1], 200ms);
+    }
+}
+
+ILIAS_TEST(ImpairedStream, FullBufferBlocksWriter) {
+    auto clock = VirtualClock::manual();
+    auto [a, b] = ImpairedStream::pair(
+        Impairment {.latency = 1s, .bufferBytes = 16},
+        Impairment {},
+        clock
+    );
+
+    auto partial = co_await a.write(bytes(32));
+    EXPECT_TRUE(partial && *partial == 16);
+
+    auto [blocked, timeout] = co_await ilias::whenAny(a.write(bytes(1)), ilias::sleep(20ms));
+    EXPECT_FALSE(blocked.has_value());
+    EXPECT_TRUE(timeout.has_value());
+
+    clock->advance(1s);
+    auto buffer = std::array<std::byte, 16> {};
+    (void) co_await b.read(buffer);
+    auto resumed = co_await a.write(bytes(1));
+    EXPECT_TRUE(resumed && *resumed == 1);
+}
+
+ILIAS_TEST(ImpairedStream, StallDelaysDelivery) {
+    auto clock = VirtualClock::manual();
+    auto [a, b] = ImpairedStream::pair(Impairment {.latency = 1ms}, Impairment {}, clock);
+
+    a.stall(50ms);
+    (void) co_await a.write(bytes(1));
+    clock->advance(49ms);
+    EXPECT_EQ(b.available(), 0U);
+    clock->advance(1ms);
+    EXPECT_EQ(b.available(), 1U);
+}
+
+ILIAS_TEST(ImpairedStream, ResetAfterBytes) {
+    auto clock = VirtualClock::manual();
+    auto [a, b] = ImpairedStream::pair(Impairment {.resetAfterBytes = 10}, Impairment {}, clock);
+
+    auto first = co_await a.write(bytes(8));
+    EXPECT_TRUE(first && *first == 8);
+    auto second = co_await a.write(bytes(8));
+    EXPECT_TRUE(second && *second == 2);
+    auto third = co_await a.write(bytes(8));
+    EXPECT_FALSE(third.has_value());
+
+    auto buffer = std::array<std::byte, 16> {};
+    auto read = co_await b.read(buffer);
+    EXPECT_FALSE(read.has_value());
+    auto reply = co_await b.write(bytes(1));
+    EXPECT_FALSE(reply.has_value());
+}
+
+ILIAS_TEST(ImpairedStream, EofAfterShutdown) {
+    auto clock = VirtualClock::manual();
+    auto [a, b] = ImpairedStream::pair(Impairment {}, Impairment {}, clock);
+
+    (void) co_await a.write(bytes(3));
+    (void) co_await a.shutdown();
+
+    auto buffer = std::array<std::byte, 8> {};
+    auto data = co_await b.read(buffer);
+    EXPECT_TRUE(data && *data == 3);
+    auto eof = co_await b.read(buffer);
+    EXPECT_TRUE(eof && *eof == 0);
+}
+
+ILIAS_TEST(ImpairedStream, CarriesRpcTransport) {
+    auto clock = VirtualClock::realtime();
+    auto [a, b] = ImpairedStream::pair(
+        Impairment {.latency = 5ms, .jitter = 2ms},
+        Impairment {.latency = 5ms},
+        clock
+    );
+    mks::RpcTransport client {ilias::DynStream {std::move(a)}};
+    mks::RpcTransport server {ilias::DynStream {std::move(b)}};
+
+    const auto start = clock->now();
+    auto [written, received] = co_await ilias::whenAll(
+        client.writeMessage(mks::RpcMessage {mks::HelloMessage {
+            .version = 0,
+            .machineId = "impaired-client",
+            .name = "impaired",
+        }}),
+        server.readMessage()
+    );
+
+    EXPECT_TRUE(written.has_value());
+    EXPECT_TRUE(received && std::holds_alternative<mks::HelloMessage>(*received));
+    EXPECT_GE(clock->now() - start, 5ms);
+}
+
+int main(int argc, char **argv) {
+    ILIAS_TEST_SETUP_UTF8();
+    ilias::PlatformContext context {};
+    context.install();
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,11 @@
+target("test_impaired_stream")
+    local test_file = path.join(os.scriptdir(), "test_impaired_stream.cpp")
+    mks_apply_test_settings(test_file)
+    add_files(test_file)
+    add_files(
+        path.join(os.projectdir(), "src/rpc/message.cpp"),
+        path.join(os.projectdir(), "src/rpc/transport.cpp"),
+        path.join(os.projectdir(), "src/diag/metrics.cpp"),
+        path.join(os.projectdir(), "src/diag/trace.cpp")
+    )
+target_end()
@@ -1,13 +1,21 @@
 #include "app/client.hpp"
 #include "app/server.hpp"
+#include "app/server_events.hpp"
+#include "diag/metrics.hpp"
+#include "rpc/transport.hpp"
 #include "platform/platform.hpp"
+#include "support/impaired_stream.hpp"
 #include "support/mock_platform.hpp"
 
+#include <array>
 #include <chrono>
 #include <gtest/gtest.h>
 #include <ilias/testing.hpp>
 #include <memory>
+#include <optional>
+#include <span>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 auto mks::Platform::create() -> Ptr
@@ -56,6 +64,71 @@ namespace
         co_return predicate();
     }
 
+    // What mks::Client sends on connect, from a hand-driven transport.
+    auto clientHandshake(std::string resumeToken) -> std::array<mks::RpcMessage, 2>
+    {
+        return std::array{
+            mks::RpcMessage{mks::HelloMessage{
+                .machineId   = "resume-client",
+                .name        = "resume-client",
+                .resumeToken = std::move(resumeToken),
+            }},
+            mks::RpcMessage{mks::ScreensMessage{
+                .screens = {makeScreen("client", 2560, 1440)},
+            }},
+        };
+    }
+
+    auto activeSessions() -> int64_t
+    {
+        return mks::metrics().gauge("server.sessions.active").value();
+    }
+
+    auto isRemoteActive(const mks::Server &server) -> bool
+    {
+        auto key = server.activeScreenKey();
+        return key && key->ownerId == "resume-client";
+    }
+
+    // Stands in for the plugin host, keeping only session events.
+    struct SessionLog final : mks::ServerEvents {
+        std::vector<std::string> entries;
+
+        auto publishScreens(std::span<const mks::TopologyScreen>) -> void override {}
+        auto publishClipboard(const mks::ClipboardOffer &, std::optional<mks::IPEndpoint>) -> void override {}
+        auto publishScreenSwitch(const mks::ScreenKey &, const mks::ScreenPoint &, bool) -> void override {}
+
+        auto publishSessionOpened(mks::IPEndpoint, std::string_view, bool resumed) -> void override
+        {
+            entries.push_back(resumed ? "resumed" : "opened");
+        }
+
+        auto publishSessionClosed(mks::IPEndpoint, std::string_view, bool suspended) -> void override
+        {
+            entries.push_back(suspended ? "suspended" : "closed");
+        }
+
+    protected:
+        auto publishInput(const mks::InputEvent &, uint32_t) -> void override {}
+    };
+
+    // Cut the connection off inside a frame, which the server takes for a
+    // broken link rather than a client that left.
+    auto dropConnection(mks::RpcTransport &transport) -> mks::IoTask<void>
+    {
+        const auto partialHeader = std::array{std::byte{0}, std::byte{8}};
+        ILIAS_CO_TRYV(co_await transport.writeRaw(partialHeader));
+        transport.close();
+        co_return {};
+    }
+
+    // Push the server cursor across its right edge onto the client screen.
+    auto enterClientScreen(mks::test::MockPlatform &platform) -> void
+    {
+        platform.capture()->push(mks::MouseMoveEvent{.x = 1919, .y = 540});
+        platform.capture()->push(mks::MouseMoveEvent{.x = 1929, .y = 540, .deltaX = 10});
+    }
+
 } // namespace
 
 ILIAS_TEST(InputPipelineLoopback, CompleteMouseAndKeyboardFlowReachesClientInjector)
@@ -133,6 +206,484 @@ ILIAS_TEST(InputPipelineLoopback, CompleteMouseAndKeyboardFlowReachesClientInjec
     co_return;
 }
 
+#if defined(__linux__)
+ILIAS_TEST(InputPipelineLoopback, ShardedWritersDeliverInputInOrder)
+{
+    auto endpoint = makeEndpoint(30208);
+    auto serverPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("server", 1920, 1080)});
+    auto clientPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("client", 2560, 1440)});
+    auto server = mks::Server{serverPlatform, endpoint};
+    server.setIoThreads(2);
+    auto client = mks::Client{clientPlatform, endpoint};
+
+    serverPlatform->actions()
+        .frequency(250_hz)
+        .mouse()
+        .set(1919, 540)
+        .sleep(16ms)
+        .interpolationMove(1929, 550, 32ms, 125_hz)
+        .click(mks::MouseButton::Left)
+        .keyboard()
+        .repeat(mks::Key::B, 16ms, 125_hz, mks::KeyModifier::None, 31);
+    clientPlatform->expect()
+        .mouse()
+        .set(0, 720)
+        .interpolationMove(10, 730, 32ms, 125_hz)
+        .click(mks::MouseButton::Left)
+        .keyboard()
+        .repeat(mks::Key::B, 16ms, 125_hz, mks::KeyModifier::None, 31);
+
+    auto runClient = [&]() -> mks::IoTask<void> {
+        co_await ilias::sleep(20ms);
+        co_return co_await client.run();
+    };
+
+    auto exercisePipeline = [&]() -> mks::Task<bool> {
+        auto connected =
+            co_await waitUntil([&] { return server.topologyScreens().size() == 2; }, 1s);
+        if (!connected) {
+            co_return false;
+        }
+        if (!co_await serverPlatform->play()) {
+            co_return false;
+        }
+        co_return co_await clientPlatform->waitForExpected(1s);
+    };
+
+    auto [serverResult, clientResult, exercised] =
+        co_await ilias::whenAny(server.run(), runClient(), exercisePipeline());
+
+    EXPECT_TRUE(exercised.has_value())
+        << "server or client stopped before the sharded input flow completed";
+    if (!exercised) {
+        co_return;
+    }
+    EXPECT_TRUE(*exercised) << "sharded input flow timed out";
+    EXPECT_GE(mks::metrics().counter("io_shards.jobs").value(), 1U);
+
+    auto verification = clientPlatform->verify();
+    EXPECT_TRUE(static_cast<bool>(verification)) << verification.description;
+}
+#endif
+
+ILIAS_TEST(InputPipelineLoopback, RejectedClientRollsBackInjector)
+{
+    auto endpoint       = makeEndpoint(30202);
+    auto serverPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("server", 1920, 1080)});
+    auto clientPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("client", 2560, 1440)});
+    auto server = mks::Server{serverPlatform, endpoint,
+                              mks::AppConfig{.trustedClients = {{.machineId = "someone-else"}}}};
+    auto client = mks::Client{clientPlatform, endpoint};
+
+    auto runClient = [&]() -> mks::IoTask<void> {
+        co_await ilias::sleep(20ms);
+        co_return co_await client.run();
+    };
+
+    auto [serverResult, clientResult] = co_await ilias::whenAny(server.run(), runClient());
+    EXPECT_FALSE(serverResult.has_value());
+    EXPECT_TRUE(clientResult.has_value());
+    if (!clientResult) {
+        co_return;
+    }
+    EXPECT_FALSE(clientResult->has_value());
+    if (!*clientResult) {
+        EXPECT_EQ(clientResult->error(), mks::make_error_code(mks::RpcError::Rejected));
+    }
+    EXPECT_EQ(clientPlatform->injector()->initializeCount(), 1U);
+    EXPECT_FALSE(clientPlatform->injector()->initialized());
+    EXPECT_EQ(server.topologyScreens().size(), 1U);
+}
+
+ILIAS_TEST(InputPipelineLoopback, FailedConnectRollsBackInjector)
+{
+    // Nothing listens on this port.
+    auto clientPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("client", 2560, 1440)});
+    auto client = mks::Client{clientPlatform, makeEndpoint(30203)};
+
+    auto result = co_await client.run();
+    EXPECT_FALSE(result.has_value());
+    EXPECT_EQ(clientPlatform->injector()->initializeCount(), 1U);
+    EXPECT_FALSE(clientPlatform->injector()->initialized());
+}
+
+ILIAS_TEST(InputPipelineLoopback, ResumedClientKeepsRouteAndGetsHeldReleases)
+{
+    auto endpoint       = makeEndpoint(30204);
+    auto serverPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("server", 1920, 1080)});
+    auto server = mks::Server{serverPlatform, endpoint};
+    server.setResumeGracePeriod(5s);
+    const auto baseline = activeSessions();
+
+    auto scenario = [&]() -> mks::IoTask<void> {
+        co_await ilias::sleep(20ms);
+        auto token = std::string{};
+        {
+            ILIAS_CO_TRY(auto stream, co_await mks::TcpStream::connect(endpoint));
+            auto transport = mks::RpcTransport{std::move(stream)};
+            ILIAS_CO_TRYV(co_await transport.writeMessages(clientHandshake({})));
+            ILIAS_CO_TRY(auto reply, co_await transport.readMessage());
+            const auto *welcome = std::get_if<mks::WelcomeMessage>(&reply);
+            EXPECT_NE(welcome, nullptr);
+            if (!welcome) {
+                co_return {};
+            }
+            EXPECT_FALSE(welcome->resumed);
+            EXPECT_EQ(welcome->resumeGraceMs, 5000U);
+            token = welcome->resumeToken;
+
+            enterClientScreen(*serverPlatform);
+            ILIAS_CO_TRYV(co_await transport.readMessage()); // Entry move
+            serverPlatform->capture()->push(mks::KeyEvent{.key = mks::Key::A});
+            ILIAS_CO_TRY(auto pressed, co_await transport.readMessage());
+            EXPECT_TRUE(std::holds_alternative<mks::InputMessage>(pressed));
+            ILIAS_CO_TRYV(co_await dropConnection(transport));
+        }
+
+        // Suspended: the client screen keeps its cell and the cursor, and the
+        // release is held rather than dropped.
+        EXPECT_TRUE(co_await waitUntil([&] { return activeSessions() == baseline; }, 1s));
+        serverPlatform->capture()->push(mks::KeyEvent{.key = mks::Key::A, .release = true});
+        co_await ilias::sleep(20ms);
+        EXPECT_EQ(server.topologyScreens().size(), 2U);
+        EXPECT_TRUE(isRemoteActive(server));
+
+        ILIAS_CO_TRY(auto stream, co_await mks::TcpStream::connect(endpoint));
+        auto transport = mks::RpcTransport{std::move(stream)};
+        ILIAS_CO_TRYV(co_await transport.writeMessages(clientHandshake(token)));
+        ILIAS_CO_TRY(auto reply, co_await transport.readMessage());
+        const auto *welcome = std::get_if<mks::WelcomeMessage>(&reply);
+        EXPECT_NE(welcome, nullptr);
+        if (!welcome) {
+            co_return {};
+        }
+        EXPECT_TRUE(welcome->resumed);
+        EXPECT_EQ(welcome->resumeToken, token);
+
+        // Cursor position first, then the replayed release.
+        ILIAS_CO_TRY(auto entry, co_await transport.readMessage());
+        const auto *move = std::get_if<mks::InputMessage>(&entry);
+        EXPECT_TRUE(move && std::holds_alternative<mks::MouseMoveEvent>(move->event));
+        ILIAS_CO_TRY(auto released, co_await transport.readMessage());
+        const auto *release = std::get_if<mks::InputMessage>(&released);
+        const auto *key     = release ? std::get_if<mks::KeyEvent>(&release->event) : nullptr;
+        EXPECT_TRUE(key && key->key == mks::Key::A && key->release);
+        EXPECT_EQ(server.topologyScreens().size(), 2U);
+        EXPECT_TRUE(isRemoteActive(server));
+        co_return {};
+    };
+
+    auto [serverResult, scenarioResult] = co_await ilias::whenAny(server.run(), scenario());
+    EXPECT_FALSE(serverResult.has_value());
+    EXPECT_TRUE(scenarioResult.has_value());
+    if (scenarioResult) {
+        EXPECT_TRUE(scenarioResult->has_value()) << scenarioResult->error().message();
+    }
+}
+
+ILIAS_TEST(InputPipelineLoopback, ResumeStopsThePreviousConnection)
+{
+    auto endpoint       = makeEndpoint(30210);
+    auto serverPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("server", 1920, 1080)});
+    auto server = mks::Server{serverPlatform, endpoint};
+    server.setResumeGracePeriod(5s);
+    const auto baseline = activeSessions();
+
+    auto scenario = [&]() -> mks::IoTask<void> {
+        co_await ilias::sleep(20ms);
+        ILIAS_CO_TRY(auto oldStream, co_await mks::TcpStream::connect(endpoint));
+        auto oldTransport = mks::RpcTransport{std::move(oldStream)};
+        ILIAS_CO_TRYV(co_await oldTransport.writeMessages(clientHandshake({})));
+        ILIAS_CO_TRY(auto reply, co_await oldTransport.readMessage());
+        const auto *welcome = std::get_if<mks::WelcomeMessage>(&reply);
+        EXPECT_NE(welcome, nullptr);
+        if (!welcome) {
+            co_return {};
+        }
+        const auto token = welcome->resumeToken;
+        enterClientScreen(*serverPlatform);
+        ILIAS_CO_TRYV(co_await oldTransport.readMessage()); // Entry move
+
+        // Roaming: the client comes back on a new socket before the server
+        // noticed the old one is gone.
+        ILIAS_CO_TRY(auto stream, co_await mks::TcpStream::connect(endpoint));
+        auto transport = mks::RpcTransport{std::move(stream)};
+        ILIAS_CO_TRYV(co_await transport.writeMessages(clientHandshake(token)));
+        ILIAS_CO_TRY(auto resumed, co_await transport.readMessage());
+        const auto *again = std::get_if<mks::WelcomeMessage>(&resumed);
+        EXPECT_TRUE(again && again->resumed);
+
+        // The server hangs up on the old socket, and that close leaves the
+        // resumed route alone.
+        auto ended = co_await oldTransport.readMessage();
+        EXPECT_FALSE(ended.has_value());
+        EXPECT_TRUE(co_await waitUntil([&] { return activeSessions() == baseline + 1; }, 1s));
+        EXPECT_EQ(server.topologyScreens().size(), 2U);
+        EXPECT_TRUE(isRemoteActive(server));
+        co_return {};
+    };
+
+    auto [serverResult, scenarioResult] = co_await ilias::whenAny(server.run(), scenario());
+    EXPECT_FALSE(serverResult.has_value());
+    EXPECT_TRUE(scenarioResult.has_value());
+    if (scenarioResult) {
+        EXPECT_TRUE(scenarioResult->has_value()) << scenarioResult->error().message();
+    }
+}
+
+ILIAS_TEST(InputPipelineLoopback, SuspendedRouteExpiresAfterGracePeriod)
+{
+    auto endpoint       = makeEndpoint(30205);
+    auto serverPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("server", 1920, 1080)});
+    auto server = mks::Server{serverPlatform, endpoint};
+    server.setResumeGracePeriod(50ms);
+
+    auto scenario = [&]() -> mks::IoTask<void> {
+        co_await ilias::sleep(20ms);
+        {
+            ILIAS_CO_TRY(auto stream, co_await mks::TcpStream::connect(endpoint));
+            auto transport = mks::RpcTransport{std::move(stream)};
+            ILIAS_CO_TRYV(co_await transport.writeMessages(clientHandshake({})));
+            ILIAS_CO_TRYV(co_await transport.readMessage()); // Welcome
+            enterClientScreen(*serverPlatform);
+            ILIAS_CO_TRYV(co_await transport.readMessage()); // Entry move
+            EXPECT_TRUE(isRemoteActive(server));
+            ILIAS_CO_TRYV(co_await dropConnection(transport));
+        }
+
+        // Control comes home only once the grace period is over.
+        EXPECT_TRUE(co_await waitUntil([&] { return server.topologyScreens().size() == 1; }, 1s));
+        EXPECT_FALSE(isRemoteActive(server));
+        EXPECT_FALSE(serverPlatform->capture()->remoteControlActive());
+        co_return {};
+    };
+
+    auto [serverResult, scenarioResult] = co_await ilias::whenAny(server.run(), scenario());
+    EXPECT_FALSE(serverResult.has_value());
+    EXPECT_TRUE(scenarioResult.has_value());
+    if (scenarioResult) {
+        EXPECT_TRUE(scenarioResult->has_value()) << scenarioResult->error().message();
+    }
+}
+
+ILIAS_TEST(InputPipelineLoopback, CleanDisconnectReleasesActiveScreen)
+{
+    auto endpoint       = makeEndpoint(30209);
+    auto serverPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("server", 1920, 1080)});
+    auto events = SessionLog{};
+    auto server = mks::Server{serverPlatform, endpoint};
+    server.setResumeGracePeriod(5s);
+    server.setEvents(&events);
+
+    auto scenario = [&]() -> mks::IoTask<void> {
+        co_await ilias::sleep(20ms);
+        {
+            ILIAS_CO_TRY(auto stream, co_await mks::TcpStream::connect(endpoint));
+            auto transport = mks::RpcTransport{std::move(stream)};
+            ILIAS_CO_TRYV(co_await transport.writeMessages(clientHandshake({})));
+            ILIAS_CO_TRY(auto reply, co_await transport.readMessage());
+            const auto *welcome = std::get_if<mks::WelcomeMessage>(&reply);
+            EXPECT_TRUE(welcome && !welcome->resumeToken.empty());
+            enterClientScreen(*serverPlatform);
+            ILIAS_CO_TRYV(co_await transport.readMessage()); // Entry move
+            EXPECT_TRUE(isRemoteActive(server));
+            (void) co_await transport.shutdown();
+            transport.close();
+        }
+
+        // A client that quits is not coming back: control returns well
+        // within the grace period, and input goes to the local screen.
+        EXPECT_TRUE(co_await waitUntil([&] { return server.topologyScreens().size() == 1; }, 1s));
+        EXPECT_FALSE(isRemoteActive(server));
+        EXPECT_FALSE(serverPlatform->capture()->remoteControlActive());
+        EXPECT_EQ(events.entries, (std::vector<std::string>{"opened", "closed"}));
+        co_return {};
+    };
+
+    auto [serverResult, scenarioResult] = co_await ilias::whenAny(server.run(), scenario());
+    EXPECT_FALSE(serverResult.has_value());
+    EXPECT_TRUE(scenarioResult.has_value());
+    if (scenarioResult) {
+        EXPECT_TRUE(scenarioResult->has_value()) << scenarioResult->error().message();
+    }
+}
+
+ILIAS_TEST(InputPipelineLoopback, ScreenHotPlugKeepsActiveRoute)
+{
+    auto endpoint       = makeEndpoint(30206);
+    auto serverPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("server", 1920, 1080)});
+    auto clientPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("laptop", 2560, 1440)});
+    auto server = mks::Server{serverPlatform, endpoint};
+    auto client = mks::Client{clientPlatform, endpoint, mks::AppConfig{.machineId = "hotplug-client"}};
+    const auto laptopKey = mks::ScreenKey{.ownerId = "hotplug-client", .screenIndex = 0};
+    auto dock            = makeScreen("dock", 1920, 1080);
+    dock.x               = 2560;
+    dock.primary         = false;
+
+    auto scenario = [&]() -> mks::IoTask<void> {
+        co_await ilias::sleep(20ms);
+        auto [clientResult, steps] = co_await ilias::whenAny(
+            client.run(), [&]() -> mks::Task<void> {
+                EXPECT_TRUE(co_await waitUntil([&] { return server.topologyScreens().size() == 2; }, 1s));
+                enterClientScreen(*serverPlatform);
+                EXPECT_TRUE(co_await waitUntil([&] { return server.activeScreenKey() == laptopKey; }, 1s));
+
+                // Docking the client adds one screen; the cursor stays on the laptop.
+                clientPlatform->setScreens({makeScreen("laptop", 2560, 1440), dock});
+                EXPECT_TRUE(co_await waitUntil([&] { return server.topologyScreens().size() == 3; }, 1s));
+                EXPECT_EQ(server.activeScreenKey(), laptopKey);
+
+                // So does a monitor plugged into the server itself.
+                serverPlatform->setScreens({makeScreen("server", 1920, 1080), dock});
+                EXPECT_TRUE(co_await waitUntil([&] { return server.topologyScreens().size() == 4; }, 1s));
+                EXPECT_EQ(server.activeScreenKey(), laptopKey);
+
+                // Undocking drops only the dock.
+                clientPlatform->setScreens({makeScreen("laptop", 2560, 1440)});
+                EXPECT_TRUE(co_await waitUntil([&] { return server.topologyScreens().size() == 3; }, 1s));
+                EXPECT_EQ(server.activeScreenKey(), laptopKey);
+            }());
+        EXPECT_FALSE(clientResult.has_value()) << "client ended during hot-plug";
+        co_return {};
+    };
+
+    auto [serverResult, scenarioResult] = co_await ilias::whenAny(server.run(), scenario());
+    EXPECT_FALSE(serverResult.has_value());
+    EXPECT_TRUE(scenarioResult.has_value());
+    if (scenarioResult) {
+        EXPECT_TRUE(scenarioResult->has_value()) << scenarioResult->error().message();
+    }
+}
+
+ILIAS_TEST(InputPipelineLoopback, ClipboardPastesLazily)
+{
+    auto endpoint       = makeEndpoint(30207);
+    auto serverPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("server", 1920, 1080)});
+    auto clientPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("client", 2560, 1440)});
+    auto server = mks::Server{serverPlatform, endpoint};
+    auto client = mks::Client{clientPlatform, endpoint, mks::AppConfig{.machineId = "clipboard-client"}};
+
+    // Several chunks' worth, so the paste streams.
+    auto image = std::vector<std::byte>(200 * 1024);
+    for (auto index = size_t{0}; index < image.size(); ++index) {
+        image[index] = static_cast<std::byte>(index % 251);
+    }
+    const auto text = std::vector{std::byte{'h'}, std::byte{'i'}};
+
+    auto scenario = [&]() -> mks::IoTask<void> {
+        co_await ilias::sleep(20ms);
+        auto [clientResult, steps] = co_await ilias::whenAny(
+            client.run(), [&]() -> mks::Task<void> {
+                EXPECT_TRUE(co_await waitUntil([&] { return server.topologyScreens().size() == 2; }, 1s));
+                EXPECT_TRUE(clientPlatform->clipboard()->copy({
+                    {.mime = "text/plain;charset=utf-8", .bytes = text},
+                    {.mime = "image/png", .bytes = image},
+                }));
+
+                // Only the advertisement crosses the link on copy.
+                auto &serverClipboard = *serverPlatform->clipboard();
+                EXPECT_TRUE(co_await waitUntil([&] { return serverClipboard.published().has_value(); }, 1s));
+                const auto offer = serverClipboard.published();
+                EXPECT_EQ(offer ? offer->formats.size() : 0U, 2U);
+                EXPECT_EQ(offer && offer->formats.size() == 2 ? offer->formats[1].size : 0U, image.size());
+                EXPECT_EQ(clientPlatform->clipboard()->reads(), 0U);
+
+                auto pasted = co_await serverClipboard.paste("image/png");
+                EXPECT_TRUE(pasted.has_value()) << pasted.error().message();
+                EXPECT_TRUE(pasted && *pasted == image);
+                EXPECT_EQ(clientPlatform->clipboard()->reads(), 1U);
+
+                // A format that was never offered fails without touching the client.
+                auto missing = co_await serverClipboard.paste("text/html");
+                EXPECT_FALSE(missing.has_value());
+                EXPECT_EQ(clientPlatform->clipboard()->reads(), 1U);
+            }());
+        EXPECT_FALSE(clientResult.has_value()) << "client ended during the paste";
+        co_return {};
+    };
+
+    auto [serverResult, scenarioResult] = co_await ilias::whenAny(server.run(), scenario());
+    EXPECT_FALSE(serverResult.has_value());
+    EXPECT_TRUE(scenarioResult.has_value());
+    if (scenarioResult) {
+        EXPECT_TRUE(scenarioResult->has_value()) << scenarioResult->error().message();
+    }
+}
+
+ILIAS_TEST(InputPipelineLoopback, ProxyResetSuspendsRouteAndClientResumes)
+{
+    auto endpoint       = makeEndpoint(30211);
+    auto proxied        = makeEndpoint(30212);
+    auto serverPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("server", 1920, 1080)});
+    auto clientPlatform =
+        std::make_shared<mks::test::MockPlatform>(std::vector{makeScreen("client", 2560, 1440)});
+    auto server = mks::Server{serverPlatform, endpoint};
+    server.setResumeGracePeriod(5s);
+    auto log = SessionLog{};
+    server.setEvents(&log);
+    // A small link buffer, so a stalled link leaves the server's input unread
+    // in the proxy's socket instead of in the link.
+    auto proxy  = mks::test::ImpairedProxy{proxied, endpoint, {}, {.bufferBytes = 1024}};
+    auto client = mks::Client{clientPlatform, proxied, mks::AppConfig{.machineId = "resume-client"}};
+    auto &resumed = mks::metrics().counter("client.sessions.resumed");
+    const auto resumedBefore = resumed.value();
+
+    auto scenario = [&]() -> mks::IoTask<void> {
+        co_await ilias::sleep(20ms);
+        auto [clientResult, steps] = co_await ilias::whenAny(
+            client.run(), [&]() -> mks::Task<void> {
+                EXPECT_TRUE(co_await waitUntil([&] { return server.topologyScreens().size() == 2; }, 1s));
+                enterClientScreen(*serverPlatform);
+                EXPECT_TRUE(co_await waitUntil([&] { return isRemoteActive(server); }, 1s));
+
+                proxy.stall(1h);
+                for (auto index = 0; index < 200; ++index) {
+                    serverPlatform->capture()->push(mks::KeyEvent{.key = mks::Key::A, .release = index % 2 == 1});
+                    if (index % 20 == 19) {
+                        co_await ilias::sleep(1ms);
+                    }
+                }
+                co_await ilias::sleep(50ms);
+
+                // The proxy drops both sockets with input unread: the server
+                // sees a broken connection and keeps the route for the client,
+                // which dials back through the proxy with its token.
+                proxy.reset();
+                EXPECT_TRUE(co_await waitUntil([&] { return resumed.value() == resumedBefore + 1; }, 2s));
+                EXPECT_EQ(proxy.connections(), 2U);
+                EXPECT_EQ(log.entries, (std::vector<std::string>{"opened", "suspended", "resumed"}));
+                EXPECT_EQ(server.topologyScreens().size(), 2U);
+                EXPECT_TRUE(isRemoteActive(server));
+                EXPECT_EQ(clientPlatform->injector()->initializeCount(), 1U);
+            }());
+        EXPECT_FALSE(clientResult.has_value()) << "client ended instead of resuming";
+        co_return {};
+    };
+
+    auto [serverResult, proxyResult, scenarioResult] =
+        co_await ilias::whenAny(server.run(), proxy.run(), scenario());
+    EXPECT_FALSE(serverResult.has_value());
+    EXPECT_FALSE(proxyResult.has_value());
+    EXPECT_TRUE(scenarioResult.has_value());
+    if (scenarioResult) {
+        EXPECT_TRUE(scenarioResult->has_value()) << scenarioResult->error().message();
+    }
+}
+
 int main(int argc, char **argv)
 {
     ILIAS_TEST_SETUP_UTF8();
@@ -0,0 +1,237 @@
+#include "preinclude.hpp"
+#include "app/input_replay.hpp"
+#include "support/mock_platform.hpp"
+
+#include <gtest/gtest.h>
+#include <ilias/testing.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+auto tempPath(std::string_view name) -> std::filesystem::path {
+    auto path = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove(path);
+    return path;
+}
+
+auto makeScreen(std::string name) -> mks::ScreenInfo {
+    return mks::ScreenInfo {
+        .x = 0,
+        .y = 0,
+        .width = 1920,
+        .height = 1080,
+        .dpi = 96,
+        .name = std::move(name),
+        .primary = true,
+    };
+}
+
+auto sampleEvents() -> std::vector<mks::InputEvent> {
+    return {
+        mks::KeyEvent {.key = mks::Key::A, .nativeCode = 38, .repeat = true},
+        mks::MouseButtonEvent {.x = 10, .y = 20, .screenIndex = 1, .button = mks::MouseButton::Left, .release = true},
+        mks::MouseMoveEvent {.x = 640, .y = 480, .screenIndex = 0, .deltaX = -3, .deltaY = 4},
+        mks::MouseWheelEvent {.x = 1, .y = 2, .deltaX = 0, .deltaY = -120},
+    };
+}
+
+auto writeRecording(const std::filesystem::path &path, const std::vector<mks::InputEvent> &events) -> void {
+    auto writer = mks::InputRecordWriter::open(path);
+    ASSERT_TRUE(writer.has_value()) << writer.error().message();
+    ASSERT_TRUE(writer->appendScreens({makeScreen("recorded")}).has_value());
+    for (const auto &event : events) {
+        ASSERT_TRUE(writer->append(event).has_value());
+    }
+    ASSERT_TRUE(writer->flush().has_value());
+}
+
+auto formatEvent(const mks::InputEvent &event) -> std::string {
+    return fmtlib::format("{}", event);
+}
+
+} // namespace
+
+TEST(InputRecord, EncodeDecodeRoundTrip) {
+    for (const auto &event : sampleEvents()) {
+        auto decoded = mks::decodeInputRecord(mks::encodeInputRecord(event, 42));
+        ASSERT_TRUE(decoded.has_value());
+        EXPECT_EQ(formatEvent(*decoded), formatEvent(event));
+    }
+}
+
+TEST(InputRecord, FileRoundTripKeepsOrderAndScreens) {
+    const auto path = tempPath("mks_input_record_roundtrip.rec");
+    const auto events = sampleEvents();
+    writeRecording(path, events);
+
+    auto reader = mks::InputRecordReader::open(path);
+    ASSERT_TRUE(reader.has_value()) << reader.error().message();
+    ASSERT_EQ(reader->screens().size(), 1U);
+    EXPECT_EQ(reader->screens()[0].name, "recorded");
+    EXPECT_EQ(reader->screens()[0].width, 1920);
+
+    auto previous = uint64_t {0};
+    for (const auto &expected : events) {
+        auto next = reader->nextEvent();
+        ASSERT_TRUE(next.has_value());
+        EXPECT_EQ(formatEvent(next->event), formatEvent(expected));
+        EXPECT_GE(next->timeNs, previous);
+        previous = next->timeNs;
+    }
+    EXPECT_FALSE(reader->nextEvent().has_value());
+
+    reader->rewind();
+    EXPECT_TRUE(reader->nextEvent().has_value());
+    std::filesystem::remove(path);
+}
+
+TEST(InputRecord, TruncatedTailEndsCleanly) {
+    const auto path = tempPath("mks_input_record_truncated.rec");
+    writeRecording(path, sampleEvents());
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 7);
+
+    auto reader = mks::InputRecordReader::open(path);
+    ASSERT_TRUE(reader.has_value()) << reader.error().message();
+    auto count = 0;
+    while (reader->nextEvent()) {
+        ++count;
+    }
+    EXPECT_EQ(count, 3);
+    std::filesystem::remove(path);
+}
+
+TEST(InputRecord, RejectsForeignFiles) {
+    const auto path = tempPath("mks_input_record_foreign.rec");
+    {
+        auto file = std::ofstream {path, std::ios::binary};
+        file << "definitely not a recording, but long enough for a header";
+    }
+    auto reader = mks::InputRecordReader::open(path);
+    ASSERT_FALSE(reader.has_value());
+    EXPECT_EQ(reader.error(), mks::make_error_code(mks::InputRecordError::BadMagic));
+    std::filesystem::remove(path);
+}
+
+TEST(InputRecord, RequiresScreenSnapshot) {
+    const auto path = tempPath("mks_input_record_noscreens.rec");
+    {
+        auto writer = mks::InputRecordWriter::open(path);
+        ASSERT_TRUE(writer.has_value());
+        ASSERT_TRUE(writer->append(sampleEvents()[0]).has_value());
+    }
+    auto reader = mks::InputRecordReader::open(path);
+    ASSERT_FALSE(reader.has_value());
+    EXPECT_EQ(reader.error(), mks::make_error_code(mks::InputRecordError::NoScreens));
+    std::filesystem::remove(path);
+}
+
+TEST(InputReplay, ParsesSpeed) {
+    EXPECT_EQ(mks::parseReplaySpeed("1"), 1.0);
+    EXPECT_EQ(mks::parseReplaySpeed("2.5"), 2.5);
+    EXPECT_EQ(mks::parseReplaySpeed("max"), 0.0);
+    EXPECT_FALSE(mks::parseReplaySpeed("0").has_value());
+    EXPECT_FALSE(mks::parseReplaySpeed("-1").has_value());
+    EXPECT_FALSE(mks::parseReplaySpeed("fast").has_value());
+}
+
+ILIAS_TEST(InputReplay, RecordingPlatformCapturesEvents) {
+    const auto path = tempPath("mks_input_record_platform.rec");
+    auto mock = std::make_shared<mks::test::MockPlatform>(std::vector {makeScreen("live")});
+    {
+        auto writer = mks::InputRecordWriter::open(path);
+        EXPECT_TRUE(writer.has_value());
+        if (!writer) {
+            co_return;
+        }
+        auto platform = mks::RecordingPlatform {
+            mock,
+            std::make_shared<mks::InputRecordWriter>(std::move(*writer)),
+        };
+        auto capture = platform.createCapture();
+        EXPECT_TRUE((co_await capture->initialize()).has_value());
+        for (const auto &event : sampleEvents()) {
+            EXPECT_TRUE(mock->capture()->push(event));
+            auto captured = co_await capture->nextEvent();
+            EXPECT_EQ(formatEvent(captured), formatEvent(event));
+        }
+        co_await capture->shutdown();
+    }
+
+    auto reader = mks::InputRecordReader::open(path);
+    EXPECT_TRUE(reader.has_value());
+    if (reader) {
+        EXPECT_EQ(reader->screens()[0].name, "live");
+        auto count = 0;
+        while (reader->nextEvent()) {
+            ++count;
+        }
+        EXPECT_EQ(count, 4);
+    }
+    std::filesystem::remove(path);
+}
+
+ILIAS_TEST(InputReplay, ReplaysAtMaxSpeedThenFinishes) {
+    const auto path = tempPath("mks_input_record_replay.rec");
+    const auto events = sampleEvents();
+    writeRecording(path, events);
+
+    auto platform = mks::ReplayPlatform::open(path, mks::ReplayOptions {.speed = 0});
+    EXPECT_TRUE(platform.has_value());
+    if (!platform) {
+        co_return;
+    }
+    EXPECT_EQ((*platform)->screens()[0].name, "recorded");
+    EXPECT_EQ((*platform)->createInjector(), nullptr);
+
+    auto capture = (*platform)->createCapture();
+    EXPECT_TRUE((co_await capture->initialize()).has_value());
+    for (const auto &expected : events) {
+        auto replayed = co_await capture->nextEvent();
+        EXPECT_EQ(formatEvent(replayed), formatEvent(expected));
+    }
+    EXPECT_EQ((*platform)->capture()->replayed(), events.size());
+
+    using namespace std::chrono_literals;
+    auto [parked, timeout] = co_await ilias::whenAny(capture->nextEvent(), ilias::sleep(20ms));
+    EXPECT_FALSE(parked.has_value());
+    EXPECT_TRUE(timeout.has_value());
+    EXPECT_TRUE((*platform)->capture()->finished());
+    std::filesystem::remove(path);
+}
+
+ILIAS_TEST(InputReplay, StartGateHoldsPlayback) {
+    const auto path = tempPath("mks_input_record_gate.rec");
+    writeRecording(path, sampleEvents());
+
+    auto open = false;
+    auto platform = mks::ReplayPlatform::open(path, mks::ReplayOptions {
+        .speed = 0,
+        .startGate = [&open] { return open; },
+    });
+    EXPECT_TRUE(platform.has_value());
+    if (!platform) {
+        co_return;
+    }
+    auto capture = (*platform)->createCapture();
+
+    using namespace std::chrono_literals;
+    auto [held, timeout] = co_await ilias::whenAny(capture->nextEvent(), ilias::sleep(100ms));
+    EXPECT_FALSE(held.has_value());
+    EXPECT_TRUE(timeout.has_value());
+
+    open = true;
+    auto first = co_await capture->nextEvent();
+    EXPECT_EQ(formatEvent(first), formatEvent(sampleEvents()[0]));
+    std::filesystem::remove(path);
+}
+
+int main(int argc, char **argv) {
+    ILIAS_TEST_SETUP_UTF8();
+    ilias::PlatformContext context {};
+    context.install();
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
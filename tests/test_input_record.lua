@@ -0,0 +1,9 @@
+target("test_input_record")
+    local test_file = path.join(os.scriptdir(), "test_input_record.cpp")
+    mks_apply_test_settings(test_file)
+    add_files(test_file)
+    add_files(
+        path.join(os.projectdir(), "src/app/input_record.cpp"),
+        path.join(os.projectdir(), "src/app/input_replay.cpp")
+    )
+target_end()
@@ -0,0 +1,186 @@
+#include "preinclude.hpp"
+#include "app/io_shards.hpp"
+#include "app/mpsc_queue.hpp"
+#include "app/outbound_queue.hpp"
+
+#include <gtest/gtest.h>
+#include <ilias/testing.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+auto keyMessage(uint32_t code) -> mks::RpcMessage {
+    return mks::RpcMessage {mks::InputMessage {
+        .event = mks::KeyEvent {.key = mks::Key::A, .nativeCode = code},
+    }};
+}
+
+auto codeOf(const mks::RpcMessage &message) -> uint32_t {
+    const auto *input = std::get_if<mks::InputMessage>(&message);
+    if (!input) {
+        return 0;
+    }
+    const auto *key = std::get_if<mks::KeyEvent>(&input->event);
+    return key ? key->nativeCode : 0;
+}
+
+} // namespace
+
+TEST(MpscQueue, KeepsOrderAndRefusesWhenFull) {
+    auto queue = mks::MpscQueue<int> {3};
+    EXPECT_EQ(queue.capacity(), 4U);
+    EXPECT_TRUE(queue.empty());
+    for (auto value = 0; value < 4; ++value) {
+        EXPECT_TRUE(queue.tryPush(int {value}));
+    }
+    EXPECT_FALSE(queue.tryPush(4));
+    for (auto value = 0; value < 4; ++value) {
+        EXPECT_EQ(queue.tryPop(), value);
+    }
+    EXPECT_FALSE(queue.tryPop());
+    // Slots are reused on the next lap.
+    EXPECT_TRUE(queue.tryPush(5));
+    EXPECT_EQ(queue.tryPop(), 5);
+}
+
+TEST(MpscQueue, DeliversEveryPushFromManyThreadsOnce) {
+    constexpr auto producers = 4;
+    constexpr auto perProducer = 20'000;
+    auto queue = mks::MpscQueue<int> {64};
+    auto seen = std::vector<int>(producers * perProducer, 0);
+    {
+        auto threads = std::vector<std::jthread> {};
+        for (auto producer = 0; producer < producers; ++producer) {
+            threads.emplace_back([&queue, producer] {
+                for (auto index = 0; index < perProducer; ++index) {
+                    while (!queue.tryPush(producer * perProducer + index)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        // Each producer's values must come out in the order it pushed them.
+        auto last = std::vector<int>(producers, -1);
+        for (auto received = 0; received < producers * perProducer;) {
+            auto value = queue.tryPop();
+            if (!value) {
+                std::this_thread::yield();
+                continue;
+            }
+            ++seen[*value];
+            EXPECT_GT(*value, last[*value / perProducer]);
+            last[*value / perProducer] = *value;
+            ++received;
+        }
+    }
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(std::count(seen.begin(), seen.end(), 1), producers * perProducer);
+}
+
+#if defined(__linux__)
+
+TEST(OutboundQueue, RefusesMessagesOnceClosed) {
+    auto queue = mks::OutboundQueue::create(2, 1);
+    ASSERT_TRUE(queue);
+    auto sender = mks::OutboundSender {*queue, mks::OutboundQueue::Lane::Urgent};
+    EXPECT_TRUE(sender.trySend(keyMessage(1)));
+    EXPECT_TRUE(sender.trySend(keyMessage(2)));
+    EXPECT_FALSE(sender.trySend(keyMessage(3)));
+    (*queue)->close();
+    EXPECT_TRUE((*queue)->closed());
+    auto bulk = mks::OutboundSender {*queue, mks::OutboundQueue::Lane::Bulk};
+    EXPECT_FALSE(bulk.trySend(keyMessage(4)));
+}
+
+ILIAS_TEST(OutboundQueue, ReceiverTakesUrgentFirstAndWakesForOtherThreads) {
+    auto queue = mks::OutboundQueue::create(8, 8);
+    EXPECT_TRUE(queue);
+    if (!queue) {
+        co_return;
+    }
+    auto urgent = mks::OutboundSender {*queue, mks::OutboundQueue::Lane::Urgent};
+    auto bulk = mks::OutboundSender {*queue, mks::OutboundQueue::Lane::Bulk};
+    EXPECT_TRUE(bulk.trySend(keyMessage(10)));
+    EXPECT_TRUE(urgent.trySend(keyMessage(1)));
+
+    auto receiver = mks::OutboundReceiver {*queue};
+    auto first = co_await receiver.recv();
+    auto second = co_await receiver.recv();
+    EXPECT_TRUE(first && second);
+    if (!first || !second) {
+        co_return;
+    }
+    EXPECT_EQ(codeOf(*first), 1U);
+    EXPECT_EQ(codeOf(*second), 10U);
+
+    // The receiver is asleep on the eventfd when this one arrives.
+    auto producer = std::jthread {[urgent]() mutable {
+        std::this_thread::sleep_for(20ms);
+        (void) urgent.trySend(keyMessage(2));
+    }};
+    auto woken = co_await receiver.recv();
+    EXPECT_TRUE(woken);
+    if (woken) {
+        EXPECT_EQ(codeOf(*woken), 2U);
+    }
+
+    (*queue)->close();
+    auto closed = co_await receiver.recv();
+    EXPECT_FALSE(closed);
+    if (!closed) {
+        EXPECT_EQ(closed.error(), std::make_error_code(std::errc::operation_canceled));
+    }
+}
+
+ILIAS_TEST(IoShards, RunsJobsOnShardThreadsAndResumesTheCaller) {
+    auto shards = mks::IoShards {};
+    EXPECT_TRUE(shards.start(2));
+    EXPECT_EQ(shards.size(), 2U);
+    EXPECT_FALSE(shards.start(1));
+    const auto caller = std::this_thread::get_id();
+
+    auto ranOn = std::make_shared<std::atomic<std::thread::id>>();
+    auto ran = co_await shards.run([ranOn]() -> mks::IoTask<void> {
+        return [](std::shared_ptr<std::atomic<std::thread::id>> target) -> mks::IoTask<void> {
+            co_await ilias::sleep(1ms);
+            target->store(std::this_thread::get_id());
+            co_return {};
+        }(ranOn);
+    });
+    EXPECT_TRUE(ran);
+    EXPECT_NE(ranOn->load(), std::thread::id {});
+    EXPECT_NE(ranOn->load(), caller);
+    EXPECT_EQ(std::this_thread::get_id(), caller);
+
+    auto failed = co_await shards.run([]() -> mks::IoTask<void> {
+        return []() -> mks::IoTask<void> {
+            co_return mks::Err(std::make_error_code(std::errc::broken_pipe));
+        }();
+    });
+    EXPECT_FALSE(failed);
+    if (!failed) {
+        EXPECT_EQ(failed.error(), std::make_error_code(std::errc::broken_pipe));
+    }
+    shards.stop();
+    EXPECT_EQ(shards.size(), 0U);
+    EXPECT_FALSE(shards.post([] {
+        return []() -> mks::Task<void> { co_return; }();
+    }));
+}
+
+#endif
+
+int main(int argc, char **argv) {
+    ILIAS_TEST_SETUP_UTF8();
+    ilias::PlatformContext context {};
+    context.install();
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
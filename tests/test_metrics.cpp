@@ -0,0 +1,176 @@
+#include "preinclude.hpp"
+#include "app/control.hpp"
+#include "diag/metrics.hpp"
+
+#include <gtest/gtest.h>
+#include <ilias/testing.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+auto makeEndpoint(uint16_t port) -> mks::IPEndpoint {
+    auto endpoint = mks::IPEndpoint::fromString(fmtlib::format("127.0.0.1:{}", port));
+    if (!endpoint) {
+        throw std::runtime_error("invalid test endpoint");
+    }
+    return *endpoint;
+}
+
+} // namespace
+
+TEST(Histogram, SmallValuesUseExactBuckets) {
+    for (auto value = uint64_t {0}; value < mks::Histogram::kSubBuckets; ++value) {
+        const auto index = mks::Histogram::bucketIndex(value);
+        EXPECT_EQ(index, value);
+        EXPECT_EQ(mks::Histogram::bucketUpperBound(index), value);
+    }
+}
+
+TEST(Histogram, BucketBoundsContainTheirValues) {
+    const auto values = std::vector<uint64_t> {
+        8, 9, 15, 16, 17, 100, 1'000, 65'535, 1'000'000, uint64_t {1} << 40, ~uint64_t {0},
+    };
+    for (auto value : values) {
+        const auto index = mks::Histogram::bucketIndex(value);
+        ASSERT_LT(index, mks::Histogram::kBucketCount) << value;
+        const auto upper = mks::Histogram::bucketUpperBound(index);
+        EXPECT_GE(upper, value);
+        // Log-linear buckets keep the relative error within one sub-bucket.
+        EXPECT_LE(upper - value, value / mks::Histogram::kSubBuckets) << value;
+        if (index > 0) {
+            EXPECT_LT(mks::Histogram::bucketUpperBound(index - 1), value) << value;
+        }
+    }
+}
+
+TEST(Histogram, SnapshotReportsPercentiles) {
+    auto histogram = mks::Histogram {};
+    for (auto value = uint64_t {1}; value <= 1000; ++value) {
+        histogram.record(value);
+    }
+
+    const auto snapshot = histogram.snapshot();
+    EXPECT_EQ(snapshot.count, 1000U);
+    EXPECT_EQ(snapshot.sum, 500'500U);
+    EXPECT_EQ(snapshot.max, 1000U);
+    EXPECT_EQ(snapshot.mean(), 500U);
+    EXPECT_NEAR(static_cast<double>(snapshot.percentile(0.5)), 500.0, 500.0 / 8);
+    EXPECT_NEAR(static_cast<double>(snapshot.percentile(0.99)), 990.0, 990.0 / 8);
+    EXPECT_EQ(snapshot.percentile(1.0), 1000U);
+    EXPECT_EQ(mks::HistogramSnapshot {}.percentile(0.5), 0U);
+}
+
+TEST(MetricsRegistry, ReturnsStableReferencesByName) {
+    auto registry = mks::MetricsRegistry {};
+    auto &first = registry.counter("test.events");
+    for (auto index = 0; index < 100; ++index) {
+        (void) registry.counter(fmtlib::format("test.filler.{}", index));
+    }
+    auto &again = registry.counter("test.events");
+    EXPECT_EQ(&first, &again);
+
+    first.add(3);
+    registry.gauge("test.level").set(-2);
+    registry.histogram("test.latency").record(42);
+
+    const auto snapshot = registry.snapshot();
+    auto counter = std::ranges::find(
+        snapshot.counters,
+        "test.events",
+        &std::pair<std::string, uint64_t>::first
+    );
+    ASSERT_NE(counter, snapshot.counters.end());
+    EXPECT_EQ(counter->second, 3U);
+    ASSERT_EQ(snapshot.gauges.size(), 1U);
+    EXPECT_EQ(snapshot.gauges[0].second, -2);
+    ASSERT_EQ(snapshot.histograms.size(), 1U);
+    EXPECT_EQ(snapshot.histograms[0].second.count, 1U);
+
+    const auto text = mks::formatMetrics(snapshot);
+    EXPECT_NE(text.find("counter   test.events 3"), std::string::npos);
+    EXPECT_NE(text.find("gauge     test.level -2"), std::string::npos);
+    EXPECT_NE(text.find("histogram test.latency count=1"), std::string::npos);
+}
+
+TEST(MetricsRegistry, CountersAreSafeAcrossThreads) {
+    auto registry = mks::MetricsRegistry {};
+    auto &counter = registry.counter("test.concurrent");
+    auto &histogram = registry.histogram("test.concurrent_ns");
+
+    auto threads = std::vector<std::jthread> {};
+    for (auto thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&]() {
+            for (auto index = 0; index < 10'000; ++index) {
+                counter.add();
+                histogram.record(static_cast<uint64_t>(index));
+            }
+        });
+    }
+    threads.clear();
+
+    EXPECT_EQ(counter.value(), 40'000U);
+    EXPECT_EQ(histogram.snapshot().count, 40'000U);
+    EXPECT_EQ(histogram.snapshot().max, 9'999U);
+}
+
+ILIAS_TEST(ControlService, AnswersStatsAndRejectsUnknownCommands) {
+    const auto endpoint = makeEndpoint(30211);
+    mks::metrics().counter("test.control.visible").add(7);
+
+    auto control = mks::ControlService {endpoint};
+    control.addCommand("echo", []() {
+        return std::string {"pong"};
+    });
+
+    auto query = [&]() -> mks::IoTask<void> {
+        using namespace std::literals;
+        // Give the listener a turn to bind before connecting.
+        co_await ilias::sleep(20ms);
+
+        ILIAS_CO_TRY(auto stats, co_await mks::queryControl(endpoint, "stats"));
+        EXPECT_TRUE(stats.ok);
+        EXPECT_NE(stats.body.find("counter   test.control.visible 7"), std::string::npos)
+            << stats.body;
+
+        ILIAS_CO_TRY(auto echo, co_await mks::queryControl(endpoint, "echo"));
+        EXPECT_TRUE(echo.ok);
+        EXPECT_EQ(echo.body, "pong");
+
+        ILIAS_CO_TRY(auto unknown, co_await mks::queryControl(endpoint, "no-such-command"));
+        EXPECT_FALSE(unknown.ok);
+        EXPECT_NE(unknown.body.find("stats"), std::string::npos);
+        co_return {};
+    };
+
+    auto [controlResult, queryResult] = co_await ilias::whenAny(control.run(), query());
+    EXPECT_FALSE(controlResult.has_value());
+    EXPECT_TRUE(queryResult.has_value());
+    if (queryResult) {
+        EXPECT_TRUE(queryResult->has_value()) << queryResult->error().message();
+    }
+}
+
+TEST(ControlEndpoint, ResolvesDefaultsAndOff) {
+    auto fallback = mks::resolveControlEndpoint("", mks::kServerControlEndpoint);
+    ASSERT_TRUE(fallback.has_value());
+    ASSERT_TRUE(fallback->has_value());
+    EXPECT_EQ(fmtlib::format("{}", **fallback), mks::kServerControlEndpoint);
+
+    auto off = mks::resolveControlEndpoint("off", mks::kServerControlEndpoint);
+    ASSERT_TRUE(off.has_value());
+    EXPECT_FALSE(off->has_value());
+
+    EXPECT_FALSE(mks::resolveControlEndpoint("not an endpoint", mks::kServerControlEndpoint));
+}
+
+int main(int argc, char **argv) {
+    ILIAS_TEST_SETUP_UTF8();
+    ilias::PlatformContext context {};
+    context.install();
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
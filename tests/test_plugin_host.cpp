@@ -0,0 +1,207 @@
+#include "preinclude.hpp"
+#include "app/plugin_host.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// What a plugin instance saw, copied out of the views while they were valid.
+struct Recorder {
+    const mks_plugin_host *host = nullptr;
+    std::vector<uint32_t> types;
+    std::vector<const void *> inputs;
+    std::vector<std::string> strings;
+    // Subscription to switch to after the next event; 0xFFFFFFFF keeps it.
+    uint32_t resubscribe = 0xFFFFFFFF;
+    bool *destroyed = nullptr;
+};
+
+auto toString(mks_string text) -> std::string {
+    return std::string {text.data, text.size};
+}
+
+auto record(void *instance, const mks_event *event) -> void {
+    auto &self = *static_cast<Recorder *>(instance);
+    self.types.push_back(event->type);
+    switch (event->type) {
+        case MKS_EVENT_KEY: self.inputs.push_back(event->data.key); break;
+        case MKS_EVENT_MOUSE_MOVE: self.inputs.push_back(event->data.mouse_move); break;
+        case MKS_EVENT_SCREENS:
+            for (size_t index = 0; index < event->data.screens->count; ++index) {
+                const auto &screen = event->data.screens->screens[index];
+                self.strings.push_back(toString(screen.owner_id) + "/" + toString(screen.name));
+            }
+            break;
+        case MKS_EVENT_CLIPBOARD:
+            for (size_t index = 0; index < event->data.clipboard->format_count; ++index) {
+                self.strings.push_back(toString(event->data.clipboard->formats[index].mime));
+            }
+            break;
+        case MKS_EVENT_SCREEN_SWITCH:
+            self.strings.push_back(toString(event->data.screen_switch->from_owner_id));
+            self.strings.push_back(toString(event->data.screen_switch->to_owner_id));
+            break;
+        case MKS_EVENT_SESSION_CLOSED:
+            self.strings.push_back(toString(event->data.session->owner_id));
+            self.strings.push_back(event->data.session->suspended ? "suspended" : "gone");
+            break;
+        default: break;
+    }
+    if (self.resubscribe != 0xFFFFFFFF) {
+        self.host->subscribe(self.host->context, self.resubscribe);
+        self.resubscribe = 0xFFFFFFFF;
+    }
+}
+
+// Tests hand their Recorder over through this, as create has no user argument.
+Recorder *gNextRecorder = nullptr;
+
+auto makePlugin(uint32_t events) -> mks_plugin {
+    return mks_plugin {
+        .abi_version = MKS_PLUGIN_ABI_VERSION,
+        .name = "recorder",
+        .events = events,
+        .create = [](const mks_plugin_host *host) -> void * {
+            auto *recorder = gNextRecorder;
+            recorder->host = host;
+            return recorder;
+        },
+        .destroy = [](void *instance) {
+            auto &self = *static_cast<Recorder *>(instance);
+            if (self.destroyed) {
+                *self.destroyed = true;
+            }
+        },
+        .on_event = record,
+    };
+}
+
+} // namespace
+
+TEST(PluginHost, DeliversOnlySubscribedEvents) {
+    auto recorder = Recorder {};
+    gNextRecorder = &recorder;
+    const auto plugin = makePlugin(MKS_EVENT_KEY);
+    auto host = mks::PluginHost {};
+    ASSERT_TRUE(host.add(plugin));
+
+    EXPECT_TRUE(host.wants(MKS_EVENT_KEY));
+    EXPECT_FALSE(host.wants(MKS_EVENT_MOUSE_MOVE | MKS_EVENT_SCREENS));
+    host.publish(mks::InputEvent {mks::MouseMoveEvent {.x = 10, .y = 20}});
+    host.publishSessionClosed({}, "machine-a", false);
+    EXPECT_TRUE(recorder.types.empty());
+
+    const auto key = mks::InputEvent {mks::KeyEvent {.key = mks::Key::F12, .nativeCode = 96, .release = true}};
+    host.publish(key);
+    ASSERT_EQ(recorder.types, std::vector<uint32_t> {MKS_EVENT_KEY});
+    // The plugin reads the captured event itself, not a copy.
+    ASSERT_EQ(recorder.inputs.size(), 1U);
+    EXPECT_EQ(recorder.inputs[0], &std::get<mks::KeyEvent>(key));
+    const auto *view = static_cast<const mks_key_event *>(recorder.inputs[0]);
+    EXPECT_EQ(view->key, static_cast<uint32_t>(mks::Key::F12));
+    EXPECT_EQ(view->native_code, 96U);
+    EXPECT_TRUE(view->release);
+    EXPECT_FALSE(view->repeat);
+}
+
+TEST(PluginHost, SubscribeTakesEffectWithTheNextEvent) {
+    auto recorder = Recorder {.resubscribe = MKS_EVENT_SESSION};
+    gNextRecorder = &recorder;
+    const auto plugin = makePlugin(MKS_EVENT_MOUSE_MOVE);
+    auto host = mks::PluginHost {};
+    ASSERT_TRUE(host.add(plugin));
+
+    host.publish(mks::InputEvent {mks::MouseMoveEvent {.x = 1}});
+    host.publish(mks::InputEvent {mks::MouseMoveEvent {.x = 2}});
+    EXPECT_EQ(recorder.types, std::vector<uint32_t> {MKS_EVENT_MOUSE_MOVE});
+    EXPECT_FALSE(host.wants(MKS_EVENT_INPUT));
+
+    host.publishSessionClosed({}, "machine-a", true);
+    ASSERT_EQ(recorder.types.size(), 2U);
+    EXPECT_EQ(recorder.strings, (std::vector<std::string> {"machine-a", "suspended"}));
+}
+
+TEST(PluginHost, PublishesViewsOfScreensAndClipboard) {
+    auto recorder = Recorder {};
+    gNextRecorder = &recorder;
+    const auto plugin = makePlugin(MKS_EVENT_SCREENS | MKS_EVENT_CLIPBOARD);
+    auto host = mks::PluginHost {};
+    ASSERT_TRUE(host.add(plugin));
+
+    const auto screens = std::vector<mks::TopologyScreen> {
+        {.key = {.ownerId = "server"}, .info = {.name = "DP-1"}, .local = true},
+        {.key = {.ownerId = "laptop", .screenIndex = 1}, .cell = {.x = 1}, .info = {.name = "eDP-1"}},
+    };
+    host.publishScreens(screens);
+    host.publishClipboard(
+        mks::ClipboardOffer {
+            .serial = 7,
+            .formats = {{.mime = "text/plain", .size = 5}, {.mime = "text/html", .size = 30}},
+        },
+        std::nullopt
+    );
+    EXPECT_EQ(recorder.types, (std::vector<uint32_t> {MKS_EVENT_SCREENS, MKS_EVENT_CLIPBOARD}));
+    EXPECT_EQ(
+        recorder.strings,
+        (std::vector<std::string> {"server/DP-1", "laptop/eDP-1", "text/plain", "text/html"})
+    );
+}
+
+TEST(PluginHost, RefusesIncompatiblePlugins) {
+    auto host = mks::PluginHost {};
+    auto newer = makePlugin(MKS_EVENT_KEY);
+    newer.abi_version = MKS_PLUGIN_ABI_VERSION + 1;
+    auto added = host.add(newer);
+    ASSERT_FALSE(added);
+    EXPECT_EQ(added.error(), mks::make_error_code(mks::PluginError::AbiMismatch));
+
+    auto refusing = makePlugin(MKS_EVENT_KEY);
+    refusing.create = [](const mks_plugin_host *) -> void * { return nullptr; };
+    added = host.add(refusing);
+    ASSERT_FALSE(added);
+    EXPECT_EQ(added.error(), mks::make_error_code(mks::PluginError::CreateFailed));
+
+    auto loaded = host.load("/nonexistent/libmks_plugin.so");
+    ASSERT_FALSE(loaded);
+    EXPECT_EQ(loaded.error(), mks::make_error_code(mks::PluginError::LoadFailed));
+
+    EXPECT_TRUE(host.names().empty());
+    EXPECT_FALSE(host.wants(MKS_EVENT_KEY));
+}
+
+TEST(PluginHost, DestroysInstancesWithTheHost) {
+    auto destroyed = false;
+    auto recorder = Recorder {.destroyed = &destroyed};
+    gNextRecorder = &recorder;
+    const auto plugin = makePlugin(0);
+    {
+        auto host = mks::PluginHost {};
+        ASSERT_TRUE(host.add(plugin));
+        EXPECT_EQ(host.names(), std::vector<std::string> {"recorder"});
+        EXPECT_FALSE(destroyed);
+    }
+    EXPECT_TRUE(destroyed);
+}
+
+TEST(PluginHost, AttachesInstancesItDoesNotOwn) {
+    auto destroyed = false;
+    auto recorder = Recorder {.destroyed = &destroyed};
+    const auto plugin = makePlugin(0);
+    {
+        auto host = mks::PluginHost {};
+        auto attached = host.attach(plugin, &recorder);
+        ASSERT_TRUE(attached);
+        recorder.host = *attached;
+        EXPECT_FALSE(host.wants(MKS_EVENT_SCREEN_SWITCH));
+
+        recorder.host->subscribe(recorder.host->context, MKS_EVENT_SCREEN_SWITCH);
+        host.publishScreenSwitch({.ownerId = "server"}, {.key = {.ownerId = "laptop"}, .x = 4}, false);
+        EXPECT_EQ(recorder.types, std::vector<uint32_t> {MKS_EVENT_SCREEN_SWITCH});
+        EXPECT_EQ(recorder.strings, (std::vector<std::string> {"server", "laptop"}));
+    }
+    // Neither created nor destroyed by the host.
+    EXPECT_FALSE(destroyed);
+}
@@ -0,0 +1,9 @@
+target("test_plugin_host")
+    local test_file = path.join(os.scriptdir(), "test_plugin_host.cpp")
+    mks_apply_test_settings(test_file)
+    add_files(test_file, path.join(os.scriptdir(), "support/gtest_entry.cpp"))
+    add_files(path.join(os.projectdir(), "src/app/plugin_host.cpp"))
+    if is_plat("linux") then
+        add_syslinks("dl")
+    end
+target_end()
@@ -4,6 +4,8 @@
 
 #include <gtest/gtest.h>
 #include <ilias/testing.hpp>
+#include <array>
+#include <vector>
 
 namespace {
 
@@ -97,6 +99,130 @@ ILIAS_TEST(RpcTransport, InputMessageRoundTrip) {
     EXPECT_TRUE(serverResult.has_value()) << serverResult.error().message();
 }
 
+ILIAS_TEST(RpcTransport, WriteMessagesKeepsOrder) {
+    auto [clientStream, serverStream] = ilias::DuplexStream::make(1024);
+    mks::RpcTransport client {std::move(clientStream)};
+    mks::RpcTransport server {std::move(serverStream)};
+
+    const auto batch = std::array {
+        mks::RpcMessage {mks::HelloMessage {.machineId = "machine-batch", .name = "batch"}},
+        mks::RpcMessage {mks::ScreensMessage {.screens = {mks::ScreenInfo {.width = 800, .height = 600}}}},
+    };
+    auto written = co_await client.writeMessages(batch);
+    EXPECT_TRUE(written.has_value()) << written.error().message();
+
+    auto first = co_await server.readMessage();
+    auto second = co_await server.readMessage();
+    EXPECT_TRUE(first && std::holds_alternative<mks::HelloMessage>(*first));
+    EXPECT_TRUE(second && std::holds_alternative<mks::ScreensMessage>(*second));
+    if (second && std::holds_alternative<mks::ScreensMessage>(*second)) {
+        const auto &screens = std::get<mks::ScreensMessage>(*second).screens;
+        EXPECT_EQ(screens.size(), 1U);
+        EXPECT_EQ(screens.empty() ? 0 : screens[0].width, 800);
+    }
+}
+
+ILIAS_TEST(RpcTransport, ScreensChangedDiffRoundTrip) {
+    auto [clientStream, serverStream] = ilias::DuplexStream::make(1024);
+    mks::RpcTransport client {std::move(clientStream)};
+    mks::RpcTransport server {std::move(serverStream)};
+
+    // Docked: the laptop panel keeps index 0, the external monitor is 1.
+    const auto undocked = std::vector {
+        mks::ScreenInfo {.width = 1920, .height = 1080, .name = "laptop", .primary = true},
+    };
+    auto docked = undocked;
+    docked[0].primary = false;
+    docked.push_back(mks::ScreenInfo {.x = 1920, .width = 2560, .height = 1440, .name = "dock", .primary = true});
+
+    auto changes = mks::diffScreens(undocked, docked);
+    EXPECT_EQ(changes.count, 2U);
+    EXPECT_EQ(changes.updates.size(), 2U);
+    EXPECT_TRUE(mks::diffScreens(docked, docked).updates.empty());
+
+    auto written = co_await client.writeMessage(mks::RpcMessage {changes});
+    EXPECT_TRUE(written.has_value()) << written.error().message();
+    auto received = co_await server.readMessage();
+    EXPECT_TRUE(received && std::holds_alternative<mks::ScreensChangedMessage>(*received));
+    if (!received || !std::holds_alternative<mks::ScreensChangedMessage>(*received)) {
+        co_return;
+    }
+
+    auto screens = undocked;
+    EXPECT_TRUE(mks::applyScreenChanges(screens, std::get<mks::ScreensChangedMessage>(*received)));
+    EXPECT_EQ(screens, docked);
+
+    // Undocking only shrinks the count and flips the primary flag back.
+    auto undock = mks::diffScreens(docked, undocked);
+    EXPECT_EQ(undock.count, 1U);
+    EXPECT_EQ(undock.updates.size(), 1U);
+    EXPECT_TRUE(mks::applyScreenChanges(screens, undock));
+    EXPECT_EQ(screens, undocked);
+}
+
+TEST(RpcMessage, RejectsScreenChangesWithGaps) {
+    auto screens = std::vector {mks::ScreenInfo {.width = 800, .height = 600}};
+    const auto before = screens;
+
+    // Index 1 is neither known nor updated.
+    auto gap = mks::ScreensChangedMessage {
+        .count = 3,
+        .updates = {mks::ScreenUpdate {.screenIndex = 2, .info = {.width = 640, .height = 480}}},
+    };
+    EXPECT_FALSE(mks::applyScreenChanges(screens, gap));
+    auto outOfRange = mks::ScreensChangedMessage {
+        .count = 1,
+        .updates = {mks::ScreenUpdate {.screenIndex = 1, .info = {.width = 640, .height = 480}}},
+    };
+    EXPECT_FALSE(mks::applyScreenChanges(screens, outOfRange));
+    EXPECT_EQ(screens, before);
+}
+
+ILIAS_TEST(RpcTransport, ClipboardChunksFitOneFrame) {
+    auto [clientStream, serverStream] = ilias::DuplexStream::make(1024);
+    mks::RpcTransport client {std::move(clientStream)};
+    mks::RpcTransport server {std::move(serverStream)};
+
+    // Every byte value, over two full chunks and a partial one.
+    auto content = std::vector<std::byte>(mks::kClipboardChunkBytes * 2 + 1000);
+    for (auto index = size_t {0}; index < content.size(); ++index) {
+        content[index] = static_cast<std::byte>(index * 31 + 7);
+    }
+
+    // The pipe is smaller than a chunk, so write and read side by side.
+    auto received = std::vector<std::byte> {};
+    for (auto offset = uint64_t {0}; offset < content.size(); offset += mks::kClipboardChunkBytes) {
+        auto chunk = mks::makeClipboardChunk(9, content, offset);
+        EXPECT_EQ(chunk.last, offset + mks::kClipboardChunkBytes >= content.size());
+        auto [written, message] = co_await ilias::whenAll(
+            client.writeMessage(mks::RpcMessage {std::move(chunk)}),
+            server.readMessage()
+        );
+        EXPECT_TRUE(written.has_value()) << written.error().message();
+        EXPECT_TRUE(message && std::holds_alternative<mks::ClipboardDataMessage>(*message));
+        if (!message || !std::holds_alternative<mks::ClipboardDataMessage>(*message)) {
+            co_return;
+        }
+        EXPECT_TRUE(mks::appendClipboardChunk(received, std::get<mks::ClipboardDataMessage>(*message)));
+    }
+    EXPECT_EQ(received, content);
+}
+
+TEST(RpcMessage, RejectsClipboardChunksOutOfOrder) {
+    const auto content = std::vector<std::byte>(mks::kClipboardChunkBytes + 10, std::byte {0x5a});
+    auto bytes = std::vector<std::byte> {};
+
+    // The second chunk cannot come first.
+    EXPECT_FALSE(mks::appendClipboardChunk(bytes, mks::makeClipboardChunk(1, content, mks::kClipboardChunkBytes)));
+    EXPECT_TRUE(bytes.empty());
+
+    EXPECT_TRUE(mks::appendClipboardChunk(bytes, mks::makeClipboardChunk(1, content, 0)));
+    auto corrupt = mks::makeClipboardChunk(1, content, mks::kClipboardChunkBytes);
+    corrupt.data.front() = '*';
+    EXPECT_FALSE(mks::appendClipboardChunk(bytes, corrupt));
+    EXPECT_EQ(bytes.size(), mks::kClipboardChunkBytes);
+}
+
 TEST(RpcMessage, InputMessageFormats) {
     auto text = fmtlib::format("{}", mks::RpcMessage {mks::InputMessage {
         .event = mks::InputEvent {mks::MouseMoveEvent {
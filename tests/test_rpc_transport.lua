@@ -4,6 +4,8 @@ target("test_rpc_transport")
     add_files(test_file)
     add_files(
         path.join(os.projectdir(), "src/rpc/message.cpp"),
-        path.join(os.projectdir(), "src/rpc/transport.cpp")
+        path.join(os.projectdir(), "src/rpc/transport.cpp"),
+        path.join(os.projectdir(), "src/diag/metrics.cpp"),
+        path.join(os.projectdir(), "src/diag/trace.cpp")
     )
 target_end()
@@ -1,6 +1,8 @@
 #include "app/server.hpp"
 #include "app/server_input.hpp"
 #include "app/server_screens.hpp"
+#include "app/worker_pool.hpp"
+#include "diag/metrics.hpp"
 #include "platform/platform.hpp"
 #include "support/mock_platform.hpp"
 
@@ -207,6 +209,96 @@ TEST(ServerScreenRegistry, ReplacesScreensForSameEndpoint) {
     EXPECT_EQ(primary->cell, (mks::GridPosition {.x = 0, .y = 0}));
 }
 
+TEST(ServerScreenRegistry, MoveEndpointKeepsScreenNodesAndCells) {
+    auto localEndpoint = makeEndpoint(30028);
+    auto oldEndpoint = makeEndpoint(30029);
+    auto newEndpoint = makeEndpoint(30030);
+    auto screenStore = mks::ServerScreenStore {};
+    auto senders = mks::ServerInputRouter::ClientSenders {};
+    auto input = mks::ServerInputRouter {screenStore, senders};
+    const auto remoteScreens = std::vector {
+        makeScreen("remote-primary", 2560, 1440, true),
+        makeScreen("remote-side", 1920, 1080, false),
+    };
+
+    addLocalScreens(screenStore, input, localEndpoint, {makeScreen("local", 1920, 1080, true)});
+    addRemoteScreens(screenStore, oldEndpoint, "machine-remote", remoteScreens);
+    auto *before = screenStore.findScreen(mks::ScreenKey {.ownerId = "machine-remote", .screenIndex = 1});
+    ASSERT_NE(before, nullptr);
+    const auto cell = before->cell;
+    EXPECT_TRUE(screenStore.matchesScreens(oldEndpoint, remoteScreens));
+    EXPECT_FALSE(screenStore.matchesScreens(oldEndpoint, {remoteScreens[0]}));
+
+    screenStore.moveEndpoint(oldEndpoint, newEndpoint);
+
+    EXPECT_EQ(screenStore.findEndpointScreen(oldEndpoint), nullptr);
+    EXPECT_TRUE(screenStore.matchesScreens(newEndpoint, remoteScreens));
+    auto *after = screenStore.findScreen(mks::ScreenKey {.ownerId = "machine-remote", .screenIndex = 1});
+    EXPECT_EQ(after, before);
+    EXPECT_EQ(after->endpoint, newEndpoint);
+    EXPECT_EQ(after->cell, cell);
+    EXPECT_EQ(screenStore.topologyScreens().size(), 3U);
+}
+
+TEST(ServerScreenRegistry, ScreenChangesKeepUnaffectedActiveScreen) {
+    auto localEndpoint = makeEndpoint(30031);
+    auto remoteEndpoint = makeEndpoint(30032);
+    auto screenStore = mks::ServerScreenStore {};
+    auto senders = mks::ServerInputRouter::ClientSenders {};
+    auto input = mks::ServerInputRouter {screenStore, senders};
+    const auto docked = std::vector {
+        makeScreen("laptop", 2560, 1440, true),
+        makeScreen("dock", 1920, 1080, false),
+    };
+    const auto panelKey = mks::ScreenKey {.ownerId = "machine-remote", .screenIndex = 0};
+    const auto dockKey = mks::ScreenKey {.ownerId = "machine-remote", .screenIndex = 1};
+
+    addLocalScreens(screenStore, input, localEndpoint, {makeScreen("local", 1920, 1080, true)});
+    addRemoteScreens(screenStore, remoteEndpoint, "machine-remote", docked);
+    const auto dockCell = screenStore.findScreen(dockKey)->cell;
+
+    // Enter the laptop panel and park the cursor near its bottom-right corner.
+    input.handleInputEvent(mks::InputEvent {mks::MouseMoveEvent {.x = 1919, .y = 540, .screenIndex = 0}});
+    input.handleInputEvent(mks::InputEvent {mks::MouseMoveEvent {
+        .x = 1919,
+        .y = 540,
+        .screenIndex = 0,
+        .deltaX = 2000,
+        .deltaY = 800,
+    }});
+    ASSERT_EQ(input.activeScreenKey(), panelKey);
+    auto *active = input.activeScreen();
+
+    // Undock: the dock goes away and the panel drops to a smaller mode.
+    const auto undocked = std::vector {makeScreen("laptop", 1280, 800, true)};
+    EXPECT_FALSE(screenStore.applyScreenChanges(
+        remoteEndpoint, mks::diffScreens(docked, undocked), false, input.activeScreen()
+    ));
+    input.clampActivePoint();
+    EXPECT_EQ(input.activeScreen(), active);
+    EXPECT_EQ(input.activeScreenKey(), panelKey);
+    EXPECT_EQ(screenStore.findScreen(dockKey), nullptr);
+    EXPECT_EQ(screenStore.findScreen(panelKey)->info.width, 1280);
+    EXPECT_TRUE(screenStore.matchesScreens(remoteEndpoint, undocked));
+    EXPECT_EQ(screenStore.topologyScreens().size(), 2U);
+
+    // Re-docking restores the dock's remembered cell.
+    EXPECT_FALSE(screenStore.applyScreenChanges(
+        remoteEndpoint, mks::diffScreens(undocked, docked), false, input.activeScreen()
+    ));
+    ASSERT_NE(screenStore.findScreen(dockKey), nullptr);
+    EXPECT_EQ(screenStore.findScreen(dockKey)->cell, dockCell);
+    EXPECT_EQ(input.activeScreen(), active);
+
+    // Losing the active screen itself is reported to the caller.
+    const auto changes = mks::ScreensChangedMessage {.count = 0};
+    EXPECT_TRUE(screenStore.applyScreenChanges(remoteEndpoint, changes, false, input.activeScreen()));
+    input.clearActiveState();
+    input.ensureActiveLocalScreen();
+    ASSERT_TRUE(input.activeScreenKey().has_value());
+    EXPECT_EQ(input.activeScreenKey()->ownerId, fmtlib::format("{}", localEndpoint));
+}
+
 TEST(ServerScreenRegistry, UsesConfiguredScreenCells) {
     auto localEndpoint = makeEndpoint(30014);
     auto remoteEndpoint = makeEndpoint(30015);
@@ -369,6 +461,41 @@ TEST(ServerScreenRegistry, PersistsRegisteredScreenCellsToConfig) {
     std::filesystem::remove(path);
 }
 
+TEST(ServerScreenRegistry, SavesConfigOnWorkerPool) {
+    auto path = std::filesystem::temp_directory_path() / "mksync-test-server-layout-pool.json";
+    std::filesystem::remove(path);
+
+    {
+        auto workers = mks::WorkerPool {2};
+        auto screenStore = mks::ServerScreenStore {mks::AppConfig {
+            .version = 1,
+            .machineId = "machine-local",
+            .screens = {},
+            .trustedClients = {},
+        }, path};
+        screenStore.setWorkerPool(&workers);
+        auto senders = mks::ServerInputRouter::ClientSenders {};
+        auto input = mks::ServerInputRouter {screenStore, senders};
+
+        addLocalScreens(screenStore, input, makeEndpoint(30033), {
+            makeScreen("local-primary", 1920, 1080, true),
+            makeScreen("local-secondary", 1280, 1024, false),
+        });
+        addRemoteScreens(screenStore, makeEndpoint(30034), "machine-remote", {
+            makeScreen("remote-primary", 2560, 1440, true),
+        });
+        // The pool drains queued saves before its workers stop.
+    }
+
+    // Coalesced writes still end on the newest layout.
+    auto loaded = mks::loadConfig(path);
+    ASSERT_TRUE(loaded.has_value()) << loaded.error().message();
+    EXPECT_EQ(loaded->screens.size(), 3U);
+    auto remote = mks::findScreenLayout(*loaded, "machine-remote", 0);
+    ASSERT_TRUE(remote.has_value());
+    EXPECT_EQ(*remote, (mks::GridPosition {.x = 2, .y = 0}));
+}
+
 TEST(ServerSecurity, AllowsAllClientsWhenTrustedListIsEmpty) {
     auto config = mks::AppConfig {};
 
@@ -563,6 +690,37 @@ TEST(ServerInputRouting, KeepsActiveScreenWhenEdgeHasNoNeighbor) {
     EXPECT_EQ(input.activeScreenKey(), activeBefore);
 }
 
+TEST(ServerInputRouting, CountsReleasesDroppedPastTheHoldLimit) {
+    auto localEndpoint = makeEndpoint(30035);
+    auto remoteEndpoint = makeEndpoint(30036);
+    auto screenStore = mks::ServerScreenStore {};
+    auto senders = mks::ServerInputRouter::ClientSenders {};
+    auto input = mks::ServerInputRouter {screenStore, senders};
+    auto &dropped = mks::metrics().counter("server.input.dropped_held_releases");
+
+    addLocalScreens(screenStore, input, localEndpoint, {
+        makeScreen("local-primary", 1920, 1080, true),
+    });
+    addRemoteScreens(screenStore, remoteEndpoint, {
+        makeScreen("remote-primary", 2560, 1440, true),
+    });
+    input.handleInputEvent(mks::InputEvent {mks::MouseMoveEvent {
+        .x = 1919,
+        .y = 540,
+        .screenIndex = 0,
+    }});
+    input.holdReleases(remoteEndpoint);
+
+    const auto before = dropped.value();
+    input.handleInputEvent(mks::InputEvent {mks::KeyEvent {.key = mks::Key::B}});
+    for (auto i = 0; i < 10; ++i) {
+        input.handleInputEvent(mks::InputEvent {mks::KeyEvent {.key = mks::Key::A, .release = true}});
+    }
+
+    // Eight are held for the resume; only the releases past that count.
+    EXPECT_EQ(dropped.value() - before, 2U);
+}
+
 ILIAS_TEST(ServerInputRouting, SendsInputMessagesToRemoteClient) {
     auto localEndpoint = makeEndpoint(30008);
     auto remoteEndpoint = makeEndpoint(30009);
@@ -0,0 +1,62 @@
+#include "preinclude.hpp"
+#include "core/spsc_ring.hpp"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+
+TEST(SpscRing, KeepsOrderAndRefusesWhenFull) {
+    auto ring = mks::SpscRing<int> {3};
+    EXPECT_EQ(ring.capacity(), 4U);
+    EXPECT_TRUE(ring.empty());
+    for (auto value = 0; value < 4; ++value) {
+        EXPECT_TRUE(ring.tryPush(int {value}));
+    }
+    EXPECT_FALSE(ring.tryPush(4));
+    for (auto value = 0; value < 4; ++value) {
+        EXPECT_EQ(ring.tryPop(), value);
+    }
+    EXPECT_FALSE(ring.tryPop());
+    // Slots are reused on the next lap.
+    EXPECT_TRUE(ring.tryPush(5));
+    EXPECT_EQ(ring.tryPop(), 5);
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(SpscRing, RefusedPushKeepsTheValue) {
+    auto ring = mks::SpscRing<std::unique_ptr<int>> {2};
+    EXPECT_TRUE(ring.tryPush(std::make_unique<int>(1)));
+    EXPECT_TRUE(ring.tryPush(std::make_unique<int>(2)));
+    auto third = std::make_unique<int>(3);
+    EXPECT_FALSE(ring.tryPush(std::move(third)));
+    ASSERT_TRUE(third);
+    EXPECT_EQ(**ring.tryPop(), 1);
+    EXPECT_TRUE(ring.tryPush(std::move(third)));
+    EXPECT_EQ(**ring.tryPop(), 2);
+    EXPECT_EQ(**ring.tryPop(), 3);
+}
+
+TEST(SpscRing, DeliversEveryPushInOrderAcrossThreads) {
+    constexpr auto count = 200'000;
+    auto ring = mks::SpscRing<int> {64};
+    {
+        auto producer = std::jthread {[&ring] {
+            for (auto value = 0; value < count; ++value) {
+                while (!ring.tryPush(int {value})) {
+                    std::this_thread::yield();
+                }
+            }
+        }};
+        for (auto expected = 0; expected < count;) {
+            auto value = ring.tryPop();
+            if (!value) {
+                std::this_thread::yield();
+                continue;
+            }
+            // Keeps draining on a mismatch, so the producer can finish.
+            EXPECT_EQ(*value, expected);
+            expected = *value + 1;
+        }
+    }
+    EXPECT_TRUE(ring.empty());
+}
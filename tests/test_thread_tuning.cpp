@@ -0,0 +1,154 @@
+#include "preinclude.hpp"
+#include "app/thread_tuning.hpp"
+#include "diag/metrics.hpp"
+
+#include <gtest/gtest.h>
+#include <ilias/testing.hpp>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+    #include <sched.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+using namespace std::chrono_literals;
+
+namespace {
+
+#if defined(__linux__)
+
+struct Scheduling {
+    int policy = 0;
+    int nice = 0;
+    int cpus = 0;
+};
+
+auto currentScheduling() -> Scheduling {
+    auto set = cpu_set_t {};
+    (void) ::sched_getaffinity(0, sizeof(set), &set);
+    return Scheduling {
+        .policy = ::sched_getscheduler(0) & ~SCHED_RESET_ON_FORK,
+        .nice = ::getpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid))),
+        .cpus = CPU_COUNT(&set),
+    };
+}
+
+auto firstAllowedCpu() -> size_t {
+    auto set = cpu_set_t {};
+    (void) ::sched_getaffinity(0, sizeof(set), &set);
+    for (auto cpu = size_t {0}; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+            return cpu;
+        }
+    }
+    return 0;
+}
+
+// Runs @p body on a thread of its own, so the test runner keeps its scheduling.
+template <typename Body>
+auto onFreshThread(Body body) -> void {
+    auto thread = std::jthread {std::move(body)};
+}
+
+#endif
+
+} // namespace
+
+TEST(ThreadTuning, ParsesCpuLists) {
+    EXPECT_EQ(mks::parseCpuList("").value(), std::vector<size_t> {});
+    EXPECT_EQ(mks::parseCpuList("2").value(), std::vector<size_t> {2});
+    EXPECT_EQ(mks::parseCpuList("0,2-3").value(), (std::vector<size_t> {0, 2, 3}));
+    // Sorted, duplicates folded.
+    EXPECT_EQ(mks::parseCpuList("3,1-2,2").value(), (std::vector<size_t> {1, 2, 3}));
+
+    EXPECT_FALSE(mks::parseCpuList("x"));
+    EXPECT_FALSE(mks::parseCpuList("3-1"));
+    EXPECT_FALSE(mks::parseCpuList(",1"));
+    EXPECT_FALSE(mks::parseCpuList("-2"));
+    EXPECT_FALSE(mks::parseCpuList("1-"));
+}
+
+TEST(ThreadTuning, ParsesPolicies) {
+    EXPECT_EQ(mks::parseSchedulingPolicy("off").value(), mks::ThreadTuning::Policy::Normal);
+    EXPECT_EQ(mks::parseSchedulingPolicy("fifo").value(), mks::ThreadTuning::Policy::Fifo);
+    EXPECT_EQ(mks::parseSchedulingPolicy("rr").value(), mks::ThreadTuning::Policy::RoundRobin);
+    EXPECT_FALSE(mks::parseSchedulingPolicy("idle"));
+}
+
+TEST(ThreadTuning, DefaultChangesNothing) {
+    EXPECT_FALSE(mks::ThreadTuning {}.enabled());
+    const auto applied = mks::applyThreadTuning(mks::ThreadTuning {});
+    EXPECT_EQ(applied.policy, mks::ThreadTuning::Policy::Normal);
+    EXPECT_EQ(applied.nice, 0);
+    EXPECT_FALSE(applied.pinned);
+    EXPECT_FALSE(applied.memoryLocked);
+}
+
+#if defined(__linux__)
+
+// Whether real-time is permitted depends on where the test runs; either
+// outcome must stay on the tuned thread and not reach threads it starts.
+TEST(ThreadTuning, RaisedPriorityIsNotInherited) {
+    onFreshThread([] {
+        const auto before = currentScheduling();
+        const auto applied = mks::applyThreadTuning(mks::ThreadTuning {
+            .policy = mks::ThreadTuning::Policy::Fifo,
+            .priority = 1,
+        });
+        const auto tuned = currentScheduling();
+        if (applied.policy == mks::ThreadTuning::Policy::Fifo) {
+            EXPECT_EQ(tuned.policy, SCHED_FIFO);
+        }
+        else {
+            EXPECT_EQ(tuned.policy, SCHED_OTHER);
+            EXPECT_EQ(tuned.nice, applied.nice == 0 ? before.nice : mks::kFallbackNice);
+        }
+        // A raised priority comes back down to nice 0; a lowered one stays.
+        const auto raised = applied.policy != mks::ThreadTuning::Policy::Normal || applied.nice != 0;
+        onFreshThread([&] {
+            const auto helper = currentScheduling();
+            EXPECT_EQ(helper.policy, SCHED_OTHER);
+            EXPECT_EQ(helper.nice, raised ? 0 : std::max(before.nice, 0));
+        });
+    });
+}
+
+TEST(ThreadTuning, HelperThreadsDropTheCpuPin) {
+    onFreshThread([] {
+        const auto before = currentScheduling();
+        const auto applied = mks::applyThreadTuning(mks::ThreadTuning {.cpus = {firstAllowedCpu()}});
+        EXPECT_TRUE(applied.pinned);
+        EXPECT_EQ(currentScheduling().cpus, 1);
+        onFreshThread([&] {
+            // Inherited until the helper resets itself.
+            EXPECT_EQ(currentScheduling().cpus, 1);
+            mks::resetThreadTuning();
+            EXPECT_EQ(currentScheduling().cpus, before.cpus);
+        });
+    });
+}
+
+#endif
+
+ILIAS_TEST(ThreadTuning, ProbeRecordsWakeUps) {
+    auto &late = mks::metrics().histogram("sched.wakeup_late_ns");
+    const auto before = late.snapshot().count;
+    auto [probe, slept] = co_await ilias::whenAny(mks::watchSchedulingDelay(5ms), ilias::sleep(60ms));
+    EXPECT_FALSE(probe);
+    EXPECT_TRUE(slept);
+    EXPECT_GT(late.snapshot().count, before);
+}
+
+int main(int argc, char **argv) {
+    ILIAS_TEST_SETUP_UTF8();
+    ilias::PlatformContext context {};
+    context.install();
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
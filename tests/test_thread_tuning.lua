@@ -0,0 +1,9 @@
+target("test_thread_tuning")
+    local test_file = path.join(os.scriptdir(), "test_thread_tuning.cpp")
+    mks_apply_test_settings(test_file)
+    add_files(test_file)
+    add_files(
+        path.join(os.projectdir(), "src/app/thread_tuning.cpp"),
+        path.join(os.projectdir(), "src/diag/metrics.cpp")
+    )
+target_end()
@@ -85,6 +85,30 @@ TEST(ScreenTopology, RejectsInvalidRects) {
     );
 }
 
+TEST(ScreenTopology, UpdatesAndRemovesSingleScreens) {
+    auto topology = mks::ScreenTopology {};
+    const auto laptop = makeKey("owner", 0);
+    const auto external = makeKey("owner", 1);
+    ASSERT_TRUE(topology.addScreen(makeScreen(laptop, {0, 0}, 1920, 1080)).has_value());
+    ASSERT_TRUE(topology.addScreen(makeScreen(external, {1, 0}, 2560, 1440)).has_value());
+
+    auto resized = makeScreen(laptop, {5, 5}, 1280, 800).info;
+    ASSERT_TRUE(topology.updateScreenInfo(laptop, resized).has_value());
+    ASSERT_NE(topology.findScreen(laptop), nullptr);
+    EXPECT_EQ(topology.findScreen(laptop)->info.width, 1280);
+    EXPECT_EQ(topology.findScreen(laptop)->cell, (mks::GridPosition {0, 0}));
+
+    topology.removeScreen(external);
+    EXPECT_EQ(topology.findScreen(external), nullptr);
+    EXPECT_EQ(topology.findNeighbor(laptop, mks::Edge::Right), std::nullopt);
+    // The freed cell can be reused.
+    EXPECT_TRUE(topology.addScreen(makeScreen(makeKey("other"), {1, 0}, 1920, 1080)).has_value());
+
+    auto unknown = topology.updateScreenInfo(external, resized);
+    ASSERT_FALSE(unknown.has_value());
+    EXPECT_EQ(unknown.error(), mks::make_error_code(mks::TopologyError::UnknownScreen));
+}
+
 TEST(ScreenTopology, DetectsEdgesFromRealScreenRect) {
     auto topology = mks::ScreenTopology {};
     const auto key = makeKey("screen");
@@ -0,0 +1,110 @@
+#include "preinclude.hpp"
+#include "diag/trace.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+namespace {
+
+auto tracePath(std::string_view name) -> std::filesystem::path {
+    auto path = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove(path);
+    return path;
+}
+
+auto readText(const std::filesystem::path &path) -> std::string {
+    auto file = std::ifstream {path, std::ios::binary};
+    return std::string {std::istreambuf_iterator<char> {file}, std::istreambuf_iterator<char> {}};
+}
+
+auto countOf(std::string_view text, std::string_view needle) -> size_t {
+    auto count = size_t {0};
+    for (auto pos = text.find(needle); pos != std::string_view::npos; pos = text.find(needle, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+} // namespace
+
+TEST(Trace, DisabledByDefault) {
+    EXPECT_FALSE(mks::tracingEnabled());
+    EXPECT_EQ(mks::nextTraceId(), 0U);
+    // Nothing to write, and no file is created.
+    const auto path = tracePath("mksync-test-trace-disabled.json");
+    EXPECT_TRUE(mks::stopTracing().has_value());
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+TEST(Trace, WritesSpansFlowsAndAsyncSlices) {
+    const auto path = tracePath("mksync-test-trace.json");
+    mks::startTracing(path, "server");
+    ASSERT_TRUE(mks::tracingEnabled());
+
+    const auto id = mks::nextTraceId();
+    EXPECT_NE(id, 0U);
+    EXPECT_NE(mks::nextTraceId(), id);
+    {
+        auto span = mks::TraceSpan {"ServerInputRouter::handleInputEvent"};
+        mks::traceFlow(mks::TraceFlow::Start, id);
+        mks::traceAsyncBegin("channel", id);
+    }
+    mks::traceAsyncEnd("channel", id);
+    {
+        auto span = mks::TraceSpan {"RpcTransport::writeMessage"};
+        span.setId(id);
+        mks::traceFlow(mks::TraceFlow::Step, id);
+    }
+    // Id 0 means "untraced message": no flow hop is emitted for it.
+    mks::traceFlow(mks::TraceFlow::End, 0);
+    std::thread {[] {
+        auto span = mks::TraceSpan {"worker"};
+    }}.join();
+
+    auto written = mks::stopTracing();
+    ASSERT_TRUE(written.has_value()) << written.error().message();
+    EXPECT_FALSE(mks::tracingEnabled());
+
+    const auto text = readText(path);
+    std::filesystem::remove(path);
+    EXPECT_EQ(text.rfind(R"({"traceEvents":[)", 0), 0U);
+    EXPECT_NE(text.find(R"("args":{"name":"mksync server"})"), std::string::npos);
+    EXPECT_EQ(countOf(text, R"("ph":"X")"), 3U);
+    EXPECT_EQ(countOf(text, R"("ph":"s")"), 1U);
+    EXPECT_EQ(countOf(text, R"("ph":"t")"), 1U);
+    EXPECT_EQ(countOf(text, R"("ph":"f")"), 0U);
+    EXPECT_EQ(countOf(text, R"("ph":"b")"), 1U);
+    EXPECT_EQ(countOf(text, R"("ph":"e")"), 1U);
+    EXPECT_NE(text.find(R"("name":"RpcTransport::writeMessage")"), std::string::npos);
+    EXPECT_NE(text.find(fmtlib::format(R"("args":{{"id":{}}})", id)), std::string::npos);
+    EXPECT_NE(text.find(R"("droppedEvents":0)"), std::string::npos);
+}
+
+TEST(Trace, RestartDiscardsPreviousSession) {
+    const auto first = tracePath("mksync-test-trace-first.json");
+    mks::startTracing(first, "client");
+    mks::traceInstant("InputCapture::nextEvent");
+    // Restarting before stop drops what the earlier session collected.
+    const auto second = tracePath("mksync-test-trace-second.json");
+    mks::startTracing(second, "client");
+    {
+        auto span = mks::TraceSpan {"InputInjector::inject", 42};
+    }
+    ASSERT_TRUE(mks::stopTracing().has_value());
+
+    const auto text = readText(second);
+    std::filesystem::remove(second);
+    EXPECT_FALSE(std::filesystem::exists(first));
+    EXPECT_EQ(countOf(text, "InputCapture::nextEvent"), 0U);
+    EXPECT_EQ(countOf(text, "InputInjector::inject"), 1U);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
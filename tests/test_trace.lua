@@ -0,0 +1,6 @@
+target("test_trace")
+    local test_file = path.join(os.scriptdir(), "test_trace.cpp")
+    mks_apply_test_settings(test_file)
+    add_files(test_file)
+    add_files(path.join(os.projectdir(), "src/diag/trace.cpp"))
+target_end()
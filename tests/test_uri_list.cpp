@@ -0,0 +1,42 @@
+#include <gtest/gtest.h>
+
+#include "platform/uri_list.hpp"
+
+namespace
+{
+
+    TEST(UriList, ParsesLocalFileUris)
+    {
+        const auto files = mks::parseFileUriList(
+            "file:///home/user/report.pdf\r\nfile://localhost/tmp/notes.txt\r\n");
+        ASSERT_EQ(files.size(), 2U);
+        EXPECT_EQ(files[0], std::filesystem::path{"/home/user/report.pdf"});
+        EXPECT_EQ(files[1], std::filesystem::path{"/tmp/notes.txt"});
+    }
+
+    TEST(UriList, DecodesPercentEscapes)
+    {
+        const auto files = mks::parseFileUriList("file:///home/user/My%20Photos/%E6%97%A5.jpg");
+        ASSERT_EQ(files.size(), 1U);
+        EXPECT_EQ(files[0].string(), "/home/user/My Photos/\xE6\x97\xA5.jpg");
+    }
+
+    TEST(UriList, SkipsCommentsRemoteHostsAndOtherSchemes)
+    {
+        const auto files = mks::parseFileUriList("# dragged from a browser\n"
+                                                 "https://example.com/a.txt\n"
+                                                 "file://nas/share/b.txt\n"
+                                                 "\n"
+                                                 "file:///c.txt\n");
+        ASSERT_EQ(files.size(), 1U);
+        EXPECT_EQ(files[0], std::filesystem::path{"/c.txt"});
+    }
+
+    TEST(UriList, SkipsMalformedEscapes)
+    {
+        EXPECT_TRUE(mks::parseFileUriList("file:///a%2").empty());
+        EXPECT_TRUE(mks::parseFileUriList("file:///a%zz").empty());
+        EXPECT_TRUE(mks::parseFileUriList("file:///a%00b").empty());
+    }
+
+} // namespace
@@ -0,0 +1,5 @@
+target("test_uri_list")
+    local test_file = path.join(os.scriptdir(), "test_uri_list.cpp")
+    mks_apply_test_settings(test_file)
+    add_files(test_file, path.join(os.scriptdir(), "support/gtest_entry.cpp"))
+target_end()
@@ -0,0 +1,101 @@
+#include "preinclude.hpp"
+#include "app/worker_pool.hpp"
+
+#include <gtest/gtest.h>
+#include <ilias/testing.hpp>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+ILIAS_TEST(WorkerPool, SubmitResumesOnTheCallingThread) {
+    auto workers = mks::WorkerPool {2};
+    const auto caller = std::this_thread::get_id();
+
+    auto worker = co_await workers.submit([] { return std::this_thread::get_id(); });
+    EXPECT_TRUE(worker);
+    if (worker) {
+        EXPECT_NE(*worker, caller);
+    }
+    EXPECT_EQ(std::this_thread::get_id(), caller);
+}
+
+ILIAS_TEST(WorkerPool, SubmitPassesResultsAndErrorsThrough) {
+    auto workers = mks::WorkerPool {1};
+
+    auto text = co_await workers.submit([] { return std::string(3, 'x'); });
+    EXPECT_EQ(text.value_or(""), "xxx");
+
+    auto failed = co_await workers.submit([]() -> mks::IoResult<int> {
+        return mks::Err(std::make_error_code(std::errc::io_error));
+    });
+    EXPECT_FALSE(failed);
+    if (!failed) {
+        EXPECT_EQ(failed.error(), std::make_error_code(std::errc::io_error));
+    }
+
+    auto ran = false;
+    auto done = co_await workers.submit([&ran] { ran = true; });
+    EXPECT_TRUE(done);
+    EXPECT_TRUE(ran);
+
+    // A throwing job is dropped, not fatal.
+    auto thrown = co_await workers.submit([]() -> int { throw std::runtime_error("job failed"); });
+    EXPECT_FALSE(thrown);
+    if (!thrown) {
+        EXPECT_EQ(thrown.error(), std::make_error_code(std::errc::operation_canceled));
+    }
+}
+
+TEST(WorkerPool, SpreadsBlockedWorkOverEveryWorker) {
+    // Four jobs that each wait for all four to start only finish if every
+    // worker picks one up, whichever queue they were posted to.
+    auto workers = mks::WorkerPool {4};
+    auto started = std::atomic<int> {0};
+    auto threads = std::vector<std::thread::id>(4);
+    auto finished = std::atomic<int> {0};
+    for (auto index = 0; index < 4; ++index) {
+        workers.post([&, index] {
+            threads[index] = std::this_thread::get_id();
+            started.fetch_add(1);
+            const auto deadline = std::chrono::steady_clock::now() + 5s;
+            while (started.load() < 4 && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::yield();
+            }
+            finished.fetch_add(1);
+        });
+    }
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (finished.load() < 4 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_EQ(finished.load(), 4);
+    EXPECT_EQ(std::set(threads.begin(), threads.end()).size(), 4U);
+}
+
+TEST(WorkerPool, DrainsQueuedJobsOnDestruction) {
+    auto count = std::atomic<int> {0};
+    {
+        auto workers = mks::WorkerPool {2};
+        for (auto index = 0; index < 100; ++index) {
+            workers.post([&count] {
+                std::this_thread::sleep_for(100us);
+                count.fetch_add(1);
+            });
+        }
+    }
+    EXPECT_EQ(count.load(), 100);
+}
+
+int main(int argc, char **argv) {
+    ILIAS_TEST_SETUP_UTF8();
+    ilias::PlatformContext context {};
+    context.install();
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,10 @@
+target("test_worker_pool")
+    local test_file = path.join(os.scriptdir(), "test_worker_pool.cpp")
+    mks_apply_test_settings(test_file)
+    add_files(test_file)
+    add_files(
+        path.join(os.projectdir(), "src/app/worker_pool.cpp"),
+        path.join(os.projectdir(), "src/app/thread_tuning.cpp"),
+        path.join(os.projectdir(), "src/diag/metrics.cpp")
+    )
+target_end()
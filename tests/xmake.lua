@@ -5,6 +5,13 @@ option("enable_tests")
     set_category("enable test")
 option_end()
 
+option("enable_benches")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Enable benchmark targets (bench_*.cpp), off by default")
+    set_category("enable test")
+option_end()
+
 if get_config("enable_tests") ~= false then
 add_requires("gtest")
 add_packages("gtest")
@@ -32,20 +39,31 @@ local function add_common_test_packages()
     end
 end
 
-function mks_apply_test_settings(file)
-    local group = test_group(file)
+local function apply_binary_settings(group_prefix, file)
     set_kind("binary")
     set_default(false)
-    set_group("tests/" .. group)
+    set_group(group_prefix .. test_group(file))
     add_includedirs(path.join(os.projectdir(), "src"))
     add_includedirs(test_root)
     if stdcxx_version() == 26 and is_tool("cxx", "gcc") then
         add_cxxflags("-freflection", {force = true})
     end
     add_common_test_packages()
+end
+
+function mks_apply_test_settings(file)
+    local group = test_group(file)
+    apply_binary_settings("tests/", file)
     add_tests(stdcxx():gsub("%+", "p", 2), {group = group, kind = "binary", languages = stdcxx()})
 end
 
+-- Benchmarks share the test toolchain but are run by hand (`xmake run bench_*`),
+-- never by `xmake test`: their numbers depend on the machine, not pass/fail.
+-- Only with --enable_benches=y, so test builds do not compile them.
+function mks_apply_bench_settings(file)
+    apply_binary_settings("bench/", file)
+end
+
 function mks_add_default_test(file)
     target(path.basename(file))
         mks_apply_test_settings(file)
@@ -53,6 +71,13 @@ function mks_add_default_test(file)
     target_end()
 end
 
+function mks_add_default_bench(file)
+    target(path.basename(file))
+        mks_apply_bench_settings(file)
+        add_files(file)
+    target_end()
+end
+
 for _, file in ipairs(os.files(path.join(test_root, "**.cpp"))) do
     local dir = path.directory(file)
     local name = path.basename(file)
@@ -64,6 +89,12 @@ for _, file in ipairs(os.files(path.join(test_root, "**.cpp"))) do
         else
             mks_add_default_test(file)
         end
+    elseif name:sub(1, 6) == "bench_" and has_config("enable_benches") then
+        if os.exists(conf) then
+            includes(conf)
+        else
+            mks_add_default_bench(file)
+        end
     end
 end
 end
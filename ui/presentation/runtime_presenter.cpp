@@ -3,6 +3,7 @@
 
 #include "app/client.hpp"
 #include "app/server.hpp"
+#include "config/backend_cache.hpp"
 #include "platform/backend.hpp"
 #include "platform/platform.hpp"
 
@@ -501,8 +502,9 @@ namespace mks::gui
             spdlog::set_level(parseLogLevel(logLevel()));
             const auto requirement = selectedMode() == ServerMode ? BackendRequirement::Capture
                                                                   : BackendRequirement::Injection;
-            auto       selected    = co_await selectBackend(commonConfig().backend,
-                                                            BackendRequirement::Screens | requirement);
+            auto       selected    = co_await selectCachedBackend(
+                commonConfig().backend, BackendRequirement::Screens | requirement,
+                backendCachePath(configPath));
             if (!selected) {
                 mRunError = tr("没有满足当前运行模式的可用输入后端：%1")
                                 .arg(QString::fromStdString(selected.error().message()));
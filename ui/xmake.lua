@@ -30,8 +30,10 @@ target("mksync-gui")
         "qml.qrc",
         path.join(os.projectdir(), "src/config/app_config.cpp"),
         path.join(os.projectdir(), "src/config/arg_config.cpp"),
+        path.join(os.projectdir(), "src/config/backend_cache.cpp"),
         path.join(os.projectdir(), "src/core.cpp"),
         path.join(os.projectdir(), "src/core/**.cpp"),
+        path.join(os.projectdir(), "src/diag/**.cpp"),
         path.join(os.projectdir(), "src/app/**.cpp"),
         path.join(os.projectdir(), "src/rpc/**.cpp")
     )
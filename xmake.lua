@@ -36,6 +36,15 @@ option("enable_gui")
     set_description("Enable the isolated Qt 6/QML GUI target")
     set_category("mksync features")
 option_end()
+option("enable_usdt")
+    set_default(true)
+    set_showmenu(true)
+    set_description("Emit USDT probes (needs <sys/sdt.h>; see src/diag/probes.hpp)")
+    set_category("mksync features")
+option_end()
+if not has_config("enable_usdt") then
+    add_defines("MKS_USDT=0")
+end
 
 includes("lua/check")
 check_macros("has_std_out_ptr",         "__cpp_lib_out_ptr",            {languages = stdcxx(), includes = "version"})
@@ -127,9 +136,11 @@ target("mksync")
     add_files("src/app/**.cpp")
     add_files("src/config/**.cpp")
     add_files("src/core/**.cpp")
+    add_files("src/diag/**.cpp")
     add_files("src/rpc/**.cpp")
     mks_add_backend_sources()
     add_installfiles("LICENSE", "README.md", "README_zh.md", {prefixdir = "share/doc/mksync"})
+    add_installfiles("src/plugin/mks_plugin.h", "src/plugin/mks_event_ring.h", {prefixdir = "include/mksync"})
 
     -- Pch
     set_pcxxheader("src/config/pch.hpp")
@@ -141,6 +152,8 @@ target("mksync")
     end
 
     if is_plat("linux") then
+        -- dlopen for --plugins.
+        add_syslinks("dl")
         set_policy("install.strip_packagelibs", true)
         add_rpathdirs("$ORIGIN/../lib", {installonly = true})
     end